@@ -0,0 +1,291 @@
+/**
+ * @file roundtrip_bench.c
+ * @brief Parse-from-text against decode-from-binary throughput
+ *
+ * Every statement of the given scripts that parses is kept as text and as a serialized AST. The
+ * benchmark then times parsing the texts against decoding the binaries, both with AstReader
+ * (ast_reader_init() and ast_reader_materialize() on the borrowed data) and through a
+ * SerializedAST handle (ast_deserialize() and ast_decode()).
+ *
+ * Usage: nsql_roundtrip_bench [-n iterations] script.nsql...
+ */
+
+#include <nsql/ast_reader.h>
+#include <nsql/ast_serializer.h>
+#include <nsql/parallel_parser.h>
+#include <nsql/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Default number of passes over the corpus
+#define DEFAULT_ITERATIONS 2000
+
+// Statements kept for the benchmark
+typedef struct {
+    char**  texts;         // Null-terminated statement texts
+    void**  blobs;         // Serialized statements
+    size_t* blob_sizes;    // Size of each blob
+    size_t  count;         // Number of statements
+    size_t  capacity;      // Allocated entries
+    size_t  text_bytes;    // Total size of the texts
+    size_t  binary_bytes;  // Total size of the blobs
+} Corpus;
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param size The size in bytes.
+ * @return The allocation.
+ */
+static void* checked_malloc(size_t size) {
+    void* result = malloc(size > 0 ? size : 1);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Get a wall-clock time stamp.
+ *
+ * @return The time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Read a whole file.
+ *
+ * @param path The file to read.
+ * @param length Receives the length of the contents.
+ * @return The null-terminated contents, or NULL if the file cannot be read.
+ */
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    size_t capacity = 4096;
+    char*  data     = (char*)checked_malloc(capacity);
+    *length         = 0;
+    for (;;) {
+        size_t read = fread(data + *length, 1, capacity - *length - 1, file);
+        *length += read;
+        if (read == 0)
+            break;
+        if (capacity - *length == 1) {
+            capacity *= 2;
+            char* grown = (char*)realloc(data, capacity);
+            if (!grown) {
+                fprintf(stderr, "Error: Out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+    }
+    fclose(file);
+
+    data[*length] = '\0';
+    return data;
+}
+
+/**
+ * Parse one statement text.
+ *
+ * @param text The statement (null-terminated).
+ * @return The statement, or NULL if it did not parse.
+ */
+static Node* parse_text(const char* text) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement = NULL;
+
+    lexer_init(&lexer, text);
+    parser_init(&parser, &lexer);
+    if (!parse_next_statement(&parser, &statement) || parser.had_error) {
+        free_node(statement);
+        statement = NULL;
+    }
+    parser_free(&parser);
+    return statement;
+}
+
+/**
+ * Add the statements of a script that parse and serialize to the corpus.
+ *
+ * @param corpus The corpus.
+ * @param source The script.
+ * @param length Length of the script in bytes.
+ */
+static void add_script(Corpus* corpus, const char* source, size_t length) {
+    StatementSpan* spans;
+    size_t         span_count = split_statements(source, length, false, &spans);
+
+    for (size_t i = 0; i < span_count; i++) {
+        char* text = (char*)checked_malloc(spans[i].length + 1);
+        memcpy(text, spans[i].start, spans[i].length);
+        text[spans[i].length] = '\0';
+
+        Node*          statement = parse_text(text);
+        SerializedAST* ast       = statement ? ast_serialize(statement, NULL) : NULL;
+        free_node(statement);
+        if (!ast) {
+            free(text);
+            continue;
+        }
+
+        if (corpus->count == corpus->capacity) {
+            corpus->capacity   = corpus->capacity > 0 ? corpus->capacity * 2 : 64;
+            corpus->texts      = (char**)realloc(corpus->texts, corpus->capacity * sizeof(char*));
+            corpus->blobs      = (void**)realloc(corpus->blobs, corpus->capacity * sizeof(void*));
+            corpus->blob_sizes = (size_t*)realloc(corpus->blob_sizes,
+                                                  corpus->capacity * sizeof(size_t));
+            if (!corpus->texts || !corpus->blobs || !corpus->blob_sizes) {
+                fprintf(stderr, "Error: Out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        size_t      size;
+        const void* data = ast_get_data(ast, &size);
+        void*       blob = checked_malloc(size);
+        memcpy(blob, data, size);
+        ast_free(ast);
+
+        corpus->texts[corpus->count]      = text;
+        corpus->blobs[corpus->count]      = blob;
+        corpus->blob_sizes[corpus->count] = size;
+        corpus->count++;
+        corpus->text_bytes += spans[i].length;
+        corpus->binary_bytes += size;
+    }
+    free(spans);
+}
+
+/**
+ * Time parsing every statement text.
+ *
+ * @param corpus The corpus.
+ * @param iterations Passes over the corpus.
+ * @return The elapsed time in seconds.
+ */
+static double bench_parse(const Corpus* corpus, int iterations) {
+    double start = now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < corpus->count; i++) {
+            free_node(parse_text(corpus->texts[i]));
+        }
+    }
+    return now() - start;
+}
+
+/**
+ * Time decoding every blob in place with AstReader.
+ *
+ * @param corpus The corpus.
+ * @param iterations Passes over the corpus.
+ * @return The elapsed time in seconds.
+ */
+static double bench_reader(const Corpus* corpus, int iterations) {
+    double start = now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < corpus->count; i++) {
+            AstReader reader;
+            if (!ast_reader_init(&reader, corpus->blobs[i], corpus->blob_sizes[i], true)) {
+                fprintf(stderr, "Error: Statement %zu does not decode\n", i);
+                exit(EXIT_FAILURE);
+            }
+            free_node(ast_reader_materialize(&reader, ast_reader_root(&reader)));
+        }
+    }
+    return now() - start;
+}
+
+/**
+ * Time decoding every blob through a SerializedAST handle.
+ *
+ * @param corpus The corpus.
+ * @param iterations Passes over the corpus.
+ * @return The elapsed time in seconds.
+ */
+static double bench_deserialize(const Corpus* corpus, int iterations) {
+    double start = now();
+    for (int it = 0; it < iterations; it++) {
+        for (size_t i = 0; i < corpus->count; i++) {
+            SerializedAST* ast = ast_deserialize(corpus->blobs[i], corpus->blob_sizes[i]);
+            free_node(ast_decode(ast));
+            ast_free(ast);
+        }
+    }
+    return now() - start;
+}
+
+/**
+ * Print the throughput of one benchmark.
+ *
+ * @param name The benchmark name.
+ * @param corpus The corpus.
+ * @param iterations Passes over the corpus.
+ * @param seconds The elapsed time.
+ * @param bytes Input bytes per pass.
+ */
+static void report(const char* name, const Corpus* corpus, int iterations, double seconds,
+                   size_t bytes) {
+    double statements = (double)corpus->count * iterations;
+    printf("%-24s %10.0f ns/stmt %12.0f stmt/s %10.1f MB/s\n", name, seconds * 1e9 / statements,
+           statements / seconds, (double)bytes * iterations / seconds / 1e6);
+}
+
+int main(int argc, char** argv) {
+    int    iterations = DEFAULT_ITERATIONS;
+    Corpus corpus;
+    memset(&corpus, 0, sizeof(corpus));
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            continue;
+        }
+
+        size_t length;
+        char*  source = read_file(argv[i], &length);
+        if (!source) {
+            fprintf(stderr, "Error: Cannot read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        add_script(&corpus, source, length);
+        free(source);
+    }
+
+    if (corpus.count == 0 || iterations <= 0) {
+        fprintf(stderr, "Usage: %s [-n iterations] script.nsql...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu statements, %zu bytes of text, %zu bytes serialized, %d iterations\n",
+           corpus.count, corpus.text_bytes, corpus.binary_bytes, iterations);
+
+    double parse  = bench_parse(&corpus, iterations);
+    double reader = bench_reader(&corpus, iterations);
+    double decode = bench_deserialize(&corpus, iterations);
+    report("parse", &corpus, iterations, parse, corpus.text_bytes);
+    report("ast_reader_materialize", &corpus, iterations, reader, corpus.binary_bytes);
+    report("ast_deserialize+decode", &corpus, iterations, decode, corpus.binary_bytes);
+    printf("decode speedup over parse: %.2fx (reader), %.2fx (deserialize)\n", parse / reader,
+           parse / decode);
+
+    for (size_t i = 0; i < corpus.count; i++) {
+        free(corpus.texts[i]);
+        free(corpus.blobs[i]);
+    }
+    free(corpus.texts);
+    free(corpus.blobs);
+    free(corpus.blob_sizes);
+    return EXIT_SUCCESS;
+}
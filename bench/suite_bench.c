@@ -0,0 +1,830 @@
+/**
+ * @file suite_bench.c
+ * @brief Throughput of the lexer, parser, serializer and printers on real and synthetic corpora
+ *
+ * Each corpus is a script: the files named on the command line, plus generated scripts that
+ * stress one dimension each (wide field lists, deeply nested expressions, long OR chains, long
+ * string literals and a 100k-statement script). Every corpus is run through:
+ *
+ *   lex          lexer_next_token() over the whole script
+ *   parse        parse_next_statement(), and so parse_query(), over the whole script
+ *   serialize    ast_serialize() of every statement
+ *   deserialize  ast_deserialize() of every serialized statement
+ *   print_json   every node of every statement printed into a buffer as nested JSON, through
+ *                ast_emit_events() and ast_printer_event_sink()
+ *
+ * MB/s is measured against the input of a stage: the script text for lex and parse, the
+ * serialized bytes for serialize and deserialize, and the printed bytes for the printers. Each
+ * benchmark repeats whole passes until it has run for the minimum time. The formats of
+ * ast_printer_print() are not timed, since they print only part of each tree (the root in JSON,
+ * the expressions in text) and XML and DOT are not implemented.
+ *
+ * -w switches to worst-case mode, which measures what invalid input costs the parser instead. The
+ * scripts named, and generated inputs that each provoke one kind of error recovery (cascading
+ * errors, tokens skipped looking for a query keyword, lexer errors, nesting past max_depth and
+ * unterminated lists and strings), are parsed into an arena as the processor does, once without
+ * limits (parse_worst) and once with WORST_MAX_TOKENS, WORST_MAX_NODES and WORST_MAX_ERRORS
+ * (parse_limited). Each reports the time and memory per input byte, the memory being what the
+ * arena and the error list hold at the end of a pass.
+ *
+ * Usage: nsql_suite_bench [-t seconds] [-f text|json] [-o results.jsonl] [-q] [-w] script.nsql...
+ *
+ * -f json prints one JSON object per benchmark and line instead of a table; -o appends the same
+ * lines to a file so results can be tracked over time. -q skips the synthetic corpora.
+ */
+
+#include <nsql/arena.h>
+#include <nsql/ast_events.h>
+#include <nsql/ast_printer.h>
+#include <nsql/ast_serializer.h>
+#include <nsql/parser.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Default minimum run time of each benchmark, in seconds
+#define DEFAULT_MIN_TIME 0.25
+
+// Shapes of the generated corpora
+#define WIDE_STATEMENTS 200     // Statements with a wide field list
+#define WIDE_FIELDS 512         // Fields in each of them
+#define DEEP_STATEMENTS 500     // Statements with a deeply nested condition
+#define DEEP_NESTING 100        // Parentheses around each (below NSQL_MAX_EXPRESSION_DEPTH)
+#define OR_STATEMENTS 20        // Statements with a long OR chain
+#define OR_TERMS 5000           // Terms in each chain
+#define STRING_STATEMENTS 64    // Statements with a long string literal
+#define STRING_LENGTH 65536     // Length of each literal
+#define SCRIPT_STATEMENTS 100000  // Statements in the large script
+
+// Worst-case mode
+#define WORST_BYTES (1 << 20)   // Size of each generated input
+#define WORST_MAX_TOKENS 65536  // Parser limits of parse_limited
+#define WORST_MAX_NODES 65536
+#define WORST_MAX_ERRORS 100
+
+// Growable text, for generating corpora
+typedef struct {
+    char*  data;
+    size_t length;
+    size_t capacity;
+} Text;
+
+// A script and its statements in both forms
+typedef struct {
+    const char* name;          // Corpus name in the results
+    char*       source;        // The script (null-terminated)
+    size_t      length;        // Length of the script in bytes
+    Node**      statements;    // Statements that parsed
+    void**      blobs;         // Serialized statements
+    size_t*     blob_sizes;    // Size of each blob
+    size_t      count;         // Number of statements
+    size_t      binary_bytes;  // Total size of the blobs
+} Corpus;
+
+// Output settings
+typedef struct {
+    bool  json;     // Print JSON lines instead of a table
+    FILE* results;  // Also append JSON lines here (may be NULL)
+} Output;
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param ptr Existing allocation to resize (NULL to allocate).
+ * @param size The size in bytes.
+ * @return The allocation.
+ */
+static void* checked_realloc(void* ptr, size_t size) {
+    void* result = realloc(ptr, size > 0 ? size : 1);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Get a wall-clock time stamp.
+ *
+ * @return The time in seconds.
+ */
+static double now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Make room for more text.
+ *
+ * @param text The text.
+ * @param extra Bytes about to be appended, not counting the null terminator.
+ */
+static void reserve(Text* text, size_t extra) {
+    if (text->length + extra < text->capacity)
+        return;
+
+    text->capacity = text->capacity > 0 ? text->capacity * 2 : 4096;
+    while (text->length + extra >= text->capacity) {
+        text->capacity *= 2;
+    }
+    text->data = (char*)checked_realloc(text->data, text->capacity);
+}
+
+/**
+ * Append formatted text.
+ *
+ * @param text The text.
+ * @param format printf format.
+ */
+static void append(Text* text, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0) {
+        fprintf(stderr, "Error: Cannot format corpus\n");
+        exit(EXIT_FAILURE);
+    }
+
+    reserve(text, (size_t)needed);
+    va_start(args, format);
+    vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+    va_end(args);
+    text->length += (size_t)needed;
+}
+
+/**
+ * Generate statements with wide field lists.
+ *
+ * @param text Receives the script.
+ */
+static void generate_wide(Text* text) {
+    for (int s = 0; s < WIDE_STATEMENTS; s++) {
+        append(text, "ASK users FOR f0");
+        for (int f = 1; f < WIDE_FIELDS; f++) {
+            append(text, ", f%d", f);
+        }
+        append(text, " WHERE id = %d;\n", s);
+    }
+}
+
+/**
+ * Generate statements with deeply nested arithmetic.
+ *
+ * @param text Receives the script.
+ */
+static void generate_deep(Text* text) {
+    for (int s = 0; s < DEEP_STATEMENTS; s++) {
+        append(text, "ASK accounts FOR balance WHERE balance > ");
+        for (int d = 0; d < DEEP_NESTING; d++) {
+            append(text, "(");
+        }
+        append(text, "%d", s);
+        for (int d = 0; d < DEEP_NESTING; d++) {
+            append(text, d % 2 == 0 ? " + %d)" : " * %d)", d);
+        }
+        append(text, ";\n");
+    }
+}
+
+/**
+ * Generate statements with long OR chains.
+ *
+ * @param text Receives the script.
+ */
+static void generate_or_chain(Text* text) {
+    for (int s = 0; s < OR_STATEMENTS; s++) {
+        append(text, "ASK orders FOR id WHERE customer = 0");
+        for (int t = 1; t < OR_TERMS; t++) {
+            append(text, " OR customer = %d", t);
+        }
+        append(text, ";\n");
+    }
+}
+
+/**
+ * Generate statements with long string literals.
+ *
+ * @param text Receives the script.
+ */
+static void generate_long_strings(Text* text) {
+    char* literal = (char*)checked_realloc(NULL, STRING_LENGTH + 1);
+    for (int i = 0; i < STRING_LENGTH; i++) {
+        literal[i] = (char)('a' + i % 26);
+    }
+    literal[STRING_LENGTH] = '\0';
+
+    for (int s = 0; s < STRING_STATEMENTS; s++) {
+        append(text, "ASK documents FOR title WHERE body = '%s';\n", literal);
+    }
+    free(literal);
+}
+
+/**
+ * Generate a long script of everyday statements.
+ *
+ * @param text Receives the script.
+ */
+static void generate_script(Text* text) {
+    for (int s = 0; s < SCRIPT_STATEMENTS; s++) {
+        switch (s % 4) {
+            case 0:
+                append(text, "ASK users FOR name, email WHERE id = %d;\n", s);
+                break;
+            case 1:
+                append(text, "TELL users TO UPDATE status = 'active' WHERE id = %d;\n", s);
+                break;
+            case 2:
+                append(text, "FIND o IN orders WHERE o.total > %d AND o.status = 'open';\n", s);
+                break;
+            default:
+                append(text, "SHOW name, price FROM products WHERE price < %d.5 LIMIT 10;\n", s);
+                break;
+        }
+    }
+}
+
+/**
+ * Fill a worst-case input with copies of a piece of text.
+ *
+ * @param text Receives the input.
+ * @param unit The text to repeat.
+ */
+static void generate_repeated(Text* text, const char* unit) {
+    size_t length = strlen(unit);
+    while (text->length + length <= WORST_BYTES) {
+        append(text, "%s", unit);
+    }
+}
+
+/**
+ * Generate statements that fail at every clause, each failure reported separately.
+ *
+ * @param text Receives the input.
+ */
+static void generate_error_cascade(Text* text) {
+    generate_repeated(text, "ASK ");
+}
+
+/**
+ * Generate input without a query keyword, which error recovery skips token by token.
+ *
+ * @param text Receives the input.
+ */
+static void generate_no_keyword(Text* text) {
+    generate_repeated(text, "status = 'open' AND total > 10 ");
+}
+
+/**
+ * Generate characters the lexer rejects.
+ *
+ * @param text Receives the input.
+ */
+static void generate_bad_chars(Text* text) {
+    generate_repeated(text, "@ ");
+}
+
+/**
+ * Generate statements nested one level deeper than the parser accepts.
+ *
+ * @param text Receives the input.
+ */
+static void generate_too_deep(Text* text) {
+    Text unit = {NULL, 0, 0};
+    append(&unit, "ASK t FOR a WHERE ");
+    for (int d = 0; d <= NSQL_MAX_EXPRESSION_DEPTH; d++) {
+        append(&unit, "(");
+    }
+    append(&unit, ";\n");
+    generate_repeated(text, unit.data);
+    free(unit.data);
+}
+
+/**
+ * Generate statements whose lists end early.
+ *
+ * @param text Receives the input.
+ */
+static void generate_open_lists(Text* text) {
+    generate_repeated(text, "ASK t FOR a, b WHERE c IN (1, 2,;\n");
+}
+
+/**
+ * Generate a string literal that is never closed.
+ *
+ * @param text Receives the input.
+ */
+static void generate_open_string(Text* text) {
+    append(text, "ASK t FOR a WHERE b = '");
+    reserve(text, WORST_BYTES);
+    memset(text->data + text->length, 'x', WORST_BYTES - text->length);
+    text->length             = WORST_BYTES;
+    text->data[text->length] = '\0';
+}
+
+/**
+ * Read a whole file.
+ *
+ * @param path The file to read.
+ * @param length Receives the length of the contents.
+ * @return The null-terminated contents, or NULL if the file cannot be read.
+ */
+static char* read_file(const char* path, size_t* length) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    Text   text = {NULL, 0, 0};
+    size_t read;
+    do {
+        reserve(&text, 4096);
+        read = fread(text.data + text.length, 1, text.capacity - text.length - 1, file);
+        text.length += read;
+    } while (read > 0);
+    fclose(file);
+
+    text.data[text.length] = '\0';
+    *length                = text.length;
+    return text.data;
+}
+
+/**
+ * Parse and serialize the statements of a corpus's script.
+ *
+ * Statements with errors are left out of the serialize, deserialize and print benchmarks.
+ *
+ * @param corpus The corpus, with its name and source set.
+ */
+static void load_corpus(Corpus* corpus) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+    size_t capacity = 0;
+
+    lexer_init(&lexer, corpus->source);
+    parser_init(&parser, &lexer);
+    while (parse_next_statement(&parser, &statement)) {
+        if (statement == NULL)
+            continue;
+
+        SerializedAST* ast = ast_serialize(statement, NULL);
+        if (!ast) {
+            free_node(statement);
+            continue;
+        }
+
+        if (corpus->count == capacity) {
+            capacity           = capacity > 0 ? capacity * 2 : 64;
+            corpus->statements = (Node**)checked_realloc(corpus->statements,
+                                                         capacity * sizeof(Node*));
+            corpus->blobs      = (void**)checked_realloc(corpus->blobs, capacity * sizeof(void*));
+            corpus->blob_sizes = (size_t*)checked_realloc(corpus->blob_sizes,
+                                                          capacity * sizeof(size_t));
+        }
+
+        size_t      size;
+        const void* data = ast_get_data(ast, &size);
+        void*       blob = checked_realloc(NULL, size);
+        memcpy(blob, data, size);
+        ast_free(ast);
+
+        corpus->statements[corpus->count] = statement;
+        corpus->blobs[corpus->count]      = blob;
+        corpus->blob_sizes[corpus->count] = size;
+        corpus->binary_bytes += size;
+        corpus->count++;
+    }
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+/**
+ * Release a corpus.
+ *
+ * @param corpus The corpus.
+ */
+static void free_corpus(Corpus* corpus) {
+    for (size_t i = 0; i < corpus->count; i++) {
+        free_node(corpus->statements[i]);
+        free(corpus->blobs[i]);
+    }
+    free(corpus->statements);
+    free(corpus->blobs);
+    free(corpus->blob_sizes);
+    free(corpus->source);
+}
+
+/**
+ * Report the result of one benchmark.
+ *
+ * @param output Output settings.
+ * @param corpus The corpus.
+ * @param bench The benchmark name.
+ * @param passes Passes over the corpus.
+ * @param seconds The elapsed time.
+ * @param bytes Input bytes per pass.
+ * @param items Items processed per pass (statements, or tokens for the lexer).
+ */
+static void report(const Output* output, const Corpus* corpus, const char* bench, int passes,
+                   double seconds, size_t bytes, size_t items) {
+    double statements = (double)corpus->count * passes;
+    double mb_per_s   = (double)bytes * passes / seconds / 1e6;
+    double queries    = statements / seconds;
+    double items_s    = (double)items * passes / seconds;
+
+    char line[512];
+    snprintf(line, sizeof(line),
+             "{\"corpus\":\"%s\",\"bench\":\"%s\",\"statements\":%zu,\"bytes\":%zu,"
+             "\"passes\":%d,\"seconds\":%.6f,\"mb_per_s\":%.2f,\"queries_per_s\":%.0f,"
+             "\"items_per_s\":%.0f}",
+             corpus->name, bench, corpus->count, bytes, passes, seconds, mb_per_s, queries,
+             items_s);
+
+    if (output->json)
+        printf("%s\n", line);
+    else
+        printf("%-14s %-16s %10.1f MB/s %12.0f queries/s %9.0f ns/stmt\n", corpus->name, bench,
+               mb_per_s, queries, seconds * 1e9 / statements);
+    if (output->results)
+        fprintf(output->results, "%s\n", line);
+}
+
+/**
+ * Lex a whole script once.
+ *
+ * @param corpus The corpus.
+ * @return The number of tokens.
+ */
+static size_t lex_pass(const Corpus* corpus) {
+    Lexer  lexer;
+    size_t tokens = 0;
+
+    lexer_init(&lexer, corpus->source);
+    while (lexer_next_token(&lexer).type != TOKEN_EOF) {
+        tokens++;
+    }
+    lexer_free(&lexer);
+    return tokens;
+}
+
+/**
+ * Parse a whole script once.
+ *
+ * @param corpus The corpus.
+ */
+static void parse_pass(const Corpus* corpus) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+
+    lexer_init(&lexer, corpus->source);
+    parser_init(&parser, &lexer);
+    while (parse_next_statement(&parser, &statement)) {
+        free_node(statement);
+    }
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+/**
+ * Serialize every statement once.
+ *
+ * @param corpus The corpus.
+ */
+static void serialize_pass(const Corpus* corpus) {
+    for (size_t i = 0; i < corpus->count; i++) {
+        ast_free(ast_serialize(corpus->statements[i], NULL));
+    }
+}
+
+/**
+ * Deserialize every statement once.
+ *
+ * @param corpus The corpus.
+ */
+static void deserialize_pass(const Corpus* corpus) {
+    for (size_t i = 0; i < corpus->count; i++) {
+        SerializedAST* ast = ast_deserialize(corpus->blobs[i], corpus->blob_sizes[i]);
+        if (!ast) {
+            fprintf(stderr, "Error: Statement %zu of %s does not deserialize\n", i, corpus->name);
+            exit(EXIT_FAILURE);
+        }
+        ast_free(ast);
+    }
+}
+
+/**
+ * Print every node of every statement once, through the JSON event sink.
+ *
+ * The buffer is grown to the size of any statement that did not fit, so only the first pass may
+ * reprint.
+ *
+ * @param corpus The corpus.
+ * @param buffer The output buffer, grown as needed.
+ * @param capacity Size of the buffer.
+ * @return The number of bytes printed.
+ */
+static size_t print_pass(const Corpus* corpus, char** buffer, size_t* capacity) {
+    size_t printed = 0;
+    for (size_t i = 0; i < corpus->count; i++) {
+        for (;;) {
+            AstPrinter   printer;
+            AstEventSink sink;
+            ast_printer_init_buffer(&printer, AST_FORMAT_JSON, *buffer, *capacity);
+            ast_printer_event_sink(&printer, &sink);
+            ast_emit_events(corpus->statements[i], &sink);
+            size_t required = ast_printer_get_required(&printer);
+            ast_printer_free(&printer);
+
+            if (required < *capacity) {
+                printed += required;
+                break;
+            }
+            *capacity = required + 1;
+            *buffer   = (char*)checked_realloc(*buffer, *capacity);
+        }
+    }
+    return printed;
+}
+
+/**
+ * Run every benchmark on a corpus.
+ *
+ * @param output Output settings.
+ * @param corpus The corpus.
+ * @param min_time Minimum run time of each benchmark in seconds.
+ */
+static void run_corpus(const Output* output, const Corpus* corpus, double min_time) {
+    double start;
+    int    passes;
+    size_t tokens = 0;
+
+    for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+        tokens = lex_pass(corpus);
+    }
+    report(output, corpus, "lex", passes, now() - start, corpus->length, tokens);
+
+    for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+        parse_pass(corpus);
+    }
+    report(output, corpus, "parse", passes, now() - start, corpus->length, corpus->count);
+
+    for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+        serialize_pass(corpus);
+    }
+    report(output, corpus, "serialize", passes, now() - start, corpus->binary_bytes,
+           corpus->count);
+
+    for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+        deserialize_pass(corpus);
+    }
+    report(output, corpus, "deserialize", passes, now() - start, corpus->binary_bytes,
+           corpus->count);
+
+    // Size the buffer first so that the timed passes never reprint
+    size_t capacity = 1 << 16;
+    char*  buffer   = (char*)checked_realloc(NULL, capacity);
+    size_t printed  = print_pass(corpus, &buffer, &capacity);
+    for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+        print_pass(corpus, &buffer, &capacity);
+    }
+    report(output, corpus, "print_json", passes, now() - start, printed, corpus->count);
+    free(buffer);
+}
+
+/**
+ * Load a corpus and run the benchmarks on it.
+ *
+ * @param output Output settings.
+ * @param name Corpus name.
+ * @param source The script, owned by the function from here on.
+ * @param length Length of the script in bytes.
+ * @param min_time Minimum run time of each benchmark in seconds.
+ */
+static void bench_script(const Output* output, const char* name, char* source, size_t length,
+                         double min_time) {
+    Corpus corpus;
+    memset(&corpus, 0, sizeof(corpus));
+    corpus.name   = name;
+    corpus.source = source;
+    corpus.length = length;
+
+    load_corpus(&corpus);
+    if (corpus.count == 0) {
+        fprintf(stderr, "Warning: No statement of %s parses, skipping it\n", name);
+    } else {
+        run_corpus(output, &corpus, min_time);
+    }
+    free_corpus(&corpus);
+}
+
+/**
+ * Generate a corpus and run the benchmarks on it.
+ *
+ * @param output Output settings.
+ * @param name Corpus name.
+ * @param generate The generator.
+ * @param min_time Minimum run time of each benchmark in seconds.
+ */
+static void bench_generated(const Output* output, const char* name, void (*generate)(Text*),
+                            double min_time) {
+    Text text = {NULL, 0, 0};
+    generate(&text);
+    bench_script(output, name, text.data, text.length, min_time);
+}
+
+/**
+ * Parse an input once the way the processor does, into an arena.
+ *
+ * @param source The input.
+ * @param length Length of the input in bytes.
+ * @param limited Whether to apply the WORST_MAX_* limits.
+ * @param errors Receives the number of errors reported.
+ * @param memory Receives the bytes held by the arena and the error list.
+ */
+static void parse_worst_pass(const char* source, size_t length, bool limited, int* errors,
+                             size_t* memory) {
+    NsqlArena arena;
+    Lexer     lexer;
+    Parser    parser;
+    Node*     statement;
+
+    arena_init(&arena, 0);
+    lexer_init_n(&lexer, source, length);
+    parser_init_with_arena(&parser, &lexer, &arena);
+    if (limited) {
+        parser.max_tokens = WORST_MAX_TOKENS;
+        parser.max_nodes  = WORST_MAX_NODES;
+        parser.max_errors = WORST_MAX_ERRORS;
+    }
+    while (parse_next_statement(&parser, &statement)) {
+    }
+
+    *errors = parser.errors.error_count;
+    *memory = arena_size(&arena) +
+              (size_t)(parser.errors.error_count + parser.errors.warning_count) *
+                  sizeof(ErrorReport);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    arena_free(&arena);
+}
+
+/**
+ * Measure what parsing an input costs per byte, without and with limits.
+ *
+ * @param output Output settings.
+ * @param name Corpus name.
+ * @param source The input, owned by the function from here on.
+ * @param length Length of the input in bytes.
+ * @param min_time Minimum run time of each benchmark in seconds.
+ */
+static void bench_worst_case(const Output* output, const char* name, char* source, size_t length,
+                             double min_time) {
+    static const char* const benches[] = {"parse_worst", "parse_limited"};
+
+    for (int limited = 0; limited < 2; limited++) {
+        double start;
+        int    passes;
+        int    errors = 0;
+        size_t memory = 0;
+
+        for (start = now(), passes = 0; passes == 0 || now() - start < min_time; passes++) {
+            parse_worst_pass(source, length, limited, &errors, &memory);
+        }
+        double seconds         = now() - start;
+        double ns_per_byte     = length > 0 ? seconds * 1e9 / passes / (double)length : 0;
+        double memory_per_byte = length > 0 ? (double)memory / (double)length : 0;
+
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "{\"corpus\":\"%s\",\"bench\":\"%s\",\"bytes\":%zu,\"passes\":%d,"
+                 "\"seconds\":%.6f,\"ns_per_byte\":%.2f,\"memory_per_byte\":%.2f,"
+                 "\"errors\":%d}",
+                 name, benches[limited], length, passes, seconds, ns_per_byte, memory_per_byte,
+                 errors);
+
+        if (output->json)
+            printf("%s\n", line);
+        else
+            printf("%-14s %-16s %10.2f ns/byte %10.2f bytes/byte %10d errors\n", name,
+                   benches[limited], ns_per_byte, memory_per_byte, errors);
+        if (output->results)
+            fprintf(output->results, "%s\n", line);
+    }
+    free(source);
+}
+
+/**
+ * Get the corpus name of a script path, its file name without the extension.
+ *
+ * @param path The path (modified in place).
+ * @return The name.
+ */
+static const char* corpus_name(char* path) {
+    char* name = path;
+    for (char* p = path; *p; p++) {
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    }
+    char* dot = strrchr(name, '.');
+    if (dot && dot != name)
+        *dot = '\0';
+    return name;
+}
+
+int main(int argc, char** argv) {
+    double min_time  = DEFAULT_MIN_TIME;
+    bool   synthetic = true;
+    bool   worst     = false;
+    Output output    = {false, NULL};
+    int    scripts   = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            output.json = strcmp(argv[++i], "json") == 0;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output.results = fopen(argv[++i], "a");
+            if (!output.results) {
+                fprintf(stderr, "Error: Cannot open %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "-q") == 0) {
+            synthetic = false;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            worst = true;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr,
+                    "Usage: %s [-t seconds] [-f text|json] [-o results.jsonl] [-q] [-w] "
+                    "script.nsql...\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (!output.json && worst)
+        printf("%-14s %-16s %18s %21s %17s\n", "corpus", "bench", "time", "memory", "errors");
+    else if (!output.json)
+        printf("%-14s %-16s %15s %22s %17s\n", "corpus", "bench", "throughput", "rate",
+               "latency");
+
+    // Scripts named on the command line come first
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-f") == 0 ||
+            strcmp(argv[i], "-o") == 0) {
+            i++;
+            continue;
+        }
+        if (argv[i][0] == '-')
+            continue;
+
+        size_t length;
+        char*  source = read_file(argv[i], &length);
+        if (!source) {
+            fprintf(stderr, "Error: Cannot read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (worst)
+            bench_worst_case(&output, corpus_name(argv[i]), source, length, min_time);
+        else
+            bench_script(&output, corpus_name(argv[i]), source, length, min_time);
+        scripts++;
+    }
+
+    if (synthetic && worst) {
+        static const struct {
+            const char* name;
+            void (*generate)(Text*);
+        } inputs[] = {
+            {"error_cascade", generate_error_cascade},
+            {"no_keyword", generate_no_keyword},
+            {"bad_chars", generate_bad_chars},
+            {"too_deep", generate_too_deep},
+            {"open_lists", generate_open_lists},
+            {"open_string", generate_open_string},
+        };
+        for (size_t k = 0; k < sizeof(inputs) / sizeof(inputs[0]); k++) {
+            Text text = {NULL, 0, 0};
+            inputs[k].generate(&text);
+            bench_worst_case(&output, inputs[k].name, text.data, text.length, min_time);
+        }
+    } else if (synthetic) {
+        bench_generated(&output, "wide_fields", generate_wide, min_time);
+        bench_generated(&output, "deep_exprs", generate_deep, min_time);
+        bench_generated(&output, "or_chain", generate_or_chain, min_time);
+        bench_generated(&output, "long_strings", generate_long_strings, min_time);
+        bench_generated(&output, "script_100k", generate_script, min_time);
+    } else if (scripts == 0) {
+        fprintf(stderr, "Error: -q needs at least one script\n");
+        return EXIT_FAILURE;
+    }
+
+    if (output.results)
+        fclose(output.results);
+    return EXIT_SUCCESS;
+}
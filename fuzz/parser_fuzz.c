@@ -0,0 +1,198 @@
+/**
+ * @file parser_fuzz.c
+ * @brief Fuzz target for the lexer, the parser and the serializer round trip
+ *
+ * The first byte of an input selects how the parser is set up and the rest is the script:
+ *
+ *   bit 0  Keywords match regardless of case
+ *   bit 1  The tree is allocated from an arena
+ *   bit 2  Zero-copy strings (only with an arena, as in the processor)
+ *
+ * The lexer reads the script in place with lexer_init_n(), so reads past its end are caught by
+ * the sanitizers. The parser runs with the FUZZ_MAX_* limits, which bound the time and memory of
+ * any input. Every statement that parses is serialized, deserialized, decoded and serialized again,
+ * and the target aborts if the two blobs differ or a step of the round trip fails.
+ *
+ * Built with Clang this is a libFuzzer target (NSQL_LIBFUZZER). Otherwise main() runs the target
+ * on each file named on the command line, or on stdin without arguments, which is what AFL
+ * expects when the target is built with afl-clang-fast or afl-gcc:
+ *
+ *   nsql_parser_fuzz -max_len=65536 corpus/ ../samples/   (libFuzzer)
+ *   afl-fuzz -i seeds -o findings -- nsql_parser_fuzz @@   (AFL)
+ */
+
+#include <nsql/arena.h>
+#include <nsql/ast_serializer.h>
+#include <nsql/parser.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Parser limits for fuzzed input
+#define FUZZ_MAX_TOKENS 100000
+#define FUZZ_MAX_NODES 100000
+#define FUZZ_MAX_ERRORS 1000
+
+// Configuration bits of the first input byte
+#define FUZZ_CASE_INSENSITIVE 0x01
+#define FUZZ_ARENA 0x02
+#define FUZZ_ZERO_COPY 0x04
+
+/**
+ * Abort with a message, so the fuzzer records the input.
+ *
+ * @param message What went wrong.
+ */
+static void fail(const char* message) {
+    fprintf(stderr, "Fuzz target failed: %s\n", message);
+    abort();
+}
+
+/**
+ * Check that a statement survives a serialization round trip.
+ *
+ * @param statement The statement.
+ */
+static void check_round_trip(Node* statement) {
+    SerializedAST* first = ast_serialize(statement, NULL);
+    if (!first)
+        fail("ast_serialize() rejected a parsed statement");
+
+    size_t         size;
+    const void*    data    = ast_get_data(first, &size);
+    SerializedAST* decoded = ast_deserialize(data, size);
+    if (!decoded)
+        fail("ast_deserialize() rejected a serialized statement");
+    if (!ast_verify_checksum(decoded))
+        fail("checksum mismatch");
+
+    Node* tree = ast_decode(decoded);
+    if (!tree)
+        fail("ast_decode() rejected a serialized statement");
+
+    SerializedAST* second = ast_serialize(tree, NULL);
+    if (!second)
+        fail("ast_serialize() rejected a decoded statement");
+
+    size_t      second_size;
+    const void* second_data = ast_get_data(second, &second_size);
+    if (second_size != size || memcmp(second_data, data, size) != 0)
+        fail("the decoded statement serializes differently");
+
+    ast_free(second);
+    free_node(tree);
+    ast_free(decoded);
+    ast_free(first);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size == 0)
+        return 0;
+
+    uint8_t     config = data[0];
+    const char* source = (const char*)data + 1;
+    size_t      length = size - 1;
+    bool        arena  = (config & FUZZ_ARENA) != 0;
+
+    NsqlArena storage;
+    Lexer     lexer;
+    Parser    parser;
+    Node*     statement;
+
+    arena_init(&storage, 0);
+    lexer_init_n(&lexer, source, length);
+    lexer.case_insensitive = (config & FUZZ_CASE_INSENSITIVE) != 0;
+    parser_init_with_arena(&parser, &lexer, arena ? &storage : NULL);
+    parser.zero_copy  = arena && (config & FUZZ_ZERO_COPY) != 0;
+    parser.max_tokens = FUZZ_MAX_TOKENS;
+    parser.max_nodes  = FUZZ_MAX_NODES;
+    parser.max_errors = FUZZ_MAX_ERRORS;
+
+    while (parse_next_statement(&parser, &statement)) {
+        if (statement == NULL)
+            continue;
+        check_round_trip(statement);
+        if (!arena)
+            free_node(statement);
+    }
+
+    if (parser.errors.error_count > FUZZ_MAX_ERRORS + 1)
+        fail("more errors than max_errors allows");
+    if (parser.token_count > FUZZ_MAX_TOKENS || parser.node_count > FUZZ_MAX_NODES + 1)
+        fail("limits exceeded");
+
+    char message[256];
+    parser_format_errors(&parser, message, sizeof(message));
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+    arena_free(&storage);
+    return 0;
+}
+
+#ifndef NSQL_LIBFUZZER
+/**
+ * Run the target on one input.
+ *
+ * @param file The input.
+ * @return false if the input cannot be read.
+ */
+static bool run_file(FILE* file) {
+    size_t   capacity = 4096;
+    size_t   size     = 0;
+    uint8_t* data     = (uint8_t*)malloc(capacity);
+    size_t   read;
+
+    while (data && (read = fread(data + size, 1, capacity - size, file)) > 0) {
+        size += read;
+        if (size == capacity) {
+            capacity *= 2;
+            uint8_t* grown = (uint8_t*)realloc(data, capacity);
+            if (!grown)
+                free(data);
+            data = grown;
+        }
+    }
+    if (!data) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ferror(file)) {
+        free(data);
+        return false;
+    }
+
+    // The target gets a copy of exactly the input's size, so that reads past the end of it are
+    // caught as they are under libFuzzer instead of landing in the spare capacity
+    uint8_t* input = (uint8_t*)malloc(size > 0 ? size : 1);
+    if (!input) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(input, data, size);
+    free(data);
+
+    LLVMFuzzerTestOneInput(input, size);
+    free(input);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return run_file(stdin) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    for (int i = 1; i < argc; i++) {
+        FILE* file = fopen(argv[i], "rb");
+        bool  ok   = file && run_file(file);
+        if (file)
+            fclose(file);
+        if (!ok) {
+            fprintf(stderr, "Error: Cannot read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,111 @@
+/**
+ * @file arena.h
+ * @brief Bump-pointer arena allocator for per-parse AST storage
+ */
+
+#ifndef NSQL_ARENA_H
+#define NSQL_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Default size of a single arena chunk in bytes
+ */
+#define NSQL_ARENA_DEFAULT_CHUNK_SIZE 16384
+
+// Forward declare chunk structure (private to arena.c)
+typedef struct NsqlArenaChunk NsqlArenaChunk;
+
+/**
+ * Arena allocator state
+ *
+ * Memory is handed out from large chunks by bumping a pointer. Individual allocations are never
+ * freed; the whole arena is recycled with arena_reset() or released with arena_free().
+ */
+typedef struct {
+    NsqlArenaChunk* first;       // First chunk in the chunk list
+    NsqlArenaChunk* current;     // Chunk currently being allocated from
+    void*           last_alloc;  // Most recent allocation (can be grown in place)
+    size_t          chunk_size;  // Size of regular chunks
+} NsqlArena;
+
+/**
+ * Initialize an arena
+ *
+ * No memory is allocated until the first call to arena_alloc().
+ *
+ * @param arena The arena to initialize
+ * @param chunk_size Size of each chunk in bytes (0 for NSQL_ARENA_DEFAULT_CHUNK_SIZE)
+ */
+void arena_init(NsqlArena* arena, size_t chunk_size);
+
+/**
+ * Allocate memory from an arena
+ *
+ * The returned memory is suitably aligned for any type and is not zeroed.
+ *
+ * @param arena The arena to allocate from
+ * @param size Number of bytes to allocate
+ * @return Pointer to the allocated memory, or NULL if out of memory
+ */
+void* arena_alloc(NsqlArena* arena, size_t size);
+
+/**
+ * Grow an allocation previously returned by the arena
+ *
+ * If ptr is the most recent allocation and the current chunk has room, the block is extended in
+ * place. Otherwise a new block is allocated and the old contents are copied.
+ *
+ * @param arena The arena that owns ptr
+ * @param ptr The allocation to grow (NULL behaves like arena_alloc())
+ * @param old_size The current size of the allocation
+ * @param new_size The requested size of the allocation
+ * @return Pointer to the resized allocation, or NULL if out of memory
+ */
+void* arena_realloc(NsqlArena* arena, void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * Copy a string into the arena
+ *
+ * @param arena The arena to allocate from
+ * @param str The characters to copy (need not be null-terminated)
+ * @param length Number of characters to copy
+ * @return Null-terminated copy of the string, or NULL if out of memory
+ */
+char* arena_strndup(NsqlArena* arena, const char* str, size_t length);
+
+/**
+ * Release every allocation made from the arena while keeping its chunks for reuse
+ *
+ * @param arena The arena to reset
+ */
+void arena_reset(NsqlArena* arena);
+
+/**
+ * Get the memory an arena holds
+ *
+ * Chunks kept for reuse by arena_reset() are included, so this is what the arena costs rather than
+ * what is in use.
+ *
+ * @param arena The arena
+ * @return Bytes of chunk memory, chunk headers included
+ */
+size_t arena_size(const NsqlArena* arena);
+
+/**
+ * Free all memory owned by the arena
+ *
+ * @param arena The arena to free
+ */
+void arena_free(NsqlArena* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_ARENA_H */
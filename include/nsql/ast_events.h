@@ -0,0 +1,95 @@
+/**
+ * @file ast_events.h
+ * @brief Event output of parsed ASTs
+ *
+ * The functions here describe a tree that has already been parsed to an AstEventSink. Each node
+ * produces an enter event, one field event per scalar value (names, literal values, operators,
+ * counts), the events of its children, and a leave event. Consumers that only forward the AST,
+ * such as a JSON log writer (see ast_printer_event_sink()), handle events instead of Node
+ * pointers.
+ *
+ * The parser does not emit events itself, so the tree is always built first; to bound memory on
+ * long scripts, call ast_emit_events() from a parse_program_stream() callback.
+ */
+
+#ifndef NSQL_AST_EVENTS_H
+#define NSQL_AST_EVENTS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A node entered or left
+ */
+typedef struct {
+    NodeType type;      // Node type
+    int      line;      // Source line
+    int      depth;     // Number of ancestors
+    int      slot;      // Child slot of the node in its parent (0 for the root)
+    int      index;     // Position among the children the parent has sent so far (0 for the root)
+    int      children;  // Number of children sent (leave events only, 0 in enter events)
+} AstEventNode;
+
+/**
+ * Value type of a field
+ */
+typedef enum {
+    AST_FIELD_STRING,    // string and length
+    AST_FIELD_NUMBER,    // number
+    AST_FIELD_INTEGER,   // integer
+    AST_FIELD_BOOLEAN,   // integer, 0 or 1
+    AST_FIELD_OPERATOR,  // integer, the NsqlTokenType of the operator
+} AstFieldType;
+
+/**
+ * A scalar value of the node entered last
+ *
+ * The field names are those of the JSON printer: "name", "value", "literalType", "operator",
+ * "count" and "index", plus "dataType", "constraint", "message", "limit", "offset" (or
+ * "limitParameter" and "offsetParameter" for ? placeholders) and "ascending" for the children of
+ * ORDER BY.
+ */
+typedef struct {
+    const char*  name;     // Field name
+    AstFieldType type;     // Which of the values below is set
+    const char*  string;   // String value, not null-terminated (valid during the callback)
+    size_t       length;   // Length of string in bytes
+    double       number;   // Numeric literal value
+    int64_t      integer;  // Integer, boolean or operator value
+} AstField;
+
+/**
+ * Event callbacks
+ *
+ * Each callback returns true to continue, false to stop. Callbacks left NULL are skipped.
+ */
+typedef struct {
+    bool (*enter)(const AstEventNode* node, void* user_data);  // Before the fields of a node
+    bool (*field)(const AstField* field, void* user_data);     // For each field of the node
+    bool (*leave)(const AstEventNode* node, void* user_data);  // After the children of a node
+    void* user_data;                                           // Passed through to the callbacks
+} AstEventSink;
+
+/**
+ * Send the events of a tree to a sink
+ *
+ * Empty child slots produce no events. Like ast_visit(), the walk keeps its state on the heap
+ * rather than the C stack and exits the process if that allocation fails.
+ *
+ * @param root Root of the tree (NULL sends nothing)
+ * @param sink The callbacks
+ * @return false if a callback stopped the walk, true otherwise
+ */
+bool ast_emit_events(const Node* root, const AstEventSink* sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_AST_EVENTS_H */
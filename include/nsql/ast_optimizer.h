@@ -0,0 +1,54 @@
+/**
+ * @file ast_optimizer.h
+ * @brief Constant folding and simplification of ASTs before serialization
+ *
+ * ast_optimize() rewrites a tree so that executors do not evaluate per row what is known when the
+ * query is parsed, and so that equivalent conditions serialize to the same plan:
+ *
+ * - Arithmetic on integer literals is folded, as in `credit_limit + 500 * 2`. Results must fit in
+ *   an int, and division is only folded when it is exact, so the result does not depend on whether
+ *   an executor divides integers as integers. Decimal arithmetic is left to the executor, since a
+ *   double does not hold sums such as 0.1 + 0.2 exactly.
+ * - Comparisons of two integer literals, and = and != on two string literals, become the integer
+ *   literal 1 or 0, the value NSQL conditions treat as true or false.
+ * - NOT of a numeric literal is folded, and NOT NOT x becomes x where only the truth of x matters.
+ * - AND and OR operands with a known value are removed. An operand that decides the result, such
+ *   as a false operand of AND, replaces the whole chain, unless the chain holds a ? placeholder,
+ *   and a condition that is always true is dropped from its query.
+ * - Comparisons with a literal on the left are turned around (`5 < age` becomes `age > 5`), so the
+ *   constant always comes last. + and * are only turned around when the other operand is known to
+ *   be a number, such as `2 * (a - b)`, since `5 + name` may join strings.
+ *
+ * The operands of AND and OR are never reordered, and ? placeholders are never moved or removed,
+ * so parameter indexes keep their meaning and every placeholder can be bound.
+ */
+
+#ifndef NSQL_AST_OPTIMIZER_H
+#define NSQL_AST_OPTIMIZER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Simplify a tree in place
+ *
+ * The root keeps its address. Nodes that are folded away are freed, unless the tree was allocated
+ * from an arena, in which case they are left to it. The walk is iterative, like ast_visit(), so
+ * long operator chains do not use C stack.
+ *
+ * @param root Root of the tree (a statement, a program or an expression; NULL does nothing)
+ * @param in_arena Whether the tree was built with parser_init_with_arena()
+ * @return The number of rewrites made
+ */
+size_t ast_optimize(Node* root, bool in_arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_AST_OPTIMIZER_H */
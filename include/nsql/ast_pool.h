@@ -0,0 +1,190 @@
+/**
+ * @file ast_pool.h
+ * @brief Compact, contiguous representation of ASTs
+ *
+ * A pool holds trees as one array of small fixed-size nodes that refer to their children by
+ * 32-bit index, with the child lists in a second array and all strings in a third. Nodes are
+ * stored in preorder, so walking a tree is a forward scan of the node array and freeing it is a
+ * single call. Trees are copied in from the pointer-based Node form with ast_pool_add() and back
+ * out with ast_pool_to_node().
+ */
+
+#ifndef NSQL_AST_POOL_H
+#define NSQL_AST_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Index of a node in a pool
+ */
+typedef uint32_t NodeIndex;
+
+/**
+ * Index of an absent child (and offset of an absent string)
+ */
+#define NODE_INDEX_NONE UINT32_MAX
+
+/**
+ * Pooled AST node
+ *
+ * Every node type takes 16 bytes. Nodes with children own a run of slots in AstPool.slots, each
+ * the index of a child or NODE_INDEX_NONE:
+ *
+ * - Queries, NODE_JOIN, NODE_GROUP_BY, the actions with fixed children, NODE_BINARY_EXPR,
+ *   NODE_UNARY_EXPR and NODE_CONSTRAINT: one slot per child, in the order of the Node fields
+ * - NODE_SOURCE: the identifier, then the join
+ * - NODE_FIELD_LIST, NODE_CREATE_ACTION, NODE_PROGRAM and NODE_LOGICAL_EXPR: one slot per entry
+ * - NODE_IN_LIST: the value, then the items
+ * - NODE_ORDER_BY: one slot per field, then one word per 32 fields with bit i set if field i
+ *   sorts ascending
+ * - NODE_UPDATE_ACTION: each field followed by its value
+ * - NODE_FIELD_DEF: the name, then the constraints, then one word holding the offset of the type
+ * - NODE_FUNCTION_CALL: the arguments, then one word holding the offset of the name
+ *
+ * children.count does not include the trailing words. Strings are null-terminated and live in
+ * AstPool.strings. The descendants of a node follow it in the node array in slot order, which is
+ * also the order ast_serialize() writes them in.
+ */
+typedef struct {
+    uint8_t  type;   // NodeType
+    uint8_t  op;     // Operator, literal type or constraint type
+    uint16_t flags;  // NODE_FLAG_* bits (never NODE_FLAG_BORROWED, the pool owns its strings)
+    int32_t  line;   // Source line
+    union {
+        struct {
+            uint32_t first;  // First slot in AstPool.slots
+            uint32_t count;  // Number of child slots
+        } children;
+
+        struct {
+            uint32_t offset;  // Offset in AstPool.strings (NODE_INDEX_NONE for NULL)
+            uint32_t length;  // Length in bytes
+        } string;  // NODE_IDENTIFIER, NODE_ERROR and string literals
+
+        double number;  // Numeric literals
+
+        struct {
+            int32_t limit;   // Row count, or LIMIT_PARAMETER(index)
+            int32_t offset;  // Rows to skip, or LIMIT_PARAMETER(index)
+        } limit;
+
+        int32_t parameter;  // Parameter index of a NODE_PARAMETER
+    } as;
+} FlatNode;
+
+/**
+ * Pool of ASTs
+ */
+typedef struct {
+    FlatNode*  nodes;            // Nodes of every tree, each tree in preorder
+    size_t     node_count;       // Number of nodes in use
+    size_t     node_capacity;    // Allocated nodes
+    uint32_t*  slots;            // Child slots and the words that follow them
+    size_t     slot_count;       // Number of slots in use
+    size_t     slot_capacity;    // Allocated slots
+    char*      strings;          // Null-terminated strings
+    size_t     string_size;      // Bytes of strings in use
+    size_t     string_capacity;  // Allocated bytes of strings
+} AstPool;
+
+/**
+ * Initialize an empty pool
+ *
+ * No memory is allocated until the first tree is added.
+ *
+ * @param pool The pool to initialize (free with ast_pool_free())
+ */
+void ast_pool_init(AstPool* pool);
+
+/**
+ * Remove every tree from a pool while keeping its memory for reuse
+ *
+ * @param pool The pool to reset
+ */
+void ast_pool_reset(AstPool* pool);
+
+/**
+ * Free all memory owned by a pool
+ *
+ * @param pool The pool to free
+ */
+void ast_pool_free(AstPool* pool);
+
+/**
+ * Copy a tree into a pool
+ *
+ * The tree is left untouched and can be freed right away; the pool copies its strings.
+ *
+ * @param pool The pool to add to
+ * @param node Root of the tree
+ * @return Index of the copied root, or NODE_INDEX_NONE if node is NULL or the pool would outgrow
+ *         32-bit indices
+ */
+NodeIndex ast_pool_add(AstPool* pool, const Node* node);
+
+/**
+ * Build a Node tree from a pooled tree
+ *
+ * @param pool The pool
+ * @param root Index of the root
+ * @return The tree (free with free_node()), or NULL if root is not a node of the pool
+ */
+Node* ast_pool_to_node(const AstPool* pool, NodeIndex root);
+
+/**
+ * Find the end of a pooled tree
+ *
+ * @param pool The pool
+ * @param root Index of the root
+ * @return Index one past the last descendant of root
+ */
+NodeIndex ast_pool_end(const AstPool* pool, NodeIndex root);
+
+/**
+ * Get a child slot of a pooled node
+ *
+ * @param pool The pool
+ * @param node The node (must have children)
+ * @param slot The slot, below node->as.children.count
+ * @return Index of the child, or NODE_INDEX_NONE if it is absent
+ */
+static inline NodeIndex ast_pool_child(const AstPool* pool, const FlatNode* node, uint32_t slot) {
+    return pool->slots[node->as.children.first + slot];
+}
+
+/**
+ * Get a string of a pool
+ *
+ * @param pool The pool
+ * @param offset Offset of the string
+ * @return The null-terminated string, or NULL if offset is NODE_INDEX_NONE
+ */
+static inline const char* ast_pool_string(const AstPool* pool, uint32_t offset) {
+    return offset == NODE_INDEX_NONE ? NULL : pool->strings + offset;
+}
+
+/**
+ * Get the sort direction of a field of a pooled NODE_ORDER_BY
+ *
+ * @param pool The pool
+ * @param node The NODE_ORDER_BY node
+ * @param field The field, below node->as.children.count
+ * @return true if the field sorts ascending
+ */
+static inline bool ast_pool_ascending(const AstPool* pool, const FlatNode* node, uint32_t field) {
+    uint32_t word = pool->slots[node->as.children.first + node->as.children.count + field / 32];
+    return (word >> (field % 32)) & 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_AST_POOL_H */
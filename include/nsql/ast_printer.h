@@ -1,123 +1,203 @@
-/**
- * @file ast_printer.h
- * @brief AST printing utilities for NSQL
- */
-
-#ifndef NSQL_AST_PRINTER_H
-#define NSQL_AST_PRINTER_H
-
-#include <nsql/ast.h>
-#include <stddef.h>
-#include <stdio.h>
-
-/**
- * Output format for AST printing
- */
-typedef enum {
-    AST_FORMAT_TEXT,  // Human-readable text format
-    AST_FORMAT_JSON,  // JSON format
-    AST_FORMAT_XML,   // XML format
-    AST_FORMAT_DOT    // GraphViz DOT format for visualization
-} AstOutputFormat;
-
-/**
- * Output type for AST printing
- */
-typedef enum {
-    AST_OUTPUT_FILE,     // Print to a file
-    AST_OUTPUT_BUFFER,   // Print to a memory buffer
-    AST_OUTPUT_CALLBACK  // Call a function for each node
-} AstOutputType;
-
-/**
- * Callback function type for AST printing
- *
- * @param node The node being processed
- * @param depth The depth of the node in the tree
- * @param user_data User data passed to the printer
- * @return true to continue traversal, false to stop
- */
-typedef bool (*AstPrintCallback)(const Node* node, int depth, void* user_data);
-
-/**
- * AST printer configuration
- */
-typedef struct {
-    AstOutputFormat format;
-    AstOutputType   type;
-    union {
-        FILE* file;  // For AST_OUTPUT_FILE
-        struct {
-            char*  buffer;  // For AST_OUTPUT_BUFFER
-            size_t size;
-            size_t written;
-        } buf;
-        struct {
-            AstPrintCallback fn;  // For AST_OUTPUT_CALLBACK
-            void*            user_data;
-        } callback;
-    } output;
-    int  indent_size;           // Number of spaces per indentation level
-    bool pretty_print;          // Whether to format with indentation and newlines
-    bool include_line_numbers;  // Whether to include line numbers in output
-} AstPrinter;
-
-/**
- * Initialize an AST printer for file output
- *
- * @param printer The printer to initialize
- * @param format The output format
- * @param file The file to write to (must be opened for writing)
- * @return true if initialization succeeded
- */
-bool ast_printer_init_file(AstPrinter* printer, AstOutputFormat format, FILE* file);
-
-/**
- * Initialize an AST printer for buffer output
- *
- * @param printer The printer to initialize
- * @param format The output format
- * @param buffer The buffer to write to
- * @param size The size of the buffer
- * @return true if initialization succeeded
- */
-bool ast_printer_init_buffer(AstPrinter* printer, AstOutputFormat format, char* buffer,
-                             size_t size);
-
-/**
- * Initialize an AST printer for callback output
- *
- * @param printer The printer to initialize
- * @param format The output format
- * @param callback The callback function
- * @param user_data User data to pass to the callback
- * @return true if initialization succeeded
- */
-bool ast_printer_init_callback(AstPrinter* printer, AstOutputFormat format,
-                               AstPrintCallback callback, void* user_data);
-
-/**
- * Print an AST node and its children
- *
- * @param printer The printer to use
- * @param node The node to print
- * @return true if printing succeeded
- */
-bool ast_printer_print(AstPrinter* printer, const Node* node);
-
-/**
- * Free any resources used by the printer
- *
- * @param printer The printer to free
- */
-void ast_printer_free(AstPrinter* printer);
-
-/**
- * Get the number of bytes written to the buffer
- *
- * @param printer The printer (must be initialized with ast_printer_init_buffer)
- * @return The number of bytes written, or 0 if the printer is not a buffer printer
- */
-size_t ast_printer_get_written(const AstPrinter* printer);
-
-#endif /* NSQL_AST_PRINTER_H */
+/**
+ * @file ast_printer.h
+ * @brief AST printing utilities for NSQL
+ */
+
+#ifndef NSQL_AST_PRINTER_H
+#define NSQL_AST_PRINTER_H
+
+#include <nsql/ast.h>
+#include <nsql/ast_events.h>
+#include <nsql/ast_pool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+// Bytes a file printer collects before writing them to the file
+#define AST_PRINTER_BLOCK_SIZE 4096
+
+/**
+ * Output format for AST printing
+ */
+typedef enum {
+    AST_FORMAT_TEXT,  // Human-readable text format
+    AST_FORMAT_JSON,  // JSON format
+    AST_FORMAT_XML,   // XML format
+    AST_FORMAT_DOT    // GraphViz DOT format for visualization
+} AstOutputFormat;
+
+/**
+ * Output type for AST printing
+ */
+typedef enum {
+    AST_OUTPUT_FILE,      // Print to a file, in blocks of AST_PRINTER_BLOCK_SIZE
+    AST_OUTPUT_BUFFER,    // Print to a fixed memory buffer
+    AST_OUTPUT_CALLBACK,  // Call a function for each node
+    AST_OUTPUT_DYNAMIC    // Print to a heap buffer that grows as needed
+} AstOutputType;
+
+/**
+ * Callback function type for AST printing
+ *
+ * @param node The node being processed
+ * @param depth The depth of the node in the tree
+ * @param user_data User data passed to the printer
+ * @return true to continue traversal, false to stop
+ */
+typedef bool (*AstPrintCallback)(const Node* node, int depth, void* user_data);
+
+/**
+ * AST printer configuration
+ */
+typedef struct {
+    AstOutputFormat format;
+    AstOutputType   type;
+    union {
+        FILE* file;  // For AST_OUTPUT_FILE
+        struct {
+            char*  buffer;  // For AST_OUTPUT_BUFFER
+            size_t size;
+            size_t written;
+            size_t required;  // Bytes the output needs, including any that did not fit
+        } buf;
+        struct {
+            char*  data;  // For AST_OUTPUT_DYNAMIC
+            size_t length;
+            size_t capacity;
+        } heap;
+        struct {
+            AstPrintCallback fn;  // For AST_OUTPUT_CALLBACK
+            void*            user_data;
+        } callback;
+    } output;
+    struct {
+        char*  data;  // Output not yet written to the file, only set while printing
+        size_t length;
+    } block;
+    int  indent_size;           // Number of spaces per indentation level
+    bool pretty_print;          // Whether to format with indentation and newlines
+    bool include_line_numbers;  // Whether to include line numbers in output
+} AstPrinter;
+
+/**
+ * Initialize an AST printer for file output
+ *
+ * @param printer The printer to initialize
+ * @param format The output format
+ * @param file The file to write to (must be opened for writing)
+ * @return true if initialization succeeded
+ */
+bool ast_printer_init_file(AstPrinter* printer, AstOutputFormat format, FILE* file);
+
+/**
+ * Initialize an AST printer for buffer output
+ *
+ * Output that does not fit is cut off, but still counted by ast_printer_get_required(). A NULL
+ * buffer with a size of 0 prints nothing, so a first pass can measure the size to allocate.
+ *
+ * @param printer The printer to initialize
+ * @param format The output format
+ * @param buffer The buffer to write to, NUL-terminated after every write
+ * @param size The size of the buffer
+ * @return true if initialization succeeded
+ */
+bool ast_printer_init_buffer(AstPrinter* printer, AstOutputFormat format, char* buffer,
+                             size_t size);
+
+/**
+ * Initialize an AST printer for output to a growing heap buffer
+ *
+ * The buffer is released by ast_printer_free() unless ast_printer_take_output() took it.
+ *
+ * @param printer The printer to initialize
+ * @param format The output format
+ * @return true if initialization succeeded
+ */
+bool ast_printer_init_dynamic(AstPrinter* printer, AstOutputFormat format);
+
+/**
+ * Initialize an AST printer for callback output
+ *
+ * @param printer The printer to initialize
+ * @param format The output format
+ * @param callback The callback function
+ * @param user_data User data to pass to the callback
+ * @return true if initialization succeeded
+ */
+bool ast_printer_init_callback(AstPrinter* printer, AstOutputFormat format,
+                               AstPrintCallback callback, void* user_data);
+
+/**
+ * Print an AST node and its children
+ *
+ * @param printer The printer to use
+ * @param node The node to print
+ * @return true if printing succeeded
+ */
+bool ast_printer_print(AstPrinter* printer, const Node* node);
+
+/**
+ * Print a tree held in an AstPool
+ *
+ * The output is the same as ast_printer_print() on the equivalent Node tree. The pooled nodes are
+ * printed by a linear scan instead of a tree walk. Callback printers are not supported.
+ *
+ * @param printer The printer to use (file or buffer output)
+ * @param pool The pool holding the tree
+ * @param root Index of the root node in the pool
+ * @return true if printing succeeded
+ */
+bool ast_printer_print_pool(AstPrinter* printer, const AstPool* pool, NodeIndex root);
+
+/**
+ * Set up an event sink that prints each tree it receives as one line of JSON
+ *
+ * Every node is printed as by the JSON format, with the fields of its events and a "children"
+ * array of the nodes below it, and each root ends a line, so sending each statement of a script
+ * writes it as JSON lines.
+ *
+ * Output goes straight to the file or buffer; file output is not collected in blocks.
+ *
+ * @param printer A JSON printer (file, buffer or dynamic output) that outlives the sink
+ * @param sink The sink to set up
+ * @return true if the sink was set up, false for other formats or callback output
+ */
+bool ast_printer_event_sink(AstPrinter* printer, AstEventSink* sink);
+
+/**
+ * Free any resources used by the printer
+ *
+ * @param printer The printer to free
+ */
+void ast_printer_free(AstPrinter* printer);
+
+/**
+ * Get the number of bytes written to the buffer
+ *
+ * @param printer The printer (initialized with ast_printer_init_buffer or ast_printer_init_dynamic)
+ * @return The number of bytes written, or 0 if the printer is not a buffer printer
+ */
+size_t ast_printer_get_written(const AstPrinter* printer);
+
+/**
+ * Get the size of the output of a buffer printer, including any output that did not fit
+ *
+ * A buffer of this size plus one for the NUL terminator holds the whole output.
+ *
+ * @param printer The printer (initialized with ast_printer_init_buffer or ast_printer_init_dynamic)
+ * @return The number of bytes printed, or 0 if the printer is not a buffer printer
+ */
+size_t ast_printer_get_required(const AstPrinter* printer);
+
+/**
+ * Take the output of a dynamic printer
+ *
+ * The printer starts over with an empty buffer.
+ *
+ * @param printer The printer (must be initialized with ast_printer_init_dynamic)
+ * @param length Receives the length of the output, if not NULL
+ * @return The NUL-terminated output, to be released with free(), or NULL if the printer is not a
+ *         dynamic printer
+ */
+char* ast_printer_take_output(AstPrinter* printer, size_t* length);
+
+#endif /* NSQL_AST_PRINTER_H */
@@ -0,0 +1,220 @@
+/**
+ * @file ast_reader.h
+ * @brief Zero-copy reader for serialized ASTs
+ *
+ * The reader works directly on a borrowed buffer, such as a network receive buffer or a
+ * memory-mapped plan file, without copying it or building a Node tree. Nodes are identified by
+ * their offset within the buffer's node data; use ast_reader_materialize() to obtain a Node tree
+ * when one is needed.
+ */
+
+#ifndef NSQL_AST_READER_H
+#define NSQL_AST_READER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <nsql/ast_serializer.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Offset returned for absent children
+ */
+#define AST_READER_NULL SIZE_MAX
+
+/**
+ * Reader over a serialized AST
+ *
+ * The reader borrows the buffer passed to ast_reader_init(), which must stay alive and unchanged
+ * while the reader and any views it returned are in use.
+ */
+typedef struct {
+    const unsigned char* nodes;          // Start of the node data
+    size_t               nodes_size;     // Size of the node data
+    const unsigned char* metadata;       // Start of the execution metadata
+    size_t               metadata_size;  // Size of the execution metadata
+    const unsigned char* strings;        // Start of the string table (version 3, else NULL)
+    size_t               strings_size;   // Size of the string table
+    uint32_t             version;        // Format version of the buffer
+} AstReader;
+
+/**
+ * Initialize a reader over a serialized AST
+ *
+ * Validates the header and the structure of every node, so the accessors below need no further
+ * bounds checks. Nothing is copied or allocated. Buffers of every version from AST_VERSION_1 to
+ * AST_VERSION are accepted; compressed buffers are not and have to go through ast_deserialize()
+ * first.
+ *
+ * @param reader The reader to initialize
+ * @param data The serialized data, as returned by ast_get_data()
+ * @param size Size of the data in bytes
+ * @param verify_checksum Whether to also verify the checksum
+ * @return true if the data is a valid serialized AST
+ */
+bool ast_reader_init(AstReader* reader, const void* data, size_t size, bool verify_checksum);
+
+/**
+ * Get the root node
+ *
+ * @param reader The reader
+ * @return Offset of the root node
+ */
+size_t ast_reader_root(const AstReader* reader);
+
+/**
+ * Get the type of a node
+ *
+ * @param reader The reader
+ * @param node Offset of the node
+ * @return The node type
+ */
+NodeType ast_reader_type(const AstReader* reader, size_t node);
+
+/**
+ * Get the line number of a node
+ *
+ * @param reader The reader
+ * @param node Offset of the node
+ * @return The line number
+ */
+int ast_reader_line(const AstReader* reader, size_t node);
+
+/**
+ * Get the number of child slots of a node
+ *
+ * Queries have one slot per clause in declaration order (see NodeData), some of which may be
+ * empty. Lists and programs have one slot per entry; update actions alternate fields and values,
+ * and field definitions have their name followed by their constraints. Sources have their join, if
+ * any. Logical expressions have one slot per operand, and IN lists their value followed by the
+ * items.
+ *
+ * @param reader The reader
+ * @param node Offset of the node
+ * @return The number of child slots
+ */
+size_t ast_reader_child_count(const AstReader* reader, size_t node);
+
+/**
+ * Get a child of a node
+ *
+ * Constant time for version 2 and later buffers, which store an offset for every child slot.
+ * Version 1 buffers have to skip the earlier siblings.
+ *
+ * @param reader The reader
+ * @param node Offset of the node
+ * @param index Index of the child slot
+ * @return Offset of the child, or AST_READER_NULL if the slot is empty or out of range
+ */
+size_t ast_reader_child(const AstReader* reader, size_t node, size_t index);
+
+/**
+ * Get the string of a node as a view into the buffer
+ *
+ * The string of an identifier is its name, of a string literal its value, of a source its name,
+ * of a field definition its type, of a function call its name and of an error its message.
+ *
+ * @param reader The reader
+ * @param node Offset of the node
+ * @param str Receives the start of the string (not null-terminated)
+ * @param length Receives the length of the string in bytes
+ * @return true if the node has a string
+ */
+bool ast_reader_string(const AstReader* reader, size_t node, const char** str, size_t* length);
+
+/**
+ * Get the type of a literal
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_LITERAL
+ * @return TOKEN_STRING, TOKEN_INTEGER or TOKEN_DECIMAL
+ */
+NsqlTokenType ast_reader_literal_type(const AstReader* reader, size_t node);
+
+/**
+ * Get the value of a numeric literal
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_LITERAL
+ * @return The value (0 for string literals)
+ */
+double ast_reader_number(const AstReader* reader, size_t node);
+
+/**
+ * Get the operator of an expression
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_BINARY_EXPR, NODE_UNARY_EXPR or NODE_LOGICAL_EXPR
+ * @return The operator token
+ */
+NsqlTokenType ast_reader_operator(const AstReader* reader, size_t node);
+
+/**
+ * Get the sort direction of an ORDER BY entry
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_ORDER_BY
+ * @param index Index of the entry
+ * @return true for ascending order
+ */
+bool ast_reader_ascending(const AstReader* reader, size_t node, size_t index);
+
+/**
+ * Get the counts of a LIMIT clause
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_LIMIT
+ * @param limit Receives the row count
+ * @param offset Receives the rows to skip
+ */
+void ast_reader_limit(const AstReader* reader, size_t node, int* limit, int* offset);
+
+/**
+ * Get the type of a constraint
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_CONSTRAINT
+ * @return The constraint type
+ */
+ConstraintType ast_reader_constraint_type(const AstReader* reader, size_t node);
+
+/**
+ * Get the index of a placeholder
+ *
+ * @param reader The reader
+ * @param node Offset of a NODE_PARAMETER
+ * @return The parameter index
+ */
+int ast_reader_parameter_index(const AstReader* reader, size_t node);
+
+/**
+ * Read the execution metadata
+ *
+ * The target index is returned as a view into the buffer, so metadata->target_index is not
+ * null-terminated and must not be freed.
+ *
+ * @param reader The reader
+ * @param metadata Receives the metadata
+ * @param target_index_length Receives the length of metadata->target_index (may be NULL)
+ */
+void ast_reader_metadata(const AstReader* reader, ExecutionMetadata* metadata,
+                         size_t* target_index_length);
+
+/**
+ * Build a Node tree from a serialized subtree
+ *
+ * @param reader The reader
+ * @param node Offset of the subtree root
+ * @return The tree (free with free_node()), or NULL if node is AST_READER_NULL
+ */
+Node* ast_reader_materialize(const AstReader* reader, size_t node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_AST_READER_H */
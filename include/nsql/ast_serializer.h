@@ -1,121 +1,285 @@
-#pragma once
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <stdbool.h>
-#include <stddef.h>
-#include <stdint.h>
-#include "ast.h"  // For Node
-
-// Format Constants
-#define AST_HEADER_SIZE 28
-#define AST_MAGIC_NUMBER 0x4E52514C  // "NSQL"
-#define AST_VERSION 0x0001
-
-// Engine types
-#define ENGINE_AUTO 0x00   // Auto-select engine
-#define ENGINE_SQL 0x01    // Use SQL engine
-#define ENGINE_NOSQL 0x02  // Use NoSQL engine
-
-// Execution hint flags
-#define HINT_PARALLEL_EXEC 0x0001  // Query can be parallelized
-#define HINT_INDEX_SCAN 0x0002     // Use an index scan
-#define HINT_FULL_SCAN 0x0004      // Use full table scan
-#define HINT_CACHE_RESULT 0x0008   // Cache query result
-#define HINT_PRIORITY_HIGH 0x0010  // High priority execution
-#define HINT_PRIORITY_LOW 0x0020   // Low priority execution
-#define HINT_READ_ONLY 0x0040      // Read-only query
-
-// Execution metadata
-typedef struct {
-    uint16_t    hint_flags;      // Execution hint flags
-    uint8_t     priority;        // 0-255 priority level (higher = more priority)
-    uint8_t     engine_type;     // Storage engine selection
-    uint32_t    estimated_rows;  // Estimated result row count
-    uint32_t    timeout_ms;      // Query timeout in milliseconds
-    const char* target_index;    // Index to use (if applicable)
-} ExecutionMetadata;
-
-// AST handle
-typedef struct SerializedAST SerializedAST;
-
-// =======================================================
-// Core Functions
-// =======================================================
-
-/**
- * Serialize an AST tree with accompanying execution metadata
- *
- * @param node Root node of the AST
- * @param metadata Execution metadata (NULL for default)
- * @return SerializedAST handle or NULL on failure
- */
-SerializedAST* ast_serialize(Node* node, const ExecutionMetadata* metadata);
-
-/**
- * Free a serialized AST
- *
- * @param ast The serialized AST to free
- */
-void ast_free(SerializedAST* ast);
-
-/**
- * Get raw binary data from serialized AST
- *
- * @param ast The serialized AST
- * @param size Pointer to store the size of the data
- * @return Pointer to binary data (do not free separately)
- */
-const void* ast_get_data(const SerializedAST* ast, size_t* size);
-
-/**
- * Deserialize AST from binary data
- *
- * @param data Binary serialized AST data
- * @param size Size of the data
- * @return SerializedData handle or NULL if invalid
- */
-SerializedAST* ast_deserialize(const void* data, size_t size);
-
-/**
- * Verify the checksum of a serialized AST
- *
- * @param ast The serialized AST
- * @return true if checksum is valid, false otherwise
- */
-bool ast_verify_checksum(const SerializedAST* ast);
-
-// =======================================================
-// Metadata Functions
-// =======================================================
-
-/**
- * Create default execution metadata for a query
- *
- * @param node Root node of the AST
- * @return ExecutionMetadata with optimal settings
- */
-ExecutionMetadata ast_create_metadata(const Node* node);
-
-/**
- * Extract execution metadata from serialized AST
- *
- * @param ast The serialized AST
- * @param metadata Pointer to store extracted metadata
- * @return true if successful, false otherwise
- */
-bool ast_extract_metadata(const SerializedAST* ast, ExecutionMetadata* metadata);
-
-/**
- * Determine if a query should use NoSQL storage engine
- *
- * @param node The AST node
- * @return true if query should use NoSQL, false if SQL
- */
-bool ast_is_nosql_query(const Node* node);
-
-#ifdef __cplusplus
-}
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"       // For Node
+#include "ast_pool.h"  // For AstPool
+
+// Format Constants
+#define AST_HEADER_SIZE 28
+#define AST_MAGIC_NUMBER 0x4E52514C  // "NSQL"
+#define AST_VERSION 0x0003
+#define AST_VERSION_1 0x0001  // Preorder node stream followed by the metadata, still readable
+#define AST_VERSION_2 0x0002  // Version 3 without the string table, still readable
+#define AST_METADATA_SIZE 16  // Fixed part of the metadata block after the header (version 2 on)
+
+// Checksum algorithms, recorded in the header word at offset 8
+#define AST_CHECKSUM_CRC32 0x00   // CRC-32 (IEEE 802.3), used by every version 1 blob
+#define AST_CHECKSUM_CRC32C 0x01  // CRC-32C (Castagnoli), hardware accelerated where available
+
+// Payload codecs, recorded in the header word at offset 24
+#define AST_CODEC_NONE 0x00  // Stored as is, used by every version 1 blob
+#define AST_CODEC_LZ4 0x01   // Node data in the LZ4 block format, the metadata block stays as is
+
+// Node data smaller than this is never compressed
+#ifndef AST_COMPRESS_THRESHOLD
+#define AST_COMPRESS_THRESHOLD 512
+#endif
+
+// Engine types
+#define ENGINE_AUTO 0x00   // Auto-select engine
+#define ENGINE_SQL 0x01    // Use SQL engine
+#define ENGINE_NOSQL 0x02  // Use NoSQL engine
+
+// Execution hint flags
+#define HINT_PARALLEL_EXEC 0x0001  // Query can be parallelized
+#define HINT_INDEX_SCAN 0x0002     // Use an index scan
+#define HINT_FULL_SCAN 0x0004      // Use full table scan
+#define HINT_CACHE_RESULT 0x0008   // Cache query result
+#define HINT_PRIORITY_HIGH 0x0010  // High priority execution
+#define HINT_PRIORITY_LOW 0x0020   // Low priority execution
+#define HINT_READ_ONLY 0x0040      // Read-only query
+
+// Execution metadata
+typedef struct {
+    uint16_t    hint_flags;      // Execution hint flags
+    uint8_t     priority;        // 0-255 priority level (higher = more priority)
+    uint8_t     engine_type;     // Storage engine selection
+    uint32_t    estimated_rows;  // Estimated result row count
+    uint32_t    timeout_ms;      // Query timeout in milliseconds
+    const char* target_index;    // Index to use (if applicable)
+} ExecutionMetadata;
+
+// AST handle
+typedef struct SerializedAST SerializedAST;
+
+// Value bound to a ? placeholder
+typedef struct {
+    NsqlTokenType type;          // TOKEN_STRING, TOKEN_INTEGER or TOKEN_DECIMAL
+    const char*   string_value;  // String bytes (TOKEN_STRING only, need not be null-terminated)
+    size_t        length;        // Length of string_value in bytes
+    double        number_value;  // Numeric value (TOKEN_INTEGER and TOKEN_DECIMAL only)
+} ParameterValue;
+
+// =======================================================
+// Core Functions
+// =======================================================
+
+/**
+ * Serialize an AST tree with accompanying execution metadata
+ *
+ * @param node Root node of the AST
+ * @param metadata Execution metadata (NULL for default)
+ * @return SerializedAST handle or NULL on failure
+ */
+SerializedAST* ast_serialize(Node* node, const ExecutionMetadata* metadata);
+
+/**
+ * Serialize a tree held in an AstPool
+ *
+ * Produces the same data as ast_serialize() on the equivalent Node tree. The pooled nodes are
+ * already in serialized order, so they are written by a linear scan instead of a tree walk.
+ *
+ * @param pool The pool
+ * @param root Index of the root node in the pool
+ * @param metadata Execution metadata (NULL for default)
+ * @return SerializedAST handle or NULL on failure
+ */
+SerializedAST* ast_pool_serialize(const AstPool* pool, NodeIndex root,
+                                  const ExecutionMetadata* metadata);
+
+/**
+ * Free a serialized AST
+ *
+ * @param ast The serialized AST to free
+ */
+void ast_free(SerializedAST* ast);
+
+/**
+ * Get raw binary data from serialized AST
+ *
+ * @param ast The serialized AST
+ * @param size Pointer to store the size of the data
+ * @return Pointer to binary data (do not free separately)
+ */
+const void* ast_get_data(const SerializedAST* ast, size_t* size);
+
+/**
+ * Compress a serialized AST for storage or transfer
+ *
+ * Only the node data is compressed, so ast_extract_metadata() still works on the result without
+ * decompressing it. Node data below AST_COMPRESS_THRESHOLD bytes, or that does not shrink, is
+ * stored uncompressed instead so that small queries pay no decompression cost. The result takes
+ * no parameters; bind them before compressing.
+ *
+ * @param ast A version 2 or later serialized AST that is not already compressed
+ * @param codec AST_CODEC_LZ4 (or AST_CODEC_NONE for a plain copy)
+ * @return A new SerializedAST handle or NULL on failure
+ */
+SerializedAST* ast_compress(const SerializedAST* ast, uint32_t codec);
+
+/**
+ * Deserialize AST from binary data
+ *
+ * Compressed data is decompressed after its checksum has been verified, so the handle always
+ * holds the uncompressed form.
+ *
+ * @param data Binary serialized AST data
+ * @param size Size of the data
+ * @return SerializedData handle or NULL if invalid
+ */
+SerializedAST* ast_deserialize(const void* data, size_t size);
+
+/**
+ * Decode a serialized AST back into a Node tree
+ *
+ * Every node type ast_serialize() accepts is decoded, NODE_PROGRAM included, so a plan can be
+ * cached as binary and reloaded without re-parsing. The structure is validated first, but the
+ * checksum is not; check ast_verify_checksum() for data from untrusted sources.
+ *
+ * @param ast The serialized AST (compressed data is decompressed by ast_deserialize())
+ * @return The tree (free with free_node()), or NULL if the data is invalid
+ */
+Node* ast_decode(const SerializedAST* ast);
+
+/**
+ * Verify the checksum of a serialized AST
+ *
+ * @param ast The serialized AST
+ * @return true if checksum is valid, false otherwise
+ */
+bool ast_verify_checksum(const SerializedAST* ast);
+
+// =======================================================
+// Metadata Functions
+// =======================================================
+
+/**
+ * Create default execution metadata for a query
+ *
+ * A condition that is a set of key lookups, such as an IN list or an OR of equalities, estimates
+ * one row per key, and hints parallel execution when there are many keys.
+ *
+ * @param node Root node of the AST
+ * @return ExecutionMetadata with optimal settings
+ */
+ExecutionMetadata ast_create_metadata(const Node* node);
+
+/**
+ * Extract execution metadata from serialized AST
+ *
+ * @param ast The serialized AST
+ * @param metadata Pointer to store extracted metadata
+ * @return true if successful, false otherwise
+ */
+bool ast_extract_metadata(const SerializedAST* ast, ExecutionMetadata* metadata);
+
+/**
+ * Determine if a query should use NoSQL storage engine
+ *
+ * @param node The AST node
+ * @return true if query should use NoSQL, false if SQL
+ */
+bool ast_is_nosql_query(const Node* node);
+
+// =======================================================
+// Parameter Functions
+// =======================================================
+
+/**
+ * Get the number of ? placeholders a serialized AST expects values for
+ *
+ * Only ASTs produced by ast_serialize() know their placeholders; deserialized ones report 0.
+ *
+ * @param ast The serialized AST
+ * @return The highest parameter index plus one
+ */
+size_t ast_parameter_count(const SerializedAST* ast);
+
+/**
+ * Bind values to the placeholders of a serialized AST
+ *
+ * Each NODE_PARAMETER becomes a NODE_LITERAL holding its value, and each LIMIT or OFFSET
+ * placeholder is overwritten with its count. The rest of the data is copied without being
+ * re-serialized, then the checksum is recomputed.
+ *
+ * @param ast The serialized AST returned by ast_serialize()
+ * @param values Value of each parameter, indexed by parameter number
+ * @param count Number of entries in values (at least ast_parameter_count())
+ * @param reuse A previous result whose storage is reused (NULL to allocate a new one)
+ * @return The bound AST (reuse, if given), or NULL if a value is missing or does not fit its
+ *         placeholder (LIMIT and OFFSET take non-negative integers)
+ */
+SerializedAST* ast_bind_parameters(const SerializedAST* ast, const ParameterValue* values,
+                                   size_t count, SerializedAST* reuse);
+
+// =======================================================
+// Batch Functions
+// =======================================================
+
+// Output buffer for ast_serialize_batch(), reusable across calls
+typedef struct {
+    void*  data;      // Serialized frames
+    size_t size;      // Bytes of data in use
+    size_t capacity;  // Bytes of data available
+    bool   fixed;     // Whether data is caller memory that cannot grow
+} AstBatchBuffer;
+
+/**
+ * Initialize a batch buffer that grows as needed
+ *
+ * @param buffer The buffer to initialize (free with ast_batch_buffer_free())
+ */
+void ast_batch_buffer_init(AstBatchBuffer* buffer);
+
+/**
+ * Initialize a batch buffer over caller-provided memory, such as a socket send buffer
+ *
+ * The buffer never grows; a batch that does not fit stops at the last AST that does.
+ *
+ * @param buffer The buffer to initialize
+ * @param memory The memory to serialize into (stays owned by the caller)
+ * @param capacity Size of the memory in bytes
+ */
+void ast_batch_buffer_init_fixed(AstBatchBuffer* buffer, void* memory, size_t capacity);
+
+/**
+ * Free the memory of a batch buffer (caller-provided memory is left alone)
+ *
+ * @param buffer The buffer to free
+ */
+void ast_batch_buffer_free(AstBatchBuffer* buffer);
+
+/**
+ * Serialize many ASTs into one buffer
+ *
+ * Each AST becomes a complete frame, exactly the data ast_serialize() would produce, written
+ * directly into the buffer after the previous one. Use ast_frame_size() to split the buffer, and
+ * ast_deserialize() or ast_reader_init() on each frame.
+ *
+ * @param roots Root nodes of the ASTs
+ * @param count Number of roots
+ * @param metadata Execution metadata for each root (NULL for default values)
+ * @param buffer The output buffer, overwritten from its start and grown if it is not fixed
+ * @return The number of ASTs serialized, less than count if one failed or did not fit
+ */
+size_t ast_serialize_batch(Node* const* roots, size_t count, const ExecutionMetadata* metadata,
+                           AstBatchBuffer* buffer);
+
+/**
+ * Get the size of the serialized AST at the start of a buffer
+ *
+ * @param data Serialized frames, as produced by ast_serialize_batch()
+ * @param size Size of the data in bytes
+ * @return Size of the first frame, or 0 if data does not start with a complete frame
+ */
+size_t ast_frame_size(const void* data, size_t size);
+
+#ifdef __cplusplus
+}
 #endif
\ No newline at end of file
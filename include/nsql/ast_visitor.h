@@ -0,0 +1,79 @@
+/**
+ * @file ast_visitor.h
+ * @brief Iterative depth-first traversal of ASTs
+ *
+ * ast_visit() walks a tree with an explicit stack instead of recursion, so the depth of the trees
+ * it handles is bounded by memory rather than by the C stack of the calling thread. Deeply nested
+ * trees such as machine-generated `-(-(-(...)))` expressions or long arithmetic chains are walked
+ * in constant C stack. free_node(), ast_clone(), ast_serialize() and the printers are built on it.
+ */
+
+#ifndef NSQL_AST_VISITOR_H
+#define NSQL_AST_VISITOR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <stdbool.h>
+
+/**
+ * What the walk does after a callback
+ */
+typedef enum {
+    AST_VISIT_CONTINUE,  // Visit the children of the node (from a pre callback) and carry on
+    AST_VISIT_SKIP,      // Do not visit the children of the node (post is still called)
+    AST_VISIT_STOP,      // End the walk
+} AstVisitAction;
+
+/**
+ * Where the walk is
+ */
+typedef struct {
+    Node* node;    // The node (NULL for an empty child slot when AstVisitor.visit_null is set)
+    Node* parent;  // Its parent (NULL for the root)
+    int   slot;    // Child slot of the node in its parent (0 for the root)
+    int   depth;   // Number of ancestors of the node
+} AstVisitFrame;
+
+/**
+ * Visitor callback
+ *
+ * @param frame The node and its position in the tree
+ * @param user_data Pointer passed through from AstVisitor.user_data
+ * @return What to do next
+ */
+typedef AstVisitAction (*AstVisitFn)(const AstVisitFrame* frame, void* user_data);
+
+/**
+ * Visitor
+ *
+ * The children of a node are its child slots in source order, which is also the order
+ * ast_serialize() writes them in. A post callback may free its node, since the walk is done with
+ * it and its children by then.
+ */
+typedef struct {
+    AstVisitFn pre;         // Called before the children of each node, in preorder (may be NULL)
+    AstVisitFn post;        // Called after the children of each node, in postorder (may be NULL)
+    void*      user_data;   // Passed through to the callbacks
+    bool       visit_null;  // Also visit empty child slots, as frames whose node is NULL
+} AstVisitor;
+
+/**
+ * Walk a tree depth-first
+ *
+ * Up to 32 pending nodes are kept on the C stack; deeper walks move the stack to the heap. Like
+ * the parser, the walk exits the process if that allocation fails.
+ *
+ * @param root Root of the tree (NULL visits nothing unless visitor->visit_null is set)
+ * @param visitor The callbacks
+ * @return false if a callback returned AST_VISIT_STOP, true otherwise
+ */
+bool ast_visit(Node* root, const AstVisitor* visitor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_AST_VISITOR_H */
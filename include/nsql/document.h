@@ -0,0 +1,103 @@
+/**
+ * @file document.h
+ * @brief Incremental re-parsing of an edited script, for editors and language servers
+ *
+ * An NsqlDocument holds the text of a script and the result of parsing each of its statements on
+ * its own. nsql_document_edit() applies a text change and parses again only the statements it
+ * touched: the text is split again (see split_statements()) from the start of the first statement
+ * containing the change, until a statement terminator past the change lines up with a terminator
+ * of the previous text. The statements outside that range keep their trees and errors. Those after
+ * the change are moved to their new offsets, and when the change added or removed lines the line
+ * numbers of their nodes and errors are shifted, which is a walk of each tree rather than a parse.
+ *
+ * Typing within one statement therefore costs a re-parse of that statement, however long the
+ * script. Opening a string literal or a >> comment can swallow the terminators after it, in which
+ * case every statement up to the next terminator that lines up again is parsed anew.
+ */
+
+#ifndef NSQL_DOCUMENT_H
+#define NSQL_DOCUMENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <nsql/error_reporter.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * One statement of a document
+ */
+typedef struct {
+    size_t        offset;     // Offset of the first character (leading whitespace and comments too)
+    size_t        length;     // Length up to and including the terminator
+    int           line;       // Line of the first character (1-based)
+    int           column;     // Column of the first character (0-based)
+    Node*         statement;  // The parsed statement, or NULL if it had errors
+    ErrorContext* errors;     // Reports of the statement (NULL if none were made)
+} NsqlDocumentStatement;
+
+/**
+ * A script kept parsed across edits
+ *
+ * Line and column numbers of nodes and error reports are relative to the whole text. The trees
+ * are owned by the document and stay valid until the edit that replaces or frees them; use
+ * ast_clone() to keep one longer.
+ */
+typedef struct {
+    char*                  text;                // The text (null-terminated)
+    size_t                 length;              // Length of text in bytes
+    size_t                 capacity;            // Allocated bytes of text
+    NsqlDocumentStatement* statements;          // Statements in source order
+    size_t                 count;               // Number of statements
+    size_t                 statement_capacity;  // Allocated entries in statements
+    bool                   case_insensitive;    // Match keywords regardless of case
+    size_t                 first_changed;       // Index of the first statement the last edit parsed
+    size_t                 changed_count;       // Statements the last edit parsed
+    size_t                 replaced_count;      // Statements of the previous text they replaced
+} NsqlDocument;
+
+/**
+ * Initialize a document and parse its text
+ *
+ * Like the parser, the document exits the process if it runs out of memory.
+ *
+ * @param document The document to initialize
+ * @param text The text (need not be null-terminated; it is copied)
+ * @param length Length of the text in bytes
+ * @param case_insensitive Whether to match keywords regardless of case
+ */
+void nsql_document_init(NsqlDocument* document, const char* text, size_t length,
+                        bool case_insensitive);
+
+/**
+ * Replace a range of the text and re-parse the statements it affects
+ *
+ * Afterwards first_changed, changed_count and replaced_count describe which statements were
+ * parsed again, so that a caller such as a language server only needs to refresh their
+ * diagnostics.
+ *
+ * @param document The document
+ * @param offset Offset of the range to replace
+ * @param removed Length of the range to replace (0 for an insertion)
+ * @param text The new text of the range (need not be null-terminated)
+ * @param length Length of the new text in bytes (0 for a deletion)
+ * @return false if the range lies outside the text, in which case nothing changes
+ */
+bool nsql_document_edit(NsqlDocument* document, size_t offset, size_t removed, const char* text,
+                        size_t length);
+
+/**
+ * Free a document's text, statements and error reports
+ *
+ * @param document The document to free
+ */
+void nsql_document_free(NsqlDocument* document);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_DOCUMENT_H */
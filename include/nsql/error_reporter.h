@@ -1,100 +1,176 @@
-/**
- * @file error_reporter.h
- * @brief Error reporting system for NSQL
- */
-
-#ifndef NSQL_ERROR_REPORTER_H
-#define NSQL_ERROR_REPORTER_H
-
-#include <stdbool.h>
-#include <stddef.h>
-
-/**
- * Error severity levels
- */
-typedef enum { ERROR_NONE, ERROR_WARNING, ERROR_ERROR, ERROR_FATAL } ErrorSeverity;
-
-/**
- * Error source types
- */
-typedef enum {
-    ERROR_SOURCE_LEXER,
-    ERROR_SOURCE_PARSER,
-    ERROR_SOURCE_SEMANTIC,
-    ERROR_SOURCE_RUNTIME,
-    ERROR_SOURCE_SYSTEM
-} ErrorSource;
-
-/**
- * Error report structure
- */
-typedef struct ErrorReport {
-    ErrorSeverity       severity;
-    ErrorSource         source;
-    int                 line;
-    int                 column;
-    const char*         message;
-    struct ErrorReport* next;  // For linked list of multiple errors
-} ErrorReport;
-
-/**
- * Error context structure
- */
-typedef struct {
-    ErrorReport* first_error;
-    ErrorReport* last_error;
-    int          error_count;
-    int          warning_count;
-    bool         has_error;
-    bool         has_fatal;
-} ErrorContext;
-
-/**
- * Initialize error context
- *
- * @param ctx The error context to initialize
- */
-void error_context_init(ErrorContext* ctx);
-
-/**
- * Free error context and all reports
- *
- * @param ctx The error context to free
- */
-void error_context_free(ErrorContext* ctx);
-
-/**
- * Report an error
- *
- * @param ctx The error context
- * @param severity The error severity
- * @param source The error source
- * @param line The line number where the error occurred
- * @param column The column number where the error occurred
- * @param message The error message
- * @return true if the report was added successfully
- */
-bool report_error(ErrorContext* ctx, ErrorSeverity severity, ErrorSource source, int line,
-                  int column, const char* message);
-
-/**
- * Format all errors in the context into a string
- *
- * @param ctx The error context
- * @param buffer The buffer to write to
- * @param size The size of the buffer
- * @return The number of bytes written (excluding null terminator)
- */
-size_t format_errors(const ErrorContext* ctx, char* buffer, size_t size);
-
-/**
- * Format all errors in the context into a string in JSON format
- *
- * @param ctx The error context
- * @param buffer The buffer to write to
- * @param size The size of the buffer
- * @return The number of bytes written (excluding null terminator)
- */
-size_t format_errors_json(const ErrorContext* ctx, char* buffer, size_t size);
-
-#endif /* NSQL_ERROR_REPORTER_H */
+/**
+ * @file error_reporter.h
+ * @brief Error reporting system for NSQL
+ */
+
+#ifndef NSQL_ERROR_REPORTER_H
+#define NSQL_ERROR_REPORTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Number of reports held by an error context in ring mode
+ */
+#ifndef NSQL_ERROR_RING_CAPACITY
+#define NSQL_ERROR_RING_CAPACITY 16
+#endif
+
+/**
+ * Bytes of message text each ring report can hold, longer messages are truncated
+ */
+#ifndef NSQL_ERROR_MESSAGE_CAPACITY
+#define NSQL_ERROR_MESSAGE_CAPACITY 128
+#endif
+
+/**
+ * Error severity levels
+ */
+typedef enum { ERROR_NONE, ERROR_WARNING, ERROR_ERROR, ERROR_FATAL } ErrorSeverity;
+
+/**
+ * Error source types
+ */
+typedef enum {
+    ERROR_SOURCE_LEXER,
+    ERROR_SOURCE_PARSER,
+    ERROR_SOURCE_SEMANTIC,
+    ERROR_SOURCE_RUNTIME,
+    ERROR_SOURCE_SYSTEM
+} ErrorSource;
+
+/**
+ * Error report structure
+ */
+typedef struct ErrorReport {
+    ErrorSeverity       severity;
+    ErrorSource         source;
+    int                 line;
+    int                 column;
+    const char*         message;
+    bool                owns_message;  // message was copied and lives as long as the report
+    struct ErrorReport* next;          // For linked list of multiple errors
+} ErrorReport;
+
+/**
+ * Error context structure
+ *
+ * By default reports are kept in a heap-allocated linked list with no limit. In ring mode (see
+ * error_context_use_ring()) they are stored in the fixed-capacity ring embedded in the context
+ * instead; once it is full each new report overwrites the oldest one. Messages that are copied go
+ * into storage of their ring slot rather than the heap, so ring mode never allocates. Use
+ * error_context_next() to walk the reports in either mode, and error_context_move() rather than
+ * assignment to hand the reports of a ring to another context.
+ */
+typedef struct {
+    ErrorReport* first_error;
+    ErrorReport* last_error;
+    int          error_count;
+    int          warning_count;
+    bool         has_error;
+    bool         has_fatal;
+    bool         use_ring;    // Store reports in ring instead of the linked list
+    size_t       ring_start;  // Index of the oldest report in ring
+    size_t       ring_count;  // Number of reports in ring
+    size_t       dropped;     // Reports overwritten because the ring was full
+    ErrorReport  ring[NSQL_ERROR_RING_CAPACITY];
+    char         ring_messages[NSQL_ERROR_RING_CAPACITY][NSQL_ERROR_MESSAGE_CAPACITY];
+} ErrorContext;
+
+/**
+ * Initialize error context
+ *
+ * @param ctx The error context to initialize
+ */
+void error_context_init(ErrorContext* ctx);
+
+/**
+ * Switch an error context to ring mode
+ *
+ * Reports already in the list are moved into the ring. In ring mode reporting never allocates
+ * memory: report_error() copies messages into the ring, truncated to NSQL_ERROR_MESSAGE_CAPACITY
+ * bytes including the terminator.
+ *
+ * @param ctx The error context
+ */
+void error_context_use_ring(ErrorContext* ctx);
+
+/**
+ * Move the reports of one error context to another
+ *
+ * Copies the context, pointing the messages held in the ring at the copy, and leaves the source
+ * empty in the same storage mode.
+ *
+ * @param to The context that receives the reports (its own reports must have been freed)
+ * @param from The context to move the reports from
+ */
+void error_context_move(ErrorContext* to, ErrorContext* from);
+
+/**
+ * Free error context and all reports
+ *
+ * @param ctx The error context to free
+ */
+void error_context_free(ErrorContext* ctx);
+
+/**
+ * Report an error
+ *
+ * @param ctx The error context
+ * @param severity The error severity
+ * @param source The error source
+ * @param line The line number where the error occurred
+ * @param column The column number where the error occurred
+ * @param message The error message
+ * @return true if the report was added successfully
+ */
+bool report_error(ErrorContext* ctx, ErrorSeverity severity, ErrorSource source, int line,
+                  int column, const char* message);
+
+/**
+ * Report an error whose message has static storage duration
+ *
+ * Like report_error(), but the message is referenced rather than copied, so it must outlive the
+ * context (string literals, for example).
+ *
+ * @param ctx The error context
+ * @param severity The error severity
+ * @param source The error source
+ * @param line The line number where the error occurred
+ * @param column The column number where the error occurred
+ * @param message The error message
+ * @return true if the report was added successfully
+ */
+bool report_error_static(ErrorContext* ctx, ErrorSeverity severity, ErrorSource source, int line,
+                         int column, const char* message);
+
+/**
+ * Iterate over the reports in a context, oldest first
+ *
+ * @param ctx The error context
+ * @param report The previous report (NULL to get the first one)
+ * @return The next report, or NULL when there are no more
+ */
+const ErrorReport* error_context_next(const ErrorContext* ctx, const ErrorReport* report);
+
+/**
+ * Format all errors in the context into a string
+ *
+ * @param ctx The error context
+ * @param buffer The buffer to write to
+ * @param size The size of the buffer
+ * @return The number of bytes written (excluding null terminator)
+ */
+size_t format_errors(const ErrorContext* ctx, char* buffer, size_t size);
+
+/**
+ * Format all errors in the context into a string in JSON format
+ *
+ * @param ctx The error context
+ * @param buffer The buffer to write to
+ * @param size The size of the buffer
+ * @return The number of bytes written (excluding null terminator)
+ */
+size_t format_errors_json(const ErrorContext* ctx, char* buffer, size_t size);
+
+#endif /* NSQL_ERROR_REPORTER_H */
@@ -1,85 +1,126 @@
-#pragma once
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-#include <stddef.h>
-
-typedef enum {
-    TOKEN_ASK,     // ASK
-    TOKEN_TELL,    // TELL
-    TOKEN_FIND,    // FIND
-    TOKEN_SHOW,    // SHOW
-    TOKEN_GET,     // GET
-    TOKEN_FOR,     // FOR
-    TOKEN_FROM,    // FROM
-    TOKEN_TO,      // TO
-    TOKEN_IF,      // IF
-    TOKEN_WHEN,    // WHEN
-    TOKEN_WHERE,   // WHERE
-    TOKEN_THAT,    // THAT
-    TOKEN_GROUP,   // GROUP
-    TOKEN_SORT,    // SORT
-    TOKEN_BY,      // BY
-    TOKEN_LIMIT,   // LIMIT
-    TOKEN_AND,     // AND
-    TOKEN_OR,      // OR
-    TOKEN_HAVING,  // HAVING
-    TOKEN_ORDER,   // ORDER
-    TOKEN_ADD,     // ADD
-    TOKEN_REMOVE,  // REMOVE
-    TOKEN_UPDATE,  // UPDATE
-    TOKEN_CREATE,  // CREATE
-    TOKEN_WITH,    // WITH
-    TOKEN_AS,      // AS
-    TOKEN_IN,      // IN
-    TOKEN_NOT,     // NOT
-    TOKEN_WHICH,   // WHICH
-
-    // Operators
-    TOKEN_PLUS,     // +
-    TOKEN_MINUS,    // -
-    TOKEN_STAR,     // *
-    TOKEN_SLASH,    // /
-    TOKEN_PERCENT,  // %
-    TOKEN_EQUAL,    // =
-    TOKEN_GT,       // >
-    TOKEN_LT,       //
-    TOKEN_GTE,      // >=
-    TOKEN_LTE,      // <=
-    TOKEN_NEQ,      // !=
-    TOKEN_LIKE,     // LIKE
-
-    // Literals and others
-    TOKEN_IDENTIFIER,  // Names
-    TOKEN_STRING,      // String literals
-    TOKEN_INTEGER,     // Integer literals
-    TOKEN_DECIMAL,     // Decimal literals
-    TOKEN_COMMA,       // ,
-    TOKEN_LPAREN,      // (
-    TOKEN_RPAREN,      // )
-    TOKEN_EOF,         // End of input
-    TOKEN_ERROR,       // Error token
-    TOKEN_TERMINATOR   // ; or PLEASE (depending on how polite you are)
-} NsqlTokenType;
-
-typedef struct {
-    NsqlTokenType type;
-    const char*   start;
-    size_t        length;
-    int           line;
-} Token;
-
-typedef struct {
-    const char* start;
-    const char* current;
-    int         line;
-} Lexer;
-
-void        lexer_init(Lexer* lexer, const char* source);
-Token       lexer_next_token(Lexer* lexer);
-const char* lexer_get_line_start(Lexer* lexer, int line);
-
-#ifdef __cplusplus
-}
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    TOKEN_ASK,     // ASK
+    TOKEN_TELL,    // TELL
+    TOKEN_FIND,    // FIND
+    TOKEN_SHOW,    // SHOW
+    TOKEN_GET,     // GET
+    TOKEN_FOR,     // FOR
+    TOKEN_FROM,    // FROM
+    TOKEN_TO,      // TO
+    TOKEN_IF,      // IF
+    TOKEN_WHEN,    // WHEN
+    TOKEN_WHERE,   // WHERE
+    TOKEN_THAT,    // THAT
+    TOKEN_GROUP,   // GROUP
+    TOKEN_SORT,    // SORT
+    TOKEN_BY,      // BY
+    TOKEN_LIMIT,   // LIMIT
+    TOKEN_AND,     // AND
+    TOKEN_OR,      // OR
+    TOKEN_HAVING,  // HAVING
+    TOKEN_ORDER,   // ORDER
+    TOKEN_ADD,     // ADD
+    TOKEN_REMOVE,  // REMOVE
+    TOKEN_UPDATE,  // UPDATE
+    TOKEN_CREATE,  // CREATE
+    TOKEN_WITH,    // WITH
+    TOKEN_AS,      // AS
+    TOKEN_IN,      // IN
+    TOKEN_NOT,     // NOT
+    TOKEN_WHICH,   // WHICH
+
+    // Operators
+    TOKEN_PLUS,     // +
+    TOKEN_MINUS,    // -
+    TOKEN_STAR,     // *
+    TOKEN_SLASH,    // /
+    TOKEN_PERCENT,  // %
+    TOKEN_EQUAL,    // =
+    TOKEN_GT,       // >
+    TOKEN_LT,       //
+    TOKEN_GTE,      // >=
+    TOKEN_LTE,      // <=
+    TOKEN_NEQ,      // !=
+    TOKEN_LIKE,     // LIKE
+
+    // Literals and others
+    TOKEN_IDENTIFIER,  // Names
+    TOKEN_STRING,      // String literals
+    TOKEN_INTEGER,     // Integer literals
+    TOKEN_DECIMAL,     // Decimal literals
+    TOKEN_COMMA,       // ,
+    TOKEN_LPAREN,      // (
+    TOKEN_RPAREN,      // )
+    TOKEN_EOF,         // End of input
+    TOKEN_ERROR,       // Error token
+    TOKEN_TERMINATOR,  // ; or PLEASE (depending on how polite you are)
+
+    // Extended keywords (appended so serialized token values stay stable)
+    TOKEN_BETWEEN,   // BETWEEN
+    TOKEN_EXISTS,    // EXISTS
+    TOKEN_HOW,       // HOW
+    TOKEN_MANY,      // MANY
+    TOKEN_HAVE,      // HAVE
+    TOKEN_ARE,       // ARE
+    TOKEN_HAS,       // HAS
+    TOKEN_PATH,      // PATH
+    TOKEN_TRAVERSE,  // TRAVERSE
+    TOKEN_VIA,       // VIA
+    TOKEN_DEPTH,     // DEPTH
+    TOKEN_HOPS,      // HOPS
+    TOKEN_BUT,       // BUT
+    TOKEN_PARAMETER  // ? (prepared statement placeholder)
+} NsqlTokenType;
+
+typedef struct {
+    NsqlTokenType type;
+    const char*   start;
+    size_t        length;
+    int           line;    // Line of the first character
+    int           column;  // Column of the first character (0-based)
+} Token;
+
+typedef struct {
+    const char* source;            // Start of the source buffer
+    const char* start;             // Start of the current lexeme
+    const char* current;           // Next character to scan
+    const char* end;               // One past the last character of the source
+    const char* line_start;        // Start of the line containing current
+    int         line;              // Line containing current
+    int         start_line;        // Line of the current lexeme
+    int         start_column;      // Column of the current lexeme
+    bool        case_insensitive;  // Match keywords regardless of case (set after lexer_init)
+    uint32_t*   line_offsets;      // Source offset of each line start (NULL unless enabled)
+    size_t      line_count;        // Number of entries in line_offsets
+    size_t      line_capacity;     // Allocated entries in line_offsets
+} Lexer;
+
+void        lexer_init(Lexer* lexer, const char* source);
+Token       lexer_next_token(Lexer* lexer);
+const char* lexer_get_line_start(Lexer* lexer, int line);
+
+// Initialize the lexer with a source of a known length that need not be null-terminated, such as
+// a receive buffer or a memory-mapped file. The lexer never reads at or beyond source + length,
+// and a NUL byte within the range is an unexpected character rather than the end of input.
+void lexer_init_n(Lexer* lexer, const char* source, size_t length);
+
+// Record the offset of every line start while scanning so lexer_get_line_start() is a direct
+// table lookup instead of a rescan. Returns false if the table cannot be allocated or the source
+// is longer than 4 GiB. Call lexer_free() once the lexer is no longer needed.
+bool lexer_enable_line_index(Lexer* lexer);
+
+// Release the line index, if any
+void lexer_free(Lexer* lexer);
+
+#ifdef __cplusplus
+}
 #endif
\ No newline at end of file
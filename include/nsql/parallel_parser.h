@@ -0,0 +1,74 @@
+/**
+ * @file parallel_parser.h
+ * @brief Parallel parsing of large multi-statement scripts
+ */
+
+#ifndef NSQL_PARALLEL_PARSER_H
+#define NSQL_PARALLEL_PARSER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <nsql/error_reporter.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A single statement located by split_statements()
+ */
+typedef struct {
+    const char* start;   // First character (leading whitespace and comments included)
+    size_t      length;  // Length up to and including the terminator
+    int         line;    // Line of start within the whole script (1-based)
+} StatementSpan;
+
+/**
+ * Options for parse_program_parallel()
+ */
+typedef struct {
+    int    thread_count;      // Worker threads (0 = one per online CPU)
+    size_t batch_size;        // Approximate bytes of source per work item (0 = automatic)
+    bool   case_insensitive;  // Match keywords regardless of case
+} ParallelParseOptions;
+
+/**
+ * Split a script at its statement terminators
+ *
+ * Semicolons and PLEASE end a statement unless they appear inside a string literal or a >>
+ * comment. Trailing text that contains no tokens is not returned as a statement.
+ *
+ * @param source The script
+ * @param length Length of the script in bytes
+ * @param case_insensitive Whether PLEASE is recognised regardless of case
+ * @param spans Receives a malloc'd array of spans (NULL if there are none), freed by the caller
+ * @return The number of spans
+ */
+size_t split_statements(const char* source, size_t length, bool case_insensitive,
+                        StatementSpan** spans);
+
+/**
+ * Parse a script on multiple threads
+ *
+ * The script is split into statements, which are parsed in batches by a pool of worker threads.
+ * The result has the same shape as parse_program(): a NODE_PROGRAM holding every statement that
+ * parsed without errors, in source order. Statements with errors are skipped as
+ * parse_program_stream() does, and their errors are appended to the error context in source order
+ * with line and column numbers relative to the whole script. Each statement is parsed on its own,
+ * so error recovery never runs past its terminator, and the errors are the same for every
+ * thread_count and batch_size.
+ *
+ * @param source The script (null-terminated)
+ * @param options Parsing options (NULL for defaults)
+ * @param errors Initialized error context that receives all errors
+ * @return The program node (free with free_node()), or NULL if nothing parsed and errors occurred
+ */
+Node* parse_program_parallel(const char* source, const ParallelParseOptions* options,
+                             ErrorContext* errors);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_PARALLEL_PARSER_H */
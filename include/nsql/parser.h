@@ -1,45 +1,112 @@
-#pragma once
-
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-#include <nsql/ast.h>
-#include <nsql/error_reporter.h>
-#include <nsql/lexer.h>
-#include <stdbool.h>
-
-// Parser state
-typedef struct {
-    Lexer*       lexer;       // Lexer to get tokens from
-    Token        current;     // Current token
-    Token        previous;    // Previous token
-    bool         had_error;   // Did we encounter an error during compilation?
-    bool         panic_mode;  // Are we in panic mode?
-    ErrorContext errors;      // Error context for reporting
-} Parser;
-
-// Initialize the parser with a lexer
-void parser_init(Parser* parser, Lexer* lexer);
-
-// Free the parser resources
-void parser_free(Parser* parser);
-
-// Parse a query
-Node* parse_query(Parser* parser);
-
-// Parse a complete program (multiple queries)
-Node* parse_program(Parser* parser);
-
-// Print AST for debugging
-void print_ast(Node* node, int indent);
-
-// Format parser errors into a string
-size_t parser_format_errors(Parser* parser, char* buffer, size_t size);
-
-// Format parser errors as JSON
-size_t parser_format_errors_json(Parser* parser, char* buffer, size_t size);
-
-#ifdef __cplusplus
-}
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/arena.h>
+#include <nsql/ast.h>
+#include <nsql/error_reporter.h>
+#include <nsql/lexer.h>
+#include <nsql/stats.h>
+#include <stdbool.h>
+
+// Default for Parser.max_depth
+#define NSQL_MAX_EXPRESSION_DEPTH 128
+
+// Most ? placeholders in one statement, since serialized ASTs store their indexes in 16 bits.
+// Further placeholders fail with "Too many placeholders in statement".
+#define NSQL_MAX_PARAMETERS 65536
+
+// Parser state
+typedef struct {
+    Lexer*       lexer;            // Lexer to get tokens from
+    Token        current;          // Current token
+    Token        previous;         // Previous token
+    bool         had_error;        // Did we encounter an error during compilation?
+    bool         panic_mode;       // Are we in panic mode?
+    ErrorContext errors;           // Error context for reporting
+    NsqlArena*   arena;            // Arena for AST allocations (NULL = use malloc)
+    bool         zero_copy;        // Point identifiers and string literals into the source buffer
+    bool         echo_errors;      // Also print each error to stderr as it is reported
+    int          parameter_count;  // ? placeholders seen in the current statement
+    int          max_depth;        // Deepest expression nesting accepted
+    int          depth;            // Current expression nesting
+    size_t       max_tokens;       // Most tokens read from the lexer (0 = no limit)
+    size_t       max_nodes;        // Most AST nodes created (0 = no limit)
+    int          max_errors;       // Most errors reported before parsing stops (0 = no limit)
+    size_t       token_count;      // Tokens read so far
+    size_t       node_count;       // AST nodes created so far
+    bool         limit_reached;    // A limit was hit and the rest of the input is ignored
+    const char*  error_token;      // Token of the last error, where further errors are cascades
+    NsqlStats    stats;            // What this parser did (zero unless built with ENABLE_STATS)
+} Parser;
+
+// Initialize the parser with a lexer
+void parser_init(Parser* parser, Lexer* lexer);
+
+// Initialize the parser with a lexer, allocating every AST node, string and child array from the
+// given arena. Trees built this way must not be passed to free_node(); release them all at once
+// with arena_reset() or arena_free() once they are no longer needed.
+void parser_init_with_arena(Parser* parser, Lexer* lexer, NsqlArena* arena);
+
+// Zero-copy mode (set parser->zero_copy = true after init) stores identifier names and string
+// literal values as views into the lexer's source, flagged NODE_FLAG_BORROWED. The tree is only
+// valid while the caller keeps the source alive; use ast_clone() to obtain a detached copy.
+
+// Parentheses, function arguments, unary operators and joined sources nest, and each level of
+// nesting is a level of recursion in the parser. Input nested deeper than parser->max_depth (set
+// after init, NSQL_MAX_EXPRESSION_DEPTH by default) fails with "Expression nested too deeply"
+// instead of overflowing the stack. Chains of binary operators such as `a = 1 OR a = 2 OR ...` are
+// parsed in a loop and do not count towards the limit; the deep trees they produce are walked,
+// copied, serialized and decoded with explicit stacks, so no limit applies to them.
+
+// Untrusted input can be bounded with parser->max_tokens, parser->max_nodes and parser->max_errors
+// (set after init, no limit by default), which count over everything the parser reads, skipped
+// tokens included. Reaching a limit reports one more error ("Too many tokens", "Too many AST
+// nodes" or "Too many errors"), sets parser->limit_reached and makes the parser see the end of
+// input, so no further errors are reported and parse_next_statement() returns false on its next
+// call. Together with max_depth this bounds the time and memory spent on any input.
+
+// Parser errors are recorded in parser->errors without copying their messages, and lexer errors
+// with a copy. Call error_context_use_ring(&parser->errors) after init to keep them in the
+// context's fixed-capacity ring, which copies lexer messages into the ring and makes reporting
+// allocation-free.
+
+// Free the parser resources
+void parser_free(Parser* parser);
+
+// Parse a query
+Node* parse_query(Parser* parser);
+
+// Parse a complete program (multiple queries)
+Node* parse_program(Parser* parser);
+
+// Parse the next statement and its terminator. Returns false at end of input. Otherwise stores the
+// statement in *statement, or NULL if it had errors; such statements are recorded in parser->errors
+// and skipped so the next call starts at the following statement.
+bool parse_next_statement(Parser* parser, Node** statement);
+
+// Statement callback for parse_program_stream(). The statement belongs to the parser and is only
+// valid until the callback returns (use ast_clone() to keep it). Return false to stop parsing.
+typedef bool (*StatementCallback)(Node* statement, void* user_data);
+
+// Parse a program statement by statement, passing each one that parsed without errors to the
+// callback. Statements with errors are recorded in parser->errors and skipped, and parsing resumes
+// at the next statement. Memory is recycled after every statement (the arena is reset when the
+// parser has one), so a script of any length parses in memory bounded by its largest statement.
+// Returns the number of statements passed to the callback.
+size_t parse_program_stream(Parser* parser, StatementCallback callback, void* user_data);
+
+// Print AST for debugging
+void print_ast(Node* node, int indent);
+
+// Format parser errors into a string
+size_t parser_format_errors(Parser* parser, char* buffer, size_t size);
+
+// Format parser errors as JSON
+size_t parser_format_errors_json(Parser* parser, char* buffer, size_t size);
+
+#ifdef __cplusplus
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,113 @@
+/**
+ * @file planner.h
+ * @brief Cost-based execution metadata from a caller-supplied catalog
+ *
+ * ast_create_metadata() only looks at the shape of a query. The planner here refines its result
+ * with what the caller knows about the data: table cardinalities, the engine each table lives in,
+ * the selectivity of equality on each column and the index on it, if any.
+ *
+ * The selectivity of a condition is estimated by walking it. A comparison of a column with a
+ * constant uses the column's selectivity for = (1 minus it for !=, and a third of the rows for
+ * ordering comparisons), an IN list one selectivity per item, AND the product of its operands
+ * (the operands are assumed independent), OR the union of its operands and NOT the complement.
+ * Columns without statistics use NSQL_DEFAULT_SELECTIVITY for =. A join is assumed to follow a
+ * foreign key, so it produces as many rows as its larger input.
+ *
+ * From the estimate the planner sets estimated_rows, chooses an index scan over the most
+ * selective indexed column an AND of conditions constrains (or a full scan), hints parallel
+ * execution when many rows are read, and scales the timeout with the rows read.
+ */
+
+#ifndef NSQL_PLANNER_H
+#define NSQL_PLANNER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <nsql/ast_serializer.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Selectivity of = on a column without statistics
+#define NSQL_DEFAULT_SELECTIVITY 0.1
+
+// Defaults for the NsqlCatalog fields that are left 0
+#define NSQL_DEFAULT_TABLE_ROWS 1000        // Rows of a table missing from the catalog
+#define NSQL_DEFAULT_INDEX_FRACTION 0.2     // Largest fraction of a table read through an index
+#define NSQL_DEFAULT_PARALLEL_ROWS 100000   // Rows read from which parallel execution is hinted
+#define NSQL_DEFAULT_ROWS_PER_MS 10000      // Rows an executor reads per millisecond
+#define NSQL_DEFAULT_MIN_TIMEOUT_MS 1000    // Shortest timeout set
+#define NSQL_DEFAULT_MAX_TIMEOUT_MS 300000  // Longest timeout set
+
+/**
+ * Statistics of a column
+ */
+typedef struct {
+    const char* name;         // Column name (null-terminated)
+    double      selectivity;  // Fraction of rows = on the column matches (0 = unknown)
+    const char* index;        // Name of an index on the column (NULL if none)
+} NsqlColumnStats;
+
+/**
+ * Statistics of a table
+ */
+typedef struct {
+    const char*            name;          // Table name as used in queries (null-terminated)
+    uint64_t               rows;          // Number of rows
+    uint8_t                engine;        // ENGINE_SQL or ENGINE_NOSQL (ENGINE_AUTO = not known)
+    const NsqlColumnStats* columns;       // Columns with statistics
+    size_t                 column_count;  // Number of entries in columns
+} NsqlTableStats;
+
+/**
+ * What the planner knows about the data
+ *
+ * Names are matched exactly, and the catalog and every string it points to must outlive the
+ * metadata produced from it, since target_index points into it.
+ */
+typedef struct {
+    const NsqlTableStats* tables;           // Tables with statistics
+    size_t                table_count;      // Number of entries in tables
+    uint64_t              default_rows;     // Rows of unknown tables (0 = NSQL_DEFAULT_TABLE_ROWS)
+    double                index_fraction;   // Largest fraction read by index (0 = the default)
+    uint64_t              parallel_rows;    // Rows read to hint parallel execution (0 = default)
+    uint32_t              rows_per_ms;      // Executor scan rate, for timeouts (0 = the default)
+    uint32_t              min_timeout_ms;   // Shortest timeout (0 = NSQL_DEFAULT_MIN_TIMEOUT_MS)
+    uint32_t              max_timeout_ms;   // Longest timeout (0 = NSQL_DEFAULT_MAX_TIMEOUT_MS)
+} NsqlCatalog;
+
+/**
+ * Planner hook
+ *
+ * Called with a statement and the metadata ast_create_metadata() made for it, which the hook
+ * refines in place.
+ *
+ * @param statement The parsed statement
+ * @param metadata The metadata to refine
+ * @param user_data Pointer supplied with the hook
+ */
+typedef void (*NsqlPlannerHook)(const Node* statement, ExecutionMetadata* metadata,
+                                void* user_data);
+
+/**
+ * Refine metadata from a catalog
+ *
+ * Matches NsqlPlannerHook, with the catalog as user_data. Statements other than ASK, FIND, SHOW,
+ * GET and TELL with UPDATE or REMOVE are left as they are, and so are statements none of whose
+ * tables are in the catalog. The engine is set from the tables the statement reads when the
+ * catalog knows all of their engines and they agree; otherwise the choice of
+ * ast_create_metadata() stands. Writes are never hinted to run in parallel.
+ *
+ * @param statement The parsed statement
+ * @param metadata The metadata to refine
+ * @param catalog The NsqlCatalog
+ */
+void nsql_plan_with_catalog(const Node* statement, ExecutionMetadata* metadata, void* catalog);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_PLANNER_H */
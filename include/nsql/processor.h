@@ -1,24 +1,237 @@
-#pragma once
-
-#include <nsql/ast_serializer.h>
-#include <nsql/lexer.h>
-#include <nsql/parser.h>
-#include <stdbool.h>
-
-/**
- * Initialize the NSQL query processor.
- */
-bool nsql_processor_init(void);
-
-/**
- * Process an NSQL query
- *
- * @param query The NSQL query string.
- * @return true if successful, false otherwise.
- */
-bool nsql_process_query(const char* query);
-
-/**
- * Shut down the NSQL processor.
- */
-void nsql_processor_shutdown(void);
\ No newline at end of file
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast_serializer.h>
+#include <nsql/error_reporter.h>
+#include <nsql/lexer.h>
+#include <nsql/parser.h>
+#include <nsql/planner.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// =======================================================
+// Query Pipeline
+// =======================================================
+
+// Default for NsqlProcessorOptions.queue_capacity
+#define NSQL_PROCESSOR_QUEUE_CAPACITY 1024
+
+// Queries submitted with a priority from this value up run before the default band
+#define NSQL_PRIORITY_HIGH_THRESHOLD 192
+
+// Queries submitted with a priority up to this value run after the default band
+#define NSQL_PRIORITY_LOW_THRESHOLD 64
+
+/**
+ * Options for nsql_processor_init_with_options()
+ */
+typedef struct {
+    int             thread_count;      // Worker threads (0 = one per online CPU)
+    size_t          queue_capacity;    // Waiting queries per priority band (0 = the default)
+    bool            case_insensitive;  // Match keywords regardless of case
+    bool            optimize;          // Simplify each tree with ast_optimize() before serializing
+    NsqlPlannerHook planner;           // Refines ast_create_metadata() of each query (NULL = none)
+    void*           planner_data;      // Passed to planner (an NsqlCatalog for the catalog planner)
+} NsqlProcessorOptions;
+
+// Completion handle of a submitted query
+typedef struct NsqlQuery NsqlQuery;
+
+/**
+ * Initialize the NSQL query processor with default options
+ *
+ * @return true if the processor is running
+ */
+bool nsql_processor_init(void);
+
+/**
+ * Initialize the NSQL query processor
+ *
+ * Starts a fixed pool of worker threads that turn query text into serialized plans: lexing,
+ * parsing, ast_optimize() if options->optimize is set, ast_create_metadata() and serialization.
+ * Each worker reuses its own parser arena and serialization buffer for every query it runs, so
+ * warm workers allocate little beyond the result. Does nothing if the processor is already
+ * running. Initialization, shutdown and submission must not overlap.
+ *
+ * @param options Processor options (NULL for defaults)
+ * @return true if the processor is running
+ */
+bool nsql_processor_init_with_options(const NsqlProcessorOptions* options);
+
+/**
+ * Submit a query to the processor
+ *
+ * The query text is copied, so the caller need not keep it. Waiting queries are taken in three
+ * priority bands: HINT_PRIORITY_HIGH, or a priority of at least NSQL_PRIORITY_HIGH_THRESHOLD, goes
+ * first, and HINT_PRIORITY_LOW, or a priority of at most NSQL_PRIORITY_LOW_THRESHOLD, goes last.
+ * Queries submitted without metadata go in the middle band. Lower bands are still served
+ * occasionally while higher ones are busy, so they are never starved. Submission does not take a
+ * lock.
+ *
+ * @param query The statement text (a single statement)
+ * @param metadata Metadata for the serialized plan and the scheduling priority (NULL to schedule at
+ *                 the default priority and use ast_create_metadata())
+ * @return The completion handle (free with nsql_query_free()), or NULL if the processor is not
+ *         running or the query's band is full
+ */
+NsqlQuery* nsql_submit_query(const char* query, const ExecutionMetadata* metadata);
+
+/**
+ * Check whether a submitted query has completed
+ *
+ * @param query The completion handle
+ * @return true once the query's result and errors are available
+ */
+bool nsql_query_done(const NsqlQuery* query);
+
+/**
+ * Wait for a submitted query to complete
+ *
+ * @param query The completion handle
+ * @return true if the query produced a serialized plan, false if it had errors
+ */
+bool nsql_query_wait(NsqlQuery* query);
+
+/**
+ * Get the serialized plan of a completed query
+ *
+ * The data is exactly what ast_serialize() produces. Read it in place with ast_reader_init() or
+ * copy it with ast_deserialize().
+ *
+ * @param query The completion handle (the query must have completed)
+ * @param size Receives the size of the plan in bytes (may be NULL)
+ * @return The plan, valid until nsql_query_free(), or NULL if the query had errors
+ */
+const void* nsql_query_result(const NsqlQuery* query, size_t* size);
+
+/**
+ * Get the errors of a completed query
+ *
+ * The context is in ring mode and keeps the last NSQL_ERROR_RING_CAPACITY reports.
+ *
+ * @param query The completion handle (the query must have completed)
+ * @return The errors, valid until nsql_query_free()
+ */
+const ErrorContext* nsql_query_errors(const NsqlQuery* query);
+
+/**
+ * Free a completion handle, waiting for the query first if it has not completed
+ *
+ * @param query The completion handle
+ */
+void nsql_query_free(NsqlQuery* query);
+
+/**
+ * Process an NSQL query
+ *
+ * Submits the query at the default priority and waits for it. The query runs on the calling
+ * thread if the processor is not running or the queue is full.
+ *
+ * @param query The NSQL query string.
+ * @return true if successful, false otherwise.
+ */
+bool nsql_process_query(const char* query);
+
+/**
+ * Shut down the NSQL processor
+ *
+ * Queries already submitted are completed before the workers exit; their handles stay valid.
+ */
+void nsql_processor_shutdown(void);
+
+// =======================================================
+// Prepared Statements
+// =======================================================
+
+// Prepared statement handle
+typedef struct PreparedStatement PreparedStatement;
+
+/**
+ * Parse a statement with ? placeholders once for repeated execution
+ *
+ * Placeholders may stand for any expression operand as well as LIMIT and OFFSET counts. They are
+ * numbered from 0 in the order they appear.
+ *
+ * @param query The statement text (a single statement)
+ * @param errors Receives the parse errors if not NULL; free it with error_context_free()
+ * @return The prepared statement, or NULL if the query does not parse
+ */
+PreparedStatement* nsql_prepare(const char* query, ErrorContext* errors);
+
+/**
+ * Get the number of placeholders in a prepared statement
+ *
+ * @param stmt The prepared statement
+ * @return The number of parameters
+ */
+int nsql_prepared_parameter_count(const PreparedStatement* stmt);
+
+/**
+ * Bind an integer to a placeholder
+ *
+ * @param stmt The prepared statement
+ * @param index The parameter index
+ * @param value The value (must not be negative for LIMIT and OFFSET placeholders)
+ * @return true if the value was bound
+ */
+bool nsql_bind_integer(PreparedStatement* stmt, int index, int value);
+
+/**
+ * Bind a decimal to a placeholder
+ *
+ * @param stmt The prepared statement
+ * @param index The parameter index (not a LIMIT or OFFSET placeholder)
+ * @param value The value
+ * @return true if the value was bound
+ */
+bool nsql_bind_decimal(PreparedStatement* stmt, int index, double value);
+
+/**
+ * Bind a string to a placeholder
+ *
+ * The string is copied.
+ *
+ * @param stmt The prepared statement
+ * @param index The parameter index (not a LIMIT or OFFSET placeholder)
+ * @param value The string bytes
+ * @param length Length of value in bytes (at most 65535)
+ * @return true if the value was bound
+ */
+bool nsql_bind_string(PreparedStatement* stmt, int index, const char* value, size_t length);
+
+/**
+ * Get the statement tree with the bound values in place
+ *
+ * Bound placeholders are NODE_LITERAL nodes (or counts in the NODE_LIMIT); placeholders not bound
+ * yet are still NODE_PARAMETER nodes. The tree belongs to the statement and changes with every
+ * bind call.
+ *
+ * @param stmt The prepared statement
+ * @return The statement tree
+ */
+const Node* nsql_prepared_ast(const PreparedStatement* stmt);
+
+/**
+ * Produce the serialized plan for the current bindings
+ *
+ * Patches the bound values into the statement's serialized template without re-serializing it.
+ * The result belongs to the statement and is overwritten by the next call.
+ *
+ * @param stmt The prepared statement
+ * @return The serialized plan, or NULL if a parameter has not been bound
+ */
+const SerializedAST* nsql_execute_prepared(PreparedStatement* stmt);
+
+/**
+ * Free a prepared statement
+ *
+ * @param stmt The prepared statement
+ */
+void nsql_prepared_free(PreparedStatement* stmt);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,126 @@
+/**
+ * @file query_cache.h
+ * @brief Cache of parsed queries keyed by their normalized token stream
+ */
+
+#ifndef NSQL_QUERY_CACHE_H
+#define NSQL_QUERY_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nsql/ast.h>
+#include <nsql/ast_serializer.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Default maximum number of cached query shapes
+ */
+#define QUERY_CACHE_DEFAULT_CAPACITY 1024
+
+// Cache handle, private to query_cache.c
+typedef struct QueryCache QueryCache;
+
+// Cached query shape, private to query_cache.c
+typedef struct QueryCacheEntry QueryCacheEntry;
+
+/**
+ * A literal extracted from a query
+ */
+typedef struct {
+    NsqlTokenType type;    // TOKEN_STRING, TOKEN_INTEGER or TOKEN_DECIMAL
+    const char*   text;    // Literal text in the query (strings without their quotes)
+    size_t        length;  // Length of text in bytes
+    double        number;  // Numeric value (TOKEN_INTEGER and TOKEN_DECIMAL only)
+} QueryLiteral;
+
+/**
+ * Result of a cache lookup
+ *
+ * The template and serialized template are shared with other lookups and must not be modified.
+ * Their literal values are those of the query that first created the entry; the query's own
+ * values are in literals, which point into the query text.
+ */
+typedef struct {
+    QueryCacheEntry*     entry;          // Cache entry kept alive by this result
+    const Node*          ast;            // Shared AST template
+    const SerializedAST* serialized;     // Shared serialized template
+    QueryLiteral*        literals;       // Every literal of the query, in source order
+    size_t               literal_count;  // Number of entries in literals
+    bool                 hit;            // Whether the shape was already cached
+} QueryCacheResult;
+
+/**
+ * Cache counters
+ */
+typedef struct {
+    uint64_t hits;       // Lookups answered from the cache
+    uint64_t misses;     // Lookups that had to parse the query
+    uint64_t evictions;  // Entries evicted to make room
+    size_t   entries;    // Entries currently cached
+} QueryCacheStats;
+
+/**
+ * Create a query cache
+ *
+ * @param capacity Maximum number of cached query shapes (0 for QUERY_CACHE_DEFAULT_CAPACITY)
+ * @return The cache, or NULL if out of memory
+ */
+QueryCache* query_cache_create(size_t capacity);
+
+/**
+ * Destroy a query cache
+ *
+ * Results that are still held stay valid until they are released.
+ *
+ * @param cache The cache to destroy
+ */
+void query_cache_destroy(QueryCache* cache);
+
+/**
+ * Look up a query, parsing and caching it on a miss
+ *
+ * The query must hold a single statement. Two queries share an entry when they differ only in
+ * literal values that end up in NODE_LITERAL nodes; literals the parser folds into the structure
+ * (LIMIT counts, quoted source names) are part of the shape. Safe to call from multiple threads.
+ *
+ * @param cache The cache
+ * @param query The query text (must outlive the result's literals)
+ * @param result Receives the result; release it with query_cache_release()
+ * @return true on success, false if the query is not a single statement that parses cleanly
+ */
+bool query_cache_lookup(QueryCache* cache, const char* query, QueryCacheResult* result);
+
+/**
+ * Build an AST for the looked-up query
+ *
+ * Clones the template and substitutes the query's own literal values.
+ *
+ * @param result A successful lookup result
+ * @return A new tree owned by the caller (free with free_node())
+ */
+Node* query_cache_instantiate(const QueryCacheResult* result);
+
+/**
+ * Release a lookup result
+ *
+ * @param result The result to release
+ */
+void query_cache_release(QueryCacheResult* result);
+
+/**
+ * Read the cache counters
+ *
+ * @param cache The cache
+ * @param stats Receives the counters
+ */
+void query_cache_stats(QueryCache* cache, QueryCacheStats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_QUERY_CACHE_H */
@@ -0,0 +1,81 @@
+/**
+ * @file stats.h
+ * @brief Opt-in counters and stage timings for lexing, parsing and serialization
+ *
+ * Statistics are compiled in with the ENABLE_STATS CMake option. Without it every hook compiles
+ * out, nsql_stats_enabled() returns false and all counters read as zero.
+ *
+ * Each thread accumulates into its own block without atomic read-modify-write operations or
+ * locks, so the counters are cheap enough to leave on. nsql_stats_get() adds up the blocks of all
+ * threads, including threads that have exited. Parser.stats holds the share of a single parser.
+ */
+
+#ifndef NSQL_STATS_H
+#define NSQL_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of ErrorSource values, the size of NsqlStats.errors
+#define NSQL_ERROR_SOURCE_COUNT 5
+
+/**
+ * Timed stages, indexes into NsqlStats.stage_ns
+ */
+typedef enum {
+    NSQL_STAGE_LEX,        // Producing tokens for the parser (estimated from every 64th token)
+    NSQL_STAGE_PARSE,      // parse_query(), including the lexing it triggers
+    NSQL_STAGE_SERIALIZE,  // Writing serialized ASTs, including their checksums
+    NSQL_STAGE_CHECKSUM,   // Computing checksums, when serializing or verifying
+    NSQL_STAGE_COUNT,
+} NsqlStage;
+
+/**
+ * Counters
+ *
+ * Every field is a uint64_t.
+ */
+typedef struct {
+    uint64_t tokens_lexed;                     // Tokens read by parsers
+    uint64_t nodes_created;                    // AST nodes allocated by parsers
+    uint64_t bytes_copied;                     // Bytes of identifiers and literals copied
+    uint64_t list_reallocs;                    // Child arrays grown while parsing lists
+    uint64_t serialized_asts;                  // ASTs serialized
+    uint64_t serialized_bytes;                 // Bytes of serialized ASTs, headers included
+    uint64_t errors[NSQL_ERROR_SOURCE_COUNT];  // Reports by ErrorSource
+    uint64_t stage_ns[NSQL_STAGE_COUNT];       // Nanoseconds spent in each NsqlStage
+} NsqlStats;
+
+/**
+ * Check whether statistics were compiled in
+ *
+ * @return true if the library was built with ENABLE_STATS
+ */
+bool nsql_stats_enabled(void);
+
+/**
+ * Get the counters of the whole process since the last nsql_stats_reset()
+ *
+ * Counters of threads still running are read while they change, so each field is current but the
+ * fields are not a consistent snapshot of one moment.
+ *
+ * @param stats Receives the counters
+ */
+void nsql_stats_get(NsqlStats* stats);
+
+/**
+ * Start counting the process-wide counters from zero
+ *
+ * Parser.stats is not affected.
+ */
+void nsql_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NSQL_STATS_H */
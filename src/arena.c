@@ -0,0 +1,227 @@
+/**
+ * @file arena.c
+ * @brief Implementation of the bump-pointer arena allocator
+ */
+
+#include <nsql/arena.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+// Arena chunk, allocations are carved out of data[]
+struct NsqlArenaChunk {
+    NsqlArenaChunk* next;
+    size_t          capacity;
+    size_t          used;
+    alignas(max_align_t) unsigned char data[];
+};
+
+/**
+ * Round a size up to the arena alignment.
+ *
+ * @param size The size to align.
+ * @return The aligned size.
+ */
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+/**
+ * Allocate a new chunk.
+ *
+ * @param capacity The usable capacity of the chunk in bytes.
+ * @return Pointer to the new chunk, or NULL on failure.
+ */
+static NsqlArenaChunk* new_chunk(size_t capacity) {
+    NsqlArenaChunk* chunk = (NsqlArenaChunk*)malloc(sizeof(NsqlArenaChunk) + capacity);
+    if (!chunk)
+        return NULL;
+
+    chunk->next     = NULL;
+    chunk->capacity = capacity;
+    chunk->used     = 0;
+    return chunk;
+}
+
+/**
+ * Initialize an arena.
+ *
+ * @param arena The arena to initialize.
+ * @param chunk_size Size of each chunk in bytes (0 for the default).
+ */
+void arena_init(NsqlArena* arena, size_t chunk_size) {
+    if (!arena)
+        return;
+
+    arena->first      = NULL;
+    arena->current    = NULL;
+    arena->last_alloc = NULL;
+    arena->chunk_size = chunk_size > 0 ? align_size(chunk_size) : NSQL_ARENA_DEFAULT_CHUNK_SIZE;
+}
+
+/**
+ * Allocate memory from an arena.
+ *
+ * Walks forward from the current chunk (chunks left over from a previous arena_reset() are reused)
+ * and allocates a new chunk only when none of the remaining ones has room.
+ *
+ * @param arena The arena to allocate from.
+ * @param size Number of bytes to allocate.
+ * @return Pointer to the allocated memory, or NULL if out of memory.
+ */
+void* arena_alloc(NsqlArena* arena, size_t size) {
+    if (!arena)
+        return NULL;
+
+    size = align_size(size > 0 ? size : 1);
+
+    NsqlArenaChunk* chunk = arena->current;
+    while (chunk && chunk->used + size > chunk->capacity) {
+        chunk = chunk->next;
+        if (chunk)
+            chunk->used = 0;
+    }
+
+    if (!chunk) {
+        // Oversized requests get a dedicated chunk so regular chunks stay dense
+        chunk = new_chunk(size > arena->chunk_size ? size : arena->chunk_size);
+        if (!chunk)
+            return NULL;
+
+        if (arena->current) {
+            chunk->next          = arena->current->next;
+            arena->current->next = chunk;
+        } else {
+            arena->first = chunk;
+        }
+    }
+
+    void* ptr = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->current    = chunk;
+    arena->last_alloc = ptr;
+    return ptr;
+}
+
+/**
+ * Grow an allocation previously returned by the arena.
+ *
+ * @param arena The arena that owns ptr.
+ * @param ptr The allocation to grow.
+ * @param old_size The current size of the allocation.
+ * @param new_size The requested size of the allocation.
+ * @return Pointer to the resized allocation, or NULL if out of memory.
+ */
+void* arena_realloc(NsqlArena* arena, void* ptr, size_t old_size, size_t new_size) {
+    if (!ptr)
+        return arena_alloc(arena, new_size);
+    if (new_size <= old_size)
+        return ptr;
+
+    // Extend in place when ptr is the tail of the current chunk
+    NsqlArenaChunk* chunk = arena->current;
+    if (ptr == arena->last_alloc && chunk) {
+        size_t offset = (size_t)((unsigned char*)ptr - chunk->data);
+        size_t needed = align_size(new_size);
+        if (offset + needed <= chunk->capacity) {
+            chunk->used = offset + needed;
+            return ptr;
+        }
+    }
+
+    void* new_ptr = arena_alloc(arena, new_size);
+    if (!new_ptr)
+        return NULL;
+
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+/**
+ * Copy a string into the arena.
+ *
+ * @param arena The arena to allocate from.
+ * @param str The characters to copy.
+ * @param length Number of characters to copy.
+ * @return Null-terminated copy of the string, or NULL if out of memory.
+ */
+char* arena_strndup(NsqlArena* arena, const char* str, size_t length) {
+    char* copy = (char*)arena_alloc(arena, length + 1);
+    if (!copy)
+        return NULL;
+
+    if (length > 0)
+        memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * Release every allocation made from the arena while keeping its chunks.
+ *
+ * Regular chunks are kept for reuse; oversized chunks are returned to the system so a single huge
+ * parse does not pin memory forever.
+ *
+ * @param arena The arena to reset.
+ */
+void arena_reset(NsqlArena* arena) {
+    if (!arena)
+        return;
+
+    NsqlArenaChunk** link = &arena->first;
+    while (*link) {
+        NsqlArenaChunk* chunk = *link;
+        if (chunk->capacity > arena->chunk_size) {
+            *link = chunk->next;
+            free(chunk);
+            continue;
+        }
+        chunk->used = 0;
+        link        = &chunk->next;
+    }
+
+    arena->current    = arena->first;
+    arena->last_alloc = NULL;
+}
+
+/**
+ * Get the memory an arena holds.
+ *
+ * @param arena The arena.
+ * @return The bytes of all of its chunks, headers included.
+ */
+size_t arena_size(const NsqlArena* arena) {
+    size_t size = 0;
+    if (!arena)
+        return 0;
+
+    for (const NsqlArenaChunk* chunk = arena->first; chunk; chunk = chunk->next) {
+        size += sizeof(NsqlArenaChunk) + chunk->capacity;
+    }
+    return size;
+}
+
+/**
+ * Free all memory owned by the arena.
+ *
+ * @param arena The arena to free.
+ */
+void arena_free(NsqlArena* arena) {
+    if (!arena)
+        return;
+
+    NsqlArenaChunk* chunk = arena->first;
+    while (chunk) {
+        NsqlArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    arena->first      = NULL;
+    arena->current    = NULL;
+    arena->last_alloc = NULL;
+}
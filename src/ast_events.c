@@ -0,0 +1,246 @@
+/**
+ * @file ast_events.c
+ * @brief Event output of parsed ASTs
+ */
+
+#include <nsql/ast_events.h>
+#include <nsql/ast_visitor.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Levels of nesting tracked on the C stack before the walk moves to the heap
+#define INLINE_LEVELS 32
+
+// State of ast_emit_events()
+typedef struct {
+    const AstEventSink* sink;         // The callbacks
+    int*                sent;         // Children sent so far by the open node at each depth
+    size_t              capacity;     // Allocated entries in sent
+    int*                inline_sent;  // The initial, stack-allocated array of sent
+} EventWalk;
+
+/**
+ * Send a string field.
+ *
+ * @param sink The callbacks.
+ * @param name Field name.
+ * @param string The value.
+ * @param length Length of the value in bytes.
+ * @return false if the callback stopped the walk.
+ */
+static bool send_string(const AstEventSink* sink, const char* name, const char* string,
+                        size_t length) {
+    AstField field = {name, AST_FIELD_STRING, string ? string : "", string ? length : 0, 0, 0};
+    return sink->field(&field, sink->user_data);
+}
+
+/**
+ * Send an integer, boolean or operator field.
+ *
+ * @param sink The callbacks.
+ * @param name Field name.
+ * @param type AST_FIELD_INTEGER, AST_FIELD_BOOLEAN or AST_FIELD_OPERATOR.
+ * @param value The value.
+ * @return false if the callback stopped the walk.
+ */
+static bool send_integer(const AstEventSink* sink, const char* name, AstFieldType type,
+                         int64_t value) {
+    AstField field = {name, type, NULL, 0, 0, value};
+    return sink->field(&field, sink->user_data);
+}
+
+/**
+ * Send a count of LIMIT, which encodes ? placeholders as negative values.
+ *
+ * @param sink The callbacks.
+ * @param name Field name of a plain count.
+ * @param parameter_name Field name of a placeholder index.
+ * @param value The count.
+ * @return false if the callback stopped the walk.
+ */
+static bool send_count(const AstEventSink* sink, const char* name, const char* parameter_name,
+                       int value) {
+    if (LIMIT_IS_PARAMETER(value))
+        return send_integer(sink, parameter_name, AST_FIELD_INTEGER, LIMIT_PARAMETER_INDEX(value));
+    return send_integer(sink, name, AST_FIELD_INTEGER, value);
+}
+
+/**
+ * Send the scalar fields of a node.
+ *
+ * @param sink The callbacks.
+ * @param frame The node and its position in the tree.
+ * @return false if the callback stopped the walk.
+ */
+static bool send_fields(const AstEventSink* sink, const AstVisitFrame* frame) {
+    const Node* node = frame->node;
+
+    // The sort direction of an ORDER BY entry is stored in its parent
+    if (frame->parent && frame->parent->type == NODE_ORDER_BY &&
+        !send_integer(sink, "ascending", AST_FIELD_BOOLEAN,
+                      frame->parent->as.order_by.ascending[frame->slot]))
+        return false;
+
+    switch (node->type) {
+        case NODE_FIELD_LIST:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.field_list.count);
+
+        case NODE_ORDER_BY:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.order_by.count);
+
+        case NODE_LIMIT:
+            return send_count(sink, "limit", "limitParameter", node->as.limit.limit) &&
+                   send_count(sink, "offset", "offsetParameter", node->as.limit.offset);
+
+        case NODE_UPDATE_ACTION:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.update_action.count);
+
+        case NODE_CREATE_ACTION:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.create_action.count);
+
+        case NODE_BINARY_EXPR:
+            return send_integer(sink, "operator", AST_FIELD_OPERATOR, node->as.binary_expr.op);
+
+        case NODE_UNARY_EXPR:
+            return send_integer(sink, "operator", AST_FIELD_OPERATOR, node->as.unary_expr.op);
+
+        case NODE_LOGICAL_EXPR:
+            return send_integer(sink, "operator", AST_FIELD_OPERATOR, node->as.logical_expr.op) &&
+                   send_integer(sink, "count", AST_FIELD_INTEGER, node->as.logical_expr.count);
+
+        case NODE_IN_LIST:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.in_list.count);
+
+        case NODE_IDENTIFIER:
+            return send_string(sink, "name", node->as.identifier.name,
+                               (size_t)node->as.identifier.length);
+
+        case NODE_LITERAL:
+            if (node->as.literal.literal_type == TOKEN_STRING) {
+                return send_string(sink, "value", node->as.literal.value.string_value,
+                                   (size_t)node->as.literal.length) &&
+                       send_string(sink, "literalType", "string", 6);
+            } else {
+                AstField field = {"value", AST_FIELD_NUMBER, NULL, 0,
+                                  node->as.literal.value.number_value, 0};
+                bool     is_integer = node->as.literal.literal_type == TOKEN_INTEGER;
+                return sink->field(&field, sink->user_data) &&
+                       send_string(sink, "literalType", is_integer ? "integer" : "decimal", 7);
+            }
+
+        case NODE_FIELD_DEF: {
+            const char* type = node->as.field_def.type;
+            return send_string(sink, "dataType", type, type ? strlen(type) : 0);
+        }
+
+        case NODE_CONSTRAINT: {
+            static const char* const names[] = {"required", "unique", "default"};
+            ConstraintType           type    = node->as.constraint.type;
+            const char*              name    = type <= CONSTRAINT_DEFAULT ? names[type] : "unknown";
+            return send_string(sink, "constraint", name, strlen(name));
+        }
+
+        case NODE_FUNCTION_CALL: {
+            const char* name = node->as.function_call.name;
+            return send_string(sink, "name", name, name ? strlen(name) : 0) &&
+                   send_integer(sink, "count", AST_FIELD_INTEGER, node->as.function_call.arg_count);
+        }
+
+        case NODE_ERROR: {
+            const char* message = node->as.error.message;
+            return send_string(sink, "message", message, message ? strlen(message) : 0);
+        }
+
+        case NODE_PROGRAM:
+            return send_integer(sink, "count", AST_FIELD_INTEGER, node->as.program.count);
+
+        case NODE_PARAMETER:
+            return send_integer(sink, "index", AST_FIELD_INTEGER, node->as.parameter.index);
+
+        default:
+            return true;
+    }
+}
+
+/**
+ * Send the enter event and the fields of a node.
+ *
+ * @param frame The node and its position in the tree.
+ * @param user_data The EventWalk.
+ * @return AST_VISIT_STOP if a callback stopped the walk, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction enter_visit(const AstVisitFrame* frame, void* user_data) {
+    EventWalk* walk  = (EventWalk*)user_data;
+    size_t     depth = (size_t)frame->depth;
+
+    if (depth >= walk->capacity) {
+        // The initial array is on the C stack, so it is copied rather than reallocated
+        bool   moved    = walk->sent == walk->inline_sent;
+        size_t capacity = walk->capacity * 2;
+        int*   sent     = moved ? (int*)malloc(capacity * sizeof(int))
+                                : (int*)realloc(walk->sent, capacity * sizeof(int));
+        if (sent == NULL) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        if (moved)
+            memcpy(sent, walk->inline_sent, walk->capacity * sizeof(int));
+        walk->sent     = sent;
+        walk->capacity = capacity;
+    }
+
+    AstEventNode event = {frame->node->type, frame->node->line, frame->depth, frame->slot, 0, 0};
+    if (depth > 0)
+        event.index = walk->sent[depth - 1]++;
+    walk->sent[depth] = 0;
+
+    const AstEventSink* sink = walk->sink;
+    if (sink->enter && !sink->enter(&event, sink->user_data))
+        return AST_VISIT_STOP;
+    if (sink->field && !send_fields(sink, frame))
+        return AST_VISIT_STOP;
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Send the leave event of a node.
+ *
+ * @param frame The node and its position in the tree.
+ * @param user_data The EventWalk.
+ * @return AST_VISIT_STOP if the callback stopped the walk, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction leave_visit(const AstVisitFrame* frame, void* user_data) {
+    EventWalk*          walk = (EventWalk*)user_data;
+    const AstEventSink* sink = walk->sink;
+    if (!sink->leave)
+        return AST_VISIT_CONTINUE;
+
+    AstEventNode event = {frame->node->type, frame->node->line, frame->depth, frame->slot,
+                          frame->depth > 0 ? walk->sent[frame->depth - 1] - 1 : 0,
+                          walk->sent[frame->depth]};
+    return sink->leave(&event, sink->user_data) ? AST_VISIT_CONTINUE : AST_VISIT_STOP;
+}
+
+/**
+ * Send the events of a tree to a sink.
+ *
+ * @param root Root of the tree.
+ * @param sink The callbacks.
+ * @return false if a callback stopped the walk, true otherwise.
+ */
+bool ast_emit_events(const Node* root, const AstEventSink* sink) {
+    if (root == NULL)
+        return true;
+
+    int       inline_sent[INLINE_LEVELS];
+    EventWalk walk = {sink, inline_sent, INLINE_LEVELS, inline_sent};
+
+    // The walk does not modify the tree
+    AstVisitor visitor = {enter_visit, leave_visit, &walk, false};
+    bool       ok      = ast_visit((Node*)root, &visitor);
+
+    if (walk.sent != inline_sent)
+        free(walk.sent);
+    return ok;
+}
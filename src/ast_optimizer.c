@@ -0,0 +1,585 @@
+/**
+ * @file ast_optimizer.c
+ * @brief Constant folding and simplification of ASTs before serialization
+ */
+
+#include <limits.h>
+#include <nsql/ast_optimizer.h>
+#include <nsql/ast_visitor.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// State of ast_optimize()
+typedef struct {
+    bool   in_arena;  // Removed nodes belong to an arena and are not freed
+    size_t rewrites;  // Rewrites made so far
+} Optimizer;
+
+/**
+ * Check whether a node is a numeric literal.
+ *
+ * @param node The node (may be NULL).
+ * @return true for integer and decimal literals.
+ */
+static bool is_number(const Node* node) {
+    return node && node->type == NODE_LITERAL &&
+           (node->as.literal.literal_type == TOKEN_INTEGER ||
+            node->as.literal.literal_type == TOKEN_DECIMAL);
+}
+
+/**
+ * Check whether a node is an integer literal.
+ *
+ * @param node The node (may be NULL).
+ * @return true for integer literals.
+ */
+static bool is_integer(const Node* node) {
+    return node && node->type == NODE_LITERAL && node->as.literal.literal_type == TOKEN_INTEGER;
+}
+
+/**
+ * Check whether a node is a string literal.
+ *
+ * @param node The node (may be NULL).
+ * @return true for string literals.
+ */
+static bool is_string(const Node* node) {
+    return node && node->type == NODE_LITERAL && node->as.literal.literal_type == TOKEN_STRING;
+}
+
+/**
+ * Check whether an operator compares its operands.
+ *
+ * @param op The operator.
+ * @return true for =, !=, <, <=, > and >=.
+ */
+static bool is_comparison(NsqlTokenType op) {
+    switch (op) {
+        case TOKEN_EQUAL:
+        case TOKEN_NEQ:
+        case TOKEN_LT:
+        case TOKEN_LTE:
+        case TOKEN_GT:
+        case TOKEN_GTE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Check whether an expression always evaluates to true or false.
+ *
+ * @param node The expression.
+ * @return true for comparisons, AND, OR, NOT and IN.
+ */
+static bool is_boolean(const Node* node) {
+    switch (node->type) {
+        case NODE_BINARY_EXPR:
+            return is_comparison(node->as.binary_expr.op);
+        case NODE_UNARY_EXPR:
+            return node->as.unary_expr.op == TOKEN_NOT;
+        case NODE_LOGICAL_EXPR:
+        case NODE_IN_LIST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Check whether an expression that is not a literal always evaluates to a number.
+ *
+ * A field or function call may hold a string, and + may join strings, so only conditions, which
+ * evaluate to 1 or 0, negations and the other arithmetic operators qualify.
+ *
+ * @param node The expression.
+ * @return true if the expression is known to be numeric.
+ */
+static bool is_numeric(const Node* node) {
+    if (is_boolean(node))
+        return true;
+
+    switch (node->type) {
+        case NODE_UNARY_EXPR:
+            return node->as.unary_expr.op == TOKEN_MINUS;
+        case NODE_BINARY_EXPR: {
+            NsqlTokenType op = node->as.binary_expr.op;
+            return op == TOKEN_MINUS || op == TOKEN_STAR || op == TOKEN_SLASH ||
+                   op == TOKEN_PERCENT;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * Check whether only the truth of a node matters to its parent.
+ *
+ * @param frame The node and its parent.
+ * @return true for conditions and the operands of AND, OR and NOT.
+ */
+static bool in_condition(const AstVisitFrame* frame) {
+    const Node* node   = frame->node;
+    const Node* parent = frame->parent;
+    if (parent == NULL)
+        return false;
+
+    switch (parent->type) {
+        case NODE_LOGICAL_EXPR:
+            return true;
+        case NODE_UNARY_EXPR:
+            return parent->as.unary_expr.op == TOKEN_NOT;
+        case NODE_ASK_QUERY:
+            return parent->as.ask_query.condition == node;
+        case NODE_TELL_QUERY:
+            return parent->as.tell_query.condition == node;
+        case NODE_FIND_QUERY:
+            return parent->as.find_query.condition == node;
+        case NODE_SHOW_QUERY:
+            return parent->as.show_query.condition == node;
+        case NODE_GET_QUERY:
+            return parent->as.get_query.condition == node;
+        case NODE_REMOVE_ACTION:
+            return parent->as.remove_action.condition == node;
+        case NODE_JOIN:
+            return parent->as.join.condition == node;
+        case NODE_GROUP_BY:
+            return parent->as.group_by.having == node;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Visitor callback that stops the walk at the first ? placeholder.
+ *
+ * @param frame The node.
+ * @param user_data Unused.
+ * @return AST_VISIT_STOP for a NODE_PARAMETER, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction find_parameter(const AstVisitFrame* frame, void* user_data) {
+    (void)user_data;
+    return frame->node->type == NODE_PARAMETER ? AST_VISIT_STOP : AST_VISIT_CONTINUE;
+}
+
+/**
+ * Check whether a subtree holds a ? placeholder.
+ *
+ * @param node The subtree.
+ * @return true if a NODE_PARAMETER is found.
+ */
+static bool has_parameter(Node* node) {
+    AstVisitor visitor = {find_parameter, NULL, NULL, false};
+    return !ast_visit(node, &visitor);
+}
+
+/**
+ * Free a subtree that was removed from the tree.
+ *
+ * @param optimizer The optimizer.
+ * @param node The subtree.
+ */
+static void discard(Optimizer* optimizer, Node* node) {
+    if (!optimizer->in_arena)
+        free_node(node);
+}
+
+/**
+ * Free the node itself once its children and fields have been moved elsewhere.
+ *
+ * @param optimizer The optimizer.
+ * @param node The node.
+ */
+static void discard_shell(Optimizer* optimizer, Node* node) {
+    if (!optimizer->in_arena)
+        free(node);
+}
+
+/**
+ * Turn a node into a numeric literal.
+ *
+ * The node's children and fields must already have been discarded.
+ *
+ * @param node The node.
+ * @param type TOKEN_INTEGER or TOKEN_DECIMAL.
+ * @param value The value.
+ */
+static void make_number(Node* node, NsqlTokenType type, double value) {
+    node->type                          = NODE_LITERAL;
+    node->flags                         = 0;
+    node->as.literal.literal_type       = type;
+    node->as.literal.value.number_value = value;
+    node->as.literal.length             = 0;
+}
+
+/**
+ * Replace a node with one of its descendants.
+ *
+ * @param optimizer The optimizer.
+ * @param node The node, whose own fields must already have been discarded.
+ * @param replacement The descendant, whose shell is freed once it has been copied.
+ */
+static void replace_node(Optimizer* optimizer, Node* node, Node* replacement) {
+    *node = *replacement;
+    discard_shell(optimizer, replacement);
+}
+
+/**
+ * Compute arithmetic on two integer literals.
+ *
+ * Decimals are not folded: the sum of two decimals in a double is not always the decimal an
+ * executor computes, as with 0.1 + 0.2, and a folded result would then compare unequal to it.
+ *
+ * @param op The operator.
+ * @param left The left operand.
+ * @param right The right operand.
+ * @param value Receives the result.
+ * @return false if the operation is not folded.
+ */
+static bool fold_arithmetic(NsqlTokenType op, const Node* left, const Node* right, double* value) {
+    // Integer literals hold int values, so their results fit in an int64_t
+    int64_t x = (int64_t)left->as.literal.value.number_value;
+    int64_t y = (int64_t)right->as.literal.value.number_value;
+    int64_t result;
+    switch (op) {
+        case TOKEN_PLUS:
+            result = x + y;
+            break;
+        case TOKEN_MINUS:
+            result = x - y;
+            break;
+        case TOKEN_STAR:
+            result = x * y;
+            break;
+        case TOKEN_SLASH:
+            // Only exact division gives every executor the same answer
+            if (y == 0 || x % y != 0)
+                return false;
+            result = x / y;
+            break;
+        case TOKEN_PERCENT:
+            if (y == 0)
+                return false;
+            result = x % y;
+            break;
+        default:
+            return false;
+    }
+
+    *value = (double)result;
+    return result >= INT_MIN && result <= INT_MAX;
+}
+
+/**
+ * Compare two literals.
+ *
+ * Decimals are left to the executor for the same reason fold_arithmetic() leaves them.
+ *
+ * @param op The comparison.
+ * @param left The left operand.
+ * @param right The right operand.
+ * @param result Receives the outcome.
+ * @return false if the comparison is not folded.
+ */
+static bool fold_comparison(NsqlTokenType op, const Node* left, const Node* right, bool* result) {
+    if (is_integer(left) && is_integer(right)) {
+        double a = left->as.literal.value.number_value;
+        double b = right->as.literal.value.number_value;
+        switch (op) {
+            case TOKEN_EQUAL:
+                *result = a == b;
+                return true;
+            case TOKEN_NEQ:
+                *result = a != b;
+                return true;
+            case TOKEN_LT:
+                *result = a < b;
+                return true;
+            case TOKEN_LTE:
+                *result = a <= b;
+                return true;
+            case TOKEN_GT:
+                *result = a > b;
+                return true;
+            case TOKEN_GTE:
+                *result = a >= b;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Ordering of strings depends on the executor's collation, equality does not
+    if (is_string(left) && is_string(right) && (op == TOKEN_EQUAL || op == TOKEN_NEQ)) {
+        bool equal = left->as.literal.length == right->as.literal.length &&
+                     memcmp(left->as.literal.value.string_value,
+                            right->as.literal.value.string_value,
+                            (size_t)left->as.literal.length) == 0;
+        *result    = op == TOKEN_EQUAL ? equal : !equal;
+        return true;
+    }
+
+    return false;
+}
+
+/**
+ * Get the comparison that holds with its operands swapped.
+ *
+ * @param op The comparison.
+ * @return The mirrored comparison.
+ */
+static NsqlTokenType mirror(NsqlTokenType op) {
+    switch (op) {
+        case TOKEN_LT:
+            return TOKEN_GT;
+        case TOKEN_LTE:
+            return TOKEN_GTE;
+        case TOKEN_GT:
+            return TOKEN_LT;
+        case TOKEN_GTE:
+            return TOKEN_LTE;
+        default:
+            return op;
+    }
+}
+
+/**
+ * Simplify a binary expression whose operands have been simplified.
+ *
+ * @param optimizer The optimizer.
+ * @param node The expression.
+ */
+static void optimize_binary(Optimizer* optimizer, Node* node) {
+    Node*         left  = node->as.binary_expr.left;
+    Node*         right = node->as.binary_expr.right;
+    NsqlTokenType op    = node->as.binary_expr.op;
+    if (left == NULL || right == NULL)
+        return;
+
+    double value;
+    bool   result;
+    if (is_integer(left) && is_integer(right) && fold_arithmetic(op, left, right, &value)) {
+        discard(optimizer, left);
+        discard(optimizer, right);
+        make_number(node, TOKEN_INTEGER, value);
+        optimizer->rewrites++;
+        return;
+    }
+    if (is_comparison(op) && fold_comparison(op, left, right, &result)) {
+        discard(optimizer, left);
+        discard(optimizer, right);
+        make_number(node, TOKEN_INTEGER, result ? 1 : 0);
+        optimizer->rewrites++;
+        return;
+    }
+
+    // Put the constant last; + and * only commute when both operands are numbers
+    bool swap = left->type == NODE_LITERAL && right->type != NODE_LITERAL &&
+                (is_comparison(op) ||
+                 ((op == TOKEN_PLUS || op == TOKEN_STAR) && is_number(left) && is_numeric(right)));
+    if (swap) {
+        node->as.binary_expr.left  = right;
+        node->as.binary_expr.right = left;
+        node->as.binary_expr.op    = mirror(op);
+        optimizer->rewrites++;
+    }
+}
+
+/**
+ * Simplify a unary expression whose operand has been simplified.
+ *
+ * @param optimizer The optimizer.
+ * @param frame The expression and its parent.
+ */
+static void optimize_unary(Optimizer* optimizer, const AstVisitFrame* frame) {
+    Node* node    = frame->node;
+    Node* operand = node->as.unary_expr.operand;
+    if (operand == NULL)
+        return;
+
+    if (is_number(operand)) {
+        double        value = operand->as.literal.value.number_value;
+        NsqlTokenType type  = operand->as.literal.literal_type;
+        if (node->as.unary_expr.op == TOKEN_NOT) {
+            value = value == 0 ? 1 : 0;
+            type  = TOKEN_INTEGER;
+        } else if (type == TOKEN_DECIMAL) {
+            value = -value;
+        } else if (value != INT_MIN) {
+            value = value != 0 ? -value : 0;
+        } else {
+            return;
+        }
+
+        discard(optimizer, operand);
+        make_number(node, type, value);
+        optimizer->rewrites++;
+        return;
+    }
+
+    // NOT NOT x is the truth of x, which is x itself if x is a condition or only its truth counts
+    if (node->as.unary_expr.op == TOKEN_NOT && operand->type == NODE_UNARY_EXPR &&
+        operand->as.unary_expr.op == TOKEN_NOT && operand->as.unary_expr.operand != NULL) {
+        Node* inner = operand->as.unary_expr.operand;
+        if (is_boolean(inner) || in_condition(frame)) {
+            discard_shell(optimizer, operand);
+            replace_node(optimizer, node, inner);
+            optimizer->rewrites++;
+        }
+    }
+}
+
+/**
+ * Simplify an AND or OR chain whose operands have been simplified.
+ *
+ * @param optimizer The optimizer.
+ * @param frame The chain and its parent.
+ */
+static void optimize_logical(Optimizer* optimizer, const AstVisitFrame* frame) {
+    Node*  node     = frame->node;
+    Node** operands = node->as.logical_expr.operands;
+    int    count    = node->as.logical_expr.count;
+    bool   is_and   = node->as.logical_expr.op == TOKEN_AND;
+
+    // A false operand of AND or a true operand of OR decides the chain, other known ones drop out
+    int  kept      = 0;
+    bool decided   = false;
+    bool droppable = false;
+    for (int i = 0; i < count; i++) {
+        if (!is_number(operands[i])) {
+            kept++;
+            continue;
+        }
+        bool truth = operands[i]->as.literal.value.number_value != 0;
+        if (truth != is_and) {
+            decided = true;
+            break;
+        }
+        droppable = true;
+    }
+
+    // Folding a chain away would leave its placeholders without a node to bind to
+    if (decided) {
+        for (int i = 0; i < count; i++) {
+            if (has_parameter(operands[i]))
+                return;
+        }
+    }
+
+    if (decided || kept == 0) {
+        for (int i = 0; i < count; i++) {
+            discard(optimizer, operands[i]);
+        }
+        if (!optimizer->in_arena)
+            free(operands);
+        make_number(node, TOKEN_INTEGER, decided != is_and ? 1 : 0);
+        optimizer->rewrites++;
+        return;
+    }
+    if (!droppable)
+        return;
+
+    // A single operand only stands in for the chain where its truth is what counts
+    Node* last = NULL;
+    for (int i = 0; i < count; i++) {
+        if (!is_number(operands[i]))
+            last = operands[i];
+    }
+    if (kept == 1 && !is_boolean(last) && !in_condition(frame))
+        return;
+
+    int out = 0;
+    for (int i = 0; i < count; i++) {
+        if (is_number(operands[i])) {
+            discard(optimizer, operands[i]);
+            optimizer->rewrites++;
+        } else {
+            operands[out++] = operands[i];
+        }
+    }
+    node->as.logical_expr.count = out;
+
+    if (out == 1) {
+        if (!optimizer->in_arena)
+            free(operands);
+        replace_node(optimizer, node, last);
+    }
+}
+
+/**
+ * Drop a condition that is always true.
+ *
+ * @param optimizer The optimizer.
+ * @param condition The condition slot of a query or action.
+ */
+static void drop_true_condition(Optimizer* optimizer, Node** condition) {
+    if (is_number(*condition) && (*condition)->as.literal.value.number_value != 0) {
+        discard(optimizer, *condition);
+        *condition = NULL;
+        optimizer->rewrites++;
+    }
+}
+
+/**
+ * Visitor callback that simplifies a node once its children are done.
+ *
+ * @param frame The node and its parent.
+ * @param user_data The Optimizer.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction optimize_node(const AstVisitFrame* frame, void* user_data) {
+    Optimizer* optimizer = (Optimizer*)user_data;
+    Node*      node      = frame->node;
+
+    switch (node->type) {
+        case NODE_BINARY_EXPR:
+            optimize_binary(optimizer, node);
+            break;
+        case NODE_UNARY_EXPR:
+            optimize_unary(optimizer, frame);
+            break;
+        case NODE_LOGICAL_EXPR:
+            optimize_logical(optimizer, frame);
+            break;
+        case NODE_ASK_QUERY:
+            drop_true_condition(optimizer, &node->as.ask_query.condition);
+            break;
+        case NODE_TELL_QUERY:
+            drop_true_condition(optimizer, &node->as.tell_query.condition);
+            break;
+        case NODE_FIND_QUERY:
+            drop_true_condition(optimizer, &node->as.find_query.condition);
+            break;
+        case NODE_SHOW_QUERY:
+            drop_true_condition(optimizer, &node->as.show_query.condition);
+            break;
+        case NODE_GET_QUERY:
+            drop_true_condition(optimizer, &node->as.get_query.condition);
+            break;
+        case NODE_REMOVE_ACTION:
+            drop_true_condition(optimizer, &node->as.remove_action.condition);
+            break;
+        case NODE_GROUP_BY:
+            drop_true_condition(optimizer, &node->as.group_by.having);
+            break;
+        default:
+            break;
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Simplify a tree in place.
+ *
+ * @param root Root of the tree.
+ * @param in_arena Whether the tree was built with parser_init_with_arena().
+ * @return The number of rewrites made.
+ */
+size_t ast_optimize(Node* root, bool in_arena) {
+    Optimizer  optimizer = {in_arena, 0};
+    AstVisitor visitor   = {NULL, optimize_node, &optimizer, false};
+    ast_visit(root, &visitor);
+    return optimizer.rewrites;
+}
@@ -0,0 +1,834 @@
+/**
+ * @file ast_pool.c
+ * @brief Compact, contiguous representation of ASTs
+ */
+
+#include <nsql/ast_pool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Grow an array to hold at least the given number of entries.
+ *
+ * @param data The array (may be NULL).
+ * @param capacity The allocated entries, updated on growth.
+ * @param needed The number of entries needed.
+ * @param size The size of an entry.
+ * @return The array, possibly moved.
+ */
+static void* grow_array(void* data, size_t* capacity, size_t needed, size_t size) {
+    if (needed <= *capacity)
+        return data;
+
+    size_t new_capacity = *capacity > 0 ? *capacity : 64;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    void* grown = realloc(data, new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+/**
+ * Check whether nodes of a type own child slots.
+ *
+ * @param type The node type.
+ * @return true if FlatNode.as.children is in use.
+ */
+static bool has_children(NodeType type) {
+    switch (type) {
+        case NODE_ASK_QUERY:
+        case NODE_TELL_QUERY:
+        case NODE_FIND_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+        case NODE_FIELD_LIST:
+        case NODE_SOURCE:
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ORDER_BY:
+        case NODE_ADD_ACTION:
+        case NODE_REMOVE_ACTION:
+        case NODE_UPDATE_ACTION:
+        case NODE_CREATE_ACTION:
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+        case NODE_FIELD_DEF:
+        case NODE_CONSTRAINT:
+        case NODE_FUNCTION_CALL:
+        case NODE_PROGRAM:
+        case NODE_LOGICAL_EXPR:
+        case NODE_IN_LIST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// =======================================================
+// Node to pool
+// =======================================================
+
+/**
+ * Append a node with the common fields of a Node and an empty payload.
+ *
+ * @param pool The pool.
+ * @param node The node to copy the fields of.
+ * @return Index of the new node, or NODE_INDEX_NONE if the pool is full.
+ */
+static NodeIndex new_node(AstPool* pool, const Node* node) {
+    if (pool->node_count >= NODE_INDEX_NONE)
+        return NODE_INDEX_NONE;
+
+    pool->nodes = (FlatNode*)grow_array(pool->nodes, &pool->node_capacity, pool->node_count + 1,
+                                        sizeof(FlatNode));
+
+    FlatNode* flat = &pool->nodes[pool->node_count];
+    memset(flat, 0, sizeof(FlatNode));
+    flat->type  = (uint8_t)node->type;
+    flat->flags = (uint16_t)(node->flags & ~NODE_FLAG_BORROWED);
+    flat->line  = node->line;
+    return (NodeIndex)pool->node_count++;
+}
+
+/**
+ * Give a node a run of absent child slots, followed by zeroed words.
+ *
+ * @param pool The pool.
+ * @param index The node.
+ * @param count Number of child slots.
+ * @param words Number of words after the slots.
+ * @return false if the pool is full.
+ */
+static bool new_slots(AstPool* pool, NodeIndex index, size_t count, size_t words) {
+    size_t total = count + words;
+    if (total > NODE_INDEX_NONE - pool->slot_count)
+        return false;
+
+    pool->slots = (uint32_t*)grow_array(pool->slots, &pool->slot_capacity,
+                                        pool->slot_count + total, sizeof(uint32_t));
+    for (size_t i = 0; i < total; i++) {
+        pool->slots[pool->slot_count + i] = i < count ? NODE_INDEX_NONE : 0;
+    }
+
+    FlatNode* flat          = &pool->nodes[index];
+    flat->as.children.first = (uint32_t)pool->slot_count;
+    flat->as.children.count = (uint32_t)count;
+    pool->slot_count += total;
+    return true;
+}
+
+/**
+ * Copy a string into a pool.
+ *
+ * @param pool The pool.
+ * @param str The characters to copy (may be NULL).
+ * @param length The number of characters to copy.
+ * @param offset Receives the offset of the copy, or NODE_INDEX_NONE if str is NULL.
+ * @return false if the pool is full.
+ */
+static bool new_string(AstPool* pool, const char* str, size_t length, uint32_t* offset) {
+    if (!str) {
+        *offset = NODE_INDEX_NONE;
+        return true;
+    }
+    if (length >= NODE_INDEX_NONE - pool->string_size)
+        return false;
+
+    pool->strings = (char*)grow_array(pool->strings, &pool->string_capacity,
+                                      pool->string_size + length + 1, 1);
+    memcpy(pool->strings + pool->string_size, str, length);
+    pool->strings[pool->string_size + length] = '\0';
+
+    *offset = (uint32_t)pool->string_size;
+    pool->string_size += length + 1;
+    return true;
+}
+
+/**
+ * A child waiting to be copied into a pool.
+ */
+typedef struct {
+    const Node* node;  // The child
+    size_t      slot;  // Slot that receives its index (SIZE_MAX for the root)
+} PendingChild;
+
+/**
+ * The children still to be copied, on the heap so that deep trees do not exhaust the C stack.
+ */
+typedef struct {
+    PendingChild* items;     // Children, the next to copy last
+    size_t        count;     // Number of children
+    size_t        capacity;  // Allocated entries
+} PendingStack;
+
+/**
+ * Queue a child to be copied into a pool and have its index stored in a slot.
+ *
+ * @param stack The children still to be copied.
+ * @param slot The slot.
+ * @param child The child (NULL leaves the slot absent).
+ */
+static void add_child(PendingStack* stack, size_t slot, const Node* child) {
+    if (!child)
+        return;
+
+    stack->items = (PendingChild*)grow_array(stack->items, &stack->capacity, stack->count + 1,
+                                             sizeof(PendingChild));
+    stack->items[stack->count].node = child;
+    stack->items[stack->count].slot = slot;
+    stack->count++;
+}
+
+/**
+ * Give a node one slot per child and queue the children to be copied into them.
+ *
+ * @param pool The pool.
+ * @param stack The children still to be copied.
+ * @param index The node.
+ * @param children The children in slot order (entries may be NULL).
+ * @param count Number of children.
+ * @param words Number of zeroed words to reserve after the slots.
+ * @return false if the pool is full.
+ */
+static bool add_children(AstPool* pool, PendingStack* stack, NodeIndex index,
+                         Node* const* children, size_t count, size_t words) {
+    if (!new_slots(pool, index, count, words))
+        return false;
+
+    size_t first = pool->nodes[index].as.children.first;
+    for (size_t i = 0; i < count; i++) {
+        add_child(stack, first + i, children[i]);
+    }
+    return true;
+}
+
+/**
+ * Copy a node into a pool and queue its children.
+ *
+ * @param pool The pool.
+ * @param stack The children still to be copied, which receives the children of the node.
+ * @param node The node.
+ * @return Index of the copied node, or NODE_INDEX_NONE if the pool is full.
+ */
+static NodeIndex add_node(AstPool* pool, PendingStack* stack, const Node* node) {
+    NodeIndex index = new_node(pool, node);
+    size_t    mark  = stack->count;
+    if (index == NODE_INDEX_NONE)
+        return NODE_INDEX_NONE;
+
+    FlatNode* flat = &pool->nodes[index];
+    bool      ok   = true;
+    size_t    first;
+    uint32_t  offset;
+
+    // The children are added after the node's own fields, since adding them moves the nodes
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY: {
+            Node* children[] = {node->as.ask_query.source,   node->as.ask_query.fields,
+                                node->as.ask_query.condition, node->as.ask_query.group_by,
+                                node->as.ask_query.order_by,  node->as.ask_query.limit};
+            ok = add_children(pool, stack, index, children, 6, 0);
+            break;
+        }
+
+        case NODE_TELL_QUERY: {
+            Node* children[] = {node->as.tell_query.source, node->as.tell_query.action,
+                                node->as.tell_query.condition};
+            ok = add_children(pool, stack, index, children, 3, 0);
+            break;
+        }
+
+        case NODE_FIND_QUERY: {
+            Node* children[] = {node->as.find_query.source, node->as.find_query.condition,
+                                node->as.find_query.group_by, node->as.find_query.order_by,
+                                node->as.find_query.limit};
+            ok = add_children(pool, stack, index, children, 5, 0);
+            break;
+        }
+
+        case NODE_FIELD_LIST:
+            ok = add_children(pool, stack, index, node->as.field_list.fields,
+                              (size_t)node->as.field_list.count, 0);
+            break;
+
+        case NODE_SOURCE: {
+            Node* children[] = {node->as.source.identifier, node->as.source.join};
+            ok = add_children(pool, stack, index, children, 2, 0);
+            break;
+        }
+
+        case NODE_JOIN: {
+            Node* children[] = {node->as.join.source, node->as.join.condition};
+            ok = add_children(pool, stack, index, children, 2, 0);
+            break;
+        }
+
+        case NODE_GROUP_BY: {
+            Node* children[] = {node->as.group_by.fields, node->as.group_by.having};
+            ok = add_children(pool, stack, index, children, 2, 0);
+            break;
+        }
+
+        case NODE_ORDER_BY: {
+            size_t count = (size_t)node->as.order_by.count;
+            if (!new_slots(pool, index, count, (count + 31) / 32))
+                return NODE_INDEX_NONE;
+            first = pool->nodes[index].as.children.first;
+            for (size_t i = 0; i < count && node->as.order_by.ascending; i++) {
+                if (node->as.order_by.ascending[i])
+                    pool->slots[first + count + i / 32] |= 1U << (i % 32);
+            }
+            for (size_t i = 0; i < count; i++) {
+                add_child(stack, first + i, node->as.order_by.fields[i]);
+            }
+            break;
+        }
+
+        case NODE_LIMIT:
+            flat->as.limit.limit  = node->as.limit.limit;
+            flat->as.limit.offset = node->as.limit.offset;
+            break;
+
+        case NODE_ADD_ACTION: {
+            Node* children[] = {node->as.add_action.value, node->as.add_action.record_spec};
+            ok = add_children(pool, stack, index, children, 2, 0);
+            break;
+        }
+
+        case NODE_REMOVE_ACTION:
+            ok = add_children(pool, stack, index, &node->as.remove_action.condition, 1, 0);
+            break;
+
+        case NODE_UPDATE_ACTION:
+            // Each field is followed by its value
+            if (!new_slots(pool, index, 2 * (size_t)node->as.update_action.count, 0))
+                return NODE_INDEX_NONE;
+            first = pool->nodes[index].as.children.first;
+            for (int i = 0; i < node->as.update_action.count; i++) {
+                add_child(stack, first + 2 * (size_t)i, node->as.update_action.fields[i]);
+                add_child(stack, first + 2 * (size_t)i + 1, node->as.update_action.values[i]);
+            }
+            break;
+
+        case NODE_CREATE_ACTION:
+            ok = add_children(pool, stack, index, node->as.create_action.field_defs,
+                              (size_t)node->as.create_action.count, 0);
+            break;
+
+        case NODE_BINARY_EXPR: {
+            Node* children[] = {node->as.binary_expr.left, node->as.binary_expr.right};
+            flat->op         = (uint8_t)node->as.binary_expr.op;
+            ok               = add_children(pool, stack, index, children, 2, 0);
+            break;
+        }
+
+        case NODE_UNARY_EXPR:
+            flat->op = (uint8_t)node->as.unary_expr.op;
+            ok       = add_children(pool, stack, index, &node->as.unary_expr.operand, 1, 0);
+            break;
+
+        case NODE_IDENTIFIER:
+            ok = new_string(pool, node->as.identifier.name, (size_t)node->as.identifier.length,
+                            &offset);
+            pool->nodes[index].as.string.offset = offset;
+            pool->nodes[index].as.string.length = (uint32_t)node->as.identifier.length;
+            break;
+
+        case NODE_LITERAL:
+            flat->op = (uint8_t)node->as.literal.literal_type;
+            if (node->as.literal.literal_type != TOKEN_STRING) {
+                flat->as.number = node->as.literal.value.number_value;
+                break;
+            }
+            ok = new_string(pool, node->as.literal.value.string_value,
+                            (size_t)node->as.literal.length, &offset);
+            pool->nodes[index].as.string.offset = offset;
+            pool->nodes[index].as.string.length = (uint32_t)node->as.literal.length;
+            break;
+
+        case NODE_FIELD_DEF: {
+            // The name comes before the constraints, and the type after them
+            size_t count = 1 + (size_t)node->as.field_def.constraint_count;
+            if (!new_slots(pool, index, count, 1))
+                return NODE_INDEX_NONE;
+            first = pool->nodes[index].as.children.first;
+            add_child(stack, first, node->as.field_def.name);
+            for (size_t i = 1; i < count; i++) {
+                add_child(stack, first + i, node->as.field_def.constraints[i - 1]);
+            }
+            const char* type = node->as.field_def.type;
+            ok = new_string(pool, type, type ? strlen(type) : 0, &pool->slots[first + count]);
+            break;
+        }
+
+        case NODE_CONSTRAINT:
+            flat->op = (uint8_t)node->as.constraint.type;
+            ok       = add_children(pool, stack, index, &node->as.constraint.default_value, 1, 0);
+            break;
+
+        case NODE_FUNCTION_CALL: {
+            size_t      count = (size_t)node->as.function_call.arg_count;
+            const char* name  = node->as.function_call.name;
+            ok = add_children(pool, stack, index, node->as.function_call.args, count, 1);
+            if (ok) {
+                first = pool->nodes[index].as.children.first;
+                ok    = new_string(pool, name, name ? strlen(name) : 0,
+                                   &pool->slots[first + count]);
+            }
+            break;
+        }
+
+        case NODE_ERROR: {
+            const char* message = node->as.error.message;
+            ok = new_string(pool, message, message ? strlen(message) : 0, &offset);
+            pool->nodes[index].as.string.offset = offset;
+            pool->nodes[index].as.string.length = message ? (uint32_t)strlen(message) : 0;
+            break;
+        }
+
+        case NODE_PROGRAM:
+            ok = add_children(pool, stack, index, node->as.program.statements,
+                              (size_t)node->as.program.count, 0);
+            break;
+
+        case NODE_PARAMETER:
+            flat->as.parameter = node->as.parameter.index;
+            break;
+
+        case NODE_LOGICAL_EXPR:
+            flat->op = (uint8_t)node->as.logical_expr.op;
+            ok       = add_children(pool, stack, index, node->as.logical_expr.operands,
+                                    (size_t)node->as.logical_expr.count, 0);
+            break;
+
+        case NODE_IN_LIST: {
+            // The value comes before the items
+            size_t count = 1 + (size_t)node->as.in_list.count;
+            if (!new_slots(pool, index, count, 0))
+                return NODE_INDEX_NONE;
+            first = pool->nodes[index].as.children.first;
+            add_child(stack, first, node->as.in_list.value);
+            for (size_t i = 1; i < count; i++) {
+                add_child(stack, first + i, node->as.in_list.items[i - 1]);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    // The children were queued in slot order, and are reversed so that the first is copied next
+    for (size_t i = mark, j = stack->count; i + 1 < j; i++, j--) {
+        PendingChild swap   = stack->items[i];
+        stack->items[i]     = stack->items[j - 1];
+        stack->items[j - 1] = swap;
+    }
+    return ok ? index : NODE_INDEX_NONE;
+}
+
+// =======================================================
+// Pool to Node
+// =======================================================
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param size The size in bytes.
+ * @return The allocation.
+ */
+static void* checked_malloc(size_t size) {
+    void* result = malloc(size > 0 ? size : 1);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Copy a string out of a pool.
+ *
+ * @param pool The pool.
+ * @param offset Offset of the string (NODE_INDEX_NONE for NULL).
+ * @param length Length of the string in bytes.
+ * @return The null-terminated copy, or NULL if offset is NODE_INDEX_NONE.
+ */
+static char* copy_string(const AstPool* pool, uint32_t offset, size_t length) {
+    if (offset == NODE_INDEX_NONE)
+        return NULL;
+
+    char* copy = (char*)checked_malloc(length + 1);
+    memcpy(copy, pool->strings + offset, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * Take the built child of a slot, so that it is owned by exactly one parent.
+ *
+ * @param built The nodes built so far, indexed from root.
+ * @param root Index of the root.
+ * @param child Index of the child (NODE_INDEX_NONE for none).
+ * @return The child, or NULL if it is absent.
+ */
+static Node* take_child(Node** built, NodeIndex root, NodeIndex child) {
+    if (child == NODE_INDEX_NONE)
+        return NULL;
+
+    Node* result        = built[child - root];
+    built[child - root] = NULL;
+    return result;
+}
+
+/**
+ * Take the built children of a run of slots into a new array.
+ *
+ * @param pool The pool.
+ * @param built The nodes built so far, indexed from root.
+ * @param root Index of the root.
+ * @param first The first slot.
+ * @param count Number of slots.
+ * @return The array (at least one entry long).
+ */
+static Node** take_children(const AstPool* pool, Node** built, NodeIndex root, size_t first,
+                            size_t count) {
+    Node** children = (Node**)checked_malloc(count * sizeof(Node*));
+    for (size_t i = 0; i < count; i++) {
+        children[i] = take_child(built, root, pool->slots[first + i]);
+    }
+    return children;
+}
+
+/**
+ * Build a Node from a pooled node whose children are already built.
+ *
+ * @param pool The pool.
+ * @param index The pooled node.
+ * @param built The nodes built so far, indexed from root.
+ * @param root Index of the root.
+ * @return The node.
+ */
+static Node* build_node(const AstPool* pool, NodeIndex index, Node** built, NodeIndex root) {
+    const FlatNode* flat = &pool->nodes[index];
+    Node*           node = (Node*)checked_malloc(sizeof(Node));
+    memset(node, 0, sizeof(Node));
+    node->type  = (NodeType)flat->type;
+    node->line  = flat->line;
+    node->flags = flat->flags;
+
+    size_t first = flat->as.children.first;
+    size_t count = flat->as.children.count;
+
+#define CHILD(slot) take_child(built, root, pool->slots[first + (slot)])
+
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            node->as.ask_query.source    = CHILD(0);
+            node->as.ask_query.fields    = CHILD(1);
+            node->as.ask_query.condition = CHILD(2);
+            node->as.ask_query.group_by  = CHILD(3);
+            node->as.ask_query.order_by  = CHILD(4);
+            node->as.ask_query.limit     = CHILD(5);
+            break;
+
+        case NODE_TELL_QUERY:
+            node->as.tell_query.source    = CHILD(0);
+            node->as.tell_query.action    = CHILD(1);
+            node->as.tell_query.condition = CHILD(2);
+            break;
+
+        case NODE_FIND_QUERY:
+            node->as.find_query.source    = CHILD(0);
+            node->as.find_query.condition = CHILD(1);
+            node->as.find_query.group_by  = CHILD(2);
+            node->as.find_query.order_by  = CHILD(3);
+            node->as.find_query.limit     = CHILD(4);
+            break;
+
+        case NODE_FIELD_LIST:
+            node->as.field_list.fields = take_children(pool, built, root, first, count);
+            node->as.field_list.count  = (int)count;
+            break;
+
+        case NODE_SOURCE:
+            node->as.source.identifier = CHILD(0);
+            node->as.source.join       = CHILD(1);
+            break;
+
+        case NODE_JOIN:
+            node->as.join.source    = CHILD(0);
+            node->as.join.condition = CHILD(1);
+            break;
+
+        case NODE_GROUP_BY:
+            node->as.group_by.fields = CHILD(0);
+            node->as.group_by.having = CHILD(1);
+            break;
+
+        case NODE_ORDER_BY:
+            node->as.order_by.fields    = take_children(pool, built, root, first, count);
+            node->as.order_by.ascending = (bool*)checked_malloc(count * sizeof(bool));
+            node->as.order_by.count     = (int)count;
+            for (size_t i = 0; i < count; i++) {
+                node->as.order_by.ascending[i] = ast_pool_ascending(pool, flat, (uint32_t)i);
+            }
+            break;
+
+        case NODE_LIMIT:
+            node->as.limit.limit  = flat->as.limit.limit;
+            node->as.limit.offset = flat->as.limit.offset;
+            break;
+
+        case NODE_ADD_ACTION:
+            node->as.add_action.value       = CHILD(0);
+            node->as.add_action.record_spec = CHILD(1);
+            break;
+
+        case NODE_REMOVE_ACTION:
+            node->as.remove_action.condition = CHILD(0);
+            break;
+
+        case NODE_UPDATE_ACTION:
+            node->as.update_action.count  = (int)(count / 2);
+            node->as.update_action.fields = (Node**)checked_malloc(count / 2 * sizeof(Node*));
+            node->as.update_action.values = (Node**)checked_malloc(count / 2 * sizeof(Node*));
+            for (size_t i = 0; i < count / 2; i++) {
+                node->as.update_action.fields[i] = CHILD(2 * i);
+                node->as.update_action.values[i] = CHILD(2 * i + 1);
+            }
+            break;
+
+        case NODE_CREATE_ACTION:
+            node->as.create_action.field_defs = take_children(pool, built, root, first, count);
+            node->as.create_action.count      = (int)count;
+            break;
+
+        case NODE_BINARY_EXPR:
+            node->as.binary_expr.op    = (NsqlTokenType)flat->op;
+            node->as.binary_expr.left  = CHILD(0);
+            node->as.binary_expr.right = CHILD(1);
+            break;
+
+        case NODE_UNARY_EXPR:
+            node->as.unary_expr.op      = (NsqlTokenType)flat->op;
+            node->as.unary_expr.operand = CHILD(0);
+            break;
+
+        case NODE_IDENTIFIER:
+            node->as.identifier.name =
+                copy_string(pool, flat->as.string.offset, flat->as.string.length);
+            node->as.identifier.length = (int)flat->as.string.length;
+            break;
+
+        case NODE_LITERAL:
+            node->as.literal.literal_type = (NsqlTokenType)flat->op;
+            if (node->as.literal.literal_type == TOKEN_STRING) {
+                node->as.literal.value.string_value =
+                    copy_string(pool, flat->as.string.offset, flat->as.string.length);
+                node->as.literal.length = (int)flat->as.string.length;
+            } else {
+                node->as.literal.value.number_value = flat->as.number;
+            }
+            break;
+
+        case NODE_FIELD_DEF: {
+            const char* type = ast_pool_string(pool, pool->slots[first + count]);
+            node->as.field_def.name = CHILD(0);
+            node->as.field_def.type = copy_string(pool, pool->slots[first + count],
+                                                  type ? strlen(type) : 0);
+            node->as.field_def.constraints =
+                take_children(pool, built, root, first + 1, count - 1);
+            node->as.field_def.constraint_count = (int)count - 1;
+            break;
+        }
+
+        case NODE_CONSTRAINT:
+            node->as.constraint.type          = (ConstraintType)flat->op;
+            node->as.constraint.default_value = CHILD(0);
+            break;
+
+        case NODE_FUNCTION_CALL: {
+            const char* name            = ast_pool_string(pool, pool->slots[first + count]);
+            node->as.function_call.name = copy_string(pool, pool->slots[first + count],
+                                                      name ? strlen(name) : 0);
+            node->as.function_call.args      = take_children(pool, built, root, first, count);
+            node->as.function_call.arg_count = (int)count;
+            break;
+        }
+
+        case NODE_ERROR:
+            node->as.error.message =
+                copy_string(pool, flat->as.string.offset, flat->as.string.length);
+            break;
+
+        case NODE_PROGRAM:
+            node->as.program.statements = take_children(pool, built, root, first, count);
+            node->as.program.count      = (int)count;
+            break;
+
+        case NODE_PARAMETER:
+            node->as.parameter.index = flat->as.parameter;
+            break;
+
+        case NODE_LOGICAL_EXPR:
+            node->as.logical_expr.op       = (NsqlTokenType)flat->op;
+            node->as.logical_expr.operands = take_children(pool, built, root, first, count);
+            node->as.logical_expr.count    = (int)count;
+            break;
+
+        case NODE_IN_LIST:
+            node->as.in_list.value = CHILD(0);
+            node->as.in_list.items = take_children(pool, built, root, first + 1, count - 1);
+            node->as.in_list.count = (int)count - 1;
+            break;
+
+        default:
+            break;
+    }
+
+#undef CHILD
+
+    return node;
+}
+
+// =======================================================
+// Public API
+// =======================================================
+
+/**
+ * Initialize an empty pool.
+ *
+ * @param pool The pool to initialize.
+ */
+void ast_pool_init(AstPool* pool) {
+    memset(pool, 0, sizeof(AstPool));
+}
+
+/**
+ * Remove every tree from a pool, keeping its memory.
+ *
+ * @param pool The pool to reset.
+ */
+void ast_pool_reset(AstPool* pool) {
+    pool->node_count  = 0;
+    pool->slot_count  = 0;
+    pool->string_size = 0;
+}
+
+/**
+ * Free all memory owned by a pool.
+ *
+ * @param pool The pool to free.
+ */
+void ast_pool_free(AstPool* pool) {
+    if (!pool)
+        return;
+
+    free(pool->nodes);
+    free(pool->slots);
+    free(pool->strings);
+    ast_pool_init(pool);
+}
+
+/**
+ * Copy a tree into a pool.
+ *
+ * @param pool The pool to add to.
+ * @param node Root of the tree.
+ * @return Index of the copied root, or NODE_INDEX_NONE on failure.
+ */
+NodeIndex ast_pool_add(AstPool* pool, const Node* node) {
+    if (!pool || !node)
+        return NODE_INDEX_NONE;
+
+    // A tree that does not fit is removed again, so the pool only ever holds whole trees
+    size_t       node_count  = pool->node_count;
+    size_t       slot_count  = pool->slot_count;
+    size_t       string_size = pool->string_size;
+    NodeIndex    root        = NODE_INDEX_NONE;
+    PendingStack stack       = {NULL, 0, 0};
+
+    // Taking each child off the stack as it is copied stores the tree in preorder
+    add_child(&stack, SIZE_MAX, node);
+    while (stack.count > 0) {
+        PendingChild child = stack.items[--stack.count];
+        NodeIndex    index = add_node(pool, &stack, child.node);
+        if (index == NODE_INDEX_NONE) {
+            root = NODE_INDEX_NONE;
+            break;
+        }
+        if (child.slot == SIZE_MAX) {
+            root = index;
+        } else {
+            pool->slots[child.slot] = index;
+        }
+    }
+    free(stack.items);
+
+    if (root == NODE_INDEX_NONE) {
+        pool->node_count  = node_count;
+        pool->slot_count  = slot_count;
+        pool->string_size = string_size;
+    }
+    return root;
+}
+
+/**
+ * Build a Node tree from a pooled tree.
+ *
+ * @param pool The pool.
+ * @param root Index of the root.
+ * @return The tree, or NULL if root is not a node of the pool.
+ */
+Node* ast_pool_to_node(const AstPool* pool, NodeIndex root) {
+    if (!pool || root >= pool->node_count)
+        return NULL;
+
+    NodeIndex end   = ast_pool_end(pool, root);
+    Node**    built = (Node**)checked_malloc((end - root) * sizeof(Node*));
+
+    // Children follow their parent, so building from the back finds every child already built
+    for (NodeIndex index = end; index-- > root;) {
+        built[index - root] = build_node(pool, index, built, root);
+    }
+
+    Node* result = built[0];
+    free(built);
+    return result;
+}
+
+/**
+ * Find the end of a pooled tree.
+ *
+ * @param pool The pool.
+ * @param root Index of the root.
+ * @return Index one past the last descendant of root.
+ */
+NodeIndex ast_pool_end(const AstPool* pool, NodeIndex root) {
+    // The last descendant in preorder is found by following the last child down
+    NodeIndex index = root;
+    for (;;) {
+        const FlatNode* node = &pool->nodes[index];
+        NodeIndex       last = NODE_INDEX_NONE;
+        if (has_children((NodeType)node->type)) {
+            for (uint32_t i = node->as.children.count; i-- > 0 && last == NODE_INDEX_NONE;) {
+                last = ast_pool_child(pool, node, i);
+            }
+        }
+        if (last == NODE_INDEX_NONE)
+            return index + 1;
+        index = last;
+    }
+}
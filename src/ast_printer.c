@@ -1,698 +1,1234 @@
-/**
- * @file ast_printer.c
- * @brief Implementation of AST printing utilities
- */
-
-#include <nsql/ast_printer.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-/**
- * @brief Writes a string to the output destination specified in the AstPrinter.
- *
- * Writes the given string to a file or buffer, depending on the printer's output type.
- * For file output, writes using fputs. For buffer output, copies the string into the buffer,
- * ensuring null termination and preventing overflow. Returns false on write failure or if
- * called with an unsupported output type (such as callback).
- *
- * @param printer Pointer to the AstPrinter specifying the output destination.
- * @param str Null-terminated string to write. If NULL, nothing is written and the function returns
- * true.
- * @return true if the write succeeds or nothing is written; false on failure or unsupported output
- * type.
- */
-static bool printer_write(AstPrinter* printer, const char* str) {
-    if (!str)
-        return true;  // Nothing to write
-
-    size_t len = strlen(str);
-
-    switch (printer->type) {
-        case AST_OUTPUT_FILE:
-            if (fputs(str, printer->output.file) == EOF) {
-                return false;
-            }
-            break;
-
-        case AST_OUTPUT_BUFFER: {
-            size_t remaining = printer->output.buf.size - printer->output.buf.written;
-            if (len >= remaining) {
-                len = remaining > 0 ? remaining - 1 : 0;  // Reserve space for null terminator
-            }
-            if (len > 0) {
-                memcpy(printer->output.buf.buffer + printer->output.buf.written, str, len);
-                printer->output.buf.written += len;
-                // Ensure null termination
-                if (printer->output.buf.written < printer->output.buf.size) {
-                    printer->output.buf.buffer[printer->output.buf.written] = '\0';
-                } else if (printer->output.buf.size > 0) {
-                    printer->output.buf.buffer[printer->output.buf.size - 1] = '\0';
-                }
-            }
-            break;
-        }
-
-        case AST_OUTPUT_CALLBACK:
-            /* Ignore and continue */
-            return true;
-    }
-
-    return true;
-}
-
-/**
- * @brief Writes indentation spaces to the output based on depth and printer settings.
- *
- * Generates and writes a string of spaces corresponding to the current indentation level if pretty
- * printing is enabled. Indentation is capped to prevent buffer overflow.
- *
- * @param depth The current depth in the AST, used to calculate indentation.
- * @return true on successful write; false if writing fails.
- */
-static bool printer_write_indent(AstPrinter* printer, int depth) {
-    if (!printer->pretty_print)
-        return true;
-
-    char indent_buf[128];
-    int  indent_size = depth * printer->indent_size;
-
-    // Cap indentation to prevent buffer overflow
-    if (indent_size > (int)sizeof(indent_buf) - 1) {
-        indent_size = sizeof(indent_buf) - 1;
-    }
-
-    // Fill indent buffer with spaces
-    memset(indent_buf, ' ', indent_size);
-    indent_buf[indent_size] = '\0';
-
-    return printer_write(printer, indent_buf);
-}
-
-// Forward declaration of recursive printer function
-static bool print_node_recursive(AstPrinter* printer, const Node* node, int depth);
-
-/**
- * @brief Prints a binary expression node in a human-readable text format.
- *
- * Outputs the operator and recursively prints the left and right operands with increased
- * indentation.
- *
- * @param node The binary expression node to print.
- * @param depth The current indentation depth for pretty printing.
- * @return true if printing succeeds for the node and its children, false otherwise.
- */
-static bool print_binary_expr_text(AstPrinter* printer, const Node* node, int depth) {
-    printer_write(printer, "BINARY EXPRESSION:\n");
-    printer_write_indent(printer, depth + 1);
-
-    // Print operator
-    const char* op_str = "UNKNOWN";
-    switch (node->as.binary_expr.op) {
-        case TOKEN_PLUS:
-            op_str = "+";
-            break;
-        case TOKEN_MINUS:
-            op_str = "-";
-            break;
-        case TOKEN_STAR:
-            op_str = "*";
-            break;
-        case TOKEN_SLASH:
-            op_str = "/";
-            break;
-        case TOKEN_EQUAL:
-            op_str = "=";
-            break;
-        case TOKEN_NEQ:
-            op_str = "!=";
-            break;
-        case TOKEN_LT:
-            op_str = "<";
-            break;
-        case TOKEN_GT:
-            op_str = ">";
-            break;
-        case TOKEN_LTE:
-            op_str = "<=";
-            break;
-        case TOKEN_GTE:
-            op_str = ">=";
-            break;
-        case TOKEN_AND:
-            op_str = "AND";
-            break;
-        case TOKEN_OR:
-            op_str = "OR";
-            break;
-    }
-
-    char op_buf[64];
-    snprintf(op_buf, sizeof(op_buf), "Operator: %s\n", op_str);
-    printer_write(printer, op_buf);
-
-    // Print left operand
-    printer_write_indent(printer, depth + 1);
-    printer_write(printer, "Left:\n");
-    if (!print_node_recursive(printer, node->as.binary_expr.left, depth + 2)) {
-        return false;
-    }
-
-    // Print right operand
-    printer_write_indent(printer, depth + 1);
-    printer_write(printer, "Right:\n");
-    if (!print_node_recursive(printer, node->as.binary_expr.right, depth + 2)) {
-        return false;
-    }
-
-    return true;
-}
-
-/**
- * @brief Prints an AST node in JSON format to the configured output.
- *
- * Outputs the node's type, optional line number, and node-specific fields such as identifier names,
- * literal values, or binary operators. Indentation is applied if pretty printing is enabled.
- * Returns false if writing fails at any point.
- *
- * @param printer The AST printer configured for output.
- * @param node The AST node to print; prints "null" if the node is NULL.
- * @param depth The current depth in the AST, used for indentation when pretty printing.
- * @return true if the node was printed successfully; false on write failure.
- */
-static bool print_node_json(AstPrinter* printer, const Node* node, int depth) {
-    // Use depth parameter to avoid warning
-    if (printer->pretty_print && depth > 0) {
-        // Add indentation if pretty printing is enabled
-        for (int i = 0; i < depth * printer->indent_size; i++) {
-            if (!printer_write(printer, " "))
-                return false;
-        }
-    }
-
-    if (!node) {
-        return printer_write(printer, "null");
-    }
-
-    // Start object
-    if (!printer_write(printer, "{"))
-        return false;
-
-    // Node type
-    if (!printer_write(printer, "\"type\":\""))
-        return false;
-
-    // Print type name based on enum
-    const char* type_name = "unknown";
-    switch (node->type) {
-        case NODE_ASK_QUERY:
-            type_name = "ask_query";
-            break;
-        case NODE_TELL_QUERY:
-            type_name = "tell_query";
-            break;
-        case NODE_FIND_QUERY:
-            type_name = "find_query";
-            break;
-        case NODE_SHOW_QUERY:
-            type_name = "show_query";
-            break;
-        case NODE_GET_QUERY:
-            type_name = "get_query";
-            break;
-        case NODE_FIELD_LIST:
-            type_name = "field_list";
-            break;
-        case NODE_SOURCE:
-            type_name = "source";
-            break;
-        case NODE_JOIN:
-            type_name = "join";
-            break;
-        case NODE_GROUP_BY:
-            type_name = "group_by";
-            break;
-        case NODE_ORDER_BY:
-            type_name = "order_by";
-            break;
-        case NODE_LIMIT:
-            type_name = "limit";
-            break;
-        case NODE_ADD_ACTION:
-            type_name = "add_action";
-            break;
-        case NODE_REMOVE_ACTION:
-            type_name = "remove_action";
-            break;
-        case NODE_UPDATE_ACTION:
-            type_name = "update_action";
-            break;
-        case NODE_CREATE_ACTION:
-            type_name = "create_action";
-            break;
-        case NODE_BINARY_EXPR:
-            type_name = "binary_expr";
-            break;
-        case NODE_UNARY_EXPR:
-            type_name = "unary_expr";
-            break;
-        case NODE_IDENTIFIER:
-            type_name = "identifier";
-            break;
-        case NODE_LITERAL:
-            type_name = "literal";
-            break;
-        case NODE_FIELD_DEF:
-            type_name = "field_def";
-            break;
-        case NODE_CONSTRAINT:
-            type_name = "constraint";
-            break;
-        case NODE_FUNCTION_CALL:
-            type_name = "function_call";
-            break;
-        case NODE_ERROR:
-            type_name = "error";
-            break;
-        case NODE_PROGRAM:
-            type_name = "program";
-            break;
-    }
-
-    if (!printer_write(printer, type_name))
-        return false;
-    if (!printer_write(printer, "\""))
-        return false;
-
-    // Line number
-    if (printer->include_line_numbers) {
-        char line_buf[32];
-        snprintf(line_buf, sizeof(line_buf), ",\"line\":%d", node->line);
-        if (!printer_write(printer, line_buf))
-            return false;
-    }
-
-    // Specific node contents based on type
-    switch (node->type) {
-        case NODE_IDENTIFIER:
-            if (!printer_write(printer, ",\"name\":\""))
-                return false;
-            if (!printer_write(printer, node->as.identifier.name))
-                return false;
-            if (!printer_write(printer, "\""))
-                return false;
-            break;
-
-        case NODE_LITERAL:
-            if (node->as.literal.literal_type == TOKEN_STRING) {
-                if (!printer_write(printer, ",\"value\":\""))
-                    return false;
-                if (!printer_write(printer, node->as.literal.value.string_value))
-                    return false;
-                if (!printer_write(printer, "\",\"literalType\":\"string\""))
-                    return false;
-            } else {
-                char value_buf[64];
-                snprintf(value_buf, sizeof(value_buf), ",\"value\":%g,\"literalType\":\"%s\"",
-                         node->as.literal.value.number_value,
-                         node->as.literal.literal_type == TOKEN_INTEGER ? "integer" : "decimal");
-                if (!printer_write(printer, value_buf))
-                    return false;
-            }
-            break;
-
-            // Add handling for other node types here
-            // This is a simplified version - a full implementation would handle all node types
-
-        default:
-            // For complex node types, we'll add a children array
-            if (node->type == NODE_BINARY_EXPR) {
-                // For binary expressions, show the operator
-                const char* op_str = "unknown";
-                switch (node->as.binary_expr.op) {
-                    case TOKEN_PLUS:
-                        op_str = "+";
-                        break;
-                    case TOKEN_MINUS:
-                        op_str = "-";
-                        break;
-                    case TOKEN_STAR:
-                        op_str = "*";
-                        break;
-                    case TOKEN_SLASH:
-                        op_str = "/";
-                        break;
-                    case TOKEN_EQUAL:
-                        op_str = "=";
-                        break;
-                    case TOKEN_NEQ:
-                        op_str = "!=";
-                        break;
-                    case TOKEN_LT:
-                        op_str = "<";
-                        break;
-                    case TOKEN_GT:
-                        op_str = ">";
-                        break;
-                    case TOKEN_LTE:
-                        op_str = "<=";
-                        break;
-                    case TOKEN_GTE:
-                        op_str = ">=";
-                        break;
-                    case TOKEN_AND:
-                        op_str = "AND";
-                        break;
-                    case TOKEN_OR:
-                        op_str = "OR";
-                        break;
-                    default:
-                        break;
-                }
-                if (!printer_write(printer, ",\"operator\":\""))
-                    return false;
-                if (!printer_write(printer, op_str))
-                    return false;
-                if (!printer_write(printer, "\""))
-                    return false;
-            }
-            break;
-    }
-
-    // Close the object
-    if (!printer_write(printer, "}"))
-        return false;
-
-    return true;
-}
-
-/**
- * @brief Recursively prints an AST node in the selected format.
- *
- * Prints the given AST node and its children using the format specified in the printer
- * configuration (text or JSON). Handles indentation and pretty-printing as configured. Returns
- * false if printing fails or if the format is not supported.
- *
- * @param printer Configured AST printer specifying output format and destination.
- * @param node AST node to print; prints "NULL" if node is null.
- * @param depth Current depth in the AST, used for indentation.
- * @return true if the node and its children were printed successfully; false on failure or
- * unsupported format.
- */
-static bool print_node_recursive(AstPrinter* printer, const Node* node, int depth) {
-    if (!node) {
-        printer_write_indent(printer, depth);
-        return printer_write(printer, "NULL\n");
-    }
-
-    switch (printer->format) {
-        case AST_FORMAT_TEXT:
-            printer_write_indent(printer, depth);
-
-            switch (node->type) {
-                case NODE_BINARY_EXPR:
-                    return print_binary_expr_text(printer, node, depth);
-
-                case NODE_IDENTIFIER:
-                    return printer_write(printer, "IDENTIFIER: ") &&
-                           printer_write(printer, node->as.identifier.name) &&
-                           printer_write(printer, "\n");
-
-                case NODE_LITERAL:
-                    if (node->as.literal.literal_type == TOKEN_STRING) {
-                        return printer_write(printer, "STRING: \"") &&
-                               printer_write(printer, node->as.literal.value.string_value) &&
-                               printer_write(printer, "\"\n");
-                    } else {
-                        char        value_buf[64];
-                        const char* type_str =
-                            node->as.literal.literal_type == TOKEN_INTEGER ? "INTEGER" : "DECIMAL";
-                        snprintf(value_buf, sizeof(value_buf), "%s: %g\n", type_str,
-                                 node->as.literal.value.number_value);
-                        return printer_write(printer, value_buf);
-                    }
-
-                    // TODO: Implement all node types
-
-                default: {
-                    // Generic node type printer
-                    char type_buf[64];
-                    snprintf(type_buf, sizeof(type_buf), "NODE TYPE %d\n", node->type);
-                    return printer_write(printer, type_buf);
-                }
-            }
-            break;
-
-        case AST_FORMAT_JSON:
-            printer_write_indent(printer, depth);
-            if (!print_node_json(printer, node, depth)) {
-                return false;
-            }
-            if (printer->pretty_print) {
-                return printer_write(printer, "\n");
-            }
-            return true;
-
-        case AST_FORMAT_XML:
-            // XML format implementation would go here
-            return false;
-
-        case AST_FORMAT_DOT:
-            // DOT format implementation would go here
-            return false;
-    }
-
-    return false;
-}
-
-/**
- * @brief Traverses the AST in depth-first order and invokes a callback for each node.
- *
- * For each node in the AST, calls the user-provided callback function with the node and its depth.
- * Traversal is performed using an explicit stack to avoid recursion. Currently, only binary
- * expression nodes have their children pushed for traversal; support for other node types can be
- * added as needed.
- *
- * @return true if traversal completes successfully; false if memory allocation fails or the printer
- * is misconfigured.
- */
-static bool print_node_callback(AstPrinter* printer, const Node* node) {
-    if (printer->type != AST_OUTPUT_CALLBACK || !printer->output.callback.fn) {
-        return false;
-    }
-
-    // Visit the AST in a depth-first manner
-    typedef struct VisitItem {
-        const Node*       node;
-        int               depth;
-        struct VisitItem* next;
-    } VisitItem;
-
-    VisitItem* stack = NULL;
-    VisitItem* item  = malloc(sizeof(VisitItem));
-    if (!item) {
-        /* Free remaining stack */
-        while (stack) {
-            VisitItem* temp = stack;
-            stack           = stack->next;
-            free(temp);
-        }
-        return false;
-    }
-
-    item->node  = node;
-    item->depth = 0;
-    item->next  = NULL;
-    stack       = item;
-
-    while (stack) {
-        // Pop from stack
-        item  = stack;
-        stack = stack->next;
-
-        // Process current node
-        const Node* current = item->node;
-        int         depth   = item->depth;
-        free(item);
-
-        // Call the callback
-        if (current) {
-            // Check the return value of the callback - if false, stop traversal
-            if (!printer->output.callback.fn(current, depth, printer->output.callback.user_data)) {
-                // Free any remaining stack items
-                while (stack) {
-                    item  = stack;
-                    stack = stack->next;
-                    free(item);
-                }
-                return false;  // Propagate the return value to caller
-            }
-
-            // Push children to stack (in reverse order so they get processed in the right order)
-            // This would need to be customized for each node type
-            // Here's an example for binary expressions
-            if (current->type == NODE_BINARY_EXPR) {
-                // Push right child first (will be processed second)
-                if (current->as.binary_expr.right) {
-                    item = malloc(sizeof(VisitItem));
-                    if (!item)
-                        return false;
-                    item->node  = current->as.binary_expr.right;
-                    item->depth = depth + 1;
-                    item->next  = stack;
-                    stack       = item;
-                }
-
-                // Push left child second (will be processed first)
-                if (current->as.binary_expr.left) {
-                    item = malloc(sizeof(VisitItem));
-                    if (!item)
-                        return false;
-                    item->node  = current->as.binary_expr.left;
-                    item->depth = depth + 1;
-                    item->next  = stack;
-                    stack       = item;
-                }
-            }
-            // Add pushing logic for other node types
-        }
-    }
-
-    return true;
-}
-
-/**
- * @brief Initializes an AstPrinter for file output with the specified format.
- *
- * Configures the printer to write AST output to a given file stream, enabling pretty printing and
- * line numbers by default.
- *
- * @param printer Pointer to the AstPrinter to initialize.
- * @param format Output format for the AST (e.g., text, JSON).
- * @param file File stream to which the AST will be written.
- * @return true if initialization succeeds; false if printer or file is NULL.
- */
-bool ast_printer_init_file(AstPrinter* printer, AstOutputFormat format, FILE* file) {
-    if (!printer || !file)
-        return false;
-
-    memset(printer, 0, sizeof(AstPrinter));
-    printer->format               = format;
-    printer->type                 = AST_OUTPUT_FILE;
-    printer->output.file          = file;
-    printer->indent_size          = 2;
-    printer->pretty_print         = true;
-    printer->include_line_numbers = true;
-
-    return true;
-}
-
-/**
- * @brief Initializes an AstPrinter for output to a character buffer.
- *
- * Configures the printer to write AST output in the specified format to a provided buffer,
- * enabling pretty printing and line numbers by default. The buffer is null-terminated and
- * its size is respected to prevent overflow.
- *
- * @param printer Pointer to the AstPrinter to initialize.
- * @param format Output format for the AST (e.g., text, JSON).
- * @param buffer Destination buffer for output.
- * @param size Size of the buffer in bytes.
- * @return true if initialization succeeds; false if arguments are invalid.
- */
-bool ast_printer_init_buffer(AstPrinter* printer, AstOutputFormat format, char* buffer,
-                             size_t size) {
-    if (!printer || !buffer || size == 0)
-        return false;
-
-    memset(printer, 0, sizeof(AstPrinter));
-    printer->format               = format;
-    printer->type                 = AST_OUTPUT_BUFFER;
-    printer->output.buf.buffer    = buffer;
-    printer->output.buf.size      = size;
-    printer->output.buf.written   = 0;
-    printer->indent_size          = 2;
-    printer->pretty_print         = true;
-    printer->include_line_numbers = true;
-
-    // Ensure the buffer is null-terminated initially
-    buffer[0] = '\0';
-
-    return true;
-}
-
-/**
- * @brief Initializes an AstPrinter for callback-based output.
- *
- * Configures the printer to traverse the AST and invoke a user-provided callback function for each
- * node, using the specified output format.
- *
- * @param printer Pointer to the AstPrinter to initialize.
- * @param format Output format to use when printing nodes.
- * @param callback Function to call for each node during traversal.
- * @param user_data User-defined data passed to the callback function.
- * @return true if initialization succeeds; false if printer or callback is NULL.
- */
-bool ast_printer_init_callback(AstPrinter* printer, AstOutputFormat format,
-                               AstPrintCallback callback, void* user_data) {
-    if (!printer || !callback)
-        return false;
-
-    memset(printer, 0, sizeof(AstPrinter));
-    printer->format                    = format;
-    printer->type                      = AST_OUTPUT_CALLBACK;
-    printer->output.callback.fn        = callback;
-    printer->output.callback.user_data = user_data;
-    printer->indent_size               = 2;
-    printer->pretty_print              = true;
-    printer->include_line_numbers      = true;
-
-    return true;
-}
-
-/**
- * @brief Prints an AST node using the specified printer configuration.
- *
- * Selects the appropriate output method (file, buffer, or callback) and format (text, JSON, etc.)
- * as configured in the printer. Returns false if the printer is invalid or if printing fails.
- *
- * @param printer Configured AST printer specifying output type and format.
- * @param node Root AST node to print.
- * @return true if printing succeeds; false otherwise.
- */
-bool ast_printer_print(AstPrinter* printer, const Node* node) {
-    if (!printer)
-        return false;
-
-    if (printer->type == AST_OUTPUT_CALLBACK) {
-        return print_node_callback(printer, node);
-    } else {
-        // For file and buffer output, use the recursive printer
-        return print_node_recursive(printer, node, 0);
-    }
-}
-
-/**
- * @brief Releases resources associated with an AstPrinter.
- *
- * Currently a placeholder; does not perform any operations.
- */
-void ast_printer_free(AstPrinter* printer) {
-    // Nothing to free for now, but implemented for future expansion
-    (void)printer;
-}
-
-/**
- * @brief Returns the number of bytes written to the output buffer.
- *
- * If the printer is not configured for buffer output or is invalid, returns 0.
- *
- * @param printer Pointer to the AstPrinter instance.
- * @return Number of bytes written to the buffer, or 0 if not applicable.
- */
-size_t ast_printer_get_written(const AstPrinter* printer) {
-    if (!printer || printer->type != AST_OUTPUT_BUFFER) {
-        return 0;
-    }
-    return printer->output.buf.written;
-}
+/**
+ * @file ast_printer.c
+ * @brief Implementation of AST printing utilities
+ */
+
+#include <nsql/ast_printer.h>
+#include <nsql/ast_visitor.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Writes the output collected in the block of a file printer to the file.
+ *
+ * @param printer Pointer to the AstPrinter.
+ * @return true if the write succeeds or nothing is pending; false on failure.
+ */
+static bool printer_flush(AstPrinter* printer) {
+    size_t length         = printer->block.length;
+    printer->block.length = 0;
+    return length == 0 || fwrite(printer->block.data, 1, length, printer->output.file) == length;
+}
+
+/**
+ * @brief Starts collecting the output of a file printer in a block owned by the caller.
+ *
+ * @param printer Pointer to the AstPrinter.
+ * @param block Storage for AST_PRINTER_BLOCK_SIZE bytes of output.
+ */
+static void printer_begin(AstPrinter* printer, char* block) {
+    if (printer->type == AST_OUTPUT_FILE) {
+        printer->block.data   = block;
+        printer->block.length = 0;
+    }
+}
+
+/**
+ * @brief Writes out the rest of the block started by printer_begin() and stops collecting.
+ *
+ * @param printer Pointer to the AstPrinter.
+ * @param ok Whether printing has succeeded so far.
+ * @return true if printing and the final write succeeded; false otherwise.
+ */
+static bool printer_end(AstPrinter* printer, bool ok) {
+    if (printer->type == AST_OUTPUT_FILE && printer->block.data) {
+        ok                  = printer_flush(printer) && ok;
+        printer->block.data = NULL;
+    }
+    return ok;
+}
+
+/**
+ * @brief Makes room for at least extra more bytes and a null terminator in a dynamic printer.
+ *
+ * @param printer Pointer to the AstPrinter.
+ * @param extra Number of bytes about to be written.
+ */
+static void printer_reserve(AstPrinter* printer, size_t extra) {
+    size_t needed = printer->output.heap.length + extra + 1;
+    if (needed <= printer->output.heap.capacity)
+        return;
+
+    size_t capacity = printer->output.heap.capacity > 0 ? printer->output.heap.capacity : 256;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    char* data = (char*)realloc(printer->output.heap.data, capacity);
+    if (!data) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    printer->output.heap.data     = data;
+    printer->output.heap.capacity = capacity;
+}
+
+/**
+ * @brief Writes a counted string to the output destination specified in the AstPrinter.
+ *
+ * Writes the first len characters of str to a file or buffer, depending on the printer's output
+ * type. The string does not need to be null-terminated. File output is collected in the printer's
+ * block and written in large pieces. For buffer output, copies the string into the buffer,
+ * ensuring null termination and preventing overflow, and counts the bytes that did not fit.
+ *
+ * @param printer Pointer to the AstPrinter specifying the output destination.
+ * @param str String to write. If NULL, nothing is written and the function returns true.
+ * @param len Number of characters to write.
+ * @return true if the write succeeds or nothing is written; false on failure.
+ */
+static bool printer_write_n(AstPrinter* printer, const char* str, size_t len) {
+    if (!str || len == 0)
+        return true;  // Nothing to write
+
+    switch (printer->type) {
+        case AST_OUTPUT_FILE:
+            if (!printer->block.data)
+                return fwrite(str, 1, len, printer->output.file) == len;
+
+            if (printer->block.length + len > AST_PRINTER_BLOCK_SIZE && !printer_flush(printer))
+                return false;
+            if (len >= AST_PRINTER_BLOCK_SIZE)
+                return fwrite(str, 1, len, printer->output.file) == len;
+            memcpy(printer->block.data + printer->block.length, str, len);
+            printer->block.length += len;
+            break;
+
+        case AST_OUTPUT_BUFFER: {
+            printer->output.buf.required += len;
+
+            size_t remaining = printer->output.buf.size - printer->output.buf.written;
+            if (len >= remaining) {
+                len = remaining > 0 ? remaining - 1 : 0;  // Reserve space for null terminator
+            }
+            if (len > 0) {
+                memcpy(printer->output.buf.buffer + printer->output.buf.written, str, len);
+                printer->output.buf.written += len;
+                printer->output.buf.buffer[printer->output.buf.written] = '\0';
+            }
+            break;
+        }
+
+        case AST_OUTPUT_DYNAMIC:
+            printer_reserve(printer, len);
+            memcpy(printer->output.heap.data + printer->output.heap.length, str, len);
+            printer->output.heap.length += len;
+            printer->output.heap.data[printer->output.heap.length] = '\0';
+            break;
+
+        case AST_OUTPUT_CALLBACK:
+            /* Ignore and continue */
+            return true;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Writes a string literal without measuring it at run time, see printer_write_n().
+ */
+#define printer_write_literal(printer, literal) \
+    printer_write_n((printer), "" literal, sizeof(literal) - 1)
+
+/**
+ * @brief Writes a null-terminated string to the output destination, see printer_write_n().
+ *
+ * @param printer Pointer to the AstPrinter specifying the output destination.
+ * @param str Null-terminated string to write. If NULL, nothing is written and the function returns
+ * true.
+ * @return true if the write succeeds or nothing is written; false on failure.
+ */
+static bool printer_write(AstPrinter* printer, const char* str) {
+    if (!str)
+        return true;  // Nothing to write
+
+    return printer_write_n(printer, str, strlen(str));
+}
+
+/**
+ * @brief Formats a short piece of output and writes it, using the length snprintf() returns.
+ *
+ * @param printer Pointer to the AstPrinter specifying the output destination.
+ * @param format printf format; the formatted text must fit in 64 bytes.
+ * @return true if the write succeeds; false on failure.
+ */
+static bool printer_writef(AstPrinter* printer, const char* format, ...) {
+    char    text[64];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+
+    if (length < 0)
+        return false;
+    return printer_write_n(printer, text, (size_t)length < sizeof(text) ? (size_t)length
+                                                                        : sizeof(text) - 1);
+}
+
+/**
+ * @brief Writes a counted string as the contents of a JSON string, escaping where JSON requires it.
+ *
+ * Runs of characters that need no escaping are written in one piece.
+ *
+ * @param printer Pointer to the AstPrinter specifying the output destination.
+ * @param str String to write. If NULL, nothing is written and the function returns true.
+ * @param len Number of characters to write.
+ * @return true if the write succeeds or nothing is written; false on failure.
+ */
+static bool printer_write_json_string(AstPrinter* printer, const char* str, size_t len) {
+    if (!str)
+        return true;  // Nothing to write
+
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+
+        if (!printer_write_n(printer, str + start, i - start))
+            return false;
+        start = i + 1;
+
+        bool ok;
+        if (c == '"')
+            ok = printer_write_literal(printer, "\\\"");
+        else if (c == '\\')
+            ok = printer_write_literal(printer, "\\\\");
+        else if (c == '\n')
+            ok = printer_write_literal(printer, "\\n");
+        else if (c == '\t')
+            ok = printer_write_literal(printer, "\\t");
+        else if (c == '\r')
+            ok = printer_write_literal(printer, "\\r");
+        else
+            ok = printer_writef(printer, "\\u%04x", c);
+        if (!ok)
+            return false;
+    }
+    return printer_write_n(printer, str + start, len - start);
+}
+
+/**
+ * @brief Writes indentation spaces to the output based on depth and printer settings.
+ *
+ * Writes the spaces for the current indentation level if pretty printing is enabled, in pieces of
+ * a constant string of spaces.
+ *
+ * @param depth The current depth in the AST, used to calculate indentation.
+ * @return true on successful write; false if writing fails.
+ */
+static bool printer_write_indent(AstPrinter* printer, int depth) {
+    static const char spaces[] = "                                                                ";
+
+    if (!printer->pretty_print || depth <= 0 || printer->indent_size <= 0)
+        return true;
+
+    size_t indent_size = (size_t)depth * (size_t)printer->indent_size;
+    while (indent_size > 0) {
+        size_t piece = indent_size < sizeof(spaces) - 1 ? indent_size : sizeof(spaces) - 1;
+        if (!printer_write_n(printer, spaces, piece))
+            return false;
+        indent_size -= piece;
+    }
+    return true;
+}
+
+/**
+ * @brief The fields of a node that the printer shows, read from a Node or a pooled node.
+ */
+typedef struct {
+    NodeType      type;    // Node type
+    int           line;    // Source line
+    NsqlTokenType op;      // Operator of a binary or logical expression, type of a literal
+    const char*   string;  // Identifier name or string literal value
+    size_t        length;  // Length of string in bytes
+    double        number;  // Numeric literal value
+    int           index;   // Parameter index
+    int           count;   // Operands of a logical expression, items of an IN list
+} PrintedNode;
+
+/**
+ * @brief Reads the printed fields of a Node.
+ *
+ * @param node The node to read.
+ * @return The fields of the node.
+ */
+static PrintedNode view_node(const Node* node) {
+    PrintedNode view;
+    memset(&view, 0, sizeof(view));
+    view.type = node->type;
+    view.line = node->line;
+
+    switch (node->type) {
+        case NODE_BINARY_EXPR:
+            view.op = node->as.binary_expr.op;
+            break;
+        case NODE_LOGICAL_EXPR:
+            view.op    = node->as.logical_expr.op;
+            view.count = node->as.logical_expr.count;
+            break;
+        case NODE_IN_LIST:
+            view.count = node->as.in_list.count;
+            break;
+        case NODE_IDENTIFIER:
+            view.string = node->as.identifier.name;
+            view.length = (size_t)node->as.identifier.length;
+            break;
+        case NODE_LITERAL:
+            view.op = node->as.literal.literal_type;
+            if (view.op == TOKEN_STRING) {
+                view.string = node->as.literal.value.string_value;
+                view.length = (size_t)node->as.literal.length;
+            } else {
+                view.number = node->as.literal.value.number_value;
+            }
+            break;
+        case NODE_PARAMETER:
+            view.index = node->as.parameter.index;
+            break;
+        default:
+            break;
+    }
+    return view;
+}
+
+/**
+ * @brief Reads the printed fields of a pooled node.
+ *
+ * @param pool The pool holding the node.
+ * @param index Index of the node.
+ * @return The fields of the node.
+ */
+static PrintedNode view_pooled(const AstPool* pool, NodeIndex index) {
+    const FlatNode* node = &pool->nodes[index];
+    PrintedNode     view;
+    memset(&view, 0, sizeof(view));
+    view.type = (NodeType)node->type;
+    view.line = node->line;
+    view.op   = (NsqlTokenType)node->op;
+
+    switch (node->type) {
+        case NODE_IDENTIFIER:
+            view.string = ast_pool_string(pool, node->as.string.offset);
+            view.length = node->as.string.length;
+            break;
+        case NODE_LITERAL:
+            if (view.op == TOKEN_STRING) {
+                view.string = ast_pool_string(pool, node->as.string.offset);
+                view.length = node->as.string.length;
+            } else {
+                view.number = node->as.number;
+            }
+            break;
+        case NODE_PARAMETER:
+            view.index = node->as.parameter;
+            break;
+        case NODE_LOGICAL_EXPR:
+            view.count = (int)node->as.children.count;
+            break;
+        case NODE_IN_LIST:
+            view.count = (int)node->as.children.count - 1;  // The value comes first
+            break;
+        default:
+            break;
+    }
+    return view;
+}
+
+/**
+ * @brief Returns the symbol of an operator.
+ *
+ * @param op The operator token.
+ * @param unknown The text to return for tokens that are not operators.
+ * @return The operator symbol.
+ */
+static const char* operator_name(NsqlTokenType op, const char* unknown) {
+    switch (op) {
+        case TOKEN_PLUS:
+            return "+";
+        case TOKEN_MINUS:
+            return "-";
+        case TOKEN_STAR:
+            return "*";
+        case TOKEN_SLASH:
+            return "/";
+        case TOKEN_EQUAL:
+            return "=";
+        case TOKEN_NEQ:
+            return "!=";
+        case TOKEN_LT:
+            return "<";
+        case TOKEN_GT:
+            return ">";
+        case TOKEN_LTE:
+            return "<=";
+        case TOKEN_GTE:
+            return ">=";
+        case TOKEN_AND:
+            return "AND";
+        case TOKEN_OR:
+            return "OR";
+        case TOKEN_NOT:
+            return "NOT";
+        default:
+            return unknown;
+    }
+}
+
+/**
+ * @brief Returns the JSON name of a node type.
+ *
+ * @param type The node type.
+ * @return The name, or "unknown" for a value outside NodeType.
+ */
+static const char* node_type_name(NodeType type) {
+    switch (type) {
+        case NODE_ASK_QUERY:
+            return "ask_query";
+        case NODE_TELL_QUERY:
+            return "tell_query";
+        case NODE_FIND_QUERY:
+            return "find_query";
+        case NODE_SHOW_QUERY:
+            return "show_query";
+        case NODE_GET_QUERY:
+            return "get_query";
+        case NODE_FIELD_LIST:
+            return "field_list";
+        case NODE_SOURCE:
+            return "source";
+        case NODE_JOIN:
+            return "join";
+        case NODE_GROUP_BY:
+            return "group_by";
+        case NODE_ORDER_BY:
+            return "order_by";
+        case NODE_LIMIT:
+            return "limit";
+        case NODE_ADD_ACTION:
+            return "add_action";
+        case NODE_REMOVE_ACTION:
+            return "remove_action";
+        case NODE_UPDATE_ACTION:
+            return "update_action";
+        case NODE_CREATE_ACTION:
+            return "create_action";
+        case NODE_BINARY_EXPR:
+            return "binary_expr";
+        case NODE_UNARY_EXPR:
+            return "unary_expr";
+        case NODE_IDENTIFIER:
+            return "identifier";
+        case NODE_LITERAL:
+            return "literal";
+        case NODE_FIELD_DEF:
+            return "field_def";
+        case NODE_CONSTRAINT:
+            return "constraint";
+        case NODE_FUNCTION_CALL:
+            return "function_call";
+        case NODE_ERROR:
+            return "error";
+        case NODE_PROGRAM:
+            return "program";
+        case NODE_PARAMETER:
+            return "parameter";
+        case NODE_LOGICAL_EXPR:
+            return "logical_expr";
+        case NODE_IN_LIST:
+            return "in_list";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Prints the text line of a node, without its children.
+ *
+ * Binary and logical expressions print their heading and operator; their operands, like the
+ * entries of IN lists, are printed by the caller with increased indentation.
+ *
+ * @param printer The AST printer configured for output.
+ * @param node The node to print.
+ * @param depth The current indentation depth for pretty printing.
+ * @return true if printing succeeds, false otherwise.
+ */
+static bool print_fields_text(AstPrinter* printer, const PrintedNode* node, int depth) {
+    switch (node->type) {
+        case NODE_BINARY_EXPR:
+            printer_write_literal(printer, "BINARY EXPRESSION:\n");
+            printer_write_indent(printer, depth + 1);
+            printer_write_literal(printer, "Operator: ");
+            printer_write(printer, operator_name(node->op, "UNKNOWN"));
+            printer_write_literal(printer, "\n");
+            return true;
+
+        case NODE_LOGICAL_EXPR:
+            printer_writef(printer, "LOGICAL EXPRESSION (%d operands):\n", node->count);
+            printer_write_indent(printer, depth + 1);
+            return printer_write_literal(printer, "Operator: ") &&
+                   printer_write(printer, operator_name(node->op, "UNKNOWN")) &&
+                   printer_write_literal(printer, "\n");
+
+        case NODE_IN_LIST:
+            return printer_writef(printer, "IN LIST (%d items):\n", node->count);
+
+        case NODE_IDENTIFIER:
+            return printer_write_literal(printer, "IDENTIFIER: ") &&
+                   printer_write_n(printer, node->string, node->length) &&
+                   printer_write_literal(printer, "\n");
+
+        case NODE_LITERAL:
+            if (node->op == TOKEN_STRING) {
+                return printer_write_literal(printer, "STRING: \"") &&
+                       printer_write_n(printer, node->string, node->length) &&
+                       printer_write_literal(printer, "\"\n");
+            } else {
+                const char* type_str = node->op == TOKEN_INTEGER ? "INTEGER" : "DECIMAL";
+                return printer_writef(printer, "%s: %g\n", type_str, node->number);
+            }
+
+        case NODE_PARAMETER:
+            return printer_writef(printer, "PARAMETER: ?%d\n", node->index);
+
+            // TODO: Implement all node types
+
+        default:
+            // Generic node type printer
+            return printer_writef(printer, "NODE TYPE %d\n", node->type);
+    }
+}
+
+/**
+ * @brief Prints an AST node in JSON format to the configured output.
+ *
+ * Outputs the node's type, optional line number, and node-specific fields such as identifier names,
+ * literal values, or binary operators. Indentation is applied if pretty printing is enabled.
+ * Returns false if writing fails at any point.
+ *
+ * @param printer The AST printer configured for output.
+ * @param node The AST node to print; prints "null" if the node is NULL.
+ * @param depth The current depth in the AST, used for indentation when pretty printing.
+ * @return true if the node was printed successfully; false on write failure.
+ */
+static bool print_node_json(AstPrinter* printer, const PrintedNode* node, int depth) {
+    // Add indentation if pretty printing is enabled
+    if (!printer_write_indent(printer, depth))
+        return false;
+
+    if (!node) {
+        return printer_write_literal(printer, "null");
+    }
+
+    // Start object
+    if (!printer_write_literal(printer, "{"))
+        return false;
+
+    // Node type
+    if (!printer_write_literal(printer, "\"type\":\""))
+        return false;
+    if (!printer_write(printer, node_type_name(node->type)))
+        return false;
+    if (!printer_write_literal(printer, "\""))
+        return false;
+
+    // Line number
+    if (printer->include_line_numbers) {
+        if (!printer_writef(printer, ",\"line\":%d", node->line))
+            return false;
+    }
+
+    // Specific node contents based on type
+    switch (node->type) {
+        case NODE_IDENTIFIER:
+            if (!printer_write_literal(printer, ",\"name\":\""))
+                return false;
+            if (!printer_write_json_string(printer, node->string, node->length))
+                return false;
+            if (!printer_write_literal(printer, "\""))
+                return false;
+            break;
+
+        case NODE_LITERAL:
+            if (node->op == TOKEN_STRING) {
+                if (!printer_write_literal(printer, ",\"value\":\""))
+                    return false;
+                if (!printer_write_json_string(printer, node->string, node->length))
+                    return false;
+                if (!printer_write_literal(printer, "\",\"literalType\":\"string\""))
+                    return false;
+            } else {
+                if (!printer_writef(printer, ",\"value\":%g,\"literalType\":\"%s\"", node->number,
+                                    node->op == TOKEN_INTEGER ? "integer" : "decimal"))
+                    return false;
+            }
+            break;
+
+        case NODE_PARAMETER:
+            if (!printer_writef(printer, ",\"index\":%d", node->index))
+                return false;
+            break;
+
+            // Add handling for other node types here
+            // This is a simplified version - a full implementation would handle all node types
+
+        case NODE_BINARY_EXPR:
+            // For binary expressions, show the operator
+            if (!printer_write_literal(printer, ",\"operator\":\""))
+                return false;
+            if (!printer_write(printer, operator_name(node->op, "unknown")))
+                return false;
+            if (!printer_write_literal(printer, "\""))
+                return false;
+            break;
+
+        case NODE_LOGICAL_EXPR:
+        case NODE_IN_LIST:
+            if (node->type == NODE_LOGICAL_EXPR) {
+                if (!printer_write_literal(printer, ",\"operator\":\""))
+                    return false;
+                if (!printer_write(printer, operator_name(node->op, "unknown")))
+                    return false;
+                if (!printer_write_literal(printer, "\""))
+                    return false;
+            }
+            if (!printer_writef(printer, ",\"count\":%d", node->count))
+                return false;
+            break;
+
+        default:
+            break;
+    }
+
+    // Close the object
+    if (!printer_write_literal(printer, "}"))
+        return false;
+
+    return true;
+}
+
+/**
+ * @brief Prints a node in JSON format followed by a newline when pretty printing.
+ *
+ * @param printer The AST printer configured for output.
+ * @param node The node to print, or NULL for "null".
+ * @param depth The current depth in the AST, used for indentation.
+ * @return true if the node was printed successfully; false on write failure.
+ */
+static bool print_json_line(AstPrinter* printer, const PrintedNode* node, int depth) {
+    printer_write_indent(printer, depth);
+    if (!print_node_json(printer, node, depth)) {
+        return false;
+    }
+    if (printer->pretty_print) {
+        return printer_write_literal(printer, "\n");
+    }
+    return true;
+}
+
+/**
+ * @brief Returns whether the text format prints the children of a node.
+ *
+ * @param type The node type.
+ * @return true for binary and logical expressions and IN lists.
+ */
+static bool prints_children(NodeType type) {
+    return type == NODE_BINARY_EXPR || type == NODE_LOGICAL_EXPR || type == NODE_IN_LIST;
+}
+
+/**
+ * @brief Prints the heading of a child in text format.
+ *
+ * Binary expressions label their operands "Left:" and "Right:" and logical expressions number
+ * theirs. IN lists show their value, then their numbered items.
+ *
+ * @param printer The AST printer configured for output.
+ * @param parent Type of the parent.
+ * @param slot Child slot of the child in the parent.
+ * @param depth The depth of the child.
+ * @return true if printing succeeds, false otherwise.
+ */
+static bool print_child_heading(AstPrinter* printer, NodeType parent, int slot, int depth) {
+    printer_write_indent(printer, depth - 1);
+    if (parent == NODE_BINARY_EXPR)
+        return slot == 0 ? printer_write_literal(printer, "Left:\n")
+                         : printer_write_literal(printer, "Right:\n");
+    else if (parent == NODE_IN_LIST && slot == 0)
+        return printer_write_literal(printer, "Value:\n");
+    else if (parent == NODE_IN_LIST)
+        return printer_writef(printer, "Item %d:\n", slot);
+    else
+        return printer_writef(printer, "Operand %d:\n", slot + 1);
+}
+
+/**
+ * @brief Prints a node in text format, under its heading if it is an operand or list entry.
+ *
+ * Only the children of binary and logical expressions and IN lists are printed, so the children
+ * of every other node are skipped. Empty operand slots of binary expressions are printed as
+ * "NULL"; those of the n-ary nodes are left out.
+ *
+ * @param frame The node and its position in the tree.
+ * @param user_data The AstPrinter.
+ * @return AST_VISIT_STOP on write failure, otherwise whether to print the children.
+ */
+static AstVisitAction print_text_visit(const AstVisitFrame* frame, void* user_data) {
+    AstPrinter* printer = (AstPrinter*)user_data;
+    int         depth   = 2 * frame->depth;  // Operands are indented below their heading
+
+    if (frame->parent) {
+        if (!frame->node && frame->parent->type != NODE_BINARY_EXPR)
+            return AST_VISIT_SKIP;
+        print_child_heading(printer, frame->parent->type, frame->slot, depth);
+    }
+
+    printer_write_indent(printer, depth);
+    if (!frame->node)
+        return printer_write_literal(printer, "NULL\n") ? AST_VISIT_SKIP : AST_VISIT_STOP;
+
+    PrintedNode view = view_node(frame->node);
+    if (!print_fields_text(printer, &view, depth))
+        return AST_VISIT_STOP;
+    return prints_children(view.type) ? AST_VISIT_CONTINUE : AST_VISIT_SKIP;
+}
+
+/**
+ * @brief Prints an AST in the selected format.
+ *
+ * Text output walks the tree with ast_visit(), so deep expression chains do not grow the C
+ * stack. Returns false if printing fails or if the format is not supported.
+ *
+ * @param printer Configured AST printer specifying output format and destination.
+ * @param node Root of the AST; prints "NULL" if node is null.
+ * @return true if the tree was printed successfully; false on failure or unsupported format.
+ */
+static bool print_tree(AstPrinter* printer, const Node* node) {
+    switch (printer->format) {
+        case AST_FORMAT_TEXT: {
+            // The walk does not modify the tree
+            AstVisitor visitor = {print_text_visit, NULL, printer, true};
+            return ast_visit((Node*)node, &visitor);
+        }
+
+        case AST_FORMAT_JSON: {
+            if (!node)
+                return printer_write_literal(printer, "NULL\n");
+            PrintedNode view = view_node(node);
+            return print_json_line(printer, &view, 0);
+        }
+
+        case AST_FORMAT_XML:
+            // XML format implementation would go here
+            return false;
+
+        case AST_FORMAT_DOT:
+            // DOT format implementation would go here
+            return false;
+    }
+
+    return false;
+}
+
+/**
+ * @brief Where the pool printer shows a node, set by the parent before the scan reaches it.
+ */
+typedef struct {
+    int      depth;   // Depth of the node, or -1 if the node is not printed
+    NodeType parent;  // Type of the parent, which picks the heading (unused for the root)
+    int      slot;    // Child slot of the node in its parent
+} PooledPlacement;
+
+/**
+ * @brief A NULL right operand that is printed once the scan has passed the left operand.
+ */
+typedef struct {
+    NodeIndex end;    // Index one past the left operand
+    int       depth;  // Depth of the binary expression
+} PendingOperand;
+
+/**
+ * @brief Prints the heading of a binary expression operand followed by "NULL".
+ *
+ * @param printer The AST printer configured for output.
+ * @param slot 0 for the left operand, 1 for the right one.
+ * @param depth The depth of the binary expression.
+ * @return true if printing succeeds, false otherwise.
+ */
+static bool print_null_operand(AstPrinter* printer, int slot, int depth) {
+    print_child_heading(printer, NODE_BINARY_EXPR, slot, depth + 2);
+    printer_write_indent(printer, depth + 2);
+    return printer_write_literal(printer, "NULL\n");
+}
+
+/**
+ * @brief Prints a pooled tree in text format with one forward scan of its nodes.
+ *
+ * The output matches print_tree() on the equivalent Node tree. Pooled trees are in
+ * preorder, so each printed node is reached after its parent has recorded its depth and heading.
+ *
+ * @param printer Configured AST printer specifying output format and destination.
+ * @param pool The pool holding the tree.
+ * @param root Index of the root node.
+ * @return true if the tree was printed successfully; false on failure.
+ */
+static bool print_pool_text(AstPrinter* printer, const AstPool* pool, NodeIndex root) {
+    size_t           count         = ast_pool_end(pool, root) - root;
+    PooledPlacement* placements    = (PooledPlacement*)malloc(count * sizeof(PooledPlacement));
+    PendingOperand*  pending       = (PendingOperand*)malloc(count * sizeof(PendingOperand));
+    size_t           pending_count = 0;
+    bool             ok            = placements && pending;
+
+    for (size_t i = 0; i < count && ok; i++) {
+        placements[i].depth = i == 0 ? 0 : -1;
+    }
+
+    for (size_t i = 0; i < count && ok; i++) {
+        // Right operands left NULL come after everything in the left operand
+        while (ok && pending_count > 0 && pending[pending_count - 1].end <= root + i) {
+            ok = print_null_operand(printer, 1, pending[--pending_count].depth);
+        }
+
+        const PooledPlacement* placement = &placements[i];
+        int                    depth     = placement->depth;
+        if (depth < 0 || !ok)
+            continue;
+
+        if (i > 0)
+            print_child_heading(printer, placement->parent, placement->slot, depth);
+        printer_write_indent(printer, depth);
+        PrintedNode view = view_pooled(pool, root + (NodeIndex)i);
+        ok               = print_fields_text(printer, &view, depth);
+        if (!prints_children(view.type))
+            continue;
+
+        // Only the children of expressions and IN lists are printed
+        const FlatNode* node = &pool->nodes[root + i];
+        for (uint32_t slot = 0; slot < node->as.children.count; slot++) {
+            NodeIndex child = ast_pool_child(pool, node, slot);
+            if (child != NODE_INDEX_NONE) {
+                placements[child - root].depth  = depth + 2;
+                placements[child - root].parent = view.type;
+                placements[child - root].slot   = (int)slot;
+            }
+        }
+        if (view.type != NODE_BINARY_EXPR)
+            continue;
+
+        // Empty operands of binary expressions are printed as NULL
+        NodeIndex left  = ast_pool_child(pool, node, 0);
+        NodeIndex right = ast_pool_child(pool, node, 1);
+        if (left == NODE_INDEX_NONE) {
+            ok = ok && print_null_operand(printer, 0, depth);
+            if (right == NODE_INDEX_NONE)
+                ok = ok && print_null_operand(printer, 1, depth);
+        } else if (right == NODE_INDEX_NONE) {
+            pending[pending_count].end     = ast_pool_end(pool, left);
+            pending[pending_count++].depth = depth;
+        }
+    }
+
+    while (ok && pending_count > 0) {
+        ok = print_null_operand(printer, 1, pending[--pending_count].depth);
+    }
+
+    free(placements);
+    free(pending);
+    return ok;
+}
+
+/**
+ * @brief Passes a node and its depth to the printer's callback.
+ *
+ * @param frame The node and its position in the tree.
+ * @param user_data The AstPrinter.
+ * @return AST_VISIT_STOP if the callback returned false, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction print_callback_visit(const AstVisitFrame* frame, void* user_data) {
+    AstPrinter* printer = (AstPrinter*)user_data;
+    return printer->output.callback.fn(frame->node, frame->depth,
+                                       printer->output.callback.user_data)
+               ? AST_VISIT_CONTINUE
+               : AST_VISIT_STOP;
+}
+
+/**
+ * @brief Traverses the AST in depth-first order and invokes a callback for each node.
+ *
+ * For each node in the AST, in preorder, calls the user-provided callback function with the node
+ * and its depth. Traversal uses ast_visit(), which keeps its stack on the heap rather than
+ * recursing.
+ *
+ * @return true if traversal completes; false if the callback stopped it or the printer is
+ * misconfigured.
+ */
+static bool print_node_callback(AstPrinter* printer, const Node* node) {
+    if (printer->type != AST_OUTPUT_CALLBACK || !printer->output.callback.fn) {
+        return false;
+    }
+
+    AstVisitor visitor = {print_callback_visit, NULL, printer, false};
+    return ast_visit((Node*)node, &visitor);
+}
+
+/**
+ * @brief Initializes an AstPrinter for file output with the specified format.
+ *
+ * Configures the printer to write AST output to a given file stream, enabling pretty printing and
+ * line numbers by default.
+ *
+ * @param printer Pointer to the AstPrinter to initialize.
+ * @param format Output format for the AST (e.g., text, JSON).
+ * @param file File stream to which the AST will be written.
+ * @return true if initialization succeeds; false if printer or file is NULL.
+ */
+bool ast_printer_init_file(AstPrinter* printer, AstOutputFormat format, FILE* file) {
+    if (!printer || !file)
+        return false;
+
+    memset(printer, 0, sizeof(AstPrinter));
+    printer->format               = format;
+    printer->type                 = AST_OUTPUT_FILE;
+    printer->output.file          = file;
+    printer->indent_size          = 2;
+    printer->pretty_print         = true;
+    printer->include_line_numbers = true;
+
+    return true;
+}
+
+/**
+ * @brief Initializes an AstPrinter for output to a character buffer.
+ *
+ * Configures the printer to write AST output in the specified format to a provided buffer,
+ * enabling pretty printing and line numbers by default. The buffer is null-terminated and
+ * its size is respected to prevent overflow. A NULL buffer of size 0 only measures the output.
+ *
+ * @param printer Pointer to the AstPrinter to initialize.
+ * @param format Output format for the AST (e.g., text, JSON).
+ * @param buffer Destination buffer for output, or NULL if size is 0.
+ * @param size Size of the buffer in bytes.
+ * @return true if initialization succeeds; false if arguments are invalid.
+ */
+bool ast_printer_init_buffer(AstPrinter* printer, AstOutputFormat format, char* buffer,
+                             size_t size) {
+    if (!printer || (!buffer && size > 0))
+        return false;
+
+    memset(printer, 0, sizeof(AstPrinter));
+    printer->format               = format;
+    printer->type                 = AST_OUTPUT_BUFFER;
+    printer->output.buf.buffer    = buffer;
+    printer->output.buf.size      = size;
+    printer->output.buf.written   = 0;
+    printer->indent_size          = 2;
+    printer->pretty_print         = true;
+    printer->include_line_numbers = true;
+
+    // Ensure the buffer is null-terminated initially
+    if (size > 0)
+        buffer[0] = '\0';
+
+    return true;
+}
+
+/**
+ * @brief Initializes an AstPrinter for output to a heap buffer that grows as needed.
+ *
+ * Configures the printer with pretty printing and line numbers enabled by default. The buffer is
+ * allocated on the first write.
+ *
+ * @param printer Pointer to the AstPrinter to initialize.
+ * @param format Output format for the AST (e.g., text, JSON).
+ * @return true if initialization succeeds; false if printer is NULL.
+ */
+bool ast_printer_init_dynamic(AstPrinter* printer, AstOutputFormat format) {
+    if (!printer)
+        return false;
+
+    memset(printer, 0, sizeof(AstPrinter));
+    printer->format               = format;
+    printer->type                 = AST_OUTPUT_DYNAMIC;
+    printer->indent_size          = 2;
+    printer->pretty_print         = true;
+    printer->include_line_numbers = true;
+
+    return true;
+}
+
+/**
+ * @brief Initializes an AstPrinter for callback-based output.
+ *
+ * Configures the printer to traverse the AST and invoke a user-provided callback function for each
+ * node, using the specified output format.
+ *
+ * @param printer Pointer to the AstPrinter to initialize.
+ * @param format Output format to use when printing nodes.
+ * @param callback Function to call for each node during traversal.
+ * @param user_data User-defined data passed to the callback function.
+ * @return true if initialization succeeds; false if printer or callback is NULL.
+ */
+bool ast_printer_init_callback(AstPrinter* printer, AstOutputFormat format,
+                               AstPrintCallback callback, void* user_data) {
+    if (!printer || !callback)
+        return false;
+
+    memset(printer, 0, sizeof(AstPrinter));
+    printer->format                    = format;
+    printer->type                      = AST_OUTPUT_CALLBACK;
+    printer->output.callback.fn        = callback;
+    printer->output.callback.user_data = user_data;
+    printer->indent_size               = 2;
+    printer->pretty_print              = true;
+    printer->include_line_numbers      = true;
+
+    return true;
+}
+
+/**
+ * @brief Prints an AST node using the specified printer configuration.
+ *
+ * Selects the appropriate output method (file, buffer, or callback) and format (text, JSON, etc.)
+ * as configured in the printer. Returns false if the printer is invalid or if printing fails.
+ *
+ * @param printer Configured AST printer specifying output type and format.
+ * @param node Root AST node to print.
+ * @return true if printing succeeds; false otherwise.
+ */
+bool ast_printer_print(AstPrinter* printer, const Node* node) {
+    if (!printer)
+        return false;
+
+    if (printer->type == AST_OUTPUT_CALLBACK) {
+        return print_node_callback(printer, node);
+    }
+
+    char block[AST_PRINTER_BLOCK_SIZE];
+    printer_begin(printer, block);
+    return printer_end(printer, print_tree(printer, node));
+}
+
+/**
+ * @brief Prints a tree held in an AstPool using the specified printer configuration.
+ *
+ * Produces the same output as ast_printer_print() on the equivalent Node tree, by scanning the
+ * pooled nodes in order instead of following pointers. Callback output is not supported, since
+ * callbacks receive Node pointers.
+ *
+ * @param printer Configured AST printer specifying output type and format.
+ * @param pool The pool holding the tree.
+ * @param root Index of the root node.
+ * @return true if printing succeeds; false otherwise.
+ */
+bool ast_printer_print_pool(AstPrinter* printer, const AstPool* pool, NodeIndex root) {
+    if (!printer || !pool || root >= pool->node_count || printer->type == AST_OUTPUT_CALLBACK)
+        return false;
+
+    char block[AST_PRINTER_BLOCK_SIZE];
+    bool ok = false;
+    printer_begin(printer, block);
+    switch (printer->format) {
+        case AST_FORMAT_TEXT:
+            ok = print_pool_text(printer, pool, root);
+            break;
+
+        case AST_FORMAT_JSON: {
+            // Only the root is printed in JSON
+            PrintedNode view = view_pooled(pool, root);
+            ok               = print_json_line(printer, &view, 0);
+            break;
+        }
+
+        default:
+            break;
+    }
+    return printer_end(printer, ok);
+}
+
+/**
+ * @brief Starts the JSON object of a node entered by an event sink.
+ *
+ * The first child of a node opens its "children" array, later ones are separated by commas.
+ *
+ * @param node The node.
+ * @param user_data The AstPrinter.
+ * @return true if printing succeeds; false otherwise.
+ */
+static bool json_event_enter(const AstEventNode* node, void* user_data) {
+    AstPrinter* printer = (AstPrinter*)user_data;
+
+    if (node->depth > 0) {
+        bool ok = node->index == 0 ? printer_write_literal(printer, ",\"children\":[")
+                                   : printer_write_literal(printer, ",");
+        if (!ok)
+            return false;
+    }
+
+    if (!printer_write_literal(printer, "{\"type\":\"") ||
+        !printer_write(printer, node_type_name(node->type)) ||
+        !printer_write_literal(printer, "\""))
+        return false;
+    return !printer->include_line_numbers || printer_writef(printer, ",\"line\":%d", node->line);
+}
+
+/**
+ * @brief Prints a field sent to an event sink as a member of the current JSON object.
+ *
+ * @param field The field.
+ * @param user_data The AstPrinter.
+ * @return true if printing succeeds; false otherwise.
+ */
+static bool json_event_field(const AstField* field, void* user_data) {
+    AstPrinter* printer = (AstPrinter*)user_data;
+
+    if (!printer_write_literal(printer, ",\"") || !printer_write(printer, field->name) ||
+        !printer_write_literal(printer, "\":"))
+        return false;
+
+    switch (field->type) {
+        case AST_FIELD_STRING:
+            return printer_write_literal(printer, "\"") &&
+                   printer_write_json_string(printer, field->string, field->length) &&
+                   printer_write_literal(printer, "\"");
+
+        case AST_FIELD_NUMBER:
+            return printer_writef(printer, "%g", field->number);
+
+        case AST_FIELD_INTEGER:
+            return printer_writef(printer, "%" PRId64, field->integer);
+
+        case AST_FIELD_BOOLEAN:
+            return field->integer ? printer_write_literal(printer, "true")
+                                  : printer_write_literal(printer, "false");
+
+        case AST_FIELD_OPERATOR: {
+            const char* name = operator_name((NsqlTokenType)field->integer, "unknown");
+            return printer_write_literal(printer, "\"") && printer_write(printer, name) &&
+                   printer_write_literal(printer, "\"");
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Closes the JSON object of a node left by an event sink, and ends the line after a root.
+ *
+ * @param node The node.
+ * @param user_data The AstPrinter.
+ * @return true if printing succeeds; false otherwise.
+ */
+static bool json_event_leave(const AstEventNode* node, void* user_data) {
+    AstPrinter* printer = (AstPrinter*)user_data;
+
+    if (node->children > 0 && !printer_write_literal(printer, "]"))
+        return false;
+    if (!printer_write_literal(printer, "}"))
+        return false;
+    return node->depth > 0 || printer_write_literal(printer, "\n");
+}
+
+/**
+ * @brief Sets up an event sink that prints every tree it receives as one line of JSON.
+ *
+ * Each node becomes an object with its type, line (if enabled) and fields, and the nodes below it
+ * in a "children" array. Output goes to the printer's file or buffer as the events arrive.
+ *
+ * @param printer A JSON printer with file, buffer or dynamic output.
+ * @param sink Receives the callbacks, with the printer as their user data.
+ * @return true if the sink was set up; false if the printer cannot print event streams.
+ */
+bool ast_printer_event_sink(AstPrinter* printer, AstEventSink* sink) {
+    if (!printer || !sink || printer->format != AST_FORMAT_JSON ||
+        printer->type == AST_OUTPUT_CALLBACK)
+        return false;
+
+    sink->enter     = json_event_enter;
+    sink->field     = json_event_field;
+    sink->leave     = json_event_leave;
+    sink->user_data = printer;
+    return true;
+}
+
+/**
+ * @brief Releases resources associated with an AstPrinter.
+ *
+ * Frees the heap buffer of a dynamic printer. Other printers own no resources.
+ */
+void ast_printer_free(AstPrinter* printer) {
+    if (!printer || printer->type != AST_OUTPUT_DYNAMIC)
+        return;
+
+    free(printer->output.heap.data);
+    printer->output.heap.data     = NULL;
+    printer->output.heap.length   = 0;
+    printer->output.heap.capacity = 0;
+}
+
+/**
+ * @brief Returns the number of bytes written to the output buffer.
+ *
+ * If the printer is not configured for buffer or dynamic output or is invalid, returns 0.
+ *
+ * @param printer Pointer to the AstPrinter instance.
+ * @return Number of bytes written to the buffer, or 0 if not applicable.
+ */
+size_t ast_printer_get_written(const AstPrinter* printer) {
+    if (!printer)
+        return 0;
+    if (printer->type == AST_OUTPUT_DYNAMIC)
+        return printer->output.heap.length;
+    if (printer->type != AST_OUTPUT_BUFFER)
+        return 0;
+    return printer->output.buf.written;
+}
+
+/**
+ * @brief Returns the number of bytes the output needs, including any that did not fit.
+ *
+ * @param printer Pointer to the AstPrinter instance.
+ * @return Number of bytes printed, or 0 if the printer is not a buffer or dynamic printer.
+ */
+size_t ast_printer_get_required(const AstPrinter* printer) {
+    if (!printer)
+        return 0;
+    if (printer->type == AST_OUTPUT_DYNAMIC)
+        return printer->output.heap.length;
+    if (printer->type != AST_OUTPUT_BUFFER)
+        return 0;
+    return printer->output.buf.required;
+}
+
+/**
+ * @brief Hands the heap buffer of a dynamic printer to the caller.
+ *
+ * The printer keeps printing into a new buffer. A printer that has written nothing returns an
+ * empty string.
+ *
+ * @param printer Pointer to the AstPrinter instance.
+ * @param length Receives the length of the output, if not NULL.
+ * @return The NUL-terminated output, or NULL if the printer is not a dynamic printer.
+ */
+char* ast_printer_take_output(AstPrinter* printer, size_t* length) {
+    if (!printer || printer->type != AST_OUTPUT_DYNAMIC)
+        return NULL;
+
+    printer_reserve(printer, 0);
+    printer->output.heap.data[printer->output.heap.length] = '\0';
+
+    char* output = printer->output.heap.data;
+    if (length)
+        *length = printer->output.heap.length;
+    printer->output.heap.data     = NULL;
+    printer->output.heap.length   = 0;
+    printer->output.heap.capacity = 0;
+    return output;
+}
@@ -0,0 +1,1615 @@
+/**
+ * @file ast_reader.c
+ * @brief Zero-copy reader for serialized ASTs
+ *
+ * A node is encoded as its type byte and line number followed by its fields. In version 2 the
+ * scalar fields come first, then a table with the offset of each child slot, then the children;
+ * version 1 interleaves fields and children and marks an absent child with a single 0xFF byte.
+ * Version 3 is version 2 with a string table: its nodes hold varint references to table entries
+ * instead of length-prefixed strings.
+ * ast_reader_init() walks every node once with bounds checks, after which offsets handed out by
+ * the reader are known to be well formed.
+ */
+
+#include <nsql/ast_reader.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checksum.h"
+
+// Header field offsets
+#define HEADER_MAGIC 0
+#define HEADER_VERSION 4
+#define HEADER_ALGORITHM 8
+#define HEADER_DATA_SIZE 12
+#define HEADER_CHECKSUM 20
+#define HEADER_CODEC 24
+
+// Type byte and line number
+#define NODE_HEADER_SIZE 5
+
+// Marker written for absent children
+#define NULL_NODE 0xFF
+
+// Fixed part of the version 1 metadata block: hints, priority, engine, rows, timeout, index length
+#define METADATA_V1_SIZE 14
+
+// Open nodes kept on the C stack before a walk moves to the heap
+#define INLINE_NODES 32
+
+/**
+ * Read a 16-bit unsigned integer.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static uint16_t read_uint16(const unsigned char* p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Read a 32-bit unsigned integer.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static uint32_t read_uint32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Read a 32-bit signed integer.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static int32_t read_int32(const unsigned char* p) {
+    int32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Read a double.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static double read_double(const unsigned char* p) {
+    double value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Read a varint.
+ *
+ * @param data The data.
+ * @param size Size of the data.
+ * @param pos Offset of the varint.
+ * @param value Receives the value.
+ * @return Offset after the varint, or AST_READER_NULL if it overruns the data or 32 bits.
+ */
+static size_t read_varint(const unsigned char* data, size_t size, size_t pos, uint32_t* value) {
+    *value = 0;
+    for (unsigned int shift = 0; shift < 32 && pos < size; shift += 7) {
+        unsigned char byte = data[pos++];
+        if (shift == 28 && byte > 0x0F)
+            return AST_READER_NULL;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return pos;
+    }
+    return AST_READER_NULL;
+}
+
+/**
+ * Read a string at pos.
+ *
+ * Versions 1 and 2 store a uint16_t length and the bytes. Version 3 stores a varint reference,
+ * the offset of a string table entry plus one, or 0 followed by an inline varint length and the
+ * bytes.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the string.
+ * @param str Receives the start of the string.
+ * @param length Receives the length of the string.
+ * @return Offset after the string, or AST_READER_NULL if it overruns the node data.
+ */
+static size_t string_view(const AstReader* reader, size_t pos, const char** str, size_t* length) {
+    const unsigned char* data = reader->nodes;
+    size_t               size = reader->nodes_size;
+
+    if (reader->version < AST_VERSION) {
+        if (pos + sizeof(uint16_t) > size)
+            return AST_READER_NULL;
+        *length = read_uint16(data + pos);
+        *str    = (const char*)data + pos + sizeof(uint16_t);
+        pos += sizeof(uint16_t) + *length;
+        return pos <= size ? pos : AST_READER_NULL;
+    }
+
+    uint32_t reference;
+    uint32_t len;
+    pos = read_varint(data, size, pos, &reference);
+    if (pos == AST_READER_NULL)
+        return AST_READER_NULL;
+
+    if (reference == 0) {
+        pos = read_varint(data, size, pos, &len);
+        if (pos == AST_READER_NULL || len > size - pos)
+            return AST_READER_NULL;
+        *length = len;
+        *str    = (const char*)data + pos;
+        return pos + len;
+    }
+
+    size_t entry = read_varint(reader->strings, reader->strings_size, reference - 1, &len);
+    if (entry == AST_READER_NULL || len > reader->strings_size - entry)
+        return AST_READER_NULL;
+    *length = len;
+    *str    = (const char*)reader->strings + entry;
+    return pos;
+}
+
+/**
+ * Skip a string.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the string.
+ * @return Offset after the string, or AST_READER_NULL if it overruns the node data.
+ */
+static size_t string_end(const AstReader* reader, size_t pos) {
+    const char* str;
+    size_t      length;
+    return string_view(reader, pos, &str, &length);
+}
+
+// A node whose children are being walked
+typedef struct {
+    size_t node;   // Offset of the node
+    size_t table;  // Offset of its child table (version 2)
+    size_t next;   // Index of the next child slot
+    size_t count;  // Number of child slots
+    Node*  built;  // The node built from it (ast_reader_materialize())
+} OpenNode;
+
+// Path from the subtree root to the node being walked, on the heap so nesting is not limited
+typedef struct {
+    OpenNode* items;         // Open nodes, the innermost last
+    size_t    count;         // Number of open nodes
+    size_t    capacity;      // Allocated entries
+    OpenNode* inline_items;  // The initial, stack-allocated array
+} OpenStack;
+
+/**
+ * Open a node, making it the innermost one of a walk.
+ *
+ * @param stack The stack.
+ * @param node Offset of the node.
+ * @param table Offset of its child table (version 2).
+ * @param count Number of child slots.
+ */
+static void open_node(OpenStack* stack, size_t node, size_t table, size_t count) {
+    if (stack->count == stack->capacity) {
+        // The initial array is on the C stack, so it is copied rather than reallocated
+        bool      moved = stack->items == stack->inline_items;
+        size_t    size  = 2 * stack->capacity * sizeof(OpenNode);
+        OpenNode* items = moved ? (OpenNode*)malloc(size) : (OpenNode*)realloc(stack->items, size);
+        if (!items) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        if (moved)
+            memcpy(items, stack->inline_items, stack->count * sizeof(OpenNode));
+        stack->items = items;
+        stack->capacity *= 2;
+    }
+
+    OpenNode* open = &stack->items[stack->count++];
+    open->node     = node;
+    open->table    = table;
+    open->next     = 0;
+    open->count    = count;
+    open->built    = NULL;
+}
+
+/**
+ * Release the memory of a walk.
+ *
+ * @param stack The stack.
+ */
+static void free_open_nodes(OpenStack* stack) {
+    if (stack->items != stack->inline_items)
+        free(stack->items);
+}
+
+/**
+ * Check the fields of a version 1 node up to its first child.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the node.
+ * @param count Receives the number of child slots known so far.
+ * @return Offset of the first child, or of the end of a node without children, or
+ *         AST_READER_NULL if the node is malformed.
+ */
+static size_t node_start_v1(const AstReader* reader, size_t pos, size_t* count) {
+    const unsigned char* data = reader->nodes;
+    size_t               size = reader->nodes_size;
+
+    *count = 0;
+    if (pos >= size)
+        return AST_READER_NULL;
+    if (data[pos] == NULL_NODE)
+        return pos + 1;
+    if (pos + NODE_HEADER_SIZE > size)
+        return AST_READER_NULL;
+
+    NodeType type = (NodeType)data[pos];
+    size_t   p    = pos + NODE_HEADER_SIZE;
+
+// Reserve n bytes of fixed fields
+#define NEED(n)                     \
+    do {                            \
+        if (p + (n) > size)         \
+            return AST_READER_NULL; \
+    } while (0)
+
+    switch (type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            *count = 6;
+            break;
+
+        case NODE_TELL_QUERY:
+            *count = 3;
+            break;
+
+        case NODE_FIND_QUERY:
+            *count = 5;
+            break;
+
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+            *count = 2;
+            break;
+
+        case NODE_REMOVE_ACTION:
+            *count = 1;
+            break;
+
+        case NODE_FIELD_LIST:
+        case NODE_CREATE_ACTION:
+        case NODE_ORDER_BY:
+        case NODE_UPDATE_ACTION:
+            NEED(2);
+            *count = read_uint16(data + p);
+            if (type == NODE_UPDATE_ACTION)
+                *count *= 2;  // Fields and values alternate
+            p += 2;
+            break;
+
+        case NODE_SOURCE:
+            p = string_end(reader, p);
+            if (p == AST_READER_NULL)
+                return AST_READER_NULL;
+            NEED(1);
+            *count = data[p++] != 0;
+            break;
+
+        case NODE_LIMIT:
+            NEED(8);
+            p += 8;
+            break;
+
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+            NEED(1);
+            p++;  // Operator
+            *count = type == NODE_BINARY_EXPR ? 2 : 1;
+            break;
+
+        case NODE_IDENTIFIER:
+        case NODE_ERROR:
+            p = string_end(reader, p);
+            break;
+
+        case NODE_LITERAL:
+            NEED(1);
+            switch (data[p++]) {
+                case TOKEN_STRING:
+                    p = string_end(reader, p);
+                    break;
+                case TOKEN_INTEGER:
+                case TOKEN_DECIMAL:
+                    NEED(sizeof(double));
+                    p += sizeof(double);
+                    break;
+                default:
+                    return AST_READER_NULL;
+            }
+            break;
+
+        case NODE_FIELD_DEF:
+            // The constraints are counted after the name, see node_child_end_v1()
+            *count = 1;
+            break;
+
+        case NODE_CONSTRAINT:
+            NEED(1);
+            p++;  // Constraint type
+            *count = 1;
+            break;
+
+        case NODE_FUNCTION_CALL:
+            p = string_end(reader, p);
+            if (p == AST_READER_NULL)
+                return AST_READER_NULL;
+            NEED(2);
+            *count = read_uint16(data + p);
+            p += 2;
+            break;
+
+        case NODE_PARAMETER:
+            NEED(2);
+            p += 2;
+            break;
+
+        default:
+            return AST_READER_NULL;  // Not produced by the serializer
+    }
+
+#undef NEED
+
+    return p;
+}
+
+/**
+ * Check the fields that follow a child of a version 1 node.
+ *
+ * @param reader The reader.
+ * @param open The node, whose next slot is advanced past the child.
+ * @param pos Offset after the child.
+ * @return Offset of the next child slot or of the end of the node, or AST_READER_NULL if the
+ *         fields are malformed.
+ */
+static size_t node_child_end_v1(const AstReader* reader, OpenNode* open, size_t pos) {
+    const unsigned char* data = reader->nodes;
+    size_t               size = reader->nodes_size;
+
+    open->next++;
+    switch ((NodeType)data[open->node]) {
+        case NODE_ORDER_BY:
+            return pos + 1 <= size ? pos + 1 : AST_READER_NULL;  // Sort direction
+
+        case NODE_FIELD_DEF:
+            if (open->next > 1)
+                return pos;
+
+            // The name is followed by the type and the constraint count
+            pos = string_end(reader, pos);
+            if (pos == AST_READER_NULL || pos + 2 > size)
+                return AST_READER_NULL;
+            open->count += read_uint16(data + pos);
+            return pos + 2;
+
+        default:
+            return pos;
+    }
+}
+
+/**
+ * Find the end of a version 1 subtree, checking that it is well formed.
+ *
+ * The walk keeps the path to the current node on the heap, so the nesting of the subtree is
+ * limited only by its size.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the subtree.
+ * @return Offset after the subtree, or AST_READER_NULL if it is malformed.
+ */
+static size_t node_end_v1(const AstReader* reader, size_t pos) {
+    OpenNode  inline_items[INLINE_NODES];
+    OpenStack open = {inline_items, 0, INLINE_NODES, inline_items};
+    size_t    p    = pos;
+
+    while (p != AST_READER_NULL) {
+        size_t node = p;
+        size_t count;
+        p = node_start_v1(reader, node, &count);
+        if (p == AST_READER_NULL)
+            break;
+        if (count > 0) {
+            open_node(&open, node, 0, count);
+            continue;
+        }
+
+        // The node is done, and so is every open node whose last child it was
+        while (open.count > 0 && p != AST_READER_NULL) {
+            OpenNode* parent = &open.items[open.count - 1];
+            p                = node_child_end_v1(reader, parent, p);
+            if (parent->next < parent->count)
+                break;
+            open.count--;
+        }
+        if (open.count == 0)
+            break;
+    }
+
+    free_open_nodes(&open);
+    return p;
+}
+
+/**
+ * Find the child table of a version 2 node.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @param count Receives the number of child slots.
+ * @return Offset of the child table, or AST_READER_NULL if the fields overrun the node data.
+ */
+static size_t child_table(const AstReader* reader, size_t node, size_t* count) {
+    const unsigned char* data = reader->nodes;
+    size_t               size = reader->nodes_size;
+    size_t               p    = node + NODE_HEADER_SIZE;
+
+    *count = 0;
+    if (p > size)
+        return AST_READER_NULL;
+
+    switch ((NodeType)data[node]) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            *count = 6;
+            break;
+
+        case NODE_TELL_QUERY:
+            *count = 3;
+            break;
+
+        case NODE_FIND_QUERY:
+            *count = 5;
+            break;
+
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+            *count = 2;
+            break;
+
+        case NODE_REMOVE_ACTION:
+            *count = 1;
+            break;
+
+        case NODE_PROGRAM:
+            if (p + 4 > size)
+                return AST_READER_NULL;
+            *count = read_uint32(data + p);
+            p += 4;
+            break;
+
+        case NODE_FIELD_LIST:
+        case NODE_CREATE_ACTION:
+        case NODE_UPDATE_ACTION:
+            if (p + 2 > size)
+                return AST_READER_NULL;
+            *count = read_uint16(data + p);
+            if (data[node] == NODE_UPDATE_ACTION)
+                *count *= 2;  // Fields and values alternate
+            p += 2;
+            break;
+
+        case NODE_SOURCE:
+            p = string_end(reader, p);
+            if (p == AST_READER_NULL || p + 1 > size)
+                return AST_READER_NULL;
+            *count = data[p++] != 0;
+            break;
+
+        case NODE_ORDER_BY:
+            if (p + 2 > size)
+                return AST_READER_NULL;
+            *count = read_uint16(data + p);
+            p += 2 + *count;  // Count and sort directions
+            break;
+
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+        case NODE_CONSTRAINT:
+            *count = data[node] == NODE_BINARY_EXPR ? 2 : 1;
+            p++;  // Operator or constraint type
+            break;
+
+        case NODE_FIELD_DEF:
+        case NODE_FUNCTION_CALL:
+            p = string_end(reader, p);
+            if (p == AST_READER_NULL || p + 2 > size)
+                return AST_READER_NULL;
+            *count = read_uint16(data + p);
+            if (data[node] == NODE_FIELD_DEF)
+                (*count)++;  // The name comes before the constraints
+            p += 2;
+            break;
+
+        case NODE_LOGICAL_EXPR:
+        case NODE_IN_LIST: {
+            uint32_t length;
+            if (data[node] == NODE_LOGICAL_EXPR)
+                p++;  // Operator
+            p = read_varint(data, size, p, &length);
+            if (p == AST_READER_NULL)
+                return AST_READER_NULL;
+            *count = data[node] == NODE_IN_LIST ? 1 + (size_t)length : length;
+            break;
+        }
+
+        default:
+            break;  // Leaves have no table
+    }
+
+    return p <= size ? p : AST_READER_NULL;
+}
+
+/**
+ * Check the fields of a version 2 node up to its children.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the node.
+ * @param table Receives the offset of the child table.
+ * @param count Receives the number of child slots.
+ * @return Offset after the child table, or of the end of a leaf, or AST_READER_NULL if the node
+ *         is malformed.
+ */
+static size_t node_start_v2(const AstReader* reader, size_t pos, size_t* table, size_t* count) {
+    const unsigned char* data = reader->nodes;
+    size_t               size = reader->nodes_size;
+
+    *table = AST_READER_NULL;
+    *count = 0;
+    if (pos + NODE_HEADER_SIZE > size)
+        return AST_READER_NULL;
+
+    // N-ary expressions came with the string table
+    size_t p = pos + NODE_HEADER_SIZE;
+    if (data[pos] >= NODE_LOGICAL_EXPR && reader->version < AST_VERSION)
+        return AST_READER_NULL;
+
+    switch ((NodeType)data[pos]) {
+        case NODE_LIMIT:
+            p += 8;
+            break;
+
+        case NODE_IDENTIFIER:
+        case NODE_ERROR:
+            p = string_end(reader, p);
+            break;
+
+        case NODE_LITERAL:
+            if (p + 1 > size)
+                return AST_READER_NULL;
+            switch (data[p++]) {
+                case TOKEN_STRING:
+                    p = string_end(reader, p);
+                    break;
+                case TOKEN_INTEGER:
+                case TOKEN_DECIMAL:
+                    p += sizeof(double);
+                    break;
+                default:
+                    return AST_READER_NULL;
+            }
+            break;
+
+        case NODE_PARAMETER:
+            p += 2;
+            break;
+
+        case NODE_ASK_QUERY:
+        case NODE_TELL_QUERY:
+        case NODE_FIND_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+        case NODE_FIELD_LIST:
+        case NODE_SOURCE:
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ORDER_BY:
+        case NODE_ADD_ACTION:
+        case NODE_REMOVE_ACTION:
+        case NODE_UPDATE_ACTION:
+        case NODE_CREATE_ACTION:
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+        case NODE_FIELD_DEF:
+        case NODE_CONSTRAINT:
+        case NODE_FUNCTION_CALL:
+        case NODE_PROGRAM:
+        case NODE_LOGICAL_EXPR:
+        case NODE_IN_LIST:
+            *table = child_table(reader, pos, count);
+            if (*table == AST_READER_NULL || *count > (size - *table) / sizeof(uint32_t))
+                return AST_READER_NULL;
+            p = *table + *count * sizeof(uint32_t);
+            break;
+
+        default:
+            return AST_READER_NULL;  // Not produced by the serializer
+    }
+
+    return p != AST_READER_NULL && p <= size ? p : AST_READER_NULL;
+}
+
+/**
+ * Find the end of a version 2 subtree, checking that it is well formed.
+ *
+ * Children must follow the table back to back in slot order, so every offset in the table is
+ * checked against the position the previous child ended at. The walk keeps the path to the
+ * current node on the heap, so the nesting of the subtree is limited only by its size.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the subtree.
+ * @return Offset after the subtree, or AST_READER_NULL if it is malformed.
+ */
+static size_t node_end_v2(const AstReader* reader, size_t pos) {
+    const unsigned char* data = reader->nodes;
+    OpenNode             inline_items[INLINE_NODES];
+    OpenStack            open = {inline_items, 0, INLINE_NODES, inline_items};
+    size_t               p    = pos;
+
+    while (p != AST_READER_NULL) {
+        size_t node = p;
+        size_t table;
+        size_t count;
+        p = node_start_v2(reader, node, &table, &count);
+        if (p == AST_READER_NULL)
+            break;
+        if (count > 0)
+            open_node(&open, node, table, count);
+
+        // Find the next present child, closing every open node that has none left
+        uint32_t offset = 0;
+        while (open.count > 0) {
+            OpenNode* parent = &open.items[open.count - 1];
+            while (parent->next < parent->count && offset == 0) {
+                offset = read_uint32(data + parent->table + parent->next++ * sizeof(uint32_t));
+            }
+            if (offset != 0)
+                break;
+            open.count--;
+        }
+        if (open.count == 0)
+            break;
+        if (open.items[open.count - 1].node + offset != p)
+            p = AST_READER_NULL;
+    }
+
+    free_open_nodes(&open);
+    return p;
+}
+
+/**
+ * Initialize a reader over a serialized AST.
+ *
+ * @param reader The reader to initialize.
+ * @param data The serialized data.
+ * @param size Size of the data in bytes.
+ * @param verify_checksum Whether to also verify the checksum.
+ * @return true if the data is a valid serialized AST.
+ */
+bool ast_reader_init(AstReader* reader, const void* data, size_t size, bool verify_checksum) {
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    memset(reader, 0, sizeof(AstReader));
+    if (!data || size < AST_HEADER_SIZE)
+        return false;
+
+    uint32_t version = read_uint32(bytes + HEADER_VERSION);
+    if (read_uint32(bytes + HEADER_MAGIC) != AST_MAGIC_NUMBER || version < AST_VERSION_1 ||
+        version > AST_VERSION)
+        return false;
+
+    uint32_t data_size = read_uint32(bytes + HEADER_DATA_SIZE);
+    if (size != AST_HEADER_SIZE + (size_t)data_size ||
+        read_uint32(bytes + HEADER_CODEC) != AST_CODEC_NONE)
+        return false;
+
+    uint32_t checksum;
+    if (verify_checksum &&
+        (!nsql_checksum(read_uint32(bytes + HEADER_ALGORITHM), bytes + AST_HEADER_SIZE, data_size,
+                        &checksum) ||
+         checksum != read_uint32(bytes + HEADER_CHECKSUM)))
+        return false;
+
+    const unsigned char* payload = bytes + AST_HEADER_SIZE;
+    if (version == AST_VERSION_1) {
+        // The node data is followed directly by the metadata block
+        reader->nodes      = payload;
+        reader->nodes_size = data_size;
+        reader->version    = version;
+
+        size_t end = node_end_v1(reader, 0);
+        if (end == AST_READER_NULL || payload[0] == NULL_NODE ||
+            data_size - end < METADATA_V1_SIZE)
+            return false;
+
+        size_t index_length = read_uint16(payload + end + METADATA_V1_SIZE - 2);
+        if (data_size - end != METADATA_V1_SIZE + index_length)
+            return false;
+
+        reader->nodes_size    = end;
+        reader->metadata      = payload + end;
+        reader->metadata_size = data_size - end;
+        return true;
+    }
+
+    // The metadata block comes first, then the nodes, then the string table (version 3)
+    if (data_size < AST_METADATA_SIZE)
+        return false;
+    size_t metadata_size = AST_METADATA_SIZE + (size_t)read_uint16(payload + 12);
+    if (metadata_size > data_size)
+        return false;
+
+    size_t nodes_end = data_size;
+    if (version == AST_VERSION) {
+        // The string table and its size end the data
+        if (data_size - metadata_size < sizeof(uint32_t))
+            return false;
+        size_t table_size = read_uint32(payload + data_size - sizeof(uint32_t));
+        if (table_size > data_size - metadata_size - sizeof(uint32_t))
+            return false;
+        nodes_end            = data_size - sizeof(uint32_t) - table_size;
+        reader->strings      = payload + nodes_end;
+        reader->strings_size = table_size;
+    }
+
+    reader->nodes      = payload + metadata_size;
+    reader->nodes_size = nodes_end - metadata_size;
+    reader->version    = version;
+    if (node_end_v2(reader, 0) != reader->nodes_size)
+        return false;
+
+    reader->metadata      = payload;
+    reader->metadata_size = metadata_size;
+    return true;
+}
+
+/**
+ * Get the root node.
+ *
+ * @param reader The reader.
+ * @return Offset of the root node.
+ */
+size_t ast_reader_root(const AstReader* reader) {
+    return reader->nodes != NULL ? 0 : AST_READER_NULL;
+}
+
+/**
+ * Get the type of a node.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @return The node type.
+ */
+NodeType ast_reader_type(const AstReader* reader, size_t node) {
+    return (NodeType)reader->nodes[node];
+}
+
+/**
+ * Get the line number of a node.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @return The line number.
+ */
+int ast_reader_line(const AstReader* reader, size_t node) {
+    return (int)read_uint32(reader->nodes + node + 1);
+}
+
+/**
+ * Get the offset of the fields that follow a node's header.
+ *
+ * @param node Offset of the node.
+ * @return Offset of the first field.
+ */
+static size_t fields_of(size_t node) {
+    return node + NODE_HEADER_SIZE;
+}
+
+/**
+ * Get the offset of a version 1 node's first child slot.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @return Offset of the first child slot.
+ */
+static size_t first_child(const AstReader* reader, size_t node) {
+    size_t p = fields_of(node);
+
+    switch (ast_reader_type(reader, node)) {
+        case NODE_FIELD_LIST:
+        case NODE_ORDER_BY:
+        case NODE_UPDATE_ACTION:
+        case NODE_CREATE_ACTION:
+            return p + 2;  // Count
+        case NODE_SOURCE:
+            return string_end(reader, p) + 1;  // Name and join flag
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+        case NODE_CONSTRAINT:
+            return p + 1;  // Operator or constraint type
+        case NODE_FUNCTION_CALL:
+            return string_end(reader, p) + 2;  // Name and count
+        default:
+            return p;
+    }
+}
+
+/**
+ * Get the offset of the version 1 child slot after the one at pos.
+ *
+ * @param reader The reader.
+ * @param node Offset of the parent node.
+ * @param pos Offset of the current child slot.
+ * @param index Index of the current child slot.
+ * @return Offset of the next child slot.
+ */
+static size_t next_child(const AstReader* reader, size_t node, size_t pos, size_t index) {
+    size_t end = node_end_v1(reader, pos);
+
+    switch (ast_reader_type(reader, node)) {
+        case NODE_ORDER_BY:
+            return end + 1;  // Sort direction
+        case NODE_FIELD_DEF:
+            // The name is followed by the type and the constraint count
+            return index == 0 ? string_end(reader, end) + 2 : end;
+        default:
+            return end;
+    }
+}
+
+/**
+ * Get the number of child slots of a version 1 node.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @return The number of child slots.
+ */
+static size_t child_count_v1(const AstReader* reader, size_t node) {
+    const unsigned char* fields = reader->nodes + fields_of(node);
+
+    switch (ast_reader_type(reader, node)) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            return 6;
+        case NODE_TELL_QUERY:
+            return 3;
+        case NODE_FIND_QUERY:
+            return 5;
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+        case NODE_BINARY_EXPR:
+            return 2;
+        case NODE_REMOVE_ACTION:
+        case NODE_UNARY_EXPR:
+        case NODE_CONSTRAINT:
+            return 1;
+        case NODE_FIELD_LIST:
+        case NODE_ORDER_BY:
+        case NODE_CREATE_ACTION:
+            return read_uint16(fields);
+        case NODE_UPDATE_ACTION:
+            return 2 * (size_t)read_uint16(fields);
+        case NODE_SOURCE:
+            return reader->nodes[first_child(reader, node) - 1] != 0;
+        case NODE_FIELD_DEF: {
+            size_t count = string_end(reader, node_end_v1(reader, fields_of(node)));
+            return 1 + (size_t)read_uint16(reader->nodes + count);
+        }
+        case NODE_FUNCTION_CALL:
+            return read_uint16(reader->nodes + first_child(reader, node) - 2);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Get the number of child slots of a node.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @return The number of child slots.
+ */
+size_t ast_reader_child_count(const AstReader* reader, size_t node) {
+    if (reader->version == AST_VERSION_1)
+        return child_count_v1(reader, node);
+
+    size_t count;
+    child_table(reader, node, &count);
+    return count;
+}
+
+/**
+ * Get a child of a node.
+ *
+ * Version 2 nodes look the child up in their table; version 1 nodes have to skip the earlier
+ * siblings.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @param index Index of the child slot.
+ * @return Offset of the child, or AST_READER_NULL if the slot is empty or out of range.
+ */
+size_t ast_reader_child(const AstReader* reader, size_t node, size_t index) {
+    if (reader->version != AST_VERSION_1) {
+        size_t count;
+        size_t table = child_table(reader, node, &count);
+        if (index >= count)
+            return AST_READER_NULL;
+
+        uint32_t offset = read_uint32(reader->nodes + table + index * sizeof(uint32_t));
+        return offset != 0 ? node + offset : AST_READER_NULL;
+    }
+
+    if (index >= child_count_v1(reader, node))
+        return AST_READER_NULL;
+
+    size_t pos = first_child(reader, node);
+    for (size_t i = 0; i < index; i++) {
+        pos = next_child(reader, node, pos, i);
+    }
+    return reader->nodes[pos] == NULL_NODE ? AST_READER_NULL : pos;
+}
+
+/**
+ * Get the string of a node as a view into the buffer.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @param str Receives the start of the string.
+ * @param length Receives the length of the string.
+ * @return true if the node has a string.
+ */
+bool ast_reader_string(const AstReader* reader, size_t node, const char** str, size_t* length) {
+    size_t p = fields_of(node);
+
+    switch (ast_reader_type(reader, node)) {
+        case NODE_IDENTIFIER:
+        case NODE_SOURCE:
+        case NODE_ERROR:
+        case NODE_FUNCTION_CALL:
+            break;
+        case NODE_LITERAL:
+            if (reader->nodes[p] != TOKEN_STRING)
+                return false;
+            p++;
+            break;
+        case NODE_FIELD_DEF:
+            // Version 1 writes the name before the type
+            if (reader->version == AST_VERSION_1)
+                p = node_end_v1(reader, p);
+            break;
+        default:
+            return false;
+    }
+
+    string_view(reader, p, str, length);
+    return true;
+}
+
+/**
+ * Get the type of a literal.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_LITERAL.
+ * @return The literal's token type.
+ */
+NsqlTokenType ast_reader_literal_type(const AstReader* reader, size_t node) {
+    return (NsqlTokenType)reader->nodes[fields_of(node)];
+}
+
+/**
+ * Get the value of a numeric literal.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_LITERAL.
+ * @return The value.
+ */
+double ast_reader_number(const AstReader* reader, size_t node) {
+    if (ast_reader_literal_type(reader, node) == TOKEN_STRING)
+        return 0;
+    return read_double(reader->nodes + fields_of(node) + 1);
+}
+
+/**
+ * Get the operator of an expression.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_BINARY_EXPR, NODE_UNARY_EXPR or NODE_LOGICAL_EXPR.
+ * @return The operator token.
+ */
+NsqlTokenType ast_reader_operator(const AstReader* reader, size_t node) {
+    return (NsqlTokenType)reader->nodes[fields_of(node)];
+}
+
+/**
+ * Get the sort direction of an ORDER BY entry.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_ORDER_BY.
+ * @param index Index of the entry.
+ * @return true for ascending order.
+ */
+bool ast_reader_ascending(const AstReader* reader, size_t node, size_t index) {
+    // Version 2 keeps the directions after the count, version 1 after each entry
+    if (reader->version != AST_VERSION_1)
+        return reader->nodes[fields_of(node) + 2 + index] != 0;
+
+    size_t pos = first_child(reader, node);
+    for (size_t i = 0; i < index; i++) {
+        pos = next_child(reader, node, pos, i);
+    }
+    return reader->nodes[node_end_v1(reader, pos)] != 0;
+}
+
+/**
+ * Get the counts of a LIMIT clause.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_LIMIT.
+ * @param limit Receives the row count.
+ * @param offset Receives the rows to skip.
+ */
+void ast_reader_limit(const AstReader* reader, size_t node, int* limit, int* offset) {
+    const unsigned char* fields = reader->nodes + fields_of(node);
+    *limit                      = read_int32(fields);
+    *offset                     = read_int32(fields + 4);
+}
+
+/**
+ * Get the type of a constraint.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_CONSTRAINT.
+ * @return The constraint type.
+ */
+ConstraintType ast_reader_constraint_type(const AstReader* reader, size_t node) {
+    return (ConstraintType)reader->nodes[fields_of(node)];
+}
+
+/**
+ * Get the index of a placeholder.
+ *
+ * @param reader The reader.
+ * @param node Offset of a NODE_PARAMETER.
+ * @return The parameter index.
+ */
+int ast_reader_parameter_index(const AstReader* reader, size_t node) {
+    return read_uint16(reader->nodes + fields_of(node));
+}
+
+/**
+ * Read the execution metadata.
+ *
+ * @param reader The reader.
+ * @param metadata Receives the metadata.
+ * @param target_index_length Receives the length of the target index.
+ */
+void ast_reader_metadata(const AstReader* reader, ExecutionMetadata* metadata,
+                         size_t* target_index_length) {
+    const unsigned char* p      = reader->metadata;
+    size_t               length = read_uint16(p + 12);
+    size_t index = reader->version == AST_VERSION_1 ? METADATA_V1_SIZE : AST_METADATA_SIZE;
+
+    metadata->hint_flags     = read_uint16(p);
+    metadata->priority       = p[2];
+    metadata->engine_type    = p[3];
+    metadata->estimated_rows = read_uint32(p + 4);
+    metadata->timeout_ms     = read_uint32(p + 8);
+    metadata->target_index   = length > 0 ? (const char*)p + index : NULL;
+    if (target_index_length)
+        *target_index_length = length;
+}
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param size The size in bytes.
+ * @return Pointer to the zero-initialized allocation.
+ */
+static void* checked_calloc(size_t size) {
+    void* result = calloc(1, size > 0 ? size : 1);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Copy a string out of the buffer.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the string, advanced past it.
+ * @param length Receives the length of the string (may be NULL).
+ * @return The null-terminated copy.
+ */
+static char* read_string(const AstReader* reader, size_t* pos, int* length) {
+    const char* str;
+    size_t      len;
+    *pos = string_view(reader, *pos, &str, &len);
+
+    char* copy = (char*)checked_calloc(len + 1);
+    memcpy(copy, str, len);
+    if (length)
+        *length = (int)len;
+    return copy;
+}
+
+/**
+ * Read the type and constraint count of a field definition.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the type, advanced past the count.
+ * @param count Receives the number of constraints.
+ * @return The null-terminated copy of the type, or NULL if it is empty.
+ */
+static char* read_field_type(const AstReader* reader, size_t* pos, int* count) {
+    const char* type;
+    size_t      length;
+    char*       copy = NULL;
+
+    if (string_view(reader, *pos, &type, &length) != AST_READER_NULL && length > 0) {
+        copy = read_string(reader, pos, NULL);
+    } else {
+        *pos = string_end(reader, *pos);  // No type
+    }
+
+    *count = read_uint16(reader->nodes + *pos);
+    *pos += 2;
+    return copy;
+}
+
+/**
+ * Start reading the child slots of a node.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the child table (version 2) or first child, advanced past the table.
+ * @param count Number of child slots.
+ * @return Offset of the child table (version 2).
+ */
+static size_t begin_slots(const AstReader* reader, size_t* pos, size_t count) {
+    size_t table = *pos;
+    if (reader->version != AST_VERSION_1)
+        *pos += count * sizeof(uint32_t);
+    return table;
+}
+
+/**
+ * Start a counted list of child nodes.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the count, advanced to the first child.
+ * @param count Receives the number of entries.
+ * @param table Receives the offset of the child table (version 2).
+ * @return The array for the children, filled in as they are built.
+ */
+static Node** begin_list(const AstReader* reader, size_t* pos, int* count, size_t* table) {
+    *count = read_uint16(reader->nodes + *pos);
+    *pos += 2;
+    *table = begin_slots(reader, pos, (size_t)*count);
+    return (Node**)checked_calloc((size_t)*count * sizeof(Node*));
+}
+
+/**
+ * Build the node at pos without its children.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the node, advanced to its first child.
+ * @param table Receives the offset of the child table (version 2).
+ * @param count Receives the number of child slots known so far.
+ * @return The node, with its child arrays allocated and empty.
+ */
+static Node* materialize_node(const AstReader* reader, size_t* pos, size_t* table,
+                              size_t* count) {
+    const unsigned char* data = reader->nodes;
+    bool                 v1   = reader->version == AST_VERSION_1;
+    int                  length;
+
+    Node* node = (Node*)checked_calloc(sizeof(Node));
+    node->type = (NodeType)data[*pos];
+    node->line = (int)read_uint32(data + *pos + 1);
+    *pos += NODE_HEADER_SIZE;
+    *count = 0;
+
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            *count = 6;
+            break;
+
+        case NODE_TELL_QUERY:
+            *count = 3;
+            break;
+
+        case NODE_FIND_QUERY:
+            *count = 5;
+            break;
+
+        case NODE_FIELD_LIST:
+            node->as.field_list.fields = begin_list(reader, pos, &length, table);
+            node->as.field_list.count  = length;
+            *count                     = (size_t)length;
+            return node;
+
+        case NODE_SOURCE: {
+            // The source name is stored as a plain string
+            Node* identifier                = (Node*)checked_calloc(sizeof(Node));
+            identifier->type                = NODE_IDENTIFIER;
+            identifier->line                = node->line;
+            identifier->as.identifier.name =
+                read_string(reader, pos, &identifier->as.identifier.length);
+            node->as.source.identifier = identifier;
+
+            *count = data[(*pos)++] != 0;  // Join flag
+            break;
+        }
+
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+            *count = 2;
+            break;
+
+        case NODE_REMOVE_ACTION:
+            *count = 1;
+            break;
+
+        case NODE_ORDER_BY: {
+            int entries = read_uint16(data + *pos);
+            *pos += 2;
+            node->as.order_by.count     = entries;
+            node->as.order_by.fields    = (Node**)checked_calloc((size_t)entries * sizeof(Node*));
+            node->as.order_by.ascending = (bool*)checked_calloc((size_t)entries * sizeof(bool));
+
+            // Version 1 follows each entry with its direction, version 2 lists them up front
+            if (!v1) {
+                for (int i = 0; i < entries; i++) {
+                    node->as.order_by.ascending[i] = data[(*pos)++] != 0;
+                }
+            }
+            *count = (size_t)entries;
+            break;
+        }
+
+        case NODE_LIMIT:
+            node->as.limit.limit  = read_int32(data + *pos);
+            node->as.limit.offset = read_int32(data + *pos + 4);
+            *pos += 8;
+            break;
+
+        case NODE_BINARY_EXPR:
+            node->as.binary_expr.op = (NsqlTokenType)data[(*pos)++];
+            *count                  = 2;
+            break;
+
+        case NODE_UNARY_EXPR:
+            node->as.unary_expr.op = (NsqlTokenType)data[(*pos)++];
+            *count                 = 1;
+            break;
+
+        case NODE_IDENTIFIER:
+            node->as.identifier.name = read_string(reader, pos, &node->as.identifier.length);
+            break;
+
+        case NODE_LITERAL:
+            node->as.literal.literal_type = (NsqlTokenType)data[(*pos)++];
+            if (node->as.literal.literal_type == TOKEN_STRING) {
+                node->as.literal.value.string_value =
+                    read_string(reader, pos, &node->as.literal.length);
+            } else {
+                node->as.literal.value.number_value = read_double(data + *pos);
+                *pos += sizeof(double);
+            }
+            break;
+
+        case NODE_UPDATE_ACTION: {
+            int entries = read_uint16(data + *pos);
+            *pos += 2;
+            node->as.update_action.count = entries;
+            node->as.update_action.fields =
+                (Node**)checked_calloc((size_t)entries * sizeof(Node*));
+            node->as.update_action.values =
+                (Node**)checked_calloc((size_t)entries * sizeof(Node*));
+            *count = 2 * (size_t)entries;
+            break;
+        }
+
+        case NODE_CREATE_ACTION:
+            node->as.create_action.field_defs = begin_list(reader, pos, &length, table);
+            node->as.create_action.count      = length;
+            *count                            = (size_t)length;
+            return node;
+
+        case NODE_FIELD_DEF:
+            // Version 1 writes the name before the type, see end_child()
+            *count = 1;
+            if (!v1) {
+                node->as.field_def.type = read_field_type(reader, pos, &length);
+                node->as.field_def.constraint_count = length;
+                node->as.field_def.constraints =
+                    (Node**)checked_calloc((size_t)length * sizeof(Node*));
+                *count += (size_t)length;
+            }
+            break;
+
+        case NODE_CONSTRAINT:
+            node->as.constraint.type = (ConstraintType)data[(*pos)++];
+            *count                   = 1;
+            break;
+
+        case NODE_FUNCTION_CALL:
+            node->as.function_call.name = read_string(reader, pos, NULL);
+            node->as.function_call.args = begin_list(reader, pos, &length, table);
+            node->as.function_call.arg_count = length;
+            *count                           = (size_t)length;
+            return node;
+
+        case NODE_ERROR:
+            node->as.error.message = read_string(reader, pos, NULL);
+            break;
+
+        case NODE_PROGRAM: {
+            int statements = (int)read_uint32(data + *pos);
+            *pos += 4;
+            node->as.program.count = statements;
+            node->as.program.statements =
+                (Node**)checked_calloc((size_t)statements * sizeof(Node*));
+            *count = (size_t)statements;
+            break;
+        }
+
+        case NODE_PARAMETER:
+            node->as.parameter.index = read_uint16(data + *pos);
+            *pos += 2;
+            break;
+
+        case NODE_LOGICAL_EXPR: {
+            uint32_t operands;
+            node->as.logical_expr.op = (NsqlTokenType)data[(*pos)++];
+            *pos = read_varint(data, reader->nodes_size, *pos, &operands);
+            node->as.logical_expr.count    = (int)operands;
+            node->as.logical_expr.operands = (Node**)checked_calloc(operands * sizeof(Node*));
+            *count                         = operands;
+            break;
+        }
+
+        case NODE_IN_LIST: {
+            uint32_t items;
+            *pos = read_varint(data, reader->nodes_size, *pos, &items);
+            node->as.in_list.count = (int)items;
+            node->as.in_list.items = (Node**)checked_calloc(items * sizeof(Node*));
+            *count                 = 1 + (size_t)items;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    *table = begin_slots(reader, pos, *count);
+    return node;
+}
+
+/**
+ * Get the location of a child slot of a node being built.
+ *
+ * @param node The node.
+ * @param slot The slot.
+ * @return Location of the child pointer.
+ */
+static Node** child_target(Node* node, size_t slot) {
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY: {
+            Node** slots[] = {&node->as.ask_query.source,   &node->as.ask_query.fields,
+                              &node->as.ask_query.condition, &node->as.ask_query.group_by,
+                              &node->as.ask_query.order_by,  &node->as.ask_query.limit};
+            return slots[slot];
+        }
+
+        case NODE_TELL_QUERY: {
+            Node** slots[] = {&node->as.tell_query.source, &node->as.tell_query.action,
+                              &node->as.tell_query.condition};
+            return slots[slot];
+        }
+
+        case NODE_FIND_QUERY: {
+            Node** slots[] = {&node->as.find_query.source, &node->as.find_query.condition,
+                              &node->as.find_query.group_by, &node->as.find_query.order_by,
+                              &node->as.find_query.limit};
+            return slots[slot];
+        }
+
+        case NODE_FIELD_LIST:
+            return &node->as.field_list.fields[slot];
+
+        case NODE_SOURCE:
+            return &node->as.source.join;
+
+        case NODE_JOIN:
+            return slot == 0 ? &node->as.join.source : &node->as.join.condition;
+
+        case NODE_GROUP_BY:
+            return slot == 0 ? &node->as.group_by.fields : &node->as.group_by.having;
+
+        case NODE_ORDER_BY:
+            return &node->as.order_by.fields[slot];
+
+        case NODE_ADD_ACTION:
+            return slot == 0 ? &node->as.add_action.value : &node->as.add_action.record_spec;
+
+        case NODE_REMOVE_ACTION:
+            return &node->as.remove_action.condition;
+
+        case NODE_UPDATE_ACTION:
+            // Fields and values alternate
+            return slot % 2 == 0 ? &node->as.update_action.fields[slot / 2]
+                                 : &node->as.update_action.values[slot / 2];
+
+        case NODE_CREATE_ACTION:
+            return &node->as.create_action.field_defs[slot];
+
+        case NODE_BINARY_EXPR:
+            return slot == 0 ? &node->as.binary_expr.left : &node->as.binary_expr.right;
+
+        case NODE_UNARY_EXPR:
+            return &node->as.unary_expr.operand;
+
+        case NODE_FIELD_DEF:
+            return slot == 0 ? &node->as.field_def.name : &node->as.field_def.constraints[slot - 1];
+
+        case NODE_CONSTRAINT:
+            return &node->as.constraint.default_value;
+
+        case NODE_FUNCTION_CALL:
+            return &node->as.function_call.args[slot];
+
+        case NODE_PROGRAM:
+            return &node->as.program.statements[slot];
+
+        case NODE_LOGICAL_EXPR:
+            return &node->as.logical_expr.operands[slot];
+
+        case NODE_IN_LIST:
+            return slot == 0 ? &node->as.in_list.value : &node->as.in_list.items[slot - 1];
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Read the fields that follow a child of a version 1 node.
+ *
+ * @param reader The reader.
+ * @param pos Offset after the child, advanced past the fields.
+ * @param open The node.
+ */
+static void end_child(const AstReader* reader, size_t* pos, OpenNode* open) {
+    Node* node = open->built;
+    int   count;
+
+    if (reader->version != AST_VERSION_1)
+        return;
+
+    if (node->type == NODE_ORDER_BY) {
+        node->as.order_by.ascending[open->next - 1] = reader->nodes[(*pos)++] != 0;
+    } else if (node->type == NODE_FIELD_DEF && open->next == 1) {
+        // The name is followed by the type and the constraints
+        node->as.field_def.type             = read_field_type(reader, pos, &count);
+        node->as.field_def.constraint_count = count;
+        node->as.field_def.constraints = (Node**)checked_calloc((size_t)count * sizeof(Node*));
+        open->count += (size_t)count;
+    }
+}
+
+/**
+ * Move to the next present child slot of the innermost open node, closing every node whose
+ * slots are all read.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the next child slot, advanced past absent children.
+ * @param open The open nodes.
+ * @return true if a child is at pos, false if the walk is done.
+ */
+static bool next_child_slot(const AstReader* reader, size_t* pos, OpenStack* open) {
+    while (open->count > 0) {
+        OpenNode* parent = &open->items[open->count - 1];
+        if (parent->next == parent->count) {
+            open->count--;
+            if (open->count > 0)
+                end_child(reader, pos, &open->items[open->count - 1]);
+            continue;
+        }
+
+        // Children follow the table in slot order, so only absent ones need the table
+        size_t slot = parent->next++;
+        bool   present;
+        if (reader->version == AST_VERSION_1) {
+            present = reader->nodes[*pos] != NULL_NODE;
+            if (!present)
+                (*pos)++;
+        } else {
+            present = read_uint32(reader->nodes + parent->table + slot * sizeof(uint32_t)) != 0;
+        }
+        if (present)
+            return true;
+        end_child(reader, pos, parent);
+    }
+    return false;
+}
+
+/**
+ * Build the node at pos and advance pos past it.
+ *
+ * Every node is built before its children, and the path to the node being built is kept on the
+ * heap, so the nesting of the subtree is limited only by its size.
+ *
+ * @param reader The reader.
+ * @param pos Offset of the node, advanced past the subtree.
+ * @return The node.
+ */
+static Node* materialize_at(const AstReader* reader, size_t* pos) {
+    OpenNode  inline_items[INLINE_NODES];
+    OpenStack open = {inline_items, 0, INLINE_NODES, inline_items};
+    Node*     root = NULL;
+
+    do {
+        size_t start = *pos;
+        size_t table;
+        size_t count;
+        Node*  node = materialize_node(reader, pos, &table, &count);
+
+        if (open.count == 0) {
+            root = node;
+        } else {
+            OpenNode* parent = &open.items[open.count - 1];
+            *child_target(parent->built, parent->next - 1) = node;
+        }
+
+        if (count > 0) {
+            open_node(&open, start, table, count);
+            open.items[open.count - 1].built = node;
+        } else if (open.count > 0) {
+            end_child(reader, pos, &open.items[open.count - 1]);
+        }
+    } while (next_child_slot(reader, pos, &open));
+
+    free_open_nodes(&open);
+    return root;
+}
+
+/**
+ * Build a Node tree from a serialized subtree.
+ *
+ * @param reader The reader.
+ * @param node Offset of the subtree root.
+ * @return The tree, or NULL if node is AST_READER_NULL.
+ */
+Node* ast_reader_materialize(const AstReader* reader, size_t node) {
+    if (node == AST_READER_NULL)
+        return NULL;
+    return materialize_at(reader, &node);
+}
@@ -1,942 +1,2044 @@
-#include <nsql/ast_serializer.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Format Constants
-#define AST_HEADER_SIZE 28
-
-// Serialized AST structure
-struct SerializedAST {
-    void*    data;      // Raw binary data
-    size_t   size;      // Total size in bytes
-    uint32_t checksum;  // CRC32 checksum
-    bool     is_valid;  // Validation state
-};
-
-// Serialization buffer
-typedef struct {
-    char*  buffer;
-    size_t capacity;
-    size_t size;
-} SerializeBuffer;
-
-/**
- * Initialize serialization buffer.
- *
- * @param initial_capacity The initial capacity of the buffer.
- * @return Pointer to the initialized buffer, or NULL on failure.
- * @note The buffer must be freed using free_buffer() after use.
- */
-static SerializeBuffer* init_buffer(size_t initial_capacity) {
-    SerializeBuffer* buf = (SerializeBuffer*)malloc(sizeof(SerializeBuffer));
-    if (!buf)
-        return NULL;
-
-    buf->buffer = (char*)malloc(initial_capacity);
-    if (!buf->buffer) {
-        free(buf);
-        return NULL;
-    }
-
-    buf->capacity = initial_capacity;
-    buf->size     = 0;
-    return buf;
-}
-
-/**
- * Free serialization buffer.
- *
- * @param buf The buffer to free.
- * @note This function frees the buffer and its internal data.
- */
-static void free_buffer(SerializeBuffer* buf) {
-    if (buf) {
-        free(buf->buffer);
-        free(buf);
-    }
-}
-
-/**
- * Ensure buffer has enough space for additional data.
- *
- * @param buf The buffer to check.
- * @param additional The additional size needed.
- * @return true if successful, false on failure.
- */
-static bool ensure_capacity(SerializeBuffer* buf, size_t additional) {
-    if (buf->size + additional > buf->capacity) {
-        size_t new_capacity = buf->capacity * 2;
-        if (new_capacity < buf->size + additional)
-            new_capacity = buf->size + additional + 1024;  // Extra padding
-
-        char* new_buffer = (char*)realloc(buf->buffer, new_capacity);
-        if (!new_buffer)
-            return false;
-
-        buf->buffer   = new_buffer;
-        buf->capacity = new_capacity;
-    }
-    return true;
-}
-
-/**
- * Write bytes to buffer.
- *
- * @param buf The buffer to write to.
- * @param data The data to write.
- * @param size The size of the data in bytes.
- * @return true if successful, false on failure.
- */
-static bool write_bytes(SerializeBuffer* buf, const void* data, size_t size) {
-    if (!ensure_capacity(buf, size))
-        return false;
-    memcpy(buf->buffer + buf->size, data, size);
-    buf->size += size;
-    return true;
-}
-
-/**
- * Write an 8-bit unsigned integer to the buffer.
- *
- * @param buf The buffer to write to.
- * @param value The value to write.
- * @return true if successful, false on failure.
- */
-static bool write_uint8(SerializeBuffer* buf, uint8_t value) {
-    return write_bytes(buf, &value, sizeof(uint8_t));
-}
-
-/**
- * Write a 16-bit unsigned integer to the buffer.
- *
- * @param buf The buffer to write to.
- * @param value The value to write.
- * @return true if successful, false on failure.
- */
-static bool write_uint16(SerializeBuffer* buf, uint16_t value) {
-    return write_bytes(buf, &value, sizeof(uint16_t));
-}
-
-/**
- * Write a 32-bit unsigned integer to the buffer.
- *
- * @param buf The buffer to write to.
- * @param value The value to write.
- * @return true if successful, false on failure.
- */
-static bool write_uint32(SerializeBuffer* buf, uint32_t value) {
-    return write_bytes(buf, &value, sizeof(uint32_t));
-}
-
-/**
- * Write a 32-bit signed integer to the buffer.
- *
- * @param buf The buffer to write to.
- * @param value The value to write.
- * @return true if successful, false on failure.
- */
-static bool write_int32(SerializeBuffer* buf, int32_t value) {
-    return write_bytes(buf, &value, sizeof(int32_t));
-}
-
-/**
- * Write a double to the buffer.
- *
- * @param buf The buffer to write to.
- * @param value The value to write.
- * @return true if successful, false on failure.
- */
-static bool write_double(SerializeBuffer* buf, double value) {
-    return write_bytes(buf, &value, sizeof(double));
-}
-
-/**
- * Writes a string to the buffer, prefixed by its length as a 16-bit unsigned integer.
- *
- * If
- * the string is NULL, writes a zero-length marker. Strings longer than 65535 bytes are truncated.
-
- * *
+#include <nsql/ast_reader.h>
+#include <nsql/ast_serializer.h>
+#include <nsql/ast_visitor.h>
+#include <nsql/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checksum.h"
+#include "compress.h"
+#include "stats.h"
+
+// Format Constants
+#define AST_HEADER_SIZE 28
+
+// Checksum algorithm written by ast_serialize()
+#ifndef AST_CHECKSUM_DEFAULT
+#define AST_CHECKSUM_DEFAULT AST_CHECKSUM_CRC32C
+#endif
+
+// Version 3 layout: the header, then the metadata block (AST_METADATA_SIZE bytes followed by the
+// target index), then the root node, then the string table and its size as a uint32_t. A node is
+// its type and line, its scalar fields and, if it can have children, one uint32_t offset per
+// child slot relative to the node's start (0 for an absent child). The children follow the table
+// in slot order.
+//
+// The string table entries are each a varint length and the bytes. Every string a node holds is a
+// varint reference: the offset of its entry in the table plus one, or 0 for a string stored inline
+// as a varint length and the bytes. Version 2 is the same without the string table, with every
+// string stored inline behind a uint16_t length, and with nothing after the root node.
+
+// FNV-1a parameters, for hashing string table entries
+#define FNV_OFFSET_BASIS 0x811c9dc5U
+#define FNV_PRIME 0x01000193U
+
+// Longest varint, enough for any uint32_t
+#define VARINT_MAX_SIZE 5
+
+// Keys looked up by a condition from which ast_create_metadata() hints parallel execution
+#define PARALLEL_LOOKUP_KEYS 64
+
+// Size of a serialized NODE_PARAMETER: type, line and index
+#define PARAMETER_NODE_SIZE 7
+
+// Kinds of parameter slot
+#define SLOT_NODE 0   // A NODE_PARAMETER, replaced by a NODE_LITERAL when bound
+#define SLOT_COUNT 1  // A LIMIT or OFFSET count, patched in place when bound
+
+// Location of a ? placeholder in serialized data
+typedef struct {
+    size_t   offset;  // Offset of the node or count from the start of the data
+    uint32_t index;   // Parameter index
+    uint8_t  kind;    // SLOT_NODE or SLOT_COUNT
+} ParameterSlot;
+
+// Location of a child offset in serialized data
+typedef struct {
+    size_t field;  // Offset of the child table entry
+    size_t node;   // Offset of the node the entry is relative to
+} ChildLink;
+
+// Serialized AST structure
+struct SerializedAST {
+    void*          data;             // Raw binary data
+    size_t         size;             // Total size in bytes
+    uint32_t       checksum;         // CRC32 checksum
+    bool           is_valid;         // Validation state
+    ParameterSlot* slots;            // Placeholders in data, in offset order
+    size_t         slot_count;       // Number of entries in slots
+    size_t         parameter_count;  // Highest parameter index plus one
+    ChildLink*     links;            // Child offsets in data (only kept if there are slots)
+    size_t         link_count;       // Number of entries in links
+};
+
+// Deduplicated string table, see the layout above
+typedef struct StringTable StringTable;
+
+// Serialization buffer
+typedef struct {
+    char*          buffer;
+    size_t         capacity;
+    size_t         size;
+    bool           fixed;          // Whether buffer is caller memory that cannot grow
+    StringTable*   strings;        // Table that strings are interned into
+    ParameterSlot* slots;          // Placeholders written so far
+    size_t         slot_count;     // Number of entries in slots
+    size_t         slot_capacity;  // Allocated entries in slots
+    ChildLink*     links;          // Child offsets written so far
+    size_t         link_count;     // Number of entries in links
+    size_t         link_capacity;  // Allocated entries in links
+} SerializeBuffer;
+
+struct StringTable {
+    SerializeBuffer* entries;       // Table entries written so far
+    uint32_t*        buckets;       // Entry offsets plus one, open addressed (0 for a free bucket)
+    size_t           bucket_count;  // Number of buckets, a power of two
+    size_t           entry_count;   // Number of entries
+};
+
+/**
+ * Initialize serialization buffer.
+ *
+ * @param initial_capacity The initial capacity of the buffer.
+ * @return Pointer to the initialized buffer, or NULL on failure.
+ * @note The buffer must be freed using free_buffer() after use.
+ */
+static SerializeBuffer* init_buffer(size_t initial_capacity) {
+    SerializeBuffer* buf = (SerializeBuffer*)malloc(sizeof(SerializeBuffer));
+    if (!buf)
+        return NULL;
+
+    buf->buffer = (char*)malloc(initial_capacity);
+    if (!buf->buffer) {
+        free(buf);
+        return NULL;
+    }
+
+    buf->capacity      = initial_capacity;
+    buf->size          = 0;
+    buf->fixed         = false;
+    buf->strings       = NULL;
+    buf->slots         = NULL;
+    buf->slot_count    = 0;
+    buf->slot_capacity = 0;
+    buf->links         = NULL;
+    buf->link_count    = 0;
+    buf->link_capacity = 0;
+    return buf;
+}
+
+/**
+ * Free serialization buffer.
+ *
+ * @param buf The buffer to free.
+ * @note This function frees the buffer and its internal data.
+ */
+static void free_buffer(SerializeBuffer* buf) {
+    if (buf) {
+        free(buf->buffer);
+        free(buf->slots);
+        free(buf->links);
+        free(buf);
+    }
+}
+
+/**
+ * Ensure buffer has enough space for additional data.
+ *
+ * @param buf The buffer to check.
+ * @param additional The additional size needed.
+ * @return true if successful, false on failure.
+ */
+static bool ensure_capacity(SerializeBuffer* buf, size_t additional) {
+    if (buf->size + additional > buf->capacity) {
+        if (buf->fixed)
+            return false;
+
+        size_t new_capacity = buf->capacity * 2;
+        if (new_capacity < buf->size + additional)
+            new_capacity = buf->size + additional + 1024;  // Extra padding
+
+        char* new_buffer = (char*)realloc(buf->buffer, new_capacity);
+        if (!new_buffer)
+            return false;
+
+        buf->buffer   = new_buffer;
+        buf->capacity = new_capacity;
+    }
+    return true;
+}
+
+/**
+ * Write bytes to buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param data The data to write.
+ * @param size The size of the data in bytes.
+ * @return true if successful, false on failure.
+ */
+static bool write_bytes(SerializeBuffer* buf, const void* data, size_t size) {
+    if (!ensure_capacity(buf, size))
+        return false;
+    memcpy(buf->buffer + buf->size, data, size);
+    buf->size += size;
+    return true;
+}
+
+/**
+ * Write an 8-bit unsigned integer to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_uint8(SerializeBuffer* buf, uint8_t value) {
+    return write_bytes(buf, &value, sizeof(uint8_t));
+}
+
+/**
+ * Write a 16-bit unsigned integer to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_uint16(SerializeBuffer* buf, uint16_t value) {
+    return write_bytes(buf, &value, sizeof(uint16_t));
+}
+
+/**
+ * Write a 32-bit unsigned integer to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_uint32(SerializeBuffer* buf, uint32_t value) {
+    return write_bytes(buf, &value, sizeof(uint32_t));
+}
+
+/**
+ * Write a 32-bit signed integer to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_int32(SerializeBuffer* buf, int32_t value) {
+    return write_bytes(buf, &value, sizeof(int32_t));
+}
+
+/**
+ * Write a double to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_double(SerializeBuffer* buf, double value) {
+    return write_bytes(buf, &value, sizeof(double));
+}
+
+/**
+ * Get the number of bytes a value takes as a varint.
+ *
+ * @param value The value.
+ * @return The size in bytes.
+ */
+static size_t varint_size(uint32_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+/**
+ * Encode a varint: 7 bits per byte, least significant first, with the high bit set on every
+ * byte but the last.
+ *
+ * @param out Receives the encoding (at least VARINT_MAX_SIZE bytes).
+ * @param value The value.
+ * @return The size of the encoding in bytes.
+ */
+static size_t encode_varint(unsigned char* out, uint32_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        out[size++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = (unsigned char)value;
+    return size;
+}
+
+/**
+ * Write a varint to the buffer.
+ *
+ * @param buf The buffer to write to.
+ * @param value The value to write.
+ * @return true if successful, false on failure.
+ */
+static bool write_varint(SerializeBuffer* buf, uint32_t value) {
+    unsigned char bytes[VARINT_MAX_SIZE];
+    return write_bytes(buf, bytes, encode_varint(bytes, value));
+}
+
+/**
+ * Read a 16-bit unsigned integer.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static uint16_t read_uint16(const void* p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Read a 32-bit unsigned integer.
+ *
+ * @param p The data, in any alignment.
+ * @return The value.
+ */
+static uint32_t read_uint32(const void* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+/**
+ * Decode a varint written by encode_varint() from trusted data.
+ *
+ * @param p The encoding.
+ * @param value Receives the value.
+ * @return The size of the encoding in bytes.
+ */
+static size_t decode_varint(const unsigned char* p, uint32_t* value) {
+    size_t size = 0;
+    *value      = 0;
+    do {
+        *value |= (uint32_t)(p[size] & 0x7F) << (7 * size);
+    } while (p[size++] & 0x80);
+    return size;
+}
+
+/**
+ * Hash a string with 32-bit FNV-1a.
+ *
+ * @param str The string.
+ * @param len The length of the string in bytes.
+ * @return The hash.
+ */
+static uint32_t hash_string(const char* str, size_t len) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Initialize an empty string table.
+ *
+ * @return The table, or NULL on failure.
+ */
+static StringTable* init_string_table(void) {
+    StringTable* table = (StringTable*)malloc(sizeof(StringTable));
+    if (!table)
+        return NULL;
+
+    table->entries      = init_buffer(1024);
+    table->bucket_count = 64;
+    table->buckets      = (uint32_t*)calloc(table->bucket_count, sizeof(uint32_t));
+    table->entry_count  = 0;
+    if (!table->entries || !table->buckets) {
+        free_buffer(table->entries);
+        free(table->buckets);
+        free(table);
+        return NULL;
+    }
+    return table;
+}
+
+/**
+ * Empty a string table so it can be reused for another AST.
+ *
+ * @param table The table.
+ */
+static void reset_string_table(StringTable* table) {
+    memset(table->buckets, 0, table->bucket_count * sizeof(uint32_t));
+    table->entries->size = 0;
+    table->entry_count   = 0;
+}
+
+/**
+ * Free a string table.
+ *
+ * @param table The table to free (may be NULL).
+ */
+static void free_string_table(StringTable* table) {
+    if (table) {
+        free_buffer(table->entries);
+        free(table->buckets);
+        free(table);
+    }
+}
+
+/**
+ * Find the bucket of a string in a string table.
+ *
+ * @param table The table.
+ * @param str The string.
+ * @param len The length of the string in bytes.
+ * @param hash The hash of the string.
+ * @return The bucket holding the string, or the free bucket it would go in.
+ */
+static size_t find_bucket(const StringTable* table, const char* str, size_t len, uint32_t hash) {
+    size_t mask = table->bucket_count - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        if (table->buckets[i] == 0)
+            return i;
+
+        const unsigned char* entry = (const unsigned char*)table->entries->buffer +
+                                     table->buckets[i] - 1;
+        uint32_t             length;
+        size_t               prefix = decode_varint(entry, &length);
+        if (length == len && memcmp(entry + prefix, str, len) == 0)
+            return i;
+    }
+}
+
+/**
+ * Double the buckets of a string table and rehash its entries.
+ *
+ * @param table The table.
+ * @return true if successful, false on failure.
+ */
+static bool grow_string_table(StringTable* table) {
+    StringTable grown = *table;
+    grown.bucket_count *= 2;
+    grown.buckets = (uint32_t*)calloc(grown.bucket_count, sizeof(uint32_t));
+    if (!grown.buckets)
+        return false;
+
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        if (table->buckets[i] == 0)
+            continue;
+
+        const char* entry = table->entries->buffer + table->buckets[i] - 1;
+        uint32_t    length;
+        size_t      prefix = decode_varint((const unsigned char*)entry, &length);
+        size_t      bucket = find_bucket(&grown, entry + prefix, length,
+                                         hash_string(entry + prefix, length));
+        grown.buckets[bucket] = table->buckets[i];
+    }
+
+    free(table->buckets);
+    *table = grown;
+    return true;
+}
+
+/**
+ * Add a string to a string table unless it is already there.
+ *
+ * @param table The table.
+ * @param str The string (may be NULL when len is 0).
+ * @param len The length of the string in bytes.
+ * @param offset Receives the offset of the string's entry.
+ * @return true if successful, false on failure or if the table would exceed 4 GiB.
+ */
+static bool intern_string(StringTable* table, const char* str, size_t len, uint32_t* offset) {
+    uint32_t hash   = hash_string(str, len);
+    size_t   bucket = find_bucket(table, str, len, hash);
+    if (table->buckets[bucket] != 0) {
+        *offset = table->buckets[bucket] - 1;
+        return true;
+    }
+
+    SerializeBuffer* entries = table->entries;
+    if (len > UINT32_MAX - VARINT_MAX_SIZE || entries->size + VARINT_MAX_SIZE + len > UINT32_MAX)
+        return false;
+
+    *offset = (uint32_t)entries->size;
+    if (!write_varint(entries, (uint32_t)len) || (len > 0 && !write_bytes(entries, str, len)))
+        return false;
+
+    table->buckets[bucket] = *offset + 1;
+    table->entry_count++;
+    return table->entry_count * 2 <= table->bucket_count || grow_string_table(table);
+}
+
+/**
+ * Writes a reference to a string, adding the string to the buffer's string table.
+ *
+ * A NULL string is written as the empty string.
+ *
+ * @return true if the string is written successfully, false on failure.
+ */
+static bool write_string_n(SerializeBuffer* buf, const char* str, size_t len) {
+    uint32_t offset;
+    if (!str) {
+        str = "";
+        len = 0;
+    }
+    if (!intern_string(buf->strings, str, len, &offset))
+        return false;
+    return write_varint(buf, offset + 1);
+}
+
+/**
+ * Writes a null-terminated string to the buffer, see write_string_n().
+ *
  * @return true if the string is written successfully, false on failure.
- */
-static bool write_string(SerializeBuffer* buf, const char* str) {
-    if (!str) {
-        // Write a null string marker
-        return write_uint16(buf, 0);
-    }
-
-    size_t len = strlen(str);
-    // Check for truncation
-    if (len > UINT16_MAX) {
-        fprintf(stderr, "Warning: String too long, truncating to %u bytes\n", UINT16_MAX);
-        len = UINT16_MAX;
-    }
-    if (!write_uint16(buf, (uint16_t)len))
-        return false;
-    if (len > 0) {
-        return write_bytes(buf, str, len);
-    }
-    return true;
-}
-
-// CRC32 table
-static uint32_t crc32_table[256];
-static bool     crc32_table_computed = false;
-
-/**
- * Initialize CRC32 table.
- *
- * @note This function is called automatically when needed.
- */
-static void make_crc32_table(void) {
-    uint32_t c;
-    int      n, k;
-
-    for (n = 0; n < 256; n++) {
-        c = (uint32_t)n;
-        for (k = 0; k < 8; k++) {
-            if (c & 1)
-                c = 0xEDB88320U ^ (c >> 1);
-            else
-                c = c >> 1;
-        }
-        crc32_table[n] = c;
-    }
-    crc32_table_computed = true;
-}
-
-/**
- * Calculate CRC32 checksum for the given data.
- *
- * @param data The data to calculate the checksum for.
- * @param length The length of the data in bytes.
- * @return The calculated checksum.
- */
-static uint32_t calculate_crc32(const void* data, size_t length) {
-    if (!crc32_table_computed)
-        make_crc32_table();
-
-    const unsigned char* buf = (const unsigned char*)data;
-    uint32_t             c   = 0xFFFFFFFFU;
-
-    for (size_t n = 0; n < length; n++) {
-        c = crc32_table[(c ^ buf[n]) & 0xFF] ^ (c >> 8);
-    }
-    return c ^ 0xFFFFFFFFU;
-}
-
-// Forward declaration for serialization (recursive)
-static bool serialize_node(SerializeBuffer* buf, const Node* node);
-
-/**
- * Serialize a field list node.
- *
- * @param buf The buffer to write to.
- * @param node The field list node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_field_list(SerializeBuffer* buf, const Node* node) {
-    if (!write_uint16(buf, node->as.field_list.count))
-        return false;
-
-    for (int i = 0; i < node->as.field_list.count; i++) {
-        if (!serialize_node(buf, node->as.field_list.fields[i]))
-            return false;
-    }
-
-    return true;
-}
-
-/**
- * Serialize a source node.
- *
- * @param buf The buffer to write to.
- * @param node The source node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_source(SerializeBuffer* buf, const Node* node) {
-    if (!write_string(buf, node->as.source.identifier->as.identifier.name))
-        return false;
-
-    // Serialize join or NULL
-    if (node->as.source.join) {
-        if (!write_uint8(buf, 1))  // Has join
-            return false;
-        if (!serialize_node(buf, node->as.source.join))
-            return false;
-    } else {
-        if (!write_uint8(buf, 0))  // No join
-            return false;
-    }
-
-    return true;
-}
-
-/**
- * Serialize a binary expression node.
- *
- * @param buf The buffer to write to.
- * @param node The binary expression node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_binary_expr(SerializeBuffer* buf, const Node* node) {
-    if (!write_uint8(buf, node->as.binary_expr.op))
-        return false;
-    if (!serialize_node(buf, node->as.binary_expr.left))
-        return false;
-    if (!serialize_node(buf, node->as.binary_expr.right))
-        return false;
-    return true;
-}
-
-/**
- * Serialize an identifier node.
- *
- * @param buf The buffer to write to.
- * @param node The identifier node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_identifier(SerializeBuffer* buf, const Node* node) {
-    return write_string(buf, node->as.identifier.name);
-}
-
-/**
- * Serialize a literal node.
- *
- * @param buf The buffer to write to.
- * @param node The literal node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_literal(SerializeBuffer* buf, const Node* node) {
-    if (!write_uint8(buf, node->as.literal.literal_type))
-        return false;
-
-    switch (node->as.literal.literal_type) {
-        case TOKEN_STRING:
-            return write_string(buf, node->as.literal.value.string_value);
-        case TOKEN_INTEGER:
-        case TOKEN_DECIMAL:
-            return write_double(buf, node->as.literal.value.number_value);
-        default:
-            return false;
-    }
-}
-
-/**
- * Main node serialization logic.
- *
- * @param buf The buffer to write to.
- * @param node The function call node to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_node(SerializeBuffer* buf, const Node* node) {
-    if (!node) {
-        // Write a null node marker
-        return write_uint8(buf, 0xFF);
-    }
-
-    // Write node type
-    if (!write_uint8(buf, node->type))
-        return false;
-
-    // Write line number for debugging
-    if (!write_uint32(buf, node->line))
-        return false;
-
-    // Serialize node-specific data
-    switch (node->type) {
-        case NODE_ASK_QUERY:
-            if (!serialize_node(buf, node->as.ask_query.source))
-                return false;
-            if (!serialize_node(buf, node->as.ask_query.fields))
-                return false;
-            if (!serialize_node(buf, node->as.ask_query.condition))
-                return false;
-            if (!serialize_node(buf, node->as.ask_query.group_by))
-                return false;
-            if (!serialize_node(buf, node->as.ask_query.order_by))
-                return false;
-            if (!serialize_node(buf, node->as.ask_query.limit))
-                return false;
-            break;
-
-        case NODE_TELL_QUERY:
-            if (!serialize_node(buf, node->as.tell_query.source))
-                return false;
-            if (!serialize_node(buf, node->as.tell_query.action))
-                return false;
-            if (!serialize_node(buf, node->as.tell_query.condition))
-                return false;
-            break;
-
-        case NODE_FIND_QUERY:
-            if (!serialize_node(buf, node->as.find_query.source))
-                return false;
-            if (!serialize_node(buf, node->as.find_query.condition))
-                return false;
-            if (!serialize_node(buf, node->as.find_query.group_by))
-                return false;
-            if (!serialize_node(buf, node->as.find_query.order_by))
-                return false;
-            if (!serialize_node(buf, node->as.find_query.limit))
-                return false;
-            break;
-
-        case NODE_SHOW_QUERY:
-        case NODE_GET_QUERY:
-            if (!serialize_node(buf, node->as.show_query.source))
-                return false;
-            if (!serialize_node(buf, node->as.show_query.fields))
-                return false;
-            if (!serialize_node(buf, node->as.show_query.condition))
-                return false;
-            if (!serialize_node(buf, node->as.show_query.group_by))
-                return false;
-            if (!serialize_node(buf, node->as.show_query.order_by))
-                return false;
-            if (!serialize_node(buf, node->as.show_query.limit))
-                return false;
-            break;
-
-        case NODE_FIELD_LIST:
-            if (!serialize_field_list(buf, node))
-                return false;
-            break;
-
-        case NODE_SOURCE:
-            if (!serialize_source(buf, node))
-                return false;
-            break;
-
-        case NODE_JOIN:
-            if (!serialize_node(buf, node->as.join.source))
-                return false;
-            if (!serialize_node(buf, node->as.join.condition))
-                return false;
-            break;
-
-        case NODE_GROUP_BY:
-            if (!serialize_node(buf, node->as.group_by.fields))
-                return false;
-            if (!serialize_node(buf, node->as.group_by.having))
-                return false;
-            break;
-
-        case NODE_ORDER_BY:
-            if (!write_uint16(buf, node->as.order_by.count))
-                return false;
-
-            for (int i = 0; i < node->as.order_by.count; i++) {
-                if (!serialize_node(buf, node->as.order_by.fields[i]))
-                    return false;
-                if (!write_uint8(buf, node->as.order_by.ascending[i]))
-                    return false;
-            }
-            break;
-
-        case NODE_LIMIT:
-            if (!write_int32(buf, node->as.limit.limit))
-                return false;
-            if (!write_int32(buf, node->as.limit.offset))
-                return false;
-            break;
-
-        case NODE_BINARY_EXPR:
-            if (!serialize_binary_expr(buf, node))
-                return false;
-            break;
-
-        case NODE_UNARY_EXPR:
-            if (!write_uint8(buf, node->as.unary_expr.op))
-                return false;
-            if (!serialize_node(buf, node->as.unary_expr.operand))
-                return false;
-            break;
-
-        case NODE_IDENTIFIER:
-            if (!serialize_identifier(buf, node))
-                return false;
-            break;
-
-        case NODE_LITERAL:
-            if (!serialize_literal(buf, node))
-                return false;
-            break;
-
-        case NODE_ADD_ACTION:
-            if (!serialize_node(buf, node->as.add_action.value))
-                return false;
-            if (!serialize_node(buf, node->as.add_action.record_spec))
-                return false;
-            break;
-
-        case NODE_REMOVE_ACTION:
-            if (!serialize_node(buf, node->as.remove_action.condition))
-                return false;
-            break;
-
-        case NODE_UPDATE_ACTION:
-            if (!write_uint16(buf, node->as.update_action.count))
-                return false;
-            for (int i = 0; i < node->as.update_action.count; i++) {
-                if (!serialize_node(buf, node->as.update_action.fields[i]))
-                    return false;
-                if (!serialize_node(buf, node->as.update_action.values[i]))
-                    return false;
-            }
-            break;
-
-        case NODE_CREATE_ACTION:
-            if (!write_uint16(buf, node->as.create_action.count))
-                return false;
-            for (int i = 0; i < node->as.create_action.count; i++) {
-                if (!serialize_node(buf, node->as.create_action.field_defs[i]))
-                    return false;
-            }
-            break;
-
-        case NODE_FIELD_DEF:
-            if (!serialize_node(buf, node->as.field_def.name))
-                return false;
-            if (!write_string(buf, node->as.field_def.type))
-                return false;
-            if (!write_uint16(buf, node->as.field_def.constraint_count))
-                return false;
-            for (int i = 0; i < node->as.field_def.constraint_count; i++) {
-                if (!serialize_node(buf, node->as.field_def.constraints[i]))
-                    return false;
-            }
-            break;
-
-        case NODE_CONSTRAINT:
-            if (!write_uint8(buf, node->as.constraint.type))
-                return false;
-            if (!serialize_node(buf, node->as.constraint.default_value))
-                return false;
-            break;
-
-        case NODE_FUNCTION_CALL:
-            if (!write_string(buf, node->as.function_call.name))
-                return false;
-            if (!write_uint16(buf, node->as.function_call.arg_count))
-                return false;
-            for (int i = 0; i < node->as.function_call.arg_count; i++) {
-                if (!serialize_node(buf, node->as.function_call.args[i]))
-                    return false;
-            }
-            break;
-
-        case NODE_ERROR:
-            if (!write_string(buf, node->as.error.message))
-                return false;
-            break;
-
-        default:
-            return false;  // Unsupported node type
-    }
-
-    return true;
-}
-
-/**
- * Serialize execution metadata.
- *
- * @param buf The buffer to write to.
- * @param metadata The metadata to serialize.
- * @return true if successful, false on failure.
- */
-static bool serialize_metadata(SerializeBuffer* buf, const ExecutionMetadata* metadata) {
-    if (!metadata) {
-        // No metadata, write zeros
-        if (!write_uint16(buf, 0))
-            return false;  // hints
-        if (!write_uint8(buf, 128))
-            return false;  // priority (default 128)
-        if (!write_uint8(buf, ENGINE_AUTO))
-            return false;  // engine
-        if (!write_uint32(buf, 0))
-            return false;  // rows
-        if (!write_uint32(buf, 30000))
-            return false;  // timeout (30s default)
-        if (!write_string(buf, NULL))
-            return false;  // index
-        return true;
-    }
-
-    if (!write_uint16(buf, metadata->hint_flags))
-        return false;
-    if (!write_uint8(buf, metadata->priority))
-        return false;
-    if (!write_uint8(buf, metadata->engine_type))
-        return false;
-    if (!write_uint32(buf, metadata->estimated_rows))
-        return false;
-    if (!write_uint32(buf, metadata->timeout_ms))
-        return false;
-    if (!write_string(buf, metadata->target_index))
-        return false;
-
-    return true;
-}
-
-ExecutionMetadata ast_create_metadata(const Node* node) {
-    // TODO: Revisit this logic
-    ExecutionMetadata metadata;
-    metadata.hint_flags     = 0;
-    metadata.priority       = 128;
-    metadata.engine_type    = ENGINE_AUTO;
-    metadata.estimated_rows = 0;
-    metadata.timeout_ms     = 30000;
-    metadata.target_index   = NULL;
-
-    if (!node)
-        return metadata;
-
-    if (ast_is_nosql_query(node)) {
-        // NoSQL: favor concurrency, parallelism, and lightness
-        metadata.engine_type = ENGINE_NOSQL;
-        metadata.hint_flags |= HINT_PARALLEL_EXEC | HINT_READ_ONLY;
-        metadata.priority   = 128;    // Balanced
-        metadata.timeout_ms = 10000;  // Faster timeout for NoSQL
-        // FIND queries: expect many rows, so set estimated_rows high
-        if (node->type == NODE_FIND_QUERY) {
-            metadata.estimated_rows = 10000;
-            metadata.hint_flags |= HINT_FULL_SCAN;
-        }
-        // SHOW/GET: reporting, so cache results
-        if (node->type == NODE_SHOW_QUERY || node->type == NODE_GET_QUERY) {
-            metadata.estimated_rows = 1000;
-            metadata.hint_flags |= HINT_CACHE_RESULT;
-            metadata.priority = 96;
-        }
-    } else {
-        // SQL: favor consistency, indexing, and correctness
-        metadata.engine_type = ENGINE_SQL;
-        switch (node->type) {
-            case NODE_ASK_QUERY:
-                metadata.hint_flags |= HINT_READ_ONLY;
-                metadata.priority = 128;
-                // If condition exists, prefer index scan
-                if (node->as.ask_query.condition != NULL) {
-                    metadata.hint_flags |= HINT_INDEX_SCAN;
-                    metadata.estimated_rows = 100;
-                } else {
-                    metadata.hint_flags |= HINT_FULL_SCAN;
-                    metadata.estimated_rows = 1000;
-                }
-                // If limit exists, cache result
-                if (node->as.ask_query.limit != NULL) {
-                    metadata.hint_flags |= HINT_CACHE_RESULT;
-                }
-                break;
-            case NODE_TELL_QUERY:
-                metadata.priority       = 192;  // Higher priority for writes
-                metadata.hint_flags     = 0;    // No read-only
-                metadata.estimated_rows = 1;
-                break;
-            default:
-                break;
-        }
-    }
-
-    return metadata;
-}
-
-/**
- * Serializes an AST and its execution metadata into a binary format with integrity
+ */
+static bool write_string(SerializeBuffer* buf, const char* str) {
+    return write_string_n(buf, str, str ? strlen(str) : 0);
+}
+
+/**
+ * Record the location of a parameter placeholder about to be written.
+ *
+ * @param buf The buffer being written.
+ * @param index The parameter index.
+ * @param kind SLOT_NODE or SLOT_COUNT.
+ * @return true if successful, false on failure.
+ */
+static bool record_slot(SerializeBuffer* buf, uint32_t index, uint8_t kind) {
+    if (buf->slot_count == buf->slot_capacity) {
+        size_t         capacity = buf->slot_capacity > 0 ? buf->slot_capacity * 2 : 8;
+        ParameterSlot* slots =
+            (ParameterSlot*)realloc(buf->slots, capacity * sizeof(ParameterSlot));
+        if (!slots)
+            return false;
+        buf->slots         = slots;
+        buf->slot_capacity = capacity;
+    }
+
+    ParameterSlot* slot = &buf->slots[buf->slot_count++];
+    slot->offset        = buf->size;
+    slot->index         = index;
+    slot->kind          = kind;
+    return true;
+}
+
+/**
+ * Write a LIMIT or OFFSET count, recording it as a slot if it is a placeholder.
+ *
+ * @param buf The buffer to write to.
+ * @param value The count.
+ * @return true if successful, false on failure.
+ */
+static bool write_count(SerializeBuffer* buf, int value) {
+    if (LIMIT_IS_PARAMETER(value) &&
+        !record_slot(buf, (uint32_t)LIMIT_PARAMETER_INDEX(value), SLOT_COUNT))
+        return false;
+    return write_int32(buf, value);
+}
+
+/**
+ * Reserve the child table of a node, with every slot marked absent.
+ *
+ * @param buf The buffer to write to.
+ * @param count Number of child slots.
+ * @param table Receives the offset of the table.
+ * @return true if successful, false on failure.
+ */
+static bool begin_children(SerializeBuffer* buf, size_t count, size_t* table) {
+    size_t size = count * sizeof(uint32_t);
+    if (!ensure_capacity(buf, size))
+        return false;
+    *table = buf->size;
+    memset(buf->buffer + buf->size, 0, size);
+    buf->size += size;
+    return true;
+}
+
+/**
+ * Point a child table entry at a child and record the link.
+ *
+ * @param buf The buffer being written.
+ * @param field Offset of the child table entry.
+ * @param start Offset of the parent node.
+ * @param child Offset of the child node.
+ * @return true if successful, false on failure.
+ */
+static bool link_child(SerializeBuffer* buf, size_t field, size_t start, size_t child) {
+    if (buf->link_count == buf->link_capacity) {
+        size_t     capacity = buf->link_capacity > 0 ? buf->link_capacity * 2 : 16;
+        ChildLink* links    = (ChildLink*)realloc(buf->links, capacity * sizeof(ChildLink));
+        if (!links)
+            return false;
+        buf->links         = links;
+        buf->link_capacity = capacity;
+    }
+
+    uint32_t offset = (uint32_t)(child - start);
+    memcpy(buf->buffer + field, &offset, sizeof(uint32_t));
+
+    ChildLink* link = &buf->links[buf->link_count++];
+    link->field     = field;
+    link->node      = start;
+    return true;
+}
+
+/**
+ * Serialize an identifier node.
+ *
+ * @param buf The buffer to write to.
+ * @param node The identifier node to serialize.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_identifier(SerializeBuffer* buf, const Node* node) {
+    return write_string_n(buf, node->as.identifier.name, node->as.identifier.length);
+}
+
+/**
+ * Serialize a literal node.
+ *
+ * @param buf The buffer to write to.
+ * @param node The literal node to serialize.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_literal(SerializeBuffer* buf, const Node* node) {
+    if (!write_uint8(buf, node->as.literal.literal_type))
+        return false;
+
+    switch (node->as.literal.literal_type) {
+        case TOKEN_STRING:
+            return write_string_n(buf, node->as.literal.value.string_value,
+                                  node->as.literal.length);
+        case TOKEN_INTEGER:
+        case TOKEN_DECIMAL:
+            return write_double(buf, node->as.literal.value.number_value);
+        default:
+            return false;
+    }
+}
+
+/**
+ * Serialize a node with its child table left absent.
+ *
+ * @param buf The buffer to write to.
+ * @param node The node to serialize.
+ * @param table Receives the offset of the child table, or SIZE_MAX if the node has none.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_node(SerializeBuffer* buf, const Node* node, size_t* table) {
+    *table = SIZE_MAX;
+
+    if (node->type == NODE_PARAMETER &&
+        !record_slot(buf, (uint32_t)node->as.parameter.index, SLOT_NODE))
+        return false;
+
+    // Write node type, then the line number for debugging
+    if (!write_uint8(buf, node->type) || !write_uint32(buf, node->line))
+        return false;
+
+    // Serialize node-specific data, then reserve one table entry per child slot
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            // SHOW and GET share the layout of ASK
+            return begin_children(buf, 6, table);
+
+        case NODE_TELL_QUERY:
+            return begin_children(buf, 3, table);
+
+        case NODE_FIND_QUERY:
+            return begin_children(buf, 5, table);
+
+        case NODE_FIELD_LIST:
+            return write_uint16(buf, node->as.field_list.count) &&
+                   begin_children(buf, (size_t)node->as.field_list.count, table);
+
+        case NODE_SOURCE: {
+            // The identifier is written inline, so the table only holds the join
+            const Node* identifier = node->as.source.identifier;
+            if (!write_string_n(buf, identifier->as.identifier.name,
+                                identifier->as.identifier.length))
+                return false;
+            if (!node->as.source.join)
+                return write_uint8(buf, 0);  // No join
+            return write_uint8(buf, 1) && begin_children(buf, 1, table);
+        }
+
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+            return begin_children(buf, 2, table);
+
+        case NODE_REMOVE_ACTION:
+            return begin_children(buf, 1, table);
+
+        case NODE_ORDER_BY:
+            if (!write_uint16(buf, node->as.order_by.count))
+                return false;
+            for (int i = 0; i < node->as.order_by.count; i++) {
+                if (!write_uint8(buf, node->as.order_by.ascending[i]))
+                    return false;
+            }
+            return begin_children(buf, (size_t)node->as.order_by.count, table);
+
+        case NODE_LIMIT:
+            return write_count(buf, node->as.limit.limit) &&
+                   write_count(buf, node->as.limit.offset);
+
+        case NODE_BINARY_EXPR:
+            return write_uint8(buf, node->as.binary_expr.op) && begin_children(buf, 2, table);
+
+        case NODE_UNARY_EXPR:
+            return write_uint8(buf, node->as.unary_expr.op) && begin_children(buf, 1, table);
+
+        case NODE_IDENTIFIER:
+            return serialize_identifier(buf, node);
+
+        case NODE_LITERAL:
+            return serialize_literal(buf, node);
+
+        case NODE_UPDATE_ACTION:
+            // Fields and values alternate
+            return write_uint16(buf, node->as.update_action.count) &&
+                   begin_children(buf, 2 * (size_t)node->as.update_action.count, table);
+
+        case NODE_CREATE_ACTION:
+            return write_uint16(buf, node->as.create_action.count) &&
+                   begin_children(buf, (size_t)node->as.create_action.count, table);
+
+        case NODE_FIELD_DEF:
+            // The name comes before the constraints
+            return write_string(buf, node->as.field_def.type) &&
+                   write_uint16(buf, node->as.field_def.constraint_count) &&
+                   begin_children(buf, 1 + (size_t)node->as.field_def.constraint_count, table);
+
+        case NODE_CONSTRAINT:
+            return write_uint8(buf, node->as.constraint.type) && begin_children(buf, 1, table);
+
+        case NODE_FUNCTION_CALL:
+            return write_string(buf, node->as.function_call.name) &&
+                   write_uint16(buf, node->as.function_call.arg_count) &&
+                   begin_children(buf, (size_t)node->as.function_call.arg_count, table);
+
+        case NODE_ERROR:
+            return write_string(buf, node->as.error.message);
+
+        case NODE_PROGRAM:
+            // Scripts can outgrow the 16-bit counts of the other lists
+            return write_uint32(buf, (uint32_t)node->as.program.count) &&
+                   begin_children(buf, (size_t)node->as.program.count, table);
+
+        case NODE_PARAMETER:
+            // The parser numbers at most NSQL_MAX_PARAMETERS placeholders per statement
+            return write_uint16(buf, (uint16_t)node->as.parameter.index);
+
+        case NODE_LOGICAL_EXPR:
+            // Generated chains can run to thousands of operands, so the count is a varint
+            return write_uint8(buf, node->as.logical_expr.op) &&
+                   write_varint(buf, (uint32_t)node->as.logical_expr.count) &&
+                   begin_children(buf, (size_t)node->as.logical_expr.count, table);
+
+        case NODE_IN_LIST:
+            // The value comes before the items
+            return write_varint(buf, (uint32_t)node->as.in_list.count) &&
+                   begin_children(buf, 1 + (size_t)node->as.in_list.count, table);
+
+        default:
+            return false;  // Unsupported node type
+    }
+}
+
+// Where a node was written
+typedef struct {
+    size_t start;  // Offset of the node
+    size_t table;  // Offset of its child table (SIZE_MAX if it has none)
+} NodeOffsets;
+
+// State of serialize_tree()
+typedef struct {
+    SerializeBuffer* buf;       // The buffer being written
+    NodeOffsets*     open;      // Offsets of the node at each depth on the path from the root
+    size_t           capacity;  // Allocated entries in open
+    bool             ok;        // Has everything been written so far?
+} SerializeWalk;
+
+/**
+ * Serialize a node and point the child table entry of its parent at it.
+ *
+ * @param frame The node.
+ * @param user_data The SerializeWalk.
+ * @return AST_VISIT_STOP on failure, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction serialize_visit(const AstVisitFrame* frame, void* user_data) {
+    SerializeWalk* walk   = (SerializeWalk*)user_data;
+    const Node*    parent = frame->parent;
+    size_t         depth  = (size_t)frame->depth;
+
+    // A source writes its identifier inline
+    if (parent && parent->type == NODE_SOURCE && frame->slot == 0)
+        return AST_VISIT_SKIP;
+
+    if (depth == walk->capacity) {
+        size_t       capacity = walk->capacity * 2;
+        NodeOffsets* open     = (NodeOffsets*)realloc(walk->open, capacity * sizeof(NodeOffsets));
+        if (!open) {
+            walk->ok = false;
+            return AST_VISIT_STOP;
+        }
+        walk->open     = open;
+        walk->capacity = capacity;
+    }
+
+    NodeOffsets* at = &walk->open[depth];
+    at->start       = walk->buf->size;
+    if (parent) {
+        const NodeOffsets* up    = &walk->open[depth - 1];
+        size_t             index = parent->type == NODE_SOURCE ? 0 : (size_t)frame->slot;
+        if (!link_child(walk->buf, up->table + index * sizeof(uint32_t), up->start, at->start)) {
+            walk->ok = false;
+            return AST_VISIT_STOP;
+        }
+    }
+
+    walk->ok = serialize_node(walk->buf, frame->node, &at->table);
+    return walk->ok ? AST_VISIT_CONTINUE : AST_VISIT_STOP;
+}
+
+/**
+ * Serialize a tree.
+ *
+ * The nodes are written in preorder by ast_visit(), each linked into the child table of its
+ * parent as it is written.
+ *
+ * @param buf The buffer to write to.
+ * @param node Root of the tree.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_tree(SerializeBuffer* buf, const Node* node) {
+    SerializeWalk walk;
+    walk.buf      = buf;
+    walk.capacity = 16;
+    walk.open     = (NodeOffsets*)malloc(walk.capacity * sizeof(NodeOffsets));
+    walk.ok       = walk.open != NULL;
+    if (!walk.ok)
+        return false;
+
+    // The walk does not modify the tree
+    AstVisitor visitor = {serialize_visit, NULL, &walk, false};
+    ast_visit((Node*)node, &visitor);
+    free(walk.open);
+    return walk.ok;
+}
+
+// =======================================================
+// Pooled ASTs
+// =======================================================
+
+/**
+ * Get the string held in the word after the child slots of a pooled node.
+ *
+ * @param pool The pool.
+ * @param node A NODE_FIELD_DEF or NODE_FUNCTION_CALL.
+ * @return The type or function name (may be NULL).
+ */
+static const char* pooled_name(const AstPool* pool, const FlatNode* node) {
+    return ast_pool_string(pool, pool->slots[node->as.children.first + node->as.children.count]);
+}
+
+/**
+ * Serialize a pooled node with its child table left absent.
+ *
+ * @param buf The buffer to write to.
+ * @param pool The pool.
+ * @param index The node.
+ * @param table Receives the offset of the child table, or SIZE_MAX if the node has none.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_pooled_node(SerializeBuffer* buf, const AstPool* pool, NodeIndex index,
+                                  size_t* table) {
+    const FlatNode* node  = &pool->nodes[index];
+    uint32_t        count = node->as.children.count;
+    *table                = SIZE_MAX;
+
+    if (node->type == NODE_PARAMETER &&
+        !record_slot(buf, (uint32_t)node->as.parameter, SLOT_NODE))
+        return false;
+
+    if (!write_uint8(buf, node->type) || !write_uint32(buf, (uint32_t)node->line))
+        return false;
+
+    // The same layouts as serialize_node()
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+        case NODE_TELL_QUERY:
+        case NODE_FIND_QUERY:
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+        case NODE_REMOVE_ACTION:
+            return begin_children(buf, count, table);
+
+        case NODE_FIELD_LIST:
+        case NODE_CREATE_ACTION:
+            return write_uint16(buf, (uint16_t)count) && begin_children(buf, count, table);
+
+        case NODE_SOURCE: {
+            NodeIndex       identifier = ast_pool_child(pool, node, 0);
+            const FlatNode* name = identifier != NODE_INDEX_NONE ? &pool->nodes[identifier] : NULL;
+            if (!write_string_n(buf, name ? ast_pool_string(pool, name->as.string.offset) : NULL,
+                                name ? name->as.string.length : 0))
+                return false;
+            if (ast_pool_child(pool, node, 1) == NODE_INDEX_NONE)
+                return write_uint8(buf, 0);  // No join
+            return write_uint8(buf, 1) && begin_children(buf, 1, table);
+        }
+
+        case NODE_ORDER_BY:
+            if (!write_uint16(buf, (uint16_t)count))
+                return false;
+            for (uint32_t i = 0; i < count; i++) {
+                if (!write_uint8(buf, ast_pool_ascending(pool, node, i)))
+                    return false;
+            }
+            return begin_children(buf, count, table);
+
+        case NODE_LIMIT:
+            return write_count(buf, node->as.limit.limit) &&
+                   write_count(buf, node->as.limit.offset);
+
+        case NODE_BINARY_EXPR:
+        case NODE_UNARY_EXPR:
+        case NODE_CONSTRAINT:
+            return write_uint8(buf, node->op) && begin_children(buf, count, table);
+
+        case NODE_IDENTIFIER:
+        case NODE_ERROR:
+            return write_string_n(buf, ast_pool_string(pool, node->as.string.offset),
+                                  node->as.string.length);
+
+        case NODE_LITERAL:
+            if (!write_uint8(buf, node->op))
+                return false;
+            switch (node->op) {
+                case TOKEN_STRING:
+                    return write_string_n(buf, ast_pool_string(pool, node->as.string.offset),
+                                          node->as.string.length);
+                case TOKEN_INTEGER:
+                case TOKEN_DECIMAL:
+                    return write_double(buf, node->as.number);
+                default:
+                    return false;
+            }
+
+        case NODE_UPDATE_ACTION:
+            return write_uint16(buf, (uint16_t)(count / 2)) && begin_children(buf, count, table);
+
+        case NODE_FIELD_DEF:
+            return write_string(buf, pooled_name(pool, node)) &&
+                   write_uint16(buf, (uint16_t)(count - 1)) && begin_children(buf, count, table);
+
+        case NODE_FUNCTION_CALL:
+            return write_string(buf, pooled_name(pool, node)) &&
+                   write_uint16(buf, (uint16_t)count) && begin_children(buf, count, table);
+
+        case NODE_PROGRAM:
+            return write_uint32(buf, count) && begin_children(buf, count, table);
+
+        case NODE_PARAMETER:
+            return write_uint16(buf, (uint16_t)node->as.parameter);
+
+        case NODE_LOGICAL_EXPR:
+            return write_uint8(buf, node->op) && write_varint(buf, count) &&
+                   begin_children(buf, count, table);
+
+        case NODE_IN_LIST:
+            return write_varint(buf, count - 1) && begin_children(buf, count, table);
+
+        default:
+            return false;  // Unsupported node type
+    }
+}
+
+/**
+ * Serialize a pooled tree.
+ *
+ * Pooled trees are in preorder, which is the order the nodes are serialized in, so the nodes are
+ * written by one forward scan of the node array. A second scan fills in the child tables from
+ * the recorded node offsets.
+ *
+ * @param buf The buffer to write to.
+ * @param pool The pool.
+ * @param root Index of the root.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_pool(SerializeBuffer* buf, const AstPool* pool, NodeIndex root) {
+    NodeIndex    end     = ast_pool_end(pool, root);
+    NodeOffsets* offsets = (NodeOffsets*)malloc((end - root) * sizeof(NodeOffsets));
+    if (!offsets)
+        return false;
+
+    bool ok = true;
+    for (NodeIndex index = root; index < end && ok; index++) {
+        const FlatNode* node = &pool->nodes[index];
+        offsets[index - root].start = buf->size;
+        ok = serialize_pooled_node(buf, pool, index, &offsets[index - root].table);
+
+        // A source writes its identifier inline, and the identifier is the node after it
+        if (node->type == NODE_SOURCE && ast_pool_child(pool, node, 0) != NODE_INDEX_NONE) {
+            index++;
+            offsets[index - root].table = SIZE_MAX;
+        }
+    }
+
+    for (NodeIndex index = root; index < end && ok; index++) {
+        const NodeOffsets* at = &offsets[index - root];
+        if (at->table == SIZE_MAX)
+            continue;
+
+        // The table of a source only holds its join
+        const FlatNode* node  = &pool->nodes[index];
+        bool            join  = node->type == NODE_SOURCE;
+        size_t          first = node->as.children.first + (join ? 1 : 0);
+        size_t          count = join ? 1 : node->as.children.count;
+        for (size_t i = 0; i < count && ok; i++) {
+            NodeIndex child = pool->slots[first + i];
+            if (child != NODE_INDEX_NONE)
+                ok = link_child(buf, at->table + i * sizeof(uint32_t), at->start,
+                                offsets[child - root].start);
+        }
+    }
+
+    free(offsets);
+    return ok;
+}
+
+/**
+ * Write the target index of the metadata block: its length, a reserved word, then its bytes.
+ *
+ * @param buf The buffer to write to.
+ * @param index The target index (may be NULL).
+ * @return true if successful, false on failure.
+ */
+static bool write_target_index(SerializeBuffer* buf, const char* index) {
+    size_t len = index ? strlen(index) : 0;
+    if (len > UINT16_MAX) {
+        fprintf(stderr, "Warning: String too long, truncating to %u bytes\n", UINT16_MAX);
+        len = UINT16_MAX;
+    }
+    if (!write_uint16(buf, (uint16_t)len))
+        return false;
+    if (!write_uint16(buf, 0))  // Reserved
+        return false;
+    return len == 0 || write_bytes(buf, index, len);
+}
+
+/**
+ * Serialize the execution metadata block, which precedes the root node.
+ *
+ * @param buf The buffer to write to.
+ * @param metadata The metadata to serialize.
+ * @return true if successful, false on failure.
+ */
+static bool serialize_metadata(SerializeBuffer* buf, const ExecutionMetadata* metadata) {
+    if (!metadata) {
+        // No metadata, write zeros
+        if (!write_uint16(buf, 0))
+            return false;  // hints
+        if (!write_uint8(buf, 128))
+            return false;  // priority (default 128)
+        if (!write_uint8(buf, ENGINE_AUTO))
+            return false;  // engine
+        if (!write_uint32(buf, 0))
+            return false;  // rows
+        if (!write_uint32(buf, 30000))
+            return false;  // timeout (30s default)
+        if (!write_target_index(buf, NULL))
+            return false;  // index
+        return true;
+    }
+
+    if (!write_uint16(buf, metadata->hint_flags))
+        return false;
+    if (!write_uint8(buf, metadata->priority))
+        return false;
+    if (!write_uint8(buf, metadata->engine_type))
+        return false;
+    if (!write_uint32(buf, metadata->estimated_rows))
+        return false;
+    if (!write_uint32(buf, metadata->timeout_ms))
+        return false;
+    if (!write_target_index(buf, metadata->target_index))
+        return false;
+
+    return true;
+}
+
+/**
+ * Count the keys a condition looks up.
+ *
+ * An equality looks up one key and an IN list one per item. An OR of lookups looks up all of
+ * its operands' keys, and an AND at most those of its narrowest lookup operand. Conditions nested
+ * more deeply than the parser allows, which only decoded trees can be, count as scans.
+ *
+ * @param condition The condition.
+ * @param depth Nesting depth of the condition.
+ * @return The number of keys, or 0 if the condition is not a set of key lookups.
+ */
+static uint32_t condition_keys(const Node* condition, int depth) {
+    uint32_t keys = 0;
+    if (!condition || depth > NSQL_MAX_EXPRESSION_DEPTH)
+        return 0;
+
+    switch (condition->type) {
+        case NODE_BINARY_EXPR:
+            return condition->as.binary_expr.op == TOKEN_EQUAL ? 1 : 0;
+
+        case NODE_IN_LIST:
+            return (uint32_t)condition->as.in_list.count;
+
+        case NODE_LOGICAL_EXPR:
+            for (int i = 0; i < condition->as.logical_expr.count; i++) {
+                uint32_t operand =
+                    condition_keys(condition->as.logical_expr.operands[i], depth + 1);
+                if (condition->as.logical_expr.op == TOKEN_OR) {
+                    if (operand == 0)
+                        return 0;  // A single scan operand turns the whole OR into a scan
+                    keys = operand > UINT32_MAX - keys ? UINT32_MAX : keys + operand;
+                } else if (operand > 0 && (keys == 0 || operand < keys)) {
+                    keys = operand;
+                }
+            }
+            return keys;
+
+        default:
+            return 0;
+    }
+}
+
+ExecutionMetadata ast_create_metadata(const Node* node) {
+    // TODO: Revisit this logic
+    ExecutionMetadata metadata;
+    metadata.hint_flags     = 0;
+    metadata.priority       = 128;
+    metadata.engine_type    = ENGINE_AUTO;
+    metadata.estimated_rows = 0;
+    metadata.timeout_ms     = 30000;
+    metadata.target_index   = NULL;
+
+    if (!node)
+        return metadata;
+
+    if (ast_is_nosql_query(node)) {
+        // NoSQL: favor concurrency, parallelism, and lightness
+        metadata.engine_type = ENGINE_NOSQL;
+        metadata.hint_flags |= HINT_PARALLEL_EXEC | HINT_READ_ONLY;
+        metadata.priority   = 128;    // Balanced
+        metadata.timeout_ms = 10000;  // Faster timeout for NoSQL
+        // FIND queries: expect many rows, so set estimated_rows high
+        if (node->type == NODE_FIND_QUERY) {
+            metadata.estimated_rows = 10000;
+            metadata.hint_flags |= HINT_FULL_SCAN;
+        }
+        // SHOW/GET: reporting, so cache results
+        if (node->type == NODE_SHOW_QUERY || node->type == NODE_GET_QUERY) {
+            metadata.estimated_rows = 1000;
+            metadata.hint_flags |= HINT_CACHE_RESULT;
+            metadata.priority = 96;
+        }
+    } else {
+        // SQL: favor consistency, indexing, and correctness
+        metadata.engine_type = ENGINE_SQL;
+        switch (node->type) {
+            case NODE_ASK_QUERY:
+                metadata.hint_flags |= HINT_READ_ONLY;
+                metadata.priority = 128;
+                // If condition exists, prefer index scan
+                if (node->as.ask_query.condition != NULL) {
+                    uint32_t keys = condition_keys(node->as.ask_query.condition, 0);
+                    metadata.hint_flags |= HINT_INDEX_SCAN;
+                    metadata.estimated_rows = keys > 1 ? keys : 100;
+                    // Long IN lists and OR chains are many independent lookups
+                    if (keys >= PARALLEL_LOOKUP_KEYS)
+                        metadata.hint_flags |= HINT_PARALLEL_EXEC;
+                } else {
+                    metadata.hint_flags |= HINT_FULL_SCAN;
+                    metadata.estimated_rows = 1000;
+                }
+                // If limit exists, cache result
+                if (node->as.ask_query.limit != NULL) {
+                    metadata.hint_flags |= HINT_CACHE_RESULT;
+                }
+                break;
+            case NODE_TELL_QUERY:
+                metadata.priority       = 192;  // Higher priority for writes
+                metadata.hint_flags     = 0;    // No read-only
+                metadata.estimated_rows = 1;
+                break;
+            default:
+                break;
+        }
+    }
+
+    return metadata;
+}
+
+/**
+ * Serialize a complete AST, header included, at the end of a buffer.
+ *
+ * The header space is reserved up front and filled in last, so the nodes are written in place.
+ * On failure the buffer may hold a partial frame past its original size.
+ *
+ * @param buf The buffer to write to.
+ * @param strings An empty string table for the AST's strings.
+ * @param node Root node of the AST (NULL to serialize root of pool instead).
+ * @param pool Pool holding the AST when node is NULL.
+ * @param root Index of the root in pool.
+ * @param metadata Execution metadata (NULL for defaults).
+ * @return true if successful, false on failure.
+ */
+static bool serialize_frame(SerializeBuffer* buf, StringTable* strings, const Node* node,
+                            const AstPool* pool, NodeIndex root,
+                            const ExecutionMetadata* metadata) {
+    NSQL_STAT_CLOCK(started);
+    size_t start = buf->size;
+    buf->strings = strings;
+
+    if (!ensure_capacity(buf, AST_HEADER_SIZE))
+        return false;
+    buf->size += AST_HEADER_SIZE;
+
+    // Serialize metadata, which sits at a fixed position after the header, then the AST
+    if (!serialize_metadata(buf, metadata) ||
+        !(node ? serialize_tree(buf, node) : serialize_pool(buf, pool, root)))
+        return false;
+
+    // The string table follows the nodes, with its size last so readers can find it
+    SerializeBuffer* table = strings->entries;
+    if (!write_bytes(buf, table->buffer, table->size) ||
+        !write_uint32(buf, (uint32_t)table->size))
+        return false;
+
+    size_t data_size = buf->size - start - AST_HEADER_SIZE;
+    if (data_size > UINT32_MAX)
+        return false;
+
+    uint32_t header[AST_HEADER_SIZE / sizeof(uint32_t)] = {
+        AST_MAGIC_NUMBER,      // Magic number
+        AST_VERSION,           // Version
+        AST_CHECKSUM_DEFAULT,  // Checksum algorithm
+        (uint32_t)data_size,   // Data size
+        (uint32_t)data_size,   // Original size (same, not compressed)
+        0,                     // Checksum
+        AST_CODEC_NONE,        // Codec
+    };
+    nsql_checksum(AST_CHECKSUM_DEFAULT, buf->buffer + start + AST_HEADER_SIZE, data_size,
+                  &header[5]);
+    memcpy(buf->buffer + start, header, AST_HEADER_SIZE);
+
+    NSQL_STAT_ADD(serialized_asts, 1);
+    NSQL_STAT_ADD(serialized_bytes, buf->size - start);
+    NSQL_STAT_ELAPSED(NSQL_STAGE_SERIALIZE, started);
+    return true;
+}
+
+/**
+ * Serialize an AST from a Node tree or a pool into a new handle.
+ *
+ * @param node Root node of the AST (NULL to serialize root of pool instead).
+ * @param pool Pool holding the AST when node is NULL.
+ * @param root Index of the root in pool.
+ * @param metadata Execution metadata (NULL for defaults).
+ * @return The serialized AST, or NULL on failure.
+ */
+static SerializedAST* serialize_ast(const Node* node, const AstPool* pool, NodeIndex root,
+                                    const ExecutionMetadata* metadata) {
+    // Initialize serialized AST
+    SerializedAST* ast = (SerializedAST*)malloc(sizeof(SerializedAST));
+    if (!ast)
+        return NULL;
+
+    ast->data            = NULL;
+    ast->size            = 0;
+    ast->checksum        = 0;
+    ast->is_valid        = false;
+    ast->slots           = NULL;
+    ast->slot_count      = 0;
+    ast->parameter_count = 0;
+    ast->links           = NULL;
+    ast->link_count      = 0;
+
+    // Initialize the output buffer, and the table its strings go into
+    SerializeBuffer* buf     = init_buffer(4096);
+    StringTable*     strings = init_string_table();
+    if (!buf || !strings || !serialize_frame(buf, strings, node, pool, root, metadata)) {
+        free_buffer(buf);
+        free_string_table(strings);
+        free(ast);
+        return NULL;
+    }
+    free_string_table(strings);
+
+    // Set serialized AST fields
+    ast->data     = buf->buffer;
+    ast->size     = buf->size;
+    ast->checksum = read_uint32(buf->buffer + 20);
+    ast->is_valid = true;  // Mark as valid
+
+    // Keep the placeholder locations so ast_bind_parameters() can patch them, along with the
+    // child offsets that change when a placeholder is resized
+    ast->slots      = buf->slots;
+    ast->slot_count = buf->slot_count;
+    for (size_t i = 0; i < ast->slot_count; i++) {
+        if (ast->slots[i].index >= ast->parameter_count)
+            ast->parameter_count = ast->slots[i].index + 1;
+    }
+    if (ast->slot_count > 0) {
+        ast->links      = buf->links;
+        ast->link_count = buf->link_count;
+    } else {
+        free(buf->links);
+    }
+
+    free(buf);  // Only free the struct, not buffer which is now owned by ast
+
+    return ast;
+}
+
+/**
+ * Serializes an AST and its execution metadata into a binary format with integrity
  * verification.
  *
- * Serializes the provided AST node and optional execution metadata into a
+ * Serializes the provided AST node and optional execution metadata into a
  * contiguous binary buffer,
- * prepends a fixed-size header containing metadata and a CRC32
+ * prepends a fixed-size header containing metadata and a CRC32
  * checksum, and returns a handle to the
- * resulting SerializedAST structure. Returns NULL if
+ * resulting SerializedAST structure. Returns NULL if
  * serialization fails at any stage.
  *
  * @param node Root node of the AST to serialize.
- * @param
+ * @param
  * metadata Optional execution metadata; if NULL, default values are used.
- * @return Pointer to a
+ * @return Pointer to a
  * SerializedAST structure containing the serialized data, or NULL on failure.
- */
-SerializedAST* ast_serialize(Node* node, const ExecutionMetadata* metadata) {
-    if (!node)
-        return NULL;
-
-    // Initialize serialized AST
-    SerializedAST* ast = (SerializedAST*)malloc(sizeof(SerializedAST));
-    if (!ast)
-        return NULL;
-
-    ast->data     = NULL;
-    ast->size     = 0;
-    ast->checksum = 0;
-    ast->is_valid = false;
-
-    // Initialize buffer for node serialization
-    SerializeBuffer* data_buf = init_buffer(4096);
-    if (!data_buf) {
-        free(ast);
-        return NULL;
-    }
-
-    // Serialize the AST
-    if (!serialize_node(data_buf, node)) {
-        free_buffer(data_buf);
-        free(ast);
-        return NULL;
-    }
-
-    // Serialize metadata
-    if (!serialize_metadata(data_buf, metadata)) {
-        free_buffer(data_buf);
-        free(ast);
-        return NULL;
-    }
-
-    // Calculate checksum
-    uint32_t checksum = calculate_crc32(data_buf->buffer, data_buf->size);
-
-    // Create buffer for final output with header
-    SerializeBuffer* final_buf = init_buffer(AST_HEADER_SIZE + data_buf->size);
-    if (!final_buf) {
-        free_buffer(data_buf);
-        free(ast);
-        return NULL;
-    }
-
-    // Write header
-    if (!write_uint32(final_buf, AST_MAGIC_NUMBER))  // Magic number
-        return NULL;
-    if (!write_uint32(final_buf, AST_VERSION))  // Version
-        return NULL;
-    if (!write_uint32(final_buf, 0))  // Reserved
-        return NULL;
-    if (!write_uint32(final_buf, data_buf->size))  // Data size
-        return NULL;
-    // Either use original_size or remove it
-    if (!write_uint32(final_buf, data_buf->size))  // Original size (same, no compression)
-        return NULL;
-    if (!write_uint32(final_buf, checksum))  // Checksum
-        return NULL;
-    if (!write_uint32(final_buf, 0))  // Reserved
-        return NULL;
-
-    // Write data
-    write_bytes(final_buf, data_buf->buffer, data_buf->size);
-
-    // Set serialized AST fields
-    ast->data     = final_buf->buffer;
-    ast->size     = final_buf->size;
-    ast->checksum = checksum;
-    ast->is_valid = true;  // Mark as valid
-
-    // Free temporary buffers
-    free(data_buf->buffer);
-    free(data_buf);
-    free(final_buf);  // Only free the struct, not buffer which is now owned by ast
-
-    return ast;
-}
-
-/**
- * Free serialized AST.
- *
- * @param ast The serialized AST to free.
- */
-void ast_free(SerializedAST* ast) {
-    if (ast) {
-        free(ast->data);
-        free(ast);
-    }
-}
-
-/**
- * Get raw binary data from serialized AST.
- *
- * @param ast The serialized AST.
- * @param size Pointer to store the size of the data.
- *
- * @return Pointer to binary data (do not free separately).
- * @note The caller is responsible for freeing the serialized AST using ast_free().
- */
-const void* ast_get_data(const SerializedAST* ast, size_t* size) {
-    if (!ast || !ast->is_valid) {
-        if (size)
-            *size = 0;
-        return NULL;
-    }
-
-    if (size)
-        *size = ast->size;
-
-    return ast->data;
-}
-
-/**
- * Deserialize AST from binary data.
- *
- * @param data Binary serialized AST data.
- * @param size Size of the data.
- * @return SerializedAST handle or NULL if invalid.
- */
-SerializedAST* ast_deserialize(const void* data, size_t size) {
-    if (!data || size < AST_HEADER_SIZE)
-        return NULL;
-
-    const char* char_data = (const char*)data;
-
-    // Parse header (all fields are uint32_t, 4 bytes each)
-    uint32_t magic   = *((uint32_t*)(char_data + 0));
-    uint32_t version = *((uint32_t*)(char_data + 4));
-    // uint32_t reserved1    = *((uint32_t*)(char_data + 8));
-    uint32_t data_size       = *((uint32_t*)(char_data + 12));
-    uint32_t original_size   = *((uint32_t*)(char_data + 16));
-    uint32_t stored_checksum = *((uint32_t*)(char_data + 20));
-    // uint32_t reserved2    = *((uint32_t*)(char_data + 24));
-
-    if (magic != AST_MAGIC_NUMBER) {
-        return NULL;  // Invalid magic number
-    }
-
-    if (version > AST_VERSION) {
-        return NULL;  // Incompatible version
-    }
-
-    // Check if data size matches
-    if (size != AST_HEADER_SIZE + data_size) {
-        return NULL;  // Size mismatch
-    }
-
-    // Get data pointer
-    const char* ast_data = char_data + AST_HEADER_SIZE;
-
-    // Compute checksum
-    uint32_t computed_checksum = calculate_crc32(ast_data, data_size);
-
-    // Create serialized AST
-    SerializedAST* ast = (SerializedAST*)malloc(sizeof(SerializedAST));
-    if (!ast)
-        return NULL;
-
-    // Make a copy of the data
-    ast->data = malloc(size);
-    if (!ast->data) {
-        free(ast);
-        return NULL;
-    }
-
-    memcpy(ast->data, data, size);
-    ast->size     = size;
-    ast->checksum = computed_checksum;
-    ast->is_valid = (computed_checksum == stored_checksum);
-
-    return ast;
-}
-
-bool ast_verify_checksum(const SerializedAST* ast) {
-    if (!ast || !ast->data || ast->size < AST_HEADER_SIZE)
-        return false;
-
-    const char* char_data       = (const char*)ast->data;
-    uint32_t    stored_checksum = *((uint32_t*)(char_data + 20));
-    const char* ast_data        = char_data + AST_HEADER_SIZE;
-    uint32_t    data_size       = *((uint32_t*)(char_data + 12));
-
-    uint32_t computed_checksum = calculate_crc32(ast_data, data_size);
-
-    return computed_checksum == stored_checksum;
-}
-
-bool ast_extract_metadata(const SerializedAST* ast, ExecutionMetadata* metadata) {
-    if (!ast || !metadata || !ast->is_valid) {
-        return false;  // Invalid AST or metadata pointer
-    }
-
-    const char* char_data = (const char*)ast->data;
-    const char* ast_data  = char_data + AST_HEADER_SIZE;
-    uint32_t    data_size = *((uint32_t*)(char_data + 12));
-
-    // Find the start of metadata (at the end of the AST data)
-    if (data_size < 8) {
-        return false;
-    }
-    size_t offset = data_size;
-
-    // Find string length
-    size_t pos = offset;
-    // Step back to read string length
-    pos -= 2;
-    uint16_t str_len = *((uint16_t*)(ast_data + pos));
-    // Step back to start of string
-    pos -= str_len;
-    // Allocate and copy string (may be NULL)
-    char* target_index = NULL;
-    if (str_len > 0) {
-        target_index = (char*)malloc(str_len + 1);
-        if (!target_index)
-            return false;
-        memcpy(target_index, ast_data + pos, str_len);
-        target_index[str_len] = '\0';
-    }
-
-    // Step back for timeout_ms (uint32_t)
-    pos -= 4;
-    uint32_t timeout_ms = *((uint32_t*)(ast_data + pos));
-    // Step back for estimated_rows (uint32_t)
-    pos -= 4;
-    uint32_t estimated_rows = *((uint32_t*)(ast_data + pos));
-    // Step back for engine_type (uint8_t)
-    pos -= 1;
-    uint8_t engine_type = *((uint8_t*)(ast_data + pos));
-    // Step back for priority (uint8_t)
-    pos -= 1;
-    uint8_t priority = *((uint8_t*)(ast_data + pos));
-    // Step back for hint_flags (uint16_t)
-    pos -= 2;
-    uint16_t hint_flags = *((uint16_t*)(ast_data + pos));
-
-    // Fill metadata struct
-    metadata->hint_flags     = hint_flags;
-    metadata->priority       = priority;
-    metadata->engine_type    = engine_type;
-    metadata->estimated_rows = estimated_rows;
-    metadata->timeout_ms     = timeout_ms;
-    metadata->target_index   = target_index;
-
-    return true;
-}
-
-/**
- * Determine if a query should use NoSQL storage engine.
- *
- * @param node The AST node.
- * @return true if query should use NoSQL, false if SQL.
- */
-bool ast_is_nosql_query(const Node* node) {
-    // TODO: Revisit this logic
-    if (!node)
-        return false;
-
-    switch (node->type) {
-        case NODE_FIND_QUERY:
-            // FIND queries are always NoSQL
-            return true;
-        case NODE_SHOW_QUERY:
-        case NODE_GET_QUERY:
-            // SHOW/GET queries are NoSQL if they use NoSQL types or sources
-            // For now, treat as NoSQL if the source or fields are not SQL-like
-            return true;
-        case NODE_TELL_QUERY:
-            // TELL is SQL unless the action is ADD/REMOVE/UPDATE on a NoSQL table
-            // For now, treat as SQL
-            return false;
-        case NODE_ASK_QUERY:
-            // ASK is SQL unless the source or fields are NoSQL types
-            // For now, treat as SQL
-            return false;
-        default:
-            return false;
-    }
+ */
+SerializedAST* ast_serialize(Node* node, const ExecutionMetadata* metadata) {
+    if (!node)
+        return NULL;
+    return serialize_ast(node, NULL, 0, metadata);
+}
+
+/**
+ * Serialize a pooled AST, producing the same data as ast_serialize() on the equivalent tree.
+ *
+ * @param pool The pool.
+ * @param root Index of the root.
+ * @param metadata Execution metadata (NULL for defaults).
+ * @return The serialized AST, or NULL on failure.
+ */
+SerializedAST* ast_pool_serialize(const AstPool* pool, NodeIndex root,
+                                  const ExecutionMetadata* metadata) {
+    if (!pool || root >= pool->node_count)
+        return NULL;
+    return serialize_ast(NULL, pool, root, metadata);
+}
+
+/**
+ * Initialize a growable batch buffer.
+ *
+ * @param buffer The buffer to initialize.
+ */
+void ast_batch_buffer_init(AstBatchBuffer* buffer) {
+    buffer->data     = NULL;
+    buffer->size     = 0;
+    buffer->capacity = 0;
+    buffer->fixed    = false;
+}
+
+/**
+ * Initialize a batch buffer over caller-provided memory.
+ *
+ * @param buffer The buffer to initialize.
+ * @param memory The memory to serialize into.
+ * @param capacity Size of the memory in bytes.
+ */
+void ast_batch_buffer_init_fixed(AstBatchBuffer* buffer, void* memory, size_t capacity) {
+    buffer->data     = memory;
+    buffer->size     = 0;
+    buffer->capacity = capacity;
+    buffer->fixed    = true;
+}
+
+/**
+ * Free the memory of a growable batch buffer.
+ *
+ * @param buffer The buffer to free.
+ */
+void ast_batch_buffer_free(AstBatchBuffer* buffer) {
+    if (!buffer)
+        return;
+
+    if (!buffer->fixed)
+        free(buffer->data);
+    buffer->data     = NULL;
+    buffer->size     = 0;
+    buffer->capacity = 0;
+}
+
+/**
+ * Serialize many ASTs into one buffer, one complete frame after another.
+ *
+ * The frames share one output buffer and one string table, both reused from frame to frame, so a
+ * batch costs no allocations once the buffer and table have grown to fit.
+ *
+ * @param roots Root nodes of the ASTs.
+ * @param count Number of roots.
+ * @param metadata Execution metadata per root (NULL for defaults throughout).
+ * @param buffer The output buffer, overwritten from its start.
+ * @return The number of ASTs serialized; buffer->size covers exactly their frames.
+ */
+size_t ast_serialize_batch(Node* const* roots, size_t count, const ExecutionMetadata* metadata,
+                           AstBatchBuffer* buffer) {
+    if (!roots || !buffer)
+        return 0;
+
+    buffer->size         = 0;
+    StringTable* strings = init_string_table();
+    if (!strings)
+        return 0;
+
+    SerializeBuffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.buffer   = (char*)buffer->data;
+    buf.capacity = buffer->capacity;
+    buf.fixed    = buffer->fixed;
+
+    size_t done = 0;
+    for (; done < count && roots[done]; done++) {
+        size_t start = buf.size;
+
+        // Placeholder locations are only kept by ast_serialize()
+        buf.slot_count = 0;
+        buf.link_count = 0;
+        reset_string_table(strings);
+        if (!serialize_frame(&buf, strings, roots[done], NULL, 0,
+                             metadata ? &metadata[done] : NULL)) {
+            buf.size = start;  // Drop the partial frame
+            break;
+        }
+    }
+
+    free(buf.slots);
+    free(buf.links);
+    free_string_table(strings);
+
+    buffer->data     = buf.buffer;
+    buffer->size     = buf.size;
+    buffer->capacity = buf.capacity;
+    return done;
+}
+
+/**
+ * Get the size of the frame at the start of a batch.
+ *
+ * @param data The batch data.
+ * @param size Size of the data in bytes.
+ * @return The frame size, or 0 if the data does not start with a complete frame.
+ */
+size_t ast_frame_size(const void* data, size_t size) {
+    if (!data || size < AST_HEADER_SIZE)
+        return 0;
+
+    uint32_t magic;
+    uint32_t data_size;
+    memcpy(&magic, data, sizeof(uint32_t));
+    memcpy(&data_size, (const char*)data + 12, sizeof(uint32_t));
+    if (magic != AST_MAGIC_NUMBER || data_size > size - AST_HEADER_SIZE)
+        return 0;
+    return AST_HEADER_SIZE + (size_t)data_size;
+}
+
+/**
+ * Decode a serialized AST into a Node tree.
+ *
+ * @param ast The serialized AST.
+ * @return The tree, or NULL if the AST is invalid, compressed or malformed.
+ */
+Node* ast_decode(const SerializedAST* ast) {
+    AstReader reader;
+    if (!ast || !ast->is_valid || !ast_reader_init(&reader, ast->data, ast->size, false))
+        return NULL;
+    return ast_reader_materialize(&reader, ast_reader_root(&reader));
+}
+
+/**
+ * Free serialized AST.
+ *
+ * @param ast The serialized AST to free.
+ */
+void ast_free(SerializedAST* ast) {
+    if (ast) {
+        free(ast->data);
+        free(ast->slots);
+        free(ast->links);
+        free(ast);
+    }
+}
+
+/**
+ * Get raw binary data from serialized AST.
+ *
+ * @param ast The serialized AST.
+ * @param size Pointer to store the size of the data.
+ *
+ * @return Pointer to binary data (do not free separately).
+ * @note The caller is responsible for freeing the serialized AST using ast_free().
+ */
+const void* ast_get_data(const SerializedAST* ast, size_t* size) {
+    if (!ast || !ast->is_valid) {
+        if (size)
+            *size = 0;
+        return NULL;
+    }
+
+    if (size)
+        *size = ast->size;
+
+    return ast->data;
+}
+
+/**
+ * Get the number of parameters in a serialized AST.
+ *
+ * @param ast The serialized AST.
+ * @return The highest parameter index plus one.
+ */
+size_t ast_parameter_count(const SerializedAST* ast) {
+    return ast ? ast->parameter_count : 0;
+}
+
+/**
+ * Get the number of bytes a parameter value takes as a serialized literal payload.
+ *
+ * @param value The value.
+ * @return The payload size, or 0 if the value cannot be serialized.
+ */
+static size_t literal_payload_size(const ParameterValue* value) {
+    switch (value->type) {
+        case TOKEN_STRING:
+            // Stored inline: a 0 reference, then the length and the bytes
+            if (value->length > UINT32_MAX - 2 * VARINT_MAX_SIZE)
+                return 0;
+            return 2 + varint_size((uint32_t)value->length) + value->length;
+        case TOKEN_INTEGER:
+        case TOKEN_DECIMAL:
+            return 1 + sizeof(double);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Map an offset in a template to the offset it moves to once the placeholders are bound.
+ *
+ * @param ast The serialized template.
+ * @param growth Total growth of the data up to and including each placeholder.
+ * @param offset The offset in the template.
+ * @return The offset in the bound data.
+ */
+static size_t bound_offset(const SerializedAST* ast, const size_t* growth, size_t offset) {
+    // Count the placeholders that start before the offset
+    size_t low  = 0;
+    size_t high = ast->slot_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (ast->slots[mid].offset < offset)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low > 0 ? offset + growth[low - 1] : offset;
+}
+
+/**
+ * Splice bound values into a copy of a template.
+ *
+ * @param ast The serialized template.
+ * @param values The parameter values.
+ * @param growth Scratch space for one entry per placeholder.
+ * @param reuse A previous result to overwrite (NULL to allocate a new one).
+ * @return The bound AST, or NULL on failure.
+ */
+static SerializedAST* bind_parameters(const SerializedAST* ast, const ParameterValue* values,
+                                      size_t* growth, SerializedAST* reuse) {
+    // Size the output and check that every value fits its slot
+    size_t size = ast->size;
+    for (size_t i = 0; i < ast->slot_count; i++) {
+        const ParameterSlot*  slot  = &ast->slots[i];
+        const ParameterValue* value = &values[slot->index];
+
+        if (slot->kind == SLOT_COUNT) {
+            if (value->type != TOKEN_INTEGER || value->number_value < 0 ||
+                value->number_value > INT32_MAX)
+                return NULL;
+            growth[i] = size - ast->size;
+            continue;
+        }
+
+        size_t payload = literal_payload_size(value);
+        if (payload == 0)
+            return NULL;
+        size      = size - PARAMETER_NODE_SIZE + 1 + sizeof(uint32_t) + payload;
+        growth[i] = size - ast->size;
+        if (size - AST_HEADER_SIZE > UINT32_MAX)
+            return NULL;
+    }
+
+    SerializedAST* result = reuse;
+    if (!result) {
+        result = (SerializedAST*)calloc(1, sizeof(SerializedAST));
+        if (!result)
+            return NULL;
+    }
+
+    char* data = (char*)realloc(result->data, size);
+    if (!data) {
+        if (!reuse)
+            free(result);
+        else
+            result->is_valid = false;
+        return NULL;
+    }
+
+    const char* src = (const char*)ast->data;
+    size_t      in  = 0;
+    size_t      out = 0;
+    for (size_t i = 0; i < ast->slot_count; i++) {
+        const ParameterSlot*  slot  = &ast->slots[i];
+        const ParameterValue* value = &values[slot->index];
+
+        memcpy(data + out, src + in, slot->offset - in);
+        out += slot->offset - in;
+        in = slot->offset;
+
+        if (slot->kind == SLOT_COUNT) {
+            int32_t number = (int32_t)value->number_value;
+            memcpy(data + out, &number, sizeof(int32_t));
+            out += sizeof(int32_t);
+            in += sizeof(int32_t);
+            continue;
+        }
+
+        // Node type, then the placeholder's line number, then the literal
+        data[out] = (char)NODE_LITERAL;
+        memcpy(data + out + 1, src + in + 1, sizeof(uint32_t));
+        out += 1 + sizeof(uint32_t);
+        in += PARAMETER_NODE_SIZE;
+
+        data[out++] = (char)value->type;
+        if (value->type == TOKEN_STRING) {
+            data[out++] = 0;  // Inline string
+            out += encode_varint((unsigned char*)data + out, (uint32_t)value->length);
+            if (value->length > 0)
+                memcpy(data + out, value->string_value, value->length);
+            out += value->length;
+        } else {
+            memcpy(data + out, &value->number_value, sizeof(double));
+            out += sizeof(double);
+        }
+    }
+    memcpy(data + out, src + in, ast->size - in);
+
+    // Child offsets that span a resized placeholder move by its growth
+    for (size_t i = 0; i < ast->link_count; i++) {
+        const ChildLink* link = &ast->links[i];
+        uint32_t         offset;
+
+        memcpy(&offset, src + link->field, sizeof(uint32_t));
+        offset = (uint32_t)(bound_offset(ast, growth, link->node + offset) -
+                            bound_offset(ast, growth, link->node));
+        memcpy(data + bound_offset(ast, growth, link->field), &offset, sizeof(uint32_t));
+    }
+
+    // Fix up the data size, original size and checksum in the header
+    uint32_t data_size = (uint32_t)(size - AST_HEADER_SIZE);
+    uint32_t algorithm;
+    uint32_t checksum;
+    memcpy(&algorithm, data + 8, sizeof(uint32_t));
+    nsql_checksum(algorithm, data + AST_HEADER_SIZE, data_size, &checksum);
+    memcpy(data + 12, &data_size, sizeof(uint32_t));
+    memcpy(data + 16, &data_size, sizeof(uint32_t));
+    memcpy(data + 20, &checksum, sizeof(uint32_t));
+
+    free(result->slots);
+    free(result->links);
+    result->data            = data;
+    result->size            = size;
+    result->checksum        = checksum;
+    result->is_valid        = true;
+    result->slots           = NULL;
+    result->slot_count      = 0;
+    result->parameter_count = 0;
+    result->links           = NULL;
+    result->link_count      = 0;
+    return result;
+}
+
+/**
+ * Bind values to the placeholders of a serialized AST.
+ *
+ * The bytes between placeholders are copied unchanged: each NODE_PARAMETER is replaced by a
+ * NODE_LITERAL (with a string value stored inline rather than in the string table, which is
+ * shared by every binding), and each placeholder count is overwritten in place. Only the header,
+ * the child offsets that span a resized placeholder and the checksum are recomputed.
+ *
+ * @param ast The serialized template.
+ * @param values The parameter values.
+ * @param count Number of entries in values.
+ * @param reuse A previous result to overwrite (NULL to allocate a new one).
+ * @return The bound AST, or NULL on failure.
+ */
+SerializedAST* ast_bind_parameters(const SerializedAST* ast, const ParameterValue* values,
+                                   size_t count, SerializedAST* reuse) {
+    if (!ast || !ast->is_valid || count < ast->parameter_count)
+        return NULL;
+
+    // Compressed data has no placeholder locations to patch
+    uint32_t codec = read_uint32((const char*)ast->data + 24);
+    if (codec != AST_CODEC_NONE)
+        return NULL;
+
+    // Running growth of the data at each placeholder, for fixing up child offsets
+    size_t  local_growth[16];
+    size_t* growth = local_growth;
+    if (ast->slot_count > sizeof(local_growth) / sizeof(local_growth[0])) {
+        growth = (size_t*)malloc(ast->slot_count * sizeof(size_t));
+        if (!growth)
+            return NULL;
+    }
+
+    SerializedAST* result = bind_parameters(ast, values, growth, reuse);
+    if (growth != local_growth)
+        free(growth);
+    return result;
+}
+
+/**
+ * Compress the node data of a serialized AST.
+ *
+ * The header and the metadata block are copied as is, so the metadata can still be read without
+ * decompressing. The checksum covers the stored (compressed) payload, letting ast_deserialize()
+ * reject corrupted data before decompressing it.
+ *
+ * @param ast The serialized AST.
+ * @param codec The codec to compress with.
+ * @return A new SerializedAST handle, or NULL on failure.
+ */
+SerializedAST* ast_compress(const SerializedAST* ast, uint32_t codec) {
+    if (!ast || !ast->is_valid || (codec != AST_CODEC_NONE && codec != AST_CODEC_LZ4))
+        return NULL;
+
+    const char* src       = (const char*)ast->data;
+    uint32_t    version   = read_uint32(src + 4);
+    uint32_t    algorithm = read_uint32(src + 8);
+    uint32_t    data_size = read_uint32(src + 12);
+    if (version == AST_VERSION_1 || read_uint32(src + 24) != AST_CODEC_NONE ||
+        data_size < AST_METADATA_SIZE)
+        return NULL;
+
+    size_t metadata_size = AST_METADATA_SIZE + read_uint16(src + AST_HEADER_SIZE + 12);
+    if (metadata_size > data_size)
+        return NULL;
+    size_t prefix     = AST_HEADER_SIZE + metadata_size;
+    size_t nodes_size = data_size - metadata_size;
+
+    // Compressed data is only kept if it is smaller, so the input size is enough
+    char* data = (char*)malloc(ast->size);
+    if (!data)
+        return NULL;
+    memcpy(data, src, prefix);
+
+    size_t stored = 0;
+    if (codec == AST_CODEC_LZ4 && nodes_size >= AST_COMPRESS_THRESHOLD)
+        stored = nsql_lz4_compress(src + prefix, nodes_size, data + prefix, nodes_size - 1);
+    if (stored == 0) {
+        codec  = AST_CODEC_NONE;
+        stored = nodes_size;
+        memcpy(data + prefix, src + prefix, nodes_size);
+    }
+
+    SerializedAST* result = (SerializedAST*)calloc(1, sizeof(SerializedAST));
+    if (!result) {
+        free(data);
+        return NULL;
+    }
+
+    // Fix up the data size, checksum and codec in the header; the original size stays
+    uint32_t stored_size = (uint32_t)(metadata_size + stored);
+    uint32_t checksum;
+    nsql_checksum(algorithm, data + AST_HEADER_SIZE, stored_size, &checksum);
+    memcpy(data + 12, &stored_size, sizeof(uint32_t));
+    memcpy(data + 20, &checksum, sizeof(uint32_t));
+    memcpy(data + 24, &codec, sizeof(uint32_t));
+
+    result->data     = data;
+    result->size     = AST_HEADER_SIZE + stored_size;
+    result->checksum = checksum;
+    result->is_valid = true;
+    return result;
+}
+
+/**
+ * Decompress the payload of verified, compressed data.
+ *
+ * @param data The serialized data.
+ * @param data_size The stored payload size from the header.
+ * @param original_size The uncompressed payload size from the header.
+ * @return The uncompressed data with its header rewritten to match (AST_HEADER_SIZE +
+ *         original_size bytes), or NULL if the data is malformed.
+ */
+static char* decompress_data(const char* data, uint32_t data_size, uint32_t original_size) {
+    if (data_size < AST_METADATA_SIZE)
+        return NULL;
+    size_t metadata_size = AST_METADATA_SIZE + read_uint16(data + AST_HEADER_SIZE + 12);
+    if (metadata_size > data_size || metadata_size > original_size)
+        return NULL;
+
+    // An LZ4 byte expands to at most 255 bytes, which bounds the allocation for hostile headers
+    size_t stored = data_size - metadata_size;
+    size_t nodes  = original_size - metadata_size;
+    if (nodes / 255 > stored)
+        return NULL;
+
+    size_t prefix  = AST_HEADER_SIZE + metadata_size;
+    char*  inflate = (char*)malloc(AST_HEADER_SIZE + (size_t)original_size);
+    if (!inflate)
+        return NULL;
+    memcpy(inflate, data, prefix);
+    if (!nsql_lz4_decompress(data + prefix, stored, inflate + prefix, nodes)) {
+        free(inflate);
+        return NULL;
+    }
+
+    uint32_t algorithm = read_uint32(data + 8);
+    uint32_t codec     = AST_CODEC_NONE;
+    uint32_t checksum;
+    nsql_checksum(algorithm, inflate + AST_HEADER_SIZE, original_size, &checksum);
+    memcpy(inflate + 12, &original_size, sizeof(uint32_t));
+    memcpy(inflate + 20, &checksum, sizeof(uint32_t));
+    memcpy(inflate + 24, &codec, sizeof(uint32_t));
+    return inflate;
+}
+
+/**
+ * Deserialize AST from binary data.
+ *
+ * @param data Binary serialized AST data.
+ * @param size Size of the data.
+ * @return SerializedAST handle or NULL if invalid.
+ */
+SerializedAST* ast_deserialize(const void* data, size_t size) {
+    if (!data || size < AST_HEADER_SIZE)
+        return NULL;
+
+    const char* char_data = (const char*)data;
+
+    // Parse header (all fields are uint32_t, 4 bytes each)
+    uint32_t magic           = read_uint32(char_data + 0);
+    uint32_t version         = read_uint32(char_data + 4);
+    uint32_t algorithm       = read_uint32(char_data + 8);
+    uint32_t data_size       = read_uint32(char_data + 12);
+    uint32_t original_size   = read_uint32(char_data + 16);
+    uint32_t stored_checksum = read_uint32(char_data + 20);
+    uint32_t codec           = read_uint32(char_data + 24);
+
+    if (magic != AST_MAGIC_NUMBER) {
+        return NULL;  // Invalid magic number
+    }
+
+    if (version > AST_VERSION) {
+        return NULL;  // Incompatible version
+    }
+
+    // Check if data size matches
+    if (size != AST_HEADER_SIZE + data_size) {
+        return NULL;  // Size mismatch
+    }
+
+    // Version 1 node data is never compressed
+    if (codec == AST_CODEC_NONE ? original_size != data_size
+                                : codec != AST_CODEC_LZ4 || version == AST_VERSION_1) {
+        return NULL;  // Unknown codec or inconsistent sizes
+    }
+
+    // Get data pointer
+    const char* ast_data = char_data + AST_HEADER_SIZE;
+
+    // Compute checksum, an unknown algorithm leaves the AST invalid
+    uint32_t computed_checksum = 0;
+    bool     known             = nsql_checksum(algorithm, ast_data, data_size, &computed_checksum);
+
+    // Create serialized AST
+    SerializedAST* ast = (SerializedAST*)malloc(sizeof(SerializedAST));
+    if (!ast)
+        return NULL;
+
+    bool is_valid = known && computed_checksum == stored_checksum;
+
+    // Make a copy of the data, decompressing it once its checksum has been verified
+    if (is_valid && codec != AST_CODEC_NONE) {
+        ast->data = decompress_data(char_data, data_size, original_size);
+        if (!ast->data) {
+            free(ast);
+            return NULL;
+        }
+        size              = AST_HEADER_SIZE + (size_t)original_size;
+        computed_checksum = read_uint32((char*)ast->data + 20);
+    } else {
+        ast->data = malloc(size);
+        if (!ast->data) {
+            free(ast);
+            return NULL;
+        }
+        memcpy(ast->data, data, size);
+    }
+
+    ast->size            = size;
+    ast->checksum        = computed_checksum;
+    ast->is_valid        = is_valid;
+    ast->slots           = NULL;
+    ast->slot_count      = 0;
+    ast->parameter_count = 0;
+    ast->links           = NULL;
+    ast->link_count      = 0;
+
+    return ast;
+}
+
+bool ast_verify_checksum(const SerializedAST* ast) {
+    if (!ast || !ast->data || ast->size < AST_HEADER_SIZE)
+        return false;
+
+    const char* char_data       = (const char*)ast->data;
+    uint32_t    stored_checksum = read_uint32(char_data + 20);
+    const char* ast_data        = char_data + AST_HEADER_SIZE;
+    uint32_t    algorithm       = read_uint32(char_data + 8);
+    uint32_t    data_size       = read_uint32(char_data + 12);
+
+    uint32_t computed_checksum;
+    if (!nsql_checksum(algorithm, ast_data, data_size, &computed_checksum))
+        return false;
+
+    return computed_checksum == stored_checksum;
+}
+
+/**
+ * Extract execution metadata from version 1 data, where it follows the nodes.
+ *
+ * The metadata ends in a length-prefixed string, so it cannot be read backwards from the end of
+ * the data; the reader walks the nodes to find where it starts.
+ *
+ * @param ast The serialized AST.
+ * @param metadata Pointer to store extracted metadata.
+ * @return true if successful, false otherwise.
+ */
+static bool extract_metadata_v1(const SerializedAST* ast, ExecutionMetadata* metadata) {
+    AstReader reader;
+    if (!ast_reader_init(&reader, ast->data, ast->size, false))
+        return false;
+
+    size_t str_len;
+    ast_reader_metadata(&reader, metadata, &str_len);
+
+    // Allocate and copy string (may be NULL)
+    char* target_index = NULL;
+    if (str_len > 0) {
+        target_index = (char*)malloc(str_len + 1);
+        if (!target_index)
+            return false;
+        memcpy(target_index, metadata->target_index, str_len);
+        target_index[str_len] = '\0';
+    }
+    metadata->target_index = target_index;
+
+    return true;
+}
+
+bool ast_extract_metadata(const SerializedAST* ast, ExecutionMetadata* metadata) {
+    if (!ast || !metadata || !ast->is_valid) {
+        return false;  // Invalid AST or metadata pointer
+    }
+
+    const char* char_data = (const char*)ast->data;
+    const char* ast_data  = char_data + AST_HEADER_SIZE;
+    uint32_t    version   = read_uint32(char_data + 4);
+    uint32_t    data_size = read_uint32(char_data + 12);
+
+    if (version == AST_VERSION_1)
+        return extract_metadata_v1(ast, metadata);
+
+    // The metadata block is at the start of the data
+    if (data_size < AST_METADATA_SIZE) {
+        return false;
+    }
+    uint16_t str_len = read_uint16(ast_data + 12);
+    if (AST_METADATA_SIZE + (uint32_t)str_len > data_size) {
+        return false;
+    }
+
+    // Allocate and copy string (may be NULL)
+    char* target_index = NULL;
+    if (str_len > 0) {
+        target_index = (char*)malloc(str_len + 1);
+        if (!target_index)
+            return false;
+        memcpy(target_index, ast_data + AST_METADATA_SIZE, str_len);
+        target_index[str_len] = '\0';
+    }
+
+    metadata->hint_flags     = read_uint16(ast_data + 0);
+    metadata->priority       = *((uint8_t*)(ast_data + 2));
+    metadata->engine_type    = *((uint8_t*)(ast_data + 3));
+    metadata->estimated_rows = read_uint32(ast_data + 4);
+    metadata->timeout_ms     = read_uint32(ast_data + 8);
+    metadata->target_index   = target_index;
+
+    return true;
+}
+
+/**
+ * Determine if a query should use NoSQL storage engine.
+ *
+ * @param node The AST node.
+ * @return true if query should use NoSQL, false if SQL.
+ */
+bool ast_is_nosql_query(const Node* node) {
+    // TODO: Revisit this logic
+    if (!node)
+        return false;
+
+    switch (node->type) {
+        case NODE_FIND_QUERY:
+            // FIND queries are always NoSQL
+            return true;
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            // SHOW/GET queries are NoSQL if they use NoSQL types or sources
+            // For now, treat as NoSQL if the source or fields are not SQL-like
+            return true;
+        case NODE_TELL_QUERY:
+            // TELL is SQL unless the action is ADD/REMOVE/UPDATE on a NoSQL table
+            // For now, treat as SQL
+            return false;
+        case NODE_ASK_QUERY:
+            // ASK is SQL unless the source or fields are NoSQL types
+            // For now, treat as SQL
+            return false;
+        default:
+            return false;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,301 @@
+/**
+ * @file ast_visitor.c
+ * @brief Iterative depth-first traversal of ASTs
+ */
+
+#include <nsql/ast_visitor.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pending nodes kept on the C stack before the walk moves to the heap
+#define INLINE_FRAMES 32
+
+// A node waiting on the walk stack
+typedef struct {
+    AstVisitFrame frame;    // The node and where it is
+    bool          entered;  // Has the pre callback run (so the children are above it)?
+} PendingNode;
+
+// Walk stack
+typedef struct {
+    PendingNode* items;     // Pending nodes, the next one last
+    size_t       count;     // Number of pending nodes
+    size_t       capacity;  // Allocated entries
+} VisitStack;
+
+/**
+ * Get the number of child slots of a node.
+ *
+ * @param node The node.
+ * @return Number of slots (0 for leaves).
+ */
+static int child_count(const Node* node) {
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            return 6;
+
+        case NODE_FIND_QUERY:
+            return 5;
+
+        case NODE_TELL_QUERY:
+            return 3;
+
+        case NODE_SOURCE:
+        case NODE_JOIN:
+        case NODE_GROUP_BY:
+        case NODE_ADD_ACTION:
+        case NODE_BINARY_EXPR:
+            return 2;
+
+        case NODE_REMOVE_ACTION:
+        case NODE_UNARY_EXPR:
+        case NODE_CONSTRAINT:
+            return 1;
+
+        case NODE_FIELD_LIST:
+            return node->as.field_list.count;
+
+        case NODE_ORDER_BY:
+            return node->as.order_by.count;
+
+        case NODE_UPDATE_ACTION:
+            // Each field is followed by its value
+            return 2 * node->as.update_action.count;
+
+        case NODE_CREATE_ACTION:
+            return node->as.create_action.count;
+
+        case NODE_FIELD_DEF:
+            // The name comes before the constraints
+            return 1 + node->as.field_def.constraint_count;
+
+        case NODE_FUNCTION_CALL:
+            return node->as.function_call.arg_count;
+
+        case NODE_PROGRAM:
+            return node->as.program.count;
+
+        case NODE_LOGICAL_EXPR:
+            return node->as.logical_expr.count;
+
+        case NODE_IN_LIST:
+            // The value comes before the items
+            return 1 + node->as.in_list.count;
+
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Get the location of a child slot.
+ *
+ * @param node The node.
+ * @param slot The slot, below child_count(node).
+ * @return Location of the child pointer (which may be NULL).
+ */
+static Node** child_slot(Node* node, int slot) {
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY: {
+            Node** slots[] = {&node->as.ask_query.source,   &node->as.ask_query.fields,
+                              &node->as.ask_query.condition, &node->as.ask_query.group_by,
+                              &node->as.ask_query.order_by,  &node->as.ask_query.limit};
+            return slots[slot];
+        }
+
+        case NODE_TELL_QUERY: {
+            Node** slots[] = {&node->as.tell_query.source, &node->as.tell_query.action,
+                              &node->as.tell_query.condition};
+            return slots[slot];
+        }
+
+        case NODE_FIND_QUERY: {
+            Node** slots[] = {&node->as.find_query.source, &node->as.find_query.condition,
+                              &node->as.find_query.group_by, &node->as.find_query.order_by,
+                              &node->as.find_query.limit};
+            return slots[slot];
+        }
+
+        case NODE_FIELD_LIST:
+            return &node->as.field_list.fields[slot];
+
+        case NODE_SOURCE:
+            return slot == 0 ? &node->as.source.identifier : &node->as.source.join;
+
+        case NODE_JOIN:
+            return slot == 0 ? &node->as.join.source : &node->as.join.condition;
+
+        case NODE_GROUP_BY:
+            return slot == 0 ? &node->as.group_by.fields : &node->as.group_by.having;
+
+        case NODE_ORDER_BY:
+            return &node->as.order_by.fields[slot];
+
+        case NODE_ADD_ACTION:
+            return slot == 0 ? &node->as.add_action.value : &node->as.add_action.record_spec;
+
+        case NODE_REMOVE_ACTION:
+            return &node->as.remove_action.condition;
+
+        case NODE_UPDATE_ACTION:
+            return slot % 2 == 0 ? &node->as.update_action.fields[slot / 2]
+                                 : &node->as.update_action.values[slot / 2];
+
+        case NODE_CREATE_ACTION:
+            return &node->as.create_action.field_defs[slot];
+
+        case NODE_BINARY_EXPR:
+            return slot == 0 ? &node->as.binary_expr.left : &node->as.binary_expr.right;
+
+        case NODE_UNARY_EXPR:
+            return &node->as.unary_expr.operand;
+
+        case NODE_FIELD_DEF:
+            return slot == 0 ? &node->as.field_def.name : &node->as.field_def.constraints[slot - 1];
+
+        case NODE_CONSTRAINT:
+            return &node->as.constraint.default_value;
+
+        case NODE_FUNCTION_CALL:
+            return &node->as.function_call.args[slot];
+
+        case NODE_PROGRAM:
+            return &node->as.program.statements[slot];
+
+        case NODE_LOGICAL_EXPR:
+            return &node->as.logical_expr.operands[slot];
+
+        case NODE_IN_LIST:
+            return slot == 0 ? &node->as.in_list.value : &node->as.in_list.items[slot - 1];
+
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * Make room for more pending nodes.
+ *
+ * @param stack The stack.
+ * @param inline_items The initial, stack-allocated array of the walk.
+ * @param count Number of nodes about to be pushed.
+ */
+static void reserve_nodes(VisitStack* stack, PendingNode* inline_items, size_t count) {
+    if (stack->count + count <= stack->capacity)
+        return;
+
+    size_t capacity = stack->capacity * 2;
+    while (capacity < stack->count + count) {
+        capacity *= 2;
+    }
+
+    // The initial array is on the C stack, so it is copied rather than reallocated
+    bool         moved = stack->items == inline_items;
+    size_t       size  = capacity * sizeof(PendingNode);
+    PendingNode* items =
+        moved ? (PendingNode*)malloc(size) : (PendingNode*)realloc(stack->items, size);
+    if (items == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    if (moved)
+        memcpy(items, inline_items, stack->count * sizeof(PendingNode));
+
+    stack->items    = items;
+    stack->capacity = capacity;
+}
+
+/**
+ * Push the children of a node, last slot first so that the first slot is visited next.
+ *
+ * @param stack The stack.
+ * @param inline_items The initial, stack-allocated array of the walk.
+ * @param parent Frame of the node.
+ * @param visit_null Push empty slots too.
+ */
+static void push_children(VisitStack* stack, PendingNode* inline_items,
+                          const AstVisitFrame* parent, bool visit_null) {
+    int count = child_count(parent->node);
+    reserve_nodes(stack, inline_items, (size_t)count);
+
+    for (int slot = count - 1; slot >= 0; slot--) {
+        Node* child = *child_slot(parent->node, slot);
+        if (child == NULL && !visit_null)
+            continue;
+
+        PendingNode* pending  = &stack->items[stack->count++];
+        pending->frame.node   = child;
+        pending->frame.parent = parent->node;
+        pending->frame.slot   = slot;
+        pending->frame.depth  = parent->depth + 1;
+        pending->entered      = false;
+    }
+}
+
+/**
+ * Walk a tree depth-first.
+ *
+ * @param root Root of the tree.
+ * @param visitor The callbacks.
+ * @return false if a callback returned AST_VISIT_STOP, true otherwise.
+ */
+bool ast_visit(Node* root, const AstVisitor* visitor) {
+    if (root == NULL && !visitor->visit_null)
+        return true;
+
+    PendingNode inline_items[INLINE_FRAMES];
+    VisitStack  stack     = {inline_items, 0, INLINE_FRAMES};
+    bool        completed = true;
+
+    PendingNode* pending  = &stack.items[stack.count++];
+    pending->frame.node   = root;
+    pending->frame.parent = NULL;
+    pending->frame.slot   = 0;
+    pending->frame.depth  = 0;
+    pending->entered      = false;
+
+    while (stack.count > 0) {
+        pending = &stack.items[stack.count - 1];
+
+        if (!pending->entered) {
+            pending->entered = true;
+
+            AstVisitAction action = AST_VISIT_CONTINUE;
+            if (visitor->pre)
+                action = visitor->pre(&pending->frame, visitor->user_data);
+            if (action == AST_VISIT_STOP) {
+                completed = false;
+                break;
+            }
+
+            // Pushing may move the stack, so the children get a copy of the frame
+            size_t count = stack.count;
+            if (action == AST_VISIT_CONTINUE && pending->frame.node != NULL) {
+                AstVisitFrame parent = pending->frame;
+                push_children(&stack, inline_items, &parent, visitor->visit_null);
+            }
+            if (stack.count > count)
+                continue;
+
+            // Without children to visit, the post callback follows right away
+            pending = &stack.items[count - 1];
+        }
+
+        // The children are done
+        AstVisitFrame frame = pending->frame;
+        stack.count--;
+        if (visitor->post && visitor->post(&frame, visitor->user_data) == AST_VISIT_STOP) {
+            completed = false;
+            break;
+        }
+    }
+
+    if (stack.items != inline_items)
+        free(stack.items);
+    return completed;
+}
@@ -0,0 +1,231 @@
+/**
+ * @file checksum.c
+ * @brief Checksums for serialized data
+ */
+
+#include "checksum.h"
+
+#include <nsql/ast_serializer.h>
+#include <string.h>
+
+#include "checksum_tables.h"
+#include "stats.h"
+
+// SSE4.2 kernels are compiled with a target attribute and selected at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CHECKSUM_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#define CHECKSUM_ARM 1
+#include <arm_acle.h>
+#endif
+
+// Slicing reads the data a word at a time, which matches the tables on little-endian hosts only
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define CHECKSUM_BIG_ENDIAN 1
+#endif
+
+// =======================================================
+// Software kernels
+// =======================================================
+
+/**
+ * Update a reflected CRC with slicing-by-8.
+ *
+ * @param table The slicing tables of the polynomial.
+ * @param crc The running CRC.
+ * @param p The data.
+ * @param length The length of the data in bytes.
+ * @return The updated CRC.
+ */
+static uint32_t crc_slice8(const uint32_t table[8][256], uint32_t crc, const unsigned char* p,
+                           size_t length) {
+#ifndef CHECKSUM_BIG_ENDIAN
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        word ^= crc;
+
+        crc = table[7][word & 0xFF] ^ table[6][(word >> 8) & 0xFF] ^
+              table[5][(word >> 16) & 0xFF] ^ table[4][(word >> 24) & 0xFF] ^
+              table[3][(word >> 32) & 0xFF] ^ table[2][(word >> 40) & 0xFF] ^
+              table[1][(word >> 48) & 0xFF] ^ table[0][word >> 56];
+        p += 8;
+        length -= 8;
+    }
+#endif
+
+    while (length--) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// =======================================================
+// SSE4.2 kernels (CRC32C only, the instruction uses the Castagnoli polynomial)
+// =======================================================
+
+#ifdef CHECKSUM_SSE42
+
+/**
+ * Update a CRC32C with the SSE4.2 crc32 instruction.
+ *
+ * @param crc The running CRC.
+ * @param p The data.
+ * @param length The length of the data in bytes.
+ * @return The updated CRC.
+ */
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse42(uint32_t crc, const unsigned char* p,
+                                                               size_t length) {
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        length -= 8;
+    }
+    crc = (uint32_t)crc64;
+#endif
+
+    while (length >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = _mm_crc32_u32(crc, word);
+        p += 4;
+        length -= 4;
+    }
+    while (length--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+
+/**
+ * Check whether the running CPU supports SSE4.2.
+ */
+static inline bool cpu_has_sse42(void) {
+    return __builtin_cpu_supports("sse4.2");
+}
+
+#endif /* CHECKSUM_SSE42 */
+
+// =======================================================
+// ARMv8 kernels (both polynomials have an instruction)
+// =======================================================
+
+#ifdef CHECKSUM_ARM
+
+/**
+ * Update a CRC32 with the ARMv8 crc32 instructions.
+ *
+ * @param crc The running CRC.
+ * @param p The data.
+ * @param length The length of the data in bytes.
+ * @return The updated CRC.
+ */
+static uint32_t crc32_arm(uint32_t crc, const unsigned char* p, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32d(crc, word);
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = __crc32b(crc, *p++);
+    }
+    return crc;
+}
+
+/**
+ * Update a CRC32C with the ARMv8 crc32c instructions.
+ *
+ * @param crc The running CRC.
+ * @param p The data.
+ * @param length The length of the data in bytes.
+ * @return The updated CRC.
+ */
+static uint32_t crc32c_arm(uint32_t crc, const unsigned char* p, size_t length) {
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        crc = __crc32cd(crc, word);
+        p += 8;
+        length -= 8;
+    }
+    while (length--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+#endif /* CHECKSUM_ARM */
+
+// =======================================================
+// Public entry points
+// =======================================================
+
+/**
+ * Calculate CRC32 checksum for the given data.
+ *
+ * @param data The data to calculate the checksum for.
+ * @param length The length of the data in bytes.
+ * @return The calculated checksum.
+ */
+uint32_t nsql_crc32(const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+#if defined(CHECKSUM_ARM)
+    return crc32_arm(0xFFFFFFFFU, p, length) ^ 0xFFFFFFFFU;
+#else
+    return crc_slice8(crc32_tables, 0xFFFFFFFFU, p, length) ^ 0xFFFFFFFFU;
+#endif
+}
+
+/**
+ * Calculate CRC32C checksum for the given data.
+ *
+ * @param data The data to calculate the checksum for.
+ * @param length The length of the data in bytes.
+ * @return The calculated checksum.
+ */
+uint32_t nsql_crc32c(const void* data, size_t length) {
+    const unsigned char* p = (const unsigned char*)data;
+#if defined(CHECKSUM_SSE42)
+    if (cpu_has_sse42())
+        return crc32c_sse42(0xFFFFFFFFU, p, length) ^ 0xFFFFFFFFU;
+#endif
+#if defined(CHECKSUM_ARM)
+    return crc32c_arm(0xFFFFFFFFU, p, length) ^ 0xFFFFFFFFU;
+#else
+    return crc_slice8(crc32c_tables, 0xFFFFFFFFU, p, length) ^ 0xFFFFFFFFU;
+#endif
+}
+
+/**
+ * Calculate a checksum with the algorithm recorded in a serialized AST header.
+ *
+ * @param algorithm The checksum algorithm.
+ * @param data The data to calculate the checksum for.
+ * @param length The length of the data in bytes.
+ * @param checksum Receives the checksum.
+ * @return false if the algorithm is unknown.
+ */
+bool nsql_checksum(uint32_t algorithm, const void* data, size_t length, uint32_t* checksum) {
+    NSQL_STAT_CLOCK(start);
+    switch (algorithm) {
+        case AST_CHECKSUM_CRC32:
+            *checksum = nsql_crc32(data, length);
+            break;
+        case AST_CHECKSUM_CRC32C:
+            *checksum = nsql_crc32c(data, length);
+            break;
+        default:
+            return false;
+    }
+    NSQL_STAT_ELAPSED(NSQL_STAGE_CHECKSUM, start);
+    return true;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file checksum.h
+ * @brief Checksums for serialized data (internal)
+ */
+
+#ifndef NSQL_CHECKSUM_H
+#define NSQL_CHECKSUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Calculate the CRC32 (IEEE 802.3) checksum of a buffer
+ *
+ * @param data The data to checksum
+ * @param length The length of the data in bytes
+ * @return The checksum
+ */
+uint32_t nsql_crc32(const void* data, size_t length);
+
+/**
+ * Calculate the CRC32C (Castagnoli) checksum of a buffer
+ *
+ * Uses the SSE4.2 or ARMv8 CRC32 instructions when the CPU has them.
+ *
+ * @param data The data to checksum
+ * @param length The length of the data in bytes
+ * @return The checksum
+ */
+uint32_t nsql_crc32c(const void* data, size_t length);
+
+/**
+ * Calculate a checksum with the algorithm recorded in a serialized AST header
+ *
+ * @param algorithm AST_CHECKSUM_CRC32 or AST_CHECKSUM_CRC32C
+ * @param data The data to checksum
+ * @param length The length of the data in bytes
+ * @param checksum Receives the checksum
+ * @return false if the algorithm is unknown
+ */
+bool nsql_checksum(uint32_t algorithm, const void* data, size_t length, uint32_t* checksum);
+
+#endif /* NSQL_CHECKSUM_H */
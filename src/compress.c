@@ -0,0 +1,240 @@
+/**
+ * @file compress.c
+ * @brief LZ4 block compression for serialized data
+ *
+ * A block is a series of sequences, each a token byte (literal length in the high nibble, match
+ * length minus 4 in the low nibble), extra length bytes for nibbles of 15, the literals, then a
+ * 16-bit little-endian match offset and extra match length bytes. The last sequence has literals
+ * only. The compressor is the greedy single-probe variant, which is enough for the repeated
+ * identifiers and node headers that make up most of a serialized AST.
+ */
+
+#include "compress.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Format limits
+#define LZ4_MIN_MATCH 4        // Shortest match
+#define LZ4_LAST_LITERALS 5    // The last 5 bytes are always literals
+#define LZ4_MATCH_LIMIT 12     // No match starts in the last 12 bytes
+#define LZ4_MAX_OFFSET 65535   // Farthest match
+#define LZ4_NIBBLE_MAX 15      // Length nibble value that is followed by extra length bytes
+
+// Hash table of recent positions, indexed by a hash of the next 4 bytes
+#define LZ4_HASH_BITS 12
+
+/**
+ * Hash the 4 bytes at a position.
+ *
+ * @param p The position.
+ * @return The hash table index.
+ */
+static inline uint32_t hash4(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return (value * 2654435761U) >> (32 - LZ4_HASH_BITS);
+}
+
+/**
+ * Write the extra bytes of a length whose nibble is LZ4_NIBBLE_MAX.
+ *
+ * @param op The output position, advanced past the bytes.
+ * @param oend The end of the output.
+ * @param length The length minus LZ4_NIBBLE_MAX.
+ * @return false if the output is full.
+ */
+static bool write_length(unsigned char** op, const unsigned char* oend, size_t length) {
+    size_t count = length / 255 + 1;
+    if ((size_t)(oend - *op) < count)
+        return false;
+
+    memset(*op, 255, count - 1);
+    *op += count - 1;
+    *(*op)++ = (unsigned char)(length % 255);
+    return true;
+}
+
+/**
+ * Write a sequence.
+ *
+ * @param op The output position, advanced past the sequence.
+ * @param oend The end of the output.
+ * @param literals The literals.
+ * @param literal_length The number of literals.
+ * @param offset The match offset.
+ * @param match_length The match length, or 0 for the last sequence.
+ * @return false if the output is full.
+ */
+static bool write_sequence(unsigned char** op, const unsigned char* oend,
+                           const unsigned char* literals, size_t literal_length, size_t offset,
+                           size_t match_length) {
+    if (*op >= oend)
+        return false;
+    unsigned char* token = (*op)++;
+
+    if (literal_length >= LZ4_NIBBLE_MAX) {
+        *token = LZ4_NIBBLE_MAX << 4;
+        if (!write_length(op, oend, literal_length - LZ4_NIBBLE_MAX))
+            return false;
+    } else {
+        *token = (unsigned char)(literal_length << 4);
+    }
+
+    if ((size_t)(oend - *op) < literal_length)
+        return false;
+    memcpy(*op, literals, literal_length);
+    *op += literal_length;
+
+    if (match_length == 0)
+        return true;
+
+    if (oend - *op < 2)
+        return false;
+    *(*op)++ = (unsigned char)(offset & 0xFF);
+    *(*op)++ = (unsigned char)(offset >> 8);
+
+    size_t extra = match_length - LZ4_MIN_MATCH;
+    if (extra >= LZ4_NIBBLE_MAX) {
+        *token |= LZ4_NIBBLE_MAX;
+        return write_length(op, oend, extra - LZ4_NIBBLE_MAX);
+    }
+    *token |= (unsigned char)extra;
+    return true;
+}
+
+/**
+ * Compress a buffer into the LZ4 block format.
+ *
+ * @param src The data to compress.
+ * @param size The size of the data in bytes.
+ * @param dst Receives the compressed data.
+ * @param capacity The size of dst in bytes.
+ * @return The compressed size, or 0 if it does not fit in capacity.
+ */
+size_t nsql_lz4_compress(const void* src, size_t size, void* dst, size_t capacity) {
+    const unsigned char* base   = (const unsigned char*)src;
+    const unsigned char* ip     = base;
+    const unsigned char* iend   = base + size;
+    const unsigned char* anchor = base;
+    unsigned char*       op     = (unsigned char*)dst;
+    const unsigned char* oend   = op + capacity;
+
+    if (size > LZ4_MATCH_LIMIT) {
+        const unsigned char* match_start_limit = iend - LZ4_MATCH_LIMIT;
+        const unsigned char* match_end_limit   = iend - LZ4_LAST_LITERALS;
+        uint32_t             table[1 << LZ4_HASH_BITS];
+        memset(table, 0, sizeof(table));
+
+        while (ip < match_start_limit) {
+            uint32_t             hash = hash4(ip);
+            const unsigned char* ref  = base + table[hash];
+            table[hash]               = (uint32_t)(ip - base);
+
+            if (ref >= ip || ip - ref > LZ4_MAX_OFFSET || memcmp(ref, ip, LZ4_MIN_MATCH) != 0) {
+                ip++;
+                continue;
+            }
+
+            // Extend the match forwards, then backwards over pending literals
+            const unsigned char* end = ip + LZ4_MIN_MATCH;
+            const unsigned char* r   = ref + LZ4_MIN_MATCH;
+            while (end < match_end_limit && *end == *r) {
+                end++;
+                r++;
+            }
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            if (!write_sequence(&op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref),
+                                (size_t)(end - ip)))
+                return 0;
+            ip = anchor = end;
+        }
+    }
+
+    if (!write_sequence(&op, oend, anchor, (size_t)(iend - anchor), 0, 0))
+        return 0;
+    return (size_t)(op - (unsigned char*)dst);
+}
+
+/**
+ * Read the extra bytes of a length whose nibble is LZ4_NIBBLE_MAX.
+ *
+ * @param ip The input position, advanced past the bytes.
+ * @param iend The end of the input.
+ * @param length The length, incremented by the extra bytes.
+ * @return false if the input ends first.
+ */
+static bool read_length(const unsigned char** ip, const unsigned char* iend, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*ip >= iend)
+            return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+/**
+ * Decompress an LZ4 block.
+ *
+ * @param src The compressed data.
+ * @param size The size of the compressed data in bytes.
+ * @param dst Receives the decompressed data.
+ * @param original_size The exact size of the decompressed data in bytes.
+ * @return false if the block is malformed or does not decompress to original_size bytes.
+ */
+bool nsql_lz4_decompress(const void* src, size_t size, void* dst, size_t original_size) {
+    const unsigned char* ip     = (const unsigned char*)src;
+    const unsigned char* iend   = ip + size;
+    unsigned char*       ostart = (unsigned char*)dst;
+    unsigned char*       op     = ostart;
+    unsigned char*       oend   = ostart + original_size;
+
+    for (;;) {
+        if (ip >= iend)
+            return false;
+        unsigned int token = *ip++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == LZ4_NIBBLE_MAX && !read_length(&ip, iend, &literal_length))
+            return false;
+        if ((size_t)(iend - ip) < literal_length || (size_t)(oend - op) < literal_length)
+            return false;
+        memcpy(op, ip, literal_length);
+        op += literal_length;
+        ip += literal_length;
+
+        // Only the last sequence ends the input after its literals
+        if (ip == iend)
+            return op == oend;
+
+        if (iend - ip < 2)
+            return false;
+        size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - ostart))
+            return false;
+
+        size_t match_length = token & LZ4_NIBBLE_MAX;
+        if (match_length == LZ4_NIBBLE_MAX && !read_length(&ip, iend, &match_length))
+            return false;
+        match_length += LZ4_MIN_MATCH;
+        if ((size_t)(oend - op) < match_length)
+            return false;
+
+        // Matches closer than their length overlap their own output and are copied bytewise
+        const unsigned char* match = op - offset;
+        if (offset >= match_length) {
+            memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            while (match_length--)
+                *op++ = *match++;
+        }
+    }
+}
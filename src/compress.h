@@ -0,0 +1,36 @@
+/**
+ * @file compress.h
+ * @brief LZ4 block compression for serialized data (internal)
+ */
+
+#ifndef NSQL_COMPRESS_H
+#define NSQL_COMPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Compress a buffer into the LZ4 block format
+ *
+ * @param src The data to compress
+ * @param size The size of the data in bytes
+ * @param dst Receives the compressed data
+ * @param capacity The size of dst in bytes
+ * @return The compressed size, or 0 if it does not fit in capacity
+ */
+size_t nsql_lz4_compress(const void* src, size_t size, void* dst, size_t capacity);
+
+/**
+ * Decompress an LZ4 block
+ *
+ * Every read and write is bounds checked, so the input may be hostile.
+ *
+ * @param src The compressed data
+ * @param size The size of the compressed data in bytes
+ * @param dst Receives the decompressed data
+ * @param original_size The exact size of the decompressed data in bytes
+ * @return false if the block is malformed or does not decompress to original_size bytes
+ */
+bool nsql_lz4_decompress(const void* src, size_t size, void* dst, size_t original_size);
+
+#endif /* NSQL_COMPRESS_H */
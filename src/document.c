@@ -0,0 +1,375 @@
+/**
+ * @file document.c
+ * @brief Incremental re-parsing of an edited script
+ */
+
+#include <nsql/ast_visitor.h>
+#include <nsql/document.h>
+#include <nsql/lexer.h>
+#include <nsql/parser.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param ptr Existing allocation to resize (NULL to allocate).
+ * @param size The new size in bytes.
+ * @return Pointer to the allocation.
+ */
+static void* checked_realloc(void* ptr, size_t size) {
+    void* result = realloc(ptr, size);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Get the column of an offset in a text.
+ *
+ * @param text The text.
+ * @param offset The offset.
+ * @return The number of characters between the start of the line and offset.
+ */
+static int column_of(const char* text, size_t offset) {
+    size_t line_start = offset;
+    while (line_start > 0 && text[line_start - 1] != '\n') line_start--;
+    return (int)(offset - line_start);
+}
+
+/**
+ * Copy error reports into a new context, moving their positions.
+ *
+ * @param from The reports to copy.
+ * @param first_line Line whose reports also move by column_delta.
+ * @param line_delta Lines to add to every report.
+ * @param column_delta Columns to add to the reports on first_line.
+ * @return The new context, or NULL if from holds no reports.
+ */
+static ErrorContext* move_errors(const ErrorContext* from, int first_line, int line_delta,
+                                 int column_delta) {
+    const ErrorReport* report = error_context_next(from, NULL);
+    if (report == NULL)
+        return NULL;
+
+    ErrorContext* errors = (ErrorContext*)checked_realloc(NULL, sizeof(ErrorContext));
+    error_context_init(errors);
+
+    for (; report; report = error_context_next(from, report)) {
+        int line   = report->line + line_delta;
+        int column = report->line == first_line ? report->column + column_delta : report->column;
+        if (report->owns_message)
+            report_error(errors, report->severity, report->source, line, column, report->message);
+        else
+            report_error_static(errors, report->severity, report->source, line, column,
+                                report->message);
+    }
+    return errors;
+}
+
+/**
+ * Free the tree and reports of a statement.
+ *
+ * @param entry The statement.
+ */
+static void free_entry(NsqlDocumentStatement* entry) {
+    free_node(entry->statement);
+    if (entry->errors) {
+        error_context_free(entry->errors);
+        free(entry->errors);
+    }
+    entry->statement = NULL;
+    entry->errors    = NULL;
+}
+
+/**
+ * Parse one statement of a document.
+ *
+ * The lexer is bounded to the statement, which holds exactly one terminator at its end, so the
+ * parser produces at most one statement from it.
+ *
+ * @param document The document.
+ * @param entry The statement, whose offset, length, line and column are set.
+ */
+static void parse_entry(const NsqlDocument* document, NsqlDocumentStatement* entry) {
+    Lexer lexer;
+    lexer_init_n(&lexer, document->text + entry->offset, entry->length);
+    lexer.case_insensitive = document->case_insensitive;
+    lexer.line             = entry->line;
+    lexer.start_line       = entry->line;
+
+    Parser parser;
+    parser_init(&parser, &lexer);
+
+    Node* stmt;
+    entry->statement = NULL;
+    while (parse_next_statement(&parser, &stmt)) {
+        if (entry->statement == NULL)
+            entry->statement = stmt;
+        else
+            free_node(stmt);
+    }
+
+    // Columns on the first line were counted from the start of the statement
+    entry->errors = move_errors(&parser.errors, entry->line, 0, entry->column);
+    parser_free(&parser);
+    lexer_free(&lexer);
+}
+
+/**
+ * Visitor callback that moves a node by the line delta in user_data.
+ *
+ * @param frame The node.
+ * @param user_data Pointer to the number of lines to add.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction shift_line(const AstVisitFrame* frame, void* user_data) {
+    frame->node->line += *(const int*)user_data;
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Move a statement that an edit did not touch to its new position.
+ *
+ * @param entry The statement.
+ * @param offset_delta Bytes added before the statement.
+ * @param line_delta Lines added before the statement.
+ * @param column The new column of its first character.
+ */
+static void shift_entry(NsqlDocumentStatement* entry, ptrdiff_t offset_delta, int line_delta,
+                        int column) {
+    int column_delta = column - entry->column;
+
+    if (line_delta != 0) {
+        AstVisitor visitor = {shift_line, NULL, &line_delta, false};
+        ast_visit(entry->statement, &visitor);
+    }
+    if (entry->errors && (line_delta != 0 || column_delta != 0)) {
+        ErrorContext* errors = move_errors(entry->errors, entry->line, line_delta, column_delta);
+        error_context_free(entry->errors);
+        free(entry->errors);
+        entry->errors = errors;
+    }
+
+    entry->offset = (size_t)((ptrdiff_t)entry->offset + offset_delta);
+    entry->line += line_delta;
+    entry->column = column;
+}
+
+/**
+ * Replace a range of the text buffer.
+ *
+ * @param document The document.
+ * @param offset Offset of the range.
+ * @param removed Length of the range.
+ * @param text The new text of the range.
+ * @param length Length of the new text.
+ */
+static void replace_text(NsqlDocument* document, size_t offset, size_t removed, const char* text,
+                         size_t length) {
+    size_t new_length = document->length - removed + length;
+    if (new_length + 1 > document->capacity) {
+        size_t capacity = document->capacity > 0 ? document->capacity : 256;
+        while (capacity < new_length + 1) capacity *= 2;
+        document->text     = (char*)checked_realloc(document->text, capacity);
+        document->capacity = capacity;
+    }
+
+    memmove(document->text + offset + length, document->text + offset + removed,
+            document->length - offset - removed);
+    memcpy(document->text + offset, text, length);
+    document->length                 = new_length;
+    document->text[document->length] = '\0';
+}
+
+/**
+ * Initialize a document and parse its text.
+ *
+ * @param document The document to initialize.
+ * @param text The text.
+ * @param length Length of the text in bytes.
+ * @param case_insensitive Whether to match keywords regardless of case.
+ */
+void nsql_document_init(NsqlDocument* document, const char* text, size_t length,
+                        bool case_insensitive) {
+    memset(document, 0, sizeof(NsqlDocument));
+    document->case_insensitive = case_insensitive;
+    nsql_document_edit(document, 0, 0, text, length);
+}
+
+/**
+ * Replace a range of the text and re-parse the statements it affects.
+ *
+ * @param document The document.
+ * @param offset Offset of the range to replace.
+ * @param removed Length of the range to replace.
+ * @param text The new text of the range.
+ * @param length Length of the new text in bytes.
+ * @return false if the range lies outside the text.
+ */
+bool nsql_document_edit(NsqlDocument* document, size_t offset, size_t removed, const char* text,
+                        size_t length) {
+    if (offset > document->length || removed > document->length - offset)
+        return false;
+
+    NsqlDocumentStatement* old   = document->statements;
+    size_t                 count = document->count;
+
+    // The first statement that ends at or after the edit; the ones before it cannot change. A
+    // statement ending right at the edit is included, since the edit may extend its PLEASE.
+    size_t first = 0;
+    size_t high  = count;
+    while (first < high) {
+        size_t middle = first + (high - first) / 2;
+        if (old[middle].offset + old[middle].length < offset)
+            first = middle + 1;
+        else
+            high = middle;
+    }
+
+    size_t start = 0;
+    int    line  = 1;
+    if (first < count) {
+        start = old[first].offset;
+        line  = old[first].line;
+    } else if (count > 0) {
+        const NsqlDocumentStatement* last = &old[count - 1];
+        start = last->offset + last->length;
+        line  = last->line + (int)nsql_count_newlines(document->text + last->offset,
+                                                      document->text + start);
+    }
+
+    const char* removed_text = document->text + offset;
+    int         line_delta   = (int)nsql_count_newlines(text, text + length) -
+                               (int)nsql_count_newlines(removed_text, removed_text + removed);
+    ptrdiff_t   delta        = (ptrdiff_t)length - (ptrdiff_t)removed;
+    size_t      edit_end     = offset + length;
+
+    replace_text(document, offset, removed, text, length);
+
+    // Split again from the first affected statement until a terminator lines up with an old one
+    const char*            base        = document->text;
+    const char*            p           = base + start;
+    const char*            end         = base + document->length;
+    NsqlDocumentStatement* added       = NULL;
+    size_t                 added_count = 0;
+    size_t                 capacity    = 0;
+    size_t                 resync      = count;
+    size_t                 j           = first;
+
+    while (p < end) {
+        size_t stmt_start = (size_t)(p - base);
+        int    stmt_line  = line;
+        bool   has_tokens;
+
+        p = nsql_scan_statement(p, end, document->case_insensitive, &line, &has_tokens);
+        if (!has_tokens)
+            break;
+
+        if (added_count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 8;
+            added    = (NsqlDocumentStatement*)checked_realloc(
+                added, capacity * sizeof(NsqlDocumentStatement));
+        }
+        NsqlDocumentStatement* entry = &added[added_count++];
+        entry->offset                = stmt_start;
+        entry->length                = (size_t)(p - base) - stmt_start;
+        entry->line                  = stmt_line;
+        entry->column                = added_count > 1 && stmt_line == entry[-1].line
+                                           ? entry[-1].column + (int)(stmt_start - entry[-1].offset)
+                                           : column_of(base, stmt_start);
+        entry->statement             = NULL;
+        entry->errors                = NULL;
+
+        // Past the edit the text is unchanged, so a split point shared with the old text means
+        // every statement after it is split as before
+        size_t stmt_end = (size_t)(p - base);
+        if (stmt_end >= edit_end) {
+            size_t old_end = (size_t)((ptrdiff_t)stmt_end - delta);
+            while (j < count && old[j].offset + old[j].length < old_end) j++;
+            if (j < count && old[j].offset + old[j].length == old_end) {
+                resync = j + 1;
+                break;
+            }
+        }
+    }
+
+    // A statement that ended at the edit may have come through unchanged
+    if (added_count > 0 && first < count && added[0].offset + added[0].length <= offset &&
+        added[0].length == old[first].length) {
+        added[0].statement     = old[first].statement;
+        added[0].errors        = old[first].errors;
+        old[first].statement   = NULL;
+        old[first].errors      = NULL;
+    }
+
+    for (size_t i = 0; i < added_count; i++) {
+        if (added[i].statement == NULL && added[i].errors == NULL)
+            parse_entry(document, &added[i]);
+    }
+
+    // Columns only change for statements on the line where the edit ended, all by the same amount
+    size_t checked      = edit_end;
+    bool   same_line    = true;
+    int    column_shift = 0;
+    for (size_t i = resync; i < count; i++) {
+        size_t new_offset = (size_t)((ptrdiff_t)old[i].offset + delta);
+        int    column     = old[i].column;
+        if (same_line) {
+            same_line = memchr(base + checked, '\n', new_offset - checked) == NULL;
+            checked   = new_offset;
+            if (same_line && i == resync)
+                column_shift = column_of(base, new_offset) - column;
+            if (same_line)
+                column += column_shift;
+        }
+        shift_entry(&old[i], delta, line_delta, column);
+    }
+
+    for (size_t i = first; i < resync; i++) {
+        free_entry(&old[i]);
+    }
+
+    // Splice the new statements in place of the ones they replace
+    size_t tail      = count - resync;
+    size_t new_count = first + added_count + tail;
+    if (new_count > document->statement_capacity) {
+        size_t capacity_needed = document->statement_capacity > 0
+                                     ? document->statement_capacity
+                                     : 16;
+        while (capacity_needed < new_count) capacity_needed *= 2;
+        document->statements = (NsqlDocumentStatement*)checked_realloc(
+            document->statements, capacity_needed * sizeof(NsqlDocumentStatement));
+        document->statement_capacity = capacity_needed;
+    }
+    memmove(document->statements + first + added_count, document->statements + resync,
+            tail * sizeof(NsqlDocumentStatement));
+    if (added_count > 0)
+        memcpy(document->statements + first, added, added_count * sizeof(NsqlDocumentStatement));
+    free(added);
+
+    document->count          = new_count;
+    document->first_changed  = first;
+    document->changed_count  = added_count;
+    document->replaced_count = resync - first;
+    return true;
+}
+
+/**
+ * Free a document's text, statements and error reports.
+ *
+ * @param document The document to free.
+ */
+void nsql_document_free(NsqlDocument* document) {
+    for (size_t i = 0; i < document->count; i++) {
+        free_entry(&document->statements[i]);
+    }
+    free(document->statements);
+    free(document->text);
+    memset(document, 0, sizeof(NsqlDocument));
+}
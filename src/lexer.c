@@ -1,486 +1,492 @@
-#include <ctype.h>
-#include <nsql/lexer.h>
-#include <stdbool.h>
-#include <stdlib.h>
-#include <string.h>
-
-/**
- * Initialize the lexer with source code.
- *
- * @param lexer The lexer instance.
- * @param source The source code to be lexed.
- */
-void lexer_init(Lexer* lexer, const char* source) {
-    lexer->start   = source;
-    lexer->current = source;
-    lexer->line    = 1;
-}
-
-/**
- * Check if the current lexeme is at the end of the source.
- *
- * @param lexer The lexer instance.
- * @return true if at end, false otherwise.
- */
-static bool is_at_end(Lexer* lexer) {
-    return *lexer->current == '\0';
-}
-
-/**
- * Creates a token representing the current lexeme in the source.
- *
- * The token includes its type, starting position, length, and line number.
- *
- * @param type The type to assign to the created token.
- * @return A token corresponding to the current lexeme.
- */
-static Token make_token(Lexer* lexer, NsqlTokenType type) {
-    Token token;
-    token.type   = type;
-    token.start  = lexer->start;
-    token.length = (int)(lexer->current - lexer->start);
-    token.line   = lexer->line;
-    return token;
-}
-
-/**
- * Create an error token.
- *
- * @param lexer The lexer instance.
- * @param message The error message.
- * @return The created error token.
- */
-static Token error_token(Lexer* lexer, const char* message) {
-    Token token;
-    token.type   = TOKEN_ERROR;
-    token.start  = message;
-    token.length = (int)strlen(message);
-    token.line   = lexer->line;
-    return token;
-}
-
-/**
- * Advance the current pointer and return the character.
- *
- * @param lexer The lexer instance.
- * @return The character at the current position.
- */
-static char advance(Lexer* lexer) {
-    return *(lexer->current++);
-}
-
-/**
- * Look at the current character without advancing.
- *
- * @param lexer The lexer instance.
- * @return The current character.
- */
-static char peek(Lexer* lexer) {
-    return *lexer->current;
-}
-
-/**
- * Look at the next character without advancing.
- *
- * @param lexer The lexer instance.
- * @return The next character.
- */
-static char peek_next(Lexer* lexer) {
-    if (is_at_end(lexer))
-        return '\0';
-    return lexer->current[1];
-}
-
-/**
- * Skip whitespace and comments in the source code.
- *
- * @param lexer The lexer instance.
- */
-static void skip_whitespace(Lexer* lexer) {
-    for (;;) {
-        char c = peek(lexer);
-        switch (c) {
-            case ' ':
-            case '\r':
-            case '\t':
-                advance(lexer);
-                break;
-            case '\n':
-                lexer->line++;
-                advance(lexer);
-                break;
-            case '>':  // Comment
-                if (peek_next(lexer) == '>') {
-                    advance(lexer);  // consume first '>'
-                    advance(lexer);  // consume second '>'
-                    while (peek(lexer) != '\n' && !is_at_end(lexer)) {
-                        advance(lexer);
-                    }
-                    break;
-                }
-                // If not '>>', fall through to default
-            default:
-                return;
-        }
-    }
-}
-
-/**
- * Check if character is a valid identifier start.
- *
- * @param c The character to check.
- * @return true if valid, false otherwise.
- */
-static bool is_alpha(char c) {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
-}
-
-/**
- * Check if character is a valid identifier character.
- *
- * @param c The character to check.
- * @return true if valid, false otherwise.
- */
-static bool is_alnum(char c) {
-    return is_alpha(c) || isdigit(c);
-}
-
-/**
- * Determines if the current lexeme matches a specific keyword and returns its token type.
- *
- * Compares a substring of the current lexeme to a given keyword. If it matches exactly, returns the
- * specified keyword token type; otherwise, returns TOKEN_IDENTIFIER.
- *
- * @return The keyword token type if matched; otherwise, TOKEN_IDENTIFIER.
- */
-static NsqlTokenType check_keyword(Lexer* lexer, int start, int length, const char* rest,
-                                   NsqlTokenType type) {
-    if (lexer->current - lexer->start == start + length &&
-        memcmp(lexer->start + start, rest, length) == 0) {
-        return type;
-    }
-
-    return TOKEN_IDENTIFIER;
-}
-
-/**
- * @brief Determines the token type for an identifier or keyword.
- *
- * Checks the current lexeme in the lexer to see if it matches any reserved SQL-like keywords and
- * returns the corresponding token type. If no keyword matches, returns TOKEN_IDENTIFIER.
- *
- * @return NsqlTokenType The token type corresponding to the matched keyword, or TOKEN_IDENTIFIER if
- * no keyword is matched.
- */
-static NsqlTokenType identifier_type(Lexer* lexer) {
-    switch (lexer->start[0]) {
-        case 'A':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'S':
-                        if (lexer->current - lexer->start == 2)
-                            return TOKEN_AS;
-                        return check_keyword(lexer, 2, 1, "K", TOKEN_ASK);
-                    case 'N':
-                        return check_keyword(lexer, 2, 1, "D", TOKEN_AND);
-                    case 'D':
-                        return check_keyword(lexer, 2, 1, "D", TOKEN_ADD);
-                }
-            }
-            break;
-        case 'B':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'Y':
-                        return check_keyword(lexer, 2, 0, "", TOKEN_BY);
-                }
-            }
-            break;
-        case 'C':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'R':
-                        return check_keyword(lexer, 2, 4, "EATE", TOKEN_CREATE);
-                }
-            }
-            break;
-        case 'F':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'I':
-                        return check_keyword(lexer, 2, 2, "ND", TOKEN_FIND);
-                    case 'O':
-                        return check_keyword(lexer, 2, 1, "R", TOKEN_FOR);
-                    case 'R':
-                        return check_keyword(lexer, 2, 2, "OM", TOKEN_FROM);
-                }
-            }
-            break;
-        case 'G':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'E':
-                        return check_keyword(lexer, 2, 1, "T", TOKEN_GET);
-                    case 'R':
-                        return check_keyword(lexer, 2, 3, "OUP", TOKEN_GROUP);
-                }
-            }
-            break;
-        case 'H':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'A':
-                        return check_keyword(lexer, 2, 4, "VING", TOKEN_HAVING);
-                }
-            }
-            break;
-        case 'L':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'I':
-                        if (lexer->current - lexer->start == 4 && lexer->start[2] == 'K' &&
-                            lexer->start[3] == 'E') {
-                            return TOKEN_LIKE;
-                        } else if (lexer->current - lexer->start == 5 && lexer->start[2] == 'M' &&
-                                   lexer->start[3] == 'I' && lexer->start[4] == 'T') {
-                            return TOKEN_LIMIT;
-                        }
-                        break;
-                }
-            }
-            break;
-        case 'N':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'O':
-                        return check_keyword(lexer, 2, 1, "T", TOKEN_NOT);
-                }
-            }
-            break;
-        case 'O':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'R':
-                        if (lexer->current - lexer->start == 2)
-                            return TOKEN_OR;
-                        return check_keyword(lexer, 2, 3, "DER", TOKEN_ORDER);
-                }
-            }
-            break;
-        case 'P':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'L':
-                        return check_keyword(lexer, 2, 4, "EASE", TOKEN_TERMINATOR);
-                }
-            }
-            break;
-        case 'R':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'E':
-                        return check_keyword(lexer, 2, 4, "MOVE", TOKEN_REMOVE);
-                }
-            }
-            break;
-        case 'S':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'H':
-                        return check_keyword(lexer, 2, 2, "OW", TOKEN_SHOW);
-                    case 'O':
-                        return check_keyword(lexer, 2, 2, "RT", TOKEN_SORT);
-                }
-            }
-            break;
-        case 'T':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'E':
-                        return check_keyword(lexer, 2, 2, "LL", TOKEN_TELL);
-                    case 'H':
-                        return check_keyword(lexer, 2, 2, "AT", TOKEN_THAT);
-                    case 'O':
-                        return check_keyword(lexer, 2, 0, "", TOKEN_TO);
-                }
-            }
-            break;
-        case 'U':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'P':
-                        return check_keyword(lexer, 2, 4, "DATE", TOKEN_UPDATE);
-                }
-            }
-            break;
-        case 'W':
-            if (lexer->current - lexer->start > 1) {
-                switch (lexer->start[1]) {
-                    case 'H':
-                        if (lexer->current - lexer->start > 2) {
-                            switch (lexer->start[2]) {
-                                case 'E':
-                                    return check_keyword(lexer, 3, 2, "RE", TOKEN_WHERE);
-                                case 'N':
-                                    return check_keyword(lexer, 3, 0, "", TOKEN_WHEN);
-                                case 'I':
-                                    return check_keyword(lexer, 3, 2, "CH", TOKEN_WHICH);
-                            }
-                        }
-                        break;
-                    case 'I':
-                        return check_keyword(lexer, 2, 2, "TH", TOKEN_WITH);
-                }
-            }
-            break;
-    }
-
-    return TOKEN_IDENTIFIER;
-}
-
-/**
- * Scan an identifier.
- *
- * @param lexer The lexer instance.
- */
-static Token identifier(Lexer* lexer) {
-    while (is_alnum(peek(lexer))) advance(lexer);
-
-    return make_token(lexer, identifier_type(lexer));
-}
-
-/**
- * Scan a number.
- *
- * @param lexer The lexer instance.
- */
-static Token number(Lexer* lexer) {
-    while (isdigit(peek(lexer))) advance(lexer);
-
-    // Look for a fractional part
-    if (peek(lexer) == '.' && isdigit(peek_next(lexer))) {
-        advance(lexer);  // Consume the '.'
-
-        while (isdigit(peek(lexer))) advance(lexer);
-        return make_token(lexer, TOKEN_DECIMAL);
-    }
-
-    return make_token(lexer, TOKEN_INTEGER);
-}
-
-/**
- * Scan a string literal.
- *
- * @param lexer The lexer instance.
- * @return The created string token.
- */
-static Token string(Lexer* lexer) {
-    // Save the opening quote character to verify closing quote later
-    char quote = lexer->start[0];
-
-    while ((peek(lexer) != quote) && !is_at_end(lexer)) {
-        if (peek(lexer) == '\n')
-            lexer->line++;
-        advance(lexer);
-    }
-
-    if (is_at_end(lexer))
-        return error_token(lexer, "Unterminated string.");
-
-    // Closing quote
-    advance(lexer);
-    return make_token(lexer, TOKEN_STRING);
-}
-
-/**
- * Get the next token from the lexer.
- *
- * @param lexer The lexer instance.
- * @return The next token.
- */
-Token lexer_next_token(Lexer* lexer) {
-    skip_whitespace(lexer);
-
-    lexer->start = lexer->current;
-
-    if (is_at_end(lexer))
-        return make_token(lexer, TOKEN_EOF);
-
-    char c = advance(lexer);
-
-    if (is_alpha(c))
-        return identifier(lexer);
-    if (isdigit(c))
-        return number(lexer);
-
-    switch (c) {
-        case '(':
-            return make_token(lexer, TOKEN_LPAREN);
-        case ')':
-            return make_token(lexer, TOKEN_RPAREN);
-        case ',':
-            return make_token(lexer, TOKEN_COMMA);
-        case '=':
-            return make_token(lexer, TOKEN_EQUAL);
-        case '<':
-            return make_token(lexer, peek(lexer) == '=' ? (advance(lexer), TOKEN_LTE) : TOKEN_LT);
-        case '>':
-            return make_token(lexer, peek(lexer) == '=' ? (advance(lexer), TOKEN_GTE) : TOKEN_GT);
-        case '!':
-            return make_token(lexer,
-                              peek(lexer) == '=' ? (advance(lexer), TOKEN_NEQ) : TOKEN_ERROR);
-        case '+':
-            return make_token(lexer, TOKEN_PLUS);
-        case '-':
-            return make_token(lexer, TOKEN_MINUS);
-        case '*':
-            return make_token(lexer, TOKEN_STAR);
-        case '/':
-            return make_token(lexer, TOKEN_SLASH);
-        case '%':
-            return make_token(lexer, TOKEN_PERCENT);
-        case '"':
-        case '\'':
-            return string(lexer);
-        case ';':
-            return make_token(lexer, TOKEN_TERMINATOR);
-    }
-
-    return error_token(lexer, "Unexpected character.");
-}
-
-/**
- * Get the starting position of a specific line in the source code.
- *
- * @param lexer The lexer instance.
- * @param line The line number (1-based).
- * @return Pointer to the beginning of the specified line,
- *         or start of source if line < 1,
- *         or end of source (terminating '\0' char) if line > total lines.
- */
-const char* lexer_get_line_start(Lexer* lexer, int line) {
-    if (!lexer || line < 1) {
-        return lexer ? lexer->start : NULL;
-    }
-
-    // Start from the beginning of the source
-    const char* current      = lexer->start;
-    int         current_line = 1;
-
-    // Find the start of the requested line
-    while (current_line < line && *current) {
-        // If we find a newline, we've found the end of a line
-        if (*current == '\n') {
-            current_line++;
-            if (current_line == line) {
-                // Return the character after the newline
-                return current + 1;
-            }
-        }
-        current++;
-    }
-
-    // If the requested line is greater than available lines,
-    // return the start of the last line
-    return current;
-}
\ No newline at end of file
+#include <ctype.h>
+#include <nsql/lexer.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+/**
+ * Initialize the lexer with null-terminated source code.
+ *
+ * @param lexer The lexer instance.
+ * @param source The source code to be lexed.
+ */
+void lexer_init(Lexer* lexer, const char* source) {
+    lexer_init_n(lexer, source, strlen(source));
+}
+
+/**
+ * Initialize the lexer with source code of a known length.
+ *
+ * Scanning stops at source + length, so the source does not need a terminator.
+ *
+ * @param lexer The lexer instance.
+ * @param source The source code to be lexed.
+ * @param length Length of the source in bytes.
+ */
+void lexer_init_n(Lexer* lexer, const char* source, size_t length) {
+    lexer->source           = source;
+    lexer->start            = source;
+    lexer->current          = source;
+    lexer->end              = source + length;
+    lexer->line_start       = source;
+    lexer->line             = 1;
+    lexer->start_line       = 1;
+    lexer->start_column     = 0;
+    lexer->case_insensitive = false;
+    lexer->line_offsets     = NULL;
+    lexer->line_count       = 0;
+    lexer->line_capacity    = 0;
+}
+
+/**
+ * Free the resources owned by the lexer.
+ *
+ * @param lexer The lexer instance.
+ */
+void lexer_free(Lexer* lexer) {
+    if (!lexer)
+        return;
+
+    free(lexer->line_offsets);
+    lexer->line_offsets  = NULL;
+    lexer->line_count    = 0;
+    lexer->line_capacity = 0;
+}
+
+/**
+ * Append a line start to the line index.
+ *
+ * If the index cannot grow it is dropped and lookups fall back to scanning the source.
+ *
+ * @param lexer The lexer instance.
+ * @param line_start The first character of the new line.
+ */
+static void push_line(Lexer* lexer, const char* line_start) {
+    if (lexer->line_count == lexer->line_capacity) {
+        size_t    capacity = lexer->line_capacity > 0 ? lexer->line_capacity * 2 : 64;
+        uint32_t* offsets  = (uint32_t*)realloc(lexer->line_offsets, capacity * sizeof(uint32_t));
+        if (!offsets) {
+            lexer_free(lexer);
+            return;
+        }
+        lexer->line_offsets  = offsets;
+        lexer->line_capacity = capacity;
+    }
+
+    lexer->line_offsets[lexer->line_count++] = (uint32_t)(line_start - lexer->source);
+}
+
+/**
+ * Update the line bookkeeping after a scanner consumed newlines.
+ *
+ * @param lexer The lexer instance.
+ * @param from Start of the consumed range.
+ * @param to End of the consumed range.
+ */
+static void track_newlines(Lexer* lexer, const char* from, const char* to) {
+    if (lexer->line_offsets) {
+        const char* p = from;
+        while (p < to && (p = (const char*)memchr(p, '\n', (size_t)(to - p))) != NULL) {
+            lexer->line_start = ++p;
+            if (lexer->line_offsets)
+                push_line(lexer, p);
+        }
+        return;
+    }
+
+    // Without an index only the start of the last line matters
+    const char* p = to;
+    while (p > from && p[-1] != '\n') p--;
+    if (p > from)
+        lexer->line_start = p;
+}
+
+/**
+ * Enable the line index.
+ *
+ * Lines already scanned are indexed immediately; the rest are recorded as the lexer reaches them.
+ *
+ * @param lexer The lexer instance.
+ * @return true if the index is enabled, false otherwise.
+ */
+bool lexer_enable_line_index(Lexer* lexer) {
+    if (!lexer)
+        return false;
+    if (lexer->line_offsets)
+        return true;
+    if ((uint64_t)(lexer->end - lexer->source) > UINT32_MAX)
+        return false;
+
+    push_line(lexer, lexer->source);
+    if (!lexer->line_offsets)
+        return false;
+
+    track_newlines(lexer, lexer->source, lexer->current);
+    return lexer->line_offsets != NULL;
+}
+
+/**
+ * Check if the current lexeme is at the end of the source.
+ *
+ * @param lexer The lexer instance.
+ * @return true if at end, false otherwise.
+ */
+static bool is_at_end(Lexer* lexer) {
+    return lexer->current >= lexer->end;
+}
+
+/**
+ * Creates a token representing the current lexeme in the source.
+ *
+ * The token includes its type, starting position, length, and line number.
+ *
+ * @param type The type to assign to the created token.
+ * @return A token corresponding to the current lexeme.
+ */
+static Token make_token(Lexer* lexer, NsqlTokenType type) {
+    Token token;
+    token.type   = type;
+    token.start  = lexer->start;
+    token.length = (int)(lexer->current - lexer->start);
+    token.line   = lexer->start_line;
+    token.column = lexer->start_column;
+    return token;
+}
+
+/**
+ * Create an error token.
+ *
+ * @param lexer The lexer instance.
+ * @param message The error message.
+ * @return The created error token.
+ */
+static Token error_token(Lexer* lexer, const char* message) {
+    Token token;
+    token.type   = TOKEN_ERROR;
+    token.start  = message;
+    token.length = (int)strlen(message);
+    token.line   = lexer->start_line;
+    token.column = lexer->start_column;
+    return token;
+}
+
+/**
+ * Advance the current pointer and return the character.
+ *
+ * @param lexer The lexer instance.
+ * @return The character at the current position.
+ */
+static char advance(Lexer* lexer) {
+    return *(lexer->current++);
+}
+
+/**
+ * Look at the current character without advancing.
+ *
+ * @param lexer The lexer instance.
+ * @return The current character, or '\0' at the end of the source.
+ */
+static char peek(Lexer* lexer) {
+    if (is_at_end(lexer))
+        return '\0';
+    return *lexer->current;
+}
+
+/**
+ * Look at the next character without advancing.
+ *
+ * @param lexer The lexer instance.
+ * @return The next character, or '\0' past the end of the source.
+ */
+static char peek_next(Lexer* lexer) {
+    if (lexer->end - lexer->current < 2)
+        return '\0';
+    return lexer->current[1];
+}
+
+/**
+ * Skip whitespace and comments in the source code.
+ *
+ * @param lexer The lexer instance.
+ */
+static void skip_whitespace(Lexer* lexer) {
+    for (;;) {
+        const char* from = lexer->current;
+        int         line = lexer->line;
+
+        lexer->current = nsql_scan_whitespace(from, lexer->end, &lexer->line);
+        if (lexer->line != line)
+            track_newlines(lexer, from, lexer->current);
+
+        // Comments run to the end of the line
+        if (peek(lexer) != '>' || peek_next(lexer) != '>')
+            return;
+        lexer->current = nsql_scan_line_end(lexer->current + 2, lexer->end);
+    }
+}
+
+/**
+ * Check if character is a valid identifier start.
+ *
+ * @param c The character to check.
+ * @return true if valid, false otherwise.
+ */
+static bool is_alpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+// Keyword table entry
+typedef struct {
+    const char*   text;
+    NsqlTokenType type;
+} Keyword;
+
+#define KEYWORD_BUCKET(entries) {entries, sizeof(entries) / sizeof(entries[0])}
+#define MAX_KEYWORD_LENGTH 8
+
+// Keywords bucketed by length. To add a keyword, add its token type to lexer.h and list it in the
+// bucket matching its length; the lookup table below is sized automatically.
+static const Keyword keywords_2[] = {
+    {"AS", TOKEN_AS}, {"BY", TOKEN_BY}, {"IF", TOKEN_IF},
+    {"IN", TOKEN_IN}, {"OR", TOKEN_OR}, {"TO", TOKEN_TO},
+};
+
+static const Keyword keywords_3[] = {
+    {"ADD", TOKEN_ADD}, {"AND", TOKEN_AND}, {"ARE", TOKEN_ARE}, {"ASK", TOKEN_ASK},
+    {"BUT", TOKEN_BUT}, {"FOR", TOKEN_FOR}, {"GET", TOKEN_GET}, {"HAS", TOKEN_HAS},
+    {"HOW", TOKEN_HOW}, {"NOT", TOKEN_NOT}, {"VIA", TOKEN_VIA},
+};
+
+static const Keyword keywords_4[] = {
+    {"FIND", TOKEN_FIND}, {"FROM", TOKEN_FROM}, {"HAVE", TOKEN_HAVE}, {"HOPS", TOKEN_HOPS},
+    {"LIKE", TOKEN_LIKE}, {"MANY", TOKEN_MANY}, {"PATH", TOKEN_PATH}, {"SHOW", TOKEN_SHOW},
+    {"SORT", TOKEN_SORT}, {"TELL", TOKEN_TELL}, {"THAT", TOKEN_THAT}, {"WHEN", TOKEN_WHEN},
+    {"WITH", TOKEN_WITH},
+};
+
+static const Keyword keywords_5[] = {
+    {"DEPTH", TOKEN_DEPTH}, {"GROUP", TOKEN_GROUP}, {"LIMIT", TOKEN_LIMIT},
+    {"ORDER", TOKEN_ORDER}, {"WHERE", TOKEN_WHERE}, {"WHICH", TOKEN_WHICH},
+};
+
+static const Keyword keywords_6[] = {
+    {"CREATE", TOKEN_CREATE},     {"EXISTS", TOKEN_EXISTS}, {"HAVING", TOKEN_HAVING},
+    {"PLEASE", TOKEN_TERMINATOR}, {"REMOVE", TOKEN_REMOVE}, {"UPDATE", TOKEN_UPDATE},
+};
+
+static const Keyword keywords_7[] = {
+    {"BETWEEN", TOKEN_BETWEEN},
+};
+
+static const Keyword keywords_8[] = {
+    {"TRAVERSE", TOKEN_TRAVERSE},
+};
+
+static const struct {
+    const Keyword* entries;
+    size_t         count;
+} keyword_buckets[MAX_KEYWORD_LENGTH + 1] = {
+    [2] = KEYWORD_BUCKET(keywords_2), [3] = KEYWORD_BUCKET(keywords_3),
+    [4] = KEYWORD_BUCKET(keywords_4), [5] = KEYWORD_BUCKET(keywords_5),
+    [6] = KEYWORD_BUCKET(keywords_6), [7] = KEYWORD_BUCKET(keywords_7),
+    [8] = KEYWORD_BUCKET(keywords_8),
+};
+
+/**
+ * @brief Determines the token type for an identifier or keyword.
+ *
+ * Looks the current lexeme up in the length-bucketed keyword table. When the lexer is configured
+ * for case-insensitive keywords the lexeme is folded to upper case before the comparison.
+ *
+ * @return NsqlTokenType The token type corresponding to the matched keyword, or TOKEN_IDENTIFIER if
+ * no keyword is matched.
+ */
+static NsqlTokenType identifier_type(Lexer* lexer) {
+    size_t length = (size_t)(lexer->current - lexer->start);
+    if (length > MAX_KEYWORD_LENGTH || keyword_buckets[length].count == 0)
+        return TOKEN_IDENTIFIER;
+
+    const char* text = lexer->start;
+    char        folded[MAX_KEYWORD_LENGTH];
+    if (lexer->case_insensitive) {
+        for (size_t i = 0; i < length; i++) {
+            char c    = text[i];
+            folded[i] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+        }
+        text = folded;
+    }
+
+    const Keyword* entries = keyword_buckets[length].entries;
+    for (size_t i = 0; i < keyword_buckets[length].count; i++) {
+        if (entries[i].text[0] == text[0] && memcmp(entries[i].text, text, length) == 0)
+            return entries[i].type;
+    }
+
+    return TOKEN_IDENTIFIER;
+}
+
+/**
+ * Scan an identifier.
+ *
+ * @param lexer The lexer instance.
+ */
+static Token identifier(Lexer* lexer) {
+    lexer->current = nsql_scan_identifier(lexer->current, lexer->end);
+
+    return make_token(lexer, identifier_type(lexer));
+}
+
+/**
+ * Scan a number.
+ *
+ * @param lexer The lexer instance.
+ */
+static Token number(Lexer* lexer) {
+    lexer->current = nsql_scan_digits(lexer->current, lexer->end);
+
+    // Look for a fractional part
+    if (peek(lexer) == '.' && isdigit(peek_next(lexer))) {
+        advance(lexer);  // Consume the '.'
+
+        lexer->current = nsql_scan_digits(lexer->current, lexer->end);
+        return make_token(lexer, TOKEN_DECIMAL);
+    }
+
+    return make_token(lexer, TOKEN_INTEGER);
+}
+
+/**
+ * Scan a string literal.
+ *
+ * @param lexer The lexer instance.
+ * @return The created string token.
+ */
+static Token string(Lexer* lexer) {
+    // Save the opening quote character to verify closing quote later
+    char quote = lexer->start[0];
+
+    const char* from = lexer->current;
+    int         line = lexer->line;
+
+    lexer->current = nsql_scan_string(from, lexer->end, quote, &lexer->line);
+    if (lexer->line != line)
+        track_newlines(lexer, from, lexer->current);
+
+    if (is_at_end(lexer))
+        return error_token(lexer, "Unterminated string.");
+
+    // Closing quote
+    advance(lexer);
+    return make_token(lexer, TOKEN_STRING);
+}
+
+/**
+ * Get the next token from the lexer.
+ *
+ * @param lexer The lexer instance.
+ * @return The next token.
+ */
+Token lexer_next_token(Lexer* lexer) {
+    skip_whitespace(lexer);
+
+    lexer->start        = lexer->current;
+    lexer->start_line   = lexer->line;
+    lexer->start_column = (int)(lexer->current - lexer->line_start);
+
+    if (is_at_end(lexer))
+        return make_token(lexer, TOKEN_EOF);
+
+    char c = advance(lexer);
+
+    if (is_alpha(c))
+        return identifier(lexer);
+    if (isdigit(c))
+        return number(lexer);
+
+    switch (c) {
+        case '(':
+            return make_token(lexer, TOKEN_LPAREN);
+        case ')':
+            return make_token(lexer, TOKEN_RPAREN);
+        case ',':
+            return make_token(lexer, TOKEN_COMMA);
+        case '=':
+            return make_token(lexer, TOKEN_EQUAL);
+        case '<':
+            return make_token(lexer, peek(lexer) == '=' ? (advance(lexer), TOKEN_LTE) : TOKEN_LT);
+        case '>':
+            return make_token(lexer, peek(lexer) == '=' ? (advance(lexer), TOKEN_GTE) : TOKEN_GT);
+        case '!':
+            if (peek(lexer) != '=')
+                return error_token(lexer, "Unexpected character.");
+            advance(lexer);
+            return make_token(lexer, TOKEN_NEQ);
+        case '+':
+            return make_token(lexer, TOKEN_PLUS);
+        case '-':
+            return make_token(lexer, TOKEN_MINUS);
+        case '*':
+            return make_token(lexer, TOKEN_STAR);
+        case '/':
+            return make_token(lexer, TOKEN_SLASH);
+        case '%':
+            return make_token(lexer, TOKEN_PERCENT);
+        case '"':
+        case '\'':
+            return string(lexer);
+        case ';':
+            return make_token(lexer, TOKEN_TERMINATOR);
+        case '?':
+            return make_token(lexer, TOKEN_PARAMETER);
+    }
+
+    return error_token(lexer, "Unexpected character.");
+}
+
+/**
+ * Get the starting position of a specific line in the source code.
+ *
+ * Lines covered by the line index are a direct lookup. Otherwise the source is scanned forward
+ * from the closest line start the lexer already knows.
+ *
+ * @param lexer The lexer instance.
+ * @param line The line number (1-based).
+ * @return Pointer to the beginning of the specified line,
+ *         or start of source if line < 1,
+ *         or end of source (one past its last character) if line > total lines.
+ */
+const char* lexer_get_line_start(Lexer* lexer, int line) {
+    if (!lexer || line < 1) {
+        return lexer ? lexer->source : NULL;
+    }
+
+    if (line == lexer->line)
+        return lexer->line_start;
+    if (lexer->line_offsets && (size_t)line <= lexer->line_count)
+        return lexer->source + lexer->line_offsets[line - 1];
+
+    // Start from the furthest known line at or before the requested one
+    const char* current      = lexer->source;
+    int         current_line = 1;
+    if (lexer->line_offsets) {
+        current      = lexer->source + lexer->line_offsets[lexer->line_count - 1];
+        current_line = (int)lexer->line_count;
+    } else if (line > lexer->line) {
+        current      = lexer->line_start;
+        current_line = lexer->line;
+    }
+
+    while (current_line < line) {
+        current = (const char*)memchr(current, '\n', (size_t)(lexer->end - current));
+        if (!current)
+            return lexer->end;
+
+        // Return the character after the newline
+        current++;
+        current_line++;
+    }
+
+    return current;
+}
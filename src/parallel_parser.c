@@ -0,0 +1,334 @@
+/**
+ * @file parallel_parser.c
+ * @brief Splitting and multi-threaded parsing of large scripts
+ */
+
+#include <nsql/parallel_parser.h>
+#include <nsql/parser.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+#include "thread.h"
+
+// Bounds for the automatic batch size
+#define MIN_BATCH_SIZE (16 * 1024)
+#define MAX_BATCH_SIZE (1024 * 1024)
+
+// Batches created per worker so uneven statements still balance out
+#define BATCHES_PER_THREAD 8
+
+// Statements parsed by one worker from a contiguous run of spans
+typedef struct {
+    size_t       first_span;  // Index of the first span in the batch
+    size_t       span_count;  // Number of spans in the batch
+    Node**       statements;  // Statements that parsed cleanly
+    size_t       count;       // Number of statements
+    size_t       capacity;    // Allocated entries in statements
+    ErrorContext errors;      // Errors reported while parsing the batch
+} ParseBatch;
+
+// State shared by all workers
+typedef struct {
+    const char*          source;
+    const StatementSpan* spans;
+    ParseBatch*          batches;
+    size_t               batch_count;
+    atomic_size_t        next_batch;
+    bool                 case_insensitive;
+} ParallelJob;
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param ptr Existing allocation to resize (NULL to allocate).
+ * @param size The new size in bytes.
+ * @return Pointer to the allocation.
+ */
+static void* checked_realloc(void* ptr, size_t size) {
+    void* result = realloc(ptr, size);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Split a script into statements.
+ *
+ * @param source The script.
+ * @param length Length of the script in bytes.
+ * @param case_insensitive Whether PLEASE is recognised regardless of case.
+ * @param spans Receives the array of spans.
+ * @return The number of spans.
+ */
+size_t split_statements(const char* source, size_t length, bool case_insensitive,
+                        StatementSpan** spans) {
+    const char*    p        = source;
+    const char*    end      = source + length;
+    int            line     = 1;
+    StatementSpan* out      = NULL;
+    size_t         count    = 0;
+    size_t         capacity = 0;
+
+    while (p < end) {
+        const char* stmt_start = p;
+        int         stmt_line  = line;
+        bool        has_tokens;
+
+        // Trailing text without tokens is not a statement
+        p = nsql_scan_statement(p, end, case_insensitive, &line, &has_tokens);
+        if (!has_tokens)
+            break;
+
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 64;
+            out      = (StatementSpan*)checked_realloc(out, capacity * sizeof(StatementSpan));
+        }
+        out[count].start  = stmt_start;
+        out[count].length = (size_t)(p - stmt_start);
+        out[count].line   = stmt_line;
+        count++;
+    }
+
+    *spans = out;
+    return count;
+}
+
+/**
+ * Copy the reports of one statement into its batch.
+ *
+ * @param job The shared job state.
+ * @param span The statement.
+ * @param from Errors reported while parsing the statement.
+ * @param to Errors of the batch.
+ */
+static void append_reports(const ParallelJob* job, const StatementSpan* span,
+                           const ErrorContext* from, ErrorContext* to) {
+    // Columns on the statement's first line were counted from the start of the statement
+    const char* line_start = span->start;
+    while (line_start > job->source && line_start[-1] != '\n') line_start--;
+    int column_offset = (int)(span->start - line_start);
+
+    const ErrorReport* report = error_context_next(from, NULL);
+    for (; report; report = error_context_next(from, report)) {
+        int column = report->line == span->line ? report->column + column_offset : report->column;
+        if (report->owns_message)
+            report_error(to, report->severity, report->source, report->line, column,
+                         report->message);
+        else
+            report_error_static(to, report->severity, report->source, report->line, column,
+                                report->message);
+    }
+}
+
+/**
+ * Parse the spans of one batch.
+ *
+ * Each span gets a lexer bounded to it, so it is parsed in place, and error recovery stops at its
+ * end. The errors reported therefore do not depend on how the spans are batched, and match those
+ * of parsing each statement on its own.
+ *
+ * @param job The shared job state.
+ * @param batch The batch to parse.
+ */
+static void parse_batch(ParallelJob* job, ParseBatch* batch) {
+    for (size_t i = 0; i < batch->span_count; i++) {
+        const StatementSpan* span = &job->spans[batch->first_span + i];
+
+        Lexer lexer;
+        lexer_init_n(&lexer, span->start, span->length);
+        lexer.case_insensitive = job->case_insensitive;
+        lexer.line             = span->line;
+        lexer.start_line       = span->line;
+
+        Parser parser;
+        parser_init(&parser, &lexer);
+
+        Node* stmt;
+        while (parse_next_statement(&parser, &stmt)) {
+            if (stmt == NULL)
+                continue;
+
+            if (batch->count == batch->capacity) {
+                batch->capacity   = batch->capacity > 0 ? batch->capacity * 2 : 16;
+                batch->statements = (Node**)checked_realloc(batch->statements,
+                                                            batch->capacity * sizeof(Node*));
+            }
+            batch->statements[batch->count++] = stmt;
+        }
+
+        append_reports(job, span, &parser.errors, &batch->errors);
+        parser_free(&parser);
+        lexer_free(&lexer);
+    }
+}
+
+/**
+ * Worker thread entry point, parses batches until none are left.
+ *
+ * @param arg The shared job state.
+ */
+static void parse_worker(void* arg) {
+    ParallelJob* job = (ParallelJob*)arg;
+
+    for (;;) {
+        size_t index = atomic_fetch_add(&job->next_batch, 1);
+        if (index >= job->batch_count)
+            break;
+
+        parse_batch(job, &job->batches[index]);
+    }
+}
+
+/**
+ * Group spans into batches of roughly batch_size bytes.
+ *
+ * @param spans The statement spans.
+ * @param span_count Number of spans.
+ * @param batch_size Target size of a batch in bytes.
+ * @param batch_count Receives the number of batches.
+ * @return The zero-initialized batches.
+ */
+static ParseBatch* make_batches(const StatementSpan* spans, size_t span_count, size_t batch_size,
+                                size_t* batch_count) {
+    ParseBatch* batches  = NULL;
+    size_t      count    = 0;
+    size_t      capacity = 0;
+
+    for (size_t i = 0; i < span_count;) {
+        size_t first = i;
+        size_t bytes = 0;
+        while (i < span_count && (i == first || bytes < batch_size)) {
+            bytes += spans[i].length;
+            i++;
+        }
+
+        if (count == capacity) {
+            capacity = capacity > 0 ? capacity * 2 : 16;
+            batches  = (ParseBatch*)checked_realloc(batches, capacity * sizeof(ParseBatch));
+        }
+        memset(&batches[count], 0, sizeof(ParseBatch));
+        batches[count].first_span = first;
+        batches[count].span_count = i - first;
+        error_context_init(&batches[count].errors);
+        count++;
+    }
+
+    *batch_count = count;
+    return batches;
+}
+
+/**
+ * Parse a script on multiple threads.
+ *
+ * @param source The script.
+ * @param options Parsing options (NULL for defaults).
+ * @param errors Error context that receives all errors.
+ * @return The program node, or NULL if nothing parsed and errors occurred.
+ */
+Node* parse_program_parallel(const char* source, const ParallelParseOptions* options,
+                             ErrorContext* errors) {
+    ParallelParseOptions defaults = {0, 0, false};
+    if (!options)
+        options = &defaults;
+
+    size_t         length = strlen(source);
+    StatementSpan* spans;
+    size_t         span_count = split_statements(source, length, options->case_insensitive, &spans);
+
+    int thread_count = options->thread_count > 0 ? options->thread_count : nsql_cpu_count();
+
+    size_t batch_size = options->batch_size;
+    if (batch_size == 0) {
+        batch_size = length / ((size_t)thread_count * BATCHES_PER_THREAD);
+        batch_size = batch_size < MIN_BATCH_SIZE   ? MIN_BATCH_SIZE
+                     : batch_size > MAX_BATCH_SIZE ? MAX_BATCH_SIZE
+                                                   : batch_size;
+    }
+
+    ParallelJob job;
+    job.source           = source;
+    job.spans            = spans;
+    job.batches          = make_batches(spans, span_count, batch_size, &job.batch_count);
+    job.case_insensitive = options->case_insensitive;
+    atomic_init(&job.next_batch, 0);
+
+    if ((size_t)thread_count > job.batch_count)
+        thread_count = job.batch_count > 0 ? (int)job.batch_count : 1;
+
+    // The calling thread works too, so start one thread fewer than requested
+    NsqlThread* threads = NULL;
+    int         started = 0;
+    if (thread_count > 1) {
+        threads = (NsqlThread*)checked_realloc(NULL, sizeof(NsqlThread) * (thread_count - 1));
+        while (started < thread_count - 1 &&
+               nsql_thread_create(&threads[started], parse_worker, &job)) {
+            started++;
+        }
+    }
+
+    parse_worker(&job);
+
+    for (int i = 0; i < started; i++) {
+        nsql_thread_join(&threads[i]);
+    }
+    free(threads);
+
+    // Merge the batches in source order
+    size_t total = 0;
+    for (size_t i = 0; i < job.batch_count; i++) {
+        total += job.batches[i].count;
+    }
+
+    Node*  program    = (Node*)calloc(1, sizeof(Node));
+    Node** statements = (Node**)malloc((total > 0 ? total : 1) * sizeof(Node*));
+    if (!program || !statements) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    program->type                  = NODE_PROGRAM;
+    program->line                  = span_count > 0 ? spans[0].line : 1;
+    program->as.program.statements = statements;
+    program->as.program.count      = 0;
+
+    bool had_error = false;
+    for (size_t i = 0; i < job.batch_count; i++) {
+        ParseBatch* batch = &job.batches[i];
+
+        // A batch without statements may not have allocated an array
+        if (batch->count > 0) {
+            memcpy(statements + program->as.program.count, batch->statements,
+                   batch->count * sizeof(Node*));
+        }
+        program->as.program.count += (int)batch->count;
+        free(batch->statements);
+
+        const ErrorReport* report = error_context_next(&batch->errors, NULL);
+        for (; report; report = error_context_next(&batch->errors, report)) {
+            if (report->owns_message)
+                report_error(errors, report->severity, report->source, report->line,
+                             report->column, report->message);
+            else
+                report_error_static(errors, report->severity, report->source, report->line,
+                                    report->column, report->message);
+        }
+        had_error = had_error || batch->errors.has_error;
+        error_context_free(&batch->errors);
+    }
+
+    free(job.batches);
+    free(spans);
+
+    // Match parse_program(): no statements and errors means no program
+    if (had_error && program->as.program.count == 0) {
+        free_node(program);
+        return NULL;
+    }
+
+    return program;
+}
@@ -1,2161 +1,2887 @@
-#include <nsql/parser.h>
-#include <stdbool.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Forward parsing function declarations
-static Node* parse_ask_query(Parser* parser);
-static Node* parse_tell_query(Parser* parser);
-static Node* parse_find_query(Parser* parser);
-static Node* parse_show_query(Parser* parser);
-
-static Node* parse_field_list(Parser* parser);
-static Node* parse_source(Parser* parser);
-static Node* parse_join(Parser* parser);
-static Node* parse_condition(Parser* parser);
-static Node* parse_group_by(Parser* parser);
-static Node* parse_order_by(Parser* parser);
-static Node* parse_limit(Parser* parser);
-
-static Node* parse_add_action(Parser* parser);
-static Node* parse_remove_action(Parser* parser);
-static Node* parse_update_action(Parser* parser);
-static Node* parse_create_action(Parser* parser);
-static Node* parse_record_spec(Parser* parser);
-static Node* parse_field_def(Parser* parser);
-static Node* parse_constraint(Parser* parser);
-
-static Node* parse_expression(Parser* parser);
-static Node* parse_logic_or(Parser* parser);
-static Node* parse_logic_and(Parser* parser);
-static Node* parse_equality(Parser* parser);
-static Node* parse_comparison(Parser* parser);
-static Node* parse_term(Parser* parser);
-static Node* parse_factor(Parser* parser);
-static Node* parse_unary(Parser* parser);
-static Node* parse_primary(Parser* parser);
-static Node* parse_function_call(Parser* parser);
-
-// Util functions
-static void        advance(Parser* parser);
-static bool        check(Parser* parser, NsqlTokenType type);
-static bool        match(Parser* parser, NsqlTokenType type);
-static void        consume(Parser* parser, NsqlTokenType type, const char* message);
-static void        error_at_current(Parser* parser, const char* message);
-static void        error_at(Parser* parser, Token* token, const char* message);
-static void        synchronize(Parser* parser);
-static Node*       create_node(NodeType type);
-static char*       copy_token_string(Token* token);
-static const char* token_type_to_op_string(NsqlTokenType type);
-
-/**
- * @brief Formats all parser errors into a single string.
- *
- * Writes a human-readable summary of all errors encountered during parsing into the provided
- * buffer.
- *
- * @param buffer Destination buffer for the formatted error string.
- * @param size Size of the destination buffer in bytes.
- * @return Number of bytes written to the buffer, excluding the null terminator.
- */
-size_t parser_format_errors(Parser* parser, char* buffer, size_t size) {
-    return format_errors(&parser->errors, buffer, size);
-}
-
-/**
- * Formats all parser errors into a JSON string.
- *
- * Writes a JSON representation of the parser's collected errors into the provided buffer.
- *
- * @param buffer Destination buffer for the JSON output.
- * @param size Size of the buffer in bytes.
- * @return Number of bytes written to the buffer, excluding the null terminator.
- */
-size_t parser_format_errors_json(Parser* parser, char* buffer, size_t size) {
-    return format_errors_json(&parser->errors, buffer, size);
-}
-
-/**
- * @brief Initializes a parser for NSQL input using the provided lexer.
- *
- * Sets up the parser state, resets error tracking, initializes the error context, and advances to
- * the first token.
- */
-void parser_init(Parser* parser, Lexer* lexer) {
-    parser->lexer      = lexer;
-    parser->had_error  = false;
-    parser->panic_mode = false;
-
-    // Initialize error context
-    error_context_init(&parser->errors);
-
-    // Prime the parser with the first token
-    advance(parser);
-}
-
-/**
- * Frees resources associated with the parser, including its error context.
- *
- * Call this function to release memory allocated for parser error tracking after parsing is
- * complete.
- */
-void parser_free(Parser* parser) {
-    // Free error context
-    error_context_free(&parser->errors);
-}
-
-/**
- * Advance the parser to the next token.
- *
- * @param parser The parser instance.
- */
-static void advance(Parser* parser) {
-    parser->previous = parser->current;
-
-    for (;;) {
-        parser->current = lexer_next_token(parser->lexer);
-        if (parser->current.type != TOKEN_ERROR)
-            break;
-
-        error_at_current(parser, parser->current.start);
-    }
-}
-
-/**
- * @brief Determines if the current token matches the specified type.
- *
- * @param type The token type to check against the current token.
- * @return true if the current token is of the given type, false otherwise.
- */
-static bool check(Parser* parser, NsqlTokenType type) {
-    return parser->current.type == type;
-}
-
-/**
- * Consumes the current token if it matches the specified type.
- *
- * @param type The token type to match against the current token.
- * @return true if the token was matched and consumed; false otherwise.
- */
-static bool match(Parser* parser, NsqlTokenType type) {
-    if (!check(parser, type))
-        return false;
-    advance(parser);
-    return true;
-}
-
-/**
- * @brief Consumes the current token if it matches the expected type, or reports an error.
- *
- * Advances the parser if the current token matches the specified type; otherwise, reports a parsing
- * error with the given message.
- */
-static void consume(Parser* parser, NsqlTokenType type, const char* message) {
-    if (parser->current.type == type) {
-        advance(parser);
-        return;
-    }
-
-    error_at_current(parser, message);
-}
-
-/**
- * Report error at current token.
- *
- * @param parser The parser instance.
- * @param message The error message.
- */
-static void error_at_current(Parser* parser, const char* message) {
-    error_at(parser, &parser->current, message);
-}
-
-/**
- * Reports a parsing error at the specified token, records it in the parser's error context, and
- * initiates error recovery.
- *
- * Sets the parser into panic mode to prevent cascading errors and triggers synchronization to
- * recover from the error state.
- */
-static void error_at(Parser* parser, Token* token, const char* message) {
-    if (parser->panic_mode)
-        return;
-    parser->panic_mode = true;
-    parser->had_error  = true;
-
-    // Report the error to the error context
-    report_error(&parser->errors, ERROR_ERROR, ERROR_SOURCE_PARSER, token->line,
-                 token->length > 0
-                     ? (int)(token->start - lexer_get_line_start(parser->lexer, token->line))
-                     : 0,
-                 message);
-
-    // Print to stderr for immediate debugging
-    fprintf(stderr, "[line %d] Error", token->line);
-
-    if (token->type == TOKEN_EOF) {
-        fprintf(stderr, " at end");
-    } else if (token->type == TOKEN_ERROR) {
-        // Nothing
-    } else {
-        fprintf(stderr, " at '%.*s'", (int)token->length, token->start);
-    }
-
-    fprintf(stderr, ": %s\n", message);
-
-    // Sync after error
-    synchronize(parser);
-}
-
-/**
- * Synchronize the parser after an error.
- *
- * Compile with -DENABLE_SYNC_RECOVERY=OFF to disable this feature.
- *
- * @param parser The parser instance.
- */
-static void synchronize(Parser* parser) {
-#ifdef ENABLE_SYNC_RECOVERY
-    while (parser->current.type != TOKEN_EOF) {
-        // Skip until we find a query start keyword
-        switch (parser->current.type) {
-            case TOKEN_ASK:
-            case TOKEN_TELL:
-            case TOKEN_FIND:
-            case TOKEN_SHOW:
-            case TOKEN_GET:
-                return;
-            default:;  // Do nothing
-        }
-
-        advance(parser);
-    }
-#endif
-    parser->panic_mode = false;
-}
-
-/**
- * Create a new AST node of the specified type.
- *
- * @param type The type of the node to create.
- * @return A pointer to the newly created node.
- */
-static Node* create_node(NodeType type) {
-    Node* node = (Node*)malloc(sizeof(Node));
-    if (node == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-    memset(node, 0, sizeof(Node));
-    node->type = type;
-    return node;
-}
-
-/**
- * Copy token string to a new memory location.
- *
- * @param token The token to copy.
- */
-static char* copy_token_string(Token* token) {
-    char* str = (char*)malloc(token->length + 1);
-    if (str == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    memcpy(str, token->start, token->length);
-    str[token->length] = '\0';
-    return str;
-}
-
-/**
- * @brief Returns the string representation of an operator token type.
- *
- * Converts a given NsqlTokenType representing an operator to its corresponding string form (e.g.,
- * "+", "AND", "!=").
- *
- * @param type The operator token type.
- * @return The string representation of the operator, or "UNKNOWN" if not recognized.
- */
-static const char* token_type_to_op_string(NsqlTokenType type) {
-    switch (type) {
-        case TOKEN_PLUS:
-            return "+";
-        case TOKEN_MINUS:
-            return "-";
-        case TOKEN_STAR:
-            return "*";
-        case TOKEN_SLASH:
-            return "/";
-        case TOKEN_PERCENT:
-            return "%";
-        case TOKEN_EQUAL:
-            return "=";
-        case TOKEN_GT:
-            return ">";
-        case TOKEN_LT:
-            return "<";
-        case TOKEN_GTE:
-            return ">=";
-        case TOKEN_LTE:
-            return "<=";
-        case TOKEN_NEQ:
-            return "!=";
-        case TOKEN_LIKE:
-            return "LIKE";
-        case TOKEN_AND:
-            return "AND";
-        case TOKEN_OR:
-            return "OR";
-        case TOKEN_NOT:
-            return "NOT";
-        default:
-            return "UNKNOWN";
-    }
-}
-
-/**
- * Parse NSQL query and return the AST root.
- *
- * @param parser The parser instance.
- */
-Node* parse_query(Parser* parser) {
-    if (match(parser, TOKEN_ASK)) {
-        return parse_ask_query(parser);
-    } else if (match(parser, TOKEN_TELL)) {
-        return parse_tell_query(parser);
-    } else if (match(parser, TOKEN_FIND)) {
-        return parse_find_query(parser);
-    } else if (match(parser, TOKEN_SHOW)) {
-        return parse_show_query(parser);
-    } else if (match(parser, TOKEN_GET)) {
-        return parse_show_query(parser);
-    }
-
-    error_at_current(parser, "Expected a query type (ASK, TELL, FIND, SHOW, GET)");
-    return NULL;
-}
-
-// TODO: Shove all of the conditionals into one function, so as to not repeat code
-
-/**
- * Parse ASK query.
- *
- * @param parser The parser instance.
- * @return The AST node representing the ASK query.
- */
-static Node* parse_ask_query(Parser* parser) {
-    Node* node = create_node(NODE_ASK_QUERY);
-    node->line = parser->previous.line;
-
-    // Parse source
-    node->as.ask_query.source = parse_source(parser);
-
-    // Parse FOR clause
-    consume(parser, TOKEN_FOR, "Expected 'FOR' after source in ASK query");
-
-    // Parse field list
-    node->as.ask_query.fields = parse_field_list(parser);
-
-    // Parse optional condition
-    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
-        node->as.ask_query.condition = parse_condition(parser);
-    } else {
-        node->as.ask_query.condition = NULL;
-    }
-
-    // Parse optional GROUP BY
-    if (match(parser, TOKEN_GROUP)) {
-        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
-        node->as.ask_query.group_by = parse_group_by(parser);
-    } else {
-        node->as.ask_query.group_by = NULL;
-    }
-
-    // Parse optional ORDER BY / SORT BY
-    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
-        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
-        node->as.ask_query.order_by = parse_order_by(parser);
-    } else {
-        node->as.ask_query.order_by = NULL;
-    }
-
-    // Parse optional LIMIT
-    if (match(parser, TOKEN_LIMIT)) {
-        node->as.ask_query.limit = parse_limit(parser);
-    } else {
-        node->as.ask_query.limit = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse TELL query.
- *
- * @param parser The parser instance.
- * @return The AST node representing the TELL query.
- */
-static Node* parse_tell_query(Parser* parser) {
-    Node* node = create_node(NODE_TELL_QUERY);
-    node->line = parser->previous.line;
-
-    // Parse source
-    node->as.tell_query.source = parse_source(parser);
-
-    // Parse TO
-    consume(parser, TOKEN_TO, "Expected 'TO' after source in TELL query");
-
-    // Parse action
-    if (match(parser, TOKEN_ADD)) {
-        node->as.tell_query.action = parse_add_action(parser);
-    } else if (match(parser, TOKEN_REMOVE)) {
-        node->as.tell_query.action = parse_remove_action(parser);
-    } else if (match(parser, TOKEN_UPDATE)) {
-        node->as.tell_query.action = parse_update_action(parser);
-    } else if (match(parser, TOKEN_CREATE)) {
-        node->as.tell_query.action = parse_create_action(parser);
-    } else {
-        error_at_current(parser, "Expected action (ADD, REMOVE, UPDATE, CREATE)");
-        return NULL;
-    }
-
-    // Parse optional condition
-    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
-        node->as.tell_query.condition = parse_condition(parser);
-    } else {
-        node->as.tell_query.condition = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse FIND query.
- *
- * @param parser The parser instance.
- * @return The AST node representing the FIND query.
- */
-static Node* parse_find_query(Parser* parser) {
-    Node* node = create_node(NODE_FIND_QUERY);
-    node->line = parser->previous.line;
-
-    // Parse fields
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        // Fields explicitly specified
-        // In FIND queries, the fields are implicit in the source
-        node->as.find_query.source = parse_source(parser);
-    } else {
-        // No fields specified, use implicit source
-        Node* source_node = create_node(NODE_SOURCE);
-        source_node->line = parser->previous.line;
-
-        // Create an implicit "*" identifier
-        Node* id_node                 = create_node(NODE_IDENTIFIER);
-        id_node->line                 = parser->previous.line;
-        id_node->as.identifier.name   = strdup("*");
-        id_node->as.identifier.length = 1;
-
-        source_node->as.source.identifier = id_node;
-        source_node->as.source.join       = NULL;
-
-        node->as.find_query.source = source_node;
-    }
-
-    // Parse IN if present
-    if (match(parser, TOKEN_IN)) {
-        // Replace the source
-        Node* old_source           = node->as.find_query.source;
-        node->as.find_query.source = parse_source(parser);
-        free_node(old_source);
-    }
-
-    // Parse condition
-    if (match(parser, TOKEN_THAT) || match(parser, TOKEN_WHEN) || match(parser, TOKEN_WHERE) ||
-        match(parser, TOKEN_WHICH)) {
-        node->as.find_query.condition = parse_condition(parser);
-    } else {
-        node->as.find_query.condition = NULL;
-    }
-
-    // Parse optional GROUP BY
-    if (match(parser, TOKEN_GROUP)) {
-        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
-        node->as.find_query.group_by = parse_group_by(parser);
-    } else {
-        node->as.find_query.group_by = NULL;
-    }
-
-    // Parse optional ORDER BY / SORT BY
-    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
-        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
-        node->as.find_query.order_by = parse_order_by(parser);
-    } else {
-        node->as.find_query.order_by = NULL;
-    }
-
-    // Parse optional LIMIT
-    if (match(parser, TOKEN_LIMIT)) {
-        node->as.find_query.limit = parse_limit(parser);
-    } else {
-        node->as.find_query.limit = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse SHOW query.
- *
- * @param parser The parser instance.
- * @return The AST node representing the SHOW query.
- */
-static Node* parse_show_query(Parser* parser) {
-    Node* node = create_node(NODE_SHOW_QUERY);
-    node->line = parser->previous.line;
-
-    // Skip optional ME
-    match(parser, TOKEN_IDENTIFIER);  // Just consume "ME" if present
-
-    // Parse field list
-    node->as.show_query.fields = parse_field_list(parser);
-
-    // Parse FROM
-    consume(parser, TOKEN_FROM, "Expected 'FROM' after fields in SHOW query");
-
-    // Parse source
-    node->as.show_query.source = parse_source(parser);
-
-    // Parse optional condition
-    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
-        node->as.show_query.condition = parse_condition(parser);
-    } else {
-        node->as.show_query.condition = NULL;
-    }
-
-    // Parse optional GROUP BY
-    if (match(parser, TOKEN_GROUP)) {
-        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
-        node->as.show_query.group_by = parse_group_by(parser);
-    } else {
-        node->as.show_query.group_by = NULL;
-    }
-
-    // Parse optional ORDER BY / SORT BY
-    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
-        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
-        node->as.show_query.order_by = parse_order_by(parser);
-    } else {
-        node->as.show_query.order_by = NULL;
-    }
-
-    // Parse optional LIMIT
-    if (match(parser, TOKEN_LIMIT)) {
-        node->as.show_query.limit = parse_limit(parser);
-    } else {
-        node->as.show_query.limit = NULL;
-    }
-
-    return node;
-}
-
-#if 0
-/**
- * Parse GET query
- *
- * @param parser The parser instance.
- * @return The AST node representing the GET query.
- */
-static Node* parse_get_query(Parser* parser) {
-    Node* node = create_node(NODE_GET_QUERY);
-    node->line = parser->previous.line;
-
-    // Parse field list
-    node->as.get_query.fields = parse_field_list(parser);
-
-    // Parse FROM
-    consume(parser, TOKEN_FROM, "Expected 'FROM' after fields in GET query");
-
-    // Parse source
-    node->as.get_query.source = parse_source(parser);
-
-    // Parse optional condition
-    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
-        node->as.get_query.condition = parse_condition(parser);
-    } else {
-        node->as.get_query.condition = NULL;
-    }
-
-    // Parse optional GROUP BY
-    if (match(parser, TOKEN_GROUP)) {
-        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
-        node->as.get_query.group_by = parse_group_by(parser);
-    } else {
-        node->as.get_query.group_by = NULL;
-    }
-
-    // Parse optional ORDER BY / SORT BY
-    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
-        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
-        node->as.get_query.order_by = parse_order_by(parser);
-    } else {
-        node->as.get_query.order_by = NULL;
-    }
-
-    // Parse optional LIMIT
-    if (match(parser, TOKEN_LIMIT)) {
-        node->as.get_query.limit = parse_limit(parser);
-    } else {
-        node->as.get_query.limit = NULL;
-    }
-
-    return node;
-}
-#endif
-
-/**
- * Parse field list.
- *
- * @param parser The parser instance.
- * @return The AST node representing the field list.
- */
-static Node* parse_field_list(Parser* parser) {
-    Node* node = create_node(NODE_FIELD_LIST);
-    node->line = parser->previous.line;
-
-    // Allocate initial space for fields
-    int capacity               = 4;
-    node->as.field_list.fields = (Node**)malloc(capacity * sizeof(Node*));
-    if (node->as.field_list.fields == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    node->as.field_list.count = 0;
-
-    // Parse first field
-    if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
-        Node* field                 = create_node(NODE_IDENTIFIER);
-        field->line                 = parser->current.line;
-        field->as.identifier.length = parser->current.length;
-        field->as.identifier.name   = copy_token_string(&parser->current);
-
-        node->as.field_list.fields[node->as.field_list.count++] = field;
-        advance(parser);
-
-        // Parse additional fields separated by commas
-        while (match(parser, TOKEN_COMMA)) {
-            if (node->as.field_list.count >= capacity) {
-                capacity *= 2;
-                node->as.field_list.fields =
-                    (Node**)realloc(node->as.field_list.fields, capacity * sizeof(Node*));
-                if (node->as.field_list.fields == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
-                field                       = create_node(NODE_IDENTIFIER);
-                field->line                 = parser->current.line;
-                field->as.identifier.length = parser->current.length;
-                field->as.identifier.name   = copy_token_string(&parser->current);
-
-                node->as.field_list.fields[node->as.field_list.count++] = field;
-                advance(parser);
-            } else {
-                error_at_current(parser, "Expected identifier or string after comma");
-                break;
-            }
-        }
-    } else {
-        error_at_current(parser, "Expected identifier or string for field list");
-    }
-
-    return node;
-}
-
-/**
- * Parse a source.
- *
- * @param parser The parser instance.
- * @return The AST node representing the source.
- */
-static Node* parse_source(Parser* parser) {
-    Node* node = create_node(NODE_SOURCE);
-    node->line = parser->previous.line;
-
-    // Parse identifier or string
-    if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
-        node->as.source.identifier                       = create_node(NODE_IDENTIFIER);
-        node->as.source.identifier->line                 = parser->current.line;
-        node->as.source.identifier->as.identifier.length = parser->current.length;
-        node->as.source.identifier->as.identifier.name   = copy_token_string(&parser->current);
-
-        advance(parser);
-
-        // Check for JOIN
-        if (match(parser, TOKEN_AND) || match(parser, TOKEN_WITH)) {
-            node->as.source.join = parse_join(parser);
-        } else {
-            node->as.source.join = NULL;
-        }
-    } else {
-        error_at_current(parser, "Expected identifier or string for source");
-    }
-
-    return node;
-}
-
-/**
- * Parse WITH (JOIN) clause.
- *
- * @param parser The parser instance.
- * @return The AST node representing the JOIN clause.
- */
-static Node* parse_join(Parser* parser) {
-    Node* node = create_node(NODE_JOIN);
-    node->line = parser->previous.line;
-
-    // Parse the joined source
-    node->as.join.source = parse_source(parser);
-
-    // Parse join condition
-    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_WHERE)) {
-        node->as.join.condition = parse_condition(parser);
-    } else {
-        error_at_current(parser, "Expected 'WHEN' or 'WHERE' after join source");
-    }
-
-    return node;
-}
-
-/**
- * Parse condition (WHERE clause).
- *
- * @param parser The parser instance.
- * @return The AST node representing the condition.
- */
-static Node* parse_condition(Parser* parser) {
-    return parse_expression(parser);
-}
-
-/**
- * Parse GROUP BY clause.
- *
- * @param parser The parser instance.
- * @return The AST node representing the GROUP BY clause.
- */
-static Node* parse_group_by(Parser* parser) {
-    Node* node = create_node(NODE_GROUP_BY);
-    node->line = parser->previous.line;
-
-    // Parse fields to group by
-    node->as.group_by.fields = parse_field_list(parser);
-
-    // Parse optional HAVING clause
-    if (match(parser, TOKEN_HAVING)) {
-        node->as.group_by.having = parse_condition(parser);
-    } else {
-        node->as.group_by.having = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse ORDER BY / SORT BY clause.
- *
- * @param parser The parser instance.
- * @return The AST node representing the ORDER BY / SORT BY clause.
- */
-static Node* parse_order_by(Parser* parser) {
-    Node* node = create_node(NODE_ORDER_BY);
-    node->line = parser->previous.line;
-
-    // Allocate initial space for sort fields
-    int capacity                = 4;
-    node->as.order_by.fields    = (Node**)malloc(capacity * sizeof(Node*));
-    node->as.order_by.ascending = (bool*)malloc(capacity * sizeof(bool));
-
-    if (node->as.order_by.fields == NULL || node->as.order_by.ascending == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    node->as.order_by.count = 0;
-
-    // Parse first field
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        Node* field                 = create_node(NODE_IDENTIFIER);
-        field->line                 = parser->current.line;
-        field->as.identifier.length = parser->current.length;
-        field->as.identifier.name   = copy_token_string(&parser->current);
-
-        node->as.order_by.fields[node->as.order_by.count] = field;
-
-        // Default to ascending order
-        node->as.order_by.ascending[node->as.order_by.count] = true;
-
-        advance(parser);
-
-        // Check for ASC/DESC
-        if (match(parser, TOKEN_IDENTIFIER)) {
-            // Compare with "ASC" or "DESC"
-            if (parser->previous.length == 3 && strncmp(parser->previous.start, "ASC", 3) == 0) {
-                node->as.order_by.ascending[node->as.order_by.count] = true;
-            } else if (parser->previous.length == 4 &&
-                       strncmp(parser->previous.start, "DESC", 4) == 0) {
-                node->as.order_by.ascending[node->as.order_by.count] = false;
-            } else {
-                // Not ASC or DESC, must be another field
-                error_at_current(parser, "Expected 'ASC', 'DESC', or ','");
-            }
-        }
-
-        node->as.order_by.count++;
-
-        // Parse additional sort fields
-        while (match(parser, TOKEN_COMMA)) {
-            if (node->as.order_by.count >= capacity) {
-                capacity *= 2;
-                node->as.order_by.fields =
-                    (Node**)realloc(node->as.order_by.fields, capacity * sizeof(Node*));
-                node->as.order_by.ascending =
-                    (bool*)realloc(node->as.order_by.ascending, capacity * sizeof(bool));
-                if (node->as.order_by.fields == NULL || node->as.order_by.ascending == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            if (check(parser, TOKEN_IDENTIFIER)) {
-                field                       = create_node(NODE_IDENTIFIER);
-                field->line                 = parser->current.line;
-                field->as.identifier.length = parser->current.length;
-                field->as.identifier.name   = copy_token_string(&parser->current);
-
-                node->as.order_by.fields[node->as.order_by.count] = field;
-
-                // Default to ascending order
-                node->as.order_by.ascending[node->as.order_by.count] = true;
-
-                advance(parser);
-
-                // Check for ASC/DESC
-                if (match(parser, TOKEN_IDENTIFIER)) {
-                    // Compare with "ASC" or "DESC"
-                    if (parser->previous.length == 3 &&
-                        strncmp(parser->previous.start, "ASC", 3) == 0) {
-                        node->as.order_by.ascending[node->as.order_by.count] = true;
-                    } else if (parser->previous.length == 4 &&
-                               strncmp(parser->previous.start, "DESC", 4) == 0) {
-                        node->as.order_by.ascending[node->as.order_by.count] = false;
-                    } else {
-                        // Not ASC or DESC, must be another field
-                        error_at_current(parser, "Expected 'ASC', 'DESC', or ','");
-                    }
-                }
-
-                node->as.order_by.count++;
-            } else {
-                error_at_current(parser, "Expected identifier after comma in ORDER BY clause");
-                break;
-            }
-        }
-    } else {
-        error_at_current(parser, "Expected identifier for ORDER BY clause");
-    }
-
-    return node;
-}
-
-/**
- * Parse LIMIT clause.
- *
- * @param parser The parser instance.
- * @return The AST node representing the LIMIT clause.
- */
-static Node* parse_limit(Parser* parser) {
-    Node* node = create_node(NODE_LIMIT);
-    node->line = parser->previous.line;
-
-    // Parse limit value
-    if (check(parser, TOKEN_INTEGER)) {
-        char* end;
-        node->as.limit.limit = (int)strtol(parser->current.start, &end, 10);
-        advance(parser);
-    } else {
-        error_at_current(parser, "Expected integer for LIMIT clause");
-    }
-
-    // Parse optional OFFSET
-    if (match(parser, TOKEN_IDENTIFIER) && parser->previous.length == 6 &&
-        strncmp(parser->previous.start, "OFFSET", 6) == 0) {
-        if (check(parser, TOKEN_INTEGER)) {
-            char* end;
-            node->as.limit.offset = (int)strtol(parser->current.start, &end, 10);
-            advance(parser);
-        } else {
-            error_at_current(parser, "Expected integer for OFFSET clause");
-        }
-    } else {
-        node->as.limit.offset = 0;
-    }
-
-    return node;
-}
-
-/**
- * Parse ADD action.
- *
- * @param parser The parser instance.
- * @return The AST node representing the ADD action.
- */
-static Node* parse_add_action(Parser* parser) {
-    Node* node = create_node(NODE_ADD_ACTION);
-    node->line = parser->previous.line;
-
-    // Parse value to add
-    node->as.add_action.value = parse_expression(parser);
-
-    // Parse optional record specifications
-    if (match(parser, TOKEN_WITH)) {
-        node->as.add_action.record_spec = parse_record_spec(parser);
-    } else {
-        node->as.add_action.record_spec = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse REMOVE action.
- *
- * @param parser The parser instance.
- * @return The AST node representing the REMOVE action.
- */
-static Node* parse_remove_action(Parser* parser) {
-    Node* node = create_node(NODE_REMOVE_ACTION);
-    node->line = parser->previous.line;
-
-    // Parse optional condition (if no condition, remove all)
-    if (check(parser, TOKEN_WHEN) || check(parser, TOKEN_IF) || check(parser, TOKEN_WHERE)) {
-        node->as.remove_action.condition = parse_condition(parser);
-    } else {
-        node->as.remove_action.condition = NULL;
-    }
-
-    return node;
-}
-
-/**
- * Parse UPDATE action.
- *
- * @param parser The parser instance.
- * @return The AST node representing the UPDATE action.
- */
-static Node* parse_update_action(Parser* parser) {
-    Node* node = create_node(NODE_UPDATE_ACTION);
-    node->line = parser->previous.line;
-
-    // Allocate initial space for field/value pairs
-    int capacity                  = 4;
-    node->as.update_action.fields = (Node**)malloc(capacity * sizeof(Node*));
-    node->as.update_action.values = (Node**)malloc(capacity * sizeof(Node*));
-
-    if (node->as.update_action.fields == NULL || node->as.update_action.values == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    node->as.update_action.count = 0;
-
-    // Parse first field=value pair
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        Node* field                 = create_node(NODE_IDENTIFIER);
-        field->line                 = parser->current.line;
-        field->as.identifier.length = parser->current.length;
-        field->as.identifier.name   = copy_token_string(&parser->current);
-
-        node->as.update_action.fields[node->as.update_action.count] = field;
-
-        advance(parser);
-        consume(parser, TOKEN_EQUAL, "Expected '=' after field name");
-
-        node->as.update_action.values[node->as.update_action.count] = parse_expression(parser);
-        node->as.update_action.count++;
-
-        // Parse additional field=value pairs
-        while (match(parser, TOKEN_COMMA)) {
-            if (node->as.update_action.count >= capacity) {
-                capacity *= 2;
-                node->as.update_action.fields =
-                    (Node**)realloc(node->as.update_action.fields, capacity * sizeof(Node*));
-                node->as.update_action.values =
-                    (Node**)realloc(node->as.update_action.values, capacity * sizeof(Node*));
-                if (node->as.update_action.fields == NULL ||
-                    node->as.update_action.values == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            if (check(parser, TOKEN_IDENTIFIER)) {
-                field                       = create_node(NODE_IDENTIFIER);
-                field->line                 = parser->current.line;
-                field->as.identifier.length = parser->current.length;
-                field->as.identifier.name   = copy_token_string(&parser->current);
-
-                node->as.update_action.fields[node->as.update_action.count] = field;
-
-                advance(parser);
-                consume(parser, TOKEN_EQUAL, "Expected '=' after field name");
-
-                node->as.update_action.values[node->as.update_action.count] =
-                    parse_expression(parser);
-                node->as.update_action.count++;
-            } else {
-                error_at_current(parser, "Expected identifier after comma in UPDATE action");
-                break;
-            }
-        }
-    } else {
-        error_at_current(parser, "Expected identifier for UPDATE action");
-    }
-
-    return node;
-}
-
-/**
- * Parse CREATE action.
- *
- * @param parser The parser instance.
- * @return The AST node representing the CREATE action.
- */
-static Node* parse_create_action(Parser* parser) {
-    Node* node = create_node(NODE_CREATE_ACTION);
-    node->line = parser->previous.line;
-
-    // Allocate initial space for field definitions
-    int capacity                      = 4;
-    node->as.create_action.field_defs = (Node**)malloc(capacity * sizeof(Node*));
-
-    if (node->as.create_action.field_defs == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    node->as.create_action.count = 0;
-
-    // Parse first field definition
-    Node* field_def                                                   = parse_field_def(parser);
-    node->as.create_action.field_defs[node->as.create_action.count++] = field_def;
-
-    // Parse additional field definitions
-    while (match(parser, TOKEN_COMMA)) {
-        if (node->as.create_action.count >= capacity) {
-            capacity *= 2;
-            node->as.create_action.field_defs =
-                (Node**)realloc(node->as.create_action.field_defs, capacity * sizeof(Node*));
-            if (node->as.create_action.field_defs == NULL) {
-                fprintf(stderr, "Error: Out of memory\n");
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        field_def                                                         = parse_field_def(parser);
-        node->as.create_action.field_defs[node->as.create_action.count++] = field_def;
-    }
-
-    return node;
-}
-
-/**
- * Parse record specification.
- *
- * @param parser The parser instance.
- * @return The AST node representing the record specification.
- */
-static Node* parse_record_spec(Parser* parser) {
-    // TODO: Implement record specification parsing
-    return parse_field_list(parser);
-}
-
-/**
- * Parse field definition.
- *
- * @param parser The parser instance.
- * @return The AST node representing the field definition.
- */
-static Node* parse_field_def(Parser* parser) {
-    Node* node = create_node(NODE_FIELD_DEF);
-    node->line = parser->previous.line;
-
-    // Parse field name
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        node->as.field_def.name                       = create_node(NODE_IDENTIFIER);
-        node->as.field_def.name->line                 = parser->current.line;
-        node->as.field_def.name->as.identifier.length = parser->current.length;
-        node->as.field_def.name->as.identifier.name   = copy_token_string(&parser->current);
-
-        advance(parser);
-    } else {
-        error_at_current(parser, "Expected identifier for field name");
-    }
-
-    // Parse optional type
-    if (match(parser, TOKEN_AS)) {
-        if (check(parser, TOKEN_IDENTIFIER)) {
-            node->as.field_def.type = copy_token_string(&parser->current);
-            advance(parser);
-        } else {
-            error_at_current(parser, "Expected identifier for field type");
-        }
-    } else {
-        node->as.field_def.type = NULL;
-    }
-
-    // Parse optional constraints
-    if (match(parser, TOKEN_LPAREN)) {
-        // Allocate initial space for constraints
-        int capacity                   = 4;
-        node->as.field_def.constraints = (Node**)malloc(capacity * sizeof(Node*));
-
-        if (node->as.field_def.constraints == NULL) {
-            fprintf(stderr, "Error: Out of memory\n");
-            exit(EXIT_FAILURE);
-        }
-
-        node->as.field_def.constraint_count = 0;
-
-        // Parse first constrain
-        Node* constraint = parse_constraint(parser);
-        node->as.field_def.constraints[node->as.field_def.constraint_count++] = constraint;
-
-        // Parse additional constraints
-        while (match(parser, TOKEN_COMMA)) {
-            if (node->as.field_def.constraint_count >= capacity) {
-                capacity *= 2;
-                node->as.field_def.constraints =
-                    (Node**)realloc(node->as.field_def.constraints, capacity * sizeof(Node*));
-                if (node->as.field_def.constraints == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            constraint = parse_constraint(parser);
-            node->as.field_def.constraints[node->as.field_def.constraint_count++] = constraint;
-        }
-
-        consume(parser, TOKEN_RPAREN, "Expected ')' after field constraints");
-    } else {
-        node->as.field_def.constraints      = NULL;  // No constraints specified
-        node->as.field_def.constraint_count = 0;
-    }
-
-    return node;
-}
-
-/**
- * Parse constraint.
- *
- * @param parser The parser instance.
- * @return The AST node representing the constraint.
- */
-static Node* parse_constraint(Parser* parser) {
-    Node* node = create_node(NODE_CONSTRAINT);
-    node->line = parser->previous.line;
-
-    // Parse constraint type
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        if (parser->current.length == 8 && strncmp(parser->current.start, "REQUIRED", 8) == 0) {
-            node->as.constraint.type          = CONSTRAINT_REQUIRED;
-            node->as.constraint.default_value = NULL;
-            advance(parser);
-        } else if (parser->current.length == 6 &&
-                   strncmp(parser->current.start, "UNIQUE", 6) == 0) {
-            node->as.constraint.type          = CONSTRAINT_UNIQUE;
-            node->as.constraint.default_value = NULL;
-            advance(parser);
-        } else if (parser->current.length == 7 &&
-                   strncmp(parser->current.start, "DEFAULT", 7) == 0) {
-            node->as.constraint.type = CONSTRAINT_DEFAULT;
-            advance(parser);
-
-            // Parse default value
-            node->as.constraint.default_value = parse_expression(parser);
-        } else {
-            error_at_current(parser, "Expected constraint type (REQUIRED, UNIQUE, DEFAULT)");
-        }
-    } else {
-        error_at_current(parser, "Expected constraint type");
-    }
-
-    return node;
-}
-
-/**
- * Parse expression (for WHERE, HAVING, etc.).
- *
- * @param parser The parser instance.
- * @return The AST node representing the expression.
- */
-static Node* parse_expression(Parser* parser) {
-    return parse_logic_or(parser);
-}
-
-/**
- * @brief Parses a logical OR expression and constructs the corresponding AST node.
- *
- * Parses left-associative logical OR (`OR`) expressions, combining sub-expressions into a binary
- * expression tree.
- *
- * @return Pointer to the AST node representing the logical OR expression.
- */
-static Node* parse_logic_or(Parser* parser) {
-    Node* left = parse_logic_and(parser);
-
-    while (match(parser, TOKEN_OR)) {
-        NsqlTokenType op           = parser->previous.type;
-        Node*         right        = parse_logic_and(parser);
-        Node*         node         = create_node(NODE_BINARY_EXPR);
-        node->line                 = parser->previous.line;
-        node->as.binary_expr.left  = left;
-        node->as.binary_expr.right = right;
-        node->as.binary_expr.op    = op;
-
-        left = node;
-    }
-
-    return left;
-}
-
-/**
- * @brief Parses a logical AND expression and constructs the corresponding AST node.
- *
- * Parses left-associative logical AND operations, combining equality expressions into a binary
- * expression tree.
- *
- * @param parser The parser instance.
- * @return Node* The AST node representing the logical AND expression.
- */
-static Node* parse_logic_and(Parser* parser) {
-    Node* left = parse_equality(parser);
-
-    while (match(parser, TOKEN_AND)) {
-        NsqlTokenType op           = parser->previous.type;
-        Node*         right        = parse_equality(parser);
-        Node*         node         = create_node(NODE_BINARY_EXPR);
-        node->line                 = parser->previous.line;
-        node->as.binary_expr.left  = left;
-        node->as.binary_expr.right = right;
-        node->as.binary_expr.op    = op;
-
-        left = node;
-    }
-
-    return left;
-}
-
-/**
- * Parses an equality or inequality expression and constructs the corresponding AST node.
- *
- * Supports chaining of equality (`=`) and inequality (`!=`) operators, producing a left-associative
- * binary expression tree.
- *
- * @return The root AST node representing the parsed equality expression.
- */
-static Node* parse_equality(Parser* parser) {
-    Node* left = parse_comparison(parser);
-
-    while (match(parser, TOKEN_EQUAL) || match(parser, TOKEN_NEQ)) {
-        NsqlTokenType op           = parser->previous.type;
-        Node*         right        = parse_comparison(parser);
-        Node*         node         = create_node(NODE_BINARY_EXPR);
-        node->line                 = parser->previous.line;
-        node->as.binary_expr.left  = left;
-        node->as.binary_expr.right = right;
-        node->as.binary_expr.op    = op;
-
-        left = node;
-    }
-
-    return left;
-}
-
-/**
- * Parses a comparison expression with relational operators (<, <=, >, >=).
- *
- * @return An AST node representing the parsed comparison expression, or a simpler term if no
- * comparison operator is present.
- */
-static Node* parse_comparison(Parser* parser) {
-    Node* left = parse_term(parser);
-
-    while (match(parser, TOKEN_LT) || match(parser, TOKEN_LTE) || match(parser, TOKEN_GT) ||
-           match(parser, TOKEN_GTE)) {
-        NsqlTokenType op           = parser->previous.type;
-        Node*         right        = parse_term(parser);
-        Node*         node         = create_node(NODE_BINARY_EXPR);
-        node->line                 = parser->previous.line;
-        node->as.binary_expr.left  = left;
-        node->as.binary_expr.right = right;
-        node->as.binary_expr.op    = op;
-
-        left = node;
-    }
-
-    return left;
-}
-
-/**
- * @brief Parses an addition or subtraction expression.
- *
- * Parses a term consisting of one or more factors combined with '+' or '-' operators, constructing
- * a left-associative binary expression AST node.
- *
- * @param parser Parser instance.
- * @return Node* AST node representing the parsed term expression.
- */
-static Node* parse_term(Parser* parser) {
-    Node* left = parse_factor(parser);
-
-    while (match(parser, TOKEN_PLUS) || match(parser, TOKEN_MINUS)) {
-        NsqlTokenType op           = parser->previous.type;
-        Node*         right        = parse_factor(parser);
-        Node*         node         = create_node(NODE_BINARY_EXPR);
-        node->line                 = parser->previous.line;
-        node->as.binary_expr.left  = left;
-        node->as.binary_expr.right = right;
-        node->as.binary_expr.op    = op;
-
-        left = node;
-    }
-
-    return left;
-}
-
-/**
- * @brief Parses a factor expression involving multiplication, division, or modulo.
- *
- * Parses left-associative binary expressions with '*', '/', or '%' operators, building the
- * corresponding AST subtree.
- *
- * @param parser The parser instance.
- * @return Node* The AST node representing the parsed factor expression.
- */
-static Node* parse_factor(Parser* parser) {
-    Node* left = parse_unary(parser);
-
-    while (match(parser, TOKEN_STAR) || match(parser, TOKEN_SLASH) ||
-           match(parser, TOKEN_PERCENT)) {
-        NsqlTokenType op    = parser->previous.type;
-        Node*         right = parse_unary(parser);
-
-        Node* binary                 = create_node(NODE_BINARY_EXPR);
-        binary->line                 = left->line;
-        binary->as.binary_expr.left  = left;
-        binary->as.binary_expr.op    = op;
-        binary->as.binary_expr.right = right;
-        left                         = binary;
-    }
-
-    return left;
-}
-
-/**
- * Parses a unary expression, handling logical NOT and negation operators.
- *
- * Returns an AST node representing either a unary operation or a primary expression if no unary
- * operator is present.
- *
- * @return Node* The AST node for the parsed unary expression.
- */
-static Node* parse_unary(Parser* parser) {
-    if (match(parser, TOKEN_NOT) || match(parser, TOKEN_MINUS)) {
-        NsqlTokenType op    = parser->previous.type;
-        Node*         right = parse_unary(parser);
-
-        Node* unary                  = create_node(NODE_UNARY_EXPR);
-        unary->line                  = parser->previous.line;
-        unary->as.unary_expr.op      = op;
-        unary->as.unary_expr.operand = right;
-        return unary;
-    }
-
-    return parse_primary(parser);
-}
-
-/**
- * Parse primary expression (identifiers, literals, etc.).
- *
- * @param parser The parser instance.
- * @return The AST node representing the primary expression.
- */
-static Node* parse_primary(Parser* parser) {
-    if (match(parser, TOKEN_STRING)) {
-        Node* node                    = create_node(NODE_LITERAL);
-        node->line                    = parser->previous.line;
-        node->as.literal.literal_type = TOKEN_STRING;
-
-        // Extract string value (excluding quotes)
-        int length                          = parser->previous.length - 2;  // Exclude quotes
-        node->as.literal.value.string_value = (char*)malloc(length + 1);
-        if (node->as.literal.value.string_value == NULL) {
-            fprintf(stderr, "Error: Out of memory\n");
-            exit(EXIT_FAILURE);
-        }
-
-        memcpy(node->as.literal.value.string_value, parser->previous.start + 1,
-               length);  // Skip opening quote
-        node->as.literal.value.string_value[length] = '\0';
-
-        return node;
-    }
-
-    if (match(parser, TOKEN_INTEGER)) {
-        Node* node                    = create_node(NODE_LITERAL);
-        node->line                    = parser->previous.line;
-        node->as.literal.literal_type = TOKEN_INTEGER;
-
-        // Convert string to integer
-        char* end;
-        node->as.literal.value.number_value = (int)strtol(parser->previous.start, &end, 10);
-
-        return node;
-    }
-
-    if (match(parser, TOKEN_DECIMAL)) {
-        Node* node                    = create_node(NODE_LITERAL);
-        node->line                    = parser->previous.line;
-        node->as.literal.literal_type = TOKEN_DECIMAL;
-
-        // Convert string to decimal
-        char* end;
-        node->as.literal.value.number_value = strtod(parser->previous.start, &end);
-        return node;
-    }
-
-    if (check(parser, TOKEN_IDENTIFIER)) {
-        // Check if it's a function call or just an identifier
-        Token id_token = parser->current;
-        advance(parser);
-
-        if (check(parser, TOKEN_LPAREN)) {
-            // Function call
-            parser->lexer->current = parser->lexer->start + (id_token.start - parser->lexer->start);
-            parser->current        = id_token;
-            return parse_function_call(parser);
-        } else {
-            Node* node                 = create_node(NODE_IDENTIFIER);
-            node->line                 = id_token.line;
-            node->as.identifier.length = id_token.length;
-            node->as.identifier.name   = (char*)malloc(id_token.length + 1);
-            if (node->as.identifier.name == NULL) {
-                fprintf(stderr, "Error: Out of memory\n");
-                exit(EXIT_FAILURE);
-            }
-
-            memcpy(node->as.identifier.name, id_token.start, id_token.length);
-            node->as.identifier.name[id_token.length] = '\0';  // Null-terminate the string
-
-            return node;
-        }
-    }
-
-    if (match(parser, TOKEN_LPAREN)) {
-        Node* expr = parse_expression(parser);
-        consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
-        return expr;
-    }
-
-    error_at_current(parser, "Expected expression");
-    return NULL;
-}
-
-/**
- * Parse function call.
- *
- * @param parser The parser instance.
- * @return The AST node representing the function call.
- */
-static Node* parse_function_call(Parser* parser) {
-    Node* node = create_node(NODE_FUNCTION_CALL);
-    node->line = parser->current.line;
-
-    // Parse function name
-    node->as.function_call.name = copy_token_string(&parser->current);
-    advance(parser);
-
-    // Parse opening parenthesis
-    consume(parser, TOKEN_LPAREN, "Expected '(' after function name");
-
-    // Parse arguments
-    int capacity                = 4;
-    node->as.function_call.args = (Node**)malloc(sizeof(Node*) * capacity);
-
-    if (node->as.function_call.args == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        exit(EXIT_FAILURE);
-    }
-
-    node->as.function_call.arg_count = 0;
-
-    // Check for arguments
-    if (!check(parser, TOKEN_RPAREN)) {
-        // Parse first argument
-        node->as.function_call.args[node->as.function_call.arg_count++] = parse_expression(parser);
-
-        // Parse additional arguments
-        while (match(parser, TOKEN_COMMA)) {
-            if (node->as.function_call.arg_count >= capacity) {
-                capacity *= 2;
-                node->as.function_call.args =
-                    (Node**)realloc(node->as.function_call.args, sizeof(Node*) * capacity);
-                if (node->as.function_call.args == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-
-            node->as.function_call.args[node->as.function_call.arg_count++] =
-                parse_expression(parser);
-        }
-    }
-
-    // Parse closing parenthesis
-    consume(parser, TOKEN_RPAREN, "Expected ')' after function arguments");
-
-    return node;
-}
-
-/**
- * Free AST nodes based on type.
- *
- * @param node The AST node to free.
- */
-void free_node(Node* node) {
-    if (node == NULL)
-        return;
-
-    switch (node->type) {
-        case NODE_ASK_QUERY:
-            free_node(node->as.ask_query.source);
-            free_node(node->as.ask_query.fields);
-            free_node(node->as.ask_query.condition);
-            free_node(node->as.ask_query.group_by);
-            free_node(node->as.ask_query.order_by);
-            free_node(node->as.ask_query.limit);
-            break;
-
-        case NODE_TELL_QUERY:
-            free_node(node->as.tell_query.source);
-            free_node(node->as.tell_query.action);
-            free_node(node->as.tell_query.condition);
-            break;
-
-        case NODE_FIND_QUERY:
-            free_node(node->as.find_query.source);
-            free_node(node->as.find_query.condition);
-            free_node(node->as.find_query.group_by);
-            free_node(node->as.find_query.order_by);
-            free_node(node->as.find_query.limit);
-            break;
-
-        case NODE_SHOW_QUERY:
-        case NODE_GET_QUERY:
-            free_node(node->as.show_query.source);
-            free_node(node->as.show_query.fields);
-            free_node(node->as.show_query.condition);
-            free_node(node->as.show_query.group_by);
-            free_node(node->as.show_query.order_by);
-            free_node(node->as.show_query.limit);
-            break;
-
-        case NODE_FIELD_LIST:
-            for (int i = 0; i < node->as.field_list.count; i++) {
-                free_node(node->as.field_list.fields[i]);
-            }
-            free(node->as.field_list.fields);
-            break;
-
-        case NODE_SOURCE:
-            free_node(node->as.source.identifier);
-            free_node(node->as.source.join);
-            break;
-
-        case NODE_JOIN:
-            free_node(node->as.join.source);
-            free_node(node->as.join.condition);
-            break;
-
-        case NODE_GROUP_BY:
-            free_node(node->as.group_by.fields);
-            free_node(node->as.group_by.having);
-            break;
-
-        case NODE_ORDER_BY:
-            for (int i = 0; i < node->as.order_by.count; i++) {
-                free_node(node->as.order_by.fields[i]);
-            }
-            free(node->as.order_by.fields);
-            free(node->as.order_by.ascending);
-            break;
-
-        case NODE_ADD_ACTION:
-            free_node(node->as.add_action.value);
-            free_node(node->as.add_action.record_spec);
-            break;
-
-        case NODE_REMOVE_ACTION:
-            free_node(node->as.remove_action.condition);
-            break;
-
-        case NODE_UPDATE_ACTION:
-            for (int i = 0; i < node->as.update_action.count; i++) {
-                free_node(node->as.update_action.fields[i]);
-                free_node(node->as.update_action.values[i]);
-            }
-            free(node->as.update_action.fields);
-            free(node->as.update_action.values);
-            break;
-
-        case NODE_CREATE_ACTION:
-            for (int i = 0; i < node->as.create_action.count; i++) {
-                free_node(node->as.create_action.field_defs[i]);
-            }
-            free(node->as.create_action.field_defs);
-            break;
-
-        case NODE_BINARY_EXPR:
-            free_node(node->as.binary_expr.left);
-            free_node(node->as.binary_expr.right);
-            break;
-
-        case NODE_UNARY_EXPR:
-            free_node(node->as.unary_expr.operand);
-            break;
-
-        case NODE_IDENTIFIER:
-            free(node->as.identifier.name);
-            break;
-
-        case NODE_FUNCTION_CALL:
-            free(node->as.function_call.name);
-            for (int i = 0; i < node->as.function_call.arg_count; i++) {
-                free_node(node->as.function_call.args[i]);
-            }
-            free(node->as.function_call.args);
-            break;
-
-        case NODE_LITERAL:
-            if (node->as.literal.literal_type == TOKEN_STRING) {
-                free(node->as.literal.value.string_value);
-            }
-            break;
-
-        case NODE_FIELD_DEF:
-            free_node(node->as.field_def.name);
-            if (node->as.field_def.type != NULL) {
-                free(node->as.field_def.type);
-            }
-            if (node->as.field_def.constraints != NULL) {
-                for (int i = 0; i < node->as.field_def.constraint_count; i++) {
-                    free_node(node->as.field_def.constraints[i]);
-                }
-                free(node->as.field_def.constraints);
-            }
-            break;
-
-        case NODE_CONSTRAINT:
-            free_node(node->as.constraint.default_value);
-            break;
-
-        case NODE_ERROR:
-            free(node->as.error.message);
-            break;
-
-        case NODE_PROGRAM:
-            for (int i = 0; i < node->as.program.count; i++) {
-                free_node(node->as.program.statements[i]);
-            }
-            free(node->as.program.statements);
-            break;
-
-        default:
-            break;
-    }
-
-    free(node);
-}
-
-/**
- * Helper for printing indentation.
- *
- * @param indent The indentation level.
- */
-static void print_indent(int indent) {
-    for (int i = 0; i < indent; i++) {
-        printf("  ");
-    }
-}
-
-/**
- * Print AST for debugging.
- *
- * @param node The AST node to print.
- * @param indent The indentation level.
- */
-// Print AST for debugging
-void print_ast(Node* node, int indent) {
-    if (node == NULL) {
-        print_indent(indent);
-        printf("NULL\n");
-        return;
-    }
-
-    print_indent(indent);
-
-    switch (node->type) {
-        case NODE_ASK_QUERY:
-            printf("ASK QUERY:\n");
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.ask_query.source, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Fields:\n");
-            print_ast(node->as.ask_query.fields, indent + 2);
-
-            if (node->as.ask_query.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.ask_query.condition, indent + 2);
-            }
-
-            if (node->as.ask_query.group_by != NULL) {
-                print_indent(indent + 1);
-                printf("Group By:\n");
-                print_ast(node->as.ask_query.group_by, indent + 2);
-            }
-
-            if (node->as.ask_query.order_by != NULL) {
-                print_indent(indent + 1);
-                printf("Order By:\n");
-                print_ast(node->as.ask_query.order_by, indent + 2);
-            }
-
-            if (node->as.ask_query.limit != NULL) {
-                print_indent(indent + 1);
-                printf("Limit:\n");
-                print_ast(node->as.ask_query.limit, indent + 2);
-            }
-            break;
-
-        case NODE_TELL_QUERY:
-            printf("TELL QUERY:\n");
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.tell_query.source, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Action:\n");
-            print_ast(node->as.tell_query.action, indent + 2);
-
-            if (node->as.tell_query.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.tell_query.condition, indent + 2);
-            }
-            break;
-
-        case NODE_FIND_QUERY:
-            printf("FIND QUERY:\n");
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.find_query.source, indent + 2);
-
-            if (node->as.find_query.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.find_query.condition, indent + 2);
-            }
-
-            if (node->as.find_query.group_by != NULL) {
-                print_indent(indent + 1);
-                printf("Group By:\n");
-                print_ast(node->as.find_query.group_by, indent + 2);
-            }
-
-            if (node->as.find_query.order_by != NULL) {
-                print_indent(indent + 1);
-                printf("Order By:\n");
-                print_ast(node->as.find_query.order_by, indent + 2);
-            }
-
-            if (node->as.find_query.limit != NULL) {
-                print_indent(indent + 1);
-                printf("Limit:\n");
-                print_ast(node->as.find_query.limit, indent + 2);
-            }
-            break;
-
-        case NODE_SHOW_QUERY:
-            printf("SHOW QUERY:\n");
-            print_indent(indent + 1);
-            printf("Fields:\n");
-            print_ast(node->as.show_query.fields, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.show_query.source, indent + 2);
-
-            if (node->as.show_query.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.show_query.condition, indent + 2);
-            }
-
-            if (node->as.show_query.group_by != NULL) {
-                print_indent(indent + 1);
-                printf("Group By:\n");
-                print_ast(node->as.show_query.group_by, indent + 2);
-            }
-
-            if (node->as.show_query.order_by != NULL) {
-                print_indent(indent + 1);
-                printf("Order By:\n");
-                print_ast(node->as.show_query.order_by, indent + 2);
-            }
-
-            if (node->as.show_query.limit != NULL) {
-                print_indent(indent + 1);
-                printf("Limit:\n");
-                print_ast(node->as.show_query.limit, indent + 2);
-            }
-            break;
-
-        case NODE_GET_QUERY:
-            printf("GET QUERY:\n");
-            print_indent(indent + 1);
-            printf("Fields:\n");
-            print_ast(node->as.get_query.fields, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.get_query.source, indent + 2);
-
-            if (node->as.get_query.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.get_query.condition, indent + 2);
-            }
-
-            if (node->as.get_query.group_by != NULL) {
-                print_indent(indent + 1);
-                printf("Group By:\n");
-                print_ast(node->as.get_query.group_by, indent + 2);
-            }
-
-            if (node->as.get_query.order_by != NULL) {
-                print_indent(indent + 1);
-                printf("Order By:\n");
-                print_ast(node->as.get_query.order_by, indent + 2);
-            }
-
-            if (node->as.get_query.limit != NULL) {
-                print_indent(indent + 1);
-                printf("Limit:\n");
-                print_ast(node->as.get_query.limit, indent + 2);
-            }
-            break;
-
-        case NODE_FIELD_LIST:
-            printf("FIELD LIST (%d fields):\n", node->as.field_list.count);
-            for (int i = 0; i < node->as.field_list.count; i++) {
-                print_ast(node->as.field_list.fields[i], indent + 1);
-            }
-            break;
-
-        case NODE_SOURCE:
-            printf("SOURCE:\n");
-            print_indent(indent + 1);
-            printf("Name:\n");
-            print_ast(node->as.source.identifier, indent + 2);
-
-            if (node->as.source.join != NULL) {
-                print_indent(indent + 1);
-                printf("Join:\n");
-                print_ast(node->as.source.join, indent + 2);
-            }
-            break;
-
-        case NODE_JOIN:
-            printf("JOIN:\n");
-            print_indent(indent + 1);
-            printf("Source:\n");
-            print_ast(node->as.join.source, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Condition:\n");
-            print_ast(node->as.join.condition, indent + 2);
-            break;
-
-        case NODE_GROUP_BY:
-            printf("GROUP BY:\n");
-            print_indent(indent + 1);
-            printf("Fields:\n");
-            print_ast(node->as.group_by.fields, indent + 2);
-
-            if (node->as.group_by.having != NULL) {
-                print_indent(indent + 1);
-                printf("Having:\n");
-                print_ast(node->as.group_by.having, indent + 2);
-            }
-            break;
-
-        case NODE_ORDER_BY:
-            printf("ORDER BY (%d fields):\n", node->as.order_by.count);
-            for (int i = 0; i < node->as.order_by.count; i++) {
-                print_indent(indent + 1);
-                printf("Field %d (%s):\n", i + 1, node->as.order_by.ascending[i] ? "ASC" : "DESC");
-                print_ast(node->as.order_by.fields[i], indent + 2);
-            }
-            break;
-
-        case NODE_LIMIT:
-            printf("LIMIT: %d", node->as.limit.limit);
-            if (node->as.limit.offset > 0) {
-                printf(" OFFSET: %d", node->as.limit.offset);
-            }
-            printf("\n");
-            break;
-
-        case NODE_ADD_ACTION:
-            printf("ADD ACTION:\n");
-            print_indent(indent + 1);
-            printf("Value:\n");
-            print_ast(node->as.add_action.value, indent + 2);
-
-            if (node->as.add_action.record_spec != NULL) {
-                print_indent(indent + 1);
-                printf("Record Spec:\n");
-                print_ast(node->as.add_action.record_spec, indent + 2);
-            }
-            break;
-
-        case NODE_REMOVE_ACTION:
-            printf("REMOVE ACTION:\n");
-            if (node->as.remove_action.condition != NULL) {
-                print_indent(indent + 1);
-                printf("Condition:\n");
-                print_ast(node->as.remove_action.condition, indent + 2);
-            } else {
-                print_indent(indent + 1);
-                printf("(Remove all)\n");
-            }
-            break;
-
-        case NODE_UPDATE_ACTION:
-            printf("UPDATE ACTION (%d fields):\n", node->as.update_action.count);
-            for (int i = 0; i < node->as.update_action.count; i++) {
-                print_indent(indent + 1);
-                printf("Field %d:\n", i + 1);
-                print_ast(node->as.update_action.fields[i], indent + 2);
-                print_indent(indent + 1);
-                printf("Value %d:\n", i + 1);
-                print_ast(node->as.update_action.values[i], indent + 2);
-            }
-            break;
-
-        case NODE_CREATE_ACTION:
-            printf("CREATE ACTION (%d fields):\n", node->as.create_action.count);
-            for (int i = 0; i < node->as.create_action.count; i++) {
-                print_ast(node->as.create_action.field_defs[i], indent + 1);
-            }
-            break;
-
-        case NODE_BINARY_EXPR:
-            printf("BINARY EXPRESSION:\n");
-            print_indent(indent + 1);
-            printf("Operator: %s\n", token_type_to_op_string(node->as.binary_expr.op));
-            print_indent(indent + 1);
-            printf("Left:\n");
-            print_ast(node->as.binary_expr.left, indent + 2);
-
-            print_indent(indent + 1);
-            printf("Right:\n");
-            print_ast(node->as.binary_expr.right, indent + 2);
-            break;
-
-        case NODE_UNARY_EXPR:
-            printf("UNARY EXPRESSION:\n");
-            print_indent(indent + 1);
-            printf("Operator: %s\n", token_type_to_op_string(node->as.unary_expr.op));
-            print_indent(indent + 1);
-            printf("Operand:\n");
-            print_ast(node->as.unary_expr.operand, indent + 2);
-            break;
-
-        case NODE_IDENTIFIER:
-            printf("IDENTIFIER: %s\n", node->as.identifier.name);
-            break;
-
-        case NODE_FUNCTION_CALL:
-            printf("FUNCTION CALL: %s (%d args)\n", node->as.function_call.name,
-                   node->as.function_call.arg_count);
-            for (int i = 0; i < node->as.function_call.arg_count; i++) {
-                print_indent(indent + 1);
-                printf("Arg %d:\n", i + 1);
-                print_ast(node->as.function_call.args[i], indent + 2);
-            }
-            break;
-
-        case NODE_LITERAL:
-            switch (node->as.literal.literal_type) {
-                case TOKEN_STRING:
-                    printf("STRING: \"%s\"\n", node->as.literal.value.string_value);
-                    break;
-                case TOKEN_INTEGER:
-                    printf("INTEGER: %g\n", node->as.literal.value.number_value);
-                    break;
-                case TOKEN_DECIMAL:
-                    printf("DECIMAL: %g\n", node->as.literal.value.number_value);
-                    break;
-                default:
-                    printf("LITERAL: UNKNOWN TYPE\n");
-                    break;
-            }
-            break;
-
-        case NODE_FIELD_DEF:
-            printf("FIELD DEFINITION:\n");
-            print_indent(indent + 1);
-            printf("Name:\n");
-            print_ast(node->as.field_def.name, indent + 2);
-
-            if (node->as.field_def.type != NULL) {
-                print_indent(indent + 1);
-                printf("Type: %s\n", node->as.field_def.type);
-            }
-
-            if (node->as.field_def.constraint_count > 0) {
-                print_indent(indent + 1);
-                printf("Constraints (%d):\n", node->as.field_def.constraint_count);
-                for (int i = 0; i < node->as.field_def.constraint_count; i++) {
-                    print_ast(node->as.field_def.constraints[i], indent + 2);
-                }
-            }
-            break;
-
-        case NODE_CONSTRAINT:
-            printf("CONSTRAINT: ");
-            switch (node->as.constraint.type) {
-                case CONSTRAINT_REQUIRED:
-                    printf("REQUIRED\n");
-                    break;
-                case CONSTRAINT_UNIQUE:
-                    printf("UNIQUE\n");
-                    break;
-                case CONSTRAINT_DEFAULT:
-                    printf("DEFAULT\n");
-                    print_indent(indent + 1);
-                    printf("Value:\n");
-                    print_ast(node->as.constraint.default_value, indent + 2);
-                    break;
-            }
-            break;
-
-        case NODE_ERROR:
-            printf("ERROR: %s\n", node->as.error.message);
-            break;
-
-        case NODE_PROGRAM:
-            printf("PROGRAM (%d statements):\n", node->as.program.count);
-            for (int i = 0; i < node->as.program.count; i++) {
-                print_indent(indent + 1);
-                printf("Statement %d:\n", i + 1);
-                print_ast(node->as.program.statements[i], indent + 2);
-            }
-            break;
-
-        default:
-            printf("UNKNOWN NODE TYPE: %d\n", node->type);
-            break;
-    }
-}
-
-/**
- * Parse a complete program, which may contain multiple queries.
- *
- * @param parser The parser instance.
- * @return The AST node representing the program.
- */
-Node* parse_program(Parser* parser) {
-    Node* program = create_node(NODE_PROGRAM);
-    program->line = parser->current.line;
-
-    // Allocate initial space for statements
-    int capacity                   = 4;
-    program->as.program.statements = (Node**)malloc(capacity * sizeof(Node*));
-    if (program->as.program.statements == NULL) {
-        fprintf(stderr, "Error: Out of memory\n");
-        parser->had_error = true;  // Set error flag when allocation fails
-        free_node(program);
-        return NULL;
-    }
-
-    program->as.program.count = 0;
-
-    // Parse statements until EOF
-    while (!check(parser, TOKEN_EOF)) {
-        // Parse a query
-        Node* stmt = parse_query(parser);
-
-        // Add the statement to the program if parsing succeeded
-        if (stmt != NULL && !parser->had_error) {
-            if (program->as.program.count >= capacity) {
-                Node** new_statements = (Node**)realloc(program->as.program.statements, 
-                                                      capacity * 2 * sizeof(Node*));
-                if (new_statements == NULL) {
-                    fprintf(stderr, "Error: Out of memory\n");
-                    parser->had_error = true;  // Set error flag when allocation fails
-                    free_node(stmt);
-                    free_node(program);
-                    return NULL;
-                }
-                program->as.program.statements = new_statements;
-                capacity *= 2;  // Expand capacity after successful allocation
-            }
-
-            program->as.program.statements[program->as.program.count++] = stmt;
-
-            // Look for a PLEASE or ; statement ender
-            if (!check(parser, TOKEN_EOF) && !match(parser, TOKEN_TERMINATOR)) {
-                error_at_current(parser, "Expected 'PLEASE'  or ';' after statement");
-                break;
-            }
-        } else {
-            // Free the statement if we had an error
-            if (stmt != NULL) {
-                free_node(stmt);
-            }
-            
-            // error_at() already performed synchronization; avoid double-sync
-            if (parser->had_error) {
-                // If we couldn't recover, just exit
-                break;
-            }
-        }
-    }
-
-    // If we had errors and no statements, free the program
-    if (parser->had_error && program->as.program.count == 0) {
-        free_node(program);
-        return NULL;
-    }
-
-    return program;
-}
\ No newline at end of file
+#include <nsql/ast_visitor.h>
+#include <nsql/parser.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+#include "stats.h"
+
+// Lexing is timed for one token in this many (a power of two) and scaled up
+#define LEX_SAMPLE_INTERVAL 64
+
+// Count into the parser's statistics as well as its thread's
+#ifdef ENABLE_STATS
+#define PARSER_STAT_ADD(parser, field, amount) \
+    ((parser)->stats.field += (amount), NSQL_STAT_ADD(field, amount))
+#else
+#define PARSER_STAT_ADD(parser, field, amount) ((void)0)
+#endif
+
+// Forward parsing function declarations
+static Node* parse_ask_query(Parser* parser);
+static Node* parse_tell_query(Parser* parser);
+static Node* parse_find_query(Parser* parser);
+static Node* parse_show_query(Parser* parser);
+
+static Node* parse_field_list(Parser* parser);
+static Node* parse_source(Parser* parser);
+static Node* parse_join(Parser* parser);
+static Node* parse_condition(Parser* parser);
+static Node* parse_group_by(Parser* parser);
+static Node* parse_order_by(Parser* parser);
+static Node* parse_limit(Parser* parser);
+
+static Node* parse_add_action(Parser* parser);
+static Node* parse_remove_action(Parser* parser);
+static Node* parse_update_action(Parser* parser);
+static Node* parse_create_action(Parser* parser);
+static Node* parse_record_spec(Parser* parser);
+static Node* parse_field_def(Parser* parser);
+static Node* parse_constraint(Parser* parser);
+
+static Node* parse_expression(Parser* parser);
+static Node* parse_logic_or(Parser* parser);
+static Node* parse_logic_and(Parser* parser);
+static Node* parse_logical_chain(Parser* parser, NsqlTokenType op, Node* first,
+                                 Node* (*parse_operand)(Parser*));
+static Node* parse_equality(Parser* parser);
+static Node* parse_comparison(Parser* parser);
+static Node* parse_in_list(Parser* parser, Node* value);
+static Node* parse_term(Parser* parser);
+static Node* parse_factor(Parser* parser);
+static Node* parse_unary(Parser* parser);
+static Node* parse_primary(Parser* parser);
+static Node* parse_function_call(Parser* parser);
+
+// Util functions
+static void        advance(Parser* parser);
+static Token       next_token(Parser* parser);
+static bool        check(Parser* parser, NsqlTokenType type);
+static bool        match(Parser* parser, NsqlTokenType type);
+static void        consume(Parser* parser, NsqlTokenType type, const char* message);
+static void        error_at_current(Parser* parser, const char* message);
+static void        error_at(Parser* parser, Token* token, const char* message);
+static void        synchronize(Parser* parser);
+static void        stop_parsing(Parser* parser, const char* message);
+static bool        is_query_start(NsqlTokenType type);
+static bool        enter_nesting(Parser* parser);
+static void        skip_statement(Parser* parser);
+static void*       parser_alloc(Parser* parser, size_t size);
+static void*       parser_grow(Parser* parser, void* ptr, size_t old_size, size_t new_size);
+static Node*       create_node(Parser* parser, NodeType type);
+static char*       copy_string(Parser* parser, const char* str, size_t length);
+static char*       copy_token_string(Parser* parser, Token* token);
+static char*       node_string(Parser* parser, Node* node, const char* str, size_t length);
+static void        set_identifier(Parser* parser, Node* node, const Token* token);
+static int         token_integer(const Token* token);
+static void        parse_count(Parser* parser, int* count);
+static int         next_parameter(Parser* parser);
+static void        discard_node(Parser* parser, Node* node);
+static const char* token_type_to_op_string(NsqlTokenType type);
+
+/**
+ * @brief Formats all parser errors into a single string.
+ *
+ * Writes a human-readable summary of all errors encountered during parsing into the provided
+ * buffer.
+ *
+ * @param buffer Destination buffer for the formatted error string.
+ * @param size Size of the destination buffer in bytes.
+ * @return Number of bytes written to the buffer, excluding the null terminator.
+ */
+size_t parser_format_errors(Parser* parser, char* buffer, size_t size) {
+    return format_errors(&parser->errors, buffer, size);
+}
+
+/**
+ * Formats all parser errors into a JSON string.
+ *
+ * Writes a JSON representation of the parser's collected errors into the provided buffer.
+ *
+ * @param buffer Destination buffer for the JSON output.
+ * @param size Size of the buffer in bytes.
+ * @return Number of bytes written to the buffer, excluding the null terminator.
+ */
+size_t parser_format_errors_json(Parser* parser, char* buffer, size_t size) {
+    return format_errors_json(&parser->errors, buffer, size);
+}
+
+/**
+ * @brief Initializes a parser for NSQL input using the provided lexer.
+ *
+ * Sets up the parser state, resets error tracking, initializes the error context, and advances to
+ * the first token. AST nodes are allocated individually with malloc.
+ */
+void parser_init(Parser* parser, Lexer* lexer) {
+    parser_init_with_arena(parser, lexer, NULL);
+}
+
+/**
+ * @brief Initializes a parser whose AST is allocated from an arena.
+ *
+ * Behaves like parser_init(), but every node, string and child array is served from the arena.
+ * Passing NULL for the arena selects the default malloc path.
+ */
+void parser_init_with_arena(Parser* parser, Lexer* lexer, NsqlArena* arena) {
+    parser->lexer           = lexer;
+    parser->had_error       = false;
+    parser->panic_mode      = false;
+    parser->arena           = arena;
+    parser->zero_copy       = false;
+    parser->echo_errors     = false;
+    parser->parameter_count = 0;
+    parser->max_depth       = NSQL_MAX_EXPRESSION_DEPTH;
+    parser->depth           = 0;
+    parser->max_tokens      = 0;
+    parser->max_nodes       = 0;
+    parser->max_errors      = 0;
+    parser->token_count     = 0;
+    parser->node_count      = 0;
+    parser->limit_reached   = false;
+    parser->error_token     = NULL;
+    memset(&parser->stats, 0, sizeof(parser->stats));
+
+    // Initialize error context
+    error_context_init(&parser->errors);
+
+    // Prime the parser with the first token
+    advance(parser);
+}
+
+/**
+ * Frees resources associated with the parser, including its error context.
+ *
+ * Call this function to release memory allocated for parser error tracking after parsing is
+ * complete.
+ */
+void parser_free(Parser* parser) {
+    // Free error context
+    error_context_free(&parser->errors);
+}
+
+/**
+ * Advance the parser to the next token.
+ *
+ * Lexer errors are reported and skipped. The recovery that follows a report advances on its own,
+ * so the token it stops at is kept, and the previous token stays the one advanced past.
+ *
+ * @param parser The parser instance.
+ */
+static void advance(Parser* parser) {
+    Token previous  = parser->current;
+    parser->current = next_token(parser);
+
+    while (parser->current.type == TOKEN_ERROR) {
+        size_t tokens = parser->token_count;
+        error_at_current(parser, parser->current.start);
+        if (parser->token_count == tokens)
+            parser->current = next_token(parser);
+    }
+    parser->previous = previous;
+}
+
+/**
+ * Read the next token from the lexer, counting it.
+ *
+ * Once a limit is reached every token is the end of input.
+ *
+ * @param parser The parser instance.
+ * @return The token.
+ */
+static Token next_token(Parser* parser) {
+    Token token;
+    if (parser->limit_reached) {
+        token.type   = TOKEN_EOF;
+        token.start  = parser->lexer->current;
+        token.length = 0;
+        token.line   = parser->current.line;
+        token.column = parser->current.column;
+        return token;
+    }
+
+#ifdef ENABLE_STATS
+    // Reading the clock costs more than lexing a token, so only a sample is timed
+    if ((parser->stats.tokens_lexed & (LEX_SAMPLE_INTERVAL - 1)) == LEX_SAMPLE_INTERVAL - 1) {
+        uint64_t start   = nsql_stat_clock();
+        token            = lexer_next_token(parser->lexer);
+        uint64_t elapsed = (nsql_stat_clock() - start) * LEX_SAMPLE_INTERVAL;
+        PARSER_STAT_ADD(parser, stage_ns[NSQL_STAGE_LEX], elapsed);
+    } else {
+        token = lexer_next_token(parser->lexer);
+    }
+    PARSER_STAT_ADD(parser, tokens_lexed, 1);
+#else
+    token = lexer_next_token(parser->lexer);
+#endif
+
+    // The end of input is not counted, so an input of exactly max_tokens tokens parses
+    if (token.type != TOKEN_EOF && ++parser->token_count > parser->max_tokens &&
+        parser->max_tokens > 0) {
+        stop_parsing(parser, "Too many tokens");
+        return next_token(parser);
+    }
+    return token;
+}
+
+/**
+ * @brief Determines if the current token matches the specified type.
+ *
+ * @param type The token type to check against the current token.
+ * @return true if the current token is of the given type, false otherwise.
+ */
+static bool check(Parser* parser, NsqlTokenType type) {
+    return parser->current.type == type;
+}
+
+/**
+ * Consumes the current token if it matches the specified type.
+ *
+ * @param type The token type to match against the current token.
+ * @return true if the token was matched and consumed; false otherwise.
+ */
+static bool match(Parser* parser, NsqlTokenType type) {
+    if (!check(parser, type))
+        return false;
+    advance(parser);
+    return true;
+}
+
+/**
+ * @brief Consumes the current token if it matches the expected type, or reports an error.
+ *
+ * Advances the parser if the current token matches the specified type; otherwise, reports a parsing
+ * error with the given message.
+ */
+static void consume(Parser* parser, NsqlTokenType type, const char* message) {
+    if (parser->current.type == type) {
+        advance(parser);
+        return;
+    }
+
+    error_at_current(parser, message);
+}
+
+/**
+ * Report error at current token.
+ *
+ * @param parser The parser instance.
+ * @param message The error message.
+ */
+static void error_at_current(Parser* parser, const char* message) {
+    error_at(parser, &parser->current, message);
+}
+
+/**
+ * Reports a parsing error at the specified token, records it in the parser's error context, and
+ * initiates error recovery.
+ *
+ * Sets the parser into panic mode to prevent cascading errors and triggers synchronization to
+ * recover from the error state. Errors at the token of the previous error are not reported, and
+ * reaching parser->max_errors stops parsing.
+ */
+static void error_at(Parser* parser, Token* token, const char* message) {
+    if (parser->panic_mode || parser->limit_reached)
+        return;
+    parser->panic_mode = true;
+    parser->had_error  = true;
+
+    // Recovery stops at a query keyword without consuming it, so the rest of a failed statement
+    // would report an error for each clause it expects there
+    if (token->start == parser->error_token && token->type != TOKEN_ERROR) {
+        synchronize(parser);
+        return;
+    }
+    parser->error_token = token->start;
+
+    // The parser's messages are string literals and are stored without copying. A lexer message
+    // is the text of its error token, which is copied since the parser cannot vouch for it.
+    if (token->type == TOKEN_ERROR && message == token->start) {
+        char text[128];
+        snprintf(text, sizeof(text), "%.*s", (int)token->length, token->start);
+        report_error(&parser->errors, ERROR_ERROR, ERROR_SOURCE_PARSER, token->line,
+                     token->column, text);
+    } else {
+        report_error_static(&parser->errors, ERROR_ERROR, ERROR_SOURCE_PARSER, token->line,
+                            token->column, message);
+    }
+#ifdef ENABLE_STATS
+    parser->stats.errors[ERROR_SOURCE_PARSER]++;  // The reporter counts it for the thread
+#endif
+
+    // Optionally echo to stderr for immediate debugging
+    if (parser->echo_errors) {
+        fprintf(stderr, "[line %d] Error", token->line);
+
+        if (token->type == TOKEN_EOF) {
+            fprintf(stderr, " at end");
+        } else if (token->type == TOKEN_ERROR) {
+            // Nothing
+        } else {
+            fprintf(stderr, " at '%.*s'", (int)token->length, token->start);
+        }
+
+        fprintf(stderr, ": %s\n", message);
+    }
+
+    if (parser->max_errors > 0 && parser->errors.error_count >= parser->max_errors)
+        stop_parsing(parser, "Too many errors");
+
+    // Sync after error
+    synchronize(parser);
+}
+
+/**
+ * Stop parsing because a limit was reached.
+ *
+ * Reports the limit, after which the parser sees the end of input and reports nothing else.
+ *
+ * @param parser The parser instance.
+ * @param message The error message.
+ */
+static void stop_parsing(Parser* parser, const char* message) {
+    if (parser->limit_reached)
+        return;
+    parser->limit_reached = true;
+    parser->had_error     = true;
+
+    report_error_static(&parser->errors, ERROR_ERROR, ERROR_SOURCE_PARSER, parser->current.line,
+                        parser->current.column, message);
+#ifdef ENABLE_STATS
+    parser->stats.errors[ERROR_SOURCE_PARSER]++;
+#endif
+    if (parser->echo_errors)
+        fprintf(stderr, "[line %d] Error: %s\n", parser->current.line, message);
+}
+
+/**
+ * Synchronize the parser after an error.
+ *
+ * Compile with -DENABLE_SYNC_RECOVERY=OFF to disable this feature.
+ *
+ * @param parser The parser instance.
+ */
+static void synchronize(Parser* parser) {
+#ifdef ENABLE_SYNC_RECOVERY
+    // Skip until we find a query start keyword
+    while (parser->current.type != TOKEN_EOF && !is_query_start(parser->current.type)) {
+        advance(parser);
+    }
+#endif
+    // Errors the rest of the failed statement reports at the token recovery stopped at are cascades
+    parser->error_token = parser->current.start;
+    parser->panic_mode  = false;
+}
+
+/**
+ * Check whether a token type can start a query.
+ *
+ * @param type The token type to check.
+ * @return true if the token starts a query, false otherwise.
+ */
+static bool is_query_start(NsqlTokenType type) {
+    switch (type) {
+        case TOKEN_ASK:
+        case TOKEN_TELL:
+        case TOKEN_FIND:
+        case TOKEN_SHOW:
+        case TOKEN_GET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Enter a nested expression, reporting an error if it is nested too deeply.
+ *
+ * On success the caller decrements parser->depth once it has parsed the nested expression.
+ *
+ * @param parser The parser instance.
+ * @return true if the expression may be parsed, false if it exceeds parser->max_depth.
+ */
+static bool enter_nesting(Parser* parser) {
+    if (parser->depth >= parser->max_depth) {
+        error_at_current(parser, "Expression nested too deeply");
+        return false;
+    }
+
+    parser->depth++;
+    return true;
+}
+
+/**
+ * Allocate memory for the AST, from the parser's arena if it has one.
+ *
+ * @param parser The parser instance.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory.
+ */
+static void* parser_alloc(Parser* parser, size_t size) {
+    void* ptr = parser->arena ? arena_alloc(parser->arena, size) : malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+/**
+ * Grow an array allocated with parser_alloc().
+ *
+ * @param parser The parser instance.
+ * @param ptr The array to grow.
+ * @param old_size The current size of the array in bytes.
+ * @param new_size The new size of the array in bytes.
+ * @return A pointer to the grown array.
+ */
+static void* parser_grow(Parser* parser, void* ptr, size_t old_size, size_t new_size) {
+    void* new_ptr = parser->arena ? arena_realloc(parser->arena, ptr, old_size, new_size)
+                                  : realloc(ptr, new_size);
+    if (new_ptr == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    PARSER_STAT_ADD(parser, list_reallocs, 1);
+    return new_ptr;
+}
+
+/**
+ * Create a new AST node of the specified type.
+ *
+ * @param parser The parser instance.
+ * @param type The type of the node to create.
+ * @return A pointer to the newly created node.
+ */
+static Node* create_node(Parser* parser, NodeType type) {
+    Node* node = (Node*)parser_alloc(parser, sizeof(Node));
+    memset(node, 0, sizeof(Node));
+    node->type = type;
+    PARSER_STAT_ADD(parser, nodes_created, 1);
+
+    if (++parser->node_count > parser->max_nodes && parser->max_nodes > 0)
+        stop_parsing(parser, "Too many AST nodes");
+    return node;
+}
+
+/**
+ * Copy a string to a new null-terminated memory location.
+ *
+ * @param parser The parser instance.
+ * @param str The characters to copy.
+ * @param length The number of characters to copy.
+ */
+static char* copy_string(Parser* parser, const char* str, size_t length) {
+    char* copy = (char*)parser_alloc(parser, length + 1);
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    PARSER_STAT_ADD(parser, bytes_copied, length);
+    return copy;
+}
+
+/**
+ * Copy token string to a new memory location.
+ *
+ * @param parser The parser instance.
+ * @param token The token to copy.
+ */
+static char* copy_token_string(Parser* parser, Token* token) {
+    return copy_string(parser, token->start, token->length);
+}
+
+/**
+ * Get the string value for an identifier or literal node.
+ *
+ * In zero-copy mode the returned pointer refers straight into the source buffer, is not
+ * null-terminated, and the node is flagged NODE_FLAG_BORROWED. Otherwise the string is copied.
+ *
+ * @param parser The parser instance.
+ * @param node The node that will hold the string.
+ * @param str The characters of the string in the source buffer.
+ * @param length The number of characters.
+ * @return The string to store in the node.
+ */
+static char* node_string(Parser* parser, Node* node, const char* str, size_t length) {
+    if (parser->zero_copy) {
+        node->flags |= NODE_FLAG_BORROWED;
+        return (char*)str;
+    }
+
+    return copy_string(parser, str, length);
+}
+
+/**
+ * Fill an identifier node from a token.
+ *
+ * @param parser The parser instance.
+ * @param node The identifier node.
+ * @param token The token holding the identifier.
+ */
+static void set_identifier(Parser* parser, Node* node, const Token* token) {
+    node->as.identifier.length = (int)token->length;
+    node->as.identifier.name   = node_string(parser, node, token->start, token->length);
+}
+
+/**
+ * Get the value of an integer token.
+ *
+ * The digits are read within the token, since the source need not be null-terminated.
+ *
+ * @param token The integer token.
+ * @return The value, saturated like strtol() and then converted to int.
+ */
+static int token_integer(const Token* token) {
+    return (int)nsql_scan_integer_value(token->start, token->start + token->length);
+}
+
+/**
+ * Parse the integer of a LIMIT or OFFSET clause.
+ *
+ * Negative counts stand for ? placeholders, so a value that does not fit in an int32_t is
+ * reported rather than wrapped. The digits are read within the token.
+ *
+ * @param parser The parser instance, at the integer token.
+ * @param count Receives the value, or 0 if it is out of range.
+ */
+static void parse_count(Parser* parser, int* count) {
+    const Token* token = &parser->current;
+    int64_t      value = 0;
+    for (size_t i = 0; i < token->length && value <= INT32_MAX; i++) {
+        value = value * 10 + (token->start[i] - '0');
+    }
+
+    // Error recovery moves past the token itself
+    if (value > INT32_MAX) {
+        *count = 0;
+        error_at_current(parser, "LIMIT/OFFSET out of range");
+        return;
+    }
+    *count = (int)value;
+    advance(parser);
+}
+
+/**
+ * Number the ? placeholder just consumed.
+ *
+ * @param parser The parser instance, past the placeholder.
+ * @return The index of the placeholder (0 once NSQL_MAX_PARAMETERS is exceeded).
+ */
+static int next_parameter(Parser* parser) {
+    if (parser->parameter_count >= NSQL_MAX_PARAMETERS) {
+        error_at(parser, &parser->previous, "Too many placeholders in statement");
+        return 0;
+    }
+    return parser->parameter_count++;
+}
+
+/**
+ * Throw away a node the parser no longer needs.
+ *
+ * Arena-allocated nodes are reclaimed when the arena is reset, so only heap nodes are freed.
+ *
+ * @param parser The parser instance.
+ * @param node The node to discard.
+ */
+static void discard_node(Parser* parser, Node* node) {
+    if (parser->arena == NULL)
+        free_node(node);
+}
+
+/**
+ * @brief Returns the string representation of an operator token type.
+ *
+ * Converts a given NsqlTokenType representing an operator to its corresponding string form (e.g.,
+ * "+", "AND", "!=").
+ *
+ * @param type The operator token type.
+ * @return The string representation of the operator, or "UNKNOWN" if not recognized.
+ */
+static const char* token_type_to_op_string(NsqlTokenType type) {
+    switch (type) {
+        case TOKEN_PLUS:
+            return "+";
+        case TOKEN_MINUS:
+            return "-";
+        case TOKEN_STAR:
+            return "*";
+        case TOKEN_SLASH:
+            return "/";
+        case TOKEN_PERCENT:
+            return "%";
+        case TOKEN_EQUAL:
+            return "=";
+        case TOKEN_GT:
+            return ">";
+        case TOKEN_LT:
+            return "<";
+        case TOKEN_GTE:
+            return ">=";
+        case TOKEN_LTE:
+            return "<=";
+        case TOKEN_NEQ:
+            return "!=";
+        case TOKEN_LIKE:
+            return "LIKE";
+        case TOKEN_AND:
+            return "AND";
+        case TOKEN_OR:
+            return "OR";
+        case TOKEN_NOT:
+            return "NOT";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+/**
+ * Parse NSQL query and return the AST root.
+ *
+ * @param parser The parser instance.
+ */
+Node* parse_query(Parser* parser) {
+    NSQL_STAT_CLOCK(start);
+    Node* query = NULL;
+
+    // Placeholders are numbered per statement
+    parser->parameter_count = 0;
+
+    if (match(parser, TOKEN_ASK)) {
+        query = parse_ask_query(parser);
+    } else if (match(parser, TOKEN_TELL)) {
+        query = parse_tell_query(parser);
+    } else if (match(parser, TOKEN_FIND)) {
+        query = parse_find_query(parser);
+    } else if (match(parser, TOKEN_SHOW)) {
+        query = parse_show_query(parser);
+    } else if (match(parser, TOKEN_GET)) {
+        query = parse_show_query(parser);
+    } else {
+        error_at_current(parser, "Expected a query type (ASK, TELL, FIND, SHOW, GET)");
+    }
+
+#ifdef ENABLE_STATS
+    PARSER_STAT_ADD(parser, stage_ns[NSQL_STAGE_PARSE], nsql_stat_clock() - start);
+#endif
+    return query;
+}
+
+// TODO: Shove all of the conditionals into one function, so as to not repeat code
+
+/**
+ * Parse ASK query.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the ASK query.
+ */
+static Node* parse_ask_query(Parser* parser) {
+    Node* node = create_node(parser, NODE_ASK_QUERY);
+    node->line = parser->previous.line;
+
+    // Parse source
+    node->as.ask_query.source = parse_source(parser);
+
+    // Parse FOR clause
+    consume(parser, TOKEN_FOR, "Expected 'FOR' after source in ASK query");
+
+    // Parse field list
+    node->as.ask_query.fields = parse_field_list(parser);
+
+    // Parse optional condition
+    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
+        node->as.ask_query.condition = parse_condition(parser);
+    } else {
+        node->as.ask_query.condition = NULL;
+    }
+
+    // Parse optional GROUP BY
+    if (match(parser, TOKEN_GROUP)) {
+        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
+        node->as.ask_query.group_by = parse_group_by(parser);
+    } else {
+        node->as.ask_query.group_by = NULL;
+    }
+
+    // Parse optional ORDER BY / SORT BY
+    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
+        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
+        node->as.ask_query.order_by = parse_order_by(parser);
+    } else {
+        node->as.ask_query.order_by = NULL;
+    }
+
+    // Parse optional LIMIT
+    if (match(parser, TOKEN_LIMIT)) {
+        node->as.ask_query.limit = parse_limit(parser);
+    } else {
+        node->as.ask_query.limit = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse TELL query.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the TELL query.
+ */
+static Node* parse_tell_query(Parser* parser) {
+    Node* node = create_node(parser, NODE_TELL_QUERY);
+    node->line = parser->previous.line;
+
+    // Parse source
+    node->as.tell_query.source = parse_source(parser);
+
+    // Parse TO
+    consume(parser, TOKEN_TO, "Expected 'TO' after source in TELL query");
+
+    // Parse action
+    if (match(parser, TOKEN_ADD)) {
+        node->as.tell_query.action = parse_add_action(parser);
+    } else if (match(parser, TOKEN_REMOVE)) {
+        node->as.tell_query.action = parse_remove_action(parser);
+    } else if (match(parser, TOKEN_UPDATE)) {
+        node->as.tell_query.action = parse_update_action(parser);
+    } else if (match(parser, TOKEN_CREATE)) {
+        node->as.tell_query.action = parse_create_action(parser);
+    } else {
+        error_at_current(parser, "Expected action (ADD, REMOVE, UPDATE, CREATE)");
+        discard_node(parser, node);
+        return NULL;
+    }
+
+    // Parse optional condition
+    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
+        node->as.tell_query.condition = parse_condition(parser);
+    } else {
+        node->as.tell_query.condition = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse FIND query.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the FIND query.
+ */
+static Node* parse_find_query(Parser* parser) {
+    Node* node = create_node(parser, NODE_FIND_QUERY);
+    node->line = parser->previous.line;
+
+    // Parse fields
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        // Fields explicitly specified
+        // In FIND queries, the fields are implicit in the source
+        node->as.find_query.source = parse_source(parser);
+    } else {
+        // No fields specified, use implicit source
+        Node* source_node = create_node(parser, NODE_SOURCE);
+        source_node->line = parser->previous.line;
+
+        // Create an implicit "*" identifier
+        Node* id_node                 = create_node(parser, NODE_IDENTIFIER);
+        id_node->line                 = parser->previous.line;
+        id_node->as.identifier.name   = node_string(parser, id_node, "*", 1);
+        id_node->as.identifier.length = 1;
+
+        source_node->as.source.identifier = id_node;
+        source_node->as.source.join       = NULL;
+
+        node->as.find_query.source = source_node;
+    }
+
+    // Parse IN if present
+    if (match(parser, TOKEN_IN)) {
+        // Replace the source
+        Node* old_source           = node->as.find_query.source;
+        node->as.find_query.source = parse_source(parser);
+        discard_node(parser, old_source);
+    }
+
+    // Parse condition
+    if (match(parser, TOKEN_THAT) || match(parser, TOKEN_WHEN) || match(parser, TOKEN_WHERE) ||
+        match(parser, TOKEN_WHICH)) {
+        node->as.find_query.condition = parse_condition(parser);
+    } else {
+        node->as.find_query.condition = NULL;
+    }
+
+    // Parse optional GROUP BY
+    if (match(parser, TOKEN_GROUP)) {
+        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
+        node->as.find_query.group_by = parse_group_by(parser);
+    } else {
+        node->as.find_query.group_by = NULL;
+    }
+
+    // Parse optional ORDER BY / SORT BY
+    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
+        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
+        node->as.find_query.order_by = parse_order_by(parser);
+    } else {
+        node->as.find_query.order_by = NULL;
+    }
+
+    // Parse optional LIMIT
+    if (match(parser, TOKEN_LIMIT)) {
+        node->as.find_query.limit = parse_limit(parser);
+    } else {
+        node->as.find_query.limit = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse SHOW query.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the SHOW query.
+ */
+static Node* parse_show_query(Parser* parser) {
+    Node* node = create_node(parser, NODE_SHOW_QUERY);
+    node->line = parser->previous.line;
+
+    // Skip optional ME
+    match(parser, TOKEN_IDENTIFIER);  // Just consume "ME" if present
+
+    // Parse field list
+    node->as.show_query.fields = parse_field_list(parser);
+
+    // Parse FROM
+    consume(parser, TOKEN_FROM, "Expected 'FROM' after fields in SHOW query");
+
+    // Parse source
+    node->as.show_query.source = parse_source(parser);
+
+    // Parse optional condition
+    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
+        node->as.show_query.condition = parse_condition(parser);
+    } else {
+        node->as.show_query.condition = NULL;
+    }
+
+    // Parse optional GROUP BY
+    if (match(parser, TOKEN_GROUP)) {
+        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
+        node->as.show_query.group_by = parse_group_by(parser);
+    } else {
+        node->as.show_query.group_by = NULL;
+    }
+
+    // Parse optional ORDER BY / SORT BY
+    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
+        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
+        node->as.show_query.order_by = parse_order_by(parser);
+    } else {
+        node->as.show_query.order_by = NULL;
+    }
+
+    // Parse optional LIMIT
+    if (match(parser, TOKEN_LIMIT)) {
+        node->as.show_query.limit = parse_limit(parser);
+    } else {
+        node->as.show_query.limit = NULL;
+    }
+
+    return node;
+}
+
+#if 0
+/**
+ * Parse GET query
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the GET query.
+ */
+static Node* parse_get_query(Parser* parser) {
+    Node* node = create_node(parser, NODE_GET_QUERY);
+    node->line = parser->previous.line;
+
+    // Parse field list
+    node->as.get_query.fields = parse_field_list(parser);
+
+    // Parse FROM
+    consume(parser, TOKEN_FROM, "Expected 'FROM' after fields in GET query");
+
+    // Parse source
+    node->as.get_query.source = parse_source(parser);
+
+    // Parse optional condition
+    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_IF) || match(parser, TOKEN_WHERE)) {
+        node->as.get_query.condition = parse_condition(parser);
+    } else {
+        node->as.get_query.condition = NULL;
+    }
+
+    // Parse optional GROUP BY
+    if (match(parser, TOKEN_GROUP)) {
+        consume(parser, TOKEN_BY, "Expected 'BY' after 'GROUP'");
+        node->as.get_query.group_by = parse_group_by(parser);
+    } else {
+        node->as.get_query.group_by = NULL;
+    }
+
+    // Parse optional ORDER BY / SORT BY
+    if ((match(parser, TOKEN_ORDER) && match(parser, TOKEN_BY)) ||
+        (match(parser, TOKEN_SORT) && match(parser, TOKEN_BY))) {
+        node->as.get_query.order_by = parse_order_by(parser);
+    } else {
+        node->as.get_query.order_by = NULL;
+    }
+
+    // Parse optional LIMIT
+    if (match(parser, TOKEN_LIMIT)) {
+        node->as.get_query.limit = parse_limit(parser);
+    } else {
+        node->as.get_query.limit = NULL;
+    }
+
+    return node;
+}
+#endif
+
+/**
+ * Parse field list.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the field list.
+ */
+static Node* parse_field_list(Parser* parser) {
+    Node* node = create_node(parser, NODE_FIELD_LIST);
+    node->line = parser->previous.line;
+
+    // Allocate initial space for fields
+    int capacity               = 4;
+    node->as.field_list.fields = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+
+    node->as.field_list.count = 0;
+
+    // Parse first field
+    if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
+        Node* field = create_node(parser, NODE_IDENTIFIER);
+        field->line = parser->current.line;
+        set_identifier(parser, field, &parser->current);
+
+        node->as.field_list.fields[node->as.field_list.count++] = field;
+        advance(parser);
+
+        // Parse additional fields separated by commas
+        while (match(parser, TOKEN_COMMA)) {
+            if (node->as.field_list.count >= capacity) {
+                node->as.field_list.fields =
+                    (Node**)parser_grow(parser, node->as.field_list.fields,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                capacity *= 2;
+            }
+
+            if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
+                field       = create_node(parser, NODE_IDENTIFIER);
+                field->line = parser->current.line;
+                set_identifier(parser, field, &parser->current);
+
+                node->as.field_list.fields[node->as.field_list.count++] = field;
+                advance(parser);
+            } else {
+                error_at_current(parser, "Expected identifier or string after comma");
+                break;
+            }
+        }
+    } else {
+        error_at_current(parser, "Expected identifier or string for field list");
+    }
+
+    return node;
+}
+
+/**
+ * Parse a source.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the source.
+ */
+static Node* parse_source(Parser* parser) {
+    Node* node = create_node(parser, NODE_SOURCE);
+    node->line = parser->previous.line;
+
+    // Parse identifier or string
+    if (check(parser, TOKEN_IDENTIFIER) || check(parser, TOKEN_STRING)) {
+        node->as.source.identifier       = create_node(parser, NODE_IDENTIFIER);
+        node->as.source.identifier->line = parser->current.line;
+        set_identifier(parser, node->as.source.identifier, &parser->current);
+
+        advance(parser);
+
+        // Check for JOIN, each joined source nesting a level deeper like a nested expression
+        if ((match(parser, TOKEN_AND) || match(parser, TOKEN_WITH)) && enter_nesting(parser)) {
+            node->as.source.join = parse_join(parser);
+            parser->depth--;
+        } else {
+            node->as.source.join = NULL;
+        }
+    } else {
+        error_at_current(parser, "Expected identifier or string for source");
+    }
+
+    return node;
+}
+
+/**
+ * Parse WITH (JOIN) clause.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the JOIN clause.
+ */
+static Node* parse_join(Parser* parser) {
+    Node* node = create_node(parser, NODE_JOIN);
+    node->line = parser->previous.line;
+
+    // Parse the joined source
+    node->as.join.source = parse_source(parser);
+
+    // Parse join condition
+    if (match(parser, TOKEN_WHEN) || match(parser, TOKEN_WHERE)) {
+        node->as.join.condition = parse_condition(parser);
+    } else {
+        error_at_current(parser, "Expected 'WHEN' or 'WHERE' after join source");
+    }
+
+    return node;
+}
+
+/**
+ * Parse condition (WHERE clause).
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the condition.
+ */
+static Node* parse_condition(Parser* parser) {
+    return parse_expression(parser);
+}
+
+/**
+ * Parse GROUP BY clause.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the GROUP BY clause.
+ */
+static Node* parse_group_by(Parser* parser) {
+    Node* node = create_node(parser, NODE_GROUP_BY);
+    node->line = parser->previous.line;
+
+    // Parse fields to group by
+    node->as.group_by.fields = parse_field_list(parser);
+
+    // Parse optional HAVING clause
+    if (match(parser, TOKEN_HAVING)) {
+        node->as.group_by.having = parse_condition(parser);
+    } else {
+        node->as.group_by.having = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse ORDER BY / SORT BY clause.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the ORDER BY / SORT BY clause.
+ */
+static Node* parse_order_by(Parser* parser) {
+    Node* node = create_node(parser, NODE_ORDER_BY);
+    node->line = parser->previous.line;
+
+    // Allocate initial space for sort fields
+    int capacity                = 4;
+    node->as.order_by.fields    = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+    node->as.order_by.ascending = (bool*)parser_alloc(parser, capacity * sizeof(bool));
+
+    node->as.order_by.count = 0;
+
+    // Parse first field
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        Node* field = create_node(parser, NODE_IDENTIFIER);
+        field->line = parser->current.line;
+        set_identifier(parser, field, &parser->current);
+
+        node->as.order_by.fields[node->as.order_by.count] = field;
+
+        // Default to ascending order
+        node->as.order_by.ascending[node->as.order_by.count] = true;
+
+        advance(parser);
+
+        // Check for ASC/DESC
+        if (match(parser, TOKEN_IDENTIFIER)) {
+            // Compare with "ASC" or "DESC"
+            if (parser->previous.length == 3 && strncmp(parser->previous.start, "ASC", 3) == 0) {
+                node->as.order_by.ascending[node->as.order_by.count] = true;
+            } else if (parser->previous.length == 4 &&
+                       strncmp(parser->previous.start, "DESC", 4) == 0) {
+                node->as.order_by.ascending[node->as.order_by.count] = false;
+            } else {
+                // Not ASC or DESC, must be another field
+                error_at_current(parser, "Expected 'ASC', 'DESC', or ','");
+            }
+        }
+
+        node->as.order_by.count++;
+
+        // Parse additional sort fields
+        while (match(parser, TOKEN_COMMA)) {
+            if (node->as.order_by.count >= capacity) {
+                node->as.order_by.fields =
+                    (Node**)parser_grow(parser, node->as.order_by.fields,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                node->as.order_by.ascending =
+                    (bool*)parser_grow(parser, node->as.order_by.ascending,
+                                       capacity * sizeof(bool), capacity * 2 * sizeof(bool));
+                capacity *= 2;
+            }
+
+            if (check(parser, TOKEN_IDENTIFIER)) {
+                field       = create_node(parser, NODE_IDENTIFIER);
+                field->line = parser->current.line;
+                set_identifier(parser, field, &parser->current);
+
+                node->as.order_by.fields[node->as.order_by.count] = field;
+
+                // Default to ascending order
+                node->as.order_by.ascending[node->as.order_by.count] = true;
+
+                advance(parser);
+
+                // Check for ASC/DESC
+                if (match(parser, TOKEN_IDENTIFIER)) {
+                    // Compare with "ASC" or "DESC"
+                    if (parser->previous.length == 3 &&
+                        strncmp(parser->previous.start, "ASC", 3) == 0) {
+                        node->as.order_by.ascending[node->as.order_by.count] = true;
+                    } else if (parser->previous.length == 4 &&
+                               strncmp(parser->previous.start, "DESC", 4) == 0) {
+                        node->as.order_by.ascending[node->as.order_by.count] = false;
+                    } else {
+                        // Not ASC or DESC, must be another field
+                        error_at_current(parser, "Expected 'ASC', 'DESC', or ','");
+                    }
+                }
+
+                node->as.order_by.count++;
+            } else {
+                error_at_current(parser, "Expected identifier after comma in ORDER BY clause");
+                break;
+            }
+        }
+    } else {
+        error_at_current(parser, "Expected identifier for ORDER BY clause");
+    }
+
+    return node;
+}
+
+/**
+ * Parse LIMIT clause.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the LIMIT clause.
+ */
+static Node* parse_limit(Parser* parser) {
+    Node* node = create_node(parser, NODE_LIMIT);
+    node->line = parser->previous.line;
+
+    // Parse limit value
+    if (check(parser, TOKEN_INTEGER)) {
+        parse_count(parser, &node->as.limit.limit);
+    } else if (match(parser, TOKEN_PARAMETER)) {
+        node->as.limit.limit = LIMIT_PARAMETER(next_parameter(parser));
+    } else {
+        error_at_current(parser, "Expected integer for LIMIT clause");
+    }
+
+    // Parse optional OFFSET
+    if (match(parser, TOKEN_IDENTIFIER) && parser->previous.length == 6 &&
+        strncmp(parser->previous.start, "OFFSET", 6) == 0) {
+        if (check(parser, TOKEN_INTEGER)) {
+            parse_count(parser, &node->as.limit.offset);
+        } else if (match(parser, TOKEN_PARAMETER)) {
+            node->as.limit.offset = LIMIT_PARAMETER(next_parameter(parser));
+        } else {
+            error_at_current(parser, "Expected integer for OFFSET clause");
+        }
+    } else {
+        node->as.limit.offset = 0;
+    }
+
+    return node;
+}
+
+/**
+ * Parse ADD action.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the ADD action.
+ */
+static Node* parse_add_action(Parser* parser) {
+    Node* node = create_node(parser, NODE_ADD_ACTION);
+    node->line = parser->previous.line;
+
+    // Parse value to add
+    node->as.add_action.value = parse_expression(parser);
+
+    // Parse optional record specifications
+    if (match(parser, TOKEN_WITH)) {
+        node->as.add_action.record_spec = parse_record_spec(parser);
+    } else {
+        node->as.add_action.record_spec = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse REMOVE action.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the REMOVE action.
+ */
+static Node* parse_remove_action(Parser* parser) {
+    Node* node = create_node(parser, NODE_REMOVE_ACTION);
+    node->line = parser->previous.line;
+
+    // Parse optional condition (if no condition, remove all)
+    if (check(parser, TOKEN_WHEN) || check(parser, TOKEN_IF) || check(parser, TOKEN_WHERE)) {
+        node->as.remove_action.condition = parse_condition(parser);
+    } else {
+        node->as.remove_action.condition = NULL;
+    }
+
+    return node;
+}
+
+/**
+ * Parse UPDATE action.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the UPDATE action.
+ */
+static Node* parse_update_action(Parser* parser) {
+    Node* node = create_node(parser, NODE_UPDATE_ACTION);
+    node->line = parser->previous.line;
+
+    // Allocate initial space for field/value pairs
+    int capacity                  = 4;
+    node->as.update_action.fields = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+    node->as.update_action.values = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+
+    node->as.update_action.count = 0;
+
+    // Parse first field=value pair
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        Node* field = create_node(parser, NODE_IDENTIFIER);
+        field->line = parser->current.line;
+        set_identifier(parser, field, &parser->current);
+
+        node->as.update_action.fields[node->as.update_action.count] = field;
+
+        advance(parser);
+        consume(parser, TOKEN_EQUAL, "Expected '=' after field name");
+
+        node->as.update_action.values[node->as.update_action.count] = parse_expression(parser);
+        node->as.update_action.count++;
+
+        // Parse additional field=value pairs
+        while (match(parser, TOKEN_COMMA)) {
+            if (node->as.update_action.count >= capacity) {
+                node->as.update_action.fields =
+                    (Node**)parser_grow(parser, node->as.update_action.fields,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                node->as.update_action.values =
+                    (Node**)parser_grow(parser, node->as.update_action.values,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                capacity *= 2;
+            }
+
+            if (check(parser, TOKEN_IDENTIFIER)) {
+                field       = create_node(parser, NODE_IDENTIFIER);
+                field->line = parser->current.line;
+                set_identifier(parser, field, &parser->current);
+
+                node->as.update_action.fields[node->as.update_action.count] = field;
+
+                advance(parser);
+                consume(parser, TOKEN_EQUAL, "Expected '=' after field name");
+
+                node->as.update_action.values[node->as.update_action.count] =
+                    parse_expression(parser);
+                node->as.update_action.count++;
+            } else {
+                error_at_current(parser, "Expected identifier after comma in UPDATE action");
+                break;
+            }
+        }
+    } else {
+        error_at_current(parser, "Expected identifier for UPDATE action");
+    }
+
+    return node;
+}
+
+/**
+ * Parse CREATE action.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the CREATE action.
+ */
+static Node* parse_create_action(Parser* parser) {
+    Node* node = create_node(parser, NODE_CREATE_ACTION);
+    node->line = parser->previous.line;
+
+    // Allocate initial space for field definitions
+    int capacity                      = 4;
+    node->as.create_action.field_defs = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+
+    node->as.create_action.count = 0;
+
+    // Parse first field definition
+    Node* field_def                                                   = parse_field_def(parser);
+    node->as.create_action.field_defs[node->as.create_action.count++] = field_def;
+
+    // Parse additional field definitions
+    while (match(parser, TOKEN_COMMA)) {
+        if (node->as.create_action.count >= capacity) {
+            node->as.create_action.field_defs =
+                (Node**)parser_grow(parser, node->as.create_action.field_defs,
+                                    capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+            capacity *= 2;
+        }
+
+        field_def                                                         = parse_field_def(parser);
+        node->as.create_action.field_defs[node->as.create_action.count++] = field_def;
+    }
+
+    return node;
+}
+
+/**
+ * Parse record specification.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the record specification.
+ */
+static Node* parse_record_spec(Parser* parser) {
+    // TODO: Implement record specification parsing
+    return parse_field_list(parser);
+}
+
+/**
+ * Parse field definition.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the field definition.
+ */
+static Node* parse_field_def(Parser* parser) {
+    Node* node = create_node(parser, NODE_FIELD_DEF);
+    node->line = parser->previous.line;
+
+    // Parse field name
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        node->as.field_def.name       = create_node(parser, NODE_IDENTIFIER);
+        node->as.field_def.name->line = parser->current.line;
+        set_identifier(parser, node->as.field_def.name, &parser->current);
+
+        advance(parser);
+    } else {
+        error_at_current(parser, "Expected identifier for field name");
+    }
+
+    // Parse optional type
+    if (match(parser, TOKEN_AS)) {
+        if (check(parser, TOKEN_IDENTIFIER)) {
+            node->as.field_def.type = copy_token_string(parser, &parser->current);
+            advance(parser);
+        } else {
+            error_at_current(parser, "Expected identifier for field type");
+        }
+    } else {
+        node->as.field_def.type = NULL;
+    }
+
+    // Parse optional constraints
+    if (match(parser, TOKEN_LPAREN)) {
+        // Allocate initial space for constraints
+        int capacity                   = 4;
+        node->as.field_def.constraints = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+
+        node->as.field_def.constraint_count = 0;
+
+        // Parse first constrain
+        Node* constraint = parse_constraint(parser);
+        node->as.field_def.constraints[node->as.field_def.constraint_count++] = constraint;
+
+        // Parse additional constraints
+        while (match(parser, TOKEN_COMMA)) {
+            if (node->as.field_def.constraint_count >= capacity) {
+                node->as.field_def.constraints =
+                    (Node**)parser_grow(parser, node->as.field_def.constraints,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                capacity *= 2;
+            }
+
+            constraint = parse_constraint(parser);
+            node->as.field_def.constraints[node->as.field_def.constraint_count++] = constraint;
+        }
+
+        consume(parser, TOKEN_RPAREN, "Expected ')' after field constraints");
+    } else {
+        node->as.field_def.constraints      = NULL;  // No constraints specified
+        node->as.field_def.constraint_count = 0;
+    }
+
+    return node;
+}
+
+/**
+ * Parse constraint.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the constraint.
+ */
+static Node* parse_constraint(Parser* parser) {
+    Node* node = create_node(parser, NODE_CONSTRAINT);
+    node->line = parser->previous.line;
+
+    // Parse constraint type
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        if (parser->current.length == 8 && strncmp(parser->current.start, "REQUIRED", 8) == 0) {
+            node->as.constraint.type          = CONSTRAINT_REQUIRED;
+            node->as.constraint.default_value = NULL;
+            advance(parser);
+        } else if (parser->current.length == 6 &&
+                   strncmp(parser->current.start, "UNIQUE", 6) == 0) {
+            node->as.constraint.type          = CONSTRAINT_UNIQUE;
+            node->as.constraint.default_value = NULL;
+            advance(parser);
+        } else if (parser->current.length == 7 &&
+                   strncmp(parser->current.start, "DEFAULT", 7) == 0) {
+            node->as.constraint.type = CONSTRAINT_DEFAULT;
+            advance(parser);
+
+            // Parse default value
+            node->as.constraint.default_value = parse_expression(parser);
+        } else {
+            error_at_current(parser, "Expected constraint type (REQUIRED, UNIQUE, DEFAULT)");
+        }
+    } else {
+        error_at_current(parser, "Expected constraint type");
+    }
+
+    return node;
+}
+
+/**
+ * Parse expression (for WHERE, HAVING, etc.).
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the expression.
+ */
+static Node* parse_expression(Parser* parser) {
+    if (!enter_nesting(parser))
+        return NULL;
+
+    Node* expr = parse_logic_or(parser);
+    parser->depth--;
+    return expr;
+}
+
+/**
+ * @brief Parses a logical OR expression and constructs the corresponding AST node.
+ *
+ * A chain of `OR` operators becomes a single NODE_LOGICAL_EXPR holding every operand, so
+ * generated filters with thousands of terms stay one level deep.
+ *
+ * @return Pointer to the AST node representing the logical OR expression.
+ */
+static Node* parse_logic_or(Parser* parser) {
+    return parse_logical_chain(parser, TOKEN_OR, parse_logic_and(parser), parse_logic_and);
+}
+
+/**
+ * @brief Parses a logical AND expression and constructs the corresponding AST node.
+ *
+ * A chain of `AND` operators becomes a single NODE_LOGICAL_EXPR holding every operand.
+ *
+ * @param parser The parser instance.
+ * @return Node* The AST node representing the logical AND expression.
+ */
+static Node* parse_logic_and(Parser* parser) {
+    return parse_logical_chain(parser, TOKEN_AND, parse_equality(parser), parse_equality);
+}
+
+/**
+ * Parse the rest of a chain of one logical operator into an n-ary node.
+ *
+ * AND and OR are associative, so the operands are kept flat in source order instead of nesting
+ * one binary expression per operator.
+ *
+ * @param parser The parser instance.
+ * @param op TOKEN_AND or TOKEN_OR.
+ * @param first The operand before the first operator.
+ * @param parse_operand Parses each of the following operands.
+ * @return The NODE_LOGICAL_EXPR, or first if no operator follows it.
+ */
+static Node* parse_logical_chain(Parser* parser, NsqlTokenType op, Node* first,
+                                 Node* (*parse_operand)(Parser*)) {
+    if (!check(parser, op))
+        return first;
+
+    Node* node               = create_node(parser, NODE_LOGICAL_EXPR);
+    node->line               = parser->current.line;
+    node->as.logical_expr.op = op;
+
+    int capacity                      = 4;
+    node->as.logical_expr.operands    = (Node**)parser_alloc(parser, sizeof(Node*) * capacity);
+    node->as.logical_expr.operands[0] = first;
+    node->as.logical_expr.count       = 1;
+
+    while (match(parser, op)) {
+        if (node->as.logical_expr.count >= capacity) {
+            node->as.logical_expr.operands =
+                (Node**)parser_grow(parser, node->as.logical_expr.operands,
+                                    sizeof(Node*) * capacity, sizeof(Node*) * capacity * 2);
+            capacity *= 2;
+        }
+
+        node->as.logical_expr.operands[node->as.logical_expr.count++] = parse_operand(parser);
+    }
+
+    return node;
+}
+
+/**
+ * Parses an equality or inequality expression and constructs the corresponding AST node.
+ *
+ * Supports chaining of equality (`=`) and inequality (`!=`) operators, producing a left-associative
+ * binary expression tree.
+ *
+ * @return The root AST node representing the parsed equality expression.
+ */
+static Node* parse_equality(Parser* parser) {
+    Node* left = parse_comparison(parser);
+
+    while (match(parser, TOKEN_EQUAL) || match(parser, TOKEN_NEQ)) {
+        NsqlTokenType op           = parser->previous.type;
+        Node*         right        = parse_comparison(parser);
+        Node*         node         = create_node(parser, NODE_BINARY_EXPR);
+        node->line                 = parser->previous.line;
+        node->as.binary_expr.left  = left;
+        node->as.binary_expr.right = right;
+        node->as.binary_expr.op    = op;
+
+        left = node;
+    }
+
+    return left;
+}
+
+/**
+ * Parses a comparison expression with relational operators (<, <=, >, >=).
+ *
+ * @return An AST node representing the parsed comparison expression, or a simpler term if no
+ * comparison operator is present.
+ */
+static Node* parse_comparison(Parser* parser) {
+    Node* left = parse_term(parser);
+
+    if (match(parser, TOKEN_IN))
+        return parse_in_list(parser, left);
+
+    while (match(parser, TOKEN_LT) || match(parser, TOKEN_LTE) || match(parser, TOKEN_GT) ||
+           match(parser, TOKEN_GTE)) {
+        NsqlTokenType op           = parser->previous.type;
+        Node*         right        = parse_term(parser);
+        Node*         node         = create_node(parser, NODE_BINARY_EXPR);
+        node->line                 = parser->previous.line;
+        node->as.binary_expr.left  = left;
+        node->as.binary_expr.right = right;
+        node->as.binary_expr.op    = op;
+
+        left = node;
+    }
+
+    return left;
+}
+
+/**
+ * Parse the parenthesized list of an IN condition.
+ *
+ * @param parser The parser instance.
+ * @param value The expression before IN (already parsed).
+ * @return The NODE_IN_LIST, or NULL if an entry failed to parse.
+ */
+static Node* parse_in_list(Parser* parser, Node* value) {
+    Node* node            = create_node(parser, NODE_IN_LIST);
+    node->line            = parser->previous.line;
+    node->as.in_list.value = value;
+
+    if (!match(parser, TOKEN_LPAREN)) {
+        error_at_current(parser, "Expected '(' after 'IN'");
+        discard_node(parser, node);
+        return NULL;
+    }
+
+    int capacity           = 4;
+    node->as.in_list.items = (Node**)parser_alloc(parser, sizeof(Node*) * capacity);
+    node->as.in_list.count = 0;
+
+    // Parse the entries, stopping at an entry that failed
+    do {
+        if (node->as.in_list.count >= capacity) {
+            node->as.in_list.items =
+                (Node**)parser_grow(parser, node->as.in_list.items, sizeof(Node*) * capacity,
+                                    sizeof(Node*) * capacity * 2);
+            capacity *= 2;
+        }
+
+        node->as.in_list.items[node->as.in_list.count++] = parse_expression(parser);
+    } while (node->as.in_list.items[node->as.in_list.count - 1] != NULL &&
+             match(parser, TOKEN_COMMA));
+
+    // A failed entry has been reported, and the closing parenthesis would only add noise
+    if (node->as.in_list.items[node->as.in_list.count - 1] == NULL) {
+        discard_node(parser, node);
+        return NULL;
+    }
+
+    consume(parser, TOKEN_RPAREN, "Expected ')' after IN list");
+
+    return node;
+}
+
+/**
+ * @brief Parses an addition or subtraction expression.
+ *
+ * Parses a term consisting of one or more factors combined with '+' or '-' operators, constructing
+ * a left-associative binary expression AST node.
+ *
+ * @param parser Parser instance.
+ * @return Node* AST node representing the parsed term expression.
+ */
+static Node* parse_term(Parser* parser) {
+    Node* left = parse_factor(parser);
+
+    while (match(parser, TOKEN_PLUS) || match(parser, TOKEN_MINUS)) {
+        NsqlTokenType op           = parser->previous.type;
+        Node*         right        = parse_factor(parser);
+        Node*         node         = create_node(parser, NODE_BINARY_EXPR);
+        node->line                 = parser->previous.line;
+        node->as.binary_expr.left  = left;
+        node->as.binary_expr.right = right;
+        node->as.binary_expr.op    = op;
+
+        left = node;
+    }
+
+    return left;
+}
+
+/**
+ * @brief Parses a factor expression involving multiplication, division, or modulo.
+ *
+ * Parses left-associative binary expressions with '*', '/', or '%' operators, building the
+ * corresponding AST subtree.
+ *
+ * @param parser The parser instance.
+ * @return Node* The AST node representing the parsed factor expression.
+ */
+static Node* parse_factor(Parser* parser) {
+    Node* left = parse_unary(parser);
+
+    while (match(parser, TOKEN_STAR) || match(parser, TOKEN_SLASH) ||
+           match(parser, TOKEN_PERCENT)) {
+        NsqlTokenType op    = parser->previous.type;
+        Node*         right = parse_unary(parser);
+
+        Node* binary                 = create_node(parser, NODE_BINARY_EXPR);
+        binary->line                 = left ? left->line : parser->previous.line;
+        binary->as.binary_expr.left  = left;
+        binary->as.binary_expr.op    = op;
+        binary->as.binary_expr.right = right;
+        left                         = binary;
+    }
+
+    return left;
+}
+
+/**
+ * Parses a unary expression, handling logical NOT and negation operators.
+ *
+ * Returns an AST node representing either a unary operation or a primary expression if no unary
+ * operator is present.
+ *
+ * @return Node* The AST node for the parsed unary expression.
+ */
+static Node* parse_unary(Parser* parser) {
+    if (match(parser, TOKEN_NOT) || match(parser, TOKEN_MINUS)) {
+        NsqlTokenType op = parser->previous.type;
+        if (!enter_nesting(parser))
+            return NULL;
+
+        Node* right = parse_unary(parser);
+        parser->depth--;
+
+        Node* unary                  = create_node(parser, NODE_UNARY_EXPR);
+        unary->line                  = parser->previous.line;
+        unary->as.unary_expr.op      = op;
+        unary->as.unary_expr.operand = right;
+        return unary;
+    }
+
+    return parse_primary(parser);
+}
+
+/**
+ * Parse primary expression (identifiers, literals, etc.).
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the primary expression.
+ */
+static Node* parse_primary(Parser* parser) {
+    if (match(parser, TOKEN_STRING)) {
+        Node* node                    = create_node(parser, NODE_LITERAL);
+        node->line                    = parser->previous.line;
+        node->as.literal.literal_type = TOKEN_STRING;
+
+        // Extract string value (excluding quotes)
+        int length              = parser->previous.length - 2;  // Exclude quotes
+        node->as.literal.length = length;
+        node->as.literal.value.string_value =
+            node_string(parser, node, parser->previous.start + 1, length);  // Skip opening quote
+
+        return node;
+    }
+
+    if (match(parser, TOKEN_INTEGER)) {
+        Node* node                    = create_node(parser, NODE_LITERAL);
+        node->line                    = parser->previous.line;
+        node->as.literal.literal_type = TOKEN_INTEGER;
+
+        // Convert string to integer
+        node->as.literal.value.number_value = token_integer(&parser->previous);
+
+        return node;
+    }
+
+    if (match(parser, TOKEN_DECIMAL)) {
+        Node* node                    = create_node(parser, NODE_LITERAL);
+        node->line                    = parser->previous.line;
+        node->as.literal.literal_type = TOKEN_DECIMAL;
+
+        // Convert string to decimal
+        const Token* token                  = &parser->previous;
+        node->as.literal.value.number_value =
+            nsql_scan_decimal_value(token->start, token->start + token->length);
+        return node;
+    }
+
+    if (match(parser, TOKEN_PARAMETER)) {
+        Node* node               = create_node(parser, NODE_PARAMETER);
+        node->line               = parser->previous.line;
+        node->as.parameter.index = next_parameter(parser);
+        return node;
+    }
+
+    if (check(parser, TOKEN_IDENTIFIER)) {
+        // Check if it's a function call or just an identifier
+        Token id_token = parser->current;
+        advance(parser);
+
+        if (check(parser, TOKEN_LPAREN)) {
+            // Function call, the name is the token we just consumed
+            return parse_function_call(parser);
+        } else {
+            Node* node = create_node(parser, NODE_IDENTIFIER);
+            node->line = id_token.line;
+            set_identifier(parser, node, &id_token);
+
+            return node;
+        }
+    }
+
+    if (match(parser, TOKEN_LPAREN)) {
+        Node* expr = parse_expression(parser);
+        if (expr == NULL)
+            return NULL;  // Already reported, and the closing parenthesis would only add noise
+        consume(parser, TOKEN_RPAREN, "Expected ')' after expression");
+        return expr;
+    }
+
+    error_at_current(parser, "Expected expression");
+    return NULL;
+}
+
+/**
+ * Parse function call.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the function call, or NULL if an argument failed to parse.
+ */
+static Node* parse_function_call(Parser* parser) {
+    Node* node = create_node(parser, NODE_FUNCTION_CALL);
+    node->line = parser->previous.line;
+
+    // Function name (already consumed by parse_primary)
+    node->as.function_call.name = copy_token_string(parser, &parser->previous);
+
+    // Parse opening parenthesis
+    consume(parser, TOKEN_LPAREN, "Expected '(' after function name");
+
+    // Parse arguments
+    int capacity                = 4;
+    node->as.function_call.args = (Node**)parser_alloc(parser, sizeof(Node*) * capacity);
+
+    node->as.function_call.arg_count = 0;
+
+    // Check for arguments
+    if (!check(parser, TOKEN_RPAREN)) {
+        // Parse first argument
+        node->as.function_call.args[node->as.function_call.arg_count++] = parse_expression(parser);
+
+        // Parse additional arguments, stopping at an argument that failed
+        while (node->as.function_call.args[node->as.function_call.arg_count - 1] != NULL &&
+               match(parser, TOKEN_COMMA)) {
+            if (node->as.function_call.arg_count >= capacity) {
+                node->as.function_call.args =
+                    (Node**)parser_grow(parser, node->as.function_call.args,
+                                        sizeof(Node*) * capacity, sizeof(Node*) * capacity * 2);
+                capacity *= 2;
+            }
+
+            node->as.function_call.args[node->as.function_call.arg_count++] =
+                parse_expression(parser);
+        }
+    }
+
+    // A failed argument has been reported, and the closing parenthesis would only add noise
+    if (node->as.function_call.arg_count > 0 &&
+        node->as.function_call.args[node->as.function_call.arg_count - 1] == NULL) {
+        discard_node(parser, node);
+        return NULL;
+    }
+
+    // Parse closing parenthesis
+    consume(parser, TOKEN_RPAREN, "Expected ')' after function arguments");
+
+    return node;
+}
+
+/**
+ * Free the memory a node owns besides its children, then the node itself.
+ *
+ * Runs after the children of the node have been freed.
+ *
+ * @param frame The node.
+ * @param user_data Unused.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction free_node_fields(const AstVisitFrame* frame, void* user_data) {
+    Node* node = frame->node;
+    (void)user_data;
+
+    switch (node->type) {
+        case NODE_FIELD_LIST:
+            free(node->as.field_list.fields);
+            break;
+
+        case NODE_ORDER_BY:
+            free(node->as.order_by.fields);
+            free(node->as.order_by.ascending);
+            break;
+
+        case NODE_UPDATE_ACTION:
+            free(node->as.update_action.fields);
+            free(node->as.update_action.values);
+            break;
+
+        case NODE_CREATE_ACTION:
+            free(node->as.create_action.field_defs);
+            break;
+
+        case NODE_IDENTIFIER:
+            if (!(node->flags & NODE_FLAG_BORROWED))
+                free(node->as.identifier.name);
+            break;
+
+        case NODE_FUNCTION_CALL:
+            free(node->as.function_call.name);
+            free(node->as.function_call.args);
+            break;
+
+        case NODE_LOGICAL_EXPR:
+            free(node->as.logical_expr.operands);
+            break;
+
+        case NODE_IN_LIST:
+            free(node->as.in_list.items);
+            break;
+
+        case NODE_LITERAL:
+            if (node->as.literal.literal_type == TOKEN_STRING &&
+                !(node->flags & NODE_FLAG_BORROWED)) {
+                free(node->as.literal.value.string_value);
+            }
+            break;
+
+        case NODE_FIELD_DEF:
+            free(node->as.field_def.type);
+            free(node->as.field_def.constraints);
+            break;
+
+        case NODE_ERROR:
+            free(node->as.error.message);
+            break;
+
+        case NODE_PROGRAM:
+            free(node->as.program.statements);
+            break;
+
+        default:
+            break;
+    }
+
+    free(node);
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Free AST nodes based on type.
+ *
+ * The tree is freed in postorder by ast_visit(), so arbitrarily deep trees do not grow the C
+ * stack.
+ *
+ * @param node The AST node to free.
+ */
+void free_node(Node* node) {
+    AstVisitor visitor = {NULL, free_node_fields, NULL, false};
+    ast_visit(node, &visitor);
+}
+
+/**
+ * Duplicate a counted string into a new heap allocation.
+ *
+ * @param str The characters to copy (may be NULL).
+ * @param length The number of characters to copy.
+ * @return The null-terminated copy, or NULL if str is NULL.
+ */
+static char* clone_string(const char* str, size_t length) {
+    if (str == NULL)
+        return NULL;
+
+    char* copy = (char*)malloc(length + 1);
+    if (copy == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/**
+ * State of ast_clone(), whose walk keeps everything on the heap so that deep trees can be copied.
+ */
+typedef struct {
+    Node**  copies;         // Copied subtrees waiting for their parent, in visit order
+    size_t  count;          // Number of copied subtrees
+    size_t  capacity;       // Allocated copies
+    size_t* marks;          // Number of copied subtrees when each ancestor was entered, by depth
+    size_t  mark_capacity;  // Allocated marks
+    size_t  next;           // Next copied subtree for the node being copied to take
+} CloneState;
+
+/**
+ * Grow a clone stack to hold at least the given number of entries.
+ *
+ * @param data The array (may be NULL).
+ * @param capacity The allocated entries, updated on growth.
+ * @param needed The number of entries needed.
+ * @param size The size of an entry.
+ * @return The array, possibly moved.
+ */
+static void* grow_clone_stack(void* data, size_t* capacity, size_t needed, size_t size) {
+    if (needed <= *capacity)
+        return data;
+
+    size_t new_capacity = *capacity > 0 ? *capacity * 2 : 32;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+
+    void* grown = realloc(data, new_capacity * size);
+    if (grown == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+/**
+ * Take the copy of a child, which was made before its parent.
+ *
+ * @param state The clone state.
+ * @param child The child (may be NULL).
+ * @return The copy, or NULL if the child is NULL.
+ */
+static Node* take_clone(CloneState* state, const Node* child) {
+    return child != NULL ? state->copies[state->next++] : NULL;
+}
+
+/**
+ * Allocate the copy of an array of child nodes, to be filled in by the caller.
+ *
+ * @param nodes The array to copy.
+ * @param count The number of entries in the array.
+ * @return The uninitialized array, or NULL if the source array is NULL.
+ */
+static Node** new_node_array(Node* const* nodes, int count) {
+    if (nodes == NULL)
+        return NULL;
+
+    // Keep at least one slot so an empty list is still a valid array
+    Node** copy = (Node**)malloc((count > 0 ? count : 1) * sizeof(Node*));
+    if (copy == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return copy;
+}
+
+/**
+ * Take the copies of an array of child nodes.
+ *
+ * @param state The clone state.
+ * @param nodes The array to copy.
+ * @param count The number of entries in the array.
+ * @return The copied array, or NULL if the source array is NULL.
+ */
+static Node** clone_node_array(CloneState* state, Node* const* nodes, int count) {
+    Node** copy = new_node_array(nodes, count);
+    for (int i = 0; copy != NULL && i < count; i++) {
+        copy[i] = take_clone(state, nodes[i]);
+    }
+    return copy;
+}
+
+/**
+ * Copy a node whose children are already copied, taking the copies in slot order.
+ *
+ * @param state The clone state.
+ * @param node The node to copy.
+ * @return The copy.
+ */
+static Node* clone_node(CloneState* state, const Node* node) {
+    Node* copy = (Node*)malloc(sizeof(Node));
+    if (copy == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Scalar fields are copied as-is, pointer fields are replaced below
+    *copy       = *node;
+    copy->flags = node->flags & ~NODE_FLAG_BORROWED;
+
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            copy->as.ask_query.source    = take_clone(state, node->as.ask_query.source);
+            copy->as.ask_query.fields    = take_clone(state, node->as.ask_query.fields);
+            copy->as.ask_query.condition = take_clone(state, node->as.ask_query.condition);
+            copy->as.ask_query.group_by  = take_clone(state, node->as.ask_query.group_by);
+            copy->as.ask_query.order_by  = take_clone(state, node->as.ask_query.order_by);
+            copy->as.ask_query.limit     = take_clone(state, node->as.ask_query.limit);
+            break;
+
+        case NODE_TELL_QUERY:
+            copy->as.tell_query.source    = take_clone(state, node->as.tell_query.source);
+            copy->as.tell_query.action    = take_clone(state, node->as.tell_query.action);
+            copy->as.tell_query.condition = take_clone(state, node->as.tell_query.condition);
+            break;
+
+        case NODE_FIND_QUERY:
+            copy->as.find_query.source    = take_clone(state, node->as.find_query.source);
+            copy->as.find_query.condition = take_clone(state, node->as.find_query.condition);
+            copy->as.find_query.group_by  = take_clone(state, node->as.find_query.group_by);
+            copy->as.find_query.order_by  = take_clone(state, node->as.find_query.order_by);
+            copy->as.find_query.limit     = take_clone(state, node->as.find_query.limit);
+            break;
+
+        case NODE_FIELD_LIST:
+            copy->as.field_list.fields =
+                clone_node_array(state, node->as.field_list.fields, node->as.field_list.count);
+            break;
+
+        case NODE_SOURCE:
+            copy->as.source.identifier = take_clone(state, node->as.source.identifier);
+            copy->as.source.join       = take_clone(state, node->as.source.join);
+            break;
+
+        case NODE_JOIN:
+            copy->as.join.source    = take_clone(state, node->as.join.source);
+            copy->as.join.condition = take_clone(state, node->as.join.condition);
+            break;
+
+        case NODE_GROUP_BY:
+            copy->as.group_by.fields = take_clone(state, node->as.group_by.fields);
+            copy->as.group_by.having = take_clone(state, node->as.group_by.having);
+            break;
+
+        case NODE_ORDER_BY:
+            copy->as.order_by.fields =
+                clone_node_array(state, node->as.order_by.fields, node->as.order_by.count);
+            if (node->as.order_by.ascending != NULL) {
+                int count = node->as.order_by.count > 0 ? node->as.order_by.count : 1;
+                copy->as.order_by.ascending = (bool*)malloc(count * sizeof(bool));
+                if (copy->as.order_by.ascending == NULL) {
+                    fprintf(stderr, "Error: Out of memory\n");
+                    exit(EXIT_FAILURE);
+                }
+                memcpy(copy->as.order_by.ascending, node->as.order_by.ascending,
+                       node->as.order_by.count * sizeof(bool));
+            }
+            break;
+
+        case NODE_ADD_ACTION:
+            copy->as.add_action.value       = take_clone(state, node->as.add_action.value);
+            copy->as.add_action.record_spec = take_clone(state, node->as.add_action.record_spec);
+            break;
+
+        case NODE_REMOVE_ACTION:
+            copy->as.remove_action.condition =
+                take_clone(state, node->as.remove_action.condition);
+            break;
+
+        case NODE_UPDATE_ACTION:
+            // Each field is followed by its value in slot order
+            copy->as.update_action.fields =
+                new_node_array(node->as.update_action.fields, node->as.update_action.count);
+            copy->as.update_action.values =
+                new_node_array(node->as.update_action.values, node->as.update_action.count);
+            for (int i = 0; i < node->as.update_action.count; i++) {
+                copy->as.update_action.fields[i] =
+                    take_clone(state, node->as.update_action.fields[i]);
+                copy->as.update_action.values[i] =
+                    take_clone(state, node->as.update_action.values[i]);
+            }
+            break;
+
+        case NODE_CREATE_ACTION:
+            copy->as.create_action.field_defs = clone_node_array(
+                state, node->as.create_action.field_defs, node->as.create_action.count);
+            break;
+
+        case NODE_BINARY_EXPR:
+            copy->as.binary_expr.left  = take_clone(state, node->as.binary_expr.left);
+            copy->as.binary_expr.right = take_clone(state, node->as.binary_expr.right);
+            break;
+
+        case NODE_UNARY_EXPR:
+            copy->as.unary_expr.operand = take_clone(state, node->as.unary_expr.operand);
+            break;
+
+        case NODE_LOGICAL_EXPR:
+            copy->as.logical_expr.operands = clone_node_array(
+                state, node->as.logical_expr.operands, node->as.logical_expr.count);
+            break;
+
+        case NODE_IN_LIST:
+            copy->as.in_list.value = take_clone(state, node->as.in_list.value);
+            copy->as.in_list.items =
+                clone_node_array(state, node->as.in_list.items, node->as.in_list.count);
+            break;
+
+        case NODE_IDENTIFIER:
+            copy->as.identifier.name =
+                clone_string(node->as.identifier.name, node->as.identifier.length);
+            break;
+
+        case NODE_LITERAL:
+            if (node->as.literal.literal_type == TOKEN_STRING) {
+                copy->as.literal.value.string_value =
+                    clone_string(node->as.literal.value.string_value, node->as.literal.length);
+            }
+            break;
+
+        case NODE_FIELD_DEF:
+            copy->as.field_def.name = take_clone(state, node->as.field_def.name);
+            copy->as.field_def.type =
+                node->as.field_def.type != NULL
+                    ? clone_string(node->as.field_def.type, strlen(node->as.field_def.type))
+                    : NULL;
+            copy->as.field_def.constraints = clone_node_array(
+                state, node->as.field_def.constraints, node->as.field_def.constraint_count);
+            break;
+
+        case NODE_CONSTRAINT:
+            copy->as.constraint.default_value =
+                take_clone(state, node->as.constraint.default_value);
+            break;
+
+        case NODE_FUNCTION_CALL:
+            copy->as.function_call.name =
+                node->as.function_call.name != NULL
+                    ? clone_string(node->as.function_call.name, strlen(node->as.function_call.name))
+                    : NULL;
+            copy->as.function_call.args = clone_node_array(
+                state, node->as.function_call.args, node->as.function_call.arg_count);
+            break;
+
+        case NODE_ERROR:
+            copy->as.error.message =
+                node->as.error.message != NULL
+                    ? clone_string(node->as.error.message, strlen(node->as.error.message))
+                    : NULL;
+            break;
+
+        case NODE_PROGRAM:
+            copy->as.program.statements =
+                clone_node_array(state, node->as.program.statements, node->as.program.count);
+            break;
+
+        default:
+            break;
+    }
+
+    return copy;
+}
+
+/**
+ * Note how many copies were made before a node, so it knows where the copies of its children start.
+ *
+ * @param frame The node.
+ * @param user_data The clone state.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction clone_enter(const AstVisitFrame* frame, void* user_data) {
+    CloneState* state = (CloneState*)user_data;
+    size_t      depth = (size_t)frame->depth;
+
+    state->marks = (size_t*)grow_clone_stack(state->marks, &state->mark_capacity, depth + 1,
+                                             sizeof(size_t));
+    state->marks[depth] = state->count;
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Copy a node, replacing the copies of its children with the copy of the node.
+ *
+ * @param frame The node.
+ * @param user_data The clone state.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction clone_leave(const AstVisitFrame* frame, void* user_data) {
+    CloneState* state = (CloneState*)user_data;
+    size_t      mark  = state->marks[frame->depth];
+
+    state->next  = mark;
+    Node* copy   = clone_node(state, frame->node);
+    state->count = mark;
+
+    state->copies = (Node**)grow_clone_stack(state->copies, &state->capacity, state->count + 1,
+                                             sizeof(Node*));
+    state->copies[state->count++] = copy;
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Create a detached deep copy of an AST.
+ *
+ * The copy is made in postorder by ast_visit(), so arbitrarily deep trees do not grow the C
+ * stack.
+ *
+ * @param node The node to copy.
+ * @return The copied tree, owned by the caller.
+ */
+Node* ast_clone(const Node* node) {
+    if (node == NULL)
+        return NULL;
+
+    CloneState state   = {NULL, 0, 0, NULL, 0, 0};
+    AstVisitor visitor = {clone_enter, clone_leave, &state, false};
+    ast_visit((Node*)node, &visitor);
+
+    Node* copy = state.copies[0];
+    free(state.copies);
+    free(state.marks);
+    return copy;
+}
+
+/**
+ * Helper for printing indentation.
+ *
+ * @param indent The indentation level.
+ */
+static void print_indent(int indent) {
+    for (int i = 0; i < indent; i++) {
+        printf("  ");
+    }
+}
+
+// How print_ast() shows a child slot
+typedef struct {
+    const char* label;   // Heading printed above the child (NULL for none)
+    int         indent;  // Indentation of the child relative to its parent
+    const char* absent;  // Printed in place of an empty slot (NULL to print nothing)
+    bool        hidden;  // The slot is not printed at all
+} DumpSlot;
+
+// Indentation of the nodes print_ast() is inside of
+typedef struct {
+    int*   indents;   // Indentation of the open node at each depth
+    size_t capacity;  // Allocated entries
+} AstDump;
+
+/**
+ * Describe a slot that has a fixed heading.
+ *
+ * @param labels The headings of the slots of the parent.
+ * @param required Number of leading slots printed as "NULL" when empty.
+ * @param slot The slot.
+ * @return The slot description.
+ */
+static DumpSlot labeled_slot(const char* const* labels, int required, int slot) {
+    DumpSlot result = {labels[slot], 2, slot < required ? "NULL" : NULL, false};
+    return result;
+}
+
+/**
+ * Describe a numbered slot of a list, formatting its heading.
+ *
+ * @param label Buffer for the heading.
+ * @param size Size of the buffer.
+ * @param format Heading format, taking the 1-based entry number.
+ * @param number The entry number.
+ * @return The slot description.
+ */
+static DumpSlot numbered_slot(char* label, size_t size, const char* format, int number) {
+    snprintf(label, size, format, number);
+    DumpSlot result = {label, 2, "NULL", false};
+    return result;
+}
+
+/**
+ * Describe how print_ast() shows a child slot.
+ *
+ * @param parent The parent node.
+ * @param slot The slot.
+ * @param present Does the slot hold a child?
+ * @param label Buffer for formatted headings.
+ * @param size Size of the buffer.
+ * @return The slot description.
+ */
+static DumpSlot dump_slot(const Node* parent, int slot, bool present, char* label, size_t size) {
+    static const char* const query_labels[] = {"Source:",   "Fields:",   "Condition:",
+                                               "Group By:", "Order By:", "Limit:"};
+    static const char* const tell_labels[]  = {"Source:", "Action:", "Condition:"};
+    static const char* const find_labels[]  = {"Source:", "Condition:", "Group By:", "Order By:",
+                                               "Limit:"};
+    static const char* const source_labels[]   = {"Name:", "Join:"};
+    static const char* const join_labels[]     = {"Source:", "Condition:"};
+    static const char* const group_labels[]    = {"Fields:", "Having:"};
+    static const char* const add_labels[]      = {"Value:", "Record Spec:"};
+    static const char* const binary_labels[]   = {"Left:", "Right:"};
+    static const char* const operand_labels[]  = {"Operand:"};
+    static const char* const name_labels[]     = {"Name:"};
+    static const char* const value_labels[]    = {"Value:"};
+    static const char* const condition_label[] = {"Condition:"};
+
+    DumpSlot entry = {NULL, 1, "NULL", false};
+
+    switch (parent->type) {
+        case NODE_ASK_QUERY:
+        case NODE_SHOW_QUERY:
+        case NODE_GET_QUERY:
+            return labeled_slot(query_labels, 2, slot);
+
+        case NODE_TELL_QUERY:
+            return labeled_slot(tell_labels, 2, slot);
+
+        case NODE_FIND_QUERY:
+            return labeled_slot(find_labels, 1, slot);
+
+        case NODE_SOURCE:
+            return labeled_slot(source_labels, 1, slot);
+
+        case NODE_JOIN:
+            return labeled_slot(join_labels, 2, slot);
+
+        case NODE_GROUP_BY:
+            return labeled_slot(group_labels, 1, slot);
+
+        case NODE_ADD_ACTION:
+            return labeled_slot(add_labels, 1, slot);
+
+        case NODE_BINARY_EXPR:
+            return labeled_slot(binary_labels, 2, slot);
+
+        case NODE_UNARY_EXPR:
+            return labeled_slot(operand_labels, 1, slot);
+
+        case NODE_REMOVE_ACTION:
+            if (present)
+                return labeled_slot(condition_label, 0, slot);
+            entry.absent = "(Remove all)";
+            return entry;
+
+        case NODE_ORDER_BY:
+            snprintf(label, size, "Field %d (%s):", slot + 1,
+                     parent->as.order_by.ascending[slot] ? "ASC" : "DESC");
+            entry.label  = label;
+            entry.indent = 2;
+            return entry;
+
+        case NODE_UPDATE_ACTION:
+            return numbered_slot(label, size, slot % 2 == 0 ? "Field %d:" : "Value %d:",
+                                 slot / 2 + 1);
+
+        case NODE_FUNCTION_CALL:
+            return numbered_slot(label, size, "Arg %d:", slot + 1);
+
+        case NODE_LOGICAL_EXPR:
+            return numbered_slot(label, size, "Operand %d:", slot + 1);
+
+        case NODE_IN_LIST:
+            // The value comes before the items
+            if (slot == 0)
+                return labeled_slot(value_labels, 1, slot);
+            return numbered_slot(label, size, "Item %d:", slot);
+
+        case NODE_PROGRAM:
+            return numbered_slot(label, size, "Statement %d:", slot + 1);
+
+        case NODE_FIELD_DEF:
+            // The constraints sit under a heading printed after the name
+            if (slot == 0)
+                return labeled_slot(name_labels, 1, slot);
+            entry.indent = 2;
+            return entry;
+
+        case NODE_CONSTRAINT:
+            // Only DEFAULT constraints show their value
+            if (parent->as.constraint.type == CONSTRAINT_DEFAULT)
+                return labeled_slot(value_labels, 1, slot);
+            entry.hidden = true;
+            return entry;
+
+        default:
+            // List entries are printed without a heading
+            return entry;
+    }
+}
+
+/**
+ * Print the line of a node, and the operator of expressions, without its children.
+ *
+ * @param node The node.
+ * @param indent The indentation of the node.
+ */
+static void print_node_line(const Node* node, int indent) {
+    switch (node->type) {
+        case NODE_ASK_QUERY:
+            printf("ASK QUERY:\n");
+            break;
+
+        case NODE_TELL_QUERY:
+            printf("TELL QUERY:\n");
+            break;
+
+        case NODE_FIND_QUERY:
+            printf("FIND QUERY:\n");
+            break;
+
+        case NODE_SHOW_QUERY:
+            printf("SHOW QUERY:\n");
+            break;
+
+        case NODE_GET_QUERY:
+            printf("GET QUERY:\n");
+            break;
+
+        case NODE_FIELD_LIST:
+            printf("FIELD LIST (%d fields):\n", node->as.field_list.count);
+            break;
+
+        case NODE_SOURCE:
+            printf("SOURCE:\n");
+            break;
+
+        case NODE_JOIN:
+            printf("JOIN:\n");
+            break;
+
+        case NODE_GROUP_BY:
+            printf("GROUP BY:\n");
+            break;
+
+        case NODE_ORDER_BY:
+            printf("ORDER BY (%d fields):\n", node->as.order_by.count);
+            break;
+
+        case NODE_LIMIT:
+            if (LIMIT_IS_PARAMETER(node->as.limit.limit))
+                printf("LIMIT: ?%d", LIMIT_PARAMETER_INDEX(node->as.limit.limit));
+            else
+                printf("LIMIT: %d", node->as.limit.limit);
+            if (LIMIT_IS_PARAMETER(node->as.limit.offset)) {
+                printf(" OFFSET: ?%d", LIMIT_PARAMETER_INDEX(node->as.limit.offset));
+            } else if (node->as.limit.offset > 0) {
+                printf(" OFFSET: %d", node->as.limit.offset);
+            }
+            printf("\n");
+            break;
+
+        case NODE_ADD_ACTION:
+            printf("ADD ACTION:\n");
+            break;
+
+        case NODE_REMOVE_ACTION:
+            printf("REMOVE ACTION:\n");
+            break;
+
+        case NODE_UPDATE_ACTION:
+            printf("UPDATE ACTION (%d fields):\n", node->as.update_action.count);
+            break;
+
+        case NODE_CREATE_ACTION:
+            printf("CREATE ACTION (%d fields):\n", node->as.create_action.count);
+            break;
+
+        case NODE_BINARY_EXPR:
+            printf("BINARY EXPRESSION:\n");
+            print_indent(indent + 1);
+            printf("Operator: %s\n", token_type_to_op_string(node->as.binary_expr.op));
+            break;
+
+        case NODE_UNARY_EXPR:
+            printf("UNARY EXPRESSION:\n");
+            print_indent(indent + 1);
+            printf("Operator: %s\n", token_type_to_op_string(node->as.unary_expr.op));
+            break;
+
+        case NODE_LOGICAL_EXPR:
+            printf("LOGICAL EXPRESSION (%d operands):\n", node->as.logical_expr.count);
+            print_indent(indent + 1);
+            printf("Operator: %s\n", token_type_to_op_string(node->as.logical_expr.op));
+            break;
+
+        case NODE_IN_LIST:
+            printf("IN LIST (%d items):\n", node->as.in_list.count);
+            break;
+
+        case NODE_IDENTIFIER:
+            printf("IDENTIFIER: %.*s\n", node->as.identifier.length, node->as.identifier.name);
+            break;
+
+        case NODE_FUNCTION_CALL:
+            printf("FUNCTION CALL: %s (%d args)\n", node->as.function_call.name,
+                   node->as.function_call.arg_count);
+            break;
+
+        case NODE_LITERAL:
+            switch (node->as.literal.literal_type) {
+                case TOKEN_STRING:
+                    printf("STRING: \"%.*s\"\n", node->as.literal.length,
+                           node->as.literal.value.string_value);
+                    break;
+                case TOKEN_INTEGER:
+                    printf("INTEGER: %g\n", node->as.literal.value.number_value);
+                    break;
+                case TOKEN_DECIMAL:
+                    printf("DECIMAL: %g\n", node->as.literal.value.number_value);
+                    break;
+                default:
+                    printf("LITERAL: UNKNOWN TYPE\n");
+                    break;
+            }
+            break;
+
+        case NODE_FIELD_DEF:
+            printf("FIELD DEFINITION:\n");
+            break;
+
+        case NODE_CONSTRAINT:
+            printf("CONSTRAINT: ");
+            switch (node->as.constraint.type) {
+                case CONSTRAINT_REQUIRED:
+                    printf("REQUIRED\n");
+                    break;
+                case CONSTRAINT_UNIQUE:
+                    printf("UNIQUE\n");
+                    break;
+                case CONSTRAINT_DEFAULT:
+                    printf("DEFAULT\n");
+                    break;
+            }
+            break;
+
+        case NODE_ERROR:
+            printf("ERROR: %s\n", node->as.error.message);
+            break;
+
+        case NODE_PROGRAM:
+            printf("PROGRAM (%d statements):\n", node->as.program.count);
+            break;
+
+        case NODE_PARAMETER:
+            printf("PARAMETER: ?%d\n", node->as.parameter.index);
+            break;
+
+        default:
+            printf("UNKNOWN NODE TYPE: %d\n", node->type);
+            break;
+    }
+}
+
+/**
+ * Print a node, or an empty slot, with the heading of its slot.
+ *
+ * @param frame The node.
+ * @param user_data The AstDump.
+ * @return AST_VISIT_SKIP for empty and hidden slots, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction dump_pre(const AstVisitFrame* frame, void* user_data) {
+    AstDump* dump   = (AstDump*)user_data;
+    DumpSlot slot   = {NULL, 0, "NULL", false};  // The root has no heading
+    int      indent = dump->indents[0];
+    char     label[32];
+
+    if (frame->parent) {
+        int parent_indent = dump->indents[frame->depth - 1];
+        slot = dump_slot(frame->parent, frame->slot, frame->node != NULL, label, sizeof(label));
+        if (slot.hidden || (!frame->node && !slot.absent))
+            return AST_VISIT_SKIP;
+
+        if (slot.label) {
+            print_indent(parent_indent + 1);
+            printf("%s\n", slot.label);
+        }
+        indent = parent_indent + slot.indent;
+    }
+
+    print_indent(indent);
+    if (!frame->node) {
+        printf("%s\n", slot.absent);
+        return AST_VISIT_SKIP;
+    }
+
+    if ((size_t)frame->depth >= dump->capacity) {
+        dump->capacity *= 2;
+        dump->indents = (int*)realloc(dump->indents, dump->capacity * sizeof(int));
+        if (dump->indents == NULL) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    dump->indents[frame->depth] = indent;
+
+    print_node_line(frame->node, indent);
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Print the type and constraint heading of a field definition once its name is done.
+ *
+ * @param frame The node.
+ * @param user_data The AstDump.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction dump_post(const AstVisitFrame* frame, void* user_data) {
+    AstDump*    dump   = (AstDump*)user_data;
+    const Node* parent = frame->parent;
+    if (!parent || parent->type != NODE_FIELD_DEF || frame->slot != 0)
+        return AST_VISIT_CONTINUE;
+
+    int indent = dump->indents[frame->depth - 1];
+    if (parent->as.field_def.type != NULL) {
+        print_indent(indent + 1);
+        printf("Type: %s\n", parent->as.field_def.type);
+    }
+    if (parent->as.field_def.constraint_count > 0) {
+        print_indent(indent + 1);
+        printf("Constraints (%d):\n", parent->as.field_def.constraint_count);
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Print AST for debugging.
+ *
+ * @param node The AST node to print.
+ * @param indent The indentation level.
+ */
+void print_ast(Node* node, int indent) {
+    AstDump dump;
+    dump.capacity = 16;
+    dump.indents  = (int*)malloc(dump.capacity * sizeof(int));
+    if (dump.indents == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    dump.indents[0] = indent;
+
+    AstVisitor visitor = {dump_pre, dump_post, &dump, true};
+    ast_visit(node, &visitor);
+    free(dump.indents);
+}
+
+/**
+ * Parse a complete program, which may contain multiple queries.
+ *
+ * @param parser The parser instance.
+ * @return The AST node representing the program.
+ */
+Node* parse_program(Parser* parser) {
+    Node* program = create_node(parser, NODE_PROGRAM);
+    program->line = parser->current.line;
+
+    // Allocate initial space for statements
+    int capacity                   = 4;
+    program->as.program.statements = (Node**)parser_alloc(parser, capacity * sizeof(Node*));
+
+    program->as.program.count = 0;
+
+    // Parse statements until EOF
+    while (!check(parser, TOKEN_EOF)) {
+        // Parse a query
+        Node* stmt = parse_query(parser);
+
+        // Add the statement to the program if parsing succeeded
+        if (stmt != NULL && !parser->had_error) {
+            if (program->as.program.count >= capacity) {
+                program->as.program.statements =
+                    (Node**)parser_grow(parser, program->as.program.statements,
+                                        capacity * sizeof(Node*), capacity * 2 * sizeof(Node*));
+                capacity *= 2;
+            }
+
+            program->as.program.statements[program->as.program.count++] = stmt;
+
+            // Look for a PLEASE or ; statement ender
+            if (!check(parser, TOKEN_EOF) && !match(parser, TOKEN_TERMINATOR)) {
+                error_at_current(parser, "Expected 'PLEASE'  or ';' after statement");
+                break;
+            }
+        } else {
+            // Free the statement if we had an error
+            if (stmt != NULL) {
+                discard_node(parser, stmt);
+            }
+            
+            // error_at() already performed synchronization; avoid double-sync
+            if (parser->had_error) {
+                // If we couldn't recover, just exit
+                break;
+            }
+        }
+    }
+
+    // If we had errors and no statements, free the program
+    if (parser->had_error && program->as.program.count == 0) {
+        discard_node(parser, program);
+        return NULL;
+    }
+
+    return program;
+}
+
+/**
+ * Skip the rest of a statement that failed to parse.
+ *
+ * Stops at the next query keyword, or just past the next statement terminator, so the following
+ * statement can be parsed even when error recovery is compiled out.
+ *
+ * @param parser The parser instance.
+ */
+static void skip_statement(Parser* parser) {
+    while (!check(parser, TOKEN_EOF) && !is_query_start(parser->current.type)) {
+        if (match(parser, TOKEN_TERMINATOR))
+            return;
+        advance(parser);
+    }
+}
+
+/**
+ * Parse the next statement and its terminator.
+ *
+ * A statement with errors is discarded after its errors are recorded, and the parser is moved to
+ * the start of the following statement.
+ *
+ * @param parser The parser instance.
+ * @param statement Receives the statement, or NULL if it had errors.
+ * @return false at end of input or once a limit is reached, true otherwise.
+ */
+bool parse_next_statement(Parser* parser, Node** statement) {
+    *statement = NULL;
+    if (check(parser, TOKEN_EOF) || parser->limit_reached)
+        return false;
+
+    bool had_error    = parser->had_error;
+    parser->had_error = false;
+
+    Node* stmt = parse_query(parser);
+
+    // Look for a PLEASE or ; statement ender
+    if (!parser->had_error && !check(parser, TOKEN_EOF) && !match(parser, TOKEN_TERMINATOR))
+        error_at_current(parser, "Expected 'PLEASE'  or ';' after statement");
+
+    if (parser->had_error) {
+        discard_node(parser, stmt);
+        skip_statement(parser);
+    } else {
+        *statement = stmt;
+    }
+
+    parser->had_error = parser->had_error || had_error;
+    return true;
+}
+
+/**
+ * Parse a program one statement at a time.
+ *
+ * Each statement that parses cleanly is handed to the callback and its memory is recycled as soon
+ * as the callback returns: the arena is reset when the parser has one, otherwise the statement is
+ * freed. Statements with errors are recorded in the parser's error context and skipped.
+ *
+ * @param parser The parser instance.
+ * @param callback Function called with each statement; return false to stop parsing.
+ * @param user_data Pointer passed through to the callback.
+ * @return The number of statements passed to the callback.
+ */
+size_t parse_program_stream(Parser* parser, StatementCallback callback, void* user_data) {
+    size_t delivered = 0;
+    Node*  stmt;
+
+    while (parse_next_statement(parser, &stmt)) {
+        bool keep_going = true;
+        if (stmt != NULL) {
+            delivered++;
+            keep_going = callback(stmt, user_data);
+            discard_node(parser, stmt);
+        }
+
+        // Recycle the statement's memory before parsing the next one
+        if (parser->arena)
+            arena_reset(parser->arena);
+
+        if (!keep_going)
+            break;
+    }
+
+    return delivered;
+}
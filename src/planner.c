@@ -0,0 +1,443 @@
+/**
+ * @file planner.c
+ * @brief Cost-based execution metadata from a caller-supplied catalog
+ */
+
+#include <nsql/parser.h>
+#include <nsql/planner.h>
+#include <string.h>
+
+// Fraction of rows an ordering comparison, or a condition the planner cannot read, matches
+#define RANGE_SELECTIVITY (1.0 / 3.0)
+
+// Tables of a statement the planner looks at, the rest of a longer join chain is ignored
+#define MAX_PLAN_TABLES 16
+
+// What the planner found out about a statement
+typedef struct {
+    const NsqlCatalog*    catalog;
+    const NsqlTableStats* tables[MAX_PLAN_TABLES];  // Table of each source (NULL if unknown)
+    size_t                table_count;              // Number of sources
+    size_t                known;                    // Sources found in the catalog
+} Plan;
+
+/**
+ * Check whether an identifier node holds a name.
+ *
+ * Sources may be written as string literals, whose quotes are part of the identifier.
+ *
+ * @param node The identifier.
+ * @param name The name (null-terminated).
+ * @return true if they match.
+ */
+static bool identifier_is(const Node* node, const char* name) {
+    const char* text   = node->as.identifier.name;
+    size_t      length = (size_t)node->as.identifier.length;
+    if (length >= 2 && (text[0] == '"' || text[0] == '\'') && text[length - 1] == text[0]) {
+        text++;
+        length -= 2;
+    }
+    return strlen(name) == length && memcmp(name, text, length) == 0;
+}
+
+/**
+ * Look up a table in the catalog.
+ *
+ * @param catalog The catalog.
+ * @param identifier The table name.
+ * @return The statistics, or NULL if the table is not in the catalog.
+ */
+static const NsqlTableStats* find_table(const NsqlCatalog* catalog, const Node* identifier) {
+    if (identifier == NULL || identifier->type != NODE_IDENTIFIER)
+        return NULL;
+    for (size_t i = 0; i < catalog->table_count; i++) {
+        if (identifier_is(identifier, catalog->tables[i].name))
+            return &catalog->tables[i];
+    }
+    return NULL;
+}
+
+/**
+ * Look up a column in the tables of a statement.
+ *
+ * @param plan The plan.
+ * @param identifier The column name.
+ * @param owner Receives the table of the column if not NULL.
+ * @return The statistics of the first table that has the column, or NULL.
+ */
+static const NsqlColumnStats* find_column(const Plan* plan, const Node* identifier,
+                                          const NsqlTableStats** owner) {
+    for (size_t i = 0; i < plan->table_count; i++) {
+        const NsqlTableStats* table = plan->tables[i];
+        if (table == NULL)
+            continue;
+        for (size_t j = 0; j < table->column_count; j++) {
+            if (identifier_is(identifier, table->columns[j].name)) {
+                if (owner)
+                    *owner = table;
+                return &table->columns[j];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Get the selectivity of = on a column.
+ *
+ * @param column The column statistics (may be NULL).
+ * @return The selectivity.
+ */
+static double equality_selectivity(const NsqlColumnStats* column) {
+    if (column && column->selectivity > 0 && column->selectivity <= 1)
+        return column->selectivity;
+    return NSQL_DEFAULT_SELECTIVITY;
+}
+
+/**
+ * Check whether an expression has the same value for every row.
+ *
+ * @param node The expression.
+ * @return true for literals and ? placeholders.
+ */
+static bool is_constant(const Node* node) {
+    return node && (node->type == NODE_LITERAL || node->type == NODE_PARAMETER);
+}
+
+/**
+ * Find the column a comparison constrains.
+ *
+ * @param node A comparison of a column with a constant, in either order.
+ * @param op Receives the comparison as if the column were on the left.
+ * @return The column identifier, or NULL if the comparison has some other shape.
+ */
+static const Node* compared_column(const Node* node, NsqlTokenType* op) {
+    const Node* left  = node->as.binary_expr.left;
+    const Node* right = node->as.binary_expr.right;
+    *op               = node->as.binary_expr.op;
+
+    if (left && left->type == NODE_IDENTIFIER && is_constant(right))
+        return left;
+    if (right && right->type == NODE_IDENTIFIER && is_constant(left)) {
+        switch (*op) {
+            case TOKEN_LT:
+                *op = TOKEN_GT;
+                break;
+            case TOKEN_LTE:
+                *op = TOKEN_GTE;
+                break;
+            case TOKEN_GT:
+                *op = TOKEN_LT;
+                break;
+            case TOKEN_GTE:
+                *op = TOKEN_LTE;
+                break;
+            default:
+                break;
+        }
+        return right;
+    }
+    return NULL;
+}
+
+/**
+ * Estimate the fraction of rows a condition matches.
+ *
+ * Recursion only follows AND, OR and NOT, and stops at the parser's nesting limit so that
+ * decoded trees nested more deeply cannot exhaust the stack either.
+ *
+ * @param plan The plan.
+ * @param node The condition (NULL matches every row).
+ * @param depth Nesting depth of the condition.
+ * @return The selectivity, between 0 and 1.
+ */
+static double selectivity(const Plan* plan, const Node* node, int depth) {
+    if (node == NULL)
+        return 1;
+    if (depth > NSQL_MAX_EXPRESSION_DEPTH)
+        return RANGE_SELECTIVITY;
+
+    switch (node->type) {
+        case NODE_LITERAL:
+            if (node->as.literal.literal_type == TOKEN_STRING)
+                return RANGE_SELECTIVITY;
+            return node->as.literal.value.number_value != 0 ? 1 : 0;
+
+        case NODE_BINARY_EXPR: {
+            NsqlTokenType          op;
+            const Node*            column = compared_column(node, &op);
+            const NsqlColumnStats* stats  = column ? find_column(plan, column, NULL) : NULL;
+            switch (op) {
+                case TOKEN_EQUAL:
+                    return equality_selectivity(stats);
+                case TOKEN_NEQ:
+                    return 1 - equality_selectivity(stats);
+                default:
+                    return RANGE_SELECTIVITY;
+            }
+        }
+
+        case NODE_IN_LIST: {
+            const Node* value    = node->as.in_list.value;
+            double      equality = equality_selectivity(
+                value && value->type == NODE_IDENTIFIER ? find_column(plan, value, NULL) : NULL);
+            double      result   = equality * node->as.in_list.count;
+            return result < 1 ? result : 1;
+        }
+
+        case NODE_LOGICAL_EXPR: {
+            // AND multiplies the fractions that match, OR those that do not
+            bool   is_and = node->as.logical_expr.op == TOKEN_AND;
+            double result = 1;
+            for (int i = 0; i < node->as.logical_expr.count; i++) {
+                double operand = selectivity(plan, node->as.logical_expr.operands[i], depth + 1);
+                result *= is_and ? operand : 1 - operand;
+            }
+            return is_and ? result : 1 - result;
+        }
+
+        case NODE_UNARY_EXPR:
+            if (node->as.unary_expr.op == TOKEN_NOT)
+                return 1 - selectivity(plan, node->as.unary_expr.operand, depth + 1);
+            return RANGE_SELECTIVITY;
+
+        default:
+            return RANGE_SELECTIVITY;
+    }
+}
+
+/**
+ * Find the index that narrows a condition the most.
+ *
+ * A comparison or IN list on an indexed column can be answered by the index, an OR only when
+ * all of its operands use the same index, and an AND by the best index of its operands.
+ *
+ * @param plan The plan.
+ * @param node The condition.
+ * @param fraction Receives the fraction of its table's rows read through the index.
+ * @param table Receives the table of the index.
+ * @param depth Nesting depth of the condition, limited like that of selectivity().
+ * @return The index name, or NULL if no index applies.
+ */
+static const char* choose_index(const Plan* plan, const Node* node, double* fraction,
+                                const NsqlTableStats** table, int depth) {
+    if (node == NULL || depth > NSQL_MAX_EXPRESSION_DEPTH)
+        return NULL;
+
+    const Node* column = NULL;
+    switch (node->type) {
+        case NODE_BINARY_EXPR: {
+            NsqlTokenType op;
+            column = compared_column(node, &op);
+            if (op == TOKEN_NEQ)
+                return NULL;  // Matches nearly everything, an index does not help
+            break;
+        }
+
+        case NODE_IN_LIST:
+            if (node->as.in_list.value && node->as.in_list.value->type == NODE_IDENTIFIER)
+                column = node->as.in_list.value;
+            break;
+
+        case NODE_LOGICAL_EXPR: {
+            bool                  is_and        = node->as.logical_expr.op == TOKEN_AND;
+            const char*           best          = NULL;
+            double                best_fraction = 1;
+            const NsqlTableStats* best_table    = NULL;
+            for (int i = 0; i < node->as.logical_expr.count; i++) {
+                double                operand_fraction = 1;
+                const NsqlTableStats* operand_table    = NULL;
+                const char*           index =
+                    choose_index(plan, node->as.logical_expr.operands[i], &operand_fraction,
+                                 &operand_table, depth + 1);
+                if (is_and) {
+                    if (index && (best == NULL || operand_fraction < best_fraction)) {
+                        best          = index;
+                        best_fraction = operand_fraction;
+                        best_table    = operand_table;
+                    }
+                } else {
+                    // Every operand of an OR must be read through the same index
+                    if (index == NULL || (best && strcmp(index, best) != 0))
+                        return NULL;
+                    best       = index;
+                    best_table = operand_table;
+                }
+            }
+            if (best) {
+                *fraction = is_and ? best_fraction : selectivity(plan, node, depth);
+                *table    = best_table;
+            }
+            return best;
+        }
+
+        default:
+            break;
+    }
+
+    const NsqlTableStats*  owner = NULL;
+    const NsqlColumnStats* stats = column ? find_column(plan, column, &owner) : NULL;
+    if (stats == NULL || stats->index == NULL)
+        return NULL;
+    *fraction = selectivity(plan, node, depth);
+    *table    = owner;
+    return stats->index;
+}
+
+/**
+ * Add the tables of a source and its joins to a plan.
+ *
+ * @param plan The plan.
+ * @param source The NODE_SOURCE.
+ */
+static void add_sources(Plan* plan, const Node* source) {
+    while (source && source->type == NODE_SOURCE && plan->table_count < MAX_PLAN_TABLES) {
+        const NsqlTableStats* table = find_table(plan->catalog, source->as.source.identifier);
+        plan->tables[plan->table_count++] = table;
+        if (table)
+            plan->known++;
+
+        const Node* join = source->as.source.join;
+        source           = join && join->type == NODE_JOIN ? join->as.join.source : NULL;
+    }
+}
+
+/**
+ * Convert a row estimate to an estimated_rows value.
+ *
+ * @param rows The estimate.
+ * @return The estimate rounded up and clamped to the range of uint32_t.
+ */
+static uint32_t clamp_rows(double rows) {
+    if (rows <= 0)
+        return 0;
+    if (rows >= (double)UINT32_MAX)
+        return UINT32_MAX;
+    uint32_t whole = (uint32_t)rows;
+    return whole < rows ? whole + 1 : whole;
+}
+
+/**
+ * Refine metadata from a catalog.
+ *
+ * @param statement The parsed statement.
+ * @param metadata The metadata to refine.
+ * @param catalog The NsqlCatalog.
+ */
+void nsql_plan_with_catalog(const Node* statement, ExecutionMetadata* metadata, void* catalog) {
+    const Node* source    = NULL;
+    const Node* condition = NULL;
+    const Node* limit     = NULL;
+    bool        writes    = false;
+    if (statement == NULL || catalog == NULL)
+        return;
+
+    switch (statement->type) {
+        case NODE_ASK_QUERY:
+            source    = statement->as.ask_query.source;
+            condition = statement->as.ask_query.condition;
+            limit     = statement->as.ask_query.limit;
+            break;
+        case NODE_FIND_QUERY:
+            source    = statement->as.find_query.source;
+            condition = statement->as.find_query.condition;
+            limit     = statement->as.find_query.limit;
+            break;
+        case NODE_SHOW_QUERY:
+            source    = statement->as.show_query.source;
+            condition = statement->as.show_query.condition;
+            limit     = statement->as.show_query.limit;
+            break;
+        case NODE_GET_QUERY:
+            source    = statement->as.get_query.source;
+            condition = statement->as.get_query.condition;
+            limit     = statement->as.get_query.limit;
+            break;
+        case NODE_TELL_QUERY: {
+            const Node* action = statement->as.tell_query.action;
+            if (action == NULL || (action->type != NODE_UPDATE_ACTION &&
+                                   action->type != NODE_REMOVE_ACTION))
+                return;  // Inserts and schema changes touch no existing rows
+            source    = statement->as.tell_query.source;
+            condition = statement->as.tell_query.condition;
+            if (condition == NULL && action->type == NODE_REMOVE_ACTION)
+                condition = action->as.remove_action.condition;
+            writes = true;
+            break;
+        }
+        default:
+            return;
+    }
+
+    Plan plan    = {0};
+    plan.catalog = (const NsqlCatalog*)catalog;
+    add_sources(&plan, source);
+    if (plan.known == 0)
+        return;
+
+    const NsqlCatalog* cat          = plan.catalog;
+    uint64_t           default_rows = cat->default_rows > 0 ? cat->default_rows
+                                                            : NSQL_DEFAULT_TABLE_ROWS;
+
+    // A join along a foreign key yields as many rows as its larger input, and reads all of them
+    double  rows   = 0;
+    double  read   = 0;
+    uint8_t engine = ENGINE_AUTO;
+    bool    agreed = true;
+    for (size_t i = 0; i < plan.table_count; i++) {
+        const NsqlTableStats* table      = plan.tables[i];
+        double                table_rows = (double)(table ? table->rows : default_rows);
+        if (table_rows > rows)
+            rows = table_rows;
+        read += table_rows;
+
+        uint8_t table_engine = table ? table->engine : ENGINE_AUTO;
+        if (table_engine == ENGINE_AUTO || (i > 0 && table_engine != engine))
+            agreed = false;
+        engine = table_engine;
+    }
+    if (agreed)
+        metadata->engine_type = engine;
+
+    double estimate = rows * selectivity(&plan, condition, 0);
+
+    // The table of the best index is read through it if it is selective enough
+    double                index_fraction = cat->index_fraction > 0 ? cat->index_fraction
+                                                                   : NSQL_DEFAULT_INDEX_FRACTION;
+    double                fraction       = 1;
+    const NsqlTableStats* indexed        = NULL;
+    const char*           index          = choose_index(&plan, condition, &fraction, &indexed, 0);
+
+    metadata->hint_flags &= (uint16_t)~(HINT_INDEX_SCAN | HINT_FULL_SCAN | HINT_PARALLEL_EXEC);
+    if (index && fraction <= index_fraction) {
+        metadata->hint_flags |= HINT_INDEX_SCAN;
+        metadata->target_index = index;
+        read -= (double)indexed->rows * (1 - fraction);
+    } else {
+        metadata->hint_flags |= HINT_FULL_SCAN;
+        metadata->target_index = NULL;
+    }
+
+    uint64_t parallel_rows = cat->parallel_rows > 0 ? cat->parallel_rows
+                                                    : NSQL_DEFAULT_PARALLEL_ROWS;
+    if (!writes && read >= (double)parallel_rows)
+        metadata->hint_flags |= HINT_PARALLEL_EXEC;
+
+    // A literal LIMIT caps the result, after the rows OFFSET skips
+    if (limit && limit->type == NODE_LIMIT && !LIMIT_IS_PARAMETER(limit->as.limit.limit)) {
+        int offset = limit->as.limit.offset;
+        if (offset > 0 && !LIMIT_IS_PARAMETER(offset))
+            estimate = estimate > offset ? estimate - offset : 0;
+        if (estimate > limit->as.limit.limit)
+            estimate = limit->as.limit.limit;
+    }
+    metadata->estimated_rows = clamp_rows(estimate);
+
+    uint32_t rows_per_ms = cat->rows_per_ms > 0 ? cat->rows_per_ms : NSQL_DEFAULT_ROWS_PER_MS;
+    uint32_t min_timeout = cat->min_timeout_ms > 0 ? cat->min_timeout_ms
+                                                   : NSQL_DEFAULT_MIN_TIMEOUT_MS;
+    uint32_t max_timeout = cat->max_timeout_ms > 0 ? cat->max_timeout_ms
+                                                   : NSQL_DEFAULT_MAX_TIMEOUT_MS;
+    double   timeout     = min_timeout + read / rows_per_ms;
+    metadata->timeout_ms = timeout < max_timeout ? (uint32_t)timeout : max_timeout;
+}
@@ -0,0 +1,934 @@
+/**
+ * @file processor.c
+ * @brief Prepared statements with ? placeholders and the multi-threaded query pipeline
+ */
+
+#include <nsql/ast_optimizer.h>
+#include <nsql/ast_visitor.h>
+#include <nsql/processor.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+// Kinds of placeholder location in a statement tree
+#define PLACEHOLDER_NODE 0    // A NODE_PARAMETER (or the NODE_LITERAL it was bound to)
+#define PLACEHOLDER_LIMIT 1   // The limit count of a NODE_LIMIT
+#define PLACEHOLDER_OFFSET 2  // The offset count of a NODE_LIMIT
+
+// Location of a placeholder in the statement tree
+typedef struct {
+    Node* node;   // The placeholder node or the NODE_LIMIT holding the count
+    int   index;  // Parameter index
+    int   kind;   // PLACEHOLDER_*
+} Placeholder;
+
+struct PreparedStatement {
+    Node*           ast;                // Statement tree, bound values are written into it
+    SerializedAST*  serialized;         // Serialized template with the placeholders in place
+    SerializedAST*  bound;              // Last result of nsql_execute_prepared()
+    Placeholder*    placeholders;       // Every placeholder location in ast
+    size_t          placeholder_count;  // Number of entries in placeholders
+    ParameterValue* values;             // Bound value of each parameter (strings are owned)
+    bool*           is_bound;           // Whether each parameter has a value
+    bool*           is_count;           // Whether each parameter is a LIMIT or OFFSET count
+    int             parameter_count;    // Number of parameters
+};
+
+// Placeholder list under construction
+typedef struct {
+    Placeholder* items;
+    size_t       count;
+    size_t       capacity;
+} PlaceholderList;
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param ptr Existing allocation to resize (NULL to allocate).
+ * @param size The new size in bytes.
+ * @return Pointer to the allocation.
+ */
+static void* checked_realloc(void* ptr, size_t size) {
+    void* result = realloc(ptr, size);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Append a placeholder location.
+ *
+ * @param list The list.
+ * @param node The node holding the placeholder.
+ * @param index The parameter index.
+ * @param kind The placeholder kind.
+ */
+static void add_placeholder(PlaceholderList* list, Node* node, int index, int kind) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        list->items =
+            (Placeholder*)checked_realloc(list->items, list->capacity * sizeof(Placeholder));
+    }
+    list->items[list->count].node  = node;
+    list->items[list->count].index = index;
+    list->items[list->count].kind  = kind;
+    list->count++;
+}
+
+/**
+ * Collect the placeholder of a node, if it has one.
+ *
+ * @param frame The node.
+ * @param user_data The placeholder list.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction collect_placeholder(const AstVisitFrame* frame, void* user_data) {
+    PlaceholderList* list = (PlaceholderList*)user_data;
+    Node*            node = frame->node;
+
+    if (node->type == NODE_PARAMETER) {
+        add_placeholder(list, node, node->as.parameter.index, PLACEHOLDER_NODE);
+    } else if (node->type == NODE_LIMIT) {
+        if (LIMIT_IS_PARAMETER(node->as.limit.limit))
+            add_placeholder(list, node, LIMIT_PARAMETER_INDEX(node->as.limit.limit),
+                            PLACEHOLDER_LIMIT);
+        if (LIMIT_IS_PARAMETER(node->as.limit.offset))
+            add_placeholder(list, node, LIMIT_PARAMETER_INDEX(node->as.limit.offset),
+                            PLACEHOLDER_OFFSET);
+    }
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Collect the placeholders of a tree.
+ *
+ * @param tree The tree.
+ * @param list The placeholder list.
+ */
+static void collect_placeholders(Node* tree, PlaceholderList* list) {
+    AstVisitor visitor = {collect_placeholder, NULL, list, false};
+    ast_visit(tree, &visitor);
+}
+
+/**
+ * Parse a statement with placeholders.
+ *
+ * @param query The statement text.
+ * @param errors Receives the parse errors if not NULL.
+ * @return The prepared statement, or NULL if the query does not parse.
+ */
+PreparedStatement* nsql_prepare(const char* query, ErrorContext* errors) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  ast = NULL;
+    Node*  extra;
+
+    lexer_init(&lexer, query);
+    parser_init(&parser, &lexer);
+
+    if (parse_next_statement(&parser, &ast) && ast != NULL &&
+        parse_next_statement(&parser, &extra)) {
+        // Only a single statement can be prepared
+        free_node(extra);
+        free_node(ast);
+        ast = NULL;
+        report_error_static(&parser.errors, ERROR_ERROR, ERROR_SOURCE_PARSER, lexer.line, 0,
+                            "Expected a single statement");
+    }
+
+    if (errors) {
+        error_context_move(errors, &parser.errors);
+    }
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    if (ast == NULL)
+        return NULL;
+
+    ExecutionMetadata metadata   = ast_create_metadata(ast);
+    SerializedAST*    serialized = ast_serialize(ast, &metadata);
+    if (serialized == NULL) {
+        free_node(ast);
+        return NULL;
+    }
+
+    PlaceholderList list = {NULL, 0, 0};
+    collect_placeholders(ast, &list);
+
+    PreparedStatement* stmt = (PreparedStatement*)checked_realloc(NULL, sizeof(PreparedStatement));
+    stmt->ast               = ast;
+    stmt->serialized        = serialized;
+    stmt->bound             = NULL;
+    stmt->placeholders      = list.items;
+    stmt->placeholder_count = list.count;
+    stmt->parameter_count   = (int)ast_parameter_count(serialized);
+
+    size_t slots   = stmt->parameter_count > 0 ? (size_t)stmt->parameter_count : 1;
+    stmt->values   = (ParameterValue*)calloc(slots, sizeof(ParameterValue));
+    stmt->is_bound = (bool*)calloc(slots, sizeof(bool));
+    stmt->is_count = (bool*)calloc(slots, sizeof(bool));
+    if (!stmt->values || !stmt->is_bound || !stmt->is_count) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < list.count; i++) {
+        if (list.items[i].kind != PLACEHOLDER_NODE)
+            stmt->is_count[list.items[i].index] = true;
+    }
+
+    return stmt;
+}
+
+/**
+ * Get the number of placeholders in a prepared statement.
+ *
+ * @param stmt The prepared statement.
+ * @return The number of parameters.
+ */
+int nsql_prepared_parameter_count(const PreparedStatement* stmt) {
+    return stmt->parameter_count;
+}
+
+/**
+ * Store a parameter value and write it into the statement tree.
+ *
+ * @param stmt The prepared statement.
+ * @param index The parameter index.
+ * @param value The value; a string is copied.
+ * @return true if the value was bound.
+ */
+static bool bind_value(PreparedStatement* stmt, int index, const ParameterValue* value) {
+    if (index < 0 || index >= stmt->parameter_count)
+        return false;
+
+    // Counts must stay valid LIMIT/OFFSET values
+    if (stmt->is_count[index] && (value->type != TOKEN_INTEGER || value->number_value < 0))
+        return false;
+    if (value->type == TOKEN_STRING && value->length > UINT16_MAX)
+        return false;
+
+    ParameterValue* slot = &stmt->values[index];
+    if (slot->type == TOKEN_STRING)
+        free((char*)slot->string_value);
+
+    *slot = *value;
+    if (value->type == TOKEN_STRING) {
+        char* copy = (char*)checked_realloc(NULL, value->length + 1);
+        memcpy(copy, value->string_value, value->length);
+        copy[value->length] = '\0';
+        slot->string_value  = copy;
+    }
+    stmt->is_bound[index] = true;
+
+    for (size_t i = 0; i < stmt->placeholder_count; i++) {
+        Placeholder* placeholder = &stmt->placeholders[i];
+        if (placeholder->index != index)
+            continue;
+
+        Node* node = placeholder->node;
+        if (placeholder->kind == PLACEHOLDER_LIMIT) {
+            node->as.limit.limit = (int)value->number_value;
+        } else if (placeholder->kind == PLACEHOLDER_OFFSET) {
+            node->as.limit.offset = (int)value->number_value;
+        } else {
+            // The node owns its string like any parsed literal, so free_node() releases it
+            if (node->type == NODE_LITERAL && node->as.literal.literal_type == TOKEN_STRING)
+                free(node->as.literal.value.string_value);
+
+            node->type                    = NODE_LITERAL;
+            node->as.literal.literal_type = value->type;
+            node->as.literal.length       = 0;
+            if (value->type == TOKEN_STRING) {
+                char* copy = (char*)checked_realloc(NULL, value->length + 1);
+                memcpy(copy, value->string_value, value->length);
+                copy[value->length]                 = '\0';
+                node->as.literal.value.string_value = copy;
+                node->as.literal.length             = (int)value->length;
+            } else {
+                node->as.literal.value.number_value = value->number_value;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Bind an integer to a placeholder.
+ *
+ * @param stmt The prepared statement.
+ * @param index The parameter index.
+ * @param value The value.
+ * @return true if the value was bound.
+ */
+bool nsql_bind_integer(PreparedStatement* stmt, int index, int value) {
+    ParameterValue param = {TOKEN_INTEGER, NULL, 0, (double)value};
+    return bind_value(stmt, index, &param);
+}
+
+/**
+ * Bind a decimal to a placeholder.
+ *
+ * @param stmt The prepared statement.
+ * @param index The parameter index.
+ * @param value The value.
+ * @return true if the value was bound.
+ */
+bool nsql_bind_decimal(PreparedStatement* stmt, int index, double value) {
+    ParameterValue param = {TOKEN_DECIMAL, NULL, 0, value};
+    return bind_value(stmt, index, &param);
+}
+
+/**
+ * Bind a string to a placeholder.
+ *
+ * @param stmt The prepared statement.
+ * @param index The parameter index.
+ * @param value The string bytes.
+ * @param length Length of value in bytes.
+ * @return true if the value was bound.
+ */
+bool nsql_bind_string(PreparedStatement* stmt, int index, const char* value, size_t length) {
+    ParameterValue param = {TOKEN_STRING, value, length, 0};
+    return bind_value(stmt, index, &param);
+}
+
+/**
+ * Get the statement tree with the bound values in place.
+ *
+ * @param stmt The prepared statement.
+ * @return The statement tree.
+ */
+const Node* nsql_prepared_ast(const PreparedStatement* stmt) {
+    return stmt->ast;
+}
+
+/**
+ * Produce the serialized plan for the current bindings.
+ *
+ * @param stmt The prepared statement.
+ * @return The serialized plan, or NULL if a parameter has not been bound.
+ */
+const SerializedAST* nsql_execute_prepared(PreparedStatement* stmt) {
+    for (int i = 0; i < stmt->parameter_count; i++) {
+        if (!stmt->is_bound[i])
+            return NULL;
+    }
+
+    SerializedAST* bound = ast_bind_parameters(stmt->serialized, stmt->values,
+                                               (size_t)stmt->parameter_count, stmt->bound);
+    if (bound == NULL)
+        return NULL;
+
+    stmt->bound = bound;
+    return bound;
+}
+
+/**
+ * Free a prepared statement.
+ *
+ * @param stmt The prepared statement.
+ */
+void nsql_prepared_free(PreparedStatement* stmt) {
+    if (!stmt)
+        return;
+
+    for (int i = 0; i < stmt->parameter_count; i++) {
+        if (stmt->values[i].type == TOKEN_STRING)
+            free((char*)stmt->values[i].string_value);
+    }
+
+    free_node(stmt->ast);
+    ast_free(stmt->serialized);
+    ast_free(stmt->bound);
+    free(stmt->placeholders);
+    free(stmt->values);
+    free(stmt->is_bound);
+    free(stmt->is_count);
+    free(stmt);
+}
+
+// Priority bands of the submission queues, served in this order
+#define BAND_HIGH 0
+#define BAND_NORMAL 1
+#define BAND_LOW 2
+#define BAND_COUNT 3
+
+// Every this many queries a worker looks at the bands lowest first, so low bands are not starved
+#define STARVATION_INTERVAL 16
+
+// Size of a cache line, to keep the ends of a queue apart
+#define CACHE_LINE_SIZE 64
+
+struct NsqlQuery {
+    atomic_bool       done;          // Set by the worker once everything below is filled in
+    bool              succeeded;     // Whether result holds a serialized plan
+    void*             result;        // Serialized plan (malloc'd, NULL on failure)
+    size_t            result_size;   // Size of result in bytes
+    ErrorContext      errors;        // Errors reported while processing, in ring mode
+    bool              has_metadata;  // Whether metadata replaces ast_create_metadata()
+    ExecutionMetadata metadata;      // Caller metadata (target_index points into text)
+    char              text[];        // Query text followed by the target index, if any
+};
+
+// Slot of a submission queue
+typedef struct {
+    atomic_size_t sequence;  // Position the slot is ready for: pos when free, pos + 1 when full
+    NsqlQuery*    query;     // The waiting query
+} QueueCell;
+
+// Bounded multi-producer, multi-consumer queue of waiting queries
+typedef struct {
+    QueueCell* cells;     // Slots, a power of two of them
+    size_t     mask;      // Number of slots minus one
+    alignas(CACHE_LINE_SIZE) atomic_size_t tail;  // Next position to submit to
+    alignas(CACHE_LINE_SIZE) atomic_size_t head;  // Next position to take from
+} SubmitQueue;
+
+// Worker thread and the buffers it reuses for every query
+typedef struct {
+    NsqlThread     thread;  // The thread (must stay alive until joined)
+    NsqlArena      arena;   // Storage of the tree being processed
+    AstBatchBuffer output;  // Serialization buffer
+    unsigned       taken;   // Queries taken so far, for STARVATION_INTERVAL
+} Worker;
+
+// Processor state
+typedef struct {
+    atomic_bool     running;             // Whether queries can be submitted
+    atomic_bool     stopping;            // Set by shutdown; workers exit once the queues drain
+    bool            case_insensitive;    // Keyword matching of every query
+    bool            optimize;            // Whether trees go through ast_optimize()
+    NsqlPlannerHook planner;             // Refines the metadata of queries without their own
+    void*           planner_data;        // Passed to planner
+    SubmitQueue     queues[BAND_COUNT];  // Waiting queries by priority band
+    atomic_size_t   queued;              // Queries in all queues
+    atomic_int      sleeping;            // Workers waiting for work
+    atomic_int      waiting;             // Threads waiting for a query to complete
+    NsqlMutex       lock;                // Guards sleeping workers and waiting threads
+    NsqlCond        work_ready;          // Signalled when a query is submitted
+    NsqlCond        query_done;          // Broadcast when a query completes
+    Worker*         workers;             // The worker pool
+    int             worker_count;        // Number of started workers
+} Processor;
+
+static Processor processor;
+
+/**
+ * Set up a worker's reusable buffers.
+ *
+ * @param worker The worker.
+ */
+static void worker_init(Worker* worker) {
+    arena_init(&worker->arena, 0);
+    ast_batch_buffer_init(&worker->output);
+    worker->taken = 0;
+}
+
+/**
+ * Release a worker's buffers.
+ *
+ * @param worker The worker.
+ */
+static void worker_free(Worker* worker) {
+    arena_free(&worker->arena);
+    ast_batch_buffer_free(&worker->output);
+}
+
+/**
+ * Turn a query into its serialized plan with a worker's buffers.
+ *
+ * The text outlives the tree, so the tree borrows its strings, and both the tree and the errors'
+ * storage are recycled for the next query.
+ *
+ * @param worker The worker.
+ * @param query The query to process, filled in except for done.
+ * @param case_insensitive Whether keywords are matched regardless of case.
+ * @param optimize Whether the tree is simplified before it is serialized.
+ */
+static void run_query(Worker* worker, NsqlQuery* query, bool case_insensitive, bool optimize) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  ast = NULL;
+    Node*  extra;
+
+    lexer_init(&lexer, query->text);
+    lexer.case_insensitive = case_insensitive;
+    parser_init_with_arena(&parser, &lexer, &worker->arena);
+    parser.zero_copy = true;
+    error_context_use_ring(&parser.errors);
+
+    if (parse_next_statement(&parser, &ast) && ast != NULL &&
+        parse_next_statement(&parser, &extra)) {
+        // Only a single statement makes a plan
+        ast = NULL;
+        report_error_static(&parser.errors, ERROR_ERROR, ERROR_SOURCE_PARSER, lexer.line, 0,
+                            "Expected a single statement");
+    }
+
+    query->succeeded = false;
+    query->result    = NULL;
+    if (ast != NULL) {
+        if (optimize)
+            ast_optimize(ast, true);
+
+        ExecutionMetadata metadata;
+        if (query->has_metadata) {
+            metadata = query->metadata;
+        } else {
+            metadata = ast_create_metadata(ast);
+            if (processor.planner)
+                processor.planner(ast, &metadata, processor.planner_data);
+        }
+        if (ast_serialize_batch(&ast, 1, &metadata, &worker->output) == 1) {
+            query->result_size = worker->output.size;
+            query->result      = checked_realloc(NULL, query->result_size);
+            memcpy(query->result, worker->output.data, query->result_size);
+            query->succeeded = true;
+        } else {
+            report_error_static(&parser.errors, ERROR_ERROR, ERROR_SOURCE_SYSTEM, ast->line, 0,
+                                "Could not serialize the query");
+        }
+    }
+
+    // Hand the reports over to the query
+    error_context_move(&query->errors, &parser.errors);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    arena_reset(&worker->arena);
+}
+
+/**
+ * Allocate the slots of a submission queue.
+ *
+ * @param queue The queue.
+ * @param capacity Number of slots, a power of two.
+ */
+static void queue_init(SubmitQueue* queue, size_t capacity) {
+    queue->cells = (QueueCell*)checked_realloc(NULL, capacity * sizeof(QueueCell));
+    queue->mask  = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].query = NULL;
+    }
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->head, 0);
+}
+
+/**
+ * Add a query to a submission queue.
+ *
+ * Each slot's sequence number says whether it is free for the position being claimed, so
+ * producers only contend on the tail.
+ *
+ * @param queue The queue.
+ * @param query The query.
+ * @return false if the queue is full.
+ */
+static bool queue_push(SubmitQueue* queue, NsqlQuery* query) {
+    size_t     pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    QueueCell* cell;
+
+    for (;;) {
+        cell          = &queue->cells[pos & queue->mask];
+        size_t   seq  = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return false;  // The slot still holds a query from the previous lap
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+
+    cell->query = query;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Take the oldest query from a submission queue.
+ *
+ * @param queue The queue.
+ * @return The query, or NULL if the queue is empty.
+ */
+static NsqlQuery* queue_pop(SubmitQueue* queue) {
+    size_t     pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    QueueCell* cell;
+
+    for (;;) {
+        cell          = &queue->cells[pos & queue->mask];
+        size_t   seq  = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+
+    NsqlQuery* query = cell->query;
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return query;
+}
+
+/**
+ * Take the next query for a worker, highest band first.
+ *
+ * @param worker The worker.
+ * @return The query, or NULL if every queue is empty.
+ */
+static NsqlQuery* take_query(Worker* worker) {
+    bool lowest_first = worker->taken % STARVATION_INTERVAL == STARVATION_INTERVAL - 1;
+
+    for (int i = 0; i < BAND_COUNT; i++) {
+        int        band  = lowest_first ? BAND_COUNT - 1 - i : i;
+        NsqlQuery* query = queue_pop(&processor.queues[band]);
+        if (query) {
+            atomic_fetch_sub(&processor.queued, 1);
+            worker->taken++;
+            return query;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Mark a query as completed and wake the threads waiting for one.
+ *
+ * @param query The query.
+ */
+static void complete_query(NsqlQuery* query) {
+    atomic_store(&query->done, true);
+    if (atomic_load(&processor.waiting) > 0) {
+        nsql_mutex_lock(&processor.lock);
+        nsql_cond_broadcast(&processor.query_done);
+        nsql_mutex_unlock(&processor.lock);
+    }
+}
+
+/**
+ * Worker thread entry point, processes queries until shutdown.
+ *
+ * @param arg The worker.
+ */
+static void process_worker(void* arg) {
+    Worker* worker = (Worker*)arg;
+
+    for (;;) {
+        NsqlQuery* query = take_query(worker);
+        if (query) {
+            run_query(worker, query, processor.case_insensitive, processor.optimize);
+            complete_query(query);
+            continue;
+        }
+
+        // Submitters check for sleeping workers after queueing, so one of the two sees the other
+        nsql_mutex_lock(&processor.lock);
+        atomic_fetch_add(&processor.sleeping, 1);
+        while (atomic_load(&processor.queued) == 0 && !atomic_load(&processor.stopping)) {
+            nsql_cond_wait(&processor.work_ready, &processor.lock);
+        }
+        atomic_fetch_sub(&processor.sleeping, 1);
+        bool done = atomic_load(&processor.queued) == 0;
+        nsql_mutex_unlock(&processor.lock);
+
+        if (done)
+            break;  // Stopping with nothing left to do
+    }
+}
+
+/**
+ * Initialize the NSQL query processor with default options.
+ *
+ * @return true if the processor is running.
+ */
+bool nsql_processor_init(void) {
+    return nsql_processor_init_with_options(NULL);
+}
+
+/**
+ * Initialize the NSQL query processor.
+ *
+ * @param options Processor options (NULL for defaults).
+ * @return true if the processor is running.
+ */
+bool nsql_processor_init_with_options(const NsqlProcessorOptions* options) {
+    NsqlProcessorOptions defaults = {0, 0, false, false, NULL, NULL};
+    if (!options)
+        options = &defaults;
+    if (atomic_load(&processor.running))
+        return true;
+
+    size_t capacity = 1;
+    size_t wanted   = options->queue_capacity > 0 ? options->queue_capacity
+                                                  : NSQL_PROCESSOR_QUEUE_CAPACITY;
+    while (capacity < wanted) {
+        capacity *= 2;
+    }
+
+    processor.case_insensitive = options->case_insensitive;
+    processor.optimize         = options->optimize;
+    processor.planner          = options->planner;
+    processor.planner_data     = options->planner_data;
+    for (int band = 0; band < BAND_COUNT; band++) {
+        queue_init(&processor.queues[band], capacity);
+    }
+    atomic_init(&processor.stopping, false);
+    atomic_init(&processor.queued, 0);
+    atomic_init(&processor.sleeping, 0);
+    atomic_init(&processor.waiting, 0);
+    nsql_mutex_init(&processor.lock);
+    nsql_cond_init(&processor.work_ready);
+    nsql_cond_init(&processor.query_done);
+
+    int thread_count = options->thread_count > 0 ? options->thread_count : nsql_cpu_count();
+    processor.workers = (Worker*)checked_realloc(NULL, (size_t)thread_count * sizeof(Worker));
+    processor.worker_count = 0;
+    while (processor.worker_count < thread_count) {
+        Worker* worker = &processor.workers[processor.worker_count];
+        worker_init(worker);
+        if (!nsql_thread_create(&worker->thread, process_worker, worker)) {
+            worker_free(worker);
+            break;
+        }
+        processor.worker_count++;
+    }
+
+    if (processor.worker_count == 0) {
+        free(processor.workers);
+        for (int band = 0; band < BAND_COUNT; band++) {
+            free(processor.queues[band].cells);
+        }
+        nsql_cond_destroy(&processor.query_done);
+        nsql_cond_destroy(&processor.work_ready);
+        nsql_mutex_destroy(&processor.lock);
+        return false;
+    }
+
+    atomic_store(&processor.running, true);
+    return true;
+}
+
+/**
+ * Pick the priority band of a query.
+ *
+ * @param metadata The query's metadata (NULL for the default band).
+ * @return The band.
+ */
+static int priority_band(const ExecutionMetadata* metadata) {
+    if (!metadata)
+        return BAND_NORMAL;
+    if (metadata->hint_flags & HINT_PRIORITY_HIGH)
+        return BAND_HIGH;
+    if (metadata->hint_flags & HINT_PRIORITY_LOW)
+        return BAND_LOW;
+    if (metadata->priority >= NSQL_PRIORITY_HIGH_THRESHOLD)
+        return BAND_HIGH;
+    if (metadata->priority <= NSQL_PRIORITY_LOW_THRESHOLD)
+        return BAND_LOW;
+    return BAND_NORMAL;
+}
+
+/**
+ * Make a completion handle holding copies of the query text and metadata.
+ *
+ * @param query The query text.
+ * @param metadata The caller's metadata (may be NULL).
+ * @return The handle.
+ */
+static NsqlQuery* new_query(const char* query, const ExecutionMetadata* metadata) {
+    size_t length       = strlen(query);
+    size_t index_length = metadata && metadata->target_index ? strlen(metadata->target_index) : 0;
+    size_t size         = sizeof(NsqlQuery) + length + 1;
+    if (index_length > 0)
+        size += index_length + 1;
+
+    NsqlQuery* handle = (NsqlQuery*)checked_realloc(NULL, size);
+    atomic_init(&handle->done, false);
+    handle->succeeded    = false;
+    handle->result       = NULL;
+    handle->result_size  = 0;
+    handle->has_metadata = metadata != NULL;
+    error_context_init(&handle->errors);
+    memcpy(handle->text, query, length + 1);
+
+    if (metadata) {
+        handle->metadata = *metadata;
+        if (index_length > 0) {
+            char* target_index = handle->text + length + 1;
+            memcpy(target_index, metadata->target_index, index_length + 1);
+            handle->metadata.target_index = target_index;
+        }
+    }
+    return handle;
+}
+
+/**
+ * Submit a query to the processor.
+ *
+ * @param query The statement text.
+ * @param metadata Metadata for the plan and the priority (NULL for defaults).
+ * @return The completion handle, or NULL if the processor is not running or the band is full.
+ */
+NsqlQuery* nsql_submit_query(const char* query, const ExecutionMetadata* metadata) {
+    if (!query || !atomic_load(&processor.running))
+        return NULL;
+
+    NsqlQuery* handle = new_query(query, metadata);
+    if (!queue_push(&processor.queues[priority_band(metadata)], handle)) {
+        free(handle);  // Nothing was attached to it yet
+        return NULL;
+    }
+
+    // Workers check the count before sleeping, so one of the two sees the other
+    atomic_fetch_add(&processor.queued, 1);
+    if (atomic_load(&processor.sleeping) > 0) {
+        nsql_mutex_lock(&processor.lock);
+        nsql_cond_signal(&processor.work_ready);
+        nsql_mutex_unlock(&processor.lock);
+    }
+    return handle;
+}
+
+/**
+ * Check whether a submitted query has completed.
+ *
+ * @param query The completion handle.
+ * @return true once the query has completed.
+ */
+bool nsql_query_done(const NsqlQuery* query) {
+    return atomic_load(&query->done);
+}
+
+/**
+ * Wait for a submitted query to complete.
+ *
+ * @param query The completion handle.
+ * @return true if the query produced a serialized plan.
+ */
+bool nsql_query_wait(NsqlQuery* query) {
+    if (!atomic_load(&query->done)) {
+        nsql_mutex_lock(&processor.lock);
+        atomic_fetch_add(&processor.waiting, 1);
+        while (!atomic_load(&query->done)) {
+            nsql_cond_wait(&processor.query_done, &processor.lock);
+        }
+        atomic_fetch_sub(&processor.waiting, 1);
+        nsql_mutex_unlock(&processor.lock);
+    }
+    return query->succeeded;
+}
+
+/**
+ * Get the serialized plan of a completed query.
+ *
+ * @param query The completion handle.
+ * @param size Receives the size of the plan (may be NULL).
+ * @return The plan, or NULL if the query had errors.
+ */
+const void* nsql_query_result(const NsqlQuery* query, size_t* size) {
+    if (size)
+        *size = query->result_size;
+    return query->result;
+}
+
+/**
+ * Get the errors of a completed query.
+ *
+ * @param query The completion handle.
+ * @return The errors.
+ */
+const ErrorContext* nsql_query_errors(const NsqlQuery* query) {
+    return &query->errors;
+}
+
+/**
+ * Free a completion handle.
+ *
+ * @param query The completion handle.
+ */
+void nsql_query_free(NsqlQuery* query) {
+    if (!query)
+        return;
+
+    nsql_query_wait(query);
+    error_context_free(&query->errors);
+    free(query->result);
+    free(query);
+}
+
+/**
+ * Process an NSQL query.
+ *
+ * @param query The NSQL query string.
+ * @return true if successful, false otherwise.
+ */
+bool nsql_process_query(const char* query) {
+    if (!query)
+        return false;
+
+    NsqlQuery* handle = nsql_submit_query(query, NULL);
+    if (handle) {
+        bool succeeded = nsql_query_wait(handle);
+        nsql_query_free(handle);
+        return succeeded;
+    }
+
+    // Not running or backlogged, so do the work here
+    Worker worker;
+    worker_init(&worker);
+    handle = new_query(query, NULL);
+    run_query(&worker, handle, processor.case_insensitive, processor.optimize);
+    atomic_store(&handle->done, true);
+    worker_free(&worker);
+
+    bool succeeded = handle->succeeded;
+    nsql_query_free(handle);
+    return succeeded;
+}
+
+/**
+ * Shut down the NSQL processor.
+ */
+void nsql_processor_shutdown(void) {
+    if (!atomic_load(&processor.running))
+        return;
+
+    atomic_store(&processor.running, false);
+    nsql_mutex_lock(&processor.lock);
+    atomic_store(&processor.stopping, true);
+    nsql_cond_broadcast(&processor.work_ready);
+    nsql_mutex_unlock(&processor.lock);
+
+    for (int i = 0; i < processor.worker_count; i++) {
+        nsql_thread_join(&processor.workers[i].thread);
+        worker_free(&processor.workers[i]);
+    }
+    free(processor.workers);
+    processor.workers      = NULL;
+    processor.worker_count = 0;
+
+    for (int band = 0; band < BAND_COUNT; band++) {
+        free(processor.queues[band].cells);
+        processor.queues[band].cells = NULL;
+    }
+    nsql_cond_destroy(&processor.query_done);
+    nsql_cond_destroy(&processor.work_ready);
+    nsql_mutex_destroy(&processor.lock);
+}
@@ -0,0 +1,740 @@
+/**
+ * @file query_cache.c
+ * @brief Sharded CLOCK cache of parsed query templates
+ *
+ * A query is normalized by lexing it into a key made of its token types and identifier names;
+ * literals contribute only their type. Queries with the same key share one parsed template, and
+ * the literal values of each query are returned alongside it so callers can bind them.
+ *
+ * Every literal token is either a slot, which maps to a NODE_LITERAL in the template, or pinned,
+ * which means the parser folded its value into the structure (a LIMIT count or a quoted source
+ * name). Pinned literals are stored with the entry and must match exactly on lookup. Slots are
+ * found by parsing a probe copy of the query in which every literal has a unique value.
+ */
+
+#include <nsql/ast_visitor.h>
+#include <nsql/parser.h>
+#include <nsql/query_cache.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+#include "thread.h"
+
+// Maximum number of independently locked shards
+#define MAX_SHARDS 16
+
+// FNV-1a parameters
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+// Integer probe values start here so they never collide with the slot index
+#define PROBE_INTEGER_BASE 1000000000
+
+// Literal values the parser folded into the structure of the template
+typedef struct {
+    size_t token;   // Index of the literal in the query's literal vector
+    size_t offset;  // Offset of the text in the entry's key buffer
+    size_t length;  // Length of the text
+} PinnedLiteral;
+
+struct QueryCacheEntry {
+    uint64_t         hash;           // Hash of the key
+    unsigned char*   key;            // Key bytes followed by the pinned literal texts
+    size_t           key_length;     // Length of the key part of key
+    Node*            ast;            // Parsed template
+    SerializedAST*   serialized;     // Serialized template
+    int*             slots;          // Template literal index of each literal token (-1 if pinned)
+    size_t           literal_count;  // Number of literal tokens in the query
+    PinnedLiteral*   pinned;         // Literals that must match exactly
+    size_t           pinned_count;   // Number of entries in pinned
+    atomic_int       refs;           // One reference for the cache plus one per result
+    bool             referenced;     // CLOCK bit, guarded by the shard lock
+    size_t           slot;           // Index in the shard's CLOCK ring
+    QueryCacheEntry* next;           // Next entry in the hash chain
+};
+
+// Independently locked part of the cache
+typedef struct {
+    NsqlMutex         lock;
+    QueryCacheEntry** buckets;       // Hash chains
+    size_t            bucket_mask;   // Number of buckets minus one
+    QueryCacheEntry** ring;          // CLOCK ring of cached entries
+    size_t            capacity;      // Size of ring
+    size_t            count;         // Entries in ring
+    size_t            hand;          // CLOCK hand
+} QueryCacheShard;
+
+struct QueryCache {
+    QueryCacheShard*     shards;
+    size_t               shard_count;
+    atomic_uint_fast64_t hits;
+    atomic_uint_fast64_t misses;
+    atomic_uint_fast64_t evictions;
+    atomic_size_t        entries;
+};
+
+// Growable byte buffer
+typedef struct {
+    unsigned char* data;
+    size_t         size;
+    size_t         capacity;
+} ByteBuffer;
+
+// Growable list of literal nodes
+typedef struct {
+    Node** nodes;
+    size_t count;
+    size_t capacity;
+} LiteralList;
+
+/**
+ * Allocate memory or exit.
+ *
+ * @param ptr Existing allocation to resize (NULL to allocate).
+ * @param size The new size in bytes.
+ * @return Pointer to the allocation.
+ */
+static void* checked_realloc(void* ptr, size_t size) {
+    void* result = realloc(ptr, size);
+    if (!result) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return result;
+}
+
+/**
+ * Append bytes to a buffer.
+ *
+ * @param buf The buffer.
+ * @param data The bytes to append.
+ * @param size Number of bytes.
+ */
+static void buffer_append(ByteBuffer* buf, const void* data, size_t size) {
+    if (buf->size + size > buf->capacity) {
+        size_t capacity = buf->capacity > 0 ? buf->capacity * 2 : 128;
+        while (capacity < buf->size + size) capacity *= 2;
+        buf->data     = (unsigned char*)checked_realloc(buf->data, capacity);
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+}
+
+/**
+ * Hash a key with 64-bit FNV-1a.
+ *
+ * @param data The key bytes.
+ * @param size Number of bytes.
+ * @return The hash.
+ */
+static uint64_t hash_key(const unsigned char* data, size_t size) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * Check whether a token type is a literal.
+ *
+ * @param type The token type.
+ * @return true for strings, integers and decimals.
+ */
+static bool is_literal(NsqlTokenType type) {
+    return type == TOKEN_STRING || type == TOKEN_INTEGER || type == TOKEN_DECIMAL;
+}
+
+/**
+ * Lex a query into its normalized key and literal vector.
+ *
+ * @param query The query text.
+ * @param key Receives the key bytes.
+ * @param tokens Receives the literal tokens in source order.
+ * @param literals Receives the literal values in source order.
+ * @return The number of literals.
+ */
+static size_t normalize_query(const char* query, ByteBuffer* key, Token** tokens,
+                              QueryLiteral** literals) {
+    Lexer         lexer;
+    Token*        toks     = NULL;
+    QueryLiteral* values   = NULL;
+    size_t        count    = 0;
+    size_t        capacity = 0;
+
+    lexer_init(&lexer, query);
+    for (;;) {
+        Token         token = lexer_next_token(&lexer);
+        unsigned char type  = (unsigned char)token.type;
+        buffer_append(key, &type, 1);
+
+        if (token.type == TOKEN_EOF)
+            break;
+
+        if (token.type == TOKEN_IDENTIFIER || token.type == TOKEN_ERROR) {
+            uint32_t length = (uint32_t)token.length;
+            buffer_append(key, &length, sizeof(length));
+            buffer_append(key, token.start, token.length);
+        } else if (is_literal(token.type)) {
+            if (count == capacity) {
+                capacity = capacity > 0 ? capacity * 2 : 8;
+                toks     = (Token*)checked_realloc(toks, capacity * sizeof(Token));
+                values   = (QueryLiteral*)checked_realloc(values, capacity * sizeof(QueryLiteral));
+            }
+
+            // Convert the value the same way the parser does
+            QueryLiteral* literal = &values[count];
+            literal->type         = token.type;
+            literal->number       = 0;
+            if (token.type == TOKEN_STRING) {
+                literal->text   = token.start + 1;
+                literal->length = token.length - 2;
+            } else {
+                literal->text   = token.start;
+                literal->length = token.length;
+                const char* end = token.start + token.length;
+                literal->number = token.type == TOKEN_INTEGER
+                                      ? (int)nsql_scan_integer_value(token.start, end)
+                                      : nsql_scan_decimal_value(token.start, end);
+            }
+            toks[count++] = token;
+        }
+    }
+    lexer_free(&lexer);
+
+    *tokens   = toks;
+    *literals = values;
+    return count;
+}
+
+/**
+ * Collect a node if it is a literal.
+ *
+ * @param frame The node.
+ * @param user_data The literal list.
+ * @return AST_VISIT_SKIP for literals, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction collect_literal(const AstVisitFrame* frame, void* user_data) {
+    LiteralList* list = (LiteralList*)user_data;
+    if (frame->node->type != NODE_LITERAL)
+        return AST_VISIT_CONTINUE;
+
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? list->capacity * 2 : 8;
+        list->nodes    = (Node**)checked_realloc(list->nodes, list->capacity * sizeof(Node*));
+    }
+    list->nodes[list->count++] = frame->node;
+    return AST_VISIT_SKIP;
+}
+
+/**
+ * Collect the literal nodes of a tree in preorder.
+ *
+ * @param node The tree.
+ * @param list The list to append to.
+ */
+static void collect_literals(Node* node, LiteralList* list) {
+    AstVisitor visitor = {collect_literal, NULL, list, false};
+    ast_visit(node, &visitor);
+}
+
+/**
+ * Parse a query that must consist of exactly one statement.
+ *
+ * @param source The query text.
+ * @return The statement, or NULL if it has errors or is followed by another statement.
+ */
+static Node* parse_single(const char* source) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  stmt = NULL;
+    Node*  extra;
+
+    lexer_init(&lexer, source);
+    parser_init(&parser, &lexer);
+
+    if (parse_next_statement(&parser, &stmt) && stmt != NULL &&
+        parse_next_statement(&parser, &extra)) {
+        free_node(extra);
+        free_node(stmt);
+        stmt = NULL;
+    }
+
+    parser_free(&parser);
+    lexer_free(&lexer);
+    return stmt;
+}
+
+/**
+ * Decode the literal token index encoded in a probe literal.
+ *
+ * @param node A literal node from the probe tree.
+ * @return The token index, or -1 if the node does not hold a probe value.
+ */
+static long probe_index(const Node* node) {
+    switch (node->as.literal.literal_type) {
+        case TOKEN_STRING: {
+            const char* text   = node->as.literal.value.string_value;
+            int         length = node->as.literal.length;
+            if (length < 2 || text[0] != '\x7f')
+                return -1;
+            long index = 0;
+            for (int i = 1; i < length; i++) {
+                if (text[i] < '0' || text[i] > '9')
+                    return -1;
+                index = index * 10 + (text[i] - '0');
+            }
+            return index;
+        }
+
+        case TOKEN_INTEGER:
+            return (long)node->as.literal.value.number_value - PROBE_INTEGER_BASE;
+
+        case TOKEN_DECIMAL:
+            return (long)node->as.literal.value.number_value;
+
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Map each literal token of a query to a literal node of its template.
+ *
+ * Parses a copy of the query in which literal i is replaced by a value that encodes i, then reads
+ * the encoded indexes back from the probe tree's literals in preorder.
+ *
+ * @param query The query text.
+ * @param tokens The literal tokens of the query.
+ * @param count Number of literal tokens.
+ * @param template_literals Number of literal nodes in the template.
+ * @param slots Receives the template literal index of each token (-1 if pinned).
+ */
+static void map_slots(const char* query, const Token* tokens, size_t count,
+                      size_t template_literals, int* slots) {
+    ByteBuffer  probe = {NULL, 0, 0};
+    const char* copied = query;
+    char        value[32];
+
+    for (size_t i = 0; i < count; i++) {
+        slots[i] = -1;
+
+        buffer_append(&probe, copied, (size_t)(tokens[i].start - copied));
+        int length;
+        if (tokens[i].type == TOKEN_STRING)
+            length = snprintf(value, sizeof(value), "%c\x7f%zu%c", tokens[i].start[0], i,
+                              tokens[i].start[0]);
+        else if (tokens[i].type == TOKEN_INTEGER)
+            length = snprintf(value, sizeof(value), "%zu", i + PROBE_INTEGER_BASE);
+        else
+            length = snprintf(value, sizeof(value), "%zu.25", i);
+        buffer_append(&probe, value, (size_t)length);
+        copied = tokens[i].start + tokens[i].length;
+    }
+    buffer_append(&probe, copied, strlen(copied) + 1);
+
+    Node*       tree = parse_single((const char*)probe.data);
+    LiteralList list = {NULL, 0, 0};
+    collect_literals(tree, &list);
+
+    // The probe must have the same shape as the template; otherwise every literal stays pinned
+    if (tree != NULL && list.count == template_literals) {
+        bool valid = true;
+        for (size_t k = 0; k < list.count && valid; k++) {
+            long index = probe_index(list.nodes[k]);
+            valid      = index >= 0 && (size_t)index < count && slots[index] == -1 &&
+                    tokens[index].type == list.nodes[k]->as.literal.literal_type;
+            if (valid)
+                slots[index] = (int)k;
+        }
+
+        if (!valid) {
+            for (size_t i = 0; i < count; i++) {
+                slots[i] = -1;
+            }
+        }
+    }
+
+    free(list.nodes);
+    free_node(tree);
+    free(probe.data);
+}
+
+/**
+ * Drop a reference to an entry, freeing it when the last one goes.
+ *
+ * @param entry The entry.
+ */
+static void entry_release(QueryCacheEntry* entry) {
+    if (atomic_fetch_sub(&entry->refs, 1) != 1)
+        return;
+
+    free_node(entry->ast);
+    ast_free(entry->serialized);
+    free(entry->key);
+    free(entry->slots);
+    free(entry->pinned);
+    free(entry);
+}
+
+/**
+ * Build a cache entry for a query.
+ *
+ * @param query The query text.
+ * @param key The query's key.
+ * @param hash Hash of the key.
+ * @param tokens The literal tokens of the query.
+ * @param count Number of literal tokens.
+ * @return The entry with one reference, or NULL if the query does not parse.
+ */
+static QueryCacheEntry* entry_create(const char* query, const ByteBuffer* key, uint64_t hash,
+                                     const Token* tokens, size_t count) {
+    Node* ast = parse_single(query);
+    if (ast == NULL)
+        return NULL;
+
+    ExecutionMetadata metadata   = ast_create_metadata(ast);
+    SerializedAST*    serialized = ast_serialize(ast, &metadata);
+    if (serialized == NULL) {
+        free_node(ast);
+        return NULL;
+    }
+
+    QueryCacheEntry* entry = (QueryCacheEntry*)checked_realloc(NULL, sizeof(QueryCacheEntry));
+    entry->hash            = hash;
+    entry->key_length      = key->size;
+    entry->ast             = ast;
+    entry->serialized      = serialized;
+    entry->slots           = (int*)checked_realloc(NULL, (count > 0 ? count : 1) * sizeof(int));
+    entry->literal_count   = count;
+    entry->pinned          = NULL;
+    entry->pinned_count    = 0;
+    entry->referenced      = false;
+    entry->slot            = 0;
+    entry->next            = NULL;
+    atomic_init(&entry->refs, 1);
+
+    if (count > 0) {
+        LiteralList list = {NULL, 0, 0};
+        collect_literals(ast, &list);
+        map_slots(query, tokens, count, list.count, entry->slots);
+        free(list.nodes);
+    }
+
+    // Pinned literal texts are stored after the key
+    ByteBuffer stored = {NULL, 0, 0};
+    buffer_append(&stored, key->data, key->size);
+    for (size_t i = 0; i < count; i++) {
+        if (entry->slots[i] >= 0)
+            continue;
+
+        entry->pinned = (PinnedLiteral*)checked_realloc(
+            entry->pinned, (entry->pinned_count + 1) * sizeof(PinnedLiteral));
+        PinnedLiteral* pin = &entry->pinned[entry->pinned_count++];
+        pin->token         = i;
+        pin->offset        = stored.size;
+        pin->length        = tokens[i].length;
+        buffer_append(&stored, tokens[i].start, tokens[i].length);
+    }
+
+    entry->key = stored.data;
+    return entry;
+}
+
+/**
+ * Check whether an entry matches a normalized query.
+ *
+ * @param entry The entry.
+ * @param hash Hash of the query's key.
+ * @param key The query's key.
+ * @param tokens The literal tokens of the query.
+ * @return true if the entry's template can serve the query.
+ */
+static bool entry_matches(const QueryCacheEntry* entry, uint64_t hash, const ByteBuffer* key,
+                          const Token* tokens) {
+    if (entry->hash != hash || entry->key_length != key->size ||
+        memcmp(entry->key, key->data, key->size) != 0)
+        return false;
+
+    for (size_t i = 0; i < entry->pinned_count; i++) {
+        const PinnedLiteral* pin   = &entry->pinned[i];
+        const Token*         token = &tokens[pin->token];
+        if (token->length != pin->length ||
+            memcmp(token->start, entry->key + pin->offset, pin->length) != 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Find a matching entry in a shard. The shard must be locked.
+ *
+ * @param shard The shard.
+ * @param hash Hash of the query's key.
+ * @param key The query's key.
+ * @param tokens The literal tokens of the query.
+ * @return The entry, or NULL if there is none.
+ */
+static QueryCacheEntry* shard_find(QueryCacheShard* shard, uint64_t hash, const ByteBuffer* key,
+                                   const Token* tokens) {
+    QueryCacheEntry* entry = shard->buckets[hash & shard->bucket_mask];
+    for (; entry; entry = entry->next) {
+        if (entry_matches(entry, hash, key, tokens))
+            return entry;
+    }
+    return NULL;
+}
+
+/**
+ * Unlink an entry from its shard's hash chain. The shard must be locked.
+ *
+ * @param shard The shard.
+ * @param entry The entry.
+ */
+static void shard_unlink(QueryCacheShard* shard, QueryCacheEntry* entry) {
+    QueryCacheEntry** link = &shard->buckets[entry->hash & shard->bucket_mask];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+}
+
+/**
+ * Insert an entry into a shard, evicting with the CLOCK algorithm when it is full. The shard must
+ * be locked.
+ *
+ * @param cache The cache.
+ * @param shard The shard.
+ * @param entry The entry; the cache takes over its initial reference.
+ */
+static void shard_insert(QueryCache* cache, QueryCacheShard* shard, QueryCacheEntry* entry) {
+    if (shard->count < shard->capacity) {
+        entry->slot = shard->count++;
+        atomic_fetch_add(&cache->entries, 1);
+    } else {
+        // Give recently used entries a second chance
+        while (shard->ring[shard->hand]->referenced) {
+            shard->ring[shard->hand]->referenced = false;
+            shard->hand                          = (shard->hand + 1) % shard->capacity;
+        }
+
+        QueryCacheEntry* victim = shard->ring[shard->hand];
+        shard_unlink(shard, victim);
+        entry_release(victim);
+        atomic_fetch_add(&cache->evictions, 1);
+
+        entry->slot = shard->hand;
+        shard->hand = (shard->hand + 1) % shard->capacity;
+    }
+
+    shard->ring[entry->slot] = entry;
+
+    QueryCacheEntry** bucket = &shard->buckets[entry->hash & shard->bucket_mask];
+    entry->next              = *bucket;
+    *bucket                  = entry;
+}
+
+/**
+ * Create a query cache.
+ *
+ * @param capacity Maximum number of cached query shapes (0 for the default).
+ * @return The cache, or NULL if out of memory.
+ */
+QueryCache* query_cache_create(size_t capacity) {
+    if (capacity == 0)
+        capacity = QUERY_CACHE_DEFAULT_CAPACITY;
+
+    QueryCache* cache = (QueryCache*)calloc(1, sizeof(QueryCache));
+    if (!cache)
+        return NULL;
+
+    cache->shard_count = capacity < MAX_SHARDS ? capacity : MAX_SHARDS;
+    cache->shards = (QueryCacheShard*)calloc(cache->shard_count, sizeof(QueryCacheShard));
+    if (!cache->shards) {
+        free(cache);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        QueryCacheShard* shard = &cache->shards[i];
+
+        // Spread the capacity so the shards add up to exactly the requested total
+        shard->capacity = capacity / cache->shard_count + (i < capacity % cache->shard_count);
+
+        size_t buckets = 1;
+        while (buckets < shard->capacity) buckets *= 2;
+        shard->bucket_mask = buckets - 1;
+        shard->buckets     = (QueryCacheEntry**)calloc(buckets, sizeof(QueryCacheEntry*));
+        shard->ring        = (QueryCacheEntry**)calloc(shard->capacity, sizeof(QueryCacheEntry*));
+        nsql_mutex_init(&shard->lock);
+
+        if (!shard->buckets || !shard->ring) {
+            cache->shard_count = i + 1;
+            query_cache_destroy(cache);
+            return NULL;
+        }
+    }
+
+    atomic_init(&cache->hits, 0);
+    atomic_init(&cache->misses, 0);
+    atomic_init(&cache->evictions, 0);
+    atomic_init(&cache->entries, 0);
+    return cache;
+}
+
+/**
+ * Destroy a query cache.
+ *
+ * @param cache The cache to destroy.
+ */
+void query_cache_destroy(QueryCache* cache) {
+    if (!cache)
+        return;
+
+    for (size_t i = 0; i < cache->shard_count; i++) {
+        QueryCacheShard* shard = &cache->shards[i];
+        for (size_t j = 0; j < shard->count; j++) {
+            entry_release(shard->ring[j]);
+        }
+        free(shard->buckets);
+        free(shard->ring);
+        nsql_mutex_destroy(&shard->lock);
+    }
+
+    free(cache->shards);
+    free(cache);
+}
+
+/**
+ * Look up a query, parsing and caching it on a miss.
+ *
+ * @param cache The cache.
+ * @param query The query text.
+ * @param result Receives the result.
+ * @return true on success, false if the query is not a single statement that parses cleanly.
+ */
+bool query_cache_lookup(QueryCache* cache, const char* query, QueryCacheResult* result) {
+    memset(result, 0, sizeof(QueryCacheResult));
+
+    ByteBuffer    key = {NULL, 0, 0};
+    Token*        tokens;
+    QueryLiteral* literals;
+    size_t        count = normalize_query(query, &key, &tokens, &literals);
+    uint64_t      hash  = hash_key(key.data, key.size);
+
+    // Use the high bits for the shard so they are independent of the bucket index
+    QueryCacheShard* shard = &cache->shards[(hash >> 32) % cache->shard_count];
+
+    nsql_mutex_lock(&shard->lock);
+    QueryCacheEntry* entry = shard_find(shard, hash, &key, tokens);
+    if (entry) {
+        entry->referenced = true;
+        atomic_fetch_add(&entry->refs, 1);
+    }
+    nsql_mutex_unlock(&shard->lock);
+
+    if (entry) {
+        atomic_fetch_add(&cache->hits, 1);
+        result->hit = true;
+    } else {
+        // Parse outside the lock so other lookups in the shard are not held up
+        atomic_fetch_add(&cache->misses, 1);
+        QueryCacheEntry* created = entry_create(query, &key, hash, tokens, count);
+        if (created == NULL) {
+            free(key.data);
+            free(tokens);
+            free(literals);
+            return false;
+        }
+
+        nsql_mutex_lock(&shard->lock);
+        entry = shard_find(shard, hash, &key, tokens);
+        if (entry) {
+            // Another thread cached the same shape in the meantime
+            entry->referenced = true;
+            atomic_fetch_add(&entry->refs, 1);
+        } else {
+            entry = created;
+            atomic_fetch_add(&entry->refs, 1);
+            shard_insert(cache, shard, entry);
+            created = NULL;
+        }
+        nsql_mutex_unlock(&shard->lock);
+
+        if (created)
+            entry_release(created);
+    }
+
+    free(key.data);
+    free(tokens);
+
+    result->entry         = entry;
+    result->ast           = entry->ast;
+    result->serialized    = entry->serialized;
+    result->literals      = literals;
+    result->literal_count = count;
+    return true;
+}
+
+/**
+ * Build an AST for the looked-up query.
+ *
+ * @param result A successful lookup result.
+ * @return A new tree owned by the caller.
+ */
+Node* query_cache_instantiate(const QueryCacheResult* result) {
+    const QueryCacheEntry* entry = result->entry;
+    Node*                  tree  = ast_clone(entry->ast);
+
+    LiteralList list = {NULL, 0, 0};
+    collect_literals(tree, &list);
+
+    for (size_t i = 0; i < entry->literal_count; i++) {
+        if (entry->slots[i] < 0)
+            continue;
+
+        const QueryLiteral* literal = &result->literals[i];
+        Node*               node    = list.nodes[entry->slots[i]];
+        if (literal->type == TOKEN_STRING) {
+            char* value = (char*)checked_realloc(node->as.literal.value.string_value,
+                                                 literal->length + 1);
+            memcpy(value, literal->text, literal->length);
+            value[literal->length]              = '\0';
+            node->as.literal.value.string_value = value;
+            node->as.literal.length             = (int)literal->length;
+        } else {
+            node->as.literal.value.number_value = literal->number;
+        }
+    }
+
+    free(list.nodes);
+    return tree;
+}
+
+/**
+ * Release a lookup result.
+ *
+ * @param result The result to release.
+ */
+void query_cache_release(QueryCacheResult* result) {
+    if (result->entry)
+        entry_release(result->entry);
+    free(result->literals);
+    memset(result, 0, sizeof(QueryCacheResult));
+}
+
+/**
+ * Read the cache counters.
+ *
+ * @param cache The cache.
+ * @param stats Receives the counters.
+ */
+void query_cache_stats(QueryCache* cache, QueryCacheStats* stats) {
+    stats->hits      = atomic_load(&cache->hits);
+    stats->misses    = atomic_load(&cache->misses);
+    stats->evictions = atomic_load(&cache->evictions);
+    stats->entries   = atomic_load(&cache->entries);
+}
@@ -0,0 +1,550 @@
+/**
+ * @file scan.c
+ * @brief Vectorized character-class scanners used by the lexer and statement splitter
+ */
+
+#include "scan.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCAN_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernels are compiled with a target attribute and selected at runtime
+#if defined(SCAN_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// =======================================================
+// Bit helpers
+// =======================================================
+
+/**
+ * Count trailing zero bits of a non-zero 64-bit value.
+ */
+static inline unsigned scan_ctz(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctzll(x);
+#endif
+}
+
+/**
+ * Count the set bits of a 64-bit value.
+ */
+static inline unsigned scan_popcount(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned count = 0;
+    while (x) {
+        x &= x - 1;
+        count++;
+    }
+    return count;
+#else
+    return (unsigned)__builtin_popcountll(x);
+#endif
+}
+
+/**
+ * Mask of the bits below position n (n may be 64).
+ */
+static inline uint64_t low_bits(unsigned n) {
+    return n >= 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1);
+}
+
+// =======================================================
+// Scalar kernels
+// =======================================================
+
+static inline bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool is_identifier_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static const char* whitespace_scalar(const char* p, const char* end, int* newlines) {
+    while (p < end && is_whitespace(*p)) {
+        if (*p == '\n')
+            (*newlines)++;
+        p++;
+    }
+    return p;
+}
+
+static const char* identifier_scalar(const char* p, const char* end) {
+    while (p < end && is_identifier_char(*p)) p++;
+    return p;
+}
+
+static const char* digits_scalar(const char* p, const char* end) {
+    while (p < end && *p >= '0' && *p <= '9') p++;
+    return p;
+}
+
+static const char* string_scalar(const char* p, const char* end, char quote, int* newlines) {
+    while (p < end && *p != quote) {
+        if (*p == '\n')
+            (*newlines)++;
+        p++;
+    }
+    return p;
+}
+
+static size_t newlines_scalar(const char* p, const char* end) {
+    size_t count = 0;
+    for (; p < end; p++) {
+        if (*p == '\n')
+            count++;
+    }
+    return count;
+}
+
+// =======================================================
+// SSE2 kernels
+// =======================================================
+
+#ifdef SCAN_SSE2
+
+/**
+ * Byte-wise unsigned range test lo <= x <= hi using signed SSE2 compares.
+ */
+static inline __m128i sse2_in_range(__m128i x, char lo, char hi) {
+    __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8((char)(-128 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(-128 + (hi - lo + 1))));
+}
+
+static const char* whitespace_sse2(const char* p, const char* end, int* newlines) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab   = _mm_set1_epi8('\t');
+    const __m128i cr    = _mm_set1_epi8('\r');
+    const __m128i nl    = _mm_set1_epi8('\n');
+
+    while (end - p >= 16) {
+        __m128i  v       = _mm_loadu_si128((const __m128i*)p);
+        __m128i  is_nl   = _mm_cmpeq_epi8(v, nl);
+        __m128i  blank   = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab));
+        __m128i  ws      = _mm_or_si128(blank, _mm_or_si128(_mm_cmpeq_epi8(v, cr), is_nl));
+        uint32_t ws_mask = (uint32_t)_mm_movemask_epi8(ws);
+        uint32_t nl_mask = (uint32_t)_mm_movemask_epi8(is_nl);
+
+        if (ws_mask != 0xFFFF) {
+            unsigned index = scan_ctz(~ws_mask);
+            *newlines += (int)scan_popcount(nl_mask & low_bits(index));
+            return p + index;
+        }
+
+        *newlines += (int)scan_popcount(nl_mask);
+        p += 16;
+    }
+
+    return whitespace_scalar(p, end, newlines);
+}
+
+static const char* identifier_sse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v     = _mm_loadu_si128((const __m128i*)p);
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));  // Fold A-Z onto a-z
+        __m128i ok    = _mm_or_si128(sse2_in_range(lower, 'a', 'z'), sse2_in_range(v, '0', '9'));
+        ok            = _mm_or_si128(ok, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(ok);
+        if (mask != 0xFFFF)
+            return p + scan_ctz(~mask);
+        p += 16;
+    }
+
+    return identifier_scalar(p, end);
+}
+
+static const char* digits_sse2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i  v    = _mm_loadu_si128((const __m128i*)p);
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(sse2_in_range(v, '0', '9'));
+        if (mask != 0xFFFF)
+            return p + scan_ctz(~mask);
+        p += 16;
+    }
+
+    return digits_scalar(p, end);
+}
+
+static const char* string_sse2(const char* p, const char* end, char quote, int* newlines) {
+    const __m128i q  = _mm_set1_epi8(quote);
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    while (end - p >= 16) {
+        __m128i  v          = _mm_loadu_si128((const __m128i*)p);
+        uint32_t quote_mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, q));
+        uint32_t nl_mask    = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+
+        if (quote_mask) {
+            unsigned index = scan_ctz(quote_mask);
+            *newlines += (int)scan_popcount(nl_mask & low_bits(index));
+            return p + index;
+        }
+
+        *newlines += (int)scan_popcount(nl_mask);
+        p += 16;
+    }
+
+    return string_scalar(p, end, quote, newlines);
+}
+
+static size_t newlines_sse2(const char* p, const char* end) {
+    const __m128i nl    = _mm_set1_epi8('\n');
+    size_t        count = 0;
+
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)p);
+        count += scan_popcount((uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+        p += 16;
+    }
+
+    return count + newlines_scalar(p, end);
+}
+
+#endif /* SCAN_SSE2 */
+
+// =======================================================
+// AVX2 kernels (long runs only: string bodies and line counting)
+// =======================================================
+
+#ifdef SCAN_AVX2
+
+__attribute__((target("avx2"))) static const char* string_avx2(const char* p, const char* end,
+                                                               char quote, int* newlines) {
+    const __m256i q  = _mm256_set1_epi8(quote);
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    while (end - p >= 32) {
+        __m256i  v          = _mm256_loadu_si256((const __m256i*)p);
+        uint32_t quote_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, q));
+        uint32_t nl_mask    = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+
+        if (quote_mask) {
+            unsigned index = scan_ctz(quote_mask);
+            *newlines += (int)scan_popcount(nl_mask & low_bits(index));
+            return p + index;
+        }
+
+        *newlines += (int)scan_popcount(nl_mask);
+        p += 32;
+    }
+
+    return string_sse2(p, end, quote, newlines);
+}
+
+__attribute__((target("avx2"))) static size_t newlines_avx2(const char* p, const char* end) {
+    const __m256i nl    = _mm256_set1_epi8('\n');
+    size_t        count = 0;
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)p);
+        count += scan_popcount((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+        p += 32;
+    }
+
+    return count + newlines_sse2(p, end);
+}
+
+/**
+ * Check whether the running CPU supports AVX2.
+ */
+static inline bool cpu_has_avx2(void) {
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif /* SCAN_AVX2 */
+
+// =======================================================
+// NEON kernels
+// =======================================================
+
+#ifdef SCAN_NEON
+
+/**
+ * Compress a byte-wise comparison result into a 64-bit mask with 4 bits per byte.
+ */
+static inline uint64_t neon_mask(uint8x16_t eq) {
+    uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+
+static inline uint8x16_t neon_in_range(uint8x16_t x, uint8_t lo, uint8_t hi) {
+    return vandq_u8(vcgeq_u8(x, vdupq_n_u8(lo)), vcleq_u8(x, vdupq_n_u8(hi)));
+}
+
+static const char* whitespace_neon(const char* p, const char* end, int* newlines) {
+    while (end - p >= 16) {
+        uint8x16_t v       = vld1q_u8((const uint8_t*)p);
+        uint8x16_t is_nl   = vceqq_u8(v, vdupq_n_u8('\n'));
+        uint8x16_t blank   = vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t')));
+        uint8x16_t ws      = vorrq_u8(blank, vorrq_u8(vceqq_u8(v, vdupq_n_u8('\r')), is_nl));
+        uint64_t   ws_mask = neon_mask(ws);
+        uint64_t   nl_mask = neon_mask(is_nl);
+
+        if (ws_mask != ~(uint64_t)0) {
+            unsigned index = scan_ctz(~ws_mask) / 4;
+            *newlines += (int)(scan_popcount(nl_mask & low_bits(index * 4)) / 4);
+            return p + index;
+        }
+
+        *newlines += (int)(scan_popcount(nl_mask) / 4);
+        p += 16;
+    }
+
+    return whitespace_scalar(p, end, newlines);
+}
+
+static const char* identifier_neon(const char* p, const char* end) {
+    while (end - p >= 16) {
+        uint8x16_t v     = vld1q_u8((const uint8_t*)p);
+        uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+        uint8x16_t ok    = vorrq_u8(neon_in_range(lower, 'a', 'z'), neon_in_range(v, '0', '9'));
+        ok               = vorrq_u8(ok, vceqq_u8(v, vdupq_n_u8('_')));
+
+        uint64_t mask = neon_mask(ok);
+        if (mask != ~(uint64_t)0)
+            return p + scan_ctz(~mask) / 4;
+        p += 16;
+    }
+
+    return identifier_scalar(p, end);
+}
+
+static const char* digits_neon(const char* p, const char* end) {
+    while (end - p >= 16) {
+        uint64_t mask = neon_mask(neon_in_range(vld1q_u8((const uint8_t*)p), '0', '9'));
+        if (mask != ~(uint64_t)0)
+            return p + scan_ctz(~mask) / 4;
+        p += 16;
+    }
+
+    return digits_scalar(p, end);
+}
+
+static const char* string_neon(const char* p, const char* end, char quote, int* newlines) {
+    while (end - p >= 16) {
+        uint8x16_t v          = vld1q_u8((const uint8_t*)p);
+        uint64_t   quote_mask = neon_mask(vceqq_u8(v, vdupq_n_u8((uint8_t)quote)));
+        uint64_t   nl_mask    = neon_mask(vceqq_u8(v, vdupq_n_u8('\n')));
+
+        if (quote_mask) {
+            unsigned index = scan_ctz(quote_mask) / 4;
+            *newlines += (int)(scan_popcount(nl_mask & low_bits(index * 4)) / 4);
+            return p + index;
+        }
+
+        *newlines += (int)(scan_popcount(nl_mask) / 4);
+        p += 16;
+    }
+
+    return string_scalar(p, end, quote, newlines);
+}
+
+static size_t newlines_neon(const char* p, const char* end) {
+    size_t count = 0;
+
+    while (end - p >= 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8((const uint8_t*)p), vdupq_n_u8('\n'));
+        count += vaddvq_u8(vshrq_n_u8(eq, 7));
+        p += 16;
+    }
+
+    return count + newlines_scalar(p, end);
+}
+
+#endif /* SCAN_NEON */
+
+// =======================================================
+// Dispatch
+// =======================================================
+
+const char* nsql_scan_whitespace(const char* p, const char* end, int* newlines) {
+    // Most runs are a single space, so settle those without touching vector registers
+    if (p >= end || !is_whitespace(*p))
+        return p;
+    if (p + 1 >= end || !is_whitespace(p[1]))
+        return whitespace_scalar(p, end, newlines);
+
+#if defined(SCAN_SSE2)
+    return whitespace_sse2(p, end, newlines);
+#elif defined(SCAN_NEON)
+    return whitespace_neon(p, end, newlines);
+#else
+    return whitespace_scalar(p, end, newlines);
+#endif
+}
+
+const char* nsql_scan_identifier(const char* p, const char* end) {
+#if defined(SCAN_SSE2)
+    return identifier_sse2(p, end);
+#elif defined(SCAN_NEON)
+    return identifier_neon(p, end);
+#else
+    return identifier_scalar(p, end);
+#endif
+}
+
+const char* nsql_scan_digits(const char* p, const char* end) {
+#if defined(SCAN_SSE2)
+    return digits_sse2(p, end);
+#elif defined(SCAN_NEON)
+    return digits_neon(p, end);
+#else
+    return digits_scalar(p, end);
+#endif
+}
+
+const char* nsql_scan_string(const char* p, const char* end, char quote, int* newlines) {
+#if defined(SCAN_AVX2)
+    if (end - p >= 64 && cpu_has_avx2())
+        return string_avx2(p, end, quote, newlines);
+#endif
+#if defined(SCAN_SSE2)
+    return string_sse2(p, end, quote, newlines);
+#elif defined(SCAN_NEON)
+    return string_neon(p, end, quote, newlines);
+#else
+    return string_scalar(p, end, quote, newlines);
+#endif
+}
+
+const char* nsql_scan_line_end(const char* p, const char* end) {
+    // The C library's memchr is already vectorized on every platform we target
+    const char* newline = p < end ? (const char*)memchr(p, '\n', (size_t)(end - p)) : NULL;
+    return newline ? newline : end;
+}
+
+size_t nsql_count_newlines(const char* p, const char* end) {
+#if defined(SCAN_AVX2)
+    if (end - p >= 64 && cpu_has_avx2())
+        return newlines_avx2(p, end);
+#endif
+#if defined(SCAN_SSE2)
+    return newlines_sse2(p, end);
+#elif defined(SCAN_NEON)
+    return newlines_neon(p, end);
+#else
+    return newlines_scalar(p, end);
+#endif
+}
+
+long nsql_scan_integer_value(const char* p, const char* end) {
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        int digit = *p - '0';
+        if (value > (LONG_MAX - digit) / 10)
+            return LONG_MAX;
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+double nsql_scan_decimal_value(const char* p, const char* end) {
+    // strtod() needs a terminator, so the number is copied, to the heap only if it is very long
+    char   inline_text[64];
+    size_t length = (size_t)(end - p);
+    char*  text   = length < sizeof(inline_text) ? inline_text : (char*)malloc(length + 1);
+    if (!text) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(text, p, length);
+    text[length] = '\0';
+
+    double value = strtod(text, NULL);
+    if (text != inline_text)
+        free(text);
+    return value;
+}
+
+// =======================================================
+// Statements
+// =======================================================
+
+/**
+ * Check whether a word is the PLEASE terminator.
+ *
+ * @param word Start of the word.
+ * @param length Length of the word.
+ * @param case_insensitive Whether to ignore case.
+ * @return true if the word ends a statement.
+ */
+static bool is_please(const char* word, size_t length, bool case_insensitive) {
+    static const char please[] = "PLEASE";
+    if (length != sizeof(please) - 1)
+        return false;
+    if (!case_insensitive)
+        return memcmp(word, please, length) == 0;
+
+    for (size_t i = 0; i < length; i++) {
+        char c = word[i];
+        if (c >= 'a' && c <= 'z')
+            c = (char)(c - 'a' + 'A');
+        if (c != please[i])
+            return false;
+    }
+    return true;
+}
+
+const char* nsql_scan_statement(const char* p, const char* end, bool case_insensitive,
+                                int* newlines, bool* has_tokens) {
+    *has_tokens = false;
+
+    for (;;) {
+        bool terminated = false;
+
+        p = nsql_scan_whitespace(p, end, newlines);
+        if (p >= end)
+            return end;
+
+        char c = *p;
+        if (c == '>' && p + 1 < end && p[1] == '>') {
+            // Comments run to the end of the line
+            p = nsql_scan_line_end(p + 2, end);
+            continue;
+        }
+
+        *has_tokens = true;
+        if (c == '"' || c == '\'') {
+            p = nsql_scan_string(p + 1, end, c, newlines);
+            if (p < end)
+                p++;  // Closing quote
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            const char* word = p;
+            p                = nsql_scan_identifier(p + 1, end);
+            terminated       = is_please(word, (size_t)(p - word), case_insensitive);
+        } else if (c >= '0' && c <= '9') {
+            p = nsql_scan_digits(p + 1, end);
+        } else {
+            terminated = c == ';';
+            p++;
+        }
+
+        if (terminated)
+            return p;
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file scan.h
+ * @brief Vectorized character-class scanners used by the lexer and statement splitter (internal)
+ *
+ * Every scanner takes a half-open range [p, end) and never reads at or beyond end. Builds pick the
+ * widest kernel available (AVX2 with runtime detection, SSE2, or NEON) and fall back to scalar
+ * code for the tail of the range and on other targets.
+ */
+
+#ifndef NSQL_SCAN_H
+#define NSQL_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Skip a run of whitespace (space, tab, carriage return, newline)
+ *
+ * @param p Start of the range
+ * @param end End of the range
+ * @param newlines Incremented by the number of newlines skipped
+ * @return Pointer to the first non-whitespace character, or end
+ */
+const char* nsql_scan_whitespace(const char* p, const char* end, int* newlines);
+
+/**
+ * Skip a run of identifier characters ([A-Za-z0-9_])
+ *
+ * @param p Start of the range
+ * @param end End of the range
+ * @return Pointer to the first character that cannot continue an identifier, or end
+ */
+const char* nsql_scan_identifier(const char* p, const char* end);
+
+/**
+ * Skip a run of decimal digits
+ *
+ * @param p Start of the range
+ * @param end End of the range
+ * @return Pointer to the first non-digit character, or end
+ */
+const char* nsql_scan_digits(const char* p, const char* end);
+
+/**
+ * Find the closing quote of a string literal
+ *
+ * @param p Start of the string body (just after the opening quote)
+ * @param end End of the range
+ * @param quote The quote character to look for
+ * @param newlines Incremented by the number of newlines before the quote
+ * @return Pointer to the closing quote, or end if the string is unterminated
+ */
+const char* nsql_scan_string(const char* p, const char* end, char quote, int* newlines);
+
+/**
+ * Find the end of the current line
+ *
+ * @param p Start of the range
+ * @param end End of the range
+ * @return Pointer to the next newline character, or end
+ */
+const char* nsql_scan_line_end(const char* p, const char* end);
+
+/**
+ * Count newline characters in a range
+ *
+ * @param p Start of the range
+ * @param end End of the range
+ * @return The number of newline characters
+ */
+size_t nsql_count_newlines(const char* p, const char* end);
+
+/**
+ * Convert a run of decimal digits to a number, like strtol() but without reading past end
+ *
+ * @param p Start of the digits
+ * @param end End of the range
+ * @return The value of the digits before the first non-digit, saturated at LONG_MAX
+ */
+long nsql_scan_integer_value(const char* p, const char* end);
+
+/**
+ * Convert a decimal number to a double, like strtod() but without reading past end
+ *
+ * @param p Start of the number
+ * @param end End of the range
+ * @return The value of the number
+ */
+double nsql_scan_decimal_value(const char* p, const char* end);
+
+/**
+ * Find the end of the statement that starts at p
+ *
+ * Mirrors the lexer's view of strings, comments and words, so only a semicolon or PLEASE that the
+ * lexer would produce as a TOKEN_TERMINATOR ends the statement.
+ *
+ * @param p Start of the statement
+ * @param end End of the range
+ * @param case_insensitive Whether PLEASE is recognised regardless of case
+ * @param newlines Incremented by the number of newlines before the returned position
+ * @param has_tokens Set to whether the statement contains anything but whitespace and comments
+ * @return Pointer just past the terminator, or end if the statement is unterminated
+ */
+const char* nsql_scan_statement(const char* p, const char* end, bool case_insensitive,
+                                int* newlines, bool* has_tokens);
+
+#endif /* NSQL_SCAN_H */
@@ -0,0 +1,171 @@
+/**
+ * @file stats.c
+ * @brief Per-thread statistics blocks and their process-wide totals
+ */
+
+#include "stats.h"
+
+#include <string.h>
+
+#ifdef ENABLE_STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "thread.h"
+
+_Thread_local NsqlThreadStats* nsql_thread_stats = NULL;
+
+// Blocks of running threads, and the totals of the threads that have exited
+static NsqlMutex        registry_lock = NSQL_MUTEX_INITIALIZER;
+static NsqlThreadStats* running       = NULL;
+static uint64_t         retired[NSQL_STAT_FIELDS];
+static uint64_t         baseline[NSQL_STAT_FIELDS];  // Totals at the last nsql_stats_reset()
+static NsqlThreadKey    exit_key;
+static bool             has_exit_key = false;
+
+/**
+ * Fold the block of an exiting thread into the retired totals.
+ *
+ * @param data The thread's block.
+ */
+static void retire_block(void* data) {
+    NsqlThreadStats* stats = (NsqlThreadStats*)data;
+
+    nsql_mutex_lock(&registry_lock);
+    for (size_t i = 0; i < NSQL_STAT_FIELDS; i++) {
+        retired[i] += atomic_load_explicit(&stats->counters[i], memory_order_relaxed);
+    }
+    if (stats->prev)
+        stats->prev->next = stats->next;
+    else
+        running = stats->next;
+    if (stats->next)
+        stats->next->prev = stats->prev;
+    nsql_mutex_unlock(&registry_lock);
+
+    // Destructors run on the exiting thread, and later ones may count again
+    nsql_thread_stats = NULL;
+    free(stats);
+}
+
+/**
+ * Create and register the counters of the calling thread.
+ *
+ * @return The counters.
+ */
+NsqlThreadStats* nsql_stats_register(void) {
+    NsqlThreadStats* stats = (NsqlThreadStats*)malloc(sizeof(NsqlThreadStats));
+    if (!stats) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < NSQL_STAT_FIELDS; i++) {
+        atomic_init(&stats->counters[i], 0);
+    }
+
+    nsql_mutex_lock(&registry_lock);
+    if (!has_exit_key)
+        has_exit_key = nsql_thread_key_create(&exit_key, retire_block);
+
+    stats->prev = NULL;
+    stats->next = running;
+    if (running)
+        running->prev = stats;
+    running = stats;
+
+    // Without an exit hook the block simply stays registered
+    if (has_exit_key)
+        nsql_thread_key_set(&exit_key, stats);
+    nsql_mutex_unlock(&registry_lock);
+
+    nsql_thread_stats = stats;
+    return stats;
+}
+
+/**
+ * Read a monotonic clock.
+ *
+ * @return The time in nanoseconds.
+ */
+uint64_t nsql_stat_clock(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER        now;
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000000u +
+           (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000000u /
+               (uint64_t)frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * Add up the counters of every thread. The registry must be locked.
+ *
+ * @param totals Receives the totals.
+ */
+static void sum_blocks(uint64_t* totals) {
+    memcpy(totals, retired, sizeof(retired));
+    for (NsqlThreadStats* stats = running; stats; stats = stats->next) {
+        for (size_t i = 0; i < NSQL_STAT_FIELDS; i++) {
+            totals[i] += atomic_load_explicit(&stats->counters[i], memory_order_relaxed);
+        }
+    }
+}
+
+#endif /* ENABLE_STATS */
+
+/**
+ * Check whether statistics were compiled in.
+ *
+ * @return true if the library was built with ENABLE_STATS.
+ */
+bool nsql_stats_enabled(void) {
+#ifdef ENABLE_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Get the process-wide counters since the last reset.
+ *
+ * @param stats Receives the counters.
+ */
+void nsql_stats_get(NsqlStats* stats) {
+    memset(stats, 0, sizeof(NsqlStats));
+
+#ifdef ENABLE_STATS
+    uint64_t totals[NSQL_STAT_FIELDS];
+    nsql_mutex_lock(&registry_lock);
+    sum_blocks(totals);
+    for (size_t i = 0; i < NSQL_STAT_FIELDS; i++) {
+        totals[i] -= baseline[i];
+    }
+    nsql_mutex_unlock(&registry_lock);
+
+    memcpy(stats, totals, sizeof(totals));
+#endif
+}
+
+/**
+ * Start counting the process-wide counters from zero.
+ *
+ * Other threads own their counters, so rather than clearing them the current totals become the
+ * baseline that nsql_stats_get() subtracts.
+ */
+void nsql_stats_reset(void) {
+#ifdef ENABLE_STATS
+    nsql_mutex_lock(&registry_lock);
+    sum_blocks(baseline);
+    nsql_mutex_unlock(&registry_lock);
+#endif
+}
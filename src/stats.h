@@ -0,0 +1,89 @@
+/**
+ * @file stats.h
+ * @brief Statistics hooks (internal)
+ *
+ * The hooks expand to nothing unless ENABLE_STATS is defined.
+ */
+
+#ifndef NSQL_STATS_INTERNAL_H
+#define NSQL_STATS_INTERNAL_H
+
+#include <nsql/stats.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef ENABLE_STATS
+
+#include <stdatomic.h>
+
+// Number of uint64_t counters in NsqlStats
+#define NSQL_STAT_FIELDS (sizeof(NsqlStats) / sizeof(uint64_t))
+
+// Index of a field in the counters of NsqlThreadStats
+#define NSQL_STAT_INDEX(field) (offsetof(NsqlStats, field) / sizeof(uint64_t))
+
+/**
+ * Counters of one thread
+ *
+ * Only the owning thread writes the counters. They are atomic so that nsql_stats_get() can read
+ * them from other threads, but the owner updates them with a plain load and store.
+ */
+typedef struct NsqlThreadStats {
+    _Atomic uint64_t        counters[NSQL_STAT_FIELDS];  // The fields of NsqlStats, in order
+    struct NsqlThreadStats* prev;                        // Previous block of a running thread
+    struct NsqlThreadStats* next;                        // Next block of a running thread
+} NsqlThreadStats;
+
+// Counters of the calling thread (NULL until it first counts something)
+extern _Thread_local NsqlThreadStats* nsql_thread_stats;
+
+/**
+ * Create and register the counters of the calling thread
+ *
+ * @return The counters, also stored in nsql_thread_stats
+ */
+NsqlThreadStats* nsql_stats_register(void);
+
+/**
+ * Read a monotonic clock
+ *
+ * @return The time in nanoseconds
+ */
+uint64_t nsql_stat_clock(void);
+
+/**
+ * Add to a counter of the calling thread
+ *
+ * @param index Index of the counter
+ * @param amount Amount to add
+ */
+static inline void nsql_stat_add(size_t index, uint64_t amount) {
+    NsqlThreadStats* stats = nsql_thread_stats;
+    if (!stats)
+        stats = nsql_stats_register();
+
+    uint64_t value = atomic_load_explicit(&stats->counters[index], memory_order_relaxed);
+    atomic_store_explicit(&stats->counters[index], value + amount, memory_order_relaxed);
+}
+
+#define NSQL_STAT_ADD(field, amount) nsql_stat_add(NSQL_STAT_INDEX(field), (uint64_t)(amount))
+#define NSQL_STAT_ADD_AT(field, i, amount) \
+    nsql_stat_add(NSQL_STAT_INDEX(field) + (size_t)(i), (uint64_t)(amount))
+
+// Declare a variable holding the current time, for NSQL_STAT_ELAPSED()
+#define NSQL_STAT_CLOCK(name) uint64_t name = nsql_stat_clock()
+
+// Add the time since a NSQL_STAT_CLOCK() to a stage
+#define NSQL_STAT_ELAPSED(stage, start) \
+    NSQL_STAT_ADD_AT(stage_ns, stage, nsql_stat_clock() - (start))
+
+#else
+
+#define NSQL_STAT_ADD(field, amount) ((void)0)
+#define NSQL_STAT_ADD_AT(field, i, amount) ((void)0)
+#define NSQL_STAT_CLOCK(name)
+#define NSQL_STAT_ELAPSED(stage, start) ((void)0)
+
+#endif /* ENABLE_STATS */
+
+#endif /* NSQL_STATS_INTERNAL_H */
@@ -0,0 +1,178 @@
+/**
+ * @file thread.c
+ * @brief Implementation of the portable threading shim
+ */
+
+#include "thread.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_main(LPVOID param) {
+    NsqlThread* thread = (NsqlThread*)param;
+    thread->fn(thread->arg);
+    return 0;
+}
+
+bool nsql_thread_create(NsqlThread* thread, NsqlThreadFn fn, void* arg) {
+    thread->fn     = fn;
+    thread->arg    = arg;
+    thread->handle = CreateThread(NULL, 0, thread_main, thread, 0, NULL);
+    return thread->handle != NULL;
+}
+
+void nsql_thread_join(NsqlThread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+}
+
+void nsql_mutex_init(NsqlMutex* mutex) {
+    InitializeSRWLock(&mutex->lock);
+}
+
+void nsql_mutex_destroy(NsqlMutex* mutex) {
+    (void)mutex;  // SRW locks need no cleanup
+}
+
+void nsql_mutex_lock(NsqlMutex* mutex) {
+    AcquireSRWLockExclusive(&mutex->lock);
+}
+
+void nsql_mutex_unlock(NsqlMutex* mutex) {
+    ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+void nsql_cond_init(NsqlCond* cond) {
+    InitializeConditionVariable(&cond->cond);
+}
+
+void nsql_cond_destroy(NsqlCond* cond) {
+    (void)cond;  // Condition variables need no cleanup
+}
+
+void nsql_cond_wait(NsqlCond* cond, NsqlMutex* mutex) {
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+}
+
+void nsql_cond_signal(NsqlCond* cond) {
+    WakeConditionVariable(&cond->cond);
+}
+
+void nsql_cond_broadcast(NsqlCond* cond) {
+    WakeAllConditionVariable(&cond->cond);
+}
+
+// Value of a thread key, with the destructor fiber-local storage callbacks cannot be given
+typedef struct {
+    NsqlThreadFn destructor;
+    void*        value;
+} KeyValue;
+
+static VOID WINAPI run_key_destructor(PVOID data) {
+    KeyValue* entry = (KeyValue*)data;
+    if (entry) {
+        entry->destructor(entry->value);
+        free(entry);
+    }
+}
+
+bool nsql_thread_key_create(NsqlThreadKey* key, NsqlThreadFn destructor) {
+    key->destructor = destructor;
+    key->index      = FlsAlloc(run_key_destructor);
+    return key->index != FLS_OUT_OF_INDEXES;
+}
+
+bool nsql_thread_key_set(NsqlThreadKey* key, void* value) {
+    KeyValue* entry = (KeyValue*)malloc(sizeof(KeyValue));
+    if (!entry)
+        return false;
+
+    entry->destructor = key->destructor;
+    entry->value      = value;
+    if (!FlsSetValue(key->index, entry)) {
+        free(entry);
+        return false;
+    }
+    return true;
+}
+
+int nsql_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+static void* thread_main(void* param) {
+    NsqlThread* thread = (NsqlThread*)param;
+    thread->fn(thread->arg);
+    return NULL;
+}
+
+bool nsql_thread_create(NsqlThread* thread, NsqlThreadFn fn, void* arg) {
+    thread->fn  = fn;
+    thread->arg = arg;
+    return pthread_create(&thread->handle, NULL, thread_main, thread) == 0;
+}
+
+void nsql_thread_join(NsqlThread* thread) {
+    pthread_join(thread->handle, NULL);
+}
+
+void nsql_mutex_init(NsqlMutex* mutex) {
+    pthread_mutex_init(&mutex->lock, NULL);
+}
+
+void nsql_mutex_destroy(NsqlMutex* mutex) {
+    pthread_mutex_destroy(&mutex->lock);
+}
+
+void nsql_mutex_lock(NsqlMutex* mutex) {
+    pthread_mutex_lock(&mutex->lock);
+}
+
+void nsql_mutex_unlock(NsqlMutex* mutex) {
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+void nsql_cond_init(NsqlCond* cond) {
+    pthread_cond_init(&cond->cond, NULL);
+}
+
+void nsql_cond_destroy(NsqlCond* cond) {
+    pthread_cond_destroy(&cond->cond);
+}
+
+void nsql_cond_wait(NsqlCond* cond, NsqlMutex* mutex) {
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+}
+
+void nsql_cond_signal(NsqlCond* cond) {
+    pthread_cond_signal(&cond->cond);
+}
+
+void nsql_cond_broadcast(NsqlCond* cond) {
+    pthread_cond_broadcast(&cond->cond);
+}
+
+bool nsql_thread_key_create(NsqlThreadKey* key, NsqlThreadFn destructor) {
+    key->destructor = destructor;
+    return pthread_key_create(&key->key, destructor) == 0;
+}
+
+bool nsql_thread_key_set(NsqlThreadKey* key, void* value) {
+    return pthread_setspecific(key->key, value) == 0;
+}
+
+int nsql_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+#endif
@@ -0,0 +1,194 @@
+/**
+ * @file thread.h
+ * @brief Minimal portable threading shim (internal)
+ *
+ * Wraps POSIX threads or the Win32 thread API behind the small surface the library needs.
+ */
+
+#ifndef NSQL_THREAD_H
+#define NSQL_THREAD_H
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/**
+ * Thread entry point
+ */
+typedef void (*NsqlThreadFn)(void* arg);
+
+/**
+ * Thread handle
+ *
+ * The handle stores the entry point and its argument, so it must stay alive until the thread has
+ * been joined.
+ */
+typedef struct {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    NsqlThreadFn fn;
+    void*        arg;
+} NsqlThread;
+
+/**
+ * Mutex
+ */
+typedef struct {
+#ifdef _WIN32
+    SRWLOCK lock;
+#else
+    pthread_mutex_t lock;
+#endif
+} NsqlMutex;
+
+/**
+ * Static initializer for an NsqlMutex that is never destroyed
+ */
+#ifdef _WIN32
+#define NSQL_MUTEX_INITIALIZER {SRWLOCK_INIT}
+#else
+#define NSQL_MUTEX_INITIALIZER {PTHREAD_MUTEX_INITIALIZER}
+#endif
+
+/**
+ * Condition variable, used with an NsqlMutex
+ */
+typedef struct {
+#ifdef _WIN32
+    CONDITION_VARIABLE cond;
+#else
+    pthread_cond_t cond;
+#endif
+} NsqlCond;
+
+/**
+ * Key of a per-thread value that is handed to a destructor when its thread exits
+ */
+typedef struct {
+#ifdef _WIN32
+    DWORD index;
+#else
+    pthread_key_t key;
+#endif
+    NsqlThreadFn destructor;
+} NsqlThreadKey;
+
+/**
+ * Initialize a mutex
+ *
+ * @param mutex The mutex to initialize
+ */
+void nsql_mutex_init(NsqlMutex* mutex);
+
+/**
+ * Destroy a mutex
+ *
+ * @param mutex The mutex to destroy
+ */
+void nsql_mutex_destroy(NsqlMutex* mutex);
+
+/**
+ * Lock a mutex
+ *
+ * @param mutex The mutex to lock
+ */
+void nsql_mutex_lock(NsqlMutex* mutex);
+
+/**
+ * Unlock a mutex
+ *
+ * @param mutex The mutex to unlock
+ */
+void nsql_mutex_unlock(NsqlMutex* mutex);
+
+/**
+ * Initialize a condition variable
+ *
+ * @param cond The condition variable to initialize
+ */
+void nsql_cond_init(NsqlCond* cond);
+
+/**
+ * Destroy a condition variable
+ *
+ * @param cond The condition variable to destroy
+ */
+void nsql_cond_destroy(NsqlCond* cond);
+
+/**
+ * Wait on a condition variable
+ *
+ * The mutex is released while waiting and locked again before returning. Wakeups may be
+ * spurious, so callers wait in a loop that checks their condition.
+ *
+ * @param cond The condition variable
+ * @param mutex The locked mutex guarding the condition
+ */
+void nsql_cond_wait(NsqlCond* cond, NsqlMutex* mutex);
+
+/**
+ * Wake one thread waiting on a condition variable
+ *
+ * @param cond The condition variable
+ */
+void nsql_cond_signal(NsqlCond* cond);
+
+/**
+ * Wake every thread waiting on a condition variable
+ *
+ * @param cond The condition variable
+ */
+void nsql_cond_broadcast(NsqlCond* cond);
+
+/**
+ * Create a thread key
+ *
+ * The key must stay alive for as long as any thread has a value set for it.
+ *
+ * @param key The key to create
+ * @param destructor Called with the value of each exiting thread that has one
+ * @return true if the key was created
+ */
+bool nsql_thread_key_create(NsqlThreadKey* key, NsqlThreadFn destructor);
+
+/**
+ * Set the calling thread's value for a key
+ *
+ * @param key The key
+ * @param value The value (not NULL)
+ * @return true if the value was set
+ */
+bool nsql_thread_key_set(NsqlThreadKey* key, void* value);
+
+/**
+ * Start a thread
+ *
+ * @param thread The thread handle to fill in
+ * @param fn The function to run
+ * @param arg Argument passed to fn
+ * @return true if the thread was started
+ */
+bool nsql_thread_create(NsqlThread* thread, NsqlThreadFn fn, void* arg);
+
+/**
+ * Wait for a thread to finish
+ *
+ * @param thread The thread to join
+ */
+void nsql_thread_join(NsqlThread* thread);
+
+/**
+ * Get the number of online CPUs
+ *
+ * @return The number of CPUs, at least 1
+ */
+int nsql_cpu_count(void);
+
+#endif /* NSQL_THREAD_H */
@@ -0,0 +1,2247 @@
+/**
+ * @file test_parser.c
+ * @brief Parser regression tests
+ *
+ * Each test returns true if it passes. The sources are heap copies freed before the errors are
+ * read, so references into them show up under AddressSanitizer.
+ */
+
+// Terms of the chain in the deep tree tests, deeper than an 8 MB stack allows a recursive walk
+#define DEEP_TERMS 200000
+
+// A statement with a condition, a string literal, ordering and a count, shared by the format tests
+#define SAMPLE_QUERY                                                                               \
+    "ASK customers FOR name, email WHERE age > 30 AND plan = 'annual' ORDER BY name DESC LIMIT 10;"
+
+#include <nsql/arena.h>
+#include <nsql/ast_optimizer.h>
+#include <nsql/ast_pool.h>
+#include <nsql/ast_printer.h>
+#include <nsql/ast_reader.h>
+#include <nsql/ast_serializer.h>
+#include <nsql/ast_visitor.h>
+#include <nsql/document.h>
+#include <nsql/parallel_parser.h>
+#include <nsql/parser.h>
+#include <nsql/planner.h>
+#include <nsql/processor.h>
+#include <nsql/query_cache.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Parse a heap copy of a script, free the copy and format the errors.
+ *
+ * @param script The script.
+ * @param terminated Whether the copy is null-terminated (lexer_init_n() is used if not).
+ * @param output Receives the formatted errors.
+ * @param size Size of output.
+ */
+static void parse_and_format(const char* script, bool terminated, char* output, size_t size) {
+    size_t length = strlen(script);
+    char*  source = (char*)malloc(terminated ? length + 1 : length);
+    memcpy(source, script, terminated ? length + 1 : length);
+
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+    if (terminated)
+        lexer_init(&lexer, source);
+    else
+        lexer_init_n(&lexer, source, length);
+    parser_init(&parser, &lexer);
+    while (parse_next_statement(&parser, &statement)) {
+        free_node(statement);
+    }
+    lexer_free(&lexer);
+    free(source);
+
+    parser_format_errors(&parser, output, size);
+    parser_free(&parser);
+}
+
+/**
+ * Parse the first statement of a script.
+ *
+ * @param script The script.
+ * @param statement Receives the statement (NULL if it has errors), freed by the caller.
+ * @return The number of errors reported.
+ */
+static int parse_first(const char* script, Node** statement) {
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    *statement = NULL;
+    parse_next_statement(&parser, statement);
+    int errors = parser.errors.error_count;
+    parser_free(&parser);
+    lexer_free(&lexer);
+    return errors;
+}
+
+/**
+ * A lone ! is reported with a message that does not point into the source.
+ */
+static bool test_lone_bang_outlives_source(void) {
+    char output[1024];
+    parse_and_format("ASK x FOR ! y;", true, output, sizeof(output));
+    if (strstr(output, "Unexpected character.") == NULL)
+        return false;
+
+    parse_and_format("ASK x FOR ! y;", false, output, sizeof(output));
+    return strstr(output, "Unexpected character.") != NULL;
+}
+
+/**
+ * Check the token types of a script.
+ *
+ * @param source The script.
+ * @param case_insensitive Whether keywords are matched regardless of case.
+ * @param expected The token types before TOKEN_EOF.
+ * @param count Number of expected types.
+ * @return true if the lexer produces exactly those tokens.
+ */
+static bool lexes_to(const char* source, bool case_insensitive, const NsqlTokenType* expected,
+                     size_t count) {
+    Lexer lexer;
+    lexer_init(&lexer, source);
+    lexer.case_insensitive = case_insensitive;
+
+    bool passed = true;
+    for (size_t i = 0; i <= count && passed; i++) {
+        Token token = lexer_next_token(&lexer);
+        passed      = token.type == (i < count ? expected[i] : TOKEN_EOF);
+    }
+    lexer_free(&lexer);
+    return passed;
+}
+
+/**
+ * Keywords of every length are recognized, and words that only share a prefix are names.
+ */
+static bool test_keywords_are_recognized(void) {
+    static const NsqlTokenType keywords[] = {
+        TOKEN_AS,     TOKEN_AND,     TOKEN_WITH,     TOKEN_WHERE,
+        TOKEN_HAVING, TOKEN_BETWEEN, TOKEN_TRAVERSE, TOKEN_TERMINATOR,
+    };
+    static const NsqlTokenType names[] = {
+        TOKEN_IDENTIFIER, TOKEN_IDENTIFIER, TOKEN_IDENTIFIER,
+        TOKEN_IDENTIFIER, TOKEN_IDENTIFIER, TOKEN_IDENTIFIER,
+    };
+    bool passed = lexes_to("AS AND WITH WHERE HAVING BETWEEN TRAVERSE PLEASE", false, keywords,
+                           sizeof(keywords) / sizeof(keywords[0]));
+    passed      = passed && lexes_to("A ASKS ANDY TRAVERSES where Where", false, names,
+                                     sizeof(names) / sizeof(names[0]));
+    return passed && lexes_to("as And with wHeRe having between Traverse please", true,
+                              keywords, sizeof(keywords) / sizeof(keywords[0]));
+}
+
+/**
+ * Runs of whitespace, strings and names of every length around the vector widths are scanned to
+ * their exact end, also when they end the buffer.
+ */
+static bool test_scanners_stop_at_run_end(void) {
+    bool passed = true;
+    for (size_t n = 1; n <= 80 && passed; n++) {
+        // n blanks with a newline every 7 bytes, x, a quoted string of n bytes with one newline,
+        // then a name of n bytes that ends the unterminated buffer
+        size_t length = n + 1 + n + 2 + n;
+        char*  source = (char*)malloc(length);
+        char*  p      = source;
+        int    lines  = 1;
+        size_t column = 0;
+        for (size_t i = 0; i < n; i++) {
+            bool newline = i % 7 == 6;
+            *p++         = newline ? '\n' : ' ';
+            lines        = newline ? lines + 1 : lines;
+            column       = newline ? 0 : column + 1;
+        }
+        *p++ = 'x';
+        *p++ = '\'';
+        for (size_t i = 0; i < n; i++) *p++ = i == n / 2 ? '\n' : 's';
+        *p++ = '\'';
+        for (size_t i = 0; i < n; i++) *p++ = (char)('a' + i % 26);
+
+        Lexer lexer;
+        lexer_init_n(&lexer, source, length);
+        Token x    = lexer_next_token(&lexer);
+        Token text = lexer_next_token(&lexer);
+        Token name = lexer_next_token(&lexer);
+        Token end  = lexer_next_token(&lexer);
+        passed     = x.type == TOKEN_IDENTIFIER && x.length == 1 && x.line == lines &&
+                 (size_t)x.column == column && text.type == TOKEN_STRING &&
+                 text.length == n + 2 && name.type == TOKEN_IDENTIFIER && name.length == n &&
+                 name.line == lines + 1 && end.type == TOKEN_EOF;
+        lexer_free(&lexer);
+        free(source);
+    }
+    return passed;
+}
+
+/**
+ * Find the start of a line by counting newlines from the start of a script.
+ *
+ * @param source The script.
+ * @param line The 1-based line.
+ * @return The first character of the line.
+ */
+static const char* line_start(const char* source, int line) {
+    for (int current = 1; current < line; current++) source = strchr(source, '\n') + 1;
+    return source;
+}
+
+/**
+ * Line starts and token columns agree with a count of newlines, with and without the line index,
+ * while scanning and after the end, across newlines in strings and comments.
+ */
+static bool test_line_index_matches_newlines(void) {
+    static const char script[] = "ASK t FOR a\n"
+                                 "  WHERE b = 'one\ntwo'  >> a comment\n"
+                                 "\n"
+                                 "\tAND c = 1;\n"
+                                 "SHOW ME d FROM e;";
+    static const int lines = 6;
+
+    bool passed = true;
+    for (int indexed = 0; indexed < 2 && passed; indexed++) {
+        Lexer lexer;
+        lexer_init(&lexer, script);
+        passed = !indexed || lexer_enable_line_index(&lexer);
+
+        Token token;
+        do {
+            token  = lexer_next_token(&lexer);
+            passed = passed && token.type != TOKEN_ERROR &&
+                     token.start - line_start(script, token.line) == token.column;
+            for (int line = 1; line <= token.line && passed; line++)
+                passed = lexer_get_line_start(&lexer, line) == line_start(script, line);
+        } while (token.type != TOKEN_EOF && passed);
+
+        for (int line = lines; line >= 1 && passed; line--)
+            passed = lexer_get_line_start(&lexer, line) == line_start(script, line);
+        lexer_free(&lexer);
+    }
+    return passed;
+}
+
+/**
+ * Build a script that repeats a piece of text.
+ *
+ * @param head Text before the repetitions.
+ * @param piece The repeated text.
+ * @param count Number of repetitions.
+ * @param tail Text after the repetitions.
+ * @return The script, owned by the caller.
+ */
+static char* repeat(const char* head, const char* piece, size_t count, const char* tail) {
+    size_t head_length  = strlen(head);
+    size_t piece_length = strlen(piece);
+    size_t tail_length  = strlen(tail);
+    char*  script       = (char*)malloc(head_length + count * piece_length + tail_length + 1);
+
+    char* p = script;
+    memcpy(p, head, head_length);
+    p += head_length;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(p, piece, piece_length);
+        p += piece_length;
+    }
+    memcpy(p, tail, tail_length + 1);
+    return script;
+}
+
+/**
+ * Serialize a tree and compare it with a serialized AST.
+ *
+ * @param node The tree.
+ * @param expected The serialized AST to compare with.
+ * @return true if the serialized tree has the same bytes.
+ */
+static bool serializes_to(Node* node, const SerializedAST* expected) {
+    SerializedAST* ast = ast_serialize(node, NULL);
+    size_t         size;
+    size_t         expected_size;
+    const void*    data          = ast_get_data(ast, &size);
+    const void*    expected_data = ast_get_data(expected, &expected_size);
+    bool           same = data && size == expected_size && memcmp(data, expected_data, size) == 0;
+
+    ast_free(ast);
+    return same;
+}
+
+/**
+ * Statements seen by a parse_program_stream() callback.
+ */
+typedef struct {
+    NodeType types[8];  // Type of each statement
+    int      lines[8];  // Line of each statement
+    size_t   count;     // Number of statements seen
+    size_t   stop_at;   // Count at which the callback stops the parse (0 = never)
+} StreamLog;
+
+/**
+ * Record a statement in a StreamLog.
+ *
+ * @param statement The statement.
+ * @param user_data The log.
+ * @return false once the log holds stop_at statements.
+ */
+static bool log_statement(Node* statement, void* user_data) {
+    StreamLog* log = (StreamLog*)user_data;
+    if (log->count < 8) {
+        log->types[log->count] = statement->type;
+        log->lines[log->count] = statement->line;
+    }
+    log->count++;
+    return log->count != log->stop_at;
+}
+
+/**
+ * A streamed parse hands over each statement that parses, skips the broken ones, recycles the
+ * arena and stops when the callback says so.
+ */
+static bool test_stream_skips_broken_statements(void) {
+    static const char script[] = "ASK a FOR x;\n"
+                                 "ASK b FOR ;\n"
+                                 "SHOW ME y FROM c;\n"
+                                 "TELL d TO UPDATE;\n"
+                                 "FIND e WHERE f = 1;\n";
+    static const NodeType types[] = {NODE_ASK_QUERY, NODE_SHOW_QUERY, NODE_FIND_QUERY};
+    static const int      lines[] = {1, 3, 5};
+
+    bool passed = true;
+    for (int use_arena = 0; use_arena < 2; use_arena++) {
+        for (size_t stop_at = 0; stop_at < 3; stop_at++) {
+            NsqlArena arena;
+            Lexer     lexer;
+            Parser    parser;
+            StreamLog log = {{0}, {0}, 0, stop_at};
+            arena_init(&arena, 0);
+            lexer_init(&lexer, script);
+            if (use_arena)
+                parser_init_with_arena(&parser, &lexer, &arena);
+            else
+                parser_init(&parser, &lexer);
+
+            // Each broken statement before the stop reports one error
+            size_t delivered = parse_program_stream(&parser, log_statement, &log);
+            size_t expected  = stop_at ? stop_at : 3;
+            passed           = passed && delivered == expected && log.count == expected &&
+                     parser.errors.error_count == (stop_at ? (int)stop_at - 1 : 2);
+            for (size_t i = 0; i < expected && passed; i++)
+                passed = log.types[i] == types[i] && log.lines[i] == lines[i];
+
+            parser_free(&parser);
+            lexer_free(&lexer);
+            arena_free(&arena);
+        }
+    }
+    return passed;
+}
+
+/**
+ * Nodes seen by a visitor, with an action to take at one node type.
+ */
+typedef struct {
+    int            types[32];   // Type of each node (-1 for an empty slot)
+    int            depths[32];  // Depth of each node
+    int            count;       // Number of nodes seen
+    NodeType       act_on;      // Type at which to return action
+    AstVisitAction action;      // What to return at act_on
+} VisitLog;
+
+/**
+ * Visitor callback that records each node in a VisitLog.
+ *
+ * @param frame The node.
+ * @param user_data The log.
+ * @return The log's action at its act_on type, AST_VISIT_CONTINUE otherwise.
+ */
+static AstVisitAction log_visit(const AstVisitFrame* frame, void* user_data) {
+    VisitLog* log = (VisitLog*)user_data;
+    if (log->count < 32) {
+        log->types[log->count]  = frame->node ? (int)frame->node->type : -1;
+        log->depths[log->count] = frame->depth;
+    }
+    log->count++;
+    return frame->node && frame->node->type == log->act_on ? log->action : AST_VISIT_CONTINUE;
+}
+
+/**
+ * The walk visits nodes in slot order, can skip subtrees, stop and show empty slots, and nesting
+ * deeper than the parser's limit is an error rather than a stack overflow.
+ */
+static bool test_walks_and_nesting_limit(void) {
+    static const int preorder[] = {
+        NODE_ASK_QUERY,   NODE_SOURCE,     NODE_IDENTIFIER,  NODE_FIELD_LIST, NODE_IDENTIFIER,
+        NODE_BINARY_EXPR, NODE_IDENTIFIER, NODE_BINARY_EXPR, NODE_LITERAL,    NODE_LITERAL,
+    };
+    static const int depths[] = {0, 1, 2, 1, 2, 1, 2, 2, 3, 3};
+    Node*            statement;
+    bool             passed = parse_first("ASK t FOR a WHERE b = 1 + 2;", &statement) == 0;
+
+    VisitLog   log     = {{0}, {0}, 0, NODE_ERROR, AST_VISIT_CONTINUE};
+    AstVisitor visitor = {log_visit, NULL, &log, false};
+    passed             = passed && ast_visit(statement, &visitor) && log.count == 10;
+    for (int i = 0; i < 10 && passed; i++)
+        passed = log.types[i] == preorder[i] && log.depths[i] == depths[i];
+
+    // Skipping the field list leaves out its name, and post callbacks come children first
+    log                = (VisitLog){{0}, {0}, 0, NODE_FIELD_LIST, AST_VISIT_SKIP};
+    visitor.pre        = NULL;
+    visitor.post       = log_visit;
+    passed             = passed && ast_visit(statement, &visitor) && log.count == 10 &&
+             log.types[0] == NODE_IDENTIFIER && log.types[9] == NODE_ASK_QUERY;
+    log                = (VisitLog){{0}, {0}, 0, NODE_FIELD_LIST, AST_VISIT_SKIP};
+    visitor.pre        = log_visit;
+    visitor.post       = NULL;
+    passed             = passed && ast_visit(statement, &visitor) && log.count == 9;
+    log                = (VisitLog){{0}, {0}, 0, NODE_LITERAL, AST_VISIT_STOP};
+    passed             = passed && !ast_visit(statement, &visitor) && log.count == 9;
+
+    // Empty slots: the join of the source, GROUP BY, ORDER BY and LIMIT
+    log                = (VisitLog){{0}, {0}, 0, NODE_ERROR, AST_VISIT_CONTINUE};
+    visitor.visit_null = true;
+    passed             = passed && ast_visit(statement, &visitor) && log.count == 14 &&
+             log.types[3] == -1 && log.types[13] == -1;
+    free_node(statement);
+
+    char* nested = repeat("ASK t FOR a WHERE b = ", "(", NSQL_MAX_EXPRESSION_DEPTH + 1, "1");
+    char* closed = repeat(nested, ")", NSQL_MAX_EXPRESSION_DEPTH + 1, ";");
+    char  output[1024];
+    parse_and_format(closed, true, output, sizeof(output));
+    passed = passed && strstr(output, "Expression nested too deeply") != NULL;
+    free(closed);
+    free(nested);
+
+    nested = repeat("ASK t FOR a WHERE b = ", "(", NSQL_MAX_EXPRESSION_DEPTH / 2, "1");
+    closed = repeat(nested, ")", NSQL_MAX_EXPRESSION_DEPTH / 2, ";");
+    passed = passed && parse_first(closed, &statement) == 0 && statement != NULL;
+    free_node(statement);
+    free(closed);
+    free(nested);
+    return passed;
+}
+
+/**
+ * A long arithmetic chain is a deep left-leaning tree, which is cloned, pooled, serialized and
+ * decoded without recursion.
+ */
+static bool test_deep_chain_round_trips(void) {
+    char*  script = repeat("ASK t FOR a WHERE x = 1", " + 1", DEEP_TERMS, ";");
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement = NULL;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    parse_next_statement(&parser, &statement);
+
+    bool passed = statement != NULL && !parser.had_error;
+    if (passed) {
+        SerializedAST* ast = ast_serialize(statement, NULL);
+        size_t         size;
+        const void*    data = ast_get_data(ast, &size);
+
+        Node* clone = ast_clone(statement);
+        passed      = serializes_to(clone, ast);
+        free_node(clone);
+
+        SerializedAST* read    = ast_deserialize(data, size);
+        Node*          decoded = ast_decode(read);
+        passed                 = passed && decoded != NULL && serializes_to(decoded, ast);
+        free_node(decoded);
+        ast_free(read);
+
+        AstPool pool;
+        ast_pool_init(&pool);
+        Node* pooled = ast_pool_to_node(&pool, ast_pool_add(&pool, statement));
+        passed       = passed && pooled != NULL && serializes_to(pooled, ast);
+        free_node(pooled);
+        ast_pool_free(&pool);
+        ast_free(ast);
+    }
+
+    free_node(statement);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(script);
+    return passed;
+}
+
+/**
+ * A long chain of joined sources counts toward the nesting limit.
+ */
+static bool test_join_chain_is_limited(void) {
+    char* script = repeat("ASK a", " AND b", DEEP_TERMS, " FOR x;");
+    char  output[1024];
+    parse_and_format(script, true, output, sizeof(output));
+    free(script);
+    return strstr(output, "Expression nested too deeply") != NULL;
+}
+
+/**
+ * A parse into an arena builds the same tree as a parse with malloc, and a reset arena is reused.
+ */
+static bool test_arena_parse_matches_malloc(void) {
+    Node*          statement;
+    bool           passed   = parse_first(SAMPLE_QUERY, &statement) == 0;
+    SerializedAST* expected = passed ? ast_serialize(statement, NULL) : NULL;
+    free_node(statement);
+
+    // Chunks far smaller than the tree, so it spans several of them
+    NsqlArena arena;
+    arena_init(&arena, 128);
+    size_t first_size = 0;
+    for (int round = 0; round < 2 && passed; round++) {
+        Lexer  lexer;
+        Parser parser;
+        lexer_init(&lexer, SAMPLE_QUERY);
+        parser_init_with_arena(&parser, &lexer, &arena);
+        passed = parse_next_statement(&parser, &statement) && !parser.had_error &&
+                 serializes_to(statement, expected);
+        parser_free(&parser);
+        lexer_free(&lexer);
+
+        if (round == 0)
+            first_size = arena_size(&arena);
+        passed = passed && first_size > 0 && arena_size(&arena) == first_size;
+        arena_reset(&arena);
+    }
+    arena_free(&arena);
+    ast_free(expected);
+    return passed && arena_size(&arena) == 0;
+}
+
+/**
+ * A zero-copy parse points names into the source, and its clone outlives the source.
+ */
+static bool test_zero_copy_clone_outlives_source(void) {
+    Node*          statement;
+    bool           passed   = parse_first(SAMPLE_QUERY, &statement) == 0;
+    SerializedAST* expected = passed ? ast_serialize(statement, NULL) : NULL;
+    free_node(statement);
+
+    size_t length = strlen(SAMPLE_QUERY);
+    char*  source = (char*)malloc(length + 1);
+    memcpy(source, SAMPLE_QUERY, length + 1);
+
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, source);
+    parser_init(&parser, &lexer);
+    parser.zero_copy = true;
+    statement        = NULL;
+    passed           = passed && parse_next_statement(&parser, &statement) && !parser.had_error;
+
+    // The table name is a view into the source, not a copy
+    Node* table = passed ? statement->as.ask_query.source->as.source.identifier : NULL;
+    passed      = passed && (table->flags & NODE_FLAG_BORROWED) &&
+             table->as.identifier.name == strstr(source, "customers") &&
+             serializes_to(statement, expected);
+
+    Node* clone = ast_clone(statement);
+    free_node(statement);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(source);
+
+    passed = passed && clone != NULL && serializes_to(clone, expected) &&
+             !(clone->as.ask_query.source->as.source.identifier->flags & NODE_FLAG_BORROWED);
+    free_node(clone);
+    ast_free(expected);
+    return passed;
+}
+
+/**
+ * Check that a tree serializes like the parse of a query.
+ *
+ * @param node The tree (freed).
+ * @param query The query.
+ * @return true if both serialize to the same bytes.
+ */
+static bool same_as_parse(Node* node, const char* query) {
+    Node*          statement;
+    bool           parsed   = parse_first(query, &statement) == 0;
+    SerializedAST* expected = parsed ? ast_serialize(statement, NULL) : NULL;
+    bool           same     = node != NULL && expected != NULL && serializes_to(node, expected);
+    ast_free(expected);
+    free_node(statement);
+    free_node(node);
+    return same;
+}
+
+/**
+ * Queries that differ in literals and spacing share a cache entry, yet each instance holds its
+ * own literals; other shapes miss and evict the least recently used entry.
+ */
+static bool test_query_cache_shares_shapes(void) {
+    static const char first[]  = "ASK t FOR a WHERE b = 1 AND c = 'x';";
+    static const char second[] = "ASK  t FOR a\tWHERE b = 25 AND c = 'hello'  ;";
+    QueryCache*       cache    = query_cache_create(2);
+    QueryCacheResult  a;
+    QueryCacheResult  b;
+    QueryCacheResult  c;
+
+    bool passed = query_cache_lookup(cache, first, &a) && !a.hit;
+    passed      = passed && query_cache_lookup(cache, second, &b) && b.hit && b.entry == a.entry &&
+             b.literal_count == 2 && b.literals[0].number == 25 &&
+             b.literals[1].length == 5 && memcmp(b.literals[1].text, "hello", 5) == 0;
+    passed = passed && same_as_parse(query_cache_instantiate(&a), first) &&
+             same_as_parse(query_cache_instantiate(&b), second);
+    query_cache_release(&b);
+
+    // LIMIT counts are part of the shape, and a third shape evicts the first. Queries that do not
+    // parse are misses that cache nothing
+    passed = passed && query_cache_lookup(cache, "ASK t FOR a LIMIT 1;", &b) && !b.hit;
+    query_cache_release(&b);
+    passed = passed && query_cache_lookup(cache, "ASK t FOR a LIMIT 2;", &b) && !b.hit;
+    query_cache_release(&b);
+    passed = passed && !query_cache_lookup(cache, "ASK t FOR ;", &c) &&
+             !query_cache_lookup(cache, "ASK t FOR a; ASK t FOR b;", &c);
+
+    QueryCacheStats stats;
+    query_cache_stats(cache, &stats);
+    passed = passed && stats.hits == 1 && stats.misses == 5 && stats.evictions == 1 &&
+             stats.entries == 2;
+
+    // A held result outlives its evicted entry and the cache
+    query_cache_destroy(cache);
+    passed = passed && same_as_parse(query_cache_instantiate(&a), first);
+    query_cache_release(&a);
+    return passed;
+}
+
+/**
+ * Parse the condition of an ASK query.
+ *
+ * @param condition The condition text.
+ * @param statement Receives the statement, freed by the caller.
+ * @return The condition (NULL if the query has errors).
+ */
+static Node* parse_condition_of(const char* condition, Node** statement) {
+    char* script = repeat("ASK t FOR a WHERE ", condition, 1, ";");
+    parse_first(script, statement);
+    free(script);
+    return *statement ? (*statement)->as.ask_query.condition : NULL;
+}
+
+/**
+ * AND and OR chains become one node per operator with the operands in source order, AND binding
+ * tighter, and IN lists hold their items in one node.
+ */
+static bool test_chains_are_flattened(void) {
+    Node* statement;
+    Node* condition = parse_condition_of("a = 1 AND b = 2 AND c = 3 AND d = 4", &statement);
+    bool  passed    = condition != NULL && condition->type == NODE_LOGICAL_EXPR &&
+                  condition->as.logical_expr.op == TOKEN_AND &&
+                  condition->as.logical_expr.count == 4;
+    if (passed) {
+        Node* last = condition->as.logical_expr.operands[3]->as.binary_expr.left;
+        passed     = last->as.identifier.length == 1 && last->as.identifier.name[0] == 'd';
+    }
+    free_node(statement);
+
+    condition = parse_condition_of("a = 1 OR b = 2 AND c = 3 OR d = 4", &statement);
+    passed    = passed && condition != NULL && condition->type == NODE_LOGICAL_EXPR &&
+             condition->as.logical_expr.op == TOKEN_OR && condition->as.logical_expr.count == 3 &&
+             condition->as.logical_expr.operands[1]->type == NODE_LOGICAL_EXPR &&
+             condition->as.logical_expr.operands[1]->as.logical_expr.count == 2;
+    free_node(statement);
+
+    // A single comparison stays a binary expression
+    condition = parse_condition_of("a = 1", &statement);
+    passed    = passed && condition != NULL && condition->type == NODE_BINARY_EXPR;
+    free_node(statement);
+
+    condition = parse_condition_of("x IN (1, 2, 'three', 4, ?)", &statement);
+    passed    = passed && condition != NULL && condition->type == NODE_IN_LIST &&
+             condition->as.in_list.value->type == NODE_IDENTIFIER &&
+             condition->as.in_list.count == 5 &&
+             condition->as.in_list.items[2]->as.literal.literal_type == TOKEN_STRING &&
+             condition->as.in_list.items[4]->type == NODE_PARAMETER;
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * Parse the first statement of an ASK query and get its condition after optimization.
+ *
+ * @param script The script.
+ * @param statement Receives the statement, freed by the caller.
+ * @return The condition (NULL if it was dropped).
+ */
+static Node* optimized_condition(const char* script, Node** statement) {
+    parse_first(script, statement);
+    ast_optimize(*statement, false);
+    return *statement ? (*statement)->as.ask_query.condition : NULL;
+}
+
+/**
+ * The optimizer folds only what every executor computes the same way, and keeps placeholders.
+ */
+static bool test_optimizer_is_conservative(void) {
+    Node* statement;
+    Node* condition;
+    bool  passed = true;
+
+    // Integer arithmetic folds into an always true condition, which is dropped
+    condition = optimized_condition("ASK x FOR a IF 1 + 2 = 3;", &statement);
+    passed    = passed && statement != NULL && condition == NULL;
+    free_node(statement);
+
+    // 0.1 + 0.2 is not 0.3 in a double, so decimals are left alone
+    condition = optimized_condition("ASK x FOR a IF 0.1 + 0.2 = 0.3;", &statement);
+    passed    = passed && condition != NULL && condition->type == NODE_BINARY_EXPR;
+    free_node(statement);
+
+    // A chain decided by a constant still holds its placeholder
+    condition = optimized_condition("ASK x FOR a IF ? = 1 AND 0;", &statement);
+    passed    = passed && condition != NULL && condition->type == NODE_LOGICAL_EXPR;
+    free_node(statement);
+
+    // name may be a string, so 5 + name keeps its order, while a product of numbers is turned
+    condition = optimized_condition("ASK x FOR a IF 5 + name = 1 AND 2 * (a - b) = 1;", &statement);
+    if (condition != NULL && condition->type == NODE_LOGICAL_EXPR &&
+        condition->as.logical_expr.count == 2) {
+        Node* sum     = condition->as.logical_expr.operands[0]->as.binary_expr.left;
+        Node* product = condition->as.logical_expr.operands[1]->as.binary_expr.left;
+        passed        = passed && sum->as.binary_expr.left->type == NODE_LITERAL &&
+                 product->as.binary_expr.right->type == NODE_LITERAL;
+    } else {
+        passed = false;
+    }
+    free_node(statement);
+
+    return passed;
+}
+
+/**
+ * Constants are folded, known operands of AND and OR removed and literals moved to the right, and
+ * folding stops where the result would depend on how an executor computes it.
+ */
+static bool test_optimizer_folds_constants(void) {
+    static const char* const cases[][2] = {
+        {"ASK x FOR a IF credit_limit + 500 * 2 > 10;", "ASK x FOR a IF credit_limit + 1000 > 10;"},
+        {"ASK x FOR a IF 5 < age;", "ASK x FOR a IF age > 5;"},
+        {"ASK x FOR a IF NOT NOT active AND b = 1;", "ASK x FOR a IF active AND b = 1;"},
+        {"ASK x FOR a IF b = 1 AND 2 > 1 AND c = 2;", "ASK x FOR a IF b = 1 AND c = 2;"},
+        {"ASK x FOR a IF b = 1 AND 'a' = 'b';", "ASK x FOR a IF 0;"},
+        {"ASK x FOR a IF b = 6 / 3;", "ASK x FOR a IF b = 2;"},
+        {"ASK x FOR a IF b = 6 / 4;", "ASK x FOR a IF b = 6 / 4;"},
+        {"ASK x FOR a IF b = 2147483647 + 1;", "ASK x FOR a IF b = 2147483647 + 1;"},
+    };
+    bool passed = true;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && passed; i++) {
+        Node* statement;
+        optimized_condition(cases[i][0], &statement);
+        passed = same_as_parse(statement, cases[i][1]);
+
+        // What is left cannot be simplified any further
+        Node* optimized = NULL;
+        passed = passed && parse_first(cases[i][1], &optimized) == 0 &&
+                 ast_optimize(optimized, false) == 0;
+        free_node(optimized);
+    }
+    return passed;
+}
+
+/**
+ * Check that a serialized plan decodes to the tree of a query.
+ *
+ * @param plan The plan.
+ * @param query The query.
+ * @return true if the decoded plan serializes like the parsed query.
+ */
+static bool plan_is(const SerializedAST* plan, const char* query) {
+    size_t         size;
+    const void*    data = plan ? ast_get_data(plan, &size) : NULL;
+    SerializedAST* read = data ? ast_deserialize(data, size) : NULL;
+    bool           same = read != NULL && same_as_parse(ast_decode(read), query);
+    ast_free(read);
+    return same;
+}
+
+/**
+ * Placeholders bind to literals and counts in both the tree and the plan, can be rebound, and
+ * reject values of the wrong kind.
+ */
+static bool test_prepared_statements_bind(void) {
+    PreparedStatement* stmt =
+        nsql_prepare("ASK t FOR a WHERE b = ? AND c = ? LIMIT ? OFFSET ?;", NULL);
+    bool passed = stmt != NULL && nsql_prepared_parameter_count(stmt) == 4 &&
+                  nsql_execute_prepared(stmt) == NULL;
+
+    passed = passed && nsql_bind_integer(stmt, 0, 7) && nsql_bind_string(stmt, 1, "bob", 3) &&
+             nsql_bind_integer(stmt, 2, 10) && !nsql_bind_decimal(stmt, 3, 1.5) &&
+             !nsql_bind_integer(stmt, 3, -1) && !nsql_bind_integer(stmt, 4, 1) &&
+             nsql_execute_prepared(stmt) == NULL && nsql_bind_integer(stmt, 3, 5);
+    passed = passed && same_as_parse(ast_clone(nsql_prepared_ast(stmt)),
+                                     "ASK t FOR a WHERE b = 7 AND c = 'bob' LIMIT 10 OFFSET 5;") &&
+             plan_is(nsql_execute_prepared(stmt),
+                     "ASK t FOR a WHERE b = 7 AND c = 'bob' LIMIT 10 OFFSET 5;");
+
+    // Rebinding changes kind and length
+    passed = passed && nsql_bind_string(stmt, 0, "seven", 5) && nsql_bind_decimal(stmt, 1, 2.5) &&
+             plan_is(nsql_execute_prepared(stmt),
+                     "ASK t FOR a WHERE b = 'seven' AND c = 2.5 LIMIT 10 OFFSET 5;");
+    nsql_prepared_free(stmt);
+
+    ErrorContext errors;
+    error_context_init(&errors);
+    passed = passed && nsql_prepare("ASK t FOR ;", &errors) == NULL && errors.error_count == 1;
+    error_context_free(&errors);
+    return passed && nsql_prepare("ASK t FOR a; ASK t FOR b;", NULL) == NULL;
+}
+
+/**
+ * Check the string of a node read from a serialized AST.
+ *
+ * @param reader The reader.
+ * @param node Offset of the node.
+ * @param expected The expected string.
+ * @return true if the node has that string.
+ */
+static bool reads_string(const AstReader* reader, size_t node, const char* expected) {
+    const char* str;
+    size_t      length;
+    return node != AST_READER_NULL && ast_reader_string(reader, node, &str, &length) &&
+           length == strlen(expected) && memcmp(str, expected, length) == 0;
+}
+
+/**
+ * The reader walks a serialized statement in place, and rejects damaged or truncated buffers.
+ */
+static bool test_reader_walks_in_place(void) {
+    Node*             statement;
+    bool              passed   = parse_first(SAMPLE_QUERY, &statement) == 0;
+    ExecutionMetadata metadata = {HINT_INDEX_SCAN, 7, ENGINE_SQL, 100, 250, "by_name"};
+    SerializedAST*    ast      = passed ? ast_serialize(statement, &metadata) : NULL;
+    size_t            size;
+    const void*       data = ast ? ast_get_data(ast, &size) : NULL;
+
+    AstReader reader;
+    passed      = data != NULL && ast_reader_init(&reader, data, size, true);
+    size_t root = passed ? ast_reader_root(&reader) : AST_READER_NULL;
+    passed      = passed && ast_reader_type(&reader, root) == NODE_ASK_QUERY &&
+             ast_reader_child_count(&reader, root) == 6;
+    if (passed) {
+        size_t source    = ast_reader_child(&reader, root, 0);
+        size_t fields    = ast_reader_child(&reader, root, 1);
+        size_t condition = ast_reader_child(&reader, root, 2);
+        size_t order_by  = ast_reader_child(&reader, root, 4);
+        size_t limit     = ast_reader_child(&reader, root, 5);
+        int    count     = 0;
+        int    offset    = -1;
+        ast_reader_limit(&reader, limit, &count, &offset);
+        passed = reads_string(&reader, source, "customers") &&
+                 ast_reader_child_count(&reader, fields) == 2 &&
+                 reads_string(&reader, ast_reader_child(&reader, fields, 1), "email") &&
+                 ast_reader_operator(&reader, condition) == TOKEN_AND &&
+                 ast_reader_child(&reader, root, 3) == AST_READER_NULL &&
+                 !ast_reader_ascending(&reader, order_by, 0) && count == 10 && offset == 0;
+
+        ExecutionMetadata read;
+        size_t            target_length;
+        ast_reader_metadata(&reader, &read, &target_length);
+        passed = passed && read.priority == 7 && read.estimated_rows == 100 &&
+                 target_length == 7 && memcmp(read.target_index, "by_name", 7) == 0;
+
+        Node* condition_tree = ast_reader_materialize(&reader, condition);
+        passed = passed && condition_tree != NULL && condition_tree->type == NODE_LOGICAL_EXPR &&
+                 condition_tree->as.logical_expr.count == 2;
+        free_node(condition_tree);
+        passed = passed && same_as_parse(ast_reader_materialize(&reader, root), SAMPLE_QUERY);
+    }
+
+    // A flipped byte fails the checksum, and a short buffer fails the structure checks
+    if (passed) {
+        unsigned char* copy = (unsigned char*)malloc(size);
+        memcpy(copy, data, size);
+        copy[size / 2] ^= 0x40;
+        passed = !ast_reader_init(&reader, copy, size, true) &&
+                 !ast_reader_init(&reader, data, size - 1, false) &&
+                 !ast_reader_init(&reader, data, AST_HEADER_SIZE - 1, false);
+        free(copy);
+    }
+    ast_free(ast);
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * Any statement of a serialized program is reached directly by its index, in any order.
+ */
+static bool test_reader_random_access(void) {
+    char*  script = repeat("", "ASK t FOR a WHERE b = 1 OR c IN (1, 2, 3);\nFIND u;\n", 500, "");
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node*          program = parse_program(&parser);
+    SerializedAST* ast     = ast_serialize(program, NULL);
+    size_t         size;
+    const void*    data = ast_get_data(ast, &size);
+
+    AstReader reader;
+    bool      passed = ast_reader_init(&reader, data, size, true) && reader.version == AST_VERSION;
+    size_t    root   = passed ? ast_reader_root(&reader) : AST_READER_NULL;
+    passed           = passed && ast_reader_child_count(&reader, root) == 1000 &&
+             ast_reader_child(&reader, root, 1000) == AST_READER_NULL;
+    for (size_t i = 1000; i-- > 0 && passed;) {
+        size_t   statement = ast_reader_child(&reader, root, i);
+        NodeType type      = i % 2 ? NODE_FIND_QUERY : NODE_ASK_QUERY;
+        passed             = ast_reader_type(&reader, statement) == type &&
+                 ast_reader_line(&reader, statement) == (int)i + 1 &&
+                 reads_string(&reader, ast_reader_child(&reader, statement, 0), i % 2 ? "u" : "t");
+    }
+
+    ast_free(ast);
+    free_node(program);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(script);
+    return passed;
+}
+
+/**
+ * Compute a CRC-32 bit by bit.
+ *
+ * @param polynomial The reflected polynomial.
+ * @param data The data.
+ * @param length Length of data in bytes.
+ * @return The checksum.
+ */
+static uint32_t reference_crc(uint32_t polynomial, const unsigned char* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) crc = (crc >> 1) ^ (polynomial & (0 - (crc & 1)));
+    }
+    return ~crc;
+}
+
+/**
+ * Check the checksum of serialized data.
+ *
+ * @param data The data.
+ * @param size Size of data in bytes.
+ * @return true if the data deserializes and its checksum is valid.
+ */
+static bool checksum_is_valid(const void* data, size_t size) {
+    SerializedAST* ast   = ast_deserialize(data, size);
+    bool           valid = ast != NULL && ast_verify_checksum(ast);
+    ast_free(ast);
+    return valid;
+}
+
+/**
+ * Serialized ASTs of every length carry a CRC-32C of their payload, legacy CRC-32 payloads still
+ * verify, and a damaged payload or unknown algorithm does not.
+ */
+static bool test_checksums_match_reference(void) {
+    static const uint32_t crc32c = 0x82F63B78;
+    static const uint32_t crc32  = 0xEDB88320;
+
+    bool passed = reference_crc(crc32c, (const unsigned char*)"123456789", 9) == 0xE3069283;
+
+    for (size_t n = 1; n <= 100 && passed; n++) {
+        char* script = repeat("ASK t FOR a WHERE x IN (1", ", 'ab'", n, ");");
+        Node* statement;
+        passed             = parse_first(script, &statement) == 0;
+        SerializedAST* ast = passed ? ast_serialize(statement, NULL) : NULL;
+        free_node(statement);
+        free(script);
+        if (ast == NULL)
+            return false;
+
+        size_t         size;
+        const void*    data = ast_get_data(ast, &size);
+        unsigned char* copy = (unsigned char*)malloc(size);
+        uint32_t       header[AST_HEADER_SIZE / sizeof(uint32_t)];
+        memcpy(copy, data, size);
+        memcpy(header, data, AST_HEADER_SIZE);
+        const unsigned char* payload  = copy + AST_HEADER_SIZE;
+        size_t               length   = size - AST_HEADER_SIZE;
+        uint32_t             expected = reference_crc(crc32c, payload, length);
+        passed = header[2] == AST_CHECKSUM_CRC32C && header[5] == expected;
+
+        // CRC-32 is the algorithm of older blobs
+        header[2] = AST_CHECKSUM_CRC32;
+        header[5] = reference_crc(crc32, payload, length);
+        memcpy(copy, header, AST_HEADER_SIZE);
+        passed = passed && checksum_is_valid(copy, size);
+
+        copy[size - 1] ^= 1;
+        passed = passed && !checksum_is_valid(copy, size);
+        copy[size - 1] ^= 1;
+        header[2] = 7;
+        memcpy(copy, header, AST_HEADER_SIZE);
+        passed = passed && !checksum_is_valid(copy, size);
+
+        free(copy);
+        ast_free(ast);
+    }
+    return passed;
+}
+
+/**
+ * Read the header word of serialized data that names its codec.
+ *
+ * @param ast The serialized AST.
+ * @param size Receives the size of the data.
+ * @return The codec.
+ */
+static uint32_t codec_of(const SerializedAST* ast, size_t* size) {
+    uint32_t codec;
+    memcpy(&codec, (const unsigned char*)ast_get_data(ast, size) + 24, sizeof(codec));
+    return codec;
+}
+
+/**
+ * Large payloads shrink under LZ4 and decompress to the same tree with the same metadata, a
+ * damaged compressed payload fails its checksum, and payloads below the threshold are stored as
+ * they are.
+ */
+static bool test_compression_round_trips(void) {
+    char*  script = repeat("", SAMPLE_QUERY "\n", 200, "");
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node*             program  = parse_program(&parser);
+    ExecutionMetadata metadata = {HINT_READ_ONLY, 9, ENGINE_NOSQL, 5, 100, NULL};
+    SerializedAST*    ast      = ast_serialize(program, &metadata);
+    SerializedAST*    expected = ast_serialize(program, NULL);
+    SerializedAST*    packed   = ast_compress(ast, AST_CODEC_LZ4);
+    size_t            size;
+    size_t            packed_size;
+    bool              passed = packed != NULL && codec_of(ast, &size) == AST_CODEC_NONE &&
+                  codec_of(packed, &packed_size) == AST_CODEC_LZ4 && packed_size < size * 3 / 4;
+
+    // The metadata block stays readable without decompressing, but the reader needs plain data
+    ExecutionMetadata read;
+    AstReader         reader;
+    const void*       data = ast_get_data(packed, NULL);
+    passed = passed && ast_extract_metadata(packed, &read) && read.priority == 9 &&
+             !ast_reader_init(&reader, data, packed_size, true);
+
+    SerializedAST* unpacked = passed ? ast_deserialize(data, packed_size) : NULL;
+    Node*          decoded  = unpacked ? ast_decode(unpacked) : NULL;
+    passed = passed && ast_verify_checksum(unpacked) && ast_extract_metadata(unpacked, &read) &&
+             read.engine_type == ENGINE_NOSQL && decoded != NULL &&
+             serializes_to(decoded, expected);
+    free_node(decoded);
+    ast_free(unpacked);
+
+    if (passed) {
+        unsigned char* copy = (unsigned char*)malloc(packed_size);
+        memcpy(copy, data, packed_size);
+        copy[packed_size - 1] ^= 1;
+        passed = !checksum_is_valid(copy, packed_size);
+        free(copy);
+    }
+    ast_free(packed);
+    ast_free(expected);
+    ast_free(ast);
+    free_node(program);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(script);
+
+    Node* statement;
+    parse_first("FIND t;", &statement);
+    ast    = ast_serialize(statement, NULL);
+    packed = ast ? ast_compress(ast, AST_CODEC_LZ4) : NULL;
+    passed = passed && packed != NULL && codec_of(packed, &packed_size) == AST_CODEC_NONE &&
+             checksum_is_valid(ast_get_data(packed, NULL), packed_size);
+    ast_free(packed);
+    ast_free(ast);
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * Serialize a script and open a reader on it.
+ *
+ * @param script The script.
+ * @param reader Receives the reader.
+ * @return The serialized program (free with ast_free()), NULL if the script has errors.
+ */
+static SerializedAST* read_program(const char* script, AstReader* reader) {
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node*          program = parse_program(&parser);
+    SerializedAST* ast     = parser.had_error ? NULL : ast_serialize(program, NULL);
+    size_t         size;
+    const void*    data = ast ? ast_get_data(ast, &size) : NULL;
+    if (data == NULL || !ast_reader_init(reader, data, size, true)) {
+        ast_free(ast);
+        ast = NULL;
+    }
+    free_node(program);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    return ast;
+}
+
+/**
+ * Each distinct string is stored once, however often the statements repeat it.
+ */
+static bool test_strings_are_stored_once(void) {
+    char*          script = repeat("", SAMPLE_QUERY "\n", 100, "");
+    AstReader      once;
+    AstReader      repeated;
+    SerializedAST* single = read_program(SAMPLE_QUERY, &once);
+    SerializedAST* many   = read_program(script, &repeated);
+    bool           passed = single != NULL && many != NULL && once.strings_size > 0 &&
+                  repeated.strings_size == once.strings_size;
+
+    // The name of every table is the same view into the string table
+    const char* first  = NULL;
+    size_t      length = 0;
+    size_t      root   = passed ? ast_reader_root(&repeated) : AST_READER_NULL;
+    for (size_t i = 0; i < 100 && passed; i++) {
+        size_t      source = ast_reader_child(&repeated, ast_reader_child(&repeated, root, i), 0);
+        const char* name;
+        passed = ast_reader_string(&repeated, source, &name, &length) && length == 9 &&
+                 (first == NULL || name == first);
+        first  = name;
+    }
+    ast_free(single);
+    ast_free(many);
+    free(script);
+    return passed;
+}
+
+/**
+ * A batch holds one frame per tree with the bytes ast_serialize() gives it, and a fixed buffer
+ * stops at the last frame that fits.
+ */
+static bool test_batch_frames_match_single(void) {
+    static const char* const queries[] = {
+        SAMPLE_QUERY,
+        "FIND t;",
+        "SHOW ME a FROM b WHERE c = ?;",
+    };
+    Node*             roots[3];
+    ExecutionMetadata metadata[3];
+    size_t            frames[3];
+    bool              passed = true;
+    for (size_t i = 0; i < 3; i++) {
+        passed      = parse_first(queries[i], &roots[i]) == 0 && passed;
+        metadata[i] = ast_create_metadata(roots[i]);
+    }
+    metadata[1].priority = 200;
+
+    AstBatchBuffer buffer;
+    ast_batch_buffer_init(&buffer);
+    size_t total = 0;
+    passed       = passed && ast_serialize_batch(roots, 3, metadata, &buffer) == 3;
+    for (size_t i = 0; i < 3 && passed; i++) {
+        SerializedAST* ast = ast_serialize(roots[i], &metadata[i]);
+        size_t         size;
+        const void*    data  = ast_get_data(ast, &size);
+        const char*    frame = (const char*)buffer.data + total;
+        frames[i]            = ast_frame_size(frame, buffer.size - total);
+        passed               = frames[i] == size && memcmp(frame, data, size) == 0;
+        total += size;
+        ast_free(ast);
+    }
+    passed = passed && total == buffer.size;
+
+    // Room for the first two frames and part of the third
+    char*          memory = (char*)malloc(total);
+    AstBatchBuffer fixed;
+    ast_batch_buffer_init_fixed(&fixed, memory, total - 1);
+    passed = passed && ast_serialize_batch(roots, 3, metadata, &fixed) == 2 &&
+             fixed.size == frames[0] + frames[1] && memcmp(memory, buffer.data, fixed.size) == 0;
+    ast_batch_buffer_free(&fixed);
+    free(memory);
+
+    // A reused buffer is overwritten from its start
+    passed = passed && ast_serialize_batch(roots + 1, 1, metadata + 1, &buffer) == 1 &&
+             buffer.size == frames[1];
+    ast_batch_buffer_free(&buffer);
+    for (size_t i = 0; i < 3; i++) free_node(roots[i]);
+    return passed;
+}
+
+/**
+ * Visitor callback that marks the type of each node as seen.
+ *
+ * @param frame The node.
+ * @param user_data Array of flags indexed by NodeType.
+ * @return AST_VISIT_CONTINUE.
+ */
+static AstVisitAction mark_type(const AstVisitFrame* frame, void* user_data) {
+    ((bool*)user_data)[frame->node->type] = true;
+    return AST_VISIT_CONTINUE;
+}
+
+/**
+ * Check that a tree survives serialization, decoding, cloning and pooling unchanged.
+ *
+ * @param node The tree.
+ * @return true if every copy serializes to the same bytes.
+ */
+static bool round_trips(Node* node) {
+    SerializedAST* ast = ast_serialize(node, NULL);
+    size_t         size;
+    const void*    data   = ast_get_data(ast, &size);
+    SerializedAST* read   = data ? ast_deserialize(data, size) : NULL;
+    Node*          copies[3];
+    copies[0] = read ? ast_decode(read) : NULL;
+    copies[1] = ast_clone(node);
+
+    AstPool pool;
+    ast_pool_init(&pool);
+    copies[2] = ast_pool_to_node(&pool, ast_pool_add(&pool, node));
+    ast_pool_free(&pool);
+
+    bool passed = ast != NULL;
+    for (int i = 0; i < 3; i++) {
+        passed = passed && copies[i] != NULL && serializes_to(copies[i], ast);
+        free_node(copies[i]);
+    }
+    ast_free(read);
+    ast_free(ast);
+    return passed;
+}
+
+/**
+ * Every node type serializes and decodes back to the same tree.
+ */
+static bool test_every_node_type_round_trips(void) {
+    static const char script[] =
+        "ASK orders WITH customers WHERE customer_id = id FOR name, total\n"
+        "WHERE NOT total > -5 AND status IN ('a', 'b') OR SUM(total) >= ?\n"
+        "GROUP BY name HAVING COUNT(id) > 1 ORDER BY name DESC, total LIMIT ? OFFSET 5;\n"
+        "TELL t TO ADD 'Ada' WITH name, email;\n"
+        "TELL t TO REMOVE;\n"
+        "TELL t TO UPDATE status = 'VIP', credit = credit + 500 IF id = 42;\n"
+        "TELL db TO CREATE id AS int (REQUIRED, UNIQUE), credit AS decimal (DEFAULT 1000);\n"
+        "FIND o IN orders WHERE total > 100.5 LIMIT 50;\n"
+        "SHOW ME name FROM products WHERE id = 1;\n";
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node* program = parse_program(&parser);
+    bool  passed  = !parser.had_error && program->as.program.count == 7;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    // The parser never builds GET queries or error nodes, so make one of each by hand
+    Node* get               = passed ? ast_clone(program->as.program.statements[6]) : NULL;
+    Node* error             = (Node*)calloc(1, sizeof(Node));
+    error->type             = NODE_ERROR;
+    error->line             = 9;
+    error->as.error.message = strdup("Something went wrong");
+    if (get)
+        get->type = NODE_GET_QUERY;
+
+    bool       seen[NODE_IN_LIST + 1] = {false};
+    AstVisitor visitor                = {mark_type, NULL, seen, false};
+    ast_visit(program, &visitor);
+    ast_visit(get, &visitor);
+    ast_visit(error, &visitor);
+    for (int type = 0; type <= NODE_IN_LIST; type++) passed = passed && seen[type];
+
+    passed = passed && round_trips(program) && round_trips(get) && round_trips(error);
+    free_node(error);
+    free_node(get);
+    free_node(program);
+    return passed;
+}
+
+/**
+ * Trees in a pool follow each other in preorder, serialize as their Node form does, keep the sort
+ * direction of many ORDER BY fields, and reuse the pool's memory after a reset.
+ */
+static bool test_pool_stores_trees_in_order(void) {
+    char*  script = repeat(SAMPLE_QUERY "\nASK t FOR a ORDER BY f0", ", f DESC, g", 20, ";");
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node* program = parse_program(&parser);
+    bool  passed  = sizeof(FlatNode) == 16 && program->as.program.count == 2;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    AstPool pool;
+    ast_pool_init(&pool);
+    for (int round = 0; round < 2 && passed; round++) {
+        NodeIndex first  = ast_pool_add(&pool, program->as.program.statements[0]);
+        NodeIndex second = ast_pool_add(&pool, program->as.program.statements[1]);
+        passed = first == 0 && ast_pool_end(&pool, first) == second &&
+                 ast_pool_end(&pool, second) == pool.node_count &&
+                 pool.nodes[second].type == NODE_ASK_QUERY;
+
+        for (int i = 0; i < 2 && passed; i++) {
+            Node*          tree     = program->as.program.statements[i];
+            NodeIndex      root     = i ? second : first;
+            SerializedAST* expected = ast_serialize(tree, NULL);
+            SerializedAST* pooled   = ast_pool_serialize(&pool, root, NULL);
+            Node*          copy     = ast_pool_to_node(&pool, root);
+            passed = pooled != NULL && serializes_to(tree, pooled) && serializes_to(copy, expected);
+            free_node(copy);
+            ast_free(pooled);
+            ast_free(expected);
+        }
+
+        // f0, then 20 pairs of a descending and an ascending field
+        const FlatNode* statement = &pool.nodes[second];
+        const FlatNode* order_by  = &pool.nodes[ast_pool_child(&pool, statement, 4)];
+        passed = passed && order_by->type == NODE_ORDER_BY && order_by->as.children.count == 41;
+        for (uint32_t field = 0; field < 41 && passed; field++)
+            passed = ast_pool_ascending(&pool, order_by, field) == (field % 2 == 0);
+
+        size_t capacity = pool.node_capacity;
+        ast_pool_reset(&pool);
+        passed = passed && pool.node_count == 0 && pool.node_capacity == capacity;
+    }
+    ast_pool_free(&pool);
+    free_node(program);
+    free(script);
+    return passed;
+}
+
+// What the processor's planner hook saw: the first letter of each query's table, and how many of
+// the high and low priority queries had completed by then
+static char       planned[8];
+static int        high_done[8];
+static int        low_done[8];
+static NsqlQuery* prioritized[4];
+static atomic_int planned_count;
+static atomic_int gate_open;
+
+/**
+ * Planner hook that holds the first query until the gate opens and logs each later one.
+ *
+ * @param statement The statement.
+ * @param metadata The metadata (unchanged).
+ * @param user_data Unused.
+ */
+static void log_planned(const Node* statement, ExecutionMetadata* metadata, void* user_data) {
+    (void)metadata;
+    (void)user_data;
+    int count = atomic_load(&planned_count);
+    if (count < 8) {
+        const Node* table = statement->as.ask_query.source->as.source.identifier;
+        planned[count]    = table->as.identifier.name[0];
+        for (int i = 0; i < 4 && count > 0; i++) {
+            if (nsql_query_done(prioritized[i]))
+                (i < 2 ? high_done : low_done)[count]++;
+        }
+    }
+    atomic_store(&planned_count, count + 1);
+    while (!atomic_load(&gate_open)) {
+    }
+}
+
+/**
+ * Submit an ASK query for a table to the processor.
+ *
+ * @param table The table, a single letter.
+ * @param hint_flags HINT_PRIORITY_HIGH, HINT_PRIORITY_LOW or 0 for the default band.
+ * @return The completion handle.
+ */
+static NsqlQuery* submit_for(char table, uint16_t hint_flags) {
+    char query[32];
+    snprintf(query, sizeof(query), "ASK %c FOR a;", table);
+    ExecutionMetadata metadata = {hint_flags, 128, ENGINE_AUTO, 0, 0, NULL};
+    return nsql_submit_query(query, hint_flags ? &metadata : NULL);
+}
+
+/**
+ * A worker takes waiting queries highest band first and in submission order within a band, and
+ * each completed query has its plan or its errors.
+ */
+static bool test_processor_serves_by_priority(void) {
+    NsqlProcessorOptions options = {1, 0, false, false, log_planned, NULL};
+    memset(high_done, 0, sizeof(high_done));
+    memset(low_done, 0, sizeof(low_done));
+    atomic_store(&planned_count, 0);
+    atomic_store(&gate_open, 0);
+    if (!nsql_processor_init_with_options(&options))
+        return false;
+
+    // The only worker holds the first query while the rest wait in their bands. Queries with
+    // metadata skip the planner, so the planned ones in the default band show which had run
+    NsqlQuery* first = submit_for('a', 0);
+    while (atomic_load(&planned_count) == 0) {
+    }
+    prioritized[2]    = submit_for('l', HINT_PRIORITY_LOW);
+    NsqlQuery* normal = submit_for('n', 0);
+    prioritized[0]    = submit_for('h', HINT_PRIORITY_HIGH);
+    prioritized[3]    = submit_for('m', HINT_PRIORITY_LOW);
+    NsqlQuery* broken = nsql_submit_query("ASK t FOR ;", NULL);
+    prioritized[1]    = submit_for('i', HINT_PRIORITY_HIGH);
+    NsqlQuery* last   = submit_for('o', 0);
+    atomic_store(&gate_open, 1);
+
+    bool passed = broken != NULL && !nsql_query_wait(broken) &&
+                  nsql_query_result(broken, NULL) == NULL &&
+                  nsql_query_errors(broken)->error_count == 1;
+    NsqlQuery* planned_queries[] = {first, normal, last};
+    for (int i = 0; i < 7; i++) {
+        NsqlQuery*  query = i < 4 ? prioritized[i] : planned_queries[i - 4];
+        size_t      size;
+        const void* data = query && nsql_query_wait(query) ? nsql_query_result(query, &size) : NULL;
+        passed           = passed && data != NULL && checksum_is_valid(data, size);
+    }
+    // The hook reads the prioritized handles, so none is freed before the last query is planned
+    for (int i = 0; i < 7; i++)
+        nsql_query_free(i < 4 ? prioritized[i] : planned_queries[i - 4]);
+    nsql_query_free(broken);
+    nsql_processor_shutdown();
+
+    // The broken query never reaches the planner, and the low band waits for the default one
+    return passed && atomic_load(&planned_count) == 3 && memcmp(planned, "ano", 3) == 0 &&
+           high_done[1] == 2 && low_done[1] == 0 && high_done[2] == 2 && low_done[2] == 0;
+}
+
+/**
+ * The process-wide counters add up what each parser counted, and all read as zero unless the
+ * library was built with ENABLE_STATS.
+ */
+static bool test_stats_count_work(void) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+    nsql_stats_reset();
+    lexer_init(&lexer, SAMPLE_QUERY "ASK t FOR ;");
+    parser_init(&parser, &lexer);
+    bool           passed = parse_next_statement(&parser, &statement);
+    SerializedAST* ast    = passed ? ast_serialize(statement, NULL) : NULL;
+    size_t         size   = 0;
+    passed                = passed && ast_get_data(ast, &size) != NULL;
+    ast_free(ast);
+    free_node(statement);
+    parse_next_statement(&parser, &statement);
+
+    NsqlStats total;
+    nsql_stats_get(&total);
+    NsqlStats own = parser.stats;
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    if (!nsql_stats_enabled()) {
+        NsqlStats zero = {0};
+        return passed && memcmp(&total, &zero, sizeof(zero)) == 0 &&
+               memcmp(&own, &zero, sizeof(zero)) == 0;
+    }
+    return passed && own.tokens_lexed > 0 && own.nodes_created > 0 &&
+           own.errors[ERROR_SOURCE_PARSER] == 1 && total.tokens_lexed == own.tokens_lexed &&
+           total.nodes_created == own.nodes_created && total.bytes_copied == own.bytes_copied &&
+           total.errors[ERROR_SOURCE_PARSER] == 1 && total.serialized_asts == 1 &&
+           total.serialized_bytes == size && total.stage_ns[NSQL_STAGE_PARSE] > 0;
+}
+
+/**
+ * Every statement of the benchmark corpus parses and round-trips, so the suite times whole
+ * statements rather than error recovery.
+ */
+static bool test_bench_corpus_parses(void) {
+    FILE* file = fopen(NSQL_SAMPLES_DIR "/queries.nsql", "rb");
+    if (!file)
+        return false;
+    char   script[8192];
+    size_t length = fread(script, 1, sizeof(script) - 1, file);
+    bool   passed = feof(file) && length > 0;
+    fclose(file);
+    script[length] = '\0';
+
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node* program = parse_program(&parser);
+    passed        = passed && program && !parser.had_error && program->as.program.count == 16;
+    for (int i = 0; passed && i < program->as.program.count; i++)
+        passed = round_trips(program->as.program.statements[i]);
+
+    free_node(program);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    return passed;
+}
+
+/**
+ * Send a tree to a JSON printer's event sink a number of times.
+ *
+ * @param printer The printer.
+ * @param node The tree.
+ * @param count How many times to send it.
+ * @return true if every tree was printed.
+ */
+static bool emit_copies(AstPrinter* printer, const Node* node, int count) {
+    AstEventSink sink;
+    bool         passed = ast_printer_event_sink(printer, &sink);
+    for (int i = 0; passed && i < count; i++)
+        passed = ast_emit_events(node, &sink);
+    return passed;
+}
+
+/**
+ * Dynamic, fixed, measuring and file printers write the same bytes, and a fixed buffer that is
+ * too small keeps a NUL-terminated prefix and counts the rest.
+ */
+static bool test_printer_outputs_agree(void) {
+    Node* statement;
+    bool  passed = parse_first(SAMPLE_QUERY, &statement) == 0;
+
+    AstPrinter dynamic;
+    size_t     length = 0;
+    ast_printer_init_dynamic(&dynamic, AST_FORMAT_JSON);
+    passed       = passed && emit_copies(&dynamic, statement, 100);
+    char* events = ast_printer_take_output(&dynamic, &length);
+    passed       = passed && ast_printer_print(&dynamic, statement);
+    char* tree   = ast_printer_take_output(&dynamic, NULL);
+    for (int i = 0; passed && i < 300; i++)
+        passed = ast_printer_print(&dynamic, statement);
+    size_t tree_length;
+    char*  trees = ast_printer_take_output(&dynamic, &tree_length);
+    ast_printer_free(&dynamic);
+    passed = passed && length > 2 * AST_PRINTER_BLOCK_SIZE && strlen(events) == length &&
+             tree_length == 300 * strlen(tree) && strncmp(trees, tree, strlen(tree)) == 0;
+
+    // A measuring pass counts the output without writing any of it
+    AstPrinter fixed;
+    ast_printer_init_buffer(&fixed, AST_FORMAT_JSON, NULL, 0);
+    passed = passed && emit_copies(&fixed, statement, 100) &&
+             ast_printer_get_required(&fixed) == length && ast_printer_get_written(&fixed) == 0;
+    ast_printer_free(&fixed);
+
+    char small[64];
+    ast_printer_init_buffer(&fixed, AST_FORMAT_JSON, small, sizeof(small));
+    emit_copies(&fixed, statement, 100);
+    passed = passed && ast_printer_get_required(&fixed) == length &&
+             ast_printer_get_written(&fixed) == sizeof(small) - 1 &&
+             small[sizeof(small) - 1] == '\0' && strncmp(small, events, sizeof(small) - 1) == 0;
+    ast_printer_free(&fixed);
+
+    // File output is written in blocks, which must add up to the same bytes
+    FILE*      file = tmpfile();
+    AstPrinter printer;
+    passed = passed && file && ast_printer_init_file(&printer, AST_FORMAT_JSON, file);
+    for (int i = 0; passed && i < 300; i++)
+        passed = ast_printer_print(&printer, statement);
+    if (file) {
+        ast_printer_free(&printer);
+        char* written = malloc(tree_length + 1);
+        rewind(file);
+        passed = passed && written && fread(written, 1, tree_length + 1, file) == tree_length &&
+                 memcmp(written, trees, tree_length) == 0;
+        free(written);
+        fclose(file);
+    }
+
+    free(events);
+    free(tree);
+    free(trees);
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * Events of a tree, with the field at which to stop the walk.
+ */
+typedef struct {
+    char        trace[256];  // "(" per enter event, " name" per field, ")" per leave event
+    size_t      length;      // Length of trace
+    int         types[16];   // Type of each node entered
+    int         count;       // Number of nodes entered
+    int         depth;       // Depth of the current node, -2 once an event was out of order
+    const char* stop_at;     // Name of the field at which to stop the walk (NULL = never)
+} EventLog;
+
+/**
+ * Append to the trace of an EventLog.
+ *
+ * @param log The log.
+ * @param text The text.
+ * @param name A field name to append after the text ("" for none).
+ */
+static void trace_event(EventLog* log, const char* text, const char* name) {
+    if (log->length < sizeof(log->trace))
+        log->length += (size_t)snprintf(log->trace + log->length,
+                                        sizeof(log->trace) - log->length, "%s%s", text, name);
+}
+
+/**
+ * Record an enter event in an EventLog.
+ *
+ * @param node The node.
+ * @param user_data The log.
+ * @return true to continue.
+ */
+static bool log_enter(const AstEventNode* node, void* user_data) {
+    EventLog* log = (EventLog*)user_data;
+    trace_event(log, "(", "");
+    if (log->count < 16)
+        log->types[log->count] = node->type;
+    log->count++;
+    log->depth = log->depth >= -1 && node->depth == log->depth + 1 && node->children == 0
+                     ? node->depth
+                     : -2;
+    return true;
+}
+
+/**
+ * Record a field event in an EventLog.
+ *
+ * @param field The field.
+ * @param user_data The log.
+ * @return false at the log's stop_at field.
+ */
+static bool log_field(const AstField* field, void* user_data) {
+    EventLog* log = (EventLog*)user_data;
+    trace_event(log, " ", field->name);
+    return !log->stop_at || strcmp(field->name, log->stop_at) != 0;
+}
+
+/**
+ * Record a leave event in an EventLog.
+ *
+ * @param node The node.
+ * @param user_data The log.
+ * @return true to continue.
+ */
+static bool log_leave(const AstEventNode* node, void* user_data) {
+    EventLog* log = (EventLog*)user_data;
+    trace_event(log, ")", "");
+    log->depth = log->depth >= -1 && node->depth == log->depth ? node->depth - 1 : -2;
+    return true;
+}
+
+/**
+ * A tree is sent as nested enter and leave events with the fields of each node, a callback can
+ * stop the walk, and the JSON sink prints the whole tree as one line.
+ */
+static bool test_events_describe_tree(void) {
+    static const char trace[] =
+        "((( name))( count( name))( operator( name)( operator( value literalType)"
+        "( value literalType))))";
+    static const int preorder[] = {
+        NODE_ASK_QUERY,   NODE_SOURCE,     NODE_IDENTIFIER,  NODE_FIELD_LIST, NODE_IDENTIFIER,
+        NODE_BINARY_EXPR, NODE_IDENTIFIER, NODE_BINARY_EXPR, NODE_LITERAL,    NODE_LITERAL,
+    };
+    static const char json[] =
+        "{\"type\":\"ask_query\",\"line\":1,\"children\":[{\"type\":\"source\",\"line\":1,"
+        "\"children\":[{\"type\":\"identifier\",\"line\":1,\"name\":\"t\"}]},"
+        "{\"type\":\"field_list\",\"line\":1,\"count\":1,\"children\":[{\"type\":\"identifier\","
+        "\"line\":1,\"name\":\"a\"}]},{\"type\":\"binary_expr\",\"line\":1,\"operator\":\"=\","
+        "\"children\":[{\"type\":\"identifier\",\"line\":1,\"name\":\"b\"},"
+        "{\"type\":\"binary_expr\",\"line\":1,\"operator\":\"+\",\"children\":[{\"type\":"
+        "\"literal\",\"line\":1,\"value\":1,\"literalType\":\"integer\"},{\"type\":\"literal\","
+        "\"line\":1,\"value\":2,\"literalType\":\"integer\"}]}]}]}\n";
+    Node* statement;
+    bool  passed = parse_first("ASK t FOR a WHERE b = 1 + 2;", &statement) == 0;
+
+    EventLog     log  = {{0}, 0, {0}, 0, -1, NULL};
+    AstEventSink sink = {log_enter, log_field, log_leave, &log};
+    passed = passed && ast_emit_events(statement, &sink) && strcmp(log.trace, trace) == 0 &&
+             log.depth == -1 && log.count == 10 &&
+             memcmp(log.types, preorder, sizeof(preorder)) == 0;
+
+    // Stopping at the first operator leaves the rest of the tree out
+    log    = (EventLog){{0}, 0, {0}, 0, -1, "operator"};
+    passed = passed && !ast_emit_events(statement, &sink) &&
+             strcmp(log.trace, "((( name))( count( name))( operator") == 0;
+
+    AstPrinter printer;
+    ast_printer_init_dynamic(&printer, AST_FORMAT_JSON);
+    passed        = passed && emit_copies(&printer, statement, 2);
+    char*  output = ast_printer_take_output(&printer, NULL);
+    size_t length = strlen(json);
+    passed        = passed && output && strlen(output) == 2 * length &&
+             strncmp(output, json, length) == 0 && strcmp(output + length, json) == 0;
+    free(output);
+    ast_printer_free(&printer);
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * Parse the first statement of the start of a script from an exact-size heap copy.
+ *
+ * @param script The script.
+ * @param length Number of bytes of the script to copy and parse.
+ * @param statement Receives the statement (NULL if it has errors), freed by the caller.
+ * @return The number of errors reported.
+ */
+static int parse_first_n(const char* script, size_t length, Node** statement) {
+    char* source = (char*)malloc(length);
+    memcpy(source, script, length);
+    Lexer  lexer;
+    Parser parser;
+    lexer_init_n(&lexer, source, length);
+    parser_init(&parser, &lexer);
+    *statement = NULL;
+    parse_next_statement(&parser, statement);
+    int errors = parser.errors.error_count;
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(source);
+    return errors;
+}
+
+/**
+ * A source of known length ends at its length even in the middle of a number, and a NUL byte
+ * within it is a character rather than the end of input.
+ */
+static bool test_sized_source_ends_at_length(void) {
+    static const char decimal[] = "ASK t FOR a WHERE b > 2.75";
+    static const char integer[] = "ASK t FOR a LIMIT 12345;";
+    Node*             statement;
+    bool              passed = parse_first_n(decimal, sizeof(decimal) - 2, &statement) == 0;
+    passed = passed && same_as_parse(statement, "ASK t FOR a WHERE b > 2.7;");
+    passed = passed && parse_first_n(integer, sizeof(integer) - 5, &statement) == 0;
+    passed = passed && same_as_parse(statement, "ASK t FOR a LIMIT 12;");
+
+    // The NUL is reported where it is, and lexing goes on after it
+    static const char embedded[] = "ASK t FOR a\0b;";
+    static const int  types[]    = {
+        TOKEN_ASK,   TOKEN_IDENTIFIER, TOKEN_FOR,        TOKEN_IDENTIFIER,
+        TOKEN_ERROR, TOKEN_IDENTIFIER, TOKEN_TERMINATOR, TOKEN_EOF,
+    };
+    Lexer lexer;
+    lexer_init_n(&lexer, embedded, sizeof(embedded) - 1);
+    for (int i = 0; i < 8 && passed; i++) {
+        Token token = lexer_next_token(&lexer);
+        passed      = token.type == (NsqlTokenType)types[i];
+    }
+    lexer_free(&lexer);
+    return passed && parse_first_n(embedded, sizeof(embedded) - 1, &statement) == 1 &&
+           statement == NULL;
+}
+
+/**
+ * Compare the error reports of two contexts.
+ *
+ * @param a The first context (NULL for none).
+ * @param b The second context (NULL for none).
+ * @return true if both hold the same reports at the same positions.
+ */
+static bool same_errors(const ErrorContext* a, const ErrorContext* b) {
+    if (!a || !b)
+        return a == b;
+    const ErrorReport* x = a->first_error;
+    const ErrorReport* y = b->first_error;
+    for (; x && y; x = x->next, y = y->next) {
+        if (x->line != y->line || x->column != y->column || strcmp(x->message, y->message) != 0)
+            return false;
+    }
+    return !x && !y && a->error_count == b->error_count && a->warning_count == b->warning_count;
+}
+
+/**
+ * Check an edited document against a document parsed from its text in one go.
+ *
+ * @param document The document.
+ * @return true if every statement has the same extent, position, tree and errors.
+ */
+static bool document_is_current(const NsqlDocument* document) {
+    NsqlDocument fresh;
+    nsql_document_init(&fresh, document->text, document->length, document->case_insensitive);
+    bool passed = fresh.count == document->count;
+    for (size_t i = 0; passed && i < fresh.count; i++) {
+        const NsqlDocumentStatement* edited   = &document->statements[i];
+        const NsqlDocumentStatement* expected = &fresh.statements[i];
+        SerializedAST* tree = expected->statement ? ast_serialize(expected->statement, NULL) : NULL;
+        passed              = edited->offset == expected->offset &&
+                 edited->length == expected->length && edited->line == expected->line &&
+                 edited->column == expected->column &&
+                 (tree ? edited->statement && serializes_to(edited->statement, tree)
+                       : !edited->statement) &&
+                 same_errors(edited->errors, expected->errors);
+        ast_free(tree);
+    }
+    nsql_document_free(&fresh);
+    return passed;
+}
+
+/**
+ * An edit parses only the statements it touches, moves the trees after it to their new lines,
+ * and leaves the document as a fresh parse of its text would be, also after edits that open
+ * strings and comments or break and join statements.
+ */
+static bool test_document_reparses_edits(void) {
+    static const char script[] = "ASK a FOR x;\nASK b FOR y;\nASK c FOR z WHERE w > 1;\n";
+    NsqlDocument      document;
+    nsql_document_init(&document, script, sizeof(script) - 1, false);
+    bool  passed = document.count == 3 && document_is_current(&document);
+    Node* first  = document.statements[0].statement;
+    Node* last   = document.statements[2].statement;
+
+    // Typing within the second statement parses it alone
+    passed = passed && nsql_document_edit(&document, 24, 0, ", q", 3) &&
+             document.statements[1].statement != NULL && document.first_changed == 1 &&
+             document.changed_count == 1 && document.replaced_count == 1 &&
+             document.statements[0].statement == first &&
+             document.statements[2].statement == last && document_is_current(&document);
+
+    // New lines in the first statement shift the last one without parsing it again
+    passed = passed && nsql_document_edit(&document, 5, 0, "\n\n", 2) &&
+             document.first_changed == 0 && document.changed_count == 1 &&
+             document.statements[2].statement == last && last->line == 5 &&
+             document_is_current(&document);
+
+    // A broken statement keeps its errors, and an edit outside the text changes nothing
+    passed = passed && nsql_document_edit(&document, 21, 3, "", 0) &&
+             document.statements[1].statement == NULL && document.statements[1].errors &&
+             document_is_current(&document) &&
+             !nsql_document_edit(&document, document.length, 1, "", 0) &&
+             !nsql_document_edit(&document, document.length + 1, 0, "x", 1) &&
+             document_is_current(&document);
+
+    // Pseudo-random edits from pieces that open strings and comments and add and remove
+    // terminators, growing the script and then cutting it back
+    static const char* pieces[] = {
+        ";", "'", "\n", "ASK t FOR a", ">> c\n", "x", " PLEASE", "WHERE b > 1", "",
+    };
+    uint32_t seed = 1;
+    for (int i = 0; passed && i < 500; i++) {
+        seed             = seed * 1103515245u + 12345u;
+        size_t offset    = (seed >> 8) % (document.length + 1);
+        seed             = seed * 1103515245u + 12345u;
+        size_t removed   = document.length > 400 ? 40 : (seed >> 8) % 4;
+        removed          = removed < document.length - offset ? removed : document.length - offset;
+        seed             = seed * 1103515245u + 12345u;
+        const char* text = pieces[(seed >> 8) % (sizeof(pieces) / sizeof(pieces[0]))];
+        passed           = nsql_document_edit(&document, offset, removed, text, strlen(text)) &&
+                 document_is_current(&document);
+    }
+    nsql_document_free(&document);
+    return passed;
+}
+
+/**
+ * Row estimates, scan choice, parallel hints, timeouts and engines follow the catalog, and
+ * statements on tables it does not know keep their metadata.
+ */
+static bool test_planner_uses_catalog(void) {
+    static const NsqlColumnStats columns[] = {
+        {"id", 0.000001, "customers_pk"},
+        {"plan", 0.25, NULL},
+        {"country", 0.05, "by_country"},
+    };
+    static const NsqlTableStats tables[] = {
+        {"customers", 1000000, ENGINE_SQL, columns, 3},
+        {"events", 500, ENGINE_NOSQL, NULL, 0},
+    };
+    static const struct {
+        const char* query;
+        uint16_t    scan;   // HINT_INDEX_SCAN, HINT_FULL_SCAN and HINT_PARALLEL_EXEC bits
+        uint32_t    rows;   // estimated_rows
+        uint32_t    timeout;
+        const char* index;  // target_index
+        uint8_t     engine;
+    } cases[] = {
+        {"ASK customers FOR name WHERE id = 7;", HINT_INDEX_SCAN, 1, 1000, "customers_pk",
+         ENGINE_SQL},
+        {"ASK customers FOR name WHERE plan = 'annual';", HINT_FULL_SCAN | HINT_PARALLEL_EXEC,
+         250000, 11000, NULL, ENGINE_SQL},
+        {"ASK customers FOR name WHERE plan != 'annual';", HINT_FULL_SCAN | HINT_PARALLEL_EXEC,
+         750000, 11000, NULL, ENGINE_SQL},
+        {"ASK customers FOR name WHERE country = 'uk' AND plan = 'annual';", HINT_INDEX_SCAN,
+         12500, 1500, "by_country", ENGINE_SQL},
+        {"ASK customers FOR name WHERE country = 'uk' OR plan = 'annual';",
+         HINT_FULL_SCAN | HINT_PARALLEL_EXEC, 287501, 11000, NULL, ENGINE_SQL},
+        {"ASK customers FOR name WHERE country IN ('uk', 'fr');",
+         HINT_INDEX_SCAN | HINT_PARALLEL_EXEC, 100000, 2000, "by_country", ENGINE_SQL},
+        {"ASK customers FOR name WHERE age > 30;", HINT_FULL_SCAN | HINT_PARALLEL_EXEC, 333334,
+         11000, NULL, ENGINE_SQL},
+        {"ASK events FOR a;", HINT_FULL_SCAN, 500, 1005, NULL, ENGINE_NOSQL},
+        {"TELL customers TO REMOVE;", HINT_FULL_SCAN, 1000000, 11000, NULL, ENGINE_SQL},
+    };
+    NsqlCatalog catalog = {tables, 2, 0, 0, 0, 100, 0, 0};
+    bool        passed  = true;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]) && passed; i++) {
+        Node*             statement;
+        ExecutionMetadata metadata;
+        passed = parse_first(cases[i].query, &statement) == 0;
+        if (passed) {
+            metadata = ast_create_metadata(statement);
+            nsql_plan_with_catalog(statement, &metadata, &catalog);
+        }
+        uint16_t scan = HINT_INDEX_SCAN | HINT_FULL_SCAN | HINT_PARALLEL_EXEC;
+        passed        = passed && (metadata.hint_flags & scan) == cases[i].scan &&
+                 metadata.estimated_rows == cases[i].rows &&
+                 metadata.timeout_ms == cases[i].timeout &&
+                 metadata.engine_type == cases[i].engine &&
+                 (cases[i].index ? metadata.target_index &&
+                                       strcmp(metadata.target_index, cases[i].index) == 0
+                                 : metadata.target_index == NULL);
+        free_node(statement);
+    }
+
+    // A table missing from the catalog leaves the metadata as it was
+    Node* statement;
+    passed = passed && parse_first("ASK other FOR a;", &statement) == 0;
+    if (passed) {
+        ExecutionMetadata heuristic = ast_create_metadata(statement);
+        ExecutionMetadata planned   = heuristic;
+        nsql_plan_with_catalog(statement, &planned, &catalog);
+        passed = memcmp(&heuristic, &planned, sizeof(planned)) == 0;
+    }
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * LIMIT and OFFSET counts past INT32_MAX are errors rather than wrapping into placeholders.
+ */
+static bool test_limit_out_of_range(void) {
+    static const char* const scripts[] = {
+        "ASK t FOR a LIMIT 3000000000;",
+        "ASK t FOR a LIMIT 2147483648;",
+        "ASK t FOR a LIMIT 10 OFFSET 99999999999;",
+    };
+    char output[1024];
+    for (size_t i = 0; i < sizeof(scripts) / sizeof(scripts[0]); i++) {
+        parse_and_format(scripts[i], true, output, sizeof(output));
+        if (strstr(output, "LIMIT/OFFSET out of range") == NULL)
+            return false;
+    }
+
+    // The largest count is still a count, not a placeholder
+    Node*          statement;
+    bool           parsed = parse_first("ASK t FOR a LIMIT 2147483647 OFFSET 2147483647;",
+                                        &statement) == 0;
+    SerializedAST* ast    = parsed ? ast_serialize(statement, NULL) : NULL;
+    bool           passed = ast != NULL && ast_parameter_count(ast) == 0;
+    ast_free(ast);
+    free_node(statement);
+    return passed;
+}
+
+/**
+ * A statement holds at most NSQL_MAX_PARAMETERS placeholders, whose indexes all serialize.
+ */
+static bool test_placeholder_limit(void) {
+    Node* statement;
+    char* script = repeat("ASK t FOR a WHERE x IN (?", ", ?", NSQL_MAX_PARAMETERS - 1, ");");
+    bool  passed = parse_first(script, &statement) == 0;
+    free(script);
+
+    SerializedAST* ast = passed ? ast_serialize(statement, NULL) : NULL;
+    passed             = ast != NULL && ast_parameter_count(ast) == NSQL_MAX_PARAMETERS;
+    ast_free(ast);
+    free_node(statement);
+
+    char output[1024];
+    script = repeat("ASK t FOR a WHERE x IN (?", ", ?", NSQL_MAX_PARAMETERS, ");");
+    parse_and_format(script, true, output, sizeof(output));
+    free(script);
+    return passed && strstr(output, "Too many placeholders in statement") != NULL;
+}
+
+/**
+ * Parse a script with parse_program_parallel() and format the errors.
+ *
+ * @param script The script.
+ * @param threads Worker threads.
+ * @param batch_size Bytes per batch.
+ * @param output Receives the formatted errors.
+ * @param size Size of output.
+ * @return The number of statements that parsed.
+ */
+static int parse_parallel(const char* script, int threads, size_t batch_size, char* output,
+                          size_t size) {
+    ParallelParseOptions options = {threads, batch_size, false};
+    ErrorContext         errors;
+    error_context_init(&errors);
+    Node* program = parse_program_parallel(script, &options, &errors);
+    int   count   = program ? program->as.program.count : 0;
+    free_node(program);
+    format_errors(&errors, output, size);
+    error_context_free(&errors);
+    return count;
+}
+
+/**
+ * Parse a script under limits.
+ *
+ * @param script The script.
+ * @param max_tokens Parser.max_tokens.
+ * @param max_nodes Parser.max_nodes.
+ * @param max_errors Parser.max_errors.
+ * @param errors Receives the number of errors reported, or -1 if no limit was reached.
+ * @param output Receives the formatted errors (1024 bytes).
+ * @return The number of statements parsed without errors.
+ */
+static int parse_limited(const char* script, size_t max_tokens, size_t max_nodes, int max_errors,
+                         int* errors, char* output) {
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    parser.max_tokens = max_tokens;
+    parser.max_nodes  = max_nodes;
+    parser.max_errors = max_errors;
+    int statements    = 0;
+    while (parse_next_statement(&parser, &statement)) {
+        statements += statement != NULL;
+        free_node(statement);
+    }
+    *errors = parser.limit_reached ? parser.errors.error_count : -1;
+    parser_format_errors(&parser, output, 1024);
+    parser_free(&parser);
+    lexer_free(&lexer);
+    return statements;
+}
+
+/**
+ * Token, node and error limits stop the parse with one more error, and input within the limits
+ * parses as without them.
+ */
+static bool test_parser_limits_stop_parse(void) {
+    Lexer  lexer;
+    size_t tokens = 0;
+    lexer_init(&lexer, SAMPLE_QUERY);
+    while (lexer_next_token(&lexer).type != TOKEN_EOF) tokens++;
+    lexer_free(&lexer);
+
+    int  errors;
+    char output[1024];
+    bool passed = parse_limited(SAMPLE_QUERY, tokens, 0, 0, &errors, output) == 1 && errors == -1;
+    passed      = passed && parse_limited(SAMPLE_QUERY, tokens - 1, 0, 0, &errors, output) == 0 &&
+             errors == 1 && strstr(output, "Too many tokens") != NULL;
+
+    // Each statement makes a few nodes, so a node limit ends a long script early
+    char* script = repeat("", "ASK t FOR a;\n", 100, "");
+    int   parsed = parse_limited(script, 0, 10, 0, &errors, output);
+    passed       = passed && parsed > 0 && parsed < 10 && errors == 1 &&
+             strstr(output, "Too many AST nodes") != NULL &&
+             parse_limited(script, 0, 0, 0, &errors, output) == 100 && errors == -1;
+    free(script);
+
+    // Three errors and the report of the limit, of 40 broken statements
+    script = repeat("", "ASK t FOR ;\n", 40, "");
+    passed = passed && parse_limited(script, 0, 0, 3, &errors, output) == 0 && errors == 4 &&
+             strstr(output, "Too many errors") != NULL &&
+             parse_limited(script, 0, 0, 0, &errors, output) == 0 && errors == -1;
+    free(script);
+    return passed;
+}
+
+/**
+ * Statements end at terminators outside strings and comments, and in parallel they parse to the
+ * same program as in sequence.
+ */
+static bool test_parallel_matches_sequential(void) {
+    static const char split[] = "ASK a FOR x WHERE y = ';' >> not; the end\n"
+                                "; SHOW ME z FROM w please\n"
+                                "  >> only a comment;\n";
+    StatementSpan*    spans;
+    size_t            count  = split_statements(split, strlen(split), true, &spans);
+    bool              passed = count == 2 && spans[0].line == 1 && spans[1].line == 2 &&
+                  spans[0].start + spans[0].length == strstr(split, " SHOW") &&
+                  spans[1].start + spans[1].length == strstr(split, "\n  >>");
+    free(spans);
+    count  = split_statements(split, strlen(split), false, &spans);
+    passed = passed && count == 2 && spans[1].start + spans[1].length == split + strlen(split);
+    free(spans);
+
+    char*  script = repeat("", SAMPLE_QUERY "\nFIND o IN orders WHERE total > 100;\n", 100, "");
+    Lexer  lexer;
+    Parser parser;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    Node*          sequential = parse_program(&parser);
+    SerializedAST* expected   = ast_serialize(sequential, NULL);
+    free_node(sequential);
+    parser_free(&parser);
+    lexer_free(&lexer);
+
+    ParallelParseOptions options = {4, 256, false};
+    ErrorContext         errors;
+    error_context_init(&errors);
+    Node* program = parse_program_parallel(script, &options, &errors);
+    passed        = passed && program != NULL && program->as.program.count == 200 &&
+             errors.error_count == 0 && serializes_to(program, expected);
+    free_node(program);
+    error_context_free(&errors);
+    ast_free(expected);
+    free(script);
+    return passed;
+}
+
+/**
+ * Errors of a parallel parse do not depend on how the script is split among threads and batches.
+ */
+static bool test_parallel_errors_are_stable(void) {
+    // Recovery from each broken statement would run on into the next one in a shared lexer
+    char* script = repeat("", "TELL t TO UPDATE; x = 1; TELL t TO ADD; GET; ASK t FOR a, ;\n"
+                              "ASK t FOR a WHERE f(; SHOW FROM x; ASK u FOR b LIMIT ?;\n",
+                          200, "");
+
+    static const int    threads[]     = {1, 2, 4};
+    static const size_t batch_sizes[] = {1, 50, 1000, 100000, 0};
+    static char         expected[1 << 20];
+    static char         output[1 << 20];
+    int                 count  = parse_parallel(script, 1, 1, expected, sizeof(expected));
+    bool                passed = count == 200 && strstr(expected, "Error") != NULL;
+
+    for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+        for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+            int parsed = parse_parallel(script, threads[t], batch_sizes[b], output, sizeof(output));
+            passed     = passed && parsed == count && strcmp(output, expected) == 0;
+        }
+    }
+    free(script);
+    return passed;
+}
+
+/**
+ * Check that the reports of an error context are on consecutive lines.
+ *
+ * @param errors The error context.
+ * @param first Line of the first report.
+ * @param last Line of the last report.
+ * @return true if the reports are on lines first to last, in order.
+ */
+static bool reports_on_lines(const ErrorContext* errors, int first, int last) {
+    const ErrorReport* report = NULL;
+    int                line   = first;
+    while ((report = error_context_next(errors, report)) != NULL) {
+        if (report->line != line++)
+            return false;
+    }
+    return line == last + 1;
+}
+
+/**
+ * A parser in ring mode keeps the latest errors in order, including those reported before the
+ * ring was enabled, and says how many were dropped.
+ */
+static bool test_parser_errors_in_ring(void) {
+    char*  script = repeat("", "ASK b FOR ;\n", 40, "");
+    Lexer  lexer;
+    Parser parser;
+    Node*  statement;
+    lexer_init(&lexer, script);
+    parser_init(&parser, &lexer);
+    parse_next_statement(&parser, &statement);
+    error_context_use_ring(&parser.errors);
+
+    bool passed = parser.errors.first_error == NULL;
+    for (int line = 2; line <= 40; line++) {
+        parse_next_statement(&parser, &statement);
+        if (line == 10)
+            passed = passed && reports_on_lines(&parser.errors, 1, 10);
+    }
+    passed = passed && parser.errors.error_count == 40 &&
+             parser.errors.dropped == 40 - NSQL_ERROR_RING_CAPACITY &&
+             reports_on_lines(&parser.errors, 40 - NSQL_ERROR_RING_CAPACITY + 1, 40);
+
+    char output[4096];
+    parser_format_errors(&parser, output, sizeof(output));
+    parser_free(&parser);
+    lexer_free(&lexer);
+    free(script);
+    return passed && strstr(output, "earlier report(s) dropped") != NULL;
+}
+
+/**
+ * Ring mode keeps copies of messages whose buffers are gone, and they survive a move.
+ */
+static bool test_error_ring_copies_messages(void) {
+    ErrorContext errors;
+    error_context_init(&errors);
+    error_context_use_ring(&errors);
+
+    for (int i = 0; i < NSQL_ERROR_RING_CAPACITY + 3; i++) {
+        char* message = (char*)malloc(NSQL_ERROR_MESSAGE_CAPACITY * 2);
+        memset(message, 'x', NSQL_ERROR_MESSAGE_CAPACITY * 2 - 1);
+        message[NSQL_ERROR_MESSAGE_CAPACITY * 2 - 1] = '\0';
+        snprintf(message, 16, "message %d", i);
+        message[strlen(message)] = ' ';
+        report_error(&errors, ERROR_ERROR, ERROR_SOURCE_LEXER, i + 1, 0, message);
+        free(message);
+    }
+
+    ErrorContext moved;
+    error_context_move(&moved, &errors);
+    error_context_free(&errors);
+
+    bool passed = moved.ring_count == NSQL_ERROR_RING_CAPACITY && moved.dropped == 3 &&
+                  errors.use_ring && error_context_next(&errors, NULL) == NULL;
+
+    int                line   = 4;
+    const ErrorReport* report = NULL;
+    while ((report = error_context_next(&moved, report)) != NULL) {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "message %d ", line - 1);
+        passed = passed && report->line == line++ &&
+                 strncmp(report->message, expected, strlen(expected)) == 0 &&
+                 strlen(report->message) == NSQL_ERROR_MESSAGE_CAPACITY - 1;
+    }
+    error_context_free(&moved);
+    return passed && line == NSQL_ERROR_RING_CAPACITY + 4;
+}
+
+int main(void) {
+    static const struct {
+        const char* name;
+        bool (*run)(void);
+    } tests[] = {
+        {"lone_bang_outlives_source", test_lone_bang_outlives_source},
+        {"keywords_are_recognized", test_keywords_are_recognized},
+        {"scanners_stop_at_run_end", test_scanners_stop_at_run_end},
+        {"line_index_matches_newlines", test_line_index_matches_newlines},
+        {"walks_and_nesting_limit", test_walks_and_nesting_limit},
+        {"deep_chain_round_trips", test_deep_chain_round_trips},
+        {"join_chain_is_limited", test_join_chain_is_limited},
+        {"arena_parse_matches_malloc", test_arena_parse_matches_malloc},
+        {"zero_copy_clone_outlives_source", test_zero_copy_clone_outlives_source},
+        {"stream_skips_broken_statements", test_stream_skips_broken_statements},
+        {"chains_are_flattened", test_chains_are_flattened},
+        {"query_cache_shares_shapes", test_query_cache_shares_shapes},
+        {"optimizer_is_conservative", test_optimizer_is_conservative},
+        {"optimizer_folds_constants", test_optimizer_folds_constants},
+        {"prepared_statements_bind", test_prepared_statements_bind},
+        {"reader_walks_in_place", test_reader_walks_in_place},
+        {"reader_random_access", test_reader_random_access},
+        {"checksums_match_reference", test_checksums_match_reference},
+        {"compression_round_trips", test_compression_round_trips},
+        {"strings_are_stored_once", test_strings_are_stored_once},
+        {"batch_frames_match_single", test_batch_frames_match_single},
+        {"every_node_type_round_trips", test_every_node_type_round_trips},
+        {"pool_stores_trees_in_order", test_pool_stores_trees_in_order},
+        {"processor_serves_by_priority", test_processor_serves_by_priority},
+        {"stats_count_work", test_stats_count_work},
+        {"bench_corpus_parses", test_bench_corpus_parses},
+        {"printer_outputs_agree", test_printer_outputs_agree},
+        {"events_describe_tree", test_events_describe_tree},
+        {"sized_source_ends_at_length", test_sized_source_ends_at_length},
+        {"document_reparses_edits", test_document_reparses_edits},
+        {"planner_uses_catalog", test_planner_uses_catalog},
+        {"limit_out_of_range", test_limit_out_of_range},
+        {"placeholder_limit", test_placeholder_limit},
+        {"parser_limits_stop_parse", test_parser_limits_stop_parse},
+        {"parallel_matches_sequential", test_parallel_matches_sequential},
+        {"parallel_errors_are_stable", test_parallel_errors_are_stable},
+        {"parser_errors_in_ring", test_parser_errors_in_ring},
+        {"error_ring_copies_messages", test_error_ring_copies_messages},
+    };
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bool passed = tests[i].run();
+        printf("%s %s\n", passed ? "PASS" : "FAIL", tests[i].name);
+        if (!passed)
+            failed++;
+    }
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}